@@ -283,6 +283,9 @@
         else
             [self _autosave:nil];
     }
+    
+    // the autosave is written on the game state writer thread; the process must not exit before it is on disk
+    [RXGameStateSnapshot waitForBackgroundWrites];
 }
 
 - (void)applicationWillResignActive:(NSNotification*)notification
@@ -517,7 +520,8 @@
     
     // FIXME: the autosave should contain extra data to point to the actual saved game such that if we load the autosave,
     // saving will continue to go in the actual saved game
-    [gameState writeToURL:autosaveURL updateURL:NO error:NULL];
+    // the snapshot is encoded and written on the game state writer thread, so that autosaving never stalls the game
+    [[gameState snapshot] writeToURLInBackground:autosaveURL];
 }
 
 - (BOOL)isGameLoaded
@@ -329,7 +329,7 @@ static NSInteger string_numeric_insensitive_sort(id lhs, id rhs, void* context)
         return YES;
     }
     
-    NSDictionary* md_program = [[[hotspot scripts] objectForKey:RXMouseDownScriptKey] objectAtIndexIfAny:0];
+    NSDictionary* md_program = rx_riven_program_descriptor([hotspot scripts], kScriptTypeMouseDown, 0);
     if (!md_program)
     {
         [bspit_284 release];
@@ -0,0 +1,267 @@
+/*
+ *  RXByteSwap.h
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 31/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#if !defined(RX_BYTE_SWAP_H)
+#define RX_BYTE_SWAP_H
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//
+// Byte swapping kernels for the big-endian resources of the Mohawk archives. The kernels swap unconditionally; callers
+// only use them on little-endian hosts. Spans may start at any address, and the kernels process 16 bytes at a time with
+// SSE2, SSSE3 or NEON when the compiler targets them, and one value at a time otherwise (or if RX_BYTE_SWAP_SCALAR is
+// defined).
+//
+// Packed structures that mix 16-bit and 32-bit fields are described by a layout, which turns the field sizes into
+// byte shuffle masks of up to 16 bytes that never split a field.
+//
+
+#if !defined(RX_BYTE_SWAP_SCALAR)
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define RX_BYTE_SWAP_SSE2 1
+#define RX_BYTE_SWAP_SSSE3 1
+#elif defined(__SSE2__) || defined(__x86_64__)
+#include <emmintrin.h>
+#define RX_BYTE_SWAP_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RX_BYTE_SWAP_NEON 1
+#endif
+#endif
+
+__BEGIN_DECLS
+
+static inline uint16_t rx_swap16(uint16_t v) {
+    return (uint16_t)((v << 8) | (v >> 8));
+}
+
+static inline uint32_t rx_swap32(uint32_t v) {
+    return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+// swaps count 16-bit words in place
+static inline void rx_swap16_span(void* data, size_t count) {
+    uint8_t* p = (uint8_t*)data;
+    size_t i = 0;
+
+#if defined(RX_BYTE_SWAP_SSSE3)
+    const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i * 2));
+        _mm_storeu_si128((__m128i*)(p + i * 2), _mm_shuffle_epi8(v, mask));
+    }
+#elif defined(RX_BYTE_SWAP_SSE2)
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i * 2));
+        _mm_storeu_si128((__m128i*)(p + i * 2), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+    }
+#elif defined(RX_BYTE_SWAP_NEON)
+    for (; i + 8 <= count; i += 8)
+        vst1q_u8(p + i * 2, vrev16q_u8(vld1q_u8(p + i * 2)));
+#endif
+
+    for (; i < count; i++) {
+        uint16_t v;
+        memcpy(&v, p + i * 2, sizeof(v));
+        v = rx_swap16(v);
+        memcpy(p + i * 2, &v, sizeof(v));
+    }
+}
+
+// swaps count 32-bit words in place
+static inline void rx_swap32_span(void* data, size_t count) {
+    uint8_t* p = (uint8_t*)data;
+    size_t i = 0;
+
+#if defined(RX_BYTE_SWAP_SSSE3)
+    const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i * 4));
+        _mm_storeu_si128((__m128i*)(p + i * 4), _mm_shuffle_epi8(v, mask));
+    }
+#elif defined(RX_BYTE_SWAP_SSE2)
+    for (; i + 4 <= count; i += 4) {
+        // swap the bytes of each half, then the halves of each word
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i * 4));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128((__m128i*)(p + i * 4), v);
+    }
+#elif defined(RX_BYTE_SWAP_NEON)
+    for (; i + 4 <= count; i += 4)
+        vst1q_u8(p + i * 4, vrev32q_u8(vld1q_u8(p + i * 4)));
+#endif
+
+    for (; i < count; i++) {
+        uint32_t v;
+        memcpy(&v, p + i * 4, sizeof(v));
+        v = rx_swap32(v);
+        memcpy(p + i * 4, &v, sizeof(v));
+    }
+}
+
+// copies count 16-bit words from src to dst, swapping them; the spans must not overlap
+static inline void rx_swap16_copy_span(void* dst, const void* src, size_t count) {
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    size_t i = 0;
+
+#if defined(RX_BYTE_SWAP_SSSE3)
+    const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + i * 2));
+        _mm_storeu_si128((__m128i*)(d + i * 2), _mm_shuffle_epi8(v, mask));
+    }
+#elif defined(RX_BYTE_SWAP_SSE2)
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + i * 2));
+        _mm_storeu_si128((__m128i*)(d + i * 2), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+    }
+#elif defined(RX_BYTE_SWAP_NEON)
+    for (; i + 8 <= count; i += 8)
+        vst1q_u8(d + i * 2, vrev16q_u8(vld1q_u8(s + i * 2)));
+#endif
+
+    for (; i < count; i++) {
+        uint16_t v;
+        memcpy(&v, s + i * 2, sizeof(v));
+        v = rx_swap16(v);
+        memcpy(d + i * 2, &v, sizeof(v));
+    }
+}
+
+#define RX_SWAP_LAYOUT_MAX_SEGMENTS 8
+
+// a run of whole fields of at most 16 bytes; mask is the byte shuffle of the 16 bytes starting at offset, and keeps
+// the bytes past the run in place
+struct rx_swap_segment {
+    uint16_t offset;
+    uint16_t length;
+    uint8_t mask[16];
+};
+
+struct rx_swap_layout {
+    size_t size;
+    uint32_t segment_count;
+    struct rx_swap_segment segments[RX_SWAP_LAYOUT_MAX_SEGMENTS];
+};
+typedef struct rx_swap_layout rx_swap_layout_t;
+
+// builds the layout of a packed structure from the sizes of its fields, in order; fields are 1, 2, 4 or 8 bytes long;
+// returns false if a field size is invalid or if the structure needs more than RX_SWAP_LAYOUT_MAX_SEGMENTS segments
+static inline bool rx_swap_layout_init(rx_swap_layout_t* layout, const uint8_t* field_sizes, size_t field_count) {
+    memset(layout, 0, sizeof(rx_swap_layout_t));
+
+    struct rx_swap_segment* segment = NULL;
+    size_t offset = 0;
+    for (size_t f = 0; f < field_count; f++) {
+        size_t field_size = field_sizes[f];
+        if (field_size != 1 && field_size != 2 && field_size != 4 && field_size != 8)
+            return false;
+
+        if (!segment || segment->length + field_size > 16) {
+            if (layout->segment_count == RX_SWAP_LAYOUT_MAX_SEGMENTS)
+                return false;
+            segment = layout->segments + layout->segment_count++;
+            segment->offset = (uint16_t)offset;
+            for (uint8_t i = 0; i < 16; i++)
+                segment->mask[i] = i;
+        }
+
+        for (size_t i = 0; i < field_size; i++)
+            segment->mask[segment->length + i] = (uint8_t)(segment->length + field_size - 1 - i);
+        segment->length += (uint16_t)field_size;
+        offset += field_size;
+    }
+
+    layout->size = offset;
+    return true;
+}
+
+// swaps a field of size bytes in count records that are stride bytes apart
+static inline void rx_swap_field_strided(uint8_t* p, size_t count, size_t stride, size_t size) {
+    switch (size) {
+        case 2:
+            for (size_t i = 0; i < count; i++, p += stride) {
+                uint16_t v;
+                memcpy(&v, p, sizeof(v));
+                v = rx_swap16(v);
+                memcpy(p, &v, sizeof(v));
+            }
+            break;
+        case 4:
+            for (size_t i = 0; i < count; i++, p += stride) {
+                uint32_t v;
+                memcpy(&v, p, sizeof(v));
+                v = rx_swap32(v);
+                memcpy(p, &v, sizeof(v));
+            }
+            break;
+        case 8:
+            for (size_t i = 0; i < count; i++, p += stride) {
+                uint32_t v[2];
+                memcpy(v, p, sizeof(v));
+                uint32_t high = rx_swap32(v[0]);
+                v[0] = rx_swap32(v[1]);
+                v[1] = high;
+                memcpy(p, v, sizeof(v));
+            }
+            break;
+    }
+}
+
+#define RX_SWAP_RECORDS_BLOCK 64
+
+// swaps the fields of count consecutive packed structures in place
+static inline void rx_swap_records(void* data, size_t count, const rx_swap_layout_t* layout) {
+    uint8_t* p = (uint8_t*)data;
+    size_t size = layout->size;
+
+    // the records are swapped a block at a time, one segment at a time across the block, so that the loops have a
+    // constant mask or field size; whole 16-byte segments are shuffled, while shorter ones are swapped one field at a
+    // time, since a 16-byte store past the segment would write back bytes of the next segment
+    for (size_t block = 0; block < count; block += RX_SWAP_RECORDS_BLOCK, p += RX_SWAP_RECORDS_BLOCK * size) {
+        size_t n = (count - block < RX_SWAP_RECORDS_BLOCK) ? count - block : RX_SWAP_RECORDS_BLOCK;
+        for (uint32_t s = 0; s < layout->segment_count; s++) {
+            // a local copy, which the stores to the records cannot alias
+            struct rx_swap_segment segment = layout->segments[s];
+            uint8_t* q = p + segment.offset;
+
+#if defined(RX_BYTE_SWAP_SSSE3)
+            if (segment.length == 16) {
+                __m128i mask = _mm_loadu_si128((const __m128i*)segment.mask);
+                for (size_t i = 0; i < n; i++, q += size)
+                    _mm_storeu_si128((__m128i*)q, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)q), mask));
+                continue;
+            }
+#elif defined(RX_BYTE_SWAP_NEON) && defined(__aarch64__)
+            if (segment.length == 16) {
+                uint8x16_t mask = vld1q_u8(segment.mask);
+                for (size_t i = 0; i < n; i++, q += size)
+                    vst1q_u8(q, vqtbl1q_u8(vld1q_u8(q), mask));
+                continue;
+            }
+#endif
+
+            // a field starts at i and ends at mask[i]
+            for (uint16_t i = 0; i < segment.length; i = (uint16_t)(segment.mask[i] + 1))
+                rx_swap_field_strided(q + i, n, size, (size_t)(segment.mask[i] - i + 1));
+        }
+    }
+}
+
+__END_DECLS
+
+#endif // RX_BYTE_SWAP_H
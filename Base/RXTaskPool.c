@@ -0,0 +1,294 @@
+/*
+ *  RXTaskPool.c
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 30/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Base/RXTaskPool.h"
+
+
+struct rx_task {
+    rx_task_pool_t* pool;
+    rx_task_function_t function;
+    void* context;
+
+    // all of the following are protected by the pool's lock
+    uint32_t refcount;
+    uint32_t pending;           // unfinished prerequisites, plus 1 until the task is submitted
+    bool finished;
+
+    rx_task_t** dependents;     // each dependent holds a reference
+    uint32_t dependent_count;
+    uint32_t dependent_capacity;
+
+    rx_task_t* next;            // in the run queue, which holds a reference
+};
+
+struct rx_task_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t work_condition;      // signaled when a task is queued or the pool is stopping
+    pthread_cond_t progress_condition;  // broadcast when a task is queued or finishes
+
+    rx_task_t* head;
+    rx_task_t* tail;
+    bool stopping;
+
+    pthread_t* threads;
+    uint32_t thread_count;
+};
+
+#pragma mark -
+#pragma mark tasks
+
+// the following functions must be called with the pool's lock held
+
+static void release_locked(rx_task_t* task)
+{
+    if (--task->refcount)
+        return;
+    free(task->dependents);
+    free(task);
+}
+
+static void enqueue_locked(rx_task_pool_t* pool, rx_task_t* task)
+{
+    task->refcount++;
+    task->next = NULL;
+    if (pool->tail)
+        pool->tail->next = task;
+    else
+        pool->head = task;
+    pool->tail = task;
+
+    pthread_cond_signal(&pool->work_condition);
+    pthread_cond_broadcast(&pool->progress_condition);
+}
+
+static rx_task_t* dequeue_locked(rx_task_pool_t* pool)
+{
+    rx_task_t* task = pool->head;
+    if (!task)
+        return NULL;
+    pool->head = task->next;
+    if (!pool->head)
+        pool->tail = NULL;
+    return task;
+}
+
+// runs a dequeued task with the lock held on entry and on exit
+static void run_locked(rx_task_pool_t* pool, rx_task_t* task)
+{
+    pthread_mutex_unlock(&pool->lock);
+    if (task->function)
+        task->function(task->context);
+    pthread_mutex_lock(&pool->lock);
+
+    task->finished = true;
+
+    for (uint32_t i = 0; i < task->dependent_count; i++)
+    {
+        rx_task_t* dependent = task->dependents[i];
+        if (--dependent->pending == 0)
+            enqueue_locked(pool, dependent);
+        release_locked(dependent);
+    }
+    task->dependent_count = 0;
+
+    pthread_cond_broadcast(&pool->progress_condition);
+
+    // the run queue's reference
+    release_locked(task);
+}
+
+rx_task_t* rx_task_create(rx_task_pool_t* pool, rx_task_function_t function, void* context)
+{
+    rx_task_t* task = (rx_task_t*)calloc(1, sizeof(rx_task_t));
+    if (!task)
+        return NULL;
+    task->pool = pool;
+    task->function = function;
+    task->context = context;
+    task->refcount = 1;
+    task->pending = 1;
+    return task;
+}
+
+void rx_task_retain(rx_task_t* task)
+{
+    pthread_mutex_lock(&task->pool->lock);
+    task->refcount++;
+    pthread_mutex_unlock(&task->pool->lock);
+}
+
+void rx_task_release(rx_task_t* task)
+{
+    if (!task)
+        return;
+    rx_task_pool_t* pool = task->pool;
+    pthread_mutex_lock(&pool->lock);
+    release_locked(task);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void rx_task_add_prerequisite(rx_task_t* task, rx_task_t* prerequisite)
+{
+    rx_task_pool_t* pool = task->pool;
+    pthread_mutex_lock(&pool->lock);
+
+    if (!prerequisite->finished && task->pending > 0)
+    {
+        if (prerequisite->dependent_count == prerequisite->dependent_capacity)
+        {
+            uint32_t capacity = (prerequisite->dependent_capacity) ? prerequisite->dependent_capacity * 2 : 4;
+            rx_task_t** dependents = (rx_task_t**)realloc(prerequisite->dependents, capacity * sizeof(rx_task_t*));
+            if (!dependents)
+                abort();
+            prerequisite->dependents = dependents;
+            prerequisite->dependent_capacity = capacity;
+        }
+
+        task->refcount++;
+        task->pending++;
+        prerequisite->dependents[prerequisite->dependent_count++] = task;
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void rx_task_submit(rx_task_t* task)
+{
+    rx_task_pool_t* pool = task->pool;
+    pthread_mutex_lock(&pool->lock);
+    if (--task->pending == 0)
+        enqueue_locked(pool, task);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void rx_task_wait(rx_task_t* task)
+{
+    rx_task_pool_t* pool = task->pool;
+    pthread_mutex_lock(&pool->lock);
+    while (!task->finished)
+    {
+        rx_task_t* queued = dequeue_locked(pool);
+        if (queued)
+            run_locked(pool, queued);
+        else
+            pthread_cond_wait(&pool->progress_condition, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+bool rx_task_is_finished(rx_task_t* task)
+{
+    pthread_mutex_lock(&task->pool->lock);
+    bool finished = task->finished;
+    pthread_mutex_unlock(&task->pool->lock);
+    return finished;
+}
+
+#pragma mark -
+#pragma mark pools
+
+static void* worker_thread(void* context)
+{
+    rx_task_pool_t* pool = (rx_task_pool_t*)context;
+#if defined(__APPLE__)
+    pthread_setname_np("task pool worker");
+#endif
+
+    pthread_mutex_lock(&pool->lock);
+    while (1)
+    {
+        rx_task_t* task = dequeue_locked(pool);
+        if (task)
+        {
+            run_locked(pool, task);
+            continue;
+        }
+        // a worker that is still running a task runs the tasks it makes ready
+        if (pool->stopping)
+            break;
+        pthread_cond_wait(&pool->work_condition, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+rx_task_pool_t* rx_task_pool_create(uint32_t thread_count)
+{
+    rx_task_pool_t* pool = (rx_task_pool_t*)calloc(1, sizeof(rx_task_pool_t));
+    if (!pool)
+        return NULL;
+    pool->threads = (pthread_t*)calloc((thread_count) ? thread_count : 1, sizeof(pthread_t));
+    if (!pool->threads)
+    {
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_condition, NULL);
+    pthread_cond_init(&pool->progress_condition, NULL);
+
+    for (; pool->thread_count < thread_count; pool->thread_count++)
+    {
+        if (pthread_create(&pool->threads[pool->thread_count], NULL, worker_thread, pool) != 0)
+            break;
+    }
+    if (pool->thread_count == 0 && thread_count > 0)
+    {
+        rx_task_pool_destroy(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void rx_task_pool_destroy(rx_task_pool_t* pool)
+{
+    // every queued task runs, as well as the tasks they make ready; tasks waiting on prerequisites that are never
+    // submitted never run
+    pthread_mutex_lock(&pool->lock);
+    while (pool->head)
+        run_locked(pool, dequeue_locked(pool));
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work_condition);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (uint32_t i = 0; i < pool->thread_count; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->progress_condition);
+    pthread_cond_destroy(&pool->work_condition);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
+
+static rx_task_pool_t* shared_pool;
+static pthread_once_t shared_pool_once = PTHREAD_ONCE_INIT;
+
+static void create_shared_pool(void)
+{
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    if (processors < 2)
+        processors = 2;
+    else if (processors > 16)
+        processors = 16;
+    shared_pool = rx_task_pool_create((uint32_t)processors);
+}
+
+rx_task_pool_t* rx_task_pool_shared(void)
+{
+    pthread_once(&shared_pool_once, create_shared_pool);
+    return shared_pool;
+}
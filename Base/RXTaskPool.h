@@ -0,0 +1,64 @@
+/*
+ *  RXTaskPool.h
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 30/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#if !defined(RX_TASK_POOL_H)
+#define RX_TASK_POOL_H
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// A pool of worker threads running small tasks that form a dependency graph. A task runs once it has been submitted
+// and all of its prerequisites have finished. Prerequisites can be added to a task until it is ready to run, including
+// by one of its running prerequisites, which lets a task fan out into subtasks that are only known once it runs (such
+// as one task per record of a list resource) and that a join task waits for.
+//
+// Threads that wait for a task run queued tasks in the meantime, so waiting never deadlocks the pool, even from a
+// worker thread.
+//
+
+__BEGIN_DECLS
+
+typedef struct rx_task_pool rx_task_pool_t;
+typedef struct rx_task rx_task_t;
+
+typedef void (*rx_task_function_t)(void* context);
+
+// creates a pool with thread_count worker threads; returns NULL on failure
+rx_task_pool_t* rx_task_pool_create(uint32_t thread_count);
+
+// runs every queued task and the tasks they make ready, then stops the worker threads
+void rx_task_pool_destroy(rx_task_pool_t* pool);
+
+// a process-wide pool with a worker thread per processor, created on first use
+rx_task_pool_t* rx_task_pool_shared(void);
+
+// creates a task, with one reference owned by the caller; function may be NULL for tasks that only join their
+// prerequisites
+rx_task_t* rx_task_create(rx_task_pool_t* pool, rx_task_function_t function, void* context);
+
+void rx_task_retain(rx_task_t* task);
+void rx_task_release(rx_task_t* task);
+
+// makes task wait for prerequisite; task must not be ready to run yet, which is the case until it has been submitted
+// and, after that, for as long as one of its prerequisites is running
+void rx_task_add_prerequisite(rx_task_t* task, rx_task_t* prerequisite);
+
+// lets the task run once its prerequisites have finished; a task is submitted exactly once
+void rx_task_submit(rx_task_t* task);
+
+// waits for a submitted task to finish, running queued tasks in the meantime
+void rx_task_wait(rx_task_t* task);
+
+bool rx_task_is_finished(rx_task_t* task);
+
+__END_DECLS
+
+#endif // RX_TASK_POOL_H
@@ -10,10 +10,14 @@
 
 #import "Debug/RXDebugWindowController.h"
 
+#import "Base/RXThreadUtilities.h"
+#import "Base/RXTiming.h"
+
 #import "Engine/RXWorldProtocol.h"
 #import "Engine/RXScriptCompiler.h"
 #import "Engine/RXScriptCommandAliases.h"
 #import "Engine/RXScriptDecoding.h"
+#import "Engine/RXScriptProfiler.h"
 
 #import "States/RXCardState.h"
 
@@ -294,17 +298,16 @@ static PyMethodDef rivenx_methods[] = {
 
 - (void)cmd_recompile:(NSArray*)args {
     RXCard* card = [[(RXCardState*)[g_world cardRenderer] scriptEngine] card];
-    NSDictionary* scripts = [card scripts];
+    const rx_script_t* scripts = [card scripts];
     
-    NSEnumerator* iter_k = [scripts keyEnumerator];
-    NSString* k;
-    while ((k = [iter_k nextObject])) {
-        if ([[scripts objectForKey:k] count] == 0)
+    for (uint16_t event = 0; event < RX_SCRIPT_EVENT_TYPE_COUNT; event++) {
+        NSDictionary* program = rx_riven_program_descriptor(scripts, event, 0);
+        if (!program)
             continue;
         
-        [self print:[NSString stringWithFormat:@"recompiling %@", k]];
+        [self print:[NSString stringWithFormat:@"recompiling %s", rx_script_event_name(event)]];
                 
-        RXScriptCompiler* comp = [[RXScriptCompiler alloc] initWithCompiledScript:[[scripts objectForKey:k] objectAtIndex:0]];
+        RXScriptCompiler* comp = [[RXScriptCompiler alloc] initWithCompiledScript:program];
         NSMutableArray* decompiled_script = [comp decompiledScript];
         
         [comp setDecompiledScript:decompiled_script];
@@ -312,13 +315,201 @@ static PyMethodDef rivenx_methods[] = {
         
         [comp release];
         
-        if (![compiled_script isEqual:[[scripts objectForKey:k] objectAtIndex:0]]) {
+        NSData* original_program = [program objectForKey:RXScriptProgramKey];
+        if (![[compiled_script objectForKey:RXScriptProgramKey] isEqualToData:original_program]) {
             [self print:@"re-compiled script not equal to origial script!"];
-            [[[[scripts objectForKey:k] objectAtIndex:0] objectForKey:RXScriptProgramKey] writeToFile:@"original.rxscript" options:0 error:NULL];
+            [original_program writeToFile:@"original.rxscript" options:0 error:NULL];
             [[compiled_script objectForKey:RXScriptProgramKey] writeToFile:@"recompiled.rxscript" options:0 error:NULL];
             break;
         }
     }
 }
 
+- (void)cmd_capture_scripts:(NSArray*)arguments {
+    // writes the current card's CARD and HSPT resources to the current directory, for the headless script driver
+    RXCardDescriptor* descriptor = [[[(RXCardState*)[g_world cardRenderer] scriptEngine] card] descriptor];
+    RXStack* stack = [descriptor parent];
+    
+    NSString* base = [NSString stringWithFormat:@"%@-%hu", [stack key], [descriptor ID]];
+    NSData* hspt_data = [stack dataWithResourceType:@"HSPT" ID:[descriptor ID]];
+    
+    [[descriptor data] writeToFile:[base stringByAppendingPathExtension:@"card"] options:0 error:NULL];
+    if (hspt_data)
+        [hspt_data writeToFile:[base stringByAppendingPathExtension:@"hspt"] options:0 error:NULL];
+    
+    [self print:[NSString stringWithFormat:@"captured the scripts of %@ into %@", descriptor,
+        [[[NSFileManager defaultManager] currentDirectoryPath] stringByAppendingPathComponent:base]]];
+}
+
+- (void)cmd_prewarm_script_cache:(NSArray*)arguments {
+    // runs the script loading pipeline of every card of every stack, filling the script cache, then loads each card's
+    // scripts again from the cache to report what the cache saves per card load
+    NSDictionary* stack_descriptors = [NSDictionary dictionaryWithContentsOfFile:[[NSBundle mainBundle] pathForResource:@"Stacks" ofType:@"plist"]];
+    NSArray* stack_keys = [[stack_descriptors allKeys] sortedArrayUsingSelector:@selector(compare:)];
+    BOOL verbose = [arguments containsObject:@"-v"];
+    
+    uint32_t total_cards = 0;
+    double total_pipeline_time = 0.0;
+    double total_cached_time = 0.0;
+    
+    for (NSString* stack_key in stack_keys) {
+        RXStack* stack = [g_world loadStackWithKey:stack_key];
+        if (!stack) {
+            [self print:[NSString stringWithFormat:@"%@: could not load the stack", stack_key]];
+            continue;
+        }
+        
+        uint32_t cards = 0;
+        double pipeline_time = 0.0;
+        double cached_time = 0.0;
+        
+        NSUInteger card_count = [stack cardCount];
+        for (NSUInteger card_id = 0; card_id < card_count && card_id <= UINT16_MAX; card_id++) {
+            NSAutoreleasePool* p = [NSAutoreleasePool new];
+            
+            RXCardDescriptor* descriptor = [RXCardDescriptor descriptorWithStack:stack ID:(uint16_t)card_id];
+            if (!descriptor) {
+                [p release];
+                continue;
+            }
+            
+            RXCard* card = [[RXCard alloc] initWithCardDescriptor:descriptor];
+            uint64_t start = RXTimingNow();
+            [card loadScriptsRefreshingCache:YES];
+            double card_pipeline_time = RXTimingTimestampDelta(RXTimingNow(), start);
+            [card release];
+            
+            card = [[RXCard alloc] initWithCardDescriptor:descriptor];
+            start = RXTimingNow();
+            [card loadScriptsRefreshingCache:NO];
+            double card_cached_time = RXTimingTimestampDelta(RXTimingNow(), start);
+            [card release];
+            
+            if (verbose)
+                [self print:[NSString stringWithFormat:@"%@ %4lu: %8.1f us -> %8.1f us (%.1f us saved)", stack_key, (unsigned long)card_id,
+                    card_pipeline_time * 1.0e6, card_cached_time * 1.0e6, (card_pipeline_time - card_cached_time) * 1.0e6]];
+            
+            cards++;
+            pipeline_time += card_pipeline_time;
+            cached_time += card_cached_time;
+            [p release];
+        }
+        
+        if (cards)
+            [self print:[NSString stringWithFormat:@"%@: %u cards, %.1f us per card load without the cache, %.1f us with it (%.1f us saved)",
+                stack_key, cards, pipeline_time * 1.0e6 / cards, cached_time * 1.0e6 / cards, (pipeline_time - cached_time) * 1.0e6 / cards]];
+        
+        total_cards += cards;
+        total_pipeline_time += pipeline_time;
+        total_cached_time += cached_time;
+    }
+    
+    if (total_cards)
+        [self print:[NSString stringWithFormat:@"script cache warmed for %u cards; %.1f us saved per card load on average",
+            total_cards, (total_pipeline_time - total_cached_time) * 1.0e6 / total_cards]];
+}
+
+static double rx_latency_percentile(NSArray* sorted_latencies, uint32_t percentile) {
+    NSUInteger count = [sorted_latencies count];
+    if (count == 0)
+        return 0.0;
+    NSUInteger index = MIN(count - 1, count * percentile / 100);
+    return [[sorted_latencies objectAtIndex:index] doubleValue];
+}
+
+- (void)_cardWalkThread:(NSArray*)arguments {
+    NSAutoreleasePool* p = [NSAutoreleasePool new];
+    RXSetThreadName("card walk");
+    
+    RXCardState* renderer = (RXCardState*)[g_world cardRenderer];
+    RXCardPreloader* preloader = [renderer cardPreloader];
+    uint32_t steps = ([arguments count] > 0) ? (uint32_t)[[arguments objectAtIndex:0] intValue] : 50;
+    useconds_t dwell = (useconds_t)((([arguments count] > 1) ? [[arguments objectAtIndex:1] intValue] : 500) * 1000);
+    
+    BOOL preloading = RXEngineGetBool(@"rendering.card_preloading");
+    RXSimpleCardDescriptor* start = [[[g_world gameState] currentCard] retain];
+    NSMutableArray* path = [NSMutableArray array];
+    NSMutableString* report = [NSMutableString string];
+    
+    // the first pass walks the link graph from the current card without preloading and records its path; the second
+    // pass walks the same path again with preloading
+    for (int pass = 0; pass < 2; pass++) {
+        [g_world setValue:[NSNumber numberWithBool:(pass == 1)] forEngineVariable:@"rendering.card_preloading"];
+        [renderer setActiveCardWithSimpleDescriptor:start waitUntilDone:YES];
+        usleep(dwell);
+        [preloader resetCardSwitchStatistics];
+        
+        // cards from the first pass would otherwise come back from the card cache
+        [[renderer cardCache] removeAllCards];
+        [[renderer cardCache] resetStatistics];
+        
+        uint32_t seed = 1;
+        for (uint32_t step = 0; step < steps; step++) {
+            RXSimpleCardDescriptor* next = nil;
+            if (pass == 0) {
+                RXSimpleCardDescriptor* current = [[g_world gameState] currentCard];
+                NSData* links = [preloader linksOfCardWithSimpleDescriptor:current];
+                uint32_t count = (uint32_t)([links length] / sizeof(rx_card_link_t));
+                if (count == 0)
+                    break;
+                
+                seed = seed * 1103515245 + 12345;
+                const rx_card_link_t* link = (const rx_card_link_t*)[links bytes] + (seed >> 16) % count;
+                next = [[[RXSimpleCardDescriptor alloc] initWithStackKey:current->stackKey ID:link->card_id] autorelease];
+                [path addObject:next];
+            } else if (step < [path count])
+                next = [path objectAtIndex:step];
+            else
+                break;
+            
+            [renderer setActiveCardWithSimpleDescriptor:next waitUntilDone:YES];
+            usleep(dwell);
+        }
+        
+        NSArray* latencies = [[preloader cardSwitchLatencies] sortedArrayUsingSelector:@selector(compare:)];
+        [report appendFormat:@"%@ preloading: %lu card switches, p50 %.2f ms, p99 %.2f ms, %u preloaded\n",
+            (pass == 0) ? @"without" : @"with", (unsigned long)[latencies count],
+            rx_latency_percentile(latencies, 50) * 1.0e3, rx_latency_percentile(latencies, 99) * 1.0e3, [preloader hitCount]];
+    }
+    
+    [g_world setValue:[NSNumber numberWithBool:preloading] forEngineVariable:@"rendering.card_preloading"];
+    [start release];
+    
+    [self performSelectorOnMainThread:@selector(pythonOut:) withObject:report waitUntilDone:NO];
+    [p release];
+}
+
+- (void)cmd_walk:(NSArray*)arguments {
+    // walks the link graph from the current card, switching cards as fast as the dwell time allows, without and then
+    // with card preloading, and reports the card switch latencies of both walks
+    [self print:@"walking the link graph; usage: walk [steps] [dwell ms]"];
+    [NSThread detachNewThreadSelector:@selector(_cardWalkThread:) toTarget:self withObject:arguments];
+}
+
+- (void)cmd_profile:(NSArray*)arguments {
+    NSString* action = ([arguments count] > 0) ? [arguments objectAtIndex:0] : @"report";
+    
+    if ([action isEqualToString:@"start"]) {
+        rx_script_profiler_set_enabled(true);
+        [self print:@"script profiling started"];
+    } else if ([action isEqualToString:@"stop"]) {
+        rx_script_profiler_set_enabled(false);
+        rx_script_profiler_collect();
+        [self print:@"script profiling stopped"];
+    } else if ([action isEqualToString:@"reset"]) {
+        rx_script_profiler_reset();
+    } else if ([action isEqualToString:@"report"]) {
+        char* report = rx_script_profiler_copy_report();
+        [self print:[NSString stringWithUTF8String:report]];
+        free(report);
+    } else if ([action isEqualToString:@"trace"]) {
+        NSString* path = ([arguments count] > 1) ? [arguments objectAtIndex:1] : @"rxscript_trace.json";
+        if (rx_script_profiler_write_chrome_trace([path fileSystemRepresentation]))
+            [self print:[NSString stringWithFormat:@"wrote the script trace to %@", path]];
+        else
+            [self print:[NSString stringWithFormat:@"failed to write the script trace to %@", path]];
+    } else
+        [self print:@"usage: profile start|stop|reset|report|trace [path]"];
+}
+
 @end
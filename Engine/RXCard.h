@@ -9,20 +9,31 @@
 #import <mach/semaphore.h>
 
 #import "Base/RXBase.h"
+#import "Base/RXTaskPool.h"
 
 #import "Engine/RXCardDescriptor.h"
 #import "Engine/RXCoreStructures.h"
 #import "Engine/RXHotspot.h"
 #import "Engine/RXCardProtocols.h"
+#import "Engine/RXScriptArena.h"
 
 
 @interface RXCard : NSObject {
     RXCardDescriptor* _descriptor;
     RXStack* _parent;
     BOOL _loaded;
+    volatile int64_t _footprint;
+    
+    // resource loading tasks (see -load)
+    OSSpinLock _load_lock;
+    rx_task_t* _pictures_task;
+    rx_task_t* _sfxes_task;
+    rx_task_t* _ready_task;
+    rx_task_t* _loaded_task;
+    NSException* _load_exception;
     
     // scripts
-    NSDictionary* _card_scripts;
+    rx_script_t* _card_scripts;
     
     // hotspots
     NSMutableArray* _hotspots;
@@ -38,11 +49,13 @@
     // movies
     NSMutableArray* _movies;
     uint16_t* _mlstCodes;
+    uint16_t _mlst_count;
     
     // sound groups
     NSMutableArray* _soundGroups;
     
     // special effects
+    void* _flst_data;
     uint16_t _flstCount;
     rx_card_sfxe* _sfxes;
 }
@@ -53,9 +66,25 @@
 - (RXStack*)parent;
 - (NSString*)name;
 
+// loads the card's resources on the shared task pool; returns once the scripts, hotspots and pictures are loaded, which
+// is all that is needed to open the card, while the movies, sounds and special effects finish loading in the background
+// (their accessors wait for them)
 - (void)load;
 
-- (NSDictionary*)scripts;
+// loads the card and hotspot scripts only, running the script workarounds again and replacing the script cache entries
+// if refresh is YES; used to fill the script cache
+- (void)loadScriptsRefreshingCache:(BOOL)refresh;
+
+// bytes of resource data and objects (scripts, lists, special effects, hotspots and movie proxies) the card keeps once
+// it is loaded
+- (size_t)memoryFootprint;
+
+// puts a loaded card that has been opened back in the state it was loaded in: restores the hotspot frames, events and
+// enabled states, drops the movies the scripts synthesized and unloads the movies; MUST RUN ON THE SCRIPT THREAD, while
+// the card is not the active card
+- (void)reset;
+
+- (const rx_script_t*)scripts;
 - (NSArray*)hotspots;
 - (NSMapTable*)hotspotsIDMap;
 - (NSMapTable*)hotspotsNameMap;
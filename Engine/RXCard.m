@@ -9,19 +9,62 @@
 #import <mach/task.h>
 #import <mach/thread_act.h>
 #import <mach/thread_policy.h>
+#import <objc/runtime.h>
 
 #import "Engine/RXCard.h"
 
+#import "Engine/RXCardResources.h"
+#import "Engine/RXWaterProgram.h"
 #import "Engine/RXCursors.h"
 #import "Engine/RXScriptDecoding.h"
 #import "Engine/RXScriptCommandAliases.h"
 #import "Engine/RXScriptCompiler.h"
+#import "Engine/RXScriptCache.h"
+#import "Engine/RXWorld.h"
 
 #import "Rendering/Graphics/RXMovieProxy.h"
 
 #import "NSArray+RXArrayAdditions.h"
 
 
+// a load job calls one of the card's loading methods on the task pool; jobs with an index load one record of a list
+// resource, the others take no argument
+struct rx_card_load_job {
+    RXCard* card;
+    SEL selector;
+    NSUInteger index;
+};
+
+@interface RXCard ()
+- (void)_recordLoadException:(NSException*)e;
+- (void)_submitLoadJob:(SEL)selector index:(NSUInteger)index joinedBy:(rx_task_t*)join;
+- (void)_waitUntilLoaded;
+@end
+
+static void rx_card_run_load_job(void* context)
+{
+    // WARNING: RUNS ON A TASK POOL THREAD
+    struct rx_card_load_job* job = (struct rx_card_load_job*)context;
+    NSAutoreleasePool* p = [NSAutoreleasePool new];
+    
+    @try
+    {
+        IMP imp = [job->card methodForSelector:job->selector];
+        if (job->index == NSNotFound)
+            ((void (*)(id, SEL))imp)(job->card, job->selector);
+        else
+            ((void (*)(id, SEL, NSUInteger))imp)(job->card, job->selector, job->index);
+    }
+    @catch (NSException* e)
+    {
+        // exceptions cannot cross the task pool; the exception is raised again by whoever waits for the card
+        [job->card _recordLoadException:e];
+    }
+    
+    [p release];
+    free(job);
+}
+
 @implementation RXCard
 
 + (BOOL)accessInstanceVariablesDirectly
@@ -60,6 +103,8 @@
     // retain our parent stack, since RXCardDescriptor only keeps a weak reference to it
     _parent = [[cardDescriptor parent] retain];
     
+    _load_lock = OS_SPINLOCK_INIT;
+    
 //    NSData* card_data = [_descriptor data];
 //    
 //    uint16_t zipCard = CFSwapInt16BigToHost(*(const uint16_t *)([card_data bytes] + 2));
@@ -77,6 +122,15 @@
     // stop receiving notifications
     [[NSNotificationCenter defaultCenter] removeObserver:self];
     
+    // the load jobs use the card until they are done
+    if (_loaded_task)
+        rx_task_wait(_loaded_task);
+    rx_task_release(_pictures_task);
+    rx_task_release(_sfxes_task);
+    rx_task_release(_ready_task);
+    rx_task_release(_loaded_task);
+    [_load_exception release];
+    
     // movies
     [_movies release];
     if (_mlstCodes)
@@ -100,14 +154,18 @@
     if (_sfxes) {
         for (uint16_t i = 0; i < _flstCount; i++) {
             free(_sfxes[i].record);
+            rx_water_program_free(_sfxes[i].water);
         }
         free(_sfxes);
     }
+    if (_flst_data)
+        free(_flst_data);
     
     // misc resources
     if (_blstData)
         free(_blstData);
-    [_card_scripts release];
+    if (_card_scripts)
+        rx_script_free(_card_scripts);
     
     [_parent release];
     [_descriptor release];
@@ -128,19 +186,58 @@
 #pragma mark -
 #pragma mark loading
 
-- (void)_loadScripts
+// script cache entries live in the world cache, in a directory per stack; returns nil if there is no world cache
+- (NSString*)_scriptCachePathWithExtension:(NSString*)extension
+{
+    NSString* cache_base = [[(RXWorld*)g_world worldCacheBase] path];
+    if (!cache_base)
+        return nil;
+    
+    NSString* directory = [[cache_base stringByAppendingPathComponent:@"Scripts"] stringByAppendingPathComponent:[_parent key]];
+    return [directory stringByAppendingPathComponent:[NSString stringWithFormat:@"%hu.%@", [_descriptor ID], extension]];
+}
+
+- (void)_writeScriptCache:(NSString*)path hash:(uint64_t)hash count:(uint32_t)count scripts:(rx_script_t* const*)scripts
+            scriptLengths:(const uint32_t*)script_lengths
+{
+    if (!path)
+        return;
+    
+    [[NSFileManager defaultManager] createDirectoryAtPath:[path stringByDeletingLastPathComponent]
+                              withIntermediateDirectories:YES
+                                               attributes:nil
+                                                    error:NULL];
+    if (!rx_script_cache_write([path fileSystemRepresentation], hash, count, (const rx_script_t* const*)scripts, script_lengths))
+        RXOLog2(kRXLoggingEngine, kRXLoggingLevelError, @"failed to write script cache entry %@", path);
+}
+
+- (void)_loadScriptsRefreshingCache:(BOOL)refresh
 {
     NSData* card_data = [_descriptor data];
     release_assert([card_data length] >= 6);
     
+    if (_card_scripts)
+        rx_script_free(_card_scripts);
+    _card_scripts = NULL;
+    
+    // the cache entry is keyed by the whole CARD resource
+    uint64_t hash = rx_script_cache_hash([card_data bytes], [card_data length]);
+    NSString* cache_path = [self _scriptCachePathWithExtension:@"card"];
+    uint32_t script_length = 0;
+    if (!refresh && cache_path && rx_script_cache_read([cache_path fileSystemRepresentation], hash, 1, &_card_scripts, &script_length) == 1)
+        return;
+    
     // card events
-    _card_scripts = rx_decode_riven_script(BUFFER_OFFSET([card_data bytes], 4), NULL);
+    _card_scripts = rx_decode_riven_script(BUFFER_OFFSET([card_data bytes], 4), [card_data length] - 4, &script_length);
+    
+    // NOTE: changes to the workarounds below and in _loadHotspotsRefreshingCache: must bump RX_SCRIPT_CACHE_VERSION,
+    //       since the cache keeps the patched scripts
     
     // WORKAROUND: there is a legitimate bug in the CD edition's tspit RMAP 28314 start rendering program;
     // it executes activate SLST record 2 command after the introduction sequence, which is the mute SLST; patch it up to activate SLST 1
     if ([_descriptor isCardWithRMAP:28314 stackName:@"tspit"])
     {
-        NSDictionary* start_rendering_program = [[_card_scripts objectForKey:RXStartRenderingScriptKey] objectAtIndexIfAny:0];
+        NSDictionary* start_rendering_program = rx_riven_program_descriptor(_card_scripts, kScriptTypeStartRendering, 0);
         if (start_rendering_program)
         {
             RXScriptCompiler* comp = [[RXScriptCompiler alloc] initWithCompiledScript:start_rendering_program];
@@ -165,12 +262,7 @@
             }
             
             [comp setDecompiledScript:dp];
-            
-            NSMutableDictionary* mutable_script = [_card_scripts mutableCopy];
-            [mutable_script setObject:[NSArray arrayWithObject:[comp compiledScript]] forKey:RXStartRenderingScriptKey];
-            
-            [_card_scripts release];
-            _card_scripts = mutable_script;
+            _card_scripts = rx_replace_riven_program(_card_scripts, kScriptTypeStartRendering, 0, [comp compiledScript]);
             
             [comp release];
         }
@@ -179,7 +271,7 @@
     // WORKAROUND: patch pspit 29's start rendering script to remove the instruction that sets atrapbook to 0
     else if ([_descriptor isCardWithRMAP:2526 stackName:@"pspit"])
     {
-        NSDictionary* start_rendering_program = [[_card_scripts objectForKey:RXStartRenderingScriptKey] objectAtIndexIfAny:0];
+        NSDictionary* start_rendering_program = rx_riven_program_descriptor(_card_scripts, kScriptTypeStartRendering, 0);
         if (start_rendering_program)
         {
             RXScriptCompiler* comp = [[RXScriptCompiler alloc] initWithCompiledScript:start_rendering_program];
@@ -225,16 +317,17 @@
             }
             
             [comp setDecompiledScript:dp];
-            
-            NSMutableDictionary* mutable_script = [_card_scripts mutableCopy];
-            [mutable_script setObject:[NSArray arrayWithObject:[comp compiledScript]] forKey:RXStartRenderingScriptKey];
-            
-            [_card_scripts release];
-            _card_scripts = mutable_script;
+            _card_scripts = rx_replace_riven_program(_card_scripts, kScriptTypeStartRendering, 0, [comp compiledScript]);
             
             [comp release];
         }
     }
+    
+    // pre-link the programs now that the workarounds have been applied
+    _card_scripts = rx_script_link(_card_scripts);
+    release_assert(_card_scripts);
+    
+    [self _writeScriptCache:cache_path hash:hash count:1 scripts:&_card_scripts scriptLengths:&script_length];
 }
 
 - (void)_loadPictures
@@ -260,53 +353,54 @@
                                        reason:@"Could not read the card's corresponding PLST ressource."
                                      userInfo:[NSDictionary dictionaryWithObjectsAndKeys:error, NSUnderlyingErrorKey, nil]];
     
-    // how many pictures do we have?
-    _picture_count = CFSwapInt16BigToHost(*(uint16_t*)_plst_data);
-    release_assert([fh length] >= sizeof(uint16_t) + (_picture_count * sizeof(struct rx_plst_record)));
-    struct rx_plst_record* picture_records = (struct rx_plst_record*)BUFFER_OFFSET(_plst_data, sizeof(uint16_t));
+    OSAtomicAdd64Barrier((int64_t)list_data_size, &_footprint);
+    
+    // how many pictures do we have? (this also swaps the records to host byte order)
+    uint16_t picture_count;
+    BOOL swapped = rx_card_swap_plst(_plst_data, list_data_size, &picture_count);
+    release_assert(swapped);
+    _picture_count = picture_count;
+    
+    // each picture record needs the descriptor of its bitmap, which is another archive read; they are read in parallel
+    for (list_index = 0; list_index < picture_count; ++list_index)
+        [self _submitLoadJob:@selector(_loadPictureRecord:) index:list_index joinedBy:_pictures_task];
+}
+
+- (void)_loadPictureRecord:(NSUInteger)list_index
+{
+    NSError* error;
+    struct rx_plst_record* picture_record = [self pictureRecords] + list_index;
+    
+    MHKArchive* archive = [[_parent fileWithResourceType:@"tBMP" ID:picture_record->bitmap_id] archive];
+    NSDictionary* picture_descriptor = [archive bitmapDescriptorWithID:picture_record->bitmap_id error:&error];
+    if (!picture_descriptor)
+        @throw [NSException exceptionWithName:@"RXPictureLoadException"
+                                       reason:@"Could not get a picture resource's picture descriptor."
+                                     userInfo:[NSDictionary dictionaryWithObjectsAndKeys:error, NSUnderlyingErrorKey, nil]];
+    
+    GLsizei width = [[picture_descriptor objectForKey:@"Width"] intValue];
+    GLsizei height = [[picture_descriptor objectForKey:@"Height"] intValue];
     
-    // process the picture records
-    for (list_index = 0; list_index < _picture_count; ++list_index)
-    {
-        struct rx_plst_record* picture_record = picture_records + list_index;
-        
-#if defined(__LITTLE_ENDIAN__)
-        picture_record->index = CFSwapInt16(picture_record->index);
-        picture_record->bitmap_id = CFSwapInt16(picture_record->bitmap_id);
-        picture_record->rect = rx_swap_core_rect(picture_record->rect);
-#endif
-        
-        MHKArchive* archive = [[_parent fileWithResourceType:@"tBMP" ID:picture_record->bitmap_id] archive];
-        NSDictionary* picture_descriptor = [archive bitmapDescriptorWithID:picture_record->bitmap_id error:&error];
-        if (!picture_descriptor)
-            @throw [NSException exceptionWithName:@"RXPictureLoadException"
-                                           reason:@"Could not get a picture resource's picture descriptor."
-                                         userInfo:[NSDictionary dictionaryWithObjectsAndKeys:error, NSUnderlyingErrorKey, nil]];
-        
-        GLsizei width = [[picture_descriptor objectForKey:@"Width"] intValue];
-        GLsizei height = [[picture_descriptor objectForKey:@"Height"] intValue];
-        
 #if defined(DEBUG) && DEBUG > 1
-        NSRect original_rect = RXMakeCompositeDisplayRectFromCoreRect(picture_record->rect);
-        if (width != original_rect.size.width || height != original_rect.size.height)
-            RXOLog2(kRXLoggingEngine, kRXLoggingLevelDebug,
-                @"PLST record %hu has display rect size different than tBMP resource %hu: %dx%d vs. %dx%d",
-                picture_record->index,
-                picture_record->bitmap_id,
-                original_rect.size.width,
-                original_rect.size.height,
-                picture_record->rect.right - picture_record->rect.left,
-                picture_record->rect.bottom - picture_record->rect.top);
+    NSRect original_rect = RXMakeCompositeDisplayRectFromCoreRect(picture_record->rect);
+    if (width != original_rect.size.width || height != original_rect.size.height)
+        RXOLog2(kRXLoggingEngine, kRXLoggingLevelDebug,
+            @"PLST record %hu has display rect size different than tBMP resource %hu: %dx%d vs. %dx%d",
+            picture_record->index,
+            picture_record->bitmap_id,
+            original_rect.size.width,
+            original_rect.size.height,
+            picture_record->rect.right - picture_record->rect.left,
+            picture_record->rect.bottom - picture_record->rect.top);
 #endif
-        
-        // adjust the display rect to anchor the picture to the top-left corner
-        // while clipping the picture to its size (and never scaling the
-        // picture either)
-        if (picture_record->rect.right - picture_record->rect.left > width)
-            picture_record->rect.right = picture_record->rect.left + width;
-        if (picture_record->rect.bottom - picture_record->rect.top > height)
-            picture_record->rect.bottom = picture_record->rect.top + height;
-    }
+    
+    // adjust the display rect to anchor the picture to the top-left corner
+    // while clipping the picture to its size (and never scaling the
+    // picture either)
+    if (picture_record->rect.right - picture_record->rect.left > width)
+        picture_record->rect.right = picture_record->rect.left + width;
+    if (picture_record->rect.bottom - picture_record->rect.top > height)
+        picture_record->rect.bottom = picture_record->rect.top + height;
 }
 
 - (void)_loadMovies
@@ -333,36 +427,21 @@
                                        reason:@"Could not read the card's corresponding MLST ressource."
                                      userInfo:[NSDictionary dictionaryWithObjectsAndKeys:error, NSUnderlyingErrorKey, nil]];
     
-    // how many movies do we have?
-    uint16_t movieCount = CFSwapInt16BigToHost(*(uint16_t*)list_data);
-    release_assert([fh length] >= sizeof(uint16_t) + (movieCount * sizeof(struct rx_mlst_record)));
+    // how many movies do we have? (this also swaps the records to host byte order)
+    uint16_t movieCount;
+    BOOL swapped = rx_card_swap_mlst(list_data, list_data_size, &movieCount);
+    release_assert(swapped);
     struct rx_mlst_record* mlstRecords = (struct rx_mlst_record*)BUFFER_OFFSET(list_data, sizeof(uint16_t));
     
     // allocate movie management objects
     _movies = [NSMutableArray new];
     _mlstCodes = malloc(sizeof(uint16_t) * movieCount);
+    _mlst_count = movieCount;
+    OSAtomicAdd64Barrier((int64_t)((class_getInstanceSize([RXMovieProxy class]) + sizeof(uint16_t)) * movieCount), &_footprint);
     
     BOOL fixup_rebel_end_loop = [[_descriptor parent] cardRMAPCodeFromID:[_descriptor ID]] == 13112 &&
                                 [[[_descriptor parent] key] isEqualToString:@"rspit"];
     
-    // swap the records if needed
-#if defined(__LITTLE_ENDIAN__)
-    for (list_index = 0; list_index < movieCount; ++list_index)
-    {
-        mlstRecords[list_index].index = CFSwapInt16(mlstRecords[list_index].index);
-        mlstRecords[list_index].movie_id = CFSwapInt16(mlstRecords[list_index].movie_id);
-        mlstRecords[list_index].code = CFSwapInt16(mlstRecords[list_index].code);
-        mlstRecords[list_index].left = CFSwapInt16(mlstRecords[list_index].left);
-        mlstRecords[list_index].top = CFSwapInt16(mlstRecords[list_index].top);
-        mlstRecords[list_index].selection_start = CFSwapInt16(mlstRecords[list_index].selection_start);
-        mlstRecords[list_index].selection_current = CFSwapInt16(mlstRecords[list_index].selection_current);
-        mlstRecords[list_index].selection_end = CFSwapInt16(mlstRecords[list_index].selection_end);
-        mlstRecords[list_index].loop = CFSwapInt16(mlstRecords[list_index].loop);
-        mlstRecords[list_index].volume = CFSwapInt16(mlstRecords[list_index].volume);
-        mlstRecords[list_index].rate = CFSwapInt16(mlstRecords[list_index].rate);
-    }
-#endif
-    
     for (list_index = 0; list_index < movieCount; ++list_index)
     {
 #if defined(DEBUG) && DEBUG > 1
@@ -406,7 +485,7 @@
     free(list_data);
 }
 
-- (void)_loadHotspots
+- (void)_loadHotspotsRefreshingCache:(BOOL)refresh
 {
     NSError* error;
     MHKFileHandle* fh;
@@ -445,73 +524,73 @@
         NSFreeMapTable(_hotspots_name_map);
     _hotspots_name_map = NSCreateMapTable(NSObjectMapKeyCallBacks, NSNonRetainedObjectMapValueCallBacks, hotspotCount);
     
-    // load the hotspots
+    struct rx_hspt_record** records = (struct rx_hspt_record**)malloc(hotspotCount * sizeof(struct rx_hspt_record*));
+    rx_script_t** scripts = (rx_script_t**)malloc(hotspotCount * sizeof(rx_script_t*));
+    uint32_t* script_lengths = (uint32_t*)malloc(hotspotCount * sizeof(uint32_t));
+    release_assert((records && scripts && script_lengths) || hotspotCount == 0);
+    
+    // the cache entry is keyed by the whole HSPT resource, before the records are swapped in place; it holds the scripts
+    // of every hotspot, including zip hotspots, since their lengths are needed to find the following records
+    uint64_t hash = rx_script_cache_hash(list_data, list_data_size);
+    NSString* cache_path = [self _scriptCachePathWithExtension:@"hspt"];
+    BOOL cached = NO;
+    if (!refresh && cache_path)
+    {
+        int32_t cached_count = rx_script_cache_read([cache_path fileSystemRepresentation], hash, hotspotCount, scripts, script_lengths);
+        cached = (cached_count == hotspotCount);
+        for (int32_t i = 0; !cached && i < cached_count; i++)
+            rx_script_free(scripts[i]);
+    }
+    
+    // find the hotspot records and get the hotspot scripts
     for (list_index = 0; list_index < hotspotCount; ++list_index)
     {
+        release_assert(list_data_size - (hsptRecordPointer - (uint8_t*)list_data) >= sizeof(struct rx_hspt_record));
         struct rx_hspt_record* hspt_record = (struct rx_hspt_record*)hsptRecordPointer;
         hsptRecordPointer += sizeof(struct rx_hspt_record);
+        records[list_index] = hspt_record;
         
         // byte order swap if needed
-#if defined(__LITTLE_ENDIAN__)
-        hspt_record->blst_id = CFSwapInt16(hspt_record->blst_id);
-        hspt_record->name_rec = (int16_t)CFSwapInt16(hspt_record->name_rec);
-        hspt_record->rect = rx_swap_core_rect(hspt_record->rect);
-        hspt_record->u0 = CFSwapInt16(hspt_record->u0);
-        hspt_record->mouse_cursor = CFSwapInt16(hspt_record->mouse_cursor);
-        hspt_record->index = CFSwapInt16(hspt_record->index);
-        hspt_record->u1 = (int16_t)CFSwapInt16(hspt_record->u1);
-        hspt_record->zip = CFSwapInt16(hspt_record->zip);
-#endif
+        rx_card_swap_hspt_record(hspt_record);
 
 #if defined(DEBUG) && DEBUG > 1
         RXOLog(@"hotspot record %u: index=%hd, blst_id=%hd, zip=%hu", list_index, hspt_record->index, hspt_record->blst_id, hspt_record->zip);
 #endif
         
-        // decode the hotspot's script
-        uint32_t script_size = 0;
-        NSDictionary* hotspot_scripts = rx_decode_riven_script(hsptRecordPointer, &script_size);
-        hsptRecordPointer += script_size;
-        
-        // if this is a zip hotspot, skip it if Zip mode is disabled
-        // FIXME: Zip mode is always disabled currently
-        if (hspt_record->zip == 1)
+        if (cached)
+        {
+            release_assert(script_lengths[list_index] <= list_data_size - (hsptRecordPointer - (uint8_t*)list_data));
+            hsptRecordPointer += script_lengths[list_index];
             continue;
+        }
         
-        // get the hotspot's name (if it has one)
-        NSString* hotspotName = nil;
-        if (hspt_record->name_rec >= 0)
-            hotspotName = [[[_descriptor parent] hotspotNameAtIndex:hspt_record->name_rec] lowercaseString];
+        // decode the hotspot's script
+        scripts[list_index] = rx_decode_riven_script(hsptRecordPointer,
+                                                     list_data_size - (hsptRecordPointer - (uint8_t*)list_data),
+                                                     &script_lengths[list_index]);
+        hsptRecordPointer += script_lengths[list_index];
         
         // WORKAROUND: there is a legitimate bug in aspit's "start new game" hotspot; it executes a command 12 at the very end,
         // which kills ambient sound after the introduction sequence; we remove that command here
         if ([_descriptor ID] == 1 && [[[_descriptor parent] key] isEqualToString:@"aspit"] && hspt_record->blst_id == 16)
         {
-            NSDictionary* program = [[hotspot_scripts objectForKey:RXMouseDownScriptKey] objectAtIndex:0];
-            
-            uint16_t opcode_count = [[program objectForKey:RXScriptOpcodeCountKey] unsignedShortValue];
-            if (opcode_count > 0 && rx_get_riven_script_opcode([[program objectForKey:RXScriptProgramKey] bytes],
-                                                               opcode_count,
-                                                               opcode_count - 1,
-                                                               NULL) == RX_COMMAND_CLEAR_SLST)
+            rx_script_program_t program = rx_script_program(scripts[list_index], kScriptTypeMouseDown, 0);
+            uint32_t last_opcode_offset;
+            if (program.opcode_count > 0 && rx_get_riven_script_opcode(program.opcodes,
+                                                                       program.opcode_count,
+                                                                       program.opcode_count - 1,
+                                                                       &last_opcode_offset) == RX_COMMAND_CLEAR_SLST)
             {
-                program = [[NSDictionary alloc] initWithObjectsAndKeys:
-                    [program objectForKey:RXScriptProgramKey], RXScriptProgramKey,
-                    [NSNumber numberWithUnsignedShort:opcode_count - 1], RXScriptOpcodeCountKey,
-                    nil];
-                
-                NSMutableDictionary* mutable_script = [hotspot_scripts mutableCopy];
-                [mutable_script setObject:[NSArray arrayWithObject:program] forKey:RXMouseDownScriptKey];
-                [program release];
-                
-                [hotspot_scripts release];
-                hotspot_scripts = mutable_script;
+                scripts[list_index] = rx_script_replace_program(scripts[list_index], kScriptTypeMouseDown, 0,
+                                                                program.opcodes, last_opcode_offset, program.opcode_count - 1);
+                release_assert(scripts[list_index]);
             }
         }
         
         // WORKAROUND: patch hotspot 16 on pspit 31 to reset pelevcombo to 0 when the combination is wrong
         else if ([_descriptor isCardWithRMAP:15632 stackName:@"pspit"] && hspt_record->blst_id == 16)
         {
-            NSDictionary* program = [[hotspot_scripts objectForKey:RXMouseDownScriptKey] objectAtIndex:0];
+            NSDictionary* program = rx_riven_program_descriptor(scripts[list_index], kScriptTypeMouseDown, 0);
             RXScriptCompiler* comp = [[RXScriptCompiler alloc] initWithCompiledScript:program];
             NSMutableArray* dp = [comp decompiledScript];
             
@@ -539,18 +618,39 @@
             }
             
             [comp setDecompiledScript:dp];
-            
-            NSMutableDictionary* mutable_script = [hotspot_scripts mutableCopy];
-            [mutable_script setObject:[NSArray arrayWithObject:[comp compiledScript]] forKey:RXMouseDownScriptKey];
-            
-            [hotspot_scripts release];
-            hotspot_scripts = mutable_script;
+            scripts[list_index] = rx_replace_riven_program(scripts[list_index], kScriptTypeMouseDown, 0, [comp compiledScript]);
             
             [comp release];
         }
         
+        // pre-link the programs now that the workarounds have been applied
+        scripts[list_index] = rx_script_link(scripts[list_index]);
+        release_assert(scripts[list_index]);
+    }
+    
+    if (!cached)
+        [self _writeScriptCache:cache_path hash:hash count:hotspotCount scripts:scripts scriptLengths:script_lengths];
+    
+    // create the hotspots
+    for (list_index = 0; list_index < hotspotCount; ++list_index)
+    {
+        struct rx_hspt_record* hspt_record = records[list_index];
+        
+        // if this is a zip hotspot, skip it if Zip mode is disabled
+        // FIXME: Zip mode is always disabled currently
+        if (hspt_record->zip == 1)
+        {
+            rx_script_free(scripts[list_index]);
+            continue;
+        }
+        
+        // get the hotspot's name (if it has one)
+        NSString* hotspotName = nil;
+        if (hspt_record->name_rec >= 0)
+            hotspotName = [[[_descriptor parent] hotspotNameAtIndex:hspt_record->name_rec] lowercaseString];
+        
         // WORKAROUND: tweak hotspot "raisehandle" on tspit 138 (29539) to have the open-hand cursor
-        else if ([_descriptor isCardWithRMAP:29539 stackName:@"tspit"] && hotspotName && [hotspotName isEqualToString:@"raisehandle"])
+        if ([_descriptor isCardWithRMAP:29539 stackName:@"tspit"] && hotspotName && [hotspotName isEqualToString:@"raisehandle"])
         {
             hspt_record->mouse_cursor = RX_CURSOR_OPEN_HAND;
         }
@@ -567,12 +667,12 @@
             hspt_record->mouse_cursor = RX_CURSOR_OPEN_HAND;
         }
         
-        // allocate the hotspot object
+        // allocate the hotspot object, which takes ownership of the hotspot's script
         RXHotspot* hs = [[RXHotspot alloc] initWithIndex:hspt_record->index
                                                       ID:hspt_record->blst_id
                                                     rect:hspt_record->rect
                                                 cursorID:hspt_record->mouse_cursor
-                                                  script:hotspot_scripts];
+                                                  script:scripts[list_index]];
         if (hotspotName)
         {
             [hs setName:hotspotName];
@@ -584,9 +684,12 @@
         [_hotspots addObject:hs];
         
         [hs release];
-        [hotspot_scripts release];
     }
     
+    free(script_lengths);
+    free(scripts);
+    free(records);
+    
     // don't need the HSPT data anymore
     free(list_data);
     
@@ -608,32 +711,26 @@
                                      userInfo:[NSDictionary dictionaryWithObjectsAndKeys:error, NSUnderlyingErrorKey, nil]];
     
     _hotspotControlRecords = (struct rx_blst_record*)BUFFER_OFFSET(_blstData, sizeof(uint16_t));
+    OSAtomicAdd64Barrier((int64_t)list_data_size, &_footprint);
+    
+    // byte order
+    uint16_t blstCount;
+    BOOL swapped = rx_card_swap_blst(_blstData, list_data_size, &blstCount);
+    release_assert(swapped);
     
-    // byte order (and debug)
-#if defined(__LITTLE_ENDIAN__) || (defined(DEBUG) && DEBUG > 1)
-    uint16_t blstCount = CFSwapInt16BigToHost(*(uint16_t*)_blstData);
+#if defined(DEBUG) && DEBUG > 1
     for (list_index = 0; list_index < blstCount; ++list_index)
     {
         struct rx_blst_record* record = _hotspotControlRecords + list_index;
-        
-#if defined(__LITTLE_ENDIAN__)
-        record->index = CFSwapInt16(record->index);
-        record->enabled = CFSwapInt16(record->enabled);
-        record->hotspot_id = CFSwapInt16(record->hotspot_id);
-#endif // defined(__LITTLE_ENDIAN__)
-        
-#if defined(DEBUG) && DEBUG > 1
         RXOLog(@"blst record %u: index=%hd, enabled=%hd, hotspot_id=%hd", list_index, record->index, record->enabled, record->hotspot_id);
-#endif // defined(DEBUG) && DEBUG > 1
     }
-#endif // defined(__LITTLE_ENDIAN__) || (defined(DEBUG) && DEBUG > 1)
+#endif
 }
 
 - (void)_loadSpecialEffects
 {
     NSError* error;
     MHKFileHandle* fh;
-    void* list_data;
     size_t list_data_size;
     uint16_t list_index;
     
@@ -645,113 +742,75 @@
     
     list_data_size = (size_t)[fh length];
     release_assert([fh length] >= sizeof(uint16_t));
-    list_data = malloc(list_data_size);
+    _flst_data = malloc(list_data_size);
     
     // read the data from the archive
-    if ([fh readDataToEndOfFileInBuffer:list_data error:&error] == -1)
+    if ([fh readDataToEndOfFileInBuffer:_flst_data error:&error] == -1)
         @throw [NSException exceptionWithName:@"RXRessourceIOException"
                                        reason:@"Could not read the card's corresponding FLST ressource."
                                      userInfo:[NSDictionary dictionaryWithObjectsAndKeys:error, NSUnderlyingErrorKey, nil]];
     
-    _flstCount = CFSwapInt16BigToHost(*(uint16_t*)list_data);
-    release_assert([fh length] >= sizeof(uint16_t) + (_flstCount * sizeof(struct rx_flst_record)));
-    _sfxes = (rx_card_sfxe*)malloc(sizeof(rx_card_sfxe) * _flstCount);
+    // how many special effects do we have? (this also swaps the records to host byte order)
+    uint16_t flst_count;
+    BOOL swapped = rx_card_swap_flst(_flst_data, list_data_size, &flst_count);
+    release_assert(swapped);
     
-    struct rx_flst_record* flstRecordPointer = (struct rx_flst_record*)BUFFER_OFFSET(list_data, sizeof(uint16_t));
-    for (list_index = 0; list_index < _flstCount; ++list_index)
-    {
-        struct rx_flst_record* record = flstRecordPointer + list_index;
-        
-#if defined(__LITTLE_ENDIAN__)
-        record->index = CFSwapInt16(record->index);
-        record->sfxe_id = CFSwapInt16(record->sfxe_id);
-        record->u0 = CFSwapInt16(record->u0);
-#endif
-        
-        // open the corresponding SFXE resource
-        MHKFileHandle* sfxeHandle = [_parent fileWithResourceType:@"SFXE" ID:record->sfxe_id];
-        if (!sfxeHandle)
-            @throw [NSException exceptionWithName:@"RXMissingResourceException"
-                                           reason:@"Could not open a required SFXE resource."
-                                         userInfo:nil];
-        
-        // get the size of the SFXE resource and allocate the sfxe's record buffer
-        size_t sfxe_size = (size_t)[sfxeHandle length];
-        release_assert(sfxe_size >= sizeof(struct rx_sfxe_record));
-        
-        rx_card_sfxe* sfxe = _sfxes + list_index;
-        sfxe->record = (struct rx_sfxe_record*)malloc(sfxe_size);
-        
-        // read the data from the archive
-        if ([sfxeHandle readDataToEndOfFileInBuffer:(void*)sfxe->record error:&error] == -1)
-            @throw [NSException exceptionWithName:@"RXRessourceIOException"
-                                           reason:@"Could not read a required SFXE resource."
-                                         userInfo:[NSDictionary dictionaryWithObjectsAndKeys:error, NSUnderlyingErrorKey, nil]];
-        
-#if defined(__LITTLE_ENDIAN__)
-        // byte swap on litle endian architectures
-        sfxe->record->magic = CFSwapInt16(sfxe->record->magic);
-        sfxe->record->frame_count = CFSwapInt16(sfxe->record->frame_count);
-        sfxe->record->offset_table = CFSwapInt32(sfxe->record->offset_table);
-        sfxe->record->rect = rx_swap_core_rect(sfxe->record->rect);
-        sfxe->record->fps = CFSwapInt16(sfxe->record->fps);
-        sfxe->record->u0 = CFSwapInt16(sfxe->record->u0);
-        sfxe->record->alt_rect = rx_swap_core_rect(sfxe->record->alt_rect);
-        sfxe->record->u1 = CFSwapInt16(sfxe->record->u1);
-        sfxe->record->alt_frame_count = CFSwapInt16(sfxe->record->alt_frame_count);
-        sfxe->record->u2 = CFSwapInt32(sfxe->record->u2);
-        sfxe->record->u3 = CFSwapInt32(sfxe->record->u3);
-        sfxe->record->u4 = CFSwapInt32(sfxe->record->u4);
-        sfxe->record->u5 = CFSwapInt32(sfxe->record->u5);
-        sfxe->record->u6 = CFSwapInt32(sfxe->record->u6);
-#endif
-        
-        // alias the offset table for convenience
-        union {
-            uint32_t* p_int32;
-            void* p_void;
-        } u;
-        u.p_void = sfxe->record;
-        sfxe->offsets = BUFFER_OFFSET(u.p_int32, sfxe->record->offset_table);
-
-#if defined(__LITTLE_ENDIAN__)
-        // byte swap the offsets and the program
-        for (uint16_t fi = 0; fi < sfxe->record->frame_count; ++fi)
-        {
-            sfxe->offsets[fi] = CFSwapInt32(sfxe->offsets[fi]);
-            
-            union {
-                uint16_t* p_int16;
-                void* p_void;
-            } mp;
-            mp.p_void = sfxe->record;
-            mp.p_int16 = BUFFER_OFFSET(mp.p_int16, sfxe->offsets[fi]);
-            
-            *mp.p_int16 = CFSwapInt16(*mp.p_int16);
-            while (*mp.p_int16 != 4)
-            {
-                if (*mp.p_int16 == 3)
-                {
-                    mp.p_int16[1] = CFSwapInt16(mp.p_int16[1]);
-                    mp.p_int16[2] = CFSwapInt16(mp.p_int16[2]);
-                    mp.p_int16[3] = CFSwapInt16(mp.p_int16[3]);
-                    mp.p_int16[4] = CFSwapInt16(mp.p_int16[4]);
-                    mp.p_int16 += 4;
-                }
-                else if (*mp.p_int16 != 1)
-                    rx_abort("invalid sfxe record: %s %d", [[_descriptor description] UTF8String], record->sfxe_id);
-                
-                mp.p_int16++;
-                *mp.p_int16 = CFSwapInt16(*mp.p_int16);
-            }
-            
-            release_assert(mp.p_void <= (void*)BUFFER_OFFSET(sfxe->record, sfxe_size));
-        }
-#endif
-    }
+    // the records are filled in by the SFXE jobs, so they start out empty
+    _sfxes = (rx_card_sfxe*)calloc(flst_count, sizeof(rx_card_sfxe));
+    release_assert(_sfxes || flst_count == 0);
+    _flstCount = flst_count;
+    OSAtomicAdd64Barrier((int64_t)(list_data_size + sizeof(rx_card_sfxe) * flst_count), &_footprint);
     
-    // don't need the FLST data anymore
-    free(list_data);
+    // every SFXE resource is a separate archive read; they are read in parallel
+    for (list_index = 0; list_index < flst_count; ++list_index)
+        [self _submitLoadJob:@selector(_loadSpecialEffect:) index:list_index joinedBy:_sfxes_task];
+}
+
+- (void)_loadSpecialEffect:(NSUInteger)list_index
+{
+    NSError* error;
+    struct rx_flst_record* record = (struct rx_flst_record*)BUFFER_OFFSET(_flst_data, sizeof(uint16_t)) + list_index;
+    
+    // open the corresponding SFXE resource
+    MHKFileHandle* sfxeHandle = [_parent fileWithResourceType:@"SFXE" ID:record->sfxe_id];
+    if (!sfxeHandle)
+        @throw [NSException exceptionWithName:@"RXMissingResourceException"
+                                       reason:@"Could not open a required SFXE resource."
+                                     userInfo:nil];
+    
+    // get the size of the SFXE resource and allocate the sfxe's record buffer
+    size_t sfxe_size = (size_t)[sfxeHandle length];
+    release_assert(sfxe_size >= sizeof(struct rx_sfxe_record));
+    
+    rx_card_sfxe* sfxe = _sfxes + list_index;
+    sfxe->record = (struct rx_sfxe_record*)malloc(sfxe_size);
+    OSAtomicAdd64Barrier((int64_t)sfxe_size, &_footprint);
+    
+    // read the data from the archive
+    if ([sfxeHandle readDataToEndOfFileInBuffer:(void*)sfxe->record error:&error] == -1)
+        @throw [NSException exceptionWithName:@"RXRessourceIOException"
+                                       reason:@"Could not read a required SFXE resource."
+                                     userInfo:[NSDictionary dictionaryWithObjectsAndKeys:error, NSUnderlyingErrorKey, nil]];
+    
+    // byte swap the header, the offsets and the frame programs
+    if (!rx_card_swap_sfxe(sfxe->record, sfxe_size))
+        rx_abort("invalid sfxe record: %s %d", [[_descriptor description] UTF8String], record->sfxe_id);
+    
+    // alias the offset table for convenience
+    union {
+        uint32_t* p_int32;
+        void* p_void;
+    } u;
+    u.p_void = sfxe->record;
+    sfxe->offsets = BUFFER_OFFSET(u.p_int32, sfxe->record->offset_table);
+    
+    // compile the frame programs into spans, which the card renderer draws on the GPU; the renderer does not play an
+    // effect whose spans fall outside of the card
+    sfxe->water = rx_water_program_compile(sfxe->record, sfxe->offsets, kRXCardViewportSize.width, kRXCardViewportSize.height);
+    if (sfxe->water)
+        OSAtomicAdd64Barrier((int64_t)rx_water_program_size(sfxe->water), &_footprint);
+    else
+        RXOLog2(kRXLoggingEngine, kRXLoggingLevelError, @"sfxe %hu has spans outside of the card", record->sfxe_id);
 }
 
 - (void)_loadSounds
@@ -779,8 +838,9 @@
                                      userInfo:[NSDictionary dictionaryWithObjectsAndKeys:error, NSUnderlyingErrorKey, nil]];
     
     // how many sound groups do we have?
-    uint16_t soundGroupCount = CFSwapInt16BigToHost(*(uint16_t*)list_data);
-    release_assert([fh length] >= sizeof(uint16_t) + (soundGroupCount * sizeof(uint16_t)));
+    uint16_t soundGroupCount;
+    BOOL swapped = rx_card_swap_slst(list_data, list_data_size, &soundGroupCount);
+    release_assert(swapped);
     uint16_t* slstRecordPointer = (uint16_t*)BUFFER_OFFSET(list_data, sizeof(uint16_t));
     
     _soundGroups = [[NSMutableArray alloc] initWithCapacity:soundGroupCount];
@@ -791,11 +851,11 @@
     // load the sound groups
     for (list_index = 0; list_index < soundGroupCount; ++list_index)
     {
-        uint16_t soundCount = CFSwapInt16BigToHost(*slstRecordPointer);
+        uint16_t soundCount = *slstRecordPointer;
         slstRecordPointer++;
         
         // create a sound group for the record
-        RXSoundGroup* sgroup = [self newSoundGroupWithSLSTRecord:slstRecordPointer soundCount:soundCount swapBytes:YES];
+        RXSoundGroup* sgroup = [self newSoundGroupWithSLSTRecord:slstRecordPointer soundCount:soundCount swapBytes:NO];
         if (sgroup)
             [_soundGroups addObject:sgroup];
         [sgroup release];
@@ -825,6 +885,94 @@
     
 }
 
+- (void)_recordLoadException:(NSException*)e
+{
+    OSSpinLockLock(&_load_lock);
+    if (!_load_exception)
+        _load_exception = [e retain];
+    OSSpinLockUnlock(&_load_lock);
+}
+
+// submits a job calling selector, with index unless it is NSNotFound, that join waits for
+- (void)_submitLoadJob:(SEL)selector index:(NSUInteger)index joinedBy:(rx_task_t*)join
+{
+    struct rx_card_load_job* job = (struct rx_card_load_job*)malloc(sizeof(struct rx_card_load_job));
+    release_assert(job);
+    job->card = self;
+    job->selector = selector;
+    job->index = index;
+    
+    rx_task_t* task = rx_task_create(rx_task_pool_shared(), rx_card_run_load_job, job);
+    release_assert(task);
+    rx_task_add_prerequisite(join, task);
+    rx_task_submit(task);
+    rx_task_release(task);
+}
+
+// waits for a load task, then raises the first exception a load job raised, if any
+- (void)_waitForLoadTask:(rx_task_t*)task
+{
+    rx_task_wait(task);
+    
+    OSSpinLockLock(&_load_lock);
+    NSException* e = [[_load_exception retain] autorelease];
+    OSSpinLockUnlock(&_load_lock);
+    if (e)
+        @throw e;
+}
+
+- (void)_waitUntilLoaded
+{
+    if (_loaded_task)
+        [self _waitForLoadTask:_loaded_task];
+}
+
+- (void)_loadScripts
+{
+    [self _loadScriptsRefreshingCache:NO];
+    OSAtomicAdd64Barrier((int64_t)rx_script_size(_card_scripts), &_footprint);
+}
+
+- (void)_loadHotspots
+{
+    [self _loadHotspotsRefreshingCache:NO];
+    
+    int64_t hotspot_bytes = (int64_t)(class_getInstanceSize([RXHotspot class]) * [_hotspots count]);
+    for (RXHotspot* hotspot in _hotspots)
+        hotspot_bytes += rx_script_size([hotspot scripts]);
+    OSAtomicAdd64Barrier(hotspot_bytes, &_footprint);
+}
+
+- (void)_submitLoadTasks
+{
+    rx_task_pool_t* pool = rx_task_pool_shared();
+    release_assert(pool);
+    
+    // the card is ready once its scripts, hotspots and pictures are loaded, and loaded once every resource is; the
+    // picture and special effect lists fan out into a job per record, which their own join tasks wait for
+    _pictures_task = rx_task_create(pool, NULL, NULL);
+    _sfxes_task = rx_task_create(pool, NULL, NULL);
+    _ready_task = rx_task_create(pool, NULL, NULL);
+    _loaded_task = rx_task_create(pool, NULL, NULL);
+    release_assert(_pictures_task && _sfxes_task && _ready_task && _loaded_task);
+    
+    rx_task_add_prerequisite(_ready_task, _pictures_task);
+    rx_task_add_prerequisite(_loaded_task, _ready_task);
+    rx_task_add_prerequisite(_loaded_task, _sfxes_task);
+    
+    [self _submitLoadJob:@selector(_loadScripts) index:NSNotFound joinedBy:_ready_task];
+    [self _submitLoadJob:@selector(_loadHotspots) index:NSNotFound joinedBy:_ready_task];
+    [self _submitLoadJob:@selector(_loadPictures) index:NSNotFound joinedBy:_pictures_task];
+    [self _submitLoadJob:@selector(_loadMovies) index:NSNotFound joinedBy:_loaded_task];
+    [self _submitLoadJob:@selector(_loadSpecialEffects) index:NSNotFound joinedBy:_sfxes_task];
+    [self _submitLoadJob:@selector(_loadSounds) index:NSNotFound joinedBy:_loaded_task];
+    
+    rx_task_submit(_pictures_task);
+    rx_task_submit(_sfxes_task);
+    rx_task_submit(_ready_task);
+    rx_task_submit(_loaded_task);
+}
+
 - (void)load
 {
     if (_loaded)
@@ -833,67 +981,26 @@
     RXOLog2(kRXLoggingEngine, kRXLoggingLevelDebug, @"loading card");
 #endif
     
-    [self _loadScripts];
-    [self _loadPictures];
-    [self _loadMovies];
-    [self _loadHotspots];
-    [self _loadSpecialEffects];
-    [self _loadSounds];
+    if (!_ready_task)
+        [self _submitLoadTasks];
     
+    // this thread runs load jobs while it waits, so a card never loads slower than it would one resource at a time
+    [self _waitForLoadTask:_ready_task];
     _loaded = YES;
 }
 
+- (void)loadScriptsRefreshingCache:(BOOL)refresh
+{
+    [self _loadScriptsRefreshingCache:refresh];
+    [self _loadHotspotsRefreshingCache:refresh];
+}
+
 #pragma mark -
 #pragma mark dynamic loading
 
 - (RXSoundGroup*)newSoundGroupWithSLSTRecord:(const uint16_t*)slst_record soundCount:(uint16_t)sound_count swapBytes:(BOOL)swap
 {
-    RXSoundGroup* group = [RXSoundGroup new];
-    
-    // some useful pointers
-    const uint16_t* group_parameters = slst_record + sound_count;
-    const uint16_t* gain_parameters = group_parameters + 5;
-    const uint16_t* pan_parameters = gain_parameters + sound_count;
-    
-    // fade flags
-    uint16_t fade_flags = *group_parameters;
-    if (swap)
-        fade_flags = CFSwapInt16BigToHost(fade_flags);
-    group->fadeOutRemovedSounds = (fade_flags & 0x0001) ? YES : NO;
-    group->fadeInNewSounds = (fade_flags & 0x0002) ? YES : NO;
-    
-    // loop flag
-    uint16_t loop = *(group_parameters + 1);
-    if (swap)
-        loop = CFSwapInt16BigToHost(loop);
-    group->loop = (loop) ? YES : NO;
-    
-    // group gain
-    uint16_t integer_gain = *(group_parameters + 2);
-    if (swap)
-        integer_gain = CFSwapInt16BigToHost(integer_gain);
-    float gain = (float)integer_gain / kRXSoundGainDivisor;
-    group->gain = gain;
-    
-    uint16_t sound_index = 0;
-    for (; sound_index < sound_count; ++sound_index)
-    {
-        uint16_t sound_id = *(slst_record + sound_index);
-        if (swap)
-            sound_id = CFSwapInt16BigToHost(sound_id);
-        
-        integer_gain = *(gain_parameters + sound_index);
-        if (swap)
-            integer_gain = CFSwapInt16BigToHost(integer_gain);
-        gain = (float)integer_gain / kRXSoundGainDivisor;
-        
-        int16_t integer_pan = *((int16_t*)(pan_parameters + sound_index));
-        if (swap)
-            integer_pan = (int16_t)CFSwapInt16BigToHost(integer_pan);
-        float pan = 0.5f + ((float)integer_pan / 200.0f);
-        
-        [group addSoundWithStack:_parent ID:sound_id gain:gain pan:pan];
-    }
+    RXSoundGroup* group = [[RXSoundGroup alloc] initWithSLSTRecord:slst_record soundCount:sound_count stack:_parent swapBytes:swap];
     
 #if defined(DEBUG) && DEBUG > 1
     RXOLog(@"created sound group: %@", group);
@@ -903,6 +1010,8 @@
 
 - (RXMovie*)loadMovieWithMLSTRecord:(struct rx_mlst_record*)mlst
 {
+    [self _waitUntilLoaded];
+    
     // sometimes volume > 255, so fix it up here
     if (mlst->volume > 255)
         mlst->volume = 255;
@@ -920,10 +1029,29 @@
     // add the movie to the movies array
     [_movies addObject:movie_proxy];
     [movie_proxy release];
+    OSAtomicAdd64Barrier((int64_t)class_getInstanceSize([RXMovieProxy class]), &_footprint);
     
     return [[(RXMovie*)movie_proxy retain] autorelease];
 }
 
+- (void)reset
+{
+    // WARNING: MUST RUN ON THE SCRIPT THREAD
+    [self _waitUntilLoaded];
+    
+    [_hotspots makeObjectsPerformSelector:@selector(reset)];
+    
+    // the movies past the MLST movies were synthesized by the scripts, which synthesize them again when they need them;
+    // the script engine keeps the ones it still refers to
+    NSUInteger movie_count = [_movies count];
+    if (movie_count > _mlst_count)
+    {
+        [_movies removeObjectsInRange:NSMakeRange(_mlst_count, movie_count - _mlst_count)];
+        OSAtomicAdd64Barrier(-(int64_t)(class_getInstanceSize([RXMovieProxy class]) * (movie_count - _mlst_count)), &_footprint);
+    }
+    [_movies makeObjectsPerformSelector:@selector(deleteMovie)];
+}
+
 - (uint16_t)soundIDWithName:(NSString*)name
 {
     return [_parent soundIDForName:[NSString stringWithFormat:@"%hu_%@_1", [_descriptor ID], name]];
@@ -937,6 +1065,14 @@
 #pragma mark -
 #pragma mark accessors
 
+- (size_t)memoryFootprint
+{
+    // the footprint is final once every resource is loaded; load errors are raised by the other accessors
+    if (_loaded_task)
+        rx_task_wait(_loaded_task);
+    return (size_t)_footprint;
+}
+
 - (RXCardDescriptor*)descriptor
 {
     return [[_descriptor retain] autorelease];
@@ -957,9 +1093,9 @@
     return (struct rx_plst_record*)BUFFER_OFFSET(_plst_data, sizeof(uint16_t));
 }
 
-- (NSDictionary*)scripts
+- (const rx_script_t*)scripts
 {
-    return [[_card_scripts retain] autorelease];
+    return _card_scripts;
 }
 
 - (NSArray*)hotspots
@@ -984,21 +1120,25 @@
 
 - (NSArray*)movies
 {
+    [self _waitUntilLoaded];
     return [[_movies retain] autorelease];
 }
 
 - (uint16_t*)movieCodes
 {
+    [self _waitUntilLoaded];
     return _mlstCodes;
 }
 
 - (NSArray*)soundGroups
 {
+    [self _waitUntilLoaded];
     return [[_soundGroups retain] autorelease];
 }
 
 - (rx_card_sfxe*)sfxes
 {
+    [self _waitUntilLoaded];
     return _sfxes;
 }
 
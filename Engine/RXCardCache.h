@@ -0,0 +1,53 @@
+//
+//  RXCardCache.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 01/11/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#import "Base/RXBase.h"
+
+#import "Engine/RXCard.h"
+#import "Engine/RXCardDescriptor.h"
+
+
+// Keeps the cards the player left, so that going back to a card does not load it again. The cards are keyed by their
+// simple descriptor and evicted in least recently used order once their memory footprints (see -[RXCard
+// memoryFootprint]) exceed the cache budget. Cards are reset to the state they were loaded in when they are taken out of
+// the cache.
+//
+// The budget is the rendering.card_cache_budget engine variable (in MB); a budget of 0 disables the cache.
+@interface RXCardCache : NSObject
+{
+    OSSpinLock _lock;
+
+    // cards by simple descriptor, their footprints when they were added, and their descriptors from least to most
+    // recently used
+    NSMutableDictionary* _cards;
+    NSMutableDictionary* _footprints;
+    NSMutableArray* _lru;
+    size_t _resident_bytes;
+
+    uint32_t _hits;
+    uint32_t _misses;
+}
+
+// returns the cached card, reset to its initial state, or nil; the card leaves the cache and is handed over to the
+// caller, who must release it; MUST RUN ON THE SCRIPT THREAD
+- (RXCard*)newCardWithSimpleDescriptor:(RXSimpleCardDescriptor*)scd NS_RETURNS_RETAINED;
+
+// adds a loaded card as the most recently used card, replacing any card with the same descriptor, and evicts the least
+// recently used cards that do not fit in the budget
+- (void)addCard:(RXCard*)card;
+
+- (void)removeAllCards;
+
+// tells if the cache holds a card, without counting a lookup
+- (BOOL)containsCardWithSimpleDescriptor:(RXSimpleCardDescriptor*)scd;
+
+- (size_t)residentBytes;
+- (double)hitRate;
+- (void)resetStatistics;
+
+@end
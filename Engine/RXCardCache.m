@@ -0,0 +1,157 @@
+//
+//  RXCardCache.m
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 01/11/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#import "Engine/RXCardCache.h"
+
+#import "Engine/RXWorldProtocol.h"
+
+
+@implementation RXCardCache
+
+- (id)init
+{
+    self = [super init];
+    if (!self)
+        return nil;
+
+    _lock = OS_SPINLOCK_INIT;
+    _cards = [NSMutableDictionary new];
+    _footprints = [NSMutableDictionary new];
+    _lru = [NSMutableArray new];
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_cards release];
+    [_footprints release];
+    [_lru release];
+
+    [super dealloc];
+}
+
+// removes a card from the cache and returns it, retained, or nil; MUST BE CALLED WITH THE LOCK HELD
+- (RXCard*)_removeCardWithSimpleDescriptor:(RXSimpleCardDescriptor*)scd NS_RETURNS_RETAINED
+{
+    RXCard* card = [[_cards objectForKey:scd] retain];
+    if (!card)
+        return nil;
+
+    _resident_bytes -= [[_footprints objectForKey:scd] unsignedLongValue];
+    [_cards removeObjectForKey:scd];
+    [_footprints removeObjectForKey:scd];
+    [_lru removeObject:scd];
+    return card;
+}
+
+- (RXCard*)newCardWithSimpleDescriptor:(RXSimpleCardDescriptor*)scd
+{
+    // WARNING: MUST RUN ON THE SCRIPT THREAD
+    OSSpinLockLock(&_lock);
+    RXCard* card = [self _removeCardWithSimpleDescriptor:scd];
+    if (card)
+        _hits++;
+    else
+        _misses++;
+    OSSpinLockUnlock(&_lock);
+
+    // the scripts changed the card while it was open
+    [card reset];
+    return card;
+}
+
+- (void)addCard:(RXCard*)card
+{
+    size_t budget = (size_t)RXEngineGetUInt32(@"rendering.card_cache_budget") * 1024 * 1024;
+    size_t footprint = [card memoryFootprint];
+    RXSimpleCardDescriptor* scd = [[card descriptor] simpleDescriptor];
+
+    // the cards are released outside of the lock, since releasing a card frees all of its resources
+    NSMutableArray* evicted_cards = [NSMutableArray new];
+
+    OSSpinLockLock(&_lock);
+
+    RXCard* previous_card = [self _removeCardWithSimpleDescriptor:scd];
+    if (previous_card)
+    {
+        [evicted_cards addObject:previous_card];
+        [previous_card release];
+    }
+
+    // a card larger than the budget would evict every other card and then itself
+    if (footprint <= budget)
+    {
+        [_cards setObject:card forKey:scd];
+        [_footprints setObject:[NSNumber numberWithUnsignedLong:footprint] forKey:scd];
+        [_lru addObject:scd];
+        _resident_bytes += footprint;
+    }
+
+    while (_resident_bytes > budget)
+    {
+        RXCard* evicted_card = [self _removeCardWithSimpleDescriptor:[_lru objectAtIndex:0]];
+        [evicted_cards addObject:evicted_card];
+        [evicted_card release];
+    }
+
+    OSSpinLockUnlock(&_lock);
+
+    [evicted_cards release];
+}
+
+- (void)removeAllCards
+{
+    OSSpinLockLock(&_lock);
+    NSArray* cards = [[_cards allValues] retain];
+    [_cards removeAllObjects];
+    [_footprints removeAllObjects];
+    [_lru removeAllObjects];
+    _resident_bytes = 0;
+    OSSpinLockUnlock(&_lock);
+
+    [cards release];
+}
+
+- (BOOL)containsCardWithSimpleDescriptor:(RXSimpleCardDescriptor*)scd
+{
+    OSSpinLockLock(&_lock);
+    BOOL contains = ([_cards objectForKey:scd] != nil) ? YES : NO;
+    OSSpinLockUnlock(&_lock);
+    return contains;
+}
+
+#pragma mark -
+#pragma mark statistics
+
+- (size_t)residentBytes
+{
+    OSSpinLockLock(&_lock);
+    size_t resident_bytes = _resident_bytes;
+    OSSpinLockUnlock(&_lock);
+    return resident_bytes;
+}
+
+- (double)hitRate
+{
+    OSSpinLockLock(&_lock);
+    uint32_t lookups = _hits + _misses;
+    double hit_rate = (lookups) ? (double)_hits / lookups : 0.0;
+    OSSpinLockUnlock(&_lock);
+    return hit_rate;
+}
+
+- (void)resetStatistics
+{
+    OSSpinLockLock(&_lock);
+    _hits = 0;
+    _misses = 0;
+    OSSpinLockUnlock(&_lock);
+}
+
+@end
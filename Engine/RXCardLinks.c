@@ -0,0 +1,117 @@
+/*
+ *  RXCardLinks.c
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 29/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdlib.h>
+
+#include "Engine/RXCardLinks.h"
+#include "Engine/RXScriptCommandAliases.h"
+
+
+struct link_list {
+    uint16_t from_card_id;
+    rx_card_link_t* links;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+static void add_link(struct link_list* list, uint16_t card_id)
+{
+    if (card_id == list->from_card_id)
+        return;
+
+    for (uint32_t i = 0; i < list->count; i++)
+    {
+        if (list->links[i].card_id == card_id)
+        {
+            if (list->links[i].references < UINT16_MAX)
+                list->links[i].references++;
+            return;
+        }
+    }
+
+    if (list->count == list->capacity)
+        return;
+    list->links[list->count].card_id = card_id;
+    list->links[list->count].references = 1;
+    list->count++;
+}
+
+// walks a block of count instructions starting at word offset and advances offset past it; programs in an arena are
+// verified, so this only checks bounds to stay safe on programs that were replaced by script workarounds
+static bool walk_block(struct link_list* list, const uint16_t* words, size_t word_count, size_t* offset, uint16_t count)
+{
+    for (uint16_t i = 0; i < count; i++)
+    {
+        if (*offset + 2 > word_count)
+            return false;
+
+        uint16_t opcode = words[*offset];
+        uint16_t argc = words[*offset + 1];
+        if (*offset + 2 + argc > word_count)
+            return false;
+
+        if (opcode == RX_COMMAND_GOTO_CARD && argc >= 1)
+            add_link(list, words[*offset + 2]);
+
+        if (opcode != RX_COMMAND_BRANCH || argc < 2)
+        {
+            *offset += 2 + (size_t)argc;
+            continue;
+        }
+
+        // variable, case count, then the case value and instruction count of each case followed by its block
+        uint16_t case_count = words[*offset + 3];
+        *offset += 2 + (size_t)argc;
+        for (uint16_t c = 0; c < case_count; c++)
+        {
+            if (*offset + 2 > word_count)
+                return false;
+            uint16_t case_opcode_count = words[*offset + 1];
+            *offset += 2;
+            if (!walk_block(list, words, word_count, offset, case_opcode_count))
+                return false;
+        }
+    }
+    return true;
+}
+
+uint32_t rx_card_links_add_script(const rx_script_t* script, uint16_t from_card_id, rx_card_link_t* links,
+                                  uint32_t count, uint32_t capacity)
+{
+    struct link_list list = {from_card_id, links, count, capacity};
+    if (!script)
+        return count;
+
+    for (uint16_t event = 0; event < RX_SCRIPT_EVENT_TYPE_COUNT; event++)
+    {
+        uint32_t program_count = rx_script_program_count(script, event);
+        for (uint32_t index = 0; index < program_count; index++)
+        {
+            rx_script_program_t program = rx_script_program(script, event, index);
+            size_t offset = 0;
+            walk_block(&list, program.opcodes, program.length / sizeof(uint16_t), &offset, program.opcode_count);
+        }
+    }
+
+    return list.count;
+}
+
+static int compare_links(const void* a, const void* b)
+{
+    const rx_card_link_t* link_a = (const rx_card_link_t*)a;
+    const rx_card_link_t* link_b = (const rx_card_link_t*)b;
+    if (link_a->references != link_b->references)
+        return (link_a->references > link_b->references) ? -1 : 1;
+    return (int)link_a->card_id - (int)link_b->card_id;
+}
+
+void rx_card_links_sort(rx_card_link_t* links, uint32_t count)
+{
+    qsort(links, count, sizeof(rx_card_link_t), compare_links);
+}
@@ -0,0 +1,43 @@
+/*
+ *  RXCardLinks.h
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 29/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#if !defined(RX_CARD_LINKS_H)
+#define RX_CARD_LINKS_H
+
+#include <sys/cdefs.h>
+#include <stdint.h>
+
+#include "Engine/RXScriptArena.h"
+
+//
+// Extracts the cards a card can switch to from its scripts, without running them: every go to card command of every
+// program, including the commands in every case of every switch, is a link to the card it names. The links of a card
+// and of its hotspots are the edges of that card in the link graph of its stack, and the number of commands that
+// name a card is a measure of how likely the player is to go there next.
+//
+
+__BEGIN_DECLS
+
+struct rx_card_link {
+    uint16_t card_id;
+    uint16_t references;    // number of go to card commands naming the card
+};
+typedef struct rx_card_link rx_card_link_t;
+
+// adds the targets of the go to card commands of a script to a list of count links, skipping the card the script
+// belongs to; returns the new number of links, which never exceeds capacity
+uint32_t rx_card_links_add_script(const rx_script_t* script, uint16_t from_card_id, rx_card_link_t* links,
+                                  uint32_t count, uint32_t capacity);
+
+// sorts links by decreasing number of references, then by card ID
+void rx_card_links_sort(rx_card_link_t* links, uint32_t count);
+
+__END_DECLS
+
+#endif // RX_CARD_LINKS_H
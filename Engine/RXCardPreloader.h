@@ -0,0 +1,78 @@
+//
+//  RXCardPreloader.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 29/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#import <mach/semaphore.h>
+
+#import "Base/RXBase.h"
+
+#import "Engine/RXCard.h"
+#import "Engine/RXCardCache.h"
+#import "Engine/RXCardLinks.h"
+
+
+// Loads the cards the player is likely to go to next on a dedicated thread, while the current card runs. The likely
+// cards are the neighbors of the current card in the link graph of its stack (see RXCardLinks.h), in decreasing order
+// of references, for as long as the preloaded cards fit in the preload budget. The link graph is built one card at a
+// time, as cards are entered. Neighbors that the card cache holds are not preloaded, since the cache supplies them.
+//
+// Preloading is controlled by the rendering.card_preloading and rendering.card_preload_budget (in MB) engine variables.
+@interface RXCardPreloader : NSObject
+{
+    OSSpinLock _lock;
+    semaphore_t _wake_semaphore;
+    semaphore_t _load_semaphore;
+    semaphore_t _exit_semaphore;
+    BOOL _terminate;
+
+    RXCardCache* _card_cache;
+
+    // stack key -> card ID -> NSData of rx_card_link_t, sorted by rx_card_links_sort
+    NSMutableDictionary* _link_graphs;
+
+    // neighbors of the current card, the ones waiting to be loaded, and the ones that are loaded
+    RXStack* _stack;
+    NSSet* _neighbors;
+    NSMutableArray* _queue;
+    NSMutableDictionary* _cards;
+    RXSimpleCardDescriptor* _loading;
+    size_t _resident_bytes;
+    size_t _budget;
+
+    // card switch statistics
+    double* _latencies;
+    uint32_t _latency_count;
+    uint32_t _latency_capacity;
+    uint32_t _hits;
+}
+
+- (id)initWithCardCache:(RXCardCache*)cache;
+
+- (void)tearDown;
+
+// returns a loaded card if the card was preloaded and nil otherwise, waiting for the card if it is being loaded; the
+// card is handed over to the caller, who must release it
+- (RXCard*)newCardWithSimpleDescriptor:(RXSimpleCardDescriptor*)scd NS_RETURNS_RETAINED;
+
+// drops the preloaded copy of a card, if any, such as when the card cache supplied the card
+- (void)dropCardWithSimpleDescriptor:(RXSimpleCardDescriptor*)scd;
+
+// adds the links of a loaded card to the link graph and starts loading its neighbors, replacing the previous neighbors;
+// MUST RUN ON THE SCRIPT THREAD
+- (void)preloadNeighborsOfCard:(RXCard*)card;
+
+// the links of a card that has been entered, sorted by decreasing number of references, or nil
+- (NSData*)linksOfCardWithSimpleDescriptor:(RXSimpleCardDescriptor*)scd;
+
+- (size_t)residentBytes;
+
+- (void)recordCardSwitchLatency:(double)latency;
+- (NSArray*)cardSwitchLatencies;
+- (uint32_t)hitCount;
+- (void)resetCardSwitchStatistics;
+
+@end
@@ -0,0 +1,387 @@
+//
+//  RXCardPreloader.m
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 29/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#import "Engine/RXCardPreloader.h"
+
+#import <mach/task.h>
+#import <mach/mach_init.h>
+
+#import "Base/RXThreadUtilities.h"
+#import "Engine/RXWorldProtocol.h"
+#import "Engine/RXStack.h"
+
+
+// cards rarely link to more than a handful of cards; links past this are dropped
+#define RX_CARD_PRELOADER_MAX_LINKS 64
+
+
+@interface RXCardPreloader ()
+- (void)_preloadThread:(id)object;
+@end
+
+@implementation RXCardPreloader
+
+- (id)initWithCardCache:(RXCardCache*)cache
+{
+    self = [super init];
+    if (!self)
+        return nil;
+
+    _lock = OS_SPINLOCK_INIT;
+    _card_cache = [cache retain];
+
+    kern_return_t kerr = semaphore_create(mach_task_self(), &_wake_semaphore, SYNC_POLICY_FIFO, 0);
+    if (kerr == 0)
+        kerr = semaphore_create(mach_task_self(), &_load_semaphore, SYNC_POLICY_FIFO, 0);
+    if (kerr == 0)
+        kerr = semaphore_create(mach_task_self(), &_exit_semaphore, SYNC_POLICY_FIFO, 0);
+    if (kerr != 0)
+    {
+        [self release];
+        return nil;
+    }
+
+    _link_graphs = [NSMutableDictionary new];
+    _queue = [NSMutableArray new];
+    _cards = [NSMutableDictionary new];
+
+    // the thread retains the preloader until -tearDown stops it
+    [NSThread detachNewThreadSelector:@selector(_preloadThread:) toTarget:self withObject:nil];
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_wake_semaphore)
+        semaphore_destroy(mach_task_self(), _wake_semaphore);
+    if (_load_semaphore)
+        semaphore_destroy(mach_task_self(), _load_semaphore);
+    if (_exit_semaphore)
+        semaphore_destroy(mach_task_self(), _exit_semaphore);
+
+    [_card_cache release];
+    [_link_graphs release];
+    [_stack release];
+    [_neighbors release];
+    [_queue release];
+    [_cards release];
+    [_loading release];
+    free(_latencies);
+
+    [super dealloc];
+}
+
+- (void)tearDown
+{
+    OSSpinLockLock(&_lock);
+    _terminate = YES;
+    [_queue removeAllObjects];
+    OSSpinLockUnlock(&_lock);
+
+    semaphore_signal(_wake_semaphore);
+    semaphore_wait(_exit_semaphore);
+
+    OSSpinLockLock(&_lock);
+    [_cards removeAllObjects];
+    _resident_bytes = 0;
+    OSSpinLockUnlock(&_lock);
+}
+
+#pragma mark -
+#pragma mark preload thread
+
+- (RXCard*)_loadCardWithSimpleDescriptor:(RXSimpleCardDescriptor*)scd stack:(RXStack*)stack NS_RETURNS_RETAINED
+{
+    RXCard* card = nil;
+    @try
+    {
+        RXCardDescriptor* cd = [[RXCardDescriptor alloc] initWithStack:stack ID:scd->cardID];
+        if (!cd)
+            return nil;
+
+        card = [[RXCard alloc] initWithCardDescriptor:cd];
+        [cd release];
+
+        [card load];
+        
+        // wait for the resources that load in the background here rather than under the lock
+        [card memoryFootprint];
+    }
+    @catch (NSException* e)
+    {
+        // the card will be loaded again on the script thread if the player goes there, where the error will surface
+        RXOLog2(kRXLoggingEngine, kRXLoggingLevelError, @"failed to preload card %@ %hu: %@", scd->stackKey, scd->cardID, e);
+        [card release];
+        card = nil;
+    }
+
+    return card;
+}
+
+- (void)_preloadThread:(id)object
+{
+    // WARNING: WILL BE RUNNING ON A DEDICATED THREAD
+    RXSetThreadName("card preloader");
+
+    while (1)
+    {
+        semaphore_wait(_wake_semaphore);
+
+        while (1)
+        {
+            NSAutoreleasePool* p = [NSAutoreleasePool new];
+
+            // take the most likely card off the queue, unless the preloaded cards already fill the budget
+            OSSpinLockLock(&_lock);
+            if (_terminate || [_queue count] == 0 || _resident_bytes >= _budget)
+            {
+                [_queue removeAllObjects];
+                OSSpinLockUnlock(&_lock);
+                [p release];
+                break;
+            }
+
+            RXSimpleCardDescriptor* scd = [[_queue objectAtIndex:0] retain];
+            [_queue removeObjectAtIndex:0];
+            RXStack* stack = [_stack retain];
+            _loading = [scd retain];
+            OSSpinLockUnlock(&_lock);
+
+            RXCard* card = [self _loadCardWithSimpleDescriptor:scd stack:stack];
+
+            // keep the card if it is still a neighbor of the current card and if it fits in the budget
+            OSSpinLockLock(&_lock);
+            if (card && [_neighbors containsObject:scd] && _resident_bytes + [card memoryFootprint] <= _budget)
+            {
+                [_cards setObject:card forKey:scd];
+                _resident_bytes += [card memoryFootprint];
+            }
+            [_loading release];
+            _loading = nil;
+            OSSpinLockUnlock(&_lock);
+
+            // the card is released outside of the lock, since releasing a card frees all of its resources
+            [card release];
+            [stack release];
+            [scd release];
+
+            semaphore_signal(_load_semaphore);
+            [p release];
+        }
+
+        if (_terminate)
+            break;
+    }
+
+    semaphore_signal_all(_exit_semaphore);
+}
+
+#pragma mark -
+#pragma mark link graph
+
+- (NSData*)_linksOfCard:(RXCard*)card
+{
+    RXCardDescriptor* cd = [card descriptor];
+    NSString* stack_key = [[cd parent] key];
+    NSNumber* card_id = [NSNumber numberWithUnsignedShort:[cd ID]];
+
+    OSSpinLockLock(&_lock);
+    NSMutableDictionary* graph = [_link_graphs objectForKey:stack_key];
+    NSData* links = [[graph objectForKey:card_id] retain];
+    OSSpinLockUnlock(&_lock);
+    if (links)
+        return [links autorelease];
+
+    // the card's own programs and the programs of its hotspots are the edges of the card
+    rx_card_link_t buffer[RX_CARD_PRELOADER_MAX_LINKS];
+    uint32_t count = rx_card_links_add_script([card scripts], [cd ID], buffer, 0, RX_CARD_PRELOADER_MAX_LINKS);
+    for (RXHotspot* hotspot in [card hotspots])
+        count = rx_card_links_add_script([hotspot scripts], [cd ID], buffer, count, RX_CARD_PRELOADER_MAX_LINKS);
+    rx_card_links_sort(buffer, count);
+    links = [NSData dataWithBytes:buffer length:count * sizeof(rx_card_link_t)];
+
+    OSSpinLockLock(&_lock);
+    graph = [_link_graphs objectForKey:stack_key];
+    if (!graph)
+    {
+        graph = [NSMutableDictionary new];
+        [_link_graphs setObject:graph forKey:stack_key];
+        [graph release];
+    }
+    [graph setObject:links forKey:card_id];
+    OSSpinLockUnlock(&_lock);
+
+    return links;
+}
+
+- (NSData*)linksOfCardWithSimpleDescriptor:(RXSimpleCardDescriptor*)scd
+{
+    OSSpinLockLock(&_lock);
+    NSData* links = [[[_link_graphs objectForKey:scd->stackKey] objectForKey:[NSNumber numberWithUnsignedShort:scd->cardID]] retain];
+    OSSpinLockUnlock(&_lock);
+    return [links autorelease];
+}
+
+#pragma mark -
+#pragma mark preloading
+
+- (RXCard*)newCardWithSimpleDescriptor:(RXSimpleCardDescriptor*)scd
+{
+    OSSpinLockLock(&_lock);
+
+    // the load semaphore is signaled after every load, so it may have been signaled for loads nobody waited on; check
+    // again after every wake up
+    while ([_loading isEqual:scd])
+    {
+        OSSpinLockUnlock(&_lock);
+        semaphore_wait(_load_semaphore);
+        OSSpinLockLock(&_lock);
+    }
+
+    RXCard* card = [[_cards objectForKey:scd] retain];
+    if (card)
+    {
+        _resident_bytes -= [card memoryFootprint];
+        [_cards removeObjectForKey:scd];
+        _hits++;
+    }
+
+    OSSpinLockUnlock(&_lock);
+    return card;
+}
+
+- (void)dropCardWithSimpleDescriptor:(RXSimpleCardDescriptor*)scd
+{
+    OSSpinLockLock(&_lock);
+    [_queue removeObject:scd];
+    RXCard* card = [[_cards objectForKey:scd] retain];
+    if (card)
+    {
+        _resident_bytes -= [card memoryFootprint];
+        [_cards removeObjectForKey:scd];
+    }
+    OSSpinLockUnlock(&_lock);
+
+    // the card is released outside of the lock, since releasing a card frees all of its resources
+    [card release];
+}
+
+- (void)preloadNeighborsOfCard:(RXCard*)card
+{
+    // WARNING: MUST RUN ON THE SCRIPT THREAD
+    NSData* links = [self _linksOfCard:card];
+    RXStack* stack = [[card descriptor] parent];
+
+    BOOL enabled = RXEngineGetBool(@"rendering.card_preloading");
+    size_t budget = (size_t)RXEngineGetUInt32(@"rendering.card_preload_budget") * 1024 * 1024;
+
+    const rx_card_link_t* link = (const rx_card_link_t*)[links bytes];
+    uint32_t count = (enabled) ? (uint32_t)([links length] / sizeof(rx_card_link_t)) : 0;
+    NSMutableArray* neighbors = [[NSMutableArray alloc] initWithCapacity:count];
+    for (uint32_t i = 0; i < count; i++)
+    {
+        // the card cache will supply the cards it holds; leaving them out of the neighbors also drops their
+        // preloaded copies below
+        RXSimpleCardDescriptor* scd = [[RXSimpleCardDescriptor alloc] initWithStackKey:[stack key] ID:link[i].card_id];
+        if (![_card_cache containsCardWithSimpleDescriptor:scd])
+            [neighbors addObject:scd];
+        [scd release];
+    }
+
+    OSSpinLockLock(&_lock);
+
+    [_stack release];
+    _stack = [stack retain];
+    [_neighbors release];
+    _neighbors = [[NSSet alloc] initWithArray:neighbors];
+    _budget = budget;
+
+    // queue the neighbors that are not loaded or being loaded yet, most likely first
+    [_queue removeAllObjects];
+    for (RXSimpleCardDescriptor* scd in neighbors)
+    {
+        if (![_cards objectForKey:scd] && ![_loading isEqual:scd])
+            [_queue addObject:scd];
+    }
+
+    // drop the preloaded cards that are not neighbors of the new card; they are released outside of the lock
+    NSMutableArray* dropped_cards = [NSMutableArray array];
+    for (RXSimpleCardDescriptor* scd in [_cards allKeys])
+    {
+        if ([_neighbors containsObject:scd])
+            continue;
+
+        RXCard* dropped_card = [_cards objectForKey:scd];
+        _resident_bytes -= [dropped_card memoryFootprint];
+        [dropped_cards addObject:dropped_card];
+        [_cards removeObjectForKey:scd];
+    }
+
+    OSSpinLockUnlock(&_lock);
+
+    [neighbors release];
+
+    if (count)
+        semaphore_signal(_wake_semaphore);
+}
+
+- (size_t)residentBytes
+{
+    OSSpinLockLock(&_lock);
+    size_t resident_bytes = _resident_bytes;
+    OSSpinLockUnlock(&_lock);
+    return resident_bytes;
+}
+
+#pragma mark -
+#pragma mark statistics
+
+- (void)recordCardSwitchLatency:(double)latency
+{
+    OSSpinLockLock(&_lock);
+    if (_latency_count == _latency_capacity)
+    {
+        uint32_t capacity = (_latency_capacity) ? _latency_capacity * 2 : 256;
+        double* latencies = (double*)realloc(_latencies, capacity * sizeof(double));
+        if (!latencies)
+        {
+            OSSpinLockUnlock(&_lock);
+            return;
+        }
+        _latencies = latencies;
+        _latency_capacity = capacity;
+    }
+    _latencies[_latency_count++] = latency;
+    OSSpinLockUnlock(&_lock);
+}
+
+- (NSArray*)cardSwitchLatencies
+{
+    OSSpinLockLock(&_lock);
+    NSMutableArray* latencies = [NSMutableArray arrayWithCapacity:_latency_count];
+    for (uint32_t i = 0; i < _latency_count; i++)
+        [latencies addObject:[NSNumber numberWithDouble:_latencies[i]]];
+    OSSpinLockUnlock(&_lock);
+    return latencies;
+}
+
+- (uint32_t)hitCount
+{
+    return _hits;
+}
+
+- (void)resetCardSwitchStatistics
+{
+    OSSpinLockLock(&_lock);
+    _latency_count = 0;
+    _hits = 0;
+    OSSpinLockUnlock(&_lock);
+}
+
+@end
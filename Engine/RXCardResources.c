@@ -0,0 +1,175 @@
+/*
+ *  RXCardResources.c
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 30/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <string.h>
+
+#include "Base/RXByteSwap.h"
+#include "Engine/RXCardResources.h"
+
+
+#if defined(__LITTLE_ENDIAN__) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define SWAP_TO_HOST 1
+#else
+#define SWAP_TO_HOST 0
+#endif
+
+// SFXE frame program opcodes
+enum {
+    SFXE_OPCODE_NEXT = 1,
+    SFXE_OPCODE_COPY = 3,   // followed by a rect
+    SFXE_OPCODE_END = 4
+};
+
+static inline uint16_t read_be16(const void* p)
+{
+    const uint8_t* b = (const uint8_t*)p;
+    return (uint16_t)((b[0] << 8) | b[1]);
+}
+
+static void swap_words(uint16_t* words, size_t count)
+{
+#if SWAP_TO_HOST
+    rx_swap16_span(words, count);
+#endif
+}
+
+// the records of every list resource are made of words only, so they can be swapped as an array of words
+static bool swap_list(void* data, size_t length, size_t record_size, uint16_t* count)
+{
+    if (length < sizeof(uint16_t))
+        return false;
+    uint16_t n = read_be16(data);
+    if ((length - sizeof(uint16_t)) / record_size < n)
+        return false;
+
+    swap_words((uint16_t*)data + 1, n * record_size / sizeof(uint16_t));
+    if (count)
+        *count = n;
+    return true;
+}
+
+bool rx_card_swap_plst(void* data, size_t length, uint16_t* count)
+{
+    return swap_list(data, length, sizeof(struct rx_plst_record), count);
+}
+
+bool rx_card_swap_mlst(void* data, size_t length, uint16_t* count)
+{
+    return swap_list(data, length, sizeof(struct rx_mlst_record), count);
+}
+
+bool rx_card_swap_blst(void* data, size_t length, uint16_t* count)
+{
+    return swap_list(data, length, sizeof(struct rx_blst_record), count);
+}
+
+bool rx_card_swap_flst(void* data, size_t length, uint16_t* count)
+{
+    return swap_list(data, length, sizeof(struct rx_flst_record), count);
+}
+
+bool rx_card_swap_slst(void* data, size_t length, uint16_t* count)
+{
+    if (length < sizeof(uint16_t))
+        return false;
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint16_t n = read_be16(data);
+
+    // a record is an index, a sound count and 4 words per sound plus 5 words for the group, so the records are walked
+    // in big-endian order first, then swapped as a whole
+    size_t available = length / sizeof(uint16_t);
+    size_t i = 1;
+    for (uint16_t record = 0; record < n; record++)
+    {
+        if (available - i < 2)
+            return false;
+        size_t sound_count = read_be16(bytes + (i + 1) * sizeof(uint16_t));
+        i += 2;
+        if (available - i < 4 * sound_count + 5)
+            return false;
+        i += 4 * sound_count + 5;
+    }
+
+    swap_words((uint16_t*)data + 1, i - 1);
+    if (count)
+        *count = n;
+    return true;
+}
+
+void rx_card_swap_hspt_record(struct rx_hspt_record* record)
+{
+    swap_words((uint16_t*)record, sizeof(struct rx_hspt_record) / sizeof(uint16_t));
+}
+
+bool rx_card_swap_sfxe(void* data, size_t length)
+{
+    if (length < sizeof(struct rx_sfxe_record))
+        return false;
+
+    struct rx_sfxe_record* record = (struct rx_sfxe_record*)data;
+    uint8_t* bytes = (uint8_t*)data;
+
+    // swapping the header one field at a time measured faster than the layout kernel with both SSE2 and SSSE3
+#if SWAP_TO_HOST
+    record->magic = rx_swap_core_word(record->magic);
+    record->frame_count = rx_swap_core_word(record->frame_count);
+    record->offset_table = rx_swap32(record->offset_table);
+    record->rect = rx_swap_core_rect(record->rect);
+    record->fps = rx_swap_core_word(record->fps);
+    record->u0 = rx_swap_core_word(record->u0);
+    record->alt_rect = rx_swap_core_rect(record->alt_rect);
+    record->u1 = rx_swap_core_word(record->u1);
+    record->alt_frame_count = rx_swap_core_word(record->alt_frame_count);
+    record->u2 = rx_swap32(record->u2);
+    record->u3 = rx_swap32(record->u3);
+    record->u4 = rx_swap32(record->u4);
+    record->u5 = rx_swap32(record->u5);
+    record->u6 = rx_swap32(record->u6);
+#endif
+
+    if (record->offset_table > length || (length - record->offset_table) / sizeof(uint32_t) < record->frame_count)
+        return false;
+
+    uint8_t* offsets = bytes + record->offset_table;
+#if SWAP_TO_HOST
+    rx_swap32_span(offsets, record->frame_count);
+#endif
+
+    for (uint16_t frame = 0; frame < record->frame_count; frame++)
+    {
+        uint32_t offset;
+        memcpy(&offset, offsets + frame * sizeof(uint32_t), sizeof(offset));
+        if (offset > length || (offset & 1))
+            return false;
+
+        // a frame program is a sequence of opcodes ending with an end opcode; it is walked in big-endian order, then
+        // swapped as a whole
+        uint8_t* program = bytes + offset;
+        size_t available = (length - offset) / sizeof(uint16_t);
+        size_t i = 0;
+        while (1)
+        {
+            if (i == available)
+                return false;
+
+            uint16_t opcode = read_be16(program + i * sizeof(uint16_t));
+            if (opcode == SFXE_OPCODE_END)
+                break;
+            else if (opcode == SFXE_OPCODE_NEXT)
+                i++;
+            else if (opcode == SFXE_OPCODE_COPY && available - i > 4)
+                i += 5;
+            else
+                return false;
+        }
+        swap_words((uint16_t*)program, i + 1);
+    }
+
+    return true;
+}
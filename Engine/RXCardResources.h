@@ -0,0 +1,48 @@
+/*
+ *  RXCardResources.h
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 30/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#if !defined(RX_CARD_RESOURCES_H)
+#define RX_CARD_RESOURCES_H
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Engine/RXCoreStructures.h"
+
+//
+// Byte swapping of the card resources, which are stored big endian, into host byte order. The resources are swapped in
+// place, and every function checks the resource against its length first; a resource that is too short for the records
+// it claims to have, or an SFXE resource with a malformed frame program, is rejected.
+//
+// The list resources (PLST, MLST, BLST, FLST and SLST) are a record count followed by the records; their count is returned in
+// host byte order. The count word itself is left as it is in the resource, since the engine reads it with
+// CFSwapInt16BigToHost.
+//
+
+__BEGIN_DECLS
+
+bool rx_card_swap_plst(void* data, size_t length, uint16_t* count);
+bool rx_card_swap_mlst(void* data, size_t length, uint16_t* count);
+bool rx_card_swap_blst(void* data, size_t length, uint16_t* count);
+bool rx_card_swap_flst(void* data, size_t length, uint16_t* count);
+
+// SLST records have a variable length, with 4 words per sound in the record; every record is swapped
+bool rx_card_swap_slst(void* data, size_t length, uint16_t* count);
+
+// HSPT records are interleaved with the hotspot scripts, so they are swapped one at a time
+void rx_card_swap_hspt_record(struct rx_hspt_record* record);
+
+// swaps the SFXE header, the frame offset table and every frame's program
+bool rx_card_swap_sfxe(void* data, size_t length);
+
+__END_DECLS
+
+#endif // RX_CARD_RESOURCES_H
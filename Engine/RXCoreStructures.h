@@ -53,6 +53,12 @@ struct rx_slst_record2 {
     uint16_t u1;
 };
 
+// rx_slst_record2 fade_flags bits; the other bits are unused
+enum {
+    RX_SLST_FADE_OUT_REMOVED_SOUNDS = 0x0001,
+    RX_SLST_FADE_IN_NEW_SOUNDS = 0x0002
+};
+
 struct rx_hspt_record {
     uint16_t blst_id;
     int16_t name_rec;
@@ -94,12 +100,16 @@ struct rx_sfxe_record {
 };
 #pragma pack(pop)
 
-#endif // RX_CORE_STRUCTURES_H
+static inline uint16_t rx_swap_core_word(uint16_t w) {
+    return (uint16_t)((w << 8) | (w >> 8));
+}
 
-CF_INLINE rx_core_rect_t rx_swap_core_rect(rx_core_rect_t r) {
-    r.left = CFSwapInt16(r.left);
-    r.top = CFSwapInt16(r.top);
-    r.right = CFSwapInt16(r.right);
-    r.bottom = CFSwapInt16(r.bottom);
+static inline rx_core_rect_t rx_swap_core_rect(rx_core_rect_t r) {
+    r.left = rx_swap_core_word(r.left);
+    r.top = rx_swap_core_word(r.top);
+    r.right = rx_swap_core_word(r.right);
+    r.bottom = rx_swap_core_word(r.bottom);
     return r;
 }
+
+#endif // RX_CORE_STRUCTURES_H
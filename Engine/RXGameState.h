@@ -11,8 +11,15 @@
 #import "Engine/RXCardDescriptor.h"
 
 
+@class RXGameStateSnapshot;
+
+// game variables are stored in a dense array of slots indexed by variable ID; IDs are interned process-wide from the
+// lowercased variable names, so the same name has the same ID in every game state; the slots are copy-on-write, so
+// that a snapshot of the game state can share them until the next variable change
 @interface RXGameState : NSObject <NSCoding> {
-    NSMutableDictionary* _variables;
+    struct rx_game_state_slots* _slots;
+    OSSpinLock _slotLock;
+    
     RXSimpleCardDescriptor* _currentCard;
     RXSimpleCardDescriptor* _returnCard;
     NSURL* _URL;
@@ -21,6 +28,10 @@
 
 + (RXGameState*)gameStateWithURL:(NSURL*)url error:(NSError**)error;
 
+// returns the ID of a variable name (case-insensitive), interning it if needed
++ (uint32_t)variableIDForKey:(NSString*)key;
++ (NSString*)keyForVariableID:(uint32_t)variable;
+
 - (id)init;
 
 - (void)dump;
@@ -29,6 +40,9 @@
 - (BOOL)writeToURL:(NSURL*)url error:(NSError**)error;
 - (BOOL)writeToURL:(NSURL*)url updateURL:(BOOL)update error:(NSError**)error;
 
+// takes a snapshot of the game state in constant time; the snapshot does not change when the game state does
+- (RXGameStateSnapshot*)snapshot;
+
 - (uint16_t)unsignedShortForKey:(NSString*)key;
 - (void)setUnsignedShort:(uint16_t)value forKey:(NSString*)key;
 - (int16_t)shortForKey:(NSString*)key;
@@ -46,6 +60,10 @@
 
 - (BOOL)isKeySet:(NSString*)key;
 
+// fast variable access for the script engine; these do not send key-value observing notifications
+- (uint16_t)unsignedShortForVariable:(uint32_t)variable;
+- (void)setUnsignedShort:(uint16_t)value forVariable:(uint32_t)variable;
+
 - (RXSimpleCardDescriptor*)currentCard;
 - (void)setCurrentCard:(RXSimpleCardDescriptor*)descriptor;
 
@@ -53,3 +71,23 @@
 - (void)setReturnCard:(RXSimpleCardDescriptor*)descriptor;
 
 @end
+
+// an immutable copy of a game state, which can be encoded on any thread; save files are snapshots in a compact binary
+// format (see RXGameState.m)
+@interface RXGameStateSnapshot : NSObject {
+    struct rx_game_state_slots* _slots;
+    RXSimpleCardDescriptor* _currentCard;
+    RXSimpleCardDescriptor* _returnCard;
+}
+
+- (NSData*)data;
+- (BOOL)writeToURL:(NSURL*)url error:(NSError**)error;
+
+// writes the snapshot on the background writer thread, which writes one snapshot at a time; a snapshot still waiting
+// to be written to the same URL is dropped, since it is older; errors are logged
+- (void)writeToURLInBackground:(NSURL*)url;
+
+// waits until every snapshot queued with -writeToURLInBackground: has been written, e.g. before quitting
++ (void)waitForBackgroundWrites;
+
+@end
@@ -7,15 +7,184 @@
 //
 
 #import "Engine/RXGameState.h"
+
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSLock.h>
+#import <Foundation/NSThread.h>
+
+#import "Base/RXThreadUtilities.h"
 #import "Engine/RXWorldProtocol.h"
+#import "Engine/RXRivenSave.h"
 #import "Base/RXErrorMacros.h"
 
 
 static const int RX_GAME_STATE_CURRENT_VERSION = 4;
 
+// save files are written in a compact binary format, all little-endian:
+//
+//  header:     'RXGS', uint32 format version
+//  cards:      the current card, then the return card, each a uint8 stack key length (0 if there is no card), the
+//              UTF-8 stack key and a uint16 card ID
+//  variables:  uint32 variable count, then for each variable a uint8 type, a uint16 name length, the UTF-8 name and
+//              the value in 2, 4 or 8 bytes depending on the type
+//
+// keyed archives (see -encodeWithCoder:) are still read, for older save files
+static const char RX_GAME_STATE_BINARY_MAGIC[4] = {'R', 'X', 'G', 'S'};
+static const uint32_t RX_GAME_STATE_BINARY_VERSION = 1;
+
 // 1-2-3-4-5
 static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 << 21) | (1 << 20);
 
+// slot types, used to rebuild the same NSNumber types when the variables are archived
+enum {
+    kVariableTypeUnset = 0,
+    kVariableTypeUnsignedShort,
+    kVariableTypeShort,
+    kVariableTypeUnsigned32,
+    kVariableTypeSigned32,
+    kVariableTypeUnsigned64,
+    kVariableTypeSigned64,
+};
+
+// variable ID registry
+static NSMutableDictionary* _variableIDs = nil;
+static NSMutableArray* _variableKeys = nil;
+static OSSpinLock _variableRegistryLock = OS_SPINLOCK_INIT;
+
+// reference-counted variable slots; a game state copies its slots before changing them if a snapshot shares them
+struct rx_game_state_slots {
+    int32_t refcount;
+    uint32_t count;
+    uint8_t* types;
+    uint64_t values[];
+};
+
+static struct rx_game_state_slots* rx_game_state_slots_create(uint32_t count) {
+    struct rx_game_state_slots* slots = (struct rx_game_state_slots*)malloc(sizeof(struct rx_game_state_slots) +
+                                                                            count * (sizeof(uint64_t) + sizeof(uint8_t)));
+    release_assert(slots);
+    slots->refcount = 1;
+    slots->count = count;
+    slots->types = (uint8_t*)(slots->values + count);
+    return slots;
+}
+
+static struct rx_game_state_slots* rx_game_state_slots_retain(struct rx_game_state_slots* slots) {
+    OSAtomicIncrement32Barrier(&slots->refcount);
+    return slots;
+}
+
+static void rx_game_state_slots_release(struct rx_game_state_slots* slots) {
+    if (slots && OSAtomicDecrement32Barrier(&slots->refcount) == 0)
+        free(slots);
+}
+
+// little-endian readers and writers for the binary save format
+struct rx_game_state_reader {
+    const uint8_t* p;
+    size_t remaining;
+};
+
+static BOOL rx_game_state_read(struct rx_game_state_reader* reader, void* buffer, size_t length) {
+    if (reader->remaining < length)
+        return NO;
+    memcpy(buffer, reader->p, length);
+    reader->p += length;
+    reader->remaining -= length;
+    return YES;
+}
+
+static BOOL rx_game_state_read_uint(struct rx_game_state_reader* reader, size_t length, uint64_t* value) {
+    uint8_t bytes[8];
+    if (!rx_game_state_read(reader, bytes, length))
+        return NO;
+    *value = 0;
+    for (size_t i = 0; i < length; i++)
+        *value |= (uint64_t)bytes[i] << (8 * i);
+    return YES;
+}
+
+static NSString* rx_game_state_read_string(struct rx_game_state_reader* reader, size_t length) {
+    if (reader->remaining < length)
+        return nil;
+    NSString* string = [[[NSString alloc] initWithBytes:reader->p length:length encoding:NSUTF8StringEncoding] autorelease];
+    reader->p += length;
+    reader->remaining -= length;
+    return string;
+}
+
+static void rx_game_state_append_uint(NSMutableData* data, size_t length, uint64_t value) {
+    uint8_t bytes[8];
+    for (size_t i = 0; i < length; i++)
+        bytes[i] = (uint8_t)(value >> (8 * i));
+    [data appendBytes:bytes length:length];
+}
+
+static void rx_game_state_append_card(NSMutableData* data, RXSimpleCardDescriptor* card) {
+    NSData* key = (card) ? [card->stackKey dataUsingEncoding:NSUTF8StringEncoding] : nil;
+    if (!key || [key length] > UINT8_MAX) {
+        rx_game_state_append_uint(data, 1, 0);
+        rx_game_state_append_uint(data, 2, 0);
+        return;
+    }
+    
+    rx_game_state_append_uint(data, 1, [key length]);
+    [data appendData:key];
+    rx_game_state_append_uint(data, 2, card->cardID);
+}
+
+// size in bytes of the values of a slot type in the binary save format
+static size_t rx_game_state_value_size(uint8_t type) {
+    switch (type) {
+        case kVariableTypeUnsignedShort:
+        case kVariableTypeShort:
+            return 2;
+        case kVariableTypeUnsigned32:
+        case kVariableTypeSigned32:
+            return 4;
+        case kVariableTypeUnsigned64:
+        case kVariableTypeSigned64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+// sign-extends a value read from the binary save format to the slot representation
+static uint64_t rx_game_state_extend_value(uint8_t type, uint64_t value) {
+    switch (type) {
+        case kVariableTypeShort:
+            return (uint64_t)(int64_t)(int16_t)value;
+        case kVariableTypeSigned32:
+            return (uint64_t)(int64_t)(int32_t)value;
+        default:
+            return value;
+    }
+}
+
+@interface RXGameState ()
+- (id)_initWithData:(NSData*)data error:(NSError**)error;
+- (id)_initWithRivenSave:(NSData*)data error:(NSError**)error;
+@end
+
+@interface RXGameStateSnapshot ()
+- (id)_initWithSlots:(struct rx_game_state_slots*)slots currentCard:(RXSimpleCardDescriptor*)currentCard returnCard:(RXSimpleCardDescriptor*)returnCard;
+@end
+
+// the serial writer behind -[RXGameStateSnapshot writeToURLInBackground:]; every queued snapshot gets a generation, and
+// the writer thread reports the last generation it has written
+@interface RXGameStateWriter : NSObject {
+    NSCondition* _condition;
+    NSMutableDictionary* _pending;
+    uint64_t _queuedGeneration;
+    uint64_t _writtenGeneration;
+}
+
++ (RXGameStateWriter*)sharedWriter;
+- (void)queueSnapshot:(RXGameStateSnapshot*)snapshot URL:(NSURL*)url;
+- (void)waitUntilDone;
+@end
+
 
 @implementation RXGameState
 
@@ -24,6 +193,45 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
     return NO;
 }
 
++ (void)initialize {
+    if (self == [RXGameState class]) {
+        _variableIDs = [NSMutableDictionary new];
+        _variableKeys = [NSMutableArray new];
+    }
+}
+
++ (uint32_t)variableIDForKey:(NSString*)key {
+    // variable names are almost always lowercase already, so try the key as-is before lowercasing it
+    OSSpinLockLock(&_variableRegistryLock);
+    NSNumber* n = [_variableIDs objectForKey:key];
+    OSSpinLockUnlock(&_variableRegistryLock);
+    if (n)
+        return [n unsignedIntValue];
+    
+    key = [key lowercaseString];
+    
+    OSSpinLockLock(&_variableRegistryLock);
+    n = [_variableIDs objectForKey:key];
+    uint32_t variable;
+    if (n)
+        variable = [n unsignedIntValue];
+    else {
+        variable = (uint32_t)[_variableKeys count];
+        [_variableKeys addObject:key];
+        [_variableIDs setObject:[NSNumber numberWithUnsignedInt:variable] forKey:key];
+    }
+    OSSpinLockUnlock(&_variableRegistryLock);
+    
+    return variable;
+}
+
++ (NSString*)keyForVariableID:(uint32_t)variable {
+    OSSpinLockLock(&_variableRegistryLock);
+    NSString* key = (variable < [_variableKeys count]) ? [[[_variableKeys objectAtIndex:variable] retain] autorelease] : nil;
+    OSSpinLockUnlock(&_variableRegistryLock);
+    return key;
+}
+
 + (RXGameState*)gameStateWithURL:(NSURL*)url error:(NSError**)error
 {
     // read the data in
@@ -34,6 +242,20 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
         return nil;
     }
     
+    // binary save files
+    if ([archive length] >= sizeof(RX_GAME_STATE_BINARY_MAGIC) &&
+        memcmp([archive bytes], RX_GAME_STATE_BINARY_MAGIC, sizeof(RX_GAME_STATE_BINARY_MAGIC)) == 0)
+    {
+        RXGameState* gameState = [[[RXGameState alloc] _initWithData:archive error:error] autorelease];
+        if (gameState)
+            gameState->_URL = [url retain];
+        return gameState;
+    }
+    
+    // save files of the original engine; they have no URL, since they are never written back
+    if ([archive length] >= 4 && memcmp([archive bytes], "MHWK", 4) == 0)
+        return [[[RXGameState alloc] _initWithRivenSave:archive error:error] autorelease];
+    
     // use a keyed unarchiver to unfreeze a new game state object
     RXGameState* gameState = nil;
     @try
@@ -69,6 +291,147 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
     return gameState;
 }
 
+// must be called with the slot lock held; makes the slots private to the game state and large enough for variable
+static void rx_game_state_make_writable(RXGameState* state, uint32_t variable) {
+    struct rx_game_state_slots* slots = state->_slots;
+    
+    // snapshots only take references with the slot lock held, so a reference count of 1 cannot change under us
+    if (slots->refcount == 1 && variable < slots->count)
+        return;
+    
+    uint32_t count = slots->count;
+    if (variable >= count)
+        count = MAX(MAX(variable + 1, count * 2), 256u);
+    
+    struct rx_game_state_slots* copy = rx_game_state_slots_create(count);
+    memcpy(copy->values, slots->values, slots->count * sizeof(uint64_t));
+    memset(copy->values + slots->count, 0, (count - slots->count) * sizeof(uint64_t));
+    memcpy(copy->types, slots->types, slots->count * sizeof(uint8_t));
+    memset(copy->types + slots->count, kVariableTypeUnset, count - slots->count);
+    
+    state->_slots = copy;
+    rx_game_state_slots_release(slots);
+}
+
+// returns the raw value of a variable; a variable that is not set is set to 0 with the given type, like the original
+// dictionary implementation did
+static uint64_t rx_game_state_get(RXGameState* state, uint32_t variable, uint8_t type) {
+    OSSpinLockLock(&state->_slotLock);
+    struct rx_game_state_slots* slots = state->_slots;
+    if (variable >= slots->count || slots->types[variable] == kVariableTypeUnset) {
+        rx_game_state_make_writable(state, variable);
+        slots = state->_slots;
+        slots->types[variable] = type;
+    }
+    uint64_t value = slots->values[variable];
+    OSSpinLockUnlock(&state->_slotLock);
+    return value;
+}
+
+// signed values must be sign-extended to 64 bits by the caller so that they read back the way NSNumber converts them
+static void rx_game_state_set(RXGameState* state, uint32_t variable, uint8_t type, uint64_t value) {
+    OSSpinLockLock(&state->_slotLock);
+    rx_game_state_make_writable(state, variable);
+    state->_slots->types[variable] = type;
+    state->_slots->values[variable] = value;
+    OSSpinLockUnlock(&state->_slotLock);
+}
+
+// sets a variable to a 32-bit value from an original engine save, keeping the type the variable already has
+static void rx_game_state_import(RXGameState* state, uint32_t variable, uint32_t value) {
+    OSSpinLockLock(&state->_slotLock);
+    rx_game_state_make_writable(state, variable);
+    struct rx_game_state_slots* slots = state->_slots;
+    if (slots->types[variable] == kVariableTypeUnset)
+        slots->types[variable] = kVariableTypeUnsigned32;
+    slots->values[variable] = rx_game_state_extend_value(slots->types[variable], value);
+    OSSpinLockUnlock(&state->_slotLock);
+}
+
+static NSNumber* rx_game_state_slot_number(const struct rx_game_state_slots* slots, uint32_t variable) {
+    uint64_t value = slots->values[variable];
+    switch (slots->types[variable]) {
+        case kVariableTypeUnsignedShort:
+            return [NSNumber numberWithUnsignedShort:(uint16_t)value];
+        case kVariableTypeShort:
+            return [NSNumber numberWithShort:(int16_t)value];
+        case kVariableTypeUnsigned32:
+            return [NSNumber numberWithUnsignedInt:(uint32_t)value];
+        case kVariableTypeSigned32:
+            return [NSNumber numberWithInt:(int32_t)value];
+        case kVariableTypeUnsigned64:
+            return [NSNumber numberWithUnsignedLongLong:value];
+        case kVariableTypeSigned64:
+            return [NSNumber numberWithLongLong:(int64_t)value];
+        default:
+            return nil;
+    }
+}
+
+static NSDictionary* rx_game_state_slots_dictionary(const struct rx_game_state_slots* slots) {
+    OSSpinLockLock(&_variableRegistryLock);
+    NSArray* keys = [_variableKeys copy];
+    OSSpinLockUnlock(&_variableRegistryLock);
+    
+    NSMutableDictionary* variables = [NSMutableDictionary dictionary];
+    uint32_t count = MIN(slots->count, (uint32_t)[keys count]);
+    for (uint32_t variable = 0; variable < count; variable++) {
+        NSNumber* n = rx_game_state_slot_number(slots, variable);
+        if (n)
+            [variables setObject:n forKey:[keys objectAtIndex:variable]];
+    }
+    
+    [keys release];
+    return variables;
+}
+
+- (void)_setVariablesWithDictionary:(NSDictionary*)variables {
+    NSEnumerator* keys = [variables keyEnumerator];
+    NSString* key;
+    while ((key = [keys nextObject])) {
+        NSNumber* n = [variables objectForKey:key];
+        if (![n isKindOfClass:[NSNumber class]])
+            continue;
+        
+        uint32_t variable = [RXGameState variableIDForKey:key];
+        switch (*[n objCType]) {
+            case 'S':
+                rx_game_state_set(self, variable, kVariableTypeUnsignedShort, [n unsignedShortValue]);
+                break;
+            case 's':
+                rx_game_state_set(self, variable, kVariableTypeShort, (int64_t)[n shortValue]);
+                break;
+            case 'I':
+            case 'L':
+                rx_game_state_set(self, variable, kVariableTypeUnsigned32, [n unsignedIntValue]);
+                break;
+            case 'i':
+            case 'l':
+            case 'c':
+            case 'C':
+                rx_game_state_set(self, variable, kVariableTypeSigned32, (int64_t)[n intValue]);
+                break;
+            case 'Q':
+                rx_game_state_set(self, variable, kVariableTypeUnsigned64, [n unsignedLongLongValue]);
+                break;
+            default:
+                rx_game_state_set(self, variable, kVariableTypeSigned64, (uint64_t)[n longLongValue]);
+                break;
+        }
+    }
+}
+
+- (NSDictionary*)_variablesDictionary {
+    // the dictionary is built from a reference to the slots, so that the slot lock is not held while it is built
+    OSSpinLockLock(&_slotLock);
+    struct rx_game_state_slots* slots = rx_game_state_slots_retain(_slots);
+    OSSpinLockUnlock(&_slotLock);
+    
+    NSDictionary* variables = rx_game_state_slots_dictionary(slots);
+    rx_game_state_slots_release(slots);
+    return variables;
+}
+
 - (uint32_t)_generateDomeCombination {
     uint8_t domecombo1 = random() % 25;
     
@@ -159,18 +522,22 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
                                      userInfo:[NSDictionary dictionaryWithObject:error forKey:NSUnderlyingErrorKey]];
     }
     
+    _slots = rx_game_state_slots_create(0);
+    _slotLock = OS_SPINLOCK_INIT;
+    
     NSString* error_str = nil;
-    _variables = [[NSPropertyListSerialization propertyListFromData:defaultVarData
-                                                   mutabilityOption:NSPropertyListMutableContainers
-                                                             format:NULL
-                                                   errorDescription:&error_str] retain];
-    if (!_variables) {
+    NSDictionary* variables = [NSPropertyListSerialization propertyListFromData:defaultVarData
+                                                               mutabilityOption:NSPropertyListImmutable
+                                                                         format:NULL
+                                                               errorDescription:&error_str];
+    if (!variables) {
         [self release];
         @throw [NSException exceptionWithName:@"RXInvalidDefaultEngineVariablesException"
                                        reason:@"Unable to load the default engine variables."
                                      userInfo:[NSDictionary dictionaryWithObject:error_str forKey:@"RXErrorString"]];
     }
     [error_str release];
+    [self _setVariablesWithDictionary:variables];
     
     // generate random combinations for the game
     [self _generateCombinations];
@@ -192,6 +559,8 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
         return nil;
     
     _accessLock = [NSRecursiveLock new];
+    _slots = rx_game_state_slots_create(0);
+    _slotLock = OS_SPINLOCK_INIT;
 
     if (![decoder containsValueForKey:@"VERSION"]) {
         [self release];
@@ -227,7 +596,7 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
                                                reason:@"Riven X does not understand the save file. It may be corrupted or may not be a Riven X save file at all."
                                              userInfo:nil];
             }
-            _variables = [[decoder decodeObjectForKey:@"variables"] retain];
+            [self _setVariablesWithDictionary:[decoder decodeObjectForKey:@"variables"]];
             
             break;
         
@@ -245,6 +614,112 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
     return self;
 }
 
+- (RXSimpleCardDescriptor*)_readCardDescriptor:(struct rx_game_state_reader*)reader valid:(BOOL*)valid {
+    uint64_t key_length, card_id;
+    if (!rx_game_state_read_uint(reader, 1, &key_length)) {
+        *valid = NO;
+        return nil;
+    }
+    NSString* stack_key = rx_game_state_read_string(reader, (size_t)key_length);
+    if (!stack_key || !rx_game_state_read_uint(reader, 2, &card_id)) {
+        *valid = NO;
+        return nil;
+    }
+    
+    if (key_length == 0)
+        return nil;
+    return [[[RXSimpleCardDescriptor alloc] initWithStackKey:stack_key ID:(uint16_t)card_id] autorelease];
+}
+
+- (id)_initWithData:(NSData*)data error:(NSError**)error {
+    self = [super init];
+    if (!self)
+        return nil;
+    
+    _accessLock = [NSRecursiveLock new];
+    _slots = rx_game_state_slots_create(0);
+    _slotLock = OS_SPINLOCK_INIT;
+    
+    struct rx_game_state_reader reader = {(const uint8_t*)[data bytes], [data length]};
+    reader.p += sizeof(RX_GAME_STATE_BINARY_MAGIC);
+    reader.remaining -= sizeof(RX_GAME_STATE_BINARY_MAGIC);
+    
+    uint64_t version = 0;
+    BOOL valid = rx_game_state_read_uint(&reader, 4, &version) && version == RX_GAME_STATE_BINARY_VERSION;
+    
+    if (valid)
+        _currentCard = [[self _readCardDescriptor:&reader valid:&valid] retain];
+    if (valid)
+        _returnCard = [[self _readCardDescriptor:&reader valid:&valid] retain];
+    
+    uint64_t count = 0;
+    valid = valid && _currentCard && rx_game_state_read_uint(&reader, 4, &count);
+    for (uint64_t i = 0; valid && i < count; i++) {
+        uint64_t type, name_length, value;
+        valid = rx_game_state_read_uint(&reader, 1, &type) && rx_game_state_value_size((uint8_t)type) &&
+                rx_game_state_read_uint(&reader, 2, &name_length);
+        
+        NSString* name = (valid) ? rx_game_state_read_string(&reader, (size_t)name_length) : nil;
+        valid = name && rx_game_state_read_uint(&reader, rx_game_state_value_size((uint8_t)type), &value);
+        if (valid)
+            rx_game_state_set(self, [RXGameState variableIDForKey:name], (uint8_t)type, rx_game_state_extend_value((uint8_t)type, value));
+    }
+    
+    if (!valid || reader.remaining) {
+        [self release];
+        ReturnValueWithError(nil, RXErrorDomain, 0,
+                             ([NSDictionary dictionaryWithObject:@"Riven X does not understand the save file. It may be corrupted or may not be a Riven X save file at all."
+                                                          forKey:NSLocalizedDescriptionKey]),
+                             error);
+    }
+    
+    return self;
+}
+
+static void rx_game_state_import_variable(void* context, uint32_t index, const char* name, size_t name_length, uint32_t value) {
+    // the variables past the end of the name list are not used by the engine
+    if (!name)
+        return;
+    
+    NSString* key = [[NSString alloc] initWithBytes:name length:name_length encoding:NSASCIIStringEncoding];
+    if (key) {
+        rx_game_state_import((RXGameState*)context, [RXGameState variableIDForKey:key], value);
+        [key release];
+    }
+}
+
+- (id)_initWithRivenSave:(NSData*)data error:(NSError**)error {
+    // start from a new game, for the variables the original engine does not save
+    self = [self init];
+    if (!self)
+        return nil;
+    
+    int save_error = rx_riven_save_read_variables([data bytes], [data length], rx_game_state_import_variable, self);
+    if (save_error != kRXRivenSaveNoError) {
+        RXLog(kRXLoggingEngine, kRXLoggingLevelError, @"failed to import an original engine save: %s", rx_riven_save_error_description(save_error));
+        [self release];
+        ReturnValueWithError(nil, RXErrorDomain, 0,
+                             ([NSDictionary dictionaryWithObject:@"Riven X does not understand the save file. It may be corrupted or may not be a Riven X save file at all."
+                                                          forKey:NSLocalizedDescriptionKey]),
+                             error);
+    }
+    
+    // the current card is saved as a stack ID and a card ID
+    uint16_t stack_id = [self unsignedShortForKey:@"currentstackid"];
+    NSDictionary* stack_descriptors = [NSDictionary dictionaryWithContentsOfFile:[[NSBundle mainBundle] pathForResource:@"Stacks" ofType:@"plist"]];
+    for (NSString* stack_key in stack_descriptors) {
+        if ([[[stack_descriptors objectForKey:stack_key] objectForKey:@"ID"] unsignedShortValue] != stack_id)
+            continue;
+        
+        RXSimpleCardDescriptor* scd = [[RXSimpleCardDescriptor alloc] initWithStackKey:stack_key ID:[self unsignedShortForKey:@"currentcardid"]];
+        [self setCurrentCard:scd];
+        [scd release];
+        break;
+    }
+    
+    return self;
+}
+
 - (void)encodeWithCoder:(NSCoder*)encoder {
     if (![encoder allowsKeyedCoding])
         @throw [NSException exceptionWithName:NSInvalidArgumentException
@@ -257,7 +732,7 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
     
     [encoder encodeObject:_currentCard forKey:@"currentCard"];
     [encoder encodeObject:_returnCard forKey:@"returnCard"];
-    [encoder encodeObject:_variables forKey:@"variables"];
+    [encoder encodeObject:[self _variablesDictionary] forKey:@"variables"];
     
     [_accessLock unlock];
 }
@@ -265,7 +740,7 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
 - (void)dealloc {
     [[NSNotificationCenter defaultCenter] removeObserver:self];
     
-    [_variables release];
+    rx_game_state_slots_release(_slots);
     [_currentCard release];
     [_returnCard release];
     [_URL release];
@@ -275,7 +750,7 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
 }
 
 - (void)dump {
-    RXOLog(@"dumping\n%@", _variables);
+    RXOLog(@"dumping\n%@", [self _variablesDictionary]);
 }
 
 - (NSURL*)URL {
@@ -287,17 +762,8 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
 }
 
 - (BOOL)writeToURL:(NSURL*)url updateURL:(BOOL)update error:(NSError**)error {
-    // serialize ourselves as data
-    NSData* gameStateData = [NSKeyedArchiver archivedDataWithRootObject:self];
-    if (!gameStateData)
-        ReturnValueWithError(NO,
-                             RXErrorDomain,
-                             0,
-                             ([NSDictionary dictionaryWithObject:@"Riven X was unable to prepare the game to be saved." forKey:NSLocalizedDescriptionKey]),
-                             error);
-    
-    // write the data
-    BOOL success = [gameStateData writeToURL:url options:NSAtomicWrite error:error];
+    // serialize a snapshot, so that the game state is only locked while the snapshot is taken
+    BOOL success = [[self snapshot] writeToURL:url error:error];
     
     // if we were successful, update our internal URL (if update is YES)
     if (success && update && url != _URL) {
@@ -308,34 +774,21 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
     return success;
 }
 
-- (uint16_t)unsignedShortForKey:(NSString*)key {
-    key = [key lowercaseString];
-    uint16_t v = 0;
-    
+- (RXGameStateSnapshot*)snapshot {
     [_accessLock lock];
-    NSNumber* n = [_variables objectForKey:key];
-    if (n)
-        v = [n unsignedShortValue];
-    else
-        [self setUnsignedShort:0 forKey:key];
+    OSSpinLockLock(&_slotLock);
+    struct rx_game_state_slots* slots = rx_game_state_slots_retain(_slots);
+    OSSpinLockUnlock(&_slotLock);
+    
+    RXGameStateSnapshot* snapshot = [[RXGameStateSnapshot alloc] _initWithSlots:slots currentCard:_currentCard returnCard:_returnCard];
     [_accessLock unlock];
     
-    return v;
+    rx_game_state_slots_release(slots);
+    return [snapshot autorelease];
 }
 
-- (int16_t)shortForKey:(NSString*)key {
-    key = [key lowercaseString];
-    int16_t v = 0;
-    
-    [_accessLock lock];
-    NSNumber* n = [_variables objectForKey:key];
-    if (n)
-        v = [n shortValue];
-    else
-        [self setShort:0 forKey:key];
-    [_accessLock unlock];
-    
-    return v;
+- (uint16_t)unsignedShortForKey:(NSString*)key {
+    return (uint16_t)rx_game_state_get(self, [RXGameState variableIDForKey:key], kVariableTypeUnsignedShort);
 }
 
 - (void)setUnsignedShort:(uint16_t)value forKey:(NSString*)key {
@@ -344,52 +797,26 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
     RXOLog2(kRXLoggingEngine, kRXLoggingLevelDebug, @"setting variable %@ to %hu", key, value);
 #endif
     [self willChangeValueForKey:key];
-    [_accessLock lock];
-    [_variables setObject:[NSNumber numberWithUnsignedShort:value] forKey:key];
-    [_accessLock unlock];
+    rx_game_state_set(self, [RXGameState variableIDForKey:key], kVariableTypeUnsignedShort, value);
     [self didChangeValueForKey:key];
 }
 
+- (int16_t)shortForKey:(NSString*)key {
+    return (int16_t)rx_game_state_get(self, [RXGameState variableIDForKey:key], kVariableTypeShort);
+}
+
 - (void)setShort:(int16_t)value forKey:(NSString*)key {
     key = [key lowercaseString];
 #if defined(DEBUG)
     RXOLog2(kRXLoggingEngine, kRXLoggingLevelDebug, @"setting variable %@ to %hd", key, value);
 #endif
     [self willChangeValueForKey:key];
-    [_accessLock lock];
-    [_variables setObject:[NSNumber numberWithShort:value] forKey:key];
-    [_accessLock unlock];
+    rx_game_state_set(self, [RXGameState variableIDForKey:key], kVariableTypeShort, (uint64_t)(int64_t)value);
     [self didChangeValueForKey:key];
 }
 
 - (uint32_t)unsigned32ForKey:(NSString*)key {
-    key = [key lowercaseString];
-    uint32_t v = 0;
-    
-    [_accessLock lock];
-    NSNumber* n = [_variables objectForKey:key];
-    if (n)
-        v = [n unsignedIntValue];
-    else
-        [self setUnsigned32:0 forKey:key];
-    [_accessLock unlock];
-    
-    return v;
-}
-
-- (int32_t)signed32ForKey:(NSString*)key {
-    key = [key lowercaseString];
-    int32_t v = 0;
-    
-    [_accessLock lock];
-    NSNumber* n = [_variables objectForKey:key];
-    if (n)
-        v = [n intValue];
-    else
-        [self setSigned32:0 forKey:key];
-    [_accessLock unlock];
-    
-    return v;
+    return (uint32_t)rx_game_state_get(self, [RXGameState variableIDForKey:key], kVariableTypeUnsigned32);
 }
 
 - (void)setUnsigned32:(uint32_t)value forKey:(NSString*)key {
@@ -398,52 +825,26 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
     RXOLog2(kRXLoggingEngine, kRXLoggingLevelDebug, @"setting variable %@ to %u", key, value);
 #endif
     [self willChangeValueForKey:key];
-    [_accessLock lock];
-    [_variables setObject:[NSNumber numberWithUnsignedInt:value] forKey:key];
-    [_accessLock unlock];
+    rx_game_state_set(self, [RXGameState variableIDForKey:key], kVariableTypeUnsigned32, value);
     [self didChangeValueForKey:key];
 }
 
+- (int32_t)signed32ForKey:(NSString*)key {
+    return (int32_t)rx_game_state_get(self, [RXGameState variableIDForKey:key], kVariableTypeSigned32);
+}
+
 - (void)setSigned32:(int32_t)value forKey:(NSString*)key {
     key = [key lowercaseString];
 #if defined(DEBUG)
     RXOLog2(kRXLoggingEngine, kRXLoggingLevelDebug, @"setting variable %@ to %d", key, value);
 #endif
     [self willChangeValueForKey:key];
-    [_accessLock lock];
-    [_variables setObject:[NSNumber numberWithInt:value] forKey:key];
-    [_accessLock unlock];
+    rx_game_state_set(self, [RXGameState variableIDForKey:key], kVariableTypeSigned32, (uint64_t)(int64_t)value);
     [self didChangeValueForKey:key];
 }
 
 - (uint64_t)unsigned64ForKey:(NSString*)key {
-    key = [key lowercaseString];
-    uint64_t v = 0;
-    
-    [_accessLock lock];
-    NSNumber* n = [_variables objectForKey:key];
-    if (n)
-        v = [n unsignedLongLongValue];
-    else
-        [self setUnsigned64:0 forKey:key];
-    [_accessLock unlock];
-    
-    return v;
-}
-
-- (int64_t)signed64ForKey:(NSString*)key {
-    key = [key lowercaseString];
-    int64_t v = 0;
-    
-    [_accessLock lock];
-    NSNumber* n = [_variables objectForKey:key];
-    if (n)
-        v = [n longLongValue];
-    else
-        [self setSigned32:0 forKey:key];
-    [_accessLock unlock];
-    
-    return v;
+    return (uint64_t)rx_game_state_get(self, [RXGameState variableIDForKey:key], kVariableTypeUnsigned64);
 }
 
 - (void)setUnsigned64:(uint64_t)value forKey:(NSString*)key {
@@ -452,32 +853,43 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
     RXOLog2(kRXLoggingEngine, kRXLoggingLevelDebug, @"setting variable %@ to %llu", key, value);
 #endif
     [self willChangeValueForKey:key];
-    [_accessLock lock];
-    [_variables setObject:[NSNumber numberWithUnsignedLongLong:value] forKey:key];
-    [_accessLock unlock];
+    rx_game_state_set(self, [RXGameState variableIDForKey:key], kVariableTypeUnsigned64, value);
     [self didChangeValueForKey:key];
 }
 
+- (int64_t)signed64ForKey:(NSString*)key {
+    return (int64_t)rx_game_state_get(self, [RXGameState variableIDForKey:key], kVariableTypeSigned64);
+}
+
 - (void)setSigned64:(int64_t)value forKey:(NSString*)key {
     key = [key lowercaseString];
 #if defined(DEBUG)
     RXOLog2(kRXLoggingEngine, kRXLoggingLevelDebug, @"setting variable %@ to %lld", key, value);
 #endif
     [self willChangeValueForKey:key];
-    [_accessLock lock];
-    [_variables setObject:[NSNumber numberWithLongLong:value] forKey:key];
-    [_accessLock unlock];
+    rx_game_state_set(self, [RXGameState variableIDForKey:key], kVariableTypeSigned64, (uint64_t)(int64_t)value);
     [self didChangeValueForKey:key];
 }
 
 - (BOOL)isKeySet:(NSString*)key {
-    key = [key lowercaseString];
-    [_accessLock lock];
-    BOOL b = ([_variables objectForKey:key]) ? YES : NO;
-    [_accessLock unlock];
+    uint32_t variable = [RXGameState variableIDForKey:key];
+    OSSpinLockLock(&_slotLock);
+    BOOL b = (variable < _slots->count && _slots->types[variable] != kVariableTypeUnset) ? YES : NO;
+    OSSpinLockUnlock(&_slotLock);
     return b;
 }
 
+- (uint16_t)unsignedShortForVariable:(uint32_t)variable {
+    return (uint16_t)rx_game_state_get(self, variable, kVariableTypeUnsignedShort);
+}
+
+- (void)setUnsignedShort:(uint16_t)value forVariable:(uint32_t)variable {
+#if defined(DEBUG)
+    RXOLog2(kRXLoggingEngine, kRXLoggingLevelDebug, @"setting variable %@ to %hu", [RXGameState keyForVariableID:variable], value);
+#endif
+    rx_game_state_set(self, variable, kVariableTypeUnsignedShort, value);
+}
+
 - (RXSimpleCardDescriptor*)currentCard {
     [_accessLock lock];
     RXSimpleCardDescriptor* card = _currentCard;
@@ -526,3 +938,171 @@ static const uint32_t domecombo_bad1 = (1 << 24) | (1 << 23) | (1 << 22) | (1 <<
 }
 
 @end
+
+@implementation RXGameStateSnapshot
+
++ (BOOL)accessInstanceVariablesDirectly {
+    return NO;
+}
+
+- (id)init {
+    [self doesNotRecognizeSelector:_cmd];
+    [self release];
+    return nil;
+}
+
+- (id)_initWithSlots:(struct rx_game_state_slots*)slots currentCard:(RXSimpleCardDescriptor*)currentCard returnCard:(RXSimpleCardDescriptor*)returnCard {
+    self = [super init];
+    if (!self)
+        return nil;
+    
+    // card descriptors are never changed once they have been created
+    _slots = rx_game_state_slots_retain(slots);
+    _currentCard = [currentCard retain];
+    _returnCard = [returnCard retain];
+    
+    return self;
+}
+
+- (void)dealloc {
+    rx_game_state_slots_release(_slots);
+    [_currentCard release];
+    [_returnCard release];
+    
+    [super dealloc];
+}
+
+- (NSData*)data {
+    OSSpinLockLock(&_variableRegistryLock);
+    NSArray* keys = [_variableKeys copy];
+    OSSpinLockUnlock(&_variableRegistryLock);
+    
+    // a few hundred variables with short names
+    NSMutableData* data = [NSMutableData dataWithCapacity:4096];
+    [data appendBytes:RX_GAME_STATE_BINARY_MAGIC length:sizeof(RX_GAME_STATE_BINARY_MAGIC)];
+    rx_game_state_append_uint(data, 4, RX_GAME_STATE_BINARY_VERSION);
+    rx_game_state_append_card(data, _currentCard);
+    rx_game_state_append_card(data, _returnCard);
+    
+    // the variable count is patched in once the variables have been written
+    NSUInteger count_offset = [data length];
+    rx_game_state_append_uint(data, 4, 0);
+    
+    uint32_t count = 0;
+    uint32_t slot_count = MIN(_slots->count, (uint32_t)[keys count]);
+    for (uint32_t variable = 0; variable < slot_count; variable++) {
+        uint8_t type = _slots->types[variable];
+        size_t value_size = rx_game_state_value_size(type);
+        NSData* name = [[keys objectAtIndex:variable] dataUsingEncoding:NSUTF8StringEncoding];
+        if (!value_size || [name length] > UINT16_MAX)
+            continue;
+        
+        rx_game_state_append_uint(data, 1, type);
+        rx_game_state_append_uint(data, 2, [name length]);
+        [data appendData:name];
+        rx_game_state_append_uint(data, value_size, _slots->values[variable]);
+        count++;
+    }
+    
+    uint8_t* count_bytes = (uint8_t*)[data mutableBytes] + count_offset;
+    for (size_t i = 0; i < 4; i++)
+        count_bytes[i] = (uint8_t)(count >> (8 * i));
+    
+    [keys release];
+    return data;
+}
+
+- (BOOL)writeToURL:(NSURL*)url error:(NSError**)error {
+    return [[self data] writeToURL:url options:NSAtomicWrite error:error];
+}
+
+- (void)writeToURLInBackground:(NSURL*)url {
+    [[RXGameStateWriter sharedWriter] queueSnapshot:self URL:url];
+}
+
++ (void)waitForBackgroundWrites {
+    [[RXGameStateWriter sharedWriter] waitUntilDone];
+}
+
+@end
+
+@implementation RXGameStateWriter
+
++ (RXGameStateWriter*)sharedWriter {
+    static RXGameStateWriter* writer = nil;
+    static OSSpinLock lock = OS_SPINLOCK_INIT;
+    OSSpinLockLock(&lock);
+    if (writer == nil)
+        writer = [RXGameStateWriter new];
+    OSSpinLockUnlock(&lock);
+    return writer;
+}
+
+- (id)init {
+    self = [super init];
+    if (!self)
+        return nil;
+    
+    _condition = [NSCondition new];
+    _pending = [NSMutableDictionary new];
+    
+    // the thread retains the writer, which is never deallocated
+    [NSThread detachNewThreadSelector:@selector(_writerThread:) toTarget:self withObject:nil];
+    
+    return self;
+}
+
+- (void)dealloc {
+    [_condition release];
+    [_pending release];
+    
+    [super dealloc];
+}
+
+- (void)queueSnapshot:(RXGameStateSnapshot*)snapshot URL:(NSURL*)url {
+    // a snapshot waiting for the same URL is older than this one, so it is replaced
+    [_condition lock];
+    [_pending setObject:snapshot forKey:url];
+    _queuedGeneration++;
+    [_condition broadcast];
+    [_condition unlock];
+}
+
+- (void)waitUntilDone {
+    [_condition lock];
+    while (_writtenGeneration != _queuedGeneration)
+        [_condition wait];
+    [_condition unlock];
+}
+
+- (void)_writerThread:(id)object {
+    // WARNING: WILL BE RUNNING ON A DEDICATED THREAD
+    RXSetThreadName("game state writer");
+    
+    [_condition lock];
+    while (1) {
+        while ([_pending count] == 0)
+            [_condition wait];
+        
+        // take every pending snapshot, the newest of each URL, and write them without the lock
+        NSDictionary* writes = _pending;
+        _pending = [NSMutableDictionary new];
+        uint64_t generation = _queuedGeneration;
+        [_condition unlock];
+        
+        NSAutoreleasePool* p = [NSAutoreleasePool new];
+        for (NSURL* url in writes) {
+            NSError* error = nil;
+            if (![[writes objectForKey:url] writeToURL:url error:&error])
+                RXOLog2(kRXLoggingEngine, kRXLoggingLevelError, @"failed to write the game state to %@: %@", url, error);
+        }
+        [writes release];
+        [p release];
+        
+        [_condition lock];
+        _writtenGeneration = generation;
+        [_condition broadcast];
+    }
+}
+
+@end
@@ -9,6 +9,7 @@
 #import "Base/RXBase.h"
 
 #import "Engine/RXCoreStructures.h"
+#import "Engine/RXScriptArena.h"
 #import "Rendering/RXRendering.h"
 
 
@@ -16,8 +17,9 @@
     uint16_t _index;
     uint16_t _ID;
     rx_core_rect_t _rect;
+    rx_core_rect_t _initial_rect;
     uint16_t _cursor_id;
-    NSDictionary* _script;
+    rx_script_t* _script;
     
     NSString* _name;
     NSString* _description;
@@ -29,14 +31,14 @@
     BOOL enabled;
 }
 
-- (id)initWithIndex:(uint16_t)index ID:(uint16_t)ID rect:(rx_core_rect_t)rect cursorID:(uint16_t)cursorID script:(NSDictionary*)script;
+- (id)initWithIndex:(uint16_t)index ID:(uint16_t)ID rect:(rx_core_rect_t)rect cursorID:(uint16_t)cursorID script:(rx_script_t*)script;
 
 - (NSString*)name;
 - (void)setName:(NSString*)name;
 
 - (uint16_t)ID;
 - (uint16_t)cursorID;
-- (NSDictionary*)scripts;
+- (const rx_script_t*)scripts;
 
 - (rx_core_rect_t)coreFrame;
 - (void)setCoreFrame:(rx_core_rect_t)frame;
@@ -48,4 +50,7 @@
 
 - (void)enable;
 
+// restores the frame the hotspot was created with and clears its event and enabled state
+- (void)reset;
+
 @end
@@ -8,7 +8,7 @@
 
 #import "Engine/RXHotspot.h"
 #import "Engine/RXScriptCommandAliases.h"
-#import "Engine/RXScriptDecoding.h"
+#import "Engine/RXScriptArena.h"
 #import "Rendering/RXRendering.h"
 
 
@@ -28,45 +28,41 @@
 
 - (void)_scanMouseInsidePrograms
 {
-    NSArray* programs = [_script objectForKey:RXMouseInsideScriptKey];
-    release_assert(programs);
-    
-    uint32_t p_count = [programs count];
-    if (p_count == 0 || p_count > 1)
+    if (rx_script_program_count(_script, kScriptTypeMouseInside) != 1)
         return;
     
-    NSDictionary* program_dict = [programs objectAtIndex:0];
-    uint16_t i_count = [[program_dict objectForKey:RXScriptOpcodeCountKey] unsignedShortValue];
-    if (i_count == 0 || i_count > 1)
+    rx_script_program_t program = rx_script_program(_script, kScriptTypeMouseInside, 0);
+    if (program.opcode_count != 1)
         return;
     
-    const uint16_t* program = (uint16_t*)[[program_dict objectForKey:RXScriptProgramKey] bytes];
-    if (program[0] != RX_COMMAND_SET_CURSOR)
+    if (program.opcodes[0] != RX_COMMAND_SET_CURSOR)
         return;
-    if (program[1] != 1)
+    if (program.opcodes[1] != 1)
         return;
     
     // our "mouse inside" script consist of a single "set cursor" command, so we'll just override our cursor
-    _cursor_id = program[2];
+    _cursor_id = program.opcodes[2];
     
     // and scrap our mouse inside program
-    NSMutableDictionary* mut_script = [_script mutableCopy];
-    [mut_script setObject:[NSArray array] forKey:RXMouseInsideScriptKey];
-    [_script release];
-    _script = mut_script;
+    rx_script_clear_event(_script, kScriptTypeMouseInside);
 }
 
-- (id)initWithIndex:(uint16_t)index ID:(uint16_t)ID rect:(rx_core_rect_t)rect cursorID:(uint16_t)cursorID script:(NSDictionary*)script
+- (id)initWithIndex:(uint16_t)index ID:(uint16_t)ID rect:(rx_core_rect_t)rect cursorID:(uint16_t)cursorID script:(rx_script_t*)script
 {
+    // the hotspot takes ownership of its script
     self = [super init];
     if (!self)
+    {
+        rx_script_free(script);
         return nil;
+    }
     
     _index = index;
     _ID = ID;
     _rect = rect;
+    _initial_rect = rect;
     _cursor_id = cursorID;
-    _script = [script retain];
+    _script = script;
     
     // register for reshape notifications so we can update our world frame and do an update immediately to initialize the world frame
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(_updateWorldFrame:) name:@"RXOpenGLDidReshapeNotification" object:nil];
@@ -77,11 +73,8 @@
     
 #if defined(DEBUG) && DEBUG > 1
     NSMutableString* hotspot_handlers = [NSMutableString new];
-    NSArray* keys = [[_script allKeys] sortedArrayUsingSelector:@selector(compare:)];
-    NSEnumerator* handlers = [keys objectEnumerator];
-    NSString* key;
-    while((key = [handlers nextObject]))
-        [hotspot_handlers appendFormat:@"     %@ = %d\n", key, [[_script objectForKey:key] count]];
+    for (uint16_t event = 0; event < RX_SCRIPT_EVENT_TYPE_COUNT; event++)
+        [hotspot_handlers appendFormat:@"     %s = %u\n", rx_script_event_name(event), rx_script_program_count(_script, event)];
     RXOLog(@"hotspot script:\n%@", hotspot_handlers);
     [hotspot_handlers release];
 #endif
@@ -95,7 +88,7 @@
     
     [_name release];
     [_description release];
-    [_script release];
+    rx_script_free(_script);
     
     [super dealloc];
 }
@@ -177,7 +170,7 @@
     return _cursor_id;
 }
 
-- (NSDictionary*)scripts
+- (const rx_script_t*)scripts
 {
     return _script;
 }
@@ -202,4 +195,14 @@
     enabled = YES;
 }
 
+- (void)reset
+{
+    if (_rect.left != _initial_rect.left || _rect.top != _initial_rect.top ||
+        _rect.right != _initial_rect.right || _rect.bottom != _initial_rect.bottom)
+        [self setCoreFrame:_initial_rect];
+    
+    memset(&_event, 0, sizeof(rx_event_t));
+    enabled = NO;
+}
+
 @end
@@ -0,0 +1,205 @@
+//
+//  RXRivenSave.cpp
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 28/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#include <string.h>
+
+#include "Engine/RXRivenSave.h"
+#include "mhk/mohawk_core.h"
+
+
+namespace {
+
+struct Resource {
+    const uint8_t* data;
+    size_t length;
+};
+
+class SaveReader {
+public:
+    SaveReader(const void* save, size_t length) : _save(static_cast<const uint8_t*>(save)), _length(length) {}
+
+    int read_variables(rx_riven_save_variable_handler_t handler, void* context);
+
+private:
+    // copies a file structure at an offset; returns false if it is out of bounds
+    template <typename T>
+    bool read(size_t offset, T* structure) const {
+        if (offset > _length || _length - offset < sizeof(T))
+            return false;
+        memcpy(structure, _save + offset, sizeof(T));
+        return true;
+    }
+
+    int read_directory();
+    int find_resource(const char type[4], uint16_t id, Resource* resource) const;
+
+    const uint8_t* _save;
+    size_t _length;
+
+    size_t _rsrc_dir;
+    size_t _file_table;
+    uint32_t _file_count;
+};
+
+inline uint16_t read_be16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline uint32_t read_be32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+int SaveReader::read_directory() {
+    MHK_chunk_header chunk;
+    MHK_RSRC_header rsrc;
+    if (!read(0, &chunk) || memcmp(&chunk.signature, "MHWK", 4) != 0)
+        return kRXRivenSaveNotMohawk;
+    if (!read(sizeof(MHK_chunk_header), &rsrc) || memcmp(&rsrc.signature, "RSRC", 4) != 0)
+        return kRXRivenSaveNotMohawk;
+    MHK_RSRC_header_fton(&rsrc);
+
+    MHK_file_table_header file_table;
+    _rsrc_dir = rsrc.rsrc_dir_absolute_offset;
+    _file_table = _rsrc_dir + rsrc.file_table_rsrc_dir_offset;
+    if (!read(_file_table, &file_table))
+        return kRXRivenSaveCorrupted;
+    MHK_file_table_header_fton(&file_table);
+
+    _file_count = file_table.count;
+    size_t entries = _file_table + sizeof(MHK_file_table_header);
+    if (entries > _length || (_length - entries) / sizeof(MHK_file_table_entry) < _file_count)
+        return kRXRivenSaveCorrupted;
+    return kRXRivenSaveNoError;
+}
+
+int SaveReader::find_resource(const char type[4], uint16_t id, Resource* resource) const {
+    MHK_type_table_header type_table;
+    if (!read(_rsrc_dir, &type_table))
+        return kRXRivenSaveCorrupted;
+    MHK_type_table_header_fton(&type_table);
+
+    for (uint16_t t = 0; t < type_table.count; t++) {
+        MHK_type_table_entry type_entry;
+        if (!read(_rsrc_dir + sizeof(MHK_type_table_header) + t * sizeof(MHK_type_table_entry), &type_entry))
+            return kRXRivenSaveCorrupted;
+        if (memcmp(type_entry.name, type, 4) != 0)
+            continue;
+        MHK_type_table_entry_fton(&type_entry);
+
+        size_t rsrc_table = _rsrc_dir + type_entry.rsrc_table_rsrc_dir_offset;
+        MHK_rsrc_table_header rsrc_table_header;
+        if (!read(rsrc_table, &rsrc_table_header))
+            return kRXRivenSaveCorrupted;
+        MHK_rsrc_table_header_fton(&rsrc_table_header);
+
+        for (uint16_t r = 0; r < rsrc_table_header.count; r++) {
+            MHK_rsrc_table_entry rsrc_entry;
+            if (!read(rsrc_table + sizeof(MHK_rsrc_table_header) + r * sizeof(MHK_rsrc_table_entry), &rsrc_entry))
+                return kRXRivenSaveCorrupted;
+            MHK_rsrc_table_entry_fton(&rsrc_entry);
+            if (rsrc_entry.id != id)
+                continue;
+
+            // file table indices are 1-based
+            if (rsrc_entry.index == 0 || rsrc_entry.index > _file_count)
+                return kRXRivenSaveCorrupted;
+
+            // the stored file sizes are unreliable; like MHKArchive, a file extends to the next file or to the end of
+            // the archive
+            const uint8_t* entries = _save + _file_table + sizeof(MHK_file_table_header);
+            size_t offset = read_be32(entries + (rsrc_entry.index - 1) * sizeof(MHK_file_table_entry));
+            if (offset > _length)
+                return kRXRivenSaveCorrupted;
+
+            size_t end = _length;
+            for (uint32_t f = 0; f < _file_count; f++) {
+                size_t file_offset = read_be32(entries + f * sizeof(MHK_file_table_entry));
+                if (file_offset > offset && file_offset < end)
+                    end = file_offset;
+            }
+
+            resource->data = _save + offset;
+            resource->length = end - offset;
+            return kRXRivenSaveNoError;
+        }
+    }
+
+    return kRXRivenSaveMissingResource;
+}
+
+int SaveReader::read_variables(rx_riven_save_variable_handler_t handler, void* context) {
+    int error = read_directory();
+    if (error)
+        return error;
+
+    Resource vars, names;
+    if ((error = find_resource("VARS", 1, &vars)) || (error = find_resource("NAME", 1, &names)))
+        return error;
+
+    // NAME: a name count, an offset into the string table for each name, an index for each name, then the strings
+    if (names.length < 2)
+        return kRXRivenSaveCorrupted;
+    uint32_t name_count = read_be16(names.data);
+    size_t strings = 2 + 4 * static_cast<size_t>(name_count);
+    if (strings > names.length)
+        return kRXRivenSaveCorrupted;
+
+    const size_t record_size = 3 * sizeof(uint32_t);
+    uint32_t count = static_cast<uint32_t>(vars.length / record_size);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t value = read_be32(vars.data + i * record_size + 8);
+
+        if (i >= name_count) {
+            handler(context, i, NULL, 0, value);
+            continue;
+        }
+
+        size_t name_offset = strings + read_be16(names.data + 2 + 2 * i);
+        if (name_offset >= names.length)
+            return kRXRivenSaveCorrupted;
+        const char* name = reinterpret_cast<const char*>(names.data + name_offset);
+        const char* name_end = static_cast<const char*>(memchr(name, 0, names.length - name_offset));
+        if (!name_end)
+            return kRXRivenSaveCorrupted;
+
+        // some names are wrapped in 0xbd, like in the stack NAME resources
+        size_t name_length = name_end - name;
+        if (name_length && static_cast<uint8_t>(name[0]) == 0xbd) {
+            name++;
+            name_length--;
+        }
+        if (name_length && static_cast<uint8_t>(name[name_length - 1]) == 0xbd)
+            name_length--;
+
+        handler(context, i, name, name_length, value);
+    }
+
+    return kRXRivenSaveNoError;
+}
+
+} // namespace
+
+int rx_riven_save_read_variables(const void* save, size_t length, rx_riven_save_variable_handler_t handler, void* context) {
+    SaveReader reader(save, length);
+    return reader.read_variables(handler, context);
+}
+
+const char* rx_riven_save_error_description(int error) {
+    switch (error) {
+        case kRXRivenSaveNoError:
+            return "no error";
+        case kRXRivenSaveNotMohawk:
+            return "not a Mohawk archive";
+        case kRXRivenSaveMissingResource:
+            return "missing VARS or NAME resource";
+        case kRXRivenSaveCorrupted:
+            return "corrupted archive";
+        default:
+            return "unknown error";
+    }
+}
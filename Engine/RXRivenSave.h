@@ -0,0 +1,43 @@
+//
+//  RXRivenSave.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 28/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#if !defined(RX_RIVEN_SAVE_H)
+#define RX_RIVEN_SAVE_H
+
+#include <sys/cdefs.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// Reads the variables of a save file of the original Riven engine (.rvn). A save file is a Mohawk archive; VARS 1 has
+// a {uint32 u0, uint32 u1, uint32 value} record for each variable and NAME 1 has the names of the first variables, in
+// the same order. The archive is read in place, without copying it or building any collection, and each variable is
+// handed to a handler in a single pass.
+//
+
+__BEGIN_DECLS
+
+enum {
+    kRXRivenSaveNoError = 0,
+    kRXRivenSaveNotMohawk,          // the data is not a Mohawk archive
+    kRXRivenSaveMissingResource,    // there is no VARS 1 or NAME 1 resource
+    kRXRivenSaveCorrupted,          // a structure of the archive is out of bounds
+};
+
+// receives each variable of a save, in save order; name is not NUL-terminated, and is NULL for the variables that
+// have no name, which are identified by their index
+typedef void (*rx_riven_save_variable_handler_t)(void* context, uint32_t index, const char* name, size_t name_length, uint32_t value);
+
+// reads the variables of a save file of length bytes; returns one of the error codes above
+int rx_riven_save_read_variables(const void* save, size_t length, rx_riven_save_variable_handler_t handler, void* context);
+
+const char* rx_riven_save_error_description(int error);
+
+__END_DECLS
+
+#endif // RX_RIVEN_SAVE_H
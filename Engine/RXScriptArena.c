@@ -0,0 +1,458 @@
+/*
+ *  RXScriptArena.c
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 26/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Base/RXByteSwap.h"
+#include "Engine/RXScriptArena.h"
+#include "Engine/RXScriptIR.h"
+
+
+#define RX_SCRIPT_ARENA_MAGIC 0x52585343 // 'RXSC'
+
+struct rx_script {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t program_count;
+    uint32_t event_start[RX_SCRIPT_EVENT_TYPE_COUNT + 1];
+};
+
+struct rx_script_entry {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t ir_offset;
+    uint32_t ir_length;
+    uint16_t opcode_count;
+    uint16_t padding;
+};
+
+static const char* const event_names[RX_SCRIPT_EVENT_TYPE_COUNT] = {
+    "mouse down",
+    "mouse still down",
+    "mouse up",
+    "unknown 3",
+    "mouse inside",
+    "mouse exited",
+    "open card",
+    "close card",
+    "idle",
+    "start rendering",
+    "screen update",
+};
+
+static inline size_t pad4(size_t length)
+{
+    return (length + 3) & ~(size_t)3;
+}
+
+static inline uint16_t read_be16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline bool host_is_little_endian(void)
+{
+    const uint16_t one = 1;
+    return *(const uint8_t*)&one == 1;
+}
+
+static inline struct rx_script_entry* script_entries(const rx_script_t* script)
+{
+    return (struct rx_script_entry*)((uint8_t*)script + sizeof(struct rx_script));
+}
+
+static inline size_t data_start(uint32_t program_count)
+{
+    return sizeof(struct rx_script) + program_count * sizeof(struct rx_script_entry);
+}
+
+#pragma mark -
+#pragma mark decoding
+
+// a script is decoded in two passes over the resource: the first verifies and measures the programs, the second copies
+// them into an arena of the measured size; both passes make the same decisions, since verification is deterministic
+struct decoder {
+    const uint8_t* script;
+    size_t available;
+    rx_script_decode_handler_t handler;
+    void* context;
+    uint16_t event;
+
+    // first pass
+    uint32_t program_counts[RX_SCRIPT_EVENT_TYPE_COUNT];
+    size_t data_size;
+
+    // second pass
+    rx_script_t* arena;
+    uint32_t next_entry[RX_SCRIPT_EVENT_TYPE_COUNT];
+    size_t next_data;
+};
+
+static void forward_violation(void* context, const rx_script_violation_t* violation)
+{
+    struct decoder* decoder = (struct decoder*)context;
+    decoder->handler(decoder->context, decoder->event, violation);
+}
+
+static void report_script_violation(struct decoder* decoder, uint16_t event, int code, size_t offset)
+{
+    if (!decoder->handler)
+        return;
+
+    rx_script_violation_t violation;
+    violation.code = code;
+    violation.opcode = 0;
+    violation.argc = 0;
+    violation.offset = offset;
+    violation.depth = 0;
+    decoder->handler(decoder->context, event, &violation);
+}
+
+static void emit_program(struct decoder* decoder, uint16_t event, const uint8_t* program, size_t length, uint16_t opcode_count)
+{
+    if (!decoder->arena)
+    {
+        decoder->program_counts[event]++;
+        decoder->data_size += pad4(length);
+        return;
+    }
+
+    struct rx_script_entry* entry = script_entries(decoder->arena) + decoder->next_entry[event]++;
+    entry->offset = (uint32_t)decoder->next_data;
+    entry->length = (uint32_t)length;
+    entry->ir_offset = 0;
+    entry->ir_length = 0;
+    entry->opcode_count = opcode_count;
+    entry->padding = 0;
+
+    // programs are measured in words, so length is even
+    uint16_t* words = (uint16_t*)((uint8_t*)decoder->arena + decoder->next_data);
+    if (host_is_little_endian())
+        rx_swap16_copy_span(words, program, length / 2);
+    else
+        memcpy(words, program, length);
+    memset((uint8_t*)words + length, 0, pad4(length) - length);
+    decoder->next_data += pad4(length);
+}
+
+// returns the length of the script
+static size_t decode_programs(struct decoder* decoder)
+{
+    const uint8_t* script = decoder->script;
+    size_t available = decoder->available;
+
+    if (available < 2)
+    {
+        report_script_violation(decoder, RX_SCRIPT_NO_EVENT, kRXScriptViolationTruncated, 0);
+        return available;
+    }
+    uint16_t event_count = read_be16(script);
+    size_t offset = 2;
+
+    for (uint16_t i = 0; i < event_count; i++)
+    {
+        // event type, opcode count
+        if (available - offset < 4)
+        {
+            report_script_violation(decoder, RX_SCRIPT_NO_EVENT, kRXScriptViolationTruncated, offset);
+            return available;
+        }
+        uint16_t event = read_be16(script + offset);
+        uint16_t opcode_count = read_be16(script + offset + 2);
+        offset += 4;
+
+        // verification also measures the program; if its length cannot be determined, the following programs cannot
+        // be found either
+        decoder->event = event;
+        size_t length;
+        uint32_t violations = rx_script_verify_program(script + offset, available - offset, opcode_count,
+                                                       host_is_little_endian(), &length,
+                                                       (decoder->handler) ? forward_violation : NULL, decoder);
+        if (length == RX_SCRIPT_VERIFIER_UNKNOWN_LENGTH)
+            return available;
+
+        if (event >= RX_SCRIPT_EVENT_TYPE_COUNT)
+            report_script_violation(decoder, event, kRXScriptViolationUnknownEvent, offset - 4);
+        else if (violations)
+            emit_program(decoder, event, script + offset, 0, 0);
+        else
+            emit_program(decoder, event, script + offset, length, opcode_count);
+
+        offset += length;
+    }
+
+    return offset;
+}
+
+rx_script_t* rx_script_decode(const void* script, size_t available, uint32_t* script_length,
+                              rx_script_decode_handler_t handler, void* context)
+{
+    struct decoder decoder;
+    memset(&decoder, 0, sizeof(struct decoder));
+    decoder.script = (const uint8_t*)script;
+    decoder.available = available;
+    decoder.handler = handler;
+    decoder.context = context;
+
+    size_t length = decode_programs(&decoder);
+
+    uint32_t program_count = 0;
+    for (uint16_t event = 0; event < RX_SCRIPT_EVENT_TYPE_COUNT; event++)
+        program_count += decoder.program_counts[event];
+
+    size_t size = data_start(program_count) + decoder.data_size;
+    rx_script_t* arena = (rx_script_t*)malloc(size);
+    if (!arena)
+        return NULL;
+
+    arena->magic = RX_SCRIPT_ARENA_MAGIC;
+    arena->size = (uint32_t)size;
+    arena->program_count = program_count;
+    arena->event_start[0] = 0;
+    for (uint16_t event = 0; event < RX_SCRIPT_EVENT_TYPE_COUNT; event++)
+    {
+        arena->event_start[event + 1] = arena->event_start[event] + decoder.program_counts[event];
+        decoder.next_entry[event] = arena->event_start[event];
+    }
+
+    // the second pass only copies; its violations have already been reported
+    decoder.handler = NULL;
+    decoder.arena = arena;
+    decoder.next_data = data_start(program_count);
+    decode_programs(&decoder);
+
+    if (script_length)
+        *script_length = (uint32_t)length;
+    return arena;
+}
+
+void rx_script_free(rx_script_t* script)
+{
+    free(script);
+}
+
+size_t rx_script_size(const rx_script_t* script)
+{
+    return script->size;
+}
+
+bool rx_script_is_valid(const void* script, size_t length)
+{
+    const rx_script_t* arena = (const rx_script_t*)script;
+    if (((uintptr_t)script & 3) || length < sizeof(struct rx_script))
+        return false;
+    if (arena->magic != RX_SCRIPT_ARENA_MAGIC || arena->size != length)
+        return false;
+
+    uint32_t program_count = arena->program_count;
+    if (program_count > (length - sizeof(struct rx_script)) / sizeof(struct rx_script_entry))
+        return false;
+    if (arena->event_start[0] != 0 || arena->event_start[RX_SCRIPT_EVENT_TYPE_COUNT] != program_count)
+        return false;
+    for (uint16_t event = 0; event < RX_SCRIPT_EVENT_TYPE_COUNT; event++)
+    {
+        if (arena->event_start[event] > arena->event_start[event + 1])
+            return false;
+    }
+
+    const struct rx_script_entry* entries = script_entries(arena);
+    size_t start = data_start(program_count);
+    for (uint32_t i = 0; i < program_count; i++)
+    {
+        const struct rx_script_entry* entry = entries + i;
+        if (entry->offset < start || entry->offset > length || (entry->offset & 3) || (entry->length & 1) ||
+            entry->length > length - entry->offset)
+            return false;
+
+        size_t program_length;
+        uint32_t violations = rx_script_verify_program((const uint8_t*)script + entry->offset, entry->length,
+                                                       entry->opcode_count, false, &program_length, NULL, NULL);
+        if (violations || program_length != entry->length)
+            return false;
+
+        if (entry->ir_length == 0)
+            continue;
+        if (entry->ir_offset < start || entry->ir_offset > length || (entry->ir_offset & 3) ||
+            entry->ir_length > length - entry->ir_offset)
+            return false;
+        if (!rx_script_ir_is_valid((const uint8_t*)script + entry->ir_offset, entry->ir_length))
+            return false;
+    }
+
+    return true;
+}
+
+#pragma mark -
+#pragma mark programs
+
+uint32_t rx_script_program_count(const rx_script_t* script, uint16_t event)
+{
+    if (event >= RX_SCRIPT_EVENT_TYPE_COUNT)
+        return 0;
+    return script->event_start[event + 1] - script->event_start[event];
+}
+
+rx_script_program_t rx_script_program(const rx_script_t* script, uint16_t event, uint32_t index)
+{
+    rx_script_program_t program;
+    memset(&program, 0, sizeof(rx_script_program_t));
+    if (index >= rx_script_program_count(script, event))
+        return program;
+
+    const struct rx_script_entry* entry = script_entries(script) + script->event_start[event] + index;
+    program.opcodes = (const uint16_t*)((const uint8_t*)script + entry->offset);
+    program.length = entry->length;
+    program.opcode_count = entry->opcode_count;
+    if (entry->ir_length)
+    {
+        program.ir = (const uint8_t*)script + entry->ir_offset;
+        program.ir_length = entry->ir_length;
+    }
+    return program;
+}
+
+void rx_script_clear_event(rx_script_t* script, uint16_t event)
+{
+    uint32_t removed = rx_script_program_count(script, event);
+    if (removed == 0)
+        return;
+
+    // the entries of the following event types move down; their program data stays where it is
+    struct rx_script_entry* entries = script_entries(script);
+    uint32_t end = script->event_start[event + 1];
+    memmove(entries + end - removed, entries + end, (script->program_count - end) * sizeof(struct rx_script_entry));
+
+    for (uint16_t e = event + 1; e <= RX_SCRIPT_EVENT_TYPE_COUNT; e++)
+        script->event_start[e] -= removed;
+    script->program_count -= removed;
+}
+
+// returns a new arena with the programs and IRs of sources, which has one program for each program of script
+static rx_script_t* rebuild_script(const rx_script_t* script, const rx_script_program_t* sources)
+{
+    uint32_t program_count = script->program_count;
+    size_t size = data_start(program_count);
+    for (uint32_t i = 0; i < program_count; i++)
+        size += pad4(sources[i].length) + pad4(sources[i].ir_length);
+
+    rx_script_t* arena = (rx_script_t*)malloc(size);
+    if (!arena)
+        return NULL;
+
+    memcpy(arena, script, sizeof(struct rx_script));
+    arena->size = (uint32_t)size;
+
+    struct rx_script_entry* entries = script_entries(arena);
+    size_t offset = data_start(program_count);
+    for (uint32_t i = 0; i < program_count; i++)
+    {
+        const rx_script_program_t* source = sources + i;
+        entries[i].offset = (uint32_t)offset;
+        entries[i].length = source->length;
+        entries[i].opcode_count = source->opcode_count;
+        entries[i].padding = 0;
+
+        memcpy((uint8_t*)arena + offset, source->opcodes, source->length);
+        memset((uint8_t*)arena + offset + source->length, 0, pad4(source->length) - source->length);
+        offset += pad4(source->length);
+
+        entries[i].ir_offset = (source->ir_length) ? (uint32_t)offset : 0;
+        entries[i].ir_length = source->ir_length;
+        if (source->ir_length)
+        {
+            memcpy((uint8_t*)arena + offset, source->ir, source->ir_length);
+            memset((uint8_t*)arena + offset + source->ir_length, 0, pad4(source->ir_length) - source->ir_length);
+            offset += pad4(source->ir_length);
+        }
+    }
+
+    return arena;
+}
+
+// fills sources with the programs of script, in entry order
+static void collect_programs(const rx_script_t* script, rx_script_program_t* sources)
+{
+    for (uint16_t event = 0; event < RX_SCRIPT_EVENT_TYPE_COUNT; event++)
+    {
+        uint32_t count = rx_script_program_count(script, event);
+        for (uint32_t index = 0; index < count; index++)
+            sources[script->event_start[event] + index] = rx_script_program(script, event, index);
+    }
+}
+
+rx_script_t* rx_script_replace_program(rx_script_t* script, uint16_t event, uint32_t index,
+                                       const uint16_t* opcodes, size_t length, uint16_t opcode_count)
+{
+    if (index >= rx_script_program_count(script, event))
+        return script;
+
+    rx_script_program_t* sources = (rx_script_program_t*)malloc(script->program_count * sizeof(rx_script_program_t));
+    if (!sources)
+        return NULL;
+    collect_programs(script, sources);
+
+    rx_script_program_t* replaced = sources + script->event_start[event] + index;
+    replaced->opcodes = opcodes;
+    replaced->length = (uint32_t)length;
+    replaced->opcode_count = opcode_count;
+    replaced->ir = NULL;
+    replaced->ir_length = 0;
+
+    rx_script_t* arena = rebuild_script(script, sources);
+    free(sources);
+    if (arena)
+        free(script);
+    return arena;
+}
+
+rx_script_t* rx_script_link(rx_script_t* script)
+{
+    uint32_t program_count = script->program_count;
+    if (program_count == 0)
+        return script;
+
+    rx_script_program_t* sources = (rx_script_program_t*)malloc(program_count * sizeof(rx_script_program_t));
+    void** irs = (void**)calloc(program_count, sizeof(void*));
+    if (!sources || !irs)
+    {
+        free(sources);
+        free(irs);
+        return NULL;
+    }
+    collect_programs(script, sources);
+
+    for (uint32_t i = 0; i < program_count; i++)
+    {
+        if (sources[i].ir)
+            continue;
+
+        size_t ir_length = 0;
+        irs[i] = rx_script_ir_compile(sources[i].opcodes, sources[i].length, sources[i].opcode_count, &ir_length);
+        if (irs[i])
+        {
+            sources[i].ir = irs[i];
+            sources[i].ir_length = (uint32_t)ir_length;
+        }
+    }
+
+    rx_script_t* arena = rebuild_script(script, sources);
+    for (uint32_t i = 0; i < program_count; i++)
+        free(irs[i]);
+    free(irs);
+    free(sources);
+    if (arena)
+        free(script);
+    return arena;
+}
+
+const char* rx_script_event_name(uint16_t event)
+{
+    return (event < RX_SCRIPT_EVENT_TYPE_COUNT) ? event_names[event] : NULL;
+}
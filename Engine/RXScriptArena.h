@@ -0,0 +1,107 @@
+//
+//  RXScriptArena.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 26/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#if !defined(RX_SCRIPT_ARENA_H)
+#define RX_SCRIPT_ARENA_H
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Engine/RXScriptVerifier.h"
+
+//
+// A decoded script is a single malloc'ed arena holding every program of a card or hotspot script, grouped by event
+// type, so that decoding a card costs one allocation and releasing it costs one free. The arena has no pointers in
+// it; all fields are host-endian and 4-byte aligned, and offsets are relative to the start of the arena:
+//
+//  header:   uint32 magic, uint32 size, uint32 program count,
+//            uint32 event start[RX_SCRIPT_EVENT_TYPE_COUNT + 1] (index of each event type's first program entry)
+//  entries:  {uint32 program offset, uint32 program length, uint32 IR offset, uint32 IR length, uint16 opcode count,
+//            uint16 padding} for each program, in event type order and in script order within an event type
+//  data:     the host-endian program of each entry, padded to 4 bytes, followed by its IR (see RXScriptIR.h) if the
+//            script has been linked
+//
+// Programs are verified when they are decoded (see RXScriptVerifier.h). A program that has a violation is stored as
+// an empty program, so that the engine never runs a malformed program.
+//
+
+__BEGIN_DECLS
+
+enum {
+    kScriptTypeMouseDown = 0,
+    kScriptTypeMouseStillDown,
+    kScriptTypeMouseUp,
+    kScriptTypeUnknown3,
+    kScriptTypeMouseInside,
+    kScriptTypeMouseExited,
+    kScriptTypeCardOpen,
+    kScriptTypeCardClose,
+    kScriptTypeIdle,
+    kScriptTypeStartRendering,
+    kScriptTypeScreenUpdate,
+};
+
+#define RX_SCRIPT_EVENT_TYPE_COUNT 11
+
+// event type of violations that are not in a program, such as a truncated script
+#define RX_SCRIPT_NO_EVENT UINT16_MAX
+
+typedef struct rx_script rx_script_t;
+
+// a view of a program in an arena; it is valid until the arena is freed or replaced
+struct rx_script_program {
+    const uint16_t* opcodes;    // host-endian
+    uint32_t length;            // in bytes
+    uint16_t opcode_count;
+    const void* ir;             // NULL if the program has not been linked or did not compile
+    uint32_t ir_length;
+};
+typedef struct rx_script_program rx_script_program_t;
+
+// receives the violations found while decoding a script, with the event type of the program they are in; violations
+// in a program have program offsets, violations outside of programs have script offsets
+typedef void (*rx_script_decode_handler_t)(void* context, uint16_t event, const rx_script_violation_t* violation);
+
+// decodes a big-endian script (an event count followed by the programs) of at most available bytes; script_length
+// receives the length of the script in bytes; programs for unknown event types are skipped, and if the length of a
+// program cannot be determined the rest of the script is dropped
+rx_script_t* rx_script_decode(const void* script, size_t available, uint32_t* script_length,
+                              rx_script_decode_handler_t handler, void* context);
+
+void rx_script_free(rx_script_t* script);
+
+// checks that length bytes hold a well-formed arena, such as one read back from disk: its layout must be in bounds
+// and aligned, its programs must verify and its IRs must be valid
+bool rx_script_is_valid(const void* script, size_t length);
+
+// size of the arena in bytes
+size_t rx_script_size(const rx_script_t* script);
+
+uint32_t rx_script_program_count(const rx_script_t* script, uint16_t event);
+rx_script_program_t rx_script_program(const rx_script_t* script, uint16_t event, uint32_t index);
+
+// removes the programs of an event type in place
+void rx_script_clear_event(rx_script_t* script, uint16_t event);
+
+// replaces a program with a host-endian program; the program is not verified and loses its IR; like realloc, returns
+// the new arena and frees the old one
+rx_script_t* rx_script_replace_program(rx_script_t* script, uint16_t event, uint32_t index,
+                                       const uint16_t* opcodes, size_t length, uint16_t opcode_count);
+
+// compiles the IR of every program that does not have one yet; programs that do not compile are left as they are and
+// run through the program walker; like realloc, returns the new arena and frees the old one
+rx_script_t* rx_script_link(rx_script_t* script);
+
+// returns the name of an event type, such as "open card", or NULL for unknown event types
+const char* rx_script_event_name(uint16_t event);
+
+__END_DECLS
+
+#endif // RX_SCRIPT_ARENA_H
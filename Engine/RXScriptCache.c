@@ -0,0 +1,200 @@
+/*
+ *  RXScriptCache.c
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 27/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "Engine/RXScriptCache.h"
+
+
+#define RX_SCRIPT_CACHE_MAGIC 0x5258534b // 'RXSK'
+
+// entries are never larger than this; anything larger is not a cache entry
+#define RX_SCRIPT_CACHE_MAX_SIZE (16 * 1024 * 1024)
+
+struct rx_script_cache_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t hash;
+    uint32_t count;
+    uint32_t padding;
+};
+
+struct rx_script_cache_record {
+    uint32_t size;
+    uint32_t script_length;
+};
+
+uint64_t rx_script_cache_hash(const void* resource, size_t length)
+{
+    // 64-bit FNV-1a
+    const uint8_t* bytes = (const uint8_t*)resource;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#pragma mark -
+#pragma mark reading
+
+static bool read_fully(int fd, void* buffer, size_t length)
+{
+    uint8_t* p = (uint8_t*)buffer;
+    while (length)
+    {
+        ssize_t n = read(fd, p, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+int32_t rx_script_cache_read(const char* path, uint64_t hash, uint32_t capacity, rx_script_t** scripts, uint32_t* script_lengths)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat sb;
+    struct rx_script_cache_header header;
+    if (fstat(fd, &sb) < 0 || sb.st_size > RX_SCRIPT_CACHE_MAX_SIZE || !read_fully(fd, &header, sizeof(header)) ||
+        header.magic != RX_SCRIPT_CACHE_MAGIC || header.version != RX_SCRIPT_CACHE_VERSION || header.hash != hash ||
+        header.count > capacity)
+    {
+        close(fd);
+        return -1;
+    }
+
+    uint32_t count = header.count;
+    struct rx_script_cache_record* records = NULL;
+    if (count)
+    {
+        records = (struct rx_script_cache_record*)malloc(count * sizeof(struct rx_script_cache_record));
+        if (!records || !read_fully(fd, records, count * sizeof(struct rx_script_cache_record)))
+        {
+            free(records);
+            close(fd);
+            return -1;
+        }
+    }
+
+    // the records must account for the rest of the file exactly
+    size_t expected = sizeof(header) + count * sizeof(struct rx_script_cache_record);
+    for (uint32_t i = 0; i < count; i++)
+        expected += records[i].size;
+
+    uint32_t read_count = 0;
+    if (expected == (size_t)sb.st_size)
+    {
+        for (; read_count < count; read_count++)
+        {
+            // malloc's alignment is enough for the arena
+            size_t size = records[read_count].size;
+            void* arena = malloc((size) ? size : 1);
+            if (!arena || !read_fully(fd, arena, size) || !rx_script_is_valid(arena, size))
+            {
+                free(arena);
+                break;
+            }
+            scripts[read_count] = (rx_script_t*)arena;
+            script_lengths[read_count] = records[read_count].script_length;
+        }
+    }
+
+    free(records);
+    close(fd);
+
+    if (read_count != count)
+    {
+        for (uint32_t i = 0; i < read_count; i++)
+            rx_script_free(scripts[i]);
+        return -1;
+    }
+    return (int32_t)count;
+}
+
+#pragma mark -
+#pragma mark writing
+
+static bool write_fully(int fd, const void* buffer, size_t length)
+{
+    const uint8_t* p = (const uint8_t*)buffer;
+    while (length)
+    {
+        ssize_t n = write(fd, p, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+bool rx_script_cache_write(const char* path, uint64_t hash, uint32_t count, const rx_script_t* const* scripts,
+                           const uint32_t* script_lengths)
+{
+    // the entry is written next to its final path and renamed over it, so that readers never see a partial entry
+    size_t path_length = strlen(path);
+    char* temp_path = (char*)malloc(path_length + 8);
+    if (!temp_path)
+        return false;
+    memcpy(temp_path, path, path_length);
+    memcpy(temp_path + path_length, ".XXXXXX", 8);
+
+    int fd = mkstemp(temp_path);
+    if (fd < 0)
+    {
+        free(temp_path);
+        return false;
+    }
+
+    struct rx_script_cache_header header;
+    header.magic = RX_SCRIPT_CACHE_MAGIC;
+    header.version = RX_SCRIPT_CACHE_VERSION;
+    header.hash = hash;
+    header.count = count;
+    header.padding = 0;
+    bool success = write_fully(fd, &header, sizeof(header));
+
+    for (uint32_t i = 0; success && i < count; i++)
+    {
+        struct rx_script_cache_record record;
+        record.size = (uint32_t)rx_script_size(scripts[i]);
+        record.script_length = script_lengths[i];
+        success = write_fully(fd, &record, sizeof(record));
+    }
+
+    for (uint32_t i = 0; success && i < count; i++)
+        success = write_fully(fd, scripts[i], rx_script_size(scripts[i]));
+
+    if (close(fd) < 0)
+        success = false;
+    if (success && rename(temp_path, path) < 0)
+        success = false;
+    if (!success)
+        unlink(temp_path);
+
+    free(temp_path);
+    return success;
+}
@@ -0,0 +1,49 @@
+//
+//  RXScriptCache.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 27/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#if !defined(RX_SCRIPT_CACHE_H)
+#define RX_SCRIPT_CACHE_H
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Engine/RXScriptArena.h"
+
+//
+// The script cache keeps the final form of a script resource's scripts on disk, after the load-time workarounds have
+// patched them and they have been linked, so that loading a card again only has to read its arenas back. An entry
+// holds the arenas of one resource (the card script of a CARD resource, or the script of every hotspot of an HSPT
+// resource) and is keyed by a hash of the resource, so that an entry made from a different edition of a stack is
+// never used. Entries are validated when they are read, and an entry that is missing, stale or invalid is a miss.
+//
+// An entry is a header (uint32 magic, uint32 version, uint64 resource hash, uint32 script count, uint32 padding),
+// followed by a {uint32 arena size, uint32 script length} record for each script and then the arenas, all in host
+// byte order.
+//
+
+__BEGIN_DECLS
+
+// bump this whenever the script workarounds, the arena layout or the IR layout change, to invalidate existing entries
+#define RX_SCRIPT_CACHE_VERSION 1
+
+uint64_t rx_script_cache_hash(const void* resource, size_t length);
+
+// reads an entry of at most capacity scripts; returns the number of scripts, or -1 for a miss; each script is a
+// malloc'ed arena to be freed with rx_script_free, and script_lengths receives the length of the script resource data
+// each script was decoded from
+int32_t rx_script_cache_read(const char* path, uint64_t hash, uint32_t capacity, rx_script_t** scripts, uint32_t* script_lengths);
+
+// writes an entry, replacing any existing one atomically; returns false if the entry could not be written
+bool rx_script_cache_write(const char* path, uint64_t hash, uint32_t count, const rx_script_t* const* scripts,
+                           const uint32_t* script_lengths);
+
+__END_DECLS
+
+#endif // RX_SCRIPT_CACHE_H
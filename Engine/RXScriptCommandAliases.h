@@ -19,6 +19,8 @@
 #define RX_COMMAND_REFRESH 19
 #define RX_COMMAND_DISABLE_SCREEN_UPDATES 20
 #define RX_COMMAND_ENABLE_SCREEN_UPDATES 21
+#define RX_COMMAND_INCREMENT_VARIABLE 24
+#define RX_COMMAND_DECREMENT_VARIABLE 25
 #define RX_COMMAND_DISABLE_MOVIE 28
 #define RX_COMMAND_DISABLE_ALL_MOVIES 29
 #define RX_COMMAND_ENABLE_MOVIE 31
@@ -31,3 +33,6 @@
 #define RX_COMMAND_ACTIVATE_MLST_AND_START 41
 #define RX_COMMAND_ACTIVATE_BLST 43
 #define RX_COMMAND_ACTIVATE_MLST 46
+
+// number of opcodes in the script engine's dispatch table
+#define RX_COMMAND_COUNT 48
@@ -9,39 +9,25 @@
 #import "Base/RXBase.h"
 #import <sys/cdefs.h>
 
-__BEGIN_DECLS
+#import "Engine/RXScriptArena.h"
 
-enum {
-    kScriptTypeMouseDown = 0,
-    kScriptTypeMouseStillDown,
-    kScriptTypeMouseUp,
-    kScriptTypeUnknown3,
-    kScriptTypeMouseInside,
-    kScriptTypeMouseExited,
-    kScriptTypeCardOpen,
-    kScriptTypeCardClose,
-    kScriptTypeIdle,
-    kScriptTypeStartRendering,
-    kScriptTypeScreenUpdate,
-};
-
-extern NSString* const RXMouseDownScriptKey;
-extern NSString* const RXMouseStillDownScriptKey;
-extern NSString* const RXMouseUpScriptKey;
-extern NSString* const RXUnknown3ScriptKey;
-extern NSString* const RXMouseInsideScriptKey;
-extern NSString* const RXMouseExitedScriptKey;
-extern NSString* const RXCardOpenScriptKey;
-extern NSString* const RXCardCloseScriptKey;
-extern NSString* const RXIdleScriptKey;
-extern NSString* const RXStartRenderingScriptKey;
-extern NSString* const RXScreenUpdateScriptKey;
+__BEGIN_DECLS
 
 extern NSString* const RXScriptProgramKey;
 extern NSString* const RXScriptOpcodeCountKey;
 
 size_t rx_compute_riven_script_length(const void* script, uint16_t command_count, bool byte_swap);
-NSDictionary* rx_decode_riven_script(const void* script, uint32_t* script_length);
+// decodes a big-endian script of at most available_length bytes into a script arena (see RXScriptArena.h); programs
+// that do not pass the script verifier (see RXScriptVerifier.h) are logged and replaced by empty programs, so that the
+// engine never runs a malformed program
+rx_script_t* rx_decode_riven_script(const void* script, size_t available_length, uint32_t* script_length);
+
+// returns a program descriptor holding a copy of a program under RXScriptProgramKey and RXScriptOpcodeCountKey, as
+// used by RXScriptCompiler, or nil if the script has no such program
+NSDictionary* rx_riven_program_descriptor(const rx_script_t* script, uint16_t event, uint32_t index);
+
+// replaces a program of a script with the program of a descriptor; like realloc, returns the new script
+rx_script_t* rx_replace_riven_program(rx_script_t* script, uint16_t event, uint32_t index, NSDictionary* descriptor);
 
 uint16_t rx_get_riven_script_opcode(const void* script, uint16_t command_count, uint16_t opcode_index, uint32_t* opcode_offset);
 uint16_t rx_get_riven_script_case_opcode_count(const void* switch_opcode, uint16_t case_index, uint32_t* case_program_offset);
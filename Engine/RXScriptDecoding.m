@@ -7,37 +7,12 @@
 //
 
 #import "RXScriptDecoding.h"
+#import "Engine/RXScriptVerifier.h"
 
 
-NSString* const RXMouseDownScriptKey = @"mouse down";
-NSString* const RXMouseStillDownScriptKey = @"mouse still down";
-NSString* const RXMouseUpScriptKey = @"mouse up";
-NSString* const RXUnknown3ScriptKey = @"unknown 3";
-NSString* const RXMouseInsideScriptKey = @"mouse inside";
-NSString* const RXMouseExitedScriptKey = @"mouse exited";
-NSString* const RXCardOpenScriptKey = @"open card";
-NSString* const RXCardCloseScriptKey = @"close card";
-NSString* const RXIdleScriptKey = @"idle";
-NSString* const RXStartRenderingScriptKey = @"start rendering";
-NSString* const RXScreenUpdateScriptKey = @"screen update";
-
 NSString* const RXScriptProgramKey = @"program";
 NSString* const RXScriptOpcodeCountKey = @"opcode count";
 
-static NSString* const script_keys_array[11] = {
-    @"mouse down",
-    @"mouse still down",
-    @"mouse up",
-    @"unknown 3",
-    @"mouse inside",
-    @"mouse exited",
-    @"open card",
-    @"close card",
-    @"idle",
-    @"start rendering",
-    @"screen update"
-};
-
 size_t rx_compute_riven_script_length(const void* script, uint16_t command_count, bool byte_swap)
 {
     size_t scriptOffset = 0;
@@ -84,75 +59,48 @@ size_t rx_compute_riven_script_length(const void* script, uint16_t command_count
     return scriptOffset;
 }
 
-NSDictionary* rx_decode_riven_script(const void* script, uint32_t* script_length)
+static void rx_log_script_violation(void* context, uint16_t event, const rx_script_violation_t* violation)
 {
-    // WARNING: THIS METHOD ASSUMES THE INPUT SCRIPT IS IN BIG ENDIAN
-    
-    // a script is composed of several events
-    uint16_t eventCount = CFSwapInt16BigToHost(*(const uint16_t*)script);
-    uint32_t scriptOffset = 2;
-    
-    // one array of Riven programs per event type
-    uint32_t eventTypeCount = sizeof(script_keys_array) / sizeof(NSString*);
-    uint16_t currentEventIndex = 0;
-    NSMutableArray** eventProgramsPerType = (NSMutableArray**)malloc(sizeof(NSMutableArray*) * eventTypeCount);
-    for (; currentEventIndex < eventTypeCount; currentEventIndex++)
-        eventProgramsPerType[currentEventIndex] = [[NSMutableArray alloc] initWithCapacity:eventCount];
-    
-    // process the programs
-    for (currentEventIndex = 0; currentEventIndex < eventCount; ++currentEventIndex)
-    {
-        // event type, command count
-        uint16_t eventCode = CFSwapInt16BigToHost(*(const uint16_t*)BUFFER_OFFSET(script, scriptOffset));
-        scriptOffset += 2;
-        uint16_t commandCount = CFSwapInt16BigToHost(*(const uint16_t*)BUFFER_OFFSET(script, scriptOffset));
-        scriptOffset += 2;
-        
-        // program length
-        size_t programLength = rx_compute_riven_script_length(BUFFER_OFFSET(script, scriptOffset), commandCount, true);
-        
-        // allocate a storage buffer for the program and swap it if needed
-        uint16_t* programStore = (uint16_t*)malloc(programLength);
-        memcpy(programStore, BUFFER_OFFSET(script, scriptOffset), programLength);
-#if defined(__LITTLE_ENDIAN__)
-        uint32_t shortCount = programLength / 2;
-        while (shortCount > 0)
-        {
-            programStore[shortCount - 1] = CFSwapInt16BigToHost(programStore[shortCount - 1]);
-            shortCount--;
-        }
-#endif
-        
-        // store the program in an NSData object
-        NSData* program = [[NSData alloc] initWithBytesNoCopy:programStore length:programLength freeWhenDone:YES];
-        scriptOffset += programLength;
-        
-        // program descriptor
-        NSDictionary* programDescriptor = [[NSDictionary alloc] initWithObjectsAndKeys:program, RXScriptProgramKey,
-            [NSNumber numberWithUnsignedShort:commandCount], RXScriptOpcodeCountKey,
-            nil];
-        release_assert(eventCode < eventTypeCount);
-        [eventProgramsPerType[eventCode] addObject:programDescriptor];
-        
-        [program release];
-        [programDescriptor release];
-    }
-    
-    // each event key holds an array of programs
-    NSDictionary* scriptDictionary = [[NSDictionary alloc] initWithObjects:eventProgramsPerType
-                                                                   forKeys:script_keys_array count:eventTypeCount];
-    
-    // release the program arrays now that they're in the dictionary
-    for (currentEventIndex = 0; currentEventIndex < eventTypeCount; ++currentEventIndex)
-        [eventProgramsPerType[currentEventIndex] release];
+    const char* event_name = rx_script_event_name(event);
+    if (event == RX_SCRIPT_NO_EVENT)
+        RXLog(kRXLoggingScript, kRXLoggingLevelError, @"rejecting the rest of the script: %s (offset %lu)",
+            rx_script_violation_description(violation->code), (unsigned long)violation->offset);
+    else if (!event_name)
+        RXLog(kRXLoggingScript, kRXLoggingLevelError, @"skipping a program for unknown event type %hu", event);
+    else
+        RXLog(kRXLoggingScript, kRXLoggingLevelError, @"rejecting the %s program: %s (opcode %hu, %hu arguments, offset %lu, depth %u)",
+            event_name, rx_script_violation_description(violation->code), violation->opcode, violation->argc,
+            (unsigned long)violation->offset, violation->depth);
+}
+
+rx_script_t* rx_decode_riven_script(const void* script, size_t available_length, uint32_t* script_length)
+{
+    rx_script_t* decoded_script = rx_script_decode(script, available_length, script_length, rx_log_script_violation, NULL);
+    release_assert(decoded_script);
+    return decoded_script;
+}
+
+NSDictionary* rx_riven_program_descriptor(const rx_script_t* script, uint16_t event, uint32_t index)
+{
+    if (index >= rx_script_program_count(script, event))
+        return nil;
     
-    // release the program array array.
-    free(eventProgramsPerType);
+    rx_script_program_t program = rx_script_program(script, event, index);
+    return [NSDictionary dictionaryWithObjectsAndKeys:
+        [NSData dataWithBytes:program.opcodes length:program.length], RXScriptProgramKey,
+        [NSNumber numberWithUnsignedShort:program.opcode_count], RXScriptOpcodeCountKey,
+        nil];
+}
+
+rx_script_t* rx_replace_riven_program(rx_script_t* script, uint16_t event, uint32_t index, NSDictionary* descriptor)
+{
+    NSData* program = [descriptor objectForKey:RXScriptProgramKey];
+    release_assert(program);
     
-    // return total script length and script dictionary
-    if (script_length)
-        *script_length = scriptOffset;
-    return scriptDictionary;
+    rx_script_t* replaced_script = rx_script_replace_program(script, event, index, (const uint16_t*)[program bytes], [program length],
+                                                             [[descriptor objectForKey:RXScriptOpcodeCountKey] unsignedShortValue]);
+    release_assert(replaced_script);
+    return replaced_script;
 }
 
 uint16_t rx_get_riven_script_opcode(const void* script, uint16_t command_count, uint16_t opcode_index, uint32_t* opcode_offset)
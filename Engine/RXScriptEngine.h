@@ -94,6 +94,9 @@ typedef struct {
     BOOL intro_cho_took_book;
 }
 
++ (SEL)selectorForExternalCommandID:(uint16_t)command_id;
++ (IMP)implementationForExternalCommandID:(uint16_t)command_id;
+
 - (id)initWithController:(id<RXScriptEngineControllerProtocol>)ctlr;
 
 @end
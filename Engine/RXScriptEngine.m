@@ -22,11 +22,15 @@
 #import "Engine/RXScriptDecoding.h"
 #import "Engine/RXScriptEngine.h"
 #import "Engine/RXScriptCommandAliases.h"
+#import "Engine/RXScriptIR.h"
+#import "Engine/RXScriptExternalCommands.h"
+#import "Engine/RXScriptProfiler.h"
 #import "Engine/RXWorldProtocol.h"
 #import "Engine/RXArchiveManager.h"
 #import "Engine/RXCursors.h"
 
 #import "Rendering/Graphics/RXTextureBroker.h"
+#import "Rendering/Graphics/RXTextureAtlas.h"
 #import "Rendering/Graphics/RXTransition.h"
 #import "Rendering/Graphics/RXDynamicPicture.h"
 
@@ -49,9 +53,9 @@ struct _rx_command_dispatch_entry {
 };
 typedef struct _rx_command_dispatch_entry rx_command_dispatch_entry_t;
 
-#define RX_COMMAND_COUNT 48
 static rx_command_dispatch_entry_t _riven_command_dispatch_table[RX_COMMAND_COUNT];
-static NSMapTable* _riven_external_command_dispatch_map;
+static rx_command_dispatch_entry_t _riven_external_command_dispatch_table[RX_EXTERNAL_COMMAND_COUNT];
+static uint16_t _riven_external_command_profiler_ids[RX_EXTERNAL_COMMAND_COUNT];
 
 
 #define DEFINE_COMMAND(NAME) - (void)_external_ ## NAME:(const uint16_t)argc arguments:(const uint16_t*)argv
@@ -99,20 +103,33 @@ CF_INLINE void rx_dispatch_command5(id target, rx_command_dispatch_entry_t* comm
 #define DISPATCH_COMMAND4(COMMAND_INDEX, ARG1, ARG2, ARG3, ARG4) rx_dispatch_command4(self, _riven_command_dispatch_table + COMMAND_INDEX, ARG1, ARG2, ARG3, ARG4)
 #define DISPATCH_COMMAND5(COMMAND_INDEX, ARG1, ARG2, ARG3, ARG4, ARG5) rx_dispatch_command5(self, _riven_command_dispatch_table + COMMAND_INDEX, ARG1, ARG2, ARG3, ARG4, ARG5)
 
-CF_INLINE void rx_dispatch_externalv(id target, NSString* external_name, uint16_t argc, uint16_t* argv) {
-    rx_command_dispatch_entry_t* command = (rx_command_dispatch_entry_t*)NSMapGet(_riven_external_command_dispatch_map,
-                                                                                  [external_name lowercaseString]);
+static void rx_dispatch_opcode_profiled(id target, uint16_t opcode, uint16_t argc, const uint16_t* argv) {
+    rx_script_profiler_enter(kRXScriptProfilerOpcode, opcode);
+    _riven_command_dispatch_table[opcode].imp(target, _riven_command_dispatch_table[opcode].sel, argc, argv);
+    rx_script_profiler_exit(kRXScriptProfilerOpcode, opcode);
+}
+
+// dispatches a script program opcode; when the script profiler is off, this costs a single branch over the call
+CF_INLINE void rx_dispatch_opcode(id target, uint16_t opcode, uint16_t argc, const uint16_t* argv) {
+    if (RX_SCRIPT_PROFILING())
+        rx_dispatch_opcode_profiled(target, opcode, argc, argv);
+    else
+        _riven_command_dispatch_table[opcode].imp(target, _riven_command_dispatch_table[opcode].sel, argc, argv);
+}
+
+CF_INLINE void rx_dispatch_externalv(id target, uint16_t command_id, uint16_t argc, uint16_t* argv) {
+    rx_command_dispatch_entry_t* command = _riven_external_command_dispatch_table + command_id;
     command->imp(target, command->sel, argc, argv);
 }
 
-CF_INLINE void rx_dispatch_external0(id target, NSString* external_name) {
+CF_INLINE void rx_dispatch_external0(id target, uint16_t command_id) {
     uint16_t args;
-    rx_dispatch_externalv(target, external_name, 0, &args);
+    rx_dispatch_externalv(target, command_id, 0, &args);
 }
 
-CF_INLINE void rx_dispatch_external1(id target, NSString* external_name, uint16_t a1) {
+CF_INLINE void rx_dispatch_external1(id target, uint16_t command_id, uint16_t a1) {
     uint16_t args[] = {a1};
-    rx_dispatch_externalv(target, external_name, 1, args);
+    rx_dispatch_externalv(target, command_id, 1, args);
 }
 
 CF_INLINE double rx_rnd_range(double lower, double upper) {
@@ -184,59 +201,39 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
     _riven_command_dispatch_table[46].sel = @selector(_opcode_activateMLST:arguments:);
     _riven_command_dispatch_table[47].sel = @selector(_opcode_activateSLSTWithVolume:arguments:);
     
-    for (unsigned char selectorIndex = 0; selectorIndex < RX_COMMAND_COUNT; selectorIndex++)
+    for (unsigned char selectorIndex = 0; selectorIndex < RX_COMMAND_COUNT; selectorIndex++) {
         _riven_command_dispatch_table[selectorIndex].imp =
             (rx_command_imp_t)[self instanceMethodForSelector:_riven_command_dispatch_table[selectorIndex].sel];
-    
-    // search for external command implementation methods and register them
-    _riven_external_command_dispatch_map = NSCreateMapTable(NSObjectMapKeyCallBacks, NSNonRetainedObjectMapValueCallBacks, 0);
-    
-    NSCharacterSet* colon_character_set = [NSCharacterSet characterSetWithCharactersInString:@":"];
-    
-/*
-    void* iterator = 0;
-    struct objc_method_list* mlist;
-    while ((mlist = class_nextMethodList(self, &iterator))) {
-        for (int method_index = 0; method_index < mlist->method_count; method_index++) {
-            Method m = mlist->method_list + method_index;
-            NSString* method_selector_string = NSStringFromSelector(m->method_name);
-            if ([method_selector_string hasPrefix:@"_external_"]) {
-                NSRange first_colon_range = [method_selector_string rangeOfCharacterFromSet:colon_character_set options:NSLiteralSearch];
-                NSString* external_name = [[method_selector_string substringWithRange:NSMakeRange([(NSString*)@"_external_" length],
-                                                                                                  first_colon_range.location - [(NSString*)@"_external_" length])]
-                                           lowercaseString];
-#if defined(DEBUG) && DEBUG > 1
-                RXLog(kRXLoggingEngine, kRXLoggingLevelDebug, @"registering external command: %@", external_name);
-#endif
-                rx_command_dispatch_entry_t* command_dispatch = (rx_command_dispatch_entry_t*)malloc(sizeof(rx_command_dispatch_entry_t));
-                command_dispatch->sel = m->method_name;
-                command_dispatch->imp = (rx_command_imp_t)m->method_imp;
-                NSMapInsertKnownAbsent(_riven_external_command_dispatch_map, external_name, command_dispatch);
-            }
-        }
-    }
-*/
-    uint32_t mlist_count;
-    Method* mlist = class_copyMethodList(self, &mlist_count);
-    for (uint32_t method_index = 0; method_index < mlist_count; ++method_index) {
-        Method m = mlist[method_index];
-        SEL m_sel = method_getName(m);
-        NSString* method_selector_string = NSStringFromSelector(m_sel);
-        if ([method_selector_string hasPrefix:@"_external_"]) {
-            NSRange first_colon_range = [method_selector_string rangeOfCharacterFromSet:colon_character_set options:NSLiteralSearch];
-            NSRange range = NSMakeRange([(NSString*)@"_external_" length], first_colon_range.location - [(NSString*)@"_external_" length]);
-            NSString* external_name = [[method_selector_string substringWithRange:range] lowercaseString];
-#if defined(DEBUG) && DEBUG > 1
-            RXLog(kRXLoggingEngine, kRXLoggingLevelDebug, @"registering external command: %@", external_name);
-#endif
-            rx_command_dispatch_entry_t* command_dispatch = (rx_command_dispatch_entry_t*)malloc(sizeof(rx_command_dispatch_entry_t));
-            command_dispatch->sel = m_sel;
-            command_dispatch->imp = (rx_command_imp_t)method_getImplementation(m);
-            NSMapInsertKnownAbsent(_riven_external_command_dispatch_map, external_name, command_dispatch);
-        }
         
+        // name the opcodes in profiler reports after their method, e.g. "activatePLST"
+        NSString* method_name = NSStringFromSelector(_riven_command_dispatch_table[selectorIndex].sel);
+        method_name = [method_name substringToIndex:[method_name rangeOfString:@":"].location];
+        if ([method_name hasPrefix:@"_opcode_"])
+            method_name = [method_name substringFromIndex:[(NSString*)@"_opcode_" length]];
+        rx_script_profiler_set_opcode_name(selectorIndex, [method_name UTF8String]);
+    }
+    
+    // build the external command dispatch table from the external command list; the selectors are checked at compile
+    // time, and a command in the list without an implementation fails here rather than when a script calls it
+#define RX_REGISTER_EXTERNAL_COMMAND(NAME) \
+    _riven_external_command_dispatch_table[RX_EXTERNAL_COMMAND_ID(NAME)].sel = COMMAND_SELECTOR(NAME);
+    RX_EXTERNAL_COMMANDS(RX_REGISTER_EXTERNAL_COMMAND)
+#undef RX_REGISTER_EXTERNAL_COMMAND
+    
+    for (uint16_t command_id = 0; command_id < RX_EXTERNAL_COMMAND_COUNT; command_id++) {
+        _riven_external_command_dispatch_table[command_id].imp =
+            (rx_command_imp_t)[self instanceMethodForSelector:_riven_external_command_dispatch_table[command_id].sel];
+        release_assert(_riven_external_command_dispatch_table[command_id].imp);
+        _riven_external_command_profiler_ids[command_id] = rx_script_profiler_external_id(rx_external_command_names[command_id]);
     }
-    free(mlist);
+}
+
++ (SEL)selectorForExternalCommandID:(uint16_t)command_id {
+    return (command_id < RX_EXTERNAL_COMMAND_COUNT) ? _riven_external_command_dispatch_table[command_id].sel : NULL;
+}
+
++ (IMP)implementationForExternalCommandID:(uint16_t)command_id {
+    return (command_id < RX_EXTERNAL_COMMAND_COUNT) ? (IMP)_riven_external_command_dispatch_table[command_id].imp : NULL;
 }
 
 + (BOOL)accessInstanceVariablesDirectly {
@@ -405,18 +402,16 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
             program_off += 8;
             program = (uint16_t*)BUFFER_OFFSET(program_buffer, program_off);
             
-            // argc should always be 2 for a conditional branch
-            if (argc != 2)
-                @throw [NSException exceptionWithName:NSInternalInconsistencyException reason:@"INVALID NUMBER OF ARGUMENTS" userInfo:nil];
+            // argc is always 2 for a conditional branch; rx_decode_riven_script rejects programs where it isn't
+            debug_assert(argc == 2);
+            (void)argc;
             
             // get the variable from the game state
-            NSString* name = [parent varNameAtIndex:variable_id];
-            if (!name)
-                name = [NSString stringWithFormat:@"%@%hu", [parent key], variable_id];
-            uint16_t var_val = [[g_world gameState] unsignedShortForKey:name];
+            uint16_t var_val = [[g_world gameState] unsignedShortForVariable:[parent variableIDAtIndex:variable_id]];
             
 #if defined(DEBUG)
-            RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@switch statement on variable %@=%hu", logPrefix, name, var_val);
+            RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@switch statement on variable %@=%hu", logPrefix,
+                [RXGameState keyForVariableID:[parent variableIDAtIndex:variable_id]], var_val);
 #endif
             
             // evaluate each branch
@@ -480,9 +475,9 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
                 }
             }
         } else {
-            // execute the command
-            _riven_command_dispatch_table[*program].imp(self, _riven_command_dispatch_table[*program].sel,
-                                                        *(program + 1), program + 2);
+            // execute the command; verified programs only have opcodes that are in the dispatch table
+            debug_assert(*program < RX_COMMAND_COUNT);
+            rx_dispatch_opcode(self, *program, *(program + 1), program + 2);
             
             
             // adjust the shorted program
@@ -500,28 +495,112 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
     return program_off;
 }
 
+// IR executor callbacks; these mirror what -_executeRivenProgram:count: does for each step of a program
+
+static uint16_t rx_ir_variable_value(void* context, uint16_t variable_id) {
+    RXScriptEngine* engine = (RXScriptEngine*)context;
+    uint32_t variable = [[[engine->_card descriptor] parent] variableIDAtIndex:variable_id];
+    uint16_t var_val = [[g_world gameState] unsignedShortForVariable:variable];
+    
+#if defined(DEBUG)
+    RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@switch statement on variable %@=%hu", engine->logPrefix,
+        [RXGameState keyForVariableID:variable], var_val);
+#endif
+    
+    return var_val;
+}
+
+static void rx_ir_execute_command(void* context, uint16_t opcode, uint16_t argc, const uint16_t* argv) {
+    rx_dispatch_opcode((id)context, opcode, argc, argv);
+}
+
+static bool rx_ir_should_abort(void* context) {
+    return ((RXScriptEngine*)context)->_abortProgramExecution;
+}
+
+static void rx_ir_enter_block(void* context) {
+    ((RXScriptEngine*)context)->_programExecutionDepth++;
+}
+
+static void rx_ir_exit_block(void* context) {
+    RXScriptEngine* engine = (RXScriptEngine*)context;
+    release_assert(engine->_programExecutionDepth > 0);
+    engine->_programExecutionDepth--;
+    if (engine->_programExecutionDepth == 0)
+        engine->_abortProgramExecution = NO;
+}
+
+#if defined(DEBUG)
+static void rx_ir_case_enter(void* context, uint16_t variable_id, uint16_t value, bool is_default) {
+    RXScriptEngine* engine = (RXScriptEngine*)context;
+    if (is_default)
+        RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@no case matched variable value, executing default case {", engine->logPrefix);
+    else
+        RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@executing matching case {", engine->logPrefix);
+    [engine->logPrefix appendString:@"    "];
+}
+
+static void rx_ir_case_exit(void* context) {
+    RXScriptEngine* engine = (RXScriptEngine*)context;
+    [engine->logPrefix deleteCharactersInRange:NSMakeRange([engine->logPrefix length] - 4, 4)];
+    RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@}", engine->logPrefix);
+}
+#endif
+
+- (void)_executeProgram:(const rx_script_program_t*)program {
+    if (!program->ir) {
+        [self _executeRivenProgram:program->opcodes count:program->opcode_count];
+        return;
+    }
+    
+    if (!controller)
+        @throw [NSException exceptionWithName:NSInternalInconsistencyException reason:@"NO RIVEN SCRIPT HANDLER" userInfo:nil];
+    
+    rx_script_ir_executor_t executor;
+    executor.context = self;
+    executor.variable_value = rx_ir_variable_value;
+    executor.execute_command = rx_ir_execute_command;
+    executor.should_abort = rx_ir_should_abort;
+    executor.enter_block = rx_ir_enter_block;
+    executor.exit_block = rx_ir_exit_block;
+#if defined(DEBUG)
+    executor.case_enter = rx_ir_case_enter;
+    executor.case_exit = rx_ir_case_exit;
+#else
+    executor.case_enter = NULL;
+    executor.case_exit = NULL;
+#endif
+    
+    rx_script_ir_execute(program->ir, &executor);
+}
+
 - (void)_runScreenUpdatePrograms {
 #if defined(DEBUG)
     RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@screen update {", logPrefix);
     [logPrefix appendString:@"    "];
 #endif
     
+    // retain the card while it executes programs
+    RXCard* executing_card = _card;
+    [executing_card retain];
+    
     // disable screen updates while running screen update programs
     _screen_update_disable_counter++;
     
-    NSArray* programs = [[_card scripts] objectForKey:RXScreenUpdateScriptKey];
-    uint32_t programCount = [programs count];
+    const rx_script_t* scripts = [_card scripts];
+    uint32_t programCount = rx_script_program_count(scripts, kScriptTypeScreenUpdate);
     uint32_t programIndex = 0;
     for (; programIndex < programCount; programIndex++) {
-        NSDictionary* program = [programs objectAtIndex:programIndex];
-        [self _executeRivenProgram:[[program objectForKey:RXScriptProgramKey] bytes]
-                             count:[[program objectForKey:RXScriptOpcodeCountKey] unsignedShortValue]];
+        rx_script_program_t program = rx_script_program(scripts, kScriptTypeScreenUpdate, programIndex);
+        [self _executeProgram:&program];
     }
     
     // re-enable screen updates to match the disable we did above
     if (_screen_update_disable_counter > 0)
         _screen_update_disable_counter--;
     
+    [executing_card release];
+    
 #if defined(DEBUG)
     [logPrefix deleteCharactersInRange:NSMakeRange([logPrefix length] - 4, 4)];
     RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@}", logPrefix);
@@ -620,13 +699,12 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
     }
     
     // execute card open programs
-    NSArray* programs = [[_card scripts] objectForKey:RXCardOpenScriptKey];
-    uint32_t programCount = [programs count];
+    const rx_script_t* scripts = [_card scripts];
+    uint32_t programCount = rx_script_program_count(scripts, kScriptTypeCardOpen);
     uint32_t programIndex = 0;
-    for(; programIndex < programCount; programIndex++) {
-        NSDictionary* program = [programs objectAtIndex:programIndex];
-        [self _executeRivenProgram:[[program objectForKey:RXScriptProgramKey] bytes]
-                             count:[[program objectForKey:RXScriptOpcodeCountKey] unsignedShortValue]];
+    for (; programIndex < programCount; programIndex++) {
+        rx_script_program_t program = rx_script_program(scripts, kScriptTypeCardOpen, programIndex);
+        [self _executeProgram:&program];
     }
     
     // activate the first picture if none has been enabled already
@@ -692,13 +770,12 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
     // workarounds that should execute before the start rendering programs
     
     // execute rendering programs (index 9)
-    NSArray* programs = [[_card scripts] objectForKey:RXStartRenderingScriptKey];
-    uint32_t programCount = [programs count];
+    const rx_script_t* scripts = [_card scripts];
+    uint32_t programCount = rx_script_program_count(scripts, kScriptTypeStartRendering);
     uint32_t programIndex = 0;
     for (; programIndex < programCount; programIndex++) {
-        NSDictionary* program = [programs objectAtIndex:programIndex];
-        [self _executeRivenProgram:[[program objectForKey:RXScriptProgramKey] bytes]
-                             count:[[program objectForKey:RXScriptOpcodeCountKey] unsignedShortValue]];
+        rx_script_program_t program = rx_script_program(scripts, kScriptTypeStartRendering, programIndex);
+        [self _executeProgram:&program];
     }
     
     // activate the first sound group if none has been enabled already
@@ -832,13 +909,12 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
     [executing_card retain];
     
     // execute leaving programs (index 7)
-    NSArray* programs = [[_card scripts] objectForKey:RXCardCloseScriptKey];
-    uint32_t programCount = [programs count];
+    const rx_script_t* scripts = [_card scripts];
+    uint32_t programCount = rx_script_program_count(scripts, kScriptTypeCardClose);
     uint32_t programIndex = 0;
     for (; programIndex < programCount; programIndex++) {
-        NSDictionary* program = [programs objectAtIndex:programIndex];
-        [self _executeRivenProgram:[[program objectForKey:RXScriptProgramKey] bytes]
-                             count:[[program objectForKey:RXScriptOpcodeCountKey] unsignedShortValue]];
+        rx_script_program_t program = rx_script_program(scripts, kScriptTypeCardClose, programIndex);
+        [self _executeProgram:&program];
     }
     
 #if defined(DEBUG)
@@ -902,13 +978,12 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
     _current_hotspot = hotspot;
     
     // execute mouse moved programs (index 4)
-    NSArray* programs = [[hotspot scripts] objectForKey:RXMouseInsideScriptKey];
-    uint32_t programCount = [programs count];
+    const rx_script_t* scripts = [hotspot scripts];
+    uint32_t programCount = rx_script_program_count(scripts, kScriptTypeMouseInside);
     uint32_t programIndex = 0;
     for (; programIndex < programCount; programIndex++) {
-        NSDictionary* program = [programs objectAtIndex:programIndex];
-        [self _executeRivenProgram:[[program objectForKey:RXScriptProgramKey] bytes]
-                             count:[[program objectForKey:RXScriptOpcodeCountKey] unsignedShortValue]];
+        rx_script_program_t program = rx_script_program(scripts, kScriptTypeMouseInside, programIndex);
+        [self _executeProgram:&program];
     }
     
 #if defined(DEBUG)
@@ -947,13 +1022,12 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
     _current_hotspot = hotspot;
     
     // execute mouse leave programs (index 5)
-    NSArray* programs = [[hotspot scripts] objectForKey:RXMouseExitedScriptKey];
-    uint32_t programCount = [programs count];
+    const rx_script_t* scripts = [hotspot scripts];
+    uint32_t programCount = rx_script_program_count(scripts, kScriptTypeMouseExited);
     uint32_t programIndex = 0;
     for (; programIndex < programCount; programIndex++) {
-        NSDictionary* program = [programs objectAtIndex:programIndex];
-        [self _executeRivenProgram:[[program objectForKey:RXScriptProgramKey] bytes]
-                             count:[[program objectForKey:RXScriptOpcodeCountKey] unsignedShortValue]];
+        rx_script_program_t program = rx_script_program(scripts, kScriptTypeMouseExited, programIndex);
+        [self _executeProgram:&program];
     }
     
 #if defined(DEBUG)
@@ -989,13 +1063,12 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
     _current_hotspot = hotspot;
     
     // execute mouse down programs (index 0)
-    NSArray* programs = [[hotspot scripts] objectForKey:RXMouseDownScriptKey];
-    uint32_t programCount = [programs count];
+    const rx_script_t* scripts = [hotspot scripts];
+    uint32_t programCount = rx_script_program_count(scripts, kScriptTypeMouseDown);
     uint32_t programIndex = 0;
     for (; programIndex < programCount; programIndex++) {
-        NSDictionary* program = [programs objectAtIndex:programIndex];
-        [self _executeRivenProgram:[[program objectForKey:RXScriptProgramKey] bytes]
-                             count:[[program objectForKey:RXScriptOpcodeCountKey] unsignedShortValue]];
+        rx_script_program_t program = rx_script_program(scripts, kScriptTypeMouseDown, programIndex);
+        [self _executeProgram:&program];
     }
     
 #if defined(DEBUG)
@@ -1034,13 +1107,12 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
     _current_hotspot = hotspot;
     
     // execute mouse up programs (index 2)
-    NSArray* programs = [[hotspot scripts] objectForKey:RXMouseUpScriptKey];
-    uint32_t programCount = [programs count];
+    const rx_script_t* scripts = [hotspot scripts];
+    uint32_t programCount = rx_script_program_count(scripts, kScriptTypeMouseUp);
     uint32_t programIndex = 0;
     for (; programIndex < programCount; programIndex++) {
-        NSDictionary* program = [programs objectAtIndex:programIndex];
-        [self _executeRivenProgram:[[program objectForKey:RXScriptProgramKey] bytes]
-                             count:[[program objectForKey:RXScriptOpcodeCountKey] unsignedShortValue]];
+        rx_script_program_t program = rx_script_program(scripts, kScriptTypeMouseUp, programIndex);
+        [self _executeProgram:&program];
     }
     
 #if defined(DEBUG)
@@ -1215,7 +1287,11 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
     NSNumber* dynamic_texture_key = [NSNumber numberWithUnsignedInt:(unsigned int)tbmp_id << 2];
     RXTexture* picture_texture = [archive_tex_cache objectForKey:dynamic_texture_key];
     if (!picture_texture) {
-        picture_texture = [[RXTextureBroker sharedTextureBroker] newTextureWithWidth:picture_width height:picture_height];
+        // small pictures go in the texture atlas, so that the pictures of a card share a few textures
+        if (RXEngineGetBool(@"rendering.picture_atlas"))
+            picture_texture = [[RXTextureAtlas sharedTextureAtlas] newTextureWithSize:RXSizeMake(picture_width, picture_height)];
+        if (!picture_texture)
+            picture_texture = [[RXTextureBroker sharedTextureBroker] newTextureWithWidth:picture_width height:picture_height];
         [picture_texture updateWithBitmap:tbmp_id archive:archive];
         
         // map the tBMP ID to the texture object
@@ -1431,16 +1507,13 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
     if (argc < 2)
         @throw [NSException exceptionWithName:NSInternalInconsistencyException reason:@"INVALID NUMBER OF ARGUMENTS" userInfo:nil];
     
-    RXStack* parent = [[_card descriptor] parent];
-    NSString* name = [parent varNameAtIndex:argv[0]];
-    if (!name)
-        name = [NSString stringWithFormat:@"%@%hu", [parent key], argv[0]];
+    uint32_t variable = [[[_card descriptor] parent] variableIDAtIndex:argv[0]];
 #if defined(DEBUG)
     if (!_disableScriptLogging)
-        RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@setting variable %@ to %hu", logPrefix, name, argv[1]);
+        RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@setting variable %@ to %hu", logPrefix, [RXGameState keyForVariableID:variable], argv[1]);
 #endif
     
-    [[g_world gameState] setUnsignedShort:argv[1] forKey:name];
+    [[g_world gameState] setUnsignedShort:argv[1] forVariable:variable];
 }
 
 // 9
@@ -1561,12 +1634,21 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
     uint16_t external_id = argv[0];
     uint16_t external_argc = argv[1];
     
-    NSString* external_name = [[[[_card descriptor] parent] externalNameAtIndex:external_id] lowercaseString];
-    if (!external_name)
-        @throw [NSException exceptionWithName:NSInternalInconsistencyException reason:@"INVALID EXTERNAL COMMAND ID" userInfo:nil];
+    // the stack resolved its external command names to command IDs when it was loaded
+    RXStack* stack = [[_card descriptor] parent];
+    uint16_t command_id = [stack externalCommandIDAtIndex:external_id];
+    if (command_id == RX_EXTERNAL_COMMAND_UNKNOWN) {
+        NSString* external_name = [[stack externalNameAtIndex:external_id] lowercaseString];
+        if (!external_name)
+            @throw [NSException exceptionWithName:NSInternalInconsistencyException reason:@"INVALID EXTERNAL COMMAND ID" userInfo:nil];
+        
+        RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@WARNING: external command '%@' is not implemented!",
+                logPrefix, external_name);
+        return;
+    }
     
 #if defined(DEBUG)
-    NSString* fmt = [NSString stringWithFormat:@"calling external %@(", external_name];
+    NSString* fmt = [NSString stringWithFormat:@"calling external %s(", rx_external_command_names[command_id]];
     
     uint16_t argi = 0;
     if (external_argc > 1) {
@@ -1585,19 +1667,14 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
 #endif
     
     // dispatch the call to the external command
-    rx_command_dispatch_entry_t* command_dispatch = (rx_command_dispatch_entry_t*)NSMapGet(_riven_external_command_dispatch_map,
-                                                                                           external_name);
-    if (!command_dispatch) {
-        RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@    WARNING: external command '%@' is not implemented!",
-                logPrefix, external_name);
-#if defined(DEBUG)
-        [logPrefix deleteCharactersInRange:NSMakeRange([logPrefix length] - 4, 4)];
-        RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@}", logPrefix);
-#endif
-        return;
-    }
-        
-    command_dispatch->imp(self, command_dispatch->sel, external_argc, argv + 2);
+    rx_command_dispatch_entry_t* command_dispatch = _riven_external_command_dispatch_table + command_id;
+    if (RX_SCRIPT_PROFILING()) {
+        uint16_t profiler_id = _riven_external_command_profiler_ids[command_id];
+        rx_script_profiler_enter(kRXScriptProfilerExternal, profiler_id);
+        command_dispatch->imp(self, command_dispatch->sel, external_argc, argv + 2);
+        rx_script_profiler_exit(kRXScriptProfilerExternal, profiler_id);
+    } else
+        command_dispatch->imp(self, command_dispatch->sel, external_argc, argv + 2);
     
 #if defined(DEBUG)
     [logPrefix deleteCharactersInRange:NSMakeRange([logPrefix length] - 4, 4)];
@@ -1672,17 +1749,15 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
     if (argc < 2)
         @throw [NSException exceptionWithName:NSInternalInconsistencyException reason:@"INVALID NUMBER OF ARGUMENTS" userInfo:nil];
     
-    RXStack* parent = [[_card descriptor] parent];
-    NSString* name = [parent varNameAtIndex:argv[0]];
-    if (!name)
-        name = [NSString stringWithFormat:@"%@%hu", [parent key], argv[0]];
+    uint32_t variable = [[[_card descriptor] parent] variableIDAtIndex:argv[0]];
 #if defined(DEBUG)
     if (!_disableScriptLogging)
-        RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@incrementing variable %@ by %hu", logPrefix, name, argv[1]);
+        RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@incrementing variable %@ by %hu", logPrefix, [RXGameState keyForVariableID:variable], argv[1]);
 #endif
     
-    uint16_t v = [[g_world gameState] unsignedShortForKey:name];
-    [[g_world gameState] setUnsignedShort:(v + argv[1]) forKey:name];
+    RXGameState* gs = [g_world gameState];
+    uint16_t v = [gs unsignedShortForVariable:variable];
+    [gs setUnsignedShort:(v + argv[1]) forVariable:variable];
 }
 
 // 25
@@ -1690,17 +1765,15 @@ CF_INLINE double rx_rnd_range(double lower, double upper) {
     if (argc < 2)
         @throw [NSException exceptionWithName:NSInternalInconsistencyException reason:@"INVALID NUMBER OF ARGUMENTS" userInfo:nil];
     
-    RXStack* parent = [[_card descriptor] parent];
-    NSString* name = [parent varNameAtIndex:argv[0]];
-    if (!name)
-        name = [NSString stringWithFormat:@"%@%hu", [parent key], argv[0]];
+    uint32_t variable = [[[_card descriptor] parent] variableIDAtIndex:argv[0]];
 #if defined(DEBUG)
     if (!_disableScriptLogging)
-        RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@decrementing variable %@ by %hu", logPrefix, name, argv[1]);
+        RXLog(kRXLoggingScript, kRXLoggingLevelDebug, @"%@decrementing variable %@ by %hu", logPrefix, [RXGameState keyForVariableID:variable], argv[1]);
 #endif
     
-    uint16_t v = [[g_world gameState] unsignedShortForKey:name];
-    [[g_world gameState] setUnsignedShort:(v - argv[1]) forKey:name];
+    RXGameState* gs = [g_world gameState];
+    uint16_t v = [gs unsignedShortForVariable:variable];
+    [gs setUnsignedShort:(v - argv[1]) forVariable:variable];
 }
 
 // 26
@@ -4946,7 +5019,7 @@ DEFINE_COMMAND(xbaitplate) {
         return;
     
     // dispatch xbcheckcatch with 1 (e.g. play the trap sound)
-    rx_dispatch_external1(self, @"xbcheckcatch", 1);
+    rx_dispatch_external1(self, RX_EXTERNAL_COMMAND_ID(xbcheckcatch), 1);
 }
 
 DEFINE_COMMAND(xbsettrap) {
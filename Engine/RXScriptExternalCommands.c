@@ -0,0 +1,30 @@
+/*
+ *  RXScriptExternalCommands.c
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 24/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <strings.h>
+
+#include "Engine/RXScriptExternalCommands.h"
+
+
+const char* const rx_external_command_names[RX_EXTERNAL_COMMAND_COUNT] = {
+#define RX_EXTERNAL_COMMAND_NAME(NAME) #NAME,
+    RX_EXTERNAL_COMMANDS(RX_EXTERNAL_COMMAND_NAME)
+#undef RX_EXTERNAL_COMMAND_NAME
+};
+
+uint16_t rx_external_command_id(const char* name)
+{
+    // this only runs when stacks are loaded, so a linear search is plenty
+    for (uint16_t command_id = 0; command_id < RX_EXTERNAL_COMMAND_COUNT; command_id++)
+    {
+        if (strcasecmp(name, rx_external_command_names[command_id]) == 0)
+            return command_id;
+    }
+    return RX_EXTERNAL_COMMAND_UNKNOWN;
+}
@@ -0,0 +1,162 @@
+//
+//  RXScriptExternalCommands.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 24/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#if !defined(RX_SCRIPT_EXTERNAL_COMMANDS_H)
+#define RX_SCRIPT_EXTERNAL_COMMANDS_H
+
+#include <sys/cdefs.h>
+#include <stdint.h>
+
+//
+// Every external command implemented by the script engine, in the order of their DEFINE_COMMAND implementations. The
+// script engine builds its external command dispatch table from this list, and stacks resolve the names in their
+// NAME 3 resource to these dense command IDs when they are loaded, so that calling an external command is an
+// indexed indirect call. A DEFINE_COMMAND that is not in this list cannot be called by scripts.
+//
+
+#define RX_EXTERNAL_COMMANDS(X) \
+    X(xarestoregame) \
+    X(xasetupcomplete) \
+    X(xastartupbtnhide) \
+    X(xthideinventory) \
+    X(xaatrusopenbook) \
+    X(xaatrusbookback) \
+    X(xaatrusbookprevpage) \
+    X(xaatrusbooknextpage) \
+    X(xacathopenbook) \
+    X(xacathbookback) \
+    X(xacathbookprevpage) \
+    X(xacathbooknextpage) \
+    X(xtrapbookback) \
+    X(xatrapbookopen) \
+    X(xatrapbookclose) \
+    X(xtatrusgivesbooks) \
+    X(xtchotakesbook) \
+    X(xblabopenbook) \
+    X(xblabbookprevpage) \
+    X(xblabbooknextpage) \
+    X(xogehnopenbook) \
+    X(xogehnbookprevpage) \
+    X(xogehnbooknextpage) \
+    X(xicon) \
+    X(xcheckicons) \
+    X(xtoggleicon) \
+    X(xjtunnel103_pictfix) \
+    X(xjtunnel104_pictfix) \
+    X(xjtunnel105_pictfix) \
+    X(xjtunnel106_pictfix) \
+    X(xreseticons) \
+    X(xhandlecontrolup) \
+    X(xhandlecontrolmid) \
+    X(xhandlecontroldown) \
+    X(xvalvecontrol) \
+    X(xbchipper) \
+    X(xbupdateboiler) \
+    X(xbchangeboiler) \
+    X(xsoundplug) \
+    X(xjschool280_resetleft) \
+    X(xjschool280_resetright) \
+    X(xschool280_playwhark) \
+    X(xbscpbtn) \
+    X(xbisland_domecheck) \
+    X(xbisland190_opencard) \
+    X(xbisland190_resetsliders) \
+    X(xbisland190_slidermd) \
+    X(xbisland190_slidermw) \
+    X(xgscpbtn) \
+    X(xgisland1490_domecheck) \
+    X(xgisland25_opencard) \
+    X(xgisland25_resetsliders) \
+    X(xgisland25_slidermd) \
+    X(xgisland25_slidermw) \
+    X(xjscpbtn) \
+    X(xjisland3500_domecheck) \
+    X(xjdome25_resetsliders) \
+    X(xjdome25_slidermd) \
+    X(xjdome25_slidermw) \
+    X(xpscpbtn) \
+    X(xpisland290_domecheck) \
+    X(xpisland25_opencard) \
+    X(xpisland25_resetsliders) \
+    X(xpisland25_slidermd) \
+    X(xpisland25_slidermw) \
+    X(xtscpbtn) \
+    X(xtisland4990_domecheck) \
+    X(xtisland5056_opencard) \
+    X(xtisland5056_resetsliders) \
+    X(xtisland5056_slidermd) \
+    X(xtisland5056_slidermw) \
+    X(xt7600_setupmarbles) \
+    X(xt7800_setup) \
+    X(xdrawmarbles) \
+    X(xtakeit) \
+    X(xt7500_checkmarbles) \
+    X(xgwt200_scribetime) \
+    X(xgwt900_scribe) \
+    X(xglview_prisonon) \
+    X(xglview_prisonoff) \
+    X(xglview_villageon) \
+    X(xglview_villageoff) \
+    X(xglviewer) \
+    X(xgrviewer) \
+    X(xgwharksnd) \
+    X(xgplaywhark) \
+    X(xgplateau3160_dopools) \
+    X(xvga1300_carriage) \
+    X(xgrotatepins) \
+    X(xgpincontrols) \
+    X(xgresetpins) \
+    X(xbait) \
+    X(xbaitplate) \
+    X(xbsettrap) \
+    X(xbcheckcatch) \
+    X(xbfreeytram) \
+    X(xtexterior300_telescopeup) \
+    X(xtexterior300_telescopedown) \
+    X(xtisland390_covercombo) \
+    X(xrwindowsetup) \
+    X(xrcredittime) \
+    X(xrhideinventory) \
+    X(xrshowinventory) \
+    X(xbookclick) \
+    X(xorollcredittime) \
+    X(xooffice30_closebook) \
+    X(xobedroom5_closedrawer) \
+    X(xgwatch) \
+    X(xpisland990_elevcombo) \
+    X(xjplaybeetle_550) \
+    X(xjplaybeetle_600) \
+    X(xjplaybeetle_950) \
+    X(xjplaybeetle_1050) \
+    X(xjplaybeetle_1450) \
+    X(xjlagoon700_alert) \
+    X(xjlagoon800_alert) \
+    X(xjlagoon1500_alert) \
+    X(xflies)
+
+#define RX_EXTERNAL_COMMAND_ID(NAME) kRXExternalCommand_ ## NAME
+
+enum {
+#define RX_EXTERNAL_COMMAND_ENUM(NAME) RX_EXTERNAL_COMMAND_ID(NAME),
+    RX_EXTERNAL_COMMANDS(RX_EXTERNAL_COMMAND_ENUM)
+#undef RX_EXTERNAL_COMMAND_ENUM
+    RX_EXTERNAL_COMMAND_COUNT
+};
+
+#define RX_EXTERNAL_COMMAND_UNKNOWN UINT16_MAX
+
+__BEGIN_DECLS
+
+extern const char* const rx_external_command_names[RX_EXTERNAL_COMMAND_COUNT];
+
+// returns the command ID of the named external command, ignoring case, or RX_EXTERNAL_COMMAND_UNKNOWN
+uint16_t rx_external_command_id(const char* name);
+
+__END_DECLS
+
+#endif // RX_SCRIPT_EXTERNAL_COMMANDS_H
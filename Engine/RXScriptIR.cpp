@@ -0,0 +1,465 @@
+//
+//  RXScriptIR.cpp
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 22/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Engine/RXScriptIR.h"
+#include "Engine/RXScriptCommandAliases.h"
+#include "Engine/RXScriptVerifier.h"
+
+
+namespace {
+
+const uint32_t kIRMagic = 0x52584952; // 'RXIR'
+const uint32_t kIRHeaderSize = 12;
+const uint32_t kSwitchHeaderSize = 16;
+
+enum {
+    kCaseTableDense = 0,
+    kCaseTableSorted = 1,
+};
+
+inline uint16_t read16(const uint8_t* ir, uint32_t offset) {
+    uint16_t value;
+    memcpy(&value, ir + offset, sizeof(uint16_t));
+    return value;
+}
+
+inline uint32_t read32(const uint8_t* ir, uint32_t offset) {
+    uint32_t value;
+    memcpy(&value, ir + offset, sizeof(uint32_t));
+    return value;
+}
+
+struct CaseEntry {
+    uint16_t value;
+    uint32_t block;
+
+    bool operator<(const CaseEntry& other) const {return value < other.value;}
+};
+
+class Compiler {
+public:
+    Compiler(const uint16_t* program, size_t word_count) : _program(program), _word_count(word_count), _failed(false) {
+        _ir.reserve(word_count * 3 + kIRHeaderSize);
+    }
+
+    void* Compile(uint16_t opcode_count, size_t* ir_length) {
+        uint32_t header = reserve(kIRHeaderSize);
+        size_t pc = 0;
+        uint32_t root = compile_block(pc, opcode_count);
+        if (_failed)
+            return NULL;
+
+        put32(header, kIRMagic);
+        put32(header + 4, static_cast<uint32_t>(_ir.size()));
+        put32(header + 8, root);
+
+        void* ir = malloc(_ir.size());
+        if (!ir)
+            return NULL;
+        memcpy(ir, &_ir[0], _ir.size());
+        if (ir_length)
+            *ir_length = _ir.size();
+        return ir;
+    }
+
+private:
+    uint32_t reserve(size_t bytes) {
+        uint32_t offset = static_cast<uint32_t>(_ir.size());
+        _ir.resize(_ir.size() + ((bytes + 3) & ~static_cast<size_t>(3)), 0);
+        return offset;
+    }
+
+    void put16(uint32_t offset, uint16_t value) {memcpy(&_ir[offset], &value, sizeof(uint16_t));}
+    void put32(uint32_t offset, uint32_t value) {memcpy(&_ir[offset], &value, sizeof(uint32_t));}
+
+    bool available(size_t pc, size_t words) const {return pc + words <= _word_count;}
+
+    // measures a raw block without emitting anything, the way rx_compute_riven_script_length does, but bounds checked
+    bool skip_block(size_t& pc, uint16_t count) const {
+        for (uint16_t i = 0; i < count; i++) {
+            if (!available(pc, 2))
+                return false;
+            uint16_t opcode = _program[pc];
+            uint16_t argc = _program[pc + 1];
+            if (!available(pc, 2 + argc))
+                return false;
+
+            if (opcode == RX_COMMAND_BRANCH) {
+                if (argc != 2)
+                    return false;
+                uint16_t case_count = _program[pc + 3];
+                pc += 4;
+                for (uint16_t c = 0; c < case_count; c++) {
+                    if (!available(pc, 2))
+                        return false;
+                    uint16_t case_opcode_count = _program[pc + 1];
+                    pc += 2;
+                    if (!skip_block(pc, case_opcode_count))
+                        return false;
+                }
+            } else
+                pc += 2 + argc;
+        }
+        return true;
+    }
+
+    uint32_t compile_block(size_t& pc, uint16_t count) {
+        uint32_t block = reserve(4);
+        put32(block, count);
+
+        for (uint16_t i = 0; i < count && !_failed; i++) {
+            if (!available(pc, 2)) {
+                _failed = true;
+                break;
+            }
+
+            uint16_t opcode = _program[pc];
+            uint16_t argc = _program[pc + 1];
+            if (!available(pc, 2 + argc)) {
+                _failed = true;
+                break;
+            }
+
+            if (opcode == RX_COMMAND_BRANCH)
+                compile_switch(pc);
+            else {
+                uint32_t command = reserve(4 + 2 * argc);
+                put16(command, opcode);
+                put16(command + 2, argc);
+                if (argc)
+                    memcpy(&_ir[command + 4], _program + pc + 2, 2 * argc);
+                pc += 2 + argc;
+            }
+        }
+
+        return block;
+    }
+
+    void compile_switch(size_t& pc) {
+        // argc should always be 2 for a conditional branch
+        if (_program[pc + 1] != 2) {
+            _failed = true;
+            return;
+        }
+
+        uint16_t variable = _program[pc + 2];
+        uint16_t case_count = _program[pc + 3];
+        pc += 4;
+
+        // first pass: collect the case values so that the table can be laid out before the case blocks
+        std::vector<uint16_t> values;
+        values.reserve(case_count);
+        size_t scan = pc;
+        for (uint16_t c = 0; c < case_count; c++) {
+            if (!available(scan, 2)) {
+                _failed = true;
+                return;
+            }
+            values.push_back(_program[scan]);
+            uint16_t case_opcode_count = _program[scan + 1];
+            scan += 2;
+            if (!skip_block(scan, case_opcode_count)) {
+                _failed = true;
+                return;
+            }
+        }
+
+        // unique values, keeping the first case for each value
+        std::vector<uint16_t> unique_values(values);
+        std::sort(unique_values.begin(), unique_values.end());
+        unique_values.erase(std::unique(unique_values.begin(), unique_values.end()), unique_values.end());
+
+        // use a dense table when the values are compact, which is the common case (booleans and small enumerations)
+        uint16_t kind = kCaseTableSorted;
+        uint16_t minimum = 0;
+        uint32_t span = 0;
+        if (!unique_values.empty()) {
+            minimum = unique_values.front();
+            span = static_cast<uint32_t>(unique_values.back()) - minimum + 1;
+            if (span <= 0xffff && span <= 2 * unique_values.size() + 4)
+                kind = kCaseTableDense;
+        }
+
+        uint32_t header = reserve(kSwitchHeaderSize);
+        put16(header, RX_COMMAND_BRANCH);
+        put16(header + 2, variable);
+        put16(header + 4, kind);
+
+        uint32_t table;
+        if (kind == kCaseTableDense) {
+            put16(header + 6, static_cast<uint16_t>(span));
+            table = reserve(4 + 4 * span);
+            put16(table, minimum);
+            put16(table + 2, static_cast<uint16_t>(span));
+        } else {
+            put16(header + 6, static_cast<uint16_t>(unique_values.size()));
+            table = reserve(8 * unique_values.size());
+        }
+
+        // second pass: compile the case blocks in program order
+        std::vector<CaseEntry> entries;
+        entries.reserve(unique_values.size());
+        uint32_t default_block = 0;
+        for (uint16_t c = 0; c < case_count && !_failed; c++) {
+            uint16_t value = _program[pc];
+            uint16_t case_opcode_count = _program[pc + 1];
+            pc += 2;
+
+            CaseEntry entry;
+            entry.value = value;
+            entry.block = compile_block(pc, case_opcode_count);
+
+            if (value == 0xffff)
+                default_block = entry.block;
+
+            bool seen = false;
+            for (size_t e = 0; e < entries.size(); e++) {
+                if (entries[e].value == value) {
+                    seen = true;
+                    break;
+                }
+            }
+            if (!seen)
+                entries.push_back(entry);
+        }
+        if (_failed)
+            return;
+
+        if (kind == kCaseTableDense) {
+            for (size_t e = 0; e < entries.size(); e++)
+                put32(table + 4 + 4 * (entries[e].value - minimum), entries[e].block);
+        } else {
+            std::sort(entries.begin(), entries.end());
+            for (size_t e = 0; e < entries.size(); e++) {
+                put16(table + 8 * e, entries[e].value);
+                put32(table + 8 * e + 4, entries[e].block);
+            }
+        }
+
+        put32(header + 8, default_block);
+        put32(header + 12, static_cast<uint32_t>(_ir.size()));
+    }
+
+    const uint16_t* _program;
+    size_t _word_count;
+    bool _failed;
+    std::vector<uint8_t> _ir;
+};
+
+// walks an IR program the way execute_block does, but every block only once: every offset must lie in the IR and be
+// 4-byte aligned, every command's arguments must fit, every case block must lie between its switch's case table and
+// next instruction, which keeps case blocks strictly forward, and case blocks must nest no deeper than the verifier
+// lets switches nest
+class Validator {
+public:
+    Validator(const uint8_t* ir, uint32_t length) : _ir(ir), _length(length), _heights(length / 4, 0) {}
+
+    bool Validate() {
+        uint32_t height;
+        return validate_block(read32(_ir, 8), 0, height);
+    }
+
+private:
+    bool in_range(uint32_t offset, uint32_t bytes) const {
+        return !(offset & 3) && offset <= _length && bytes <= _length - offset;
+    }
+
+    // height receives how deep case blocks nest under the block
+    bool validate_block(uint32_t block, uint32_t depth, uint32_t& height) {
+        if (depth > RX_SCRIPT_VERIFIER_MAX_DEPTH || block < kIRHeaderSize || !in_range(block, 4))
+            return false;
+
+        // blocks that several cases share are walked once
+        if (_heights[block / 4]) {
+            height = _heights[block / 4] - 1;
+            return depth + height <= RX_SCRIPT_VERIFIER_MAX_DEPTH;
+        }
+
+        height = 0;
+        uint32_t count = read32(_ir, block);
+        uint32_t offset = block + 4;
+        for (uint32_t i = 0; i < count; i++) {
+            if (!in_range(offset, 4))
+                return false;
+
+            if (read16(_ir, offset) == RX_COMMAND_BRANCH) {
+                uint32_t switch_height;
+                if (!validate_switch(offset, depth, switch_height))
+                    return false;
+                height = std::max(height, switch_height);
+                offset = read32(_ir, offset + 12);
+            } else {
+                uint32_t size = (4 + 2 * static_cast<uint32_t>(read16(_ir, offset + 2)) + 3) & ~3u;
+                if (!in_range(offset, size))
+                    return false;
+                offset += size;
+            }
+        }
+
+        _heights[block / 4] = static_cast<uint8_t>(height + 1);
+        return true;
+    }
+
+    bool validate_switch(uint32_t offset, uint32_t depth, uint32_t& height) {
+        if (!in_range(offset, kSwitchHeaderSize))
+            return false;
+
+        uint16_t kind = read16(_ir, offset + 4);
+        uint32_t table = offset + kSwitchHeaderSize;
+        uint32_t entry_count = read16(_ir, offset + 6);
+        uint32_t table_end;
+        if (kind == kCaseTableDense) {
+            if (!in_range(table, 4) || read16(_ir, table + 2) != entry_count || !in_range(table, 4 + 4 * entry_count))
+                return false;
+            table_end = table + 4 + 4 * entry_count;
+        } else if (kind == kCaseTableSorted) {
+            if (!in_range(table, 8 * entry_count))
+                return false;
+            table_end = table + 8 * entry_count;
+
+            // find_case binary searches the table
+            for (uint32_t e = 1; e < entry_count; e++) {
+                if (read16(_ir, table + 8 * e) <= read16(_ir, table + 8 * (e - 1)))
+                    return false;
+            }
+        } else
+            return false;
+
+        uint32_t next = read32(_ir, offset + 12);
+        if (next < table_end || !in_range(next, 0))
+            return false;
+
+        height = 0;
+        if (!validate_case(read32(_ir, offset + 8), table_end, next, depth, height))
+            return false;
+        for (uint32_t e = 0; e < entry_count; e++) {
+            uint32_t target = (kind == kCaseTableDense) ? read32(_ir, table + 4 + 4 * e) : read32(_ir, table + 8 * e + 4);
+            if (!validate_case(target, table_end, next, depth, height))
+                return false;
+        }
+        return true;
+    }
+
+    // height is raised to the height of the case block plus one
+    bool validate_case(uint32_t target, uint32_t table_end, uint32_t next, uint32_t depth, uint32_t& height) {
+        if (target == 0)
+            return true;
+        if (target < table_end || target >= next)
+            return false;
+
+        uint32_t case_height;
+        if (!validate_block(target, depth + 1, case_height))
+            return false;
+        height = std::max(height, case_height + 1);
+        return true;
+    }
+
+    const uint8_t* _ir;
+    uint32_t _length;
+
+    // the height of each validated block plus one, indexed by offset / 4, or 0
+    std::vector<uint8_t> _heights;
+};
+
+// returns the block offset for the case matching value, or 0
+inline uint32_t find_case(const uint8_t* ir, uint32_t switch_offset, uint16_t value) {
+    uint16_t kind = read16(ir, switch_offset + 4);
+    uint32_t table = switch_offset + kSwitchHeaderSize;
+
+    if (kind == kCaseTableDense) {
+        uint16_t minimum = read16(ir, table);
+        uint16_t span = read16(ir, table + 2);
+        uint32_t index = static_cast<uint32_t>(value) - minimum;
+        if (value < minimum || index >= span)
+            return 0;
+        return read32(ir, table + 4 + 4 * index);
+    }
+
+    uint32_t low = 0;
+    uint32_t high = read16(ir, switch_offset + 6);
+    while (low < high) {
+        uint32_t middle = (low + high) / 2;
+        uint16_t middle_value = read16(ir, table + 8 * middle);
+        if (middle_value == value)
+            return read32(ir, table + 8 * middle + 4);
+        if (middle_value < value)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return 0;
+}
+
+void execute_block(const uint8_t* ir, uint32_t block, const rx_script_ir_executor_t* executor) {
+    executor->enter_block(executor->context);
+
+    uint32_t count = read32(ir, block);
+    uint32_t offset = block + 4;
+    for (uint32_t i = 0; i < count; i++) {
+        if (executor->should_abort(executor->context))
+            break;
+
+        uint16_t opcode = read16(ir, offset);
+        if (opcode == RX_COMMAND_BRANCH) {
+            uint16_t variable = read16(ir, offset + 2);
+            uint16_t value = executor->variable_value(executor->context, variable);
+
+            bool is_default = false;
+            uint32_t target = find_case(ir, offset, value);
+            if (!target) {
+                target = read32(ir, offset + 8);
+                is_default = true;
+            }
+
+            if (target) {
+                if (executor->case_enter)
+                    executor->case_enter(executor->context, variable, value, is_default);
+                execute_block(ir, target, executor);
+                if (executor->case_exit)
+                    executor->case_exit(executor->context);
+            }
+
+            offset = read32(ir, offset + 12);
+        } else {
+            uint16_t argc = read16(ir, offset + 2);
+            executor->execute_command(executor->context, opcode, argc, reinterpret_cast<const uint16_t*>(ir + offset + 4));
+            offset += (4 + 2 * argc + 3) & ~3u;
+        }
+    }
+
+    executor->exit_block(executor->context);
+}
+
+} // namespace
+
+void* rx_script_ir_compile(const uint16_t* program, size_t program_length, uint16_t opcode_count, size_t* ir_length) {
+    Compiler compiler(program, program_length / sizeof(uint16_t));
+    return compiler.Compile(opcode_count, ir_length);
+}
+
+bool rx_script_ir_is_valid(const void* ir, size_t ir_length) {
+    if (!ir || ir_length < kIRHeaderSize)
+        return false;
+    const uint8_t* bytes = static_cast<const uint8_t*>(ir);
+    if (read32(bytes, 0) != kIRMagic || read32(bytes, 4) != ir_length)
+        return false;
+
+    Validator validator(bytes, static_cast<uint32_t>(ir_length));
+    return validator.Validate();
+}
+
+void rx_script_ir_execute(const void* ir, const rx_script_ir_executor_t* executor) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(ir);
+    execute_block(bytes, read32(bytes, 8), executor);
+}
@@ -0,0 +1,71 @@
+//
+//  RXScriptIR.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 22/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#if !defined(RX_SCRIPT_IR_H)
+#define RX_SCRIPT_IR_H
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// The script IR is a pre-linked form of a Riven program, produced once when a card's scripts are loaded. Walking a raw
+// program requires measuring every case of a switch that doesn't match just to skip it; the IR instead stores, for
+// each switch, a case table (dense for compact value ranges, sorted otherwise), the default case's block and the
+// offset of the next instruction, so taking a branch is O(1) or O(log n) and never touches the cases it doesn't run.
+//
+// An IR program is a single malloc'ed block with no pointers in it, so it can be freed with free() or wrapped in an
+// NSData. All fields are host-endian and 4-byte aligned, and offsets are relative to the start of the IR:
+//
+//  header:  uint32 magic, uint32 size, uint32 root block offset
+//  block:   uint32 instruction count, followed by the instructions
+//  command: uint16 opcode, uint16 argc, uint16 argv[argc], padded to 4 bytes
+//  switch:  uint16 opcode (RX_COMMAND_BRANCH), uint16 variable, uint16 table kind, uint16 table entry count,
+//           uint32 default case block offset (0 if there is none), uint32 next instruction offset,
+//           the case table, then the case blocks in program order
+//
+// A dense table is a uint16 minimum value and uint16 span followed by span uint32 block offsets (0 for values that
+// have no case); a sorted table is an array of {uint16 value, uint16 padding, uint32 block offset} sorted by value.
+// When several cases have the same value, the first one is in the table; the default case is the last 0xffff case.
+// This is exactly how the original program walker resolves cases.
+//
+
+__BEGIN_DECLS
+
+// execution callbacks; case_enter and case_exit are optional
+struct rx_script_ir_executor {
+    void* context;
+
+    uint16_t (*variable_value)(void* context, uint16_t variable);
+    void (*execute_command)(void* context, uint16_t opcode, uint16_t argc, const uint16_t* argv);
+    bool (*should_abort)(void* context);
+
+    // called around the top-level block and every executed case block
+    void (*enter_block)(void* context);
+    void (*exit_block)(void* context);
+
+    void (*case_enter)(void* context, uint16_t variable, uint16_t value, bool is_default);
+    void (*case_exit)(void* context);
+};
+typedef struct rx_script_ir_executor rx_script_ir_executor_t;
+
+// compiles a host-endian program of the given length in bytes; returns a malloc'ed IR program, or NULL if the program
+// is malformed (truncated, or a switch without exactly 2 arguments)
+void* rx_script_ir_compile(const uint16_t* program, size_t program_length, uint16_t opcode_count, size_t* ir_length);
+
+// returns true if ir is a well-formed IR program of the given length, such as one read back from disk, that
+// rx_script_ir_execute can run without reading out of bounds or nesting case blocks deeper than
+// RX_SCRIPT_VERIFIER_MAX_DEPTH; the whole program is walked once
+bool rx_script_ir_is_valid(const void* ir, size_t ir_length);
+
+void rx_script_ir_execute(const void* ir, const rx_script_ir_executor_t* executor);
+
+__END_DECLS
+
+#endif // RX_SCRIPT_IR_H
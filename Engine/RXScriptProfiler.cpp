@@ -0,0 +1,400 @@
+//
+//  RXScriptProfiler.cpp
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 23/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Engine/RXScriptProfiler.h"
+#include "Utilities/RXRingBuffer.h"
+
+#if defined(__APPLE__)
+#include <CoreFoundation/CoreFoundation.h>
+#include "Base/RXTiming.h"
+#else
+#include <time.h>
+#endif
+
+
+bool g_rx_script_profiling = false;
+
+namespace {
+
+#if defined(__APPLE__)
+inline uint64_t profiler_now() {return RXTimingNow();}
+inline double profiler_seconds(uint64_t ticks) {return RXTimingTimestampDelta(ticks, 0);}
+#else
+inline uint64_t profiler_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+inline double profiler_seconds(uint64_t ticks) {return ticks * 1.0e-9;}
+#endif
+
+const size_t kRingLength = 256 * 1024;
+const size_t kTraceLimit = 1000000;
+const uint32_t kOpcodeSlots = 256;
+
+struct Event {
+    uint64_t timestamp;
+    uint16_t kind;
+    uint16_t id;
+    uint16_t enter;
+    uint16_t padding;
+};
+
+struct Stat {
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+};
+
+// report rows sort by decreasing total time
+struct Row {
+    std::string name;
+    Stat stat;
+
+    bool operator<(const Row& other) const {return stat.total > other.stat.total;}
+};
+
+struct TraceEvent {
+    uint64_t start;
+    uint64_t duration;
+    uint32_t thread;
+    uint16_t kind;
+    uint16_t id;
+};
+
+// one per recording thread; the ring and dropped count belong to the thread, the call stack to the collector
+struct ThreadLog {
+    ThreadLog(uint32_t index) : ring(kRingLength), index(index), dropped(0), exited(false) {}
+
+    RX::RingBuffer ring;
+    uint32_t index;
+    uint64_t dropped;
+    bool exited;
+
+    std::vector<Event> stack;
+};
+
+class Profiler {
+public:
+    Profiler() : _trace_base(0), _reset_timestamp(0), _dropped(0), _next_thread_index(1) {
+        pthread_mutex_init(&_lock, NULL);
+        pthread_key_create(&_key, &Profiler::thread_exited);
+        memset(_opcodes, 0, sizeof(_opcodes));
+    }
+
+    ThreadLog* Log() {
+        ThreadLog* log = static_cast<ThreadLog*>(pthread_getspecific(_key));
+        if (__builtin_expect(log != NULL, 1))
+            return log;
+
+        pthread_mutex_lock(&_lock);
+        log = new ThreadLog(_next_thread_index++);
+        _threads.push_back(log);
+        pthread_mutex_unlock(&_lock);
+
+        pthread_setspecific(_key, log);
+        return log;
+    }
+
+    void Record(uint16_t kind, uint16_t id, bool enter) {
+        Event event;
+        event.timestamp = profiler_now();
+        event.kind = kind;
+        event.id = id;
+        event.enter = enter;
+        event.padding = 0;
+
+        // the ring's capacity is a multiple of the event size, so an event never straddles the end of the storage
+        ThreadLog* log = Log();
+        void* span;
+        if (log->ring.WriteSpan(&span) < sizeof(Event)) {
+            __atomic_add_fetch(&log->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        memcpy(span, &event, sizeof(Event));
+        log->ring.DidWrite(sizeof(Event));
+    }
+
+    void SetOpcodeName(uint16_t opcode, const char* name) {
+        pthread_mutex_lock(&_lock);
+        if (opcode < kOpcodeSlots)
+            _opcode_names[opcode] = name;
+        pthread_mutex_unlock(&_lock);
+    }
+
+    uint16_t ExternalID(const char* name) {
+        pthread_mutex_lock(&_lock);
+        std::map<std::string, uint16_t>::iterator i = _external_ids.find(name);
+        uint16_t id;
+        if (i != _external_ids.end())
+            id = i->second;
+        else {
+            id = static_cast<uint16_t>(_external_names.size());
+            _external_names.push_back(name);
+            _external_ids[name] = id;
+
+            Stat stat = {0, 0, 0};
+            _externals.push_back(stat);
+        }
+        pthread_mutex_unlock(&_lock);
+        return id;
+    }
+
+    void Collect() {
+        pthread_mutex_lock(&_lock);
+
+        std::vector<ThreadLog*>::iterator i = _threads.begin();
+        while (i != _threads.end()) {
+            ThreadLog* log = *i;
+            drain(log);
+            _dropped += __atomic_exchange_n(&log->dropped, 0, __ATOMIC_RELAXED);
+
+            if (__atomic_load_n(&log->exited, __ATOMIC_ACQUIRE)) {
+                drain(log);
+                delete log;
+                i = _threads.erase(i);
+            } else
+                ++i;
+        }
+
+        pthread_mutex_unlock(&_lock);
+    }
+
+    void Reset() {
+        pthread_mutex_lock(&_lock);
+        memset(_opcodes, 0, sizeof(_opcodes));
+        for (size_t e = 0; e < _externals.size(); e++)
+            _externals[e].count = _externals[e].total = _externals[e].max = 0;
+        _trace.clear();
+        _trace_base = 0;
+        _dropped = 0;
+        _reset_timestamp = profiler_now();
+        for (size_t t = 0; t < _threads.size(); t++)
+            _threads[t]->stack.clear();
+        pthread_mutex_unlock(&_lock);
+    }
+
+    char* CopyReport() {
+        Collect();
+
+        std::vector<Row> rows;
+
+        pthread_mutex_lock(&_lock);
+        for (uint32_t op = 0; op < kOpcodeSlots; op++) {
+            if (_opcodes[op].count == 0)
+                continue;
+            Row row;
+            row.name = name(kRXScriptProfilerOpcode, op);
+            row.stat = _opcodes[op];
+            rows.push_back(row);
+        }
+        for (size_t e = 0; e < _externals.size(); e++) {
+            if (_externals[e].count == 0)
+                continue;
+            Row row;
+            row.name = name(kRXScriptProfilerExternal, static_cast<uint16_t>(e));
+            row.stat = _externals[e];
+            rows.push_back(row);
+        }
+        uint64_t dropped = _dropped;
+        pthread_mutex_unlock(&_lock);
+
+        std::sort(rows.begin(), rows.end());
+
+        std::string report;
+        char line[256];
+        snprintf(line, sizeof(line), "%-40s %10s %12s %12s %12s\n", "command", "count", "total ms", "mean us", "max us");
+        report += line;
+        for (size_t r = 0; r < rows.size(); r++) {
+            const Stat& stat = rows[r].stat;
+            snprintf(line, sizeof(line), "%-40s %10llu %12.3f %12.1f %12.1f\n", rows[r].name.c_str(), (unsigned long long)stat.count,
+                     profiler_seconds(stat.total) * 1.0e3, profiler_seconds(stat.total) * 1.0e6 / stat.count,
+                     profiler_seconds(stat.max) * 1.0e6);
+            report += line;
+        }
+        if (dropped) {
+            snprintf(line, sizeof(line), "%llu events dropped\n", (unsigned long long)dropped);
+            report += line;
+        }
+
+        return strdup(report.c_str());
+    }
+
+    bool WriteChromeTrace(const char* path) {
+        Collect();
+
+        FILE* fp = fopen(path, "w");
+        if (!fp)
+            return false;
+
+        pthread_mutex_lock(&_lock);
+        fprintf(fp, "{\"traceEvents\":[\n");
+        for (size_t t = 0; t < _trace.size(); t++) {
+            const TraceEvent& event = _trace[t];
+            std::string event_name = json_escape(name(event.kind, event.id));
+            fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                    (t == 0) ? "" : ",\n", event_name.c_str(), (event.kind == kRXScriptProfilerOpcode) ? "opcode" : "external",
+                    profiler_seconds(event.start - _trace_base) * 1.0e6, profiler_seconds(event.duration) * 1.0e6, event.thread);
+        }
+        fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        pthread_mutex_unlock(&_lock);
+
+        return fclose(fp) == 0;
+    }
+
+private:
+    static void thread_exited(void* value) {
+        __atomic_store_n(&static_cast<ThreadLog*>(value)->exited, true, __ATOMIC_RELEASE);
+    }
+
+    // must be called with the lock held
+    std::string name(uint16_t kind, uint16_t id) const {
+        if (kind == kRXScriptProfilerExternal && id < _external_names.size())
+            return _external_names[id];
+        if (kind == kRXScriptProfilerOpcode && id < kOpcodeSlots && !_opcode_names[id].empty())
+            return _opcode_names[id];
+
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%s %hu", (kind == kRXScriptProfilerOpcode) ? "opcode" : "external", id);
+        return buffer;
+    }
+
+    static std::string json_escape(const std::string& s) {
+        std::string escaped;
+        for (size_t c = 0; c < s.size(); c++) {
+            if (s[c] == '"' || s[c] == '\\')
+                escaped += '\\';
+            if (static_cast<unsigned char>(s[c]) >= 0x20)
+                escaped += s[c];
+        }
+        return escaped;
+    }
+
+    // must be called with the lock held
+    void drain(ThreadLog* log) {
+        const void* span;
+        size_t available;
+        while ((available = log->ring.ReadSpan(&span)) >= sizeof(Event)) {
+            size_t count = available / sizeof(Event);
+            const Event* events = static_cast<const Event*>(span);
+            for (size_t e = 0; e < count; e++)
+                process(log, events[e]);
+            log->ring.DidRead(count * sizeof(Event));
+        }
+    }
+
+    // must be called with the lock held
+    void process(ThreadLog* log, const Event& event) {
+        if (event.timestamp < _reset_timestamp)
+            return;
+
+        if (event.enter) {
+            log->stack.push_back(event);
+            return;
+        }
+
+        // pop to the matching entry; a command that threw or a dropped event leaves unmatched entries behind
+        while (!log->stack.empty()) {
+            Event entry = log->stack.back();
+            log->stack.pop_back();
+            if (entry.kind != event.kind || entry.id != event.id)
+                continue;
+
+            uint64_t duration = event.timestamp - entry.timestamp;
+            Stat* stat = NULL;
+            if (event.kind == kRXScriptProfilerOpcode && event.id < kOpcodeSlots)
+                stat = _opcodes + event.id;
+            else if (event.kind == kRXScriptProfilerExternal && event.id < _externals.size())
+                stat = &_externals[event.id];
+            if (stat) {
+                stat->count++;
+                stat->total += duration;
+                stat->max = std::max(stat->max, duration);
+            }
+
+            if (_trace.size() < kTraceLimit) {
+                if (_trace.empty())
+                    _trace_base = entry.timestamp;
+                TraceEvent trace_event = {entry.timestamp, duration, log->index, event.kind, event.id};
+                _trace.push_back(trace_event);
+            }
+            return;
+        }
+    }
+
+    pthread_mutex_t _lock;
+    pthread_key_t _key;
+    std::vector<ThreadLog*> _threads;
+
+    std::string _opcode_names[kOpcodeSlots];
+    std::vector<std::string> _external_names;
+    std::map<std::string, uint16_t> _external_ids;
+
+    Stat _opcodes[kOpcodeSlots];
+    std::vector<Stat> _externals;
+    std::vector<TraceEvent> _trace;
+    uint64_t _trace_base;
+    uint64_t _reset_timestamp;
+    uint64_t _dropped;
+    uint32_t _next_thread_index;
+};
+
+Profiler& SharedProfiler() {
+    static Profiler* profiler = new Profiler();
+    return *profiler;
+}
+
+} // namespace
+
+void rx_script_profiler_set_enabled(bool enabled) {
+    // create the profiler before any recording site can see the flag
+    SharedProfiler();
+    __atomic_store_n(&g_rx_script_profiling, enabled, __ATOMIC_RELEASE);
+}
+
+void rx_script_profiler_set_opcode_name(uint16_t opcode, const char* name) {
+    SharedProfiler().SetOpcodeName(opcode, name);
+}
+
+uint16_t rx_script_profiler_external_id(const char* name) {
+    return SharedProfiler().ExternalID(name);
+}
+
+void rx_script_profiler_enter(uint16_t kind, uint16_t id) {
+    SharedProfiler().Record(kind, id, true);
+}
+
+void rx_script_profiler_exit(uint16_t kind, uint16_t id) {
+    SharedProfiler().Record(kind, id, false);
+}
+
+void rx_script_profiler_collect(void) {
+    SharedProfiler().Collect();
+}
+
+void rx_script_profiler_reset(void) {
+    SharedProfiler().Reset();
+}
+
+char* rx_script_profiler_copy_report(void) {
+    return SharedProfiler().CopyReport();
+}
+
+bool rx_script_profiler_write_chrome_trace(const char* path) {
+    return SharedProfiler().WriteChromeTrace(path);
+}
@@ -0,0 +1,60 @@
+//
+//  RXScriptProfiler.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 23/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#if !defined(RX_SCRIPT_PROFILER_H)
+#define RX_SCRIPT_PROFILER_H
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// The script profiler records entry and exit timestamps of script opcodes and external commands. Each thread that
+// records events gets its own single-producer ring, so recording never takes a lock; rings are drained by
+// rx_script_profiler_collect into per-opcode and per-external count/total/max tables and a bounded list of trace
+// events, which can be exported in the Chrome trace event format (chrome://tracing).
+//
+// Recording sites check RX_SCRIPT_PROFILING() once and take a separate, instrumented dispatch path when it is true, so
+// the cost of the profiler when it is disabled is a single predictable branch.
+//
+
+__BEGIN_DECLS
+
+enum {
+    kRXScriptProfilerOpcode = 0,
+    kRXScriptProfilerExternal = 1,
+};
+
+extern bool g_rx_script_profiling;
+
+#define RX_SCRIPT_PROFILING() __builtin_expect(g_rx_script_profiling, 0)
+
+void rx_script_profiler_set_enabled(bool enabled);
+
+// names used in reports and traces; external IDs are interned from their names
+void rx_script_profiler_set_opcode_name(uint16_t opcode, const char* name);
+uint16_t rx_script_profiler_external_id(const char* name);
+
+void rx_script_profiler_enter(uint16_t kind, uint16_t id);
+void rx_script_profiler_exit(uint16_t kind, uint16_t id);
+
+// drains every thread's ring into the tables and the trace; safe to call while events are being recorded
+void rx_script_profiler_collect(void);
+
+// clears the tables and the trace; events still in the rings are discarded by the next collection
+void rx_script_profiler_reset(void);
+
+// returns a malloc'ed text report of the tables, sorted by total time
+char* rx_script_profiler_copy_report(void);
+
+bool rx_script_profiler_write_chrome_trace(const char* path);
+
+__END_DECLS
+
+#endif // RX_SCRIPT_PROFILER_H
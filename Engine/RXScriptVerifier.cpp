@@ -0,0 +1,247 @@
+//
+//  RXScriptVerifier.cpp
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 25/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#include <string.h>
+
+#include "Engine/RXScriptVerifier.h"
+#include "Engine/RXScriptCommandAliases.h"
+
+
+namespace {
+
+enum {
+    kArgumentsMinimum = 0,      // at least minimum arguments
+    kArgumentsSwitch,           // exactly 2 arguments, followed by the cases
+    kArgumentsSynthesizedSLST,  // a sound count, then an SLST record for that many sounds
+    kArgumentsExternal,         // an external command ID, an argument count, then that many arguments
+    kArgumentsTransition,       // a transition code, optionally followed by a rect
+};
+
+struct OpcodeSchema {
+    uint8_t kind;
+    uint8_t minimum;
+};
+
+// the arguments each opcode implementation in RXScriptEngine reads; opcodes that are invalid, unimplemented or no-ops
+// read none
+const OpcodeSchema opcode_schemas[RX_COMMAND_COUNT] = {
+    {kArgumentsMinimum, 0},         // 0 invalid
+    {kArgumentsMinimum, 9},         // 1 draw dynamic picture
+    {kArgumentsMinimum, 1},         // 2 go to card
+    {kArgumentsSynthesizedSLST, 1}, // 3 activate synthesized SLST
+    {kArgumentsMinimum, 3},         // 4 play data sound
+    {kArgumentsMinimum, 10},        // 5 activate synthesized MLST
+    {kArgumentsMinimum, 0},         // 6 unimplemented
+    {kArgumentsMinimum, 2},         // 7 set variable
+    {kArgumentsSwitch, 2},          // 8 switch
+    {kArgumentsMinimum, 1},         // 9 enable hotspot
+    {kArgumentsMinimum, 1},         // 10 disable hotspot
+    {kArgumentsMinimum, 0},         // 11 invalid
+    {kArgumentsMinimum, 1},         // 12 clear sounds
+    {kArgumentsMinimum, 1},         // 13 set cursor
+    {kArgumentsMinimum, 1},         // 14 pause
+    {kArgumentsMinimum, 0},         // 15 invalid
+    {kArgumentsMinimum, 0},         // 16 invalid
+    {kArgumentsExternal, 2},        // 17 call external
+    {kArgumentsTransition, 1},      // 18 schedule transition
+    {kArgumentsMinimum, 0},         // 19 reload card
+    {kArgumentsMinimum, 0},         // 20 disable screen updates
+    {kArgumentsMinimum, 0},         // 21 enable screen updates
+    {kArgumentsMinimum, 0},         // 22 invalid
+    {kArgumentsMinimum, 0},         // 23 invalid
+    {kArgumentsMinimum, 2},         // 24 increment variable
+    {kArgumentsMinimum, 2},         // 25 decrement variable
+    {kArgumentsMinimum, 0},         // 26 close all movies
+    {kArgumentsMinimum, 3},         // 27 go to stack
+    {kArgumentsMinimum, 1},         // 28 disable movie
+    {kArgumentsMinimum, 0},         // 29 disable all movies
+    {kArgumentsMinimum, 0},         // 30 unimplemented
+    {kArgumentsMinimum, 1},         // 31 enable movie
+    {kArgumentsMinimum, 1},         // 32 start movie and wait until done
+    {kArgumentsMinimum, 1},         // 33 start movie
+    {kArgumentsMinimum, 1},         // 34 stop movie
+    {kArgumentsMinimum, 0},         // 35 unimplemented
+    {kArgumentsMinimum, 0},         // 36 no-op
+    {kArgumentsMinimum, 0},         // 37 fade ambient sounds
+    {kArgumentsMinimum, 5},         // 38 schedule movie command
+    {kArgumentsMinimum, 1},         // 39 activate PLST
+    {kArgumentsMinimum, 1},         // 40 activate SLST
+    {kArgumentsMinimum, 1},         // 41 activate MLST and start movie
+    {kArgumentsMinimum, 0},         // 42 no-op
+    {kArgumentsMinimum, 1},         // 43 activate BLST
+    {kArgumentsMinimum, 1},         // 44 activate FLST
+    {kArgumentsMinimum, 0},         // 45 unimplemented
+    {kArgumentsMinimum, 1},         // 46 activate MLST
+    {kArgumentsMinimum, 2},         // 47 activate SLST with volume
+};
+
+class Verifier {
+public:
+    Verifier(const void* program, size_t available, bool byte_swap, rx_script_violation_handler_t handler, void* context) :
+        _program(static_cast<const uint8_t*>(program)), _available(available), _byte_swap(byte_swap),
+        _handler(handler), _context(context), _violations(0) {}
+
+    uint32_t violations() const {return _violations;}
+
+    // verifies a block of count instructions starting at offset and advances offset past it; returns false if the
+    // extent of the block could not be determined
+    bool verify_block(size_t& offset, uint16_t count, uint32_t depth) {
+        for (uint16_t i = 0; i < count; i++) {
+            if (!available(offset, 2)) {
+                report(kRXScriptViolationTruncated, offset, 0, 0, depth);
+                return false;
+            }
+
+            uint16_t opcode = word(offset);
+            uint16_t argc = word(offset + 2);
+            if (!available(offset, 2 + argc)) {
+                report(kRXScriptViolationTruncated, offset, opcode, argc, depth);
+                return false;
+            }
+
+            if (opcode == RX_COMMAND_BRANCH) {
+                if (!verify_switch(offset, argc, depth))
+                    return false;
+                continue;
+            }
+
+            if (opcode >= RX_COMMAND_COUNT)
+                report(kRXScriptViolationInvalidOpcode, offset, opcode, argc, depth);
+            else
+                verify_arguments(offset, opcode, argc, depth);
+
+            offset += 4 + 2 * static_cast<size_t>(argc);
+        }
+        return true;
+    }
+
+private:
+    uint16_t word(size_t offset) const {
+        uint16_t value;
+        memcpy(&value, _program + offset, sizeof(uint16_t));
+        if (_byte_swap)
+            value = static_cast<uint16_t>((value << 8) | (value >> 8));
+        return value;
+    }
+
+    bool available(size_t offset, size_t words) const {return offset <= _available && words <= (_available - offset) / 2;}
+
+    void report(int code, size_t offset, uint16_t opcode, uint16_t argc, uint32_t depth) {
+        _violations++;
+        if (!_handler)
+            return;
+
+        rx_script_violation_t violation;
+        violation.code = code;
+        violation.opcode = opcode;
+        violation.argc = argc;
+        violation.offset = offset;
+        violation.depth = depth;
+        _handler(_context, &violation);
+    }
+
+    void verify_arguments(size_t offset, uint16_t opcode, uint16_t argc, uint32_t depth) {
+        const OpcodeSchema& schema = opcode_schemas[opcode];
+        size_t argv = offset + 4;
+
+        switch (schema.kind) {
+            case kArgumentsSynthesizedSLST:
+                // the sound IDs, 5 group parameters, then the gain and pan of each sound
+                if (argc < 1 || argc < 6 + 3 * static_cast<uint32_t>(word(argv)))
+                    report(kRXScriptViolationArgumentCount, offset, opcode, argc, depth);
+                break;
+            case kArgumentsExternal:
+                if (argc < 2)
+                    report(kRXScriptViolationArgumentCount, offset, opcode, argc, depth);
+                else if (word(argv + 2) > argc - 2)
+                    report(kRXScriptViolationExternalArguments, offset, opcode, argc, depth);
+                break;
+            case kArgumentsTransition:
+                if (argc != 1 && argc != 5)
+                    report(kRXScriptViolationArgumentCount, offset, opcode, argc, depth);
+                break;
+            default:
+                if (argc < schema.minimum)
+                    report(kRXScriptViolationArgumentCount, offset, opcode, argc, depth);
+                break;
+        }
+    }
+
+    bool verify_switch(size_t& offset, uint16_t argc, uint32_t depth) {
+        // the program walker and the IR both expect the cases right after a variable and a case count; with fewer
+        // arguments there is no case count, and with more the walker would run the arguments as cases
+        if (argc != 2) {
+            report(kRXScriptViolationSwitchArguments, offset, RX_COMMAND_BRANCH, argc, depth);
+            if (argc < 2)
+                return false;
+        }
+        if (depth >= RX_SCRIPT_VERIFIER_MAX_DEPTH) {
+            report(kRXScriptViolationSwitchDepth, offset, RX_COMMAND_BRANCH, argc, depth);
+            return false;
+        }
+
+        uint16_t case_count = word(offset + 6);
+        offset += 4 + 2 * static_cast<size_t>(argc);
+
+        for (uint16_t c = 0; c < case_count; c++) {
+            // case value, case instruction count
+            if (!available(offset, 2)) {
+                report(kRXScriptViolationTruncated, offset, RX_COMMAND_BRANCH, argc, depth);
+                return false;
+            }
+            uint16_t case_opcode_count = word(offset + 2);
+            offset += 4;
+
+            if (!verify_block(offset, case_opcode_count, depth + 1))
+                return false;
+        }
+        return true;
+    }
+
+    const uint8_t* _program;
+    size_t _available;
+    bool _byte_swap;
+    rx_script_violation_handler_t _handler;
+    void* _context;
+    uint32_t _violations;
+};
+
+} // namespace
+
+uint32_t rx_script_verify_program(const void* program, size_t available, uint16_t opcode_count, bool byte_swap,
+                                  size_t* program_length, rx_script_violation_handler_t handler, void* context)
+{
+    Verifier verifier(program, available, byte_swap, handler, context);
+    size_t offset = 0;
+    bool measured = verifier.verify_block(offset, opcode_count, 0);
+    if (program_length)
+        *program_length = (measured) ? offset : RX_SCRIPT_VERIFIER_UNKNOWN_LENGTH;
+    return verifier.violations();
+}
+
+const char* rx_script_violation_description(int code)
+{
+    switch (code) {
+        case kRXScriptViolationTruncated:
+            return "program runs past the end of its buffer";
+        case kRXScriptViolationInvalidOpcode:
+            return "opcode out of range";
+        case kRXScriptViolationArgumentCount:
+            return "invalid number of arguments";
+        case kRXScriptViolationSwitchArguments:
+            return "switch without exactly 2 arguments";
+        case kRXScriptViolationSwitchDepth:
+            return "switches nested too deeply";
+        case kRXScriptViolationExternalArguments:
+            return "external command call with more arguments than the instruction";
+        case kRXScriptViolationUnknownEvent:
+            return "program for an unknown event type";
+        default:
+            return "unknown violation";
+    }
+}
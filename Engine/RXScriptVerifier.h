@@ -0,0 +1,66 @@
+//
+//  RXScriptVerifier.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 25/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#if !defined(RX_SCRIPT_VERIFIER_H)
+#define RX_SCRIPT_VERIFIER_H
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// The script verifier checks a Riven program once, when it is decoded, so that the program walker and the opcode
+// implementations can trust it: every instruction lies within the program's buffer, every opcode has an entry in the
+// engine's dispatch table, every opcode has at least the arguments its implementation reads, switches have exactly 2
+// arguments and are nested no deeper than RX_SCRIPT_VERIFIER_MAX_DEPTH, and external command calls do not claim more
+// arguments than they have.
+//
+// Verification continues past a violation whenever the extent of the program can still be determined, so that every
+// violation is reported; it stops at the first violation that makes the rest of the program unreadable.
+//
+
+__BEGIN_DECLS
+
+#define RX_SCRIPT_VERIFIER_MAX_DEPTH 32
+
+// program length reported for programs whose extent could not be determined
+#define RX_SCRIPT_VERIFIER_UNKNOWN_LENGTH SIZE_MAX
+
+enum {
+    kRXScriptViolationTruncated = 1,        // the program runs past the end of its buffer
+    kRXScriptViolationInvalidOpcode,        // the opcode is out of range of the dispatch table
+    kRXScriptViolationArgumentCount,        // the opcode has fewer arguments than its implementation reads
+    kRXScriptViolationSwitchArguments,      // a switch does not have exactly 2 arguments
+    kRXScriptViolationSwitchDepth,          // switches are nested too deeply
+    kRXScriptViolationExternalArguments,    // an external command call claims more arguments than it has
+    kRXScriptViolationUnknownEvent,         // the program is for an unknown event type (reported by script decoders)
+};
+
+struct rx_script_violation {
+    int code;
+    uint16_t opcode;
+    uint16_t argc;
+    size_t offset;      // byte offset of the instruction in the program
+    uint32_t depth;     // switch nesting depth of the instruction
+};
+typedef struct rx_script_violation rx_script_violation_t;
+
+typedef void (*rx_script_violation_handler_t)(void* context, const rx_script_violation_t* violation);
+
+// verifies the program of opcode_count instructions at the start of a buffer of available bytes; byte_swap is true for
+// big-endian programs straight out of a resource; returns the number of violations, each of which is passed to the
+// optional handler; program_length receives the length of the program in bytes, or RX_SCRIPT_VERIFIER_UNKNOWN_LENGTH
+uint32_t rx_script_verify_program(const void* program, size_t available, uint16_t opcode_count, bool byte_swap,
+                                  size_t* program_length, rx_script_violation_handler_t handler, void* context);
+
+const char* rx_script_violation_description(int code);
+
+__END_DECLS
+
+#endif // RX_SCRIPT_VERIFIER_H
@@ -21,7 +21,9 @@
     NSArray* _cardNames;
     NSArray* _hotspotNames;
     NSArray* _externalNames;
+    uint16_t* _externalCommandIDs;
     NSArray* _varNames;
+    uint32_t* _varIDs;
     NSArray* _stackNames;
     NSData* _rmapData;
     
@@ -39,8 +41,10 @@
 - (NSString*)cardNameAtIndex:(uint32_t)index;
 - (NSString*)hotspotNameAtIndex:(uint32_t)index;
 - (NSString*)externalNameAtIndex:(uint32_t)index;
+- (uint16_t)externalCommandIDAtIndex:(uint32_t)index;
 - (NSString*)varNameAtIndex:(uint32_t)index;
 - (uint32_t)varIndexForName:(NSString*)name;
+- (uint32_t)variableIDAtIndex:(uint32_t)index;
 - (NSString*)stackNameAtIndex:(uint32_t)index;
 
 - (uint16_t)cardIDFromRMAPCode:(uint32_t)code;
@@ -10,6 +10,8 @@
 
 #import "RXStack.h"
 #import "RXCardDescriptor.h"
+#import "RXGameState.h"
+#import "RXScriptExternalCommands.h"
 
 #import "RXWorldProtocol.h"
 #import "RXArchiveManager.h"
@@ -148,6 +150,30 @@ static NSArray* _loadNAMEResourceWithID(MHKArchive* archive, uint16_t resourceID
     _varNames = _loadNAMEResourceWithID(masterDataArchive, 4);
     _stackNames = _loadNAMEResourceWithID(masterDataArchive, 5);
     
+    // resolve the game state variable ID of every stack variable once
+    if (_varNames)
+    {
+        uint32_t n = (uint32_t)[_varNames count];
+        _varIDs = (uint32_t*)malloc(n * sizeof(uint32_t));
+        for (uint32_t i = 0; i < n; i++)
+            _varIDs[i] = [RXGameState variableIDForKey:[_varNames objectAtIndex:i]];
+    }
+    
+    // resolve the external command ID of every stack external command once
+    if (_externalNames)
+    {
+        uint32_t n = (uint32_t)[_externalNames count];
+        _externalCommandIDs = (uint16_t*)malloc(n * sizeof(uint16_t));
+        for (uint32_t i = 0; i < n; i++)
+        {
+            _externalCommandIDs[i] = rx_external_command_id([[_externalNames objectAtIndex:i] UTF8String]);
+#if defined(DEBUG)
+            if (_externalCommandIDs[i] == RX_EXTERNAL_COMMAND_UNKNOWN)
+                RXOLog2(kRXLoggingEngine, kRXLoggingLevelDebug, @"external command %@ is not implemented", [_externalNames objectAtIndex:i]);
+#endif
+        }
+    }
+    
     // rmap data
     uint16_t remapID = [[rmapDescriptor objectForKey:@"ID"] unsignedShortValue];
     _rmapData = [[masterDataArchive dataWithResourceType:@"RMAP" ID:remapID] retain];
@@ -169,7 +195,9 @@ static NSArray* _loadNAMEResourceWithID(MHKArchive* archive, uint16_t resourceID
     [_cardNames release]; _cardNames = nil;
     [_hotspotNames release]; _hotspotNames = nil;
     [_externalNames release]; _externalNames = nil;
+    free(_externalCommandIDs); _externalCommandIDs = NULL;
     [_varNames release]; _varNames = nil;
+    free(_varIDs); _varIDs = NULL;
     [_stackNames release]; _stackNames = nil;
     [_rmapData release]; _rmapData = nil;
     
@@ -238,6 +266,13 @@ static NSArray* _loadNAMEResourceWithID(MHKArchive* archive, uint16_t resourceID
     return (_externalNames) ? [_externalNames objectAtIndex:index] : nil;
 }
 
+- (uint16_t)externalCommandIDAtIndex:(uint32_t)index
+{
+    if (!_externalCommandIDs || index >= [_externalNames count])
+        return RX_EXTERNAL_COMMAND_UNKNOWN;
+    return _externalCommandIDs[index];
+}
+
 - (NSString*)varNameAtIndex:(uint32_t)index
 {
     return (_varNames) ? [_varNames objectAtIndex:index] : nil;
@@ -254,6 +289,20 @@ static NSArray* _loadNAMEResourceWithID(MHKArchive* archive, uint16_t resourceID
     return UINT32_MAX;
 }
 
+- (uint32_t)variableIDAtIndex:(uint32_t)index
+{
+    if (_varIDs)
+    {
+        // script data can name any index; throw like -objectAtIndex: did rather than reading past the IDs
+        if (index >= [_varNames count])
+            @throw [NSException exceptionWithName:NSRangeException reason:@"INVALID VARIABLE INDEX" userInfo:nil];
+        return _varIDs[index];
+    }
+    
+    // stacks without variable names use the stack key and the variable index as the name
+    return [RXGameState variableIDForKey:[NSString stringWithFormat:@"%@%u", _key, index]];
+}
+
 - (NSString*)stackNameAtIndex:(uint32_t)index
 {
     return (_stackNames) ? [_stackNames objectAtIndex:index] : nil;
@@ -0,0 +1,285 @@
+/*
+ *  RXWaterProgram.c
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 02/11/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Engine/RXWaterProgram.h"
+
+
+// SFXE frame program opcodes
+enum {
+    SFXE_OPCODE_NEXT = 1,
+    SFXE_OPCODE_COPY = 3,   // followed by destination x, source x, source y and width
+    SFXE_OPCODE_END = 4
+};
+
+static inline const uint16_t* frame_program(const struct rx_sfxe_record* record, const uint32_t* offsets, uint16_t frame)
+{
+    return (const uint16_t*)((const uint8_t*)record + offsets[frame]);
+}
+
+#pragma mark -
+
+// counts the spans of a frame program, or returns -1 if the program has an unknown opcode
+static int64_t count_spans(const uint16_t* program)
+{
+    int64_t count = 0;
+    while (*program != SFXE_OPCODE_END)
+    {
+        if (*program == SFXE_OPCODE_COPY)
+        {
+            count++;
+            program += 4;
+        }
+        else if (*program != SFXE_OPCODE_NEXT)
+            return -1;
+        program++;
+    }
+    return count;
+}
+
+// orders the spans of a frame by destination; the rows of a frame only go down, so this sorts the spans of each row
+static int compare_spans(const void* a, const void* b)
+{
+    const struct rx_water_span* x = (const struct rx_water_span*)a;
+    const struct rx_water_span* y = (const struct rx_water_span*)b;
+    if (x->dst_y != y->dst_y)
+        return (x->dst_y < y->dst_y) ? -1 : 1;
+    if (x->dst_x != y->dst_x)
+        return (x->dst_x < y->dst_x) ? -1 : 1;
+    return 0;
+}
+
+// sorts and merges the spans of a frame in place, and returns the new number of spans
+static uint32_t optimize_spans(struct rx_water_span* spans, uint32_t count, struct rx_water_span* scratch)
+{
+    if (count == 0)
+        return 0;
+
+    // spans that overlap in the destination must be copied in the order of the program; sorted by destination, two
+    // spans overlap if and only if two consecutive spans do
+    memcpy(scratch, spans, count * sizeof(struct rx_water_span));
+    qsort(scratch, count, sizeof(struct rx_water_span), compare_spans);
+    bool overlap = false;
+    for (uint32_t i = 1; i < count && !overlap; i++)
+        overlap = scratch[i].dst_y == scratch[i - 1].dst_y && scratch[i - 1].dst_x + scratch[i - 1].width > scratch[i].dst_x;
+    if (!overlap)
+        memcpy(spans, scratch, count * sizeof(struct rx_water_span));
+
+    uint32_t merged = 0;
+    for (uint32_t i = 1; i < count; i++)
+    {
+        struct rx_water_span* last = spans + merged;
+        const struct rx_water_span* span = spans + i;
+        if (span->dst_y == last->dst_y && span->src_y == last->src_y && last->dst_x + last->width == span->dst_x &&
+            last->src_x + last->width == span->src_x)
+            last->width = (uint16_t)(last->width + span->width);
+        else
+            spans[++merged] = *span;
+    }
+    return merged + 1;
+}
+
+rx_water_program_t* rx_water_program_compile(const struct rx_sfxe_record* record, const uint32_t* offsets, uint32_t width,
+                                             uint32_t height)
+{
+    uint32_t span_count = 0;
+    uint32_t max_frame_spans = 0;
+    for (uint16_t frame = 0; frame < record->frame_count; frame++)
+    {
+        int64_t count = count_spans(frame_program(record, offsets, frame));
+        if (count < 0 || span_count + count > UINT32_MAX)
+            return NULL;
+        span_count += (uint32_t)count;
+        if ((uint32_t)count > max_frame_spans)
+            max_frame_spans = (uint32_t)count;
+    }
+
+    rx_water_program_t* program = (rx_water_program_t*)calloc(1, sizeof(rx_water_program_t));
+    if (!program)
+        return NULL;
+    program->width = width;
+    program->frame_count = record->frame_count;
+    program->frames = (struct rx_water_frame*)calloc(record->frame_count, sizeof(struct rx_water_frame));
+    program->spans = (struct rx_water_span*)malloc(span_count * sizeof(struct rx_water_span));
+    program->runs = (struct rx_water_run*)malloc(span_count * sizeof(struct rx_water_run));
+    struct rx_water_span* scratch = (struct rx_water_span*)malloc(max_frame_spans * sizeof(struct rx_water_span));
+    if ((!program->frames && record->frame_count) || ((!program->spans || !program->runs) && span_count) ||
+        (!scratch && max_frame_spans))
+    {
+        free(scratch);
+        rx_water_program_free(program);
+        return NULL;
+    }
+
+    struct rx_water_span* span = program->spans;
+    struct rx_water_run* run = program->runs;
+    for (uint16_t frame = 0; frame < record->frame_count; frame++)
+    {
+        struct rx_water_frame* f = program->frames + frame;
+        struct rx_water_span* first_span = span;
+        f->first_span = (uint32_t)(span - program->spans);
+
+        const uint16_t* p = frame_program(record, offsets, frame);
+        uint32_t row = record->rect.top;
+        for (; *p != SFXE_OPCODE_END; p++)
+        {
+            if (*p == SFXE_OPCODE_NEXT)
+            {
+                row++;
+                continue;
+            }
+
+            span->dst_x = p[1];
+            span->dst_y = (uint16_t)row;
+            span->src_x = p[2];
+            span->src_y = p[3];
+            span->width = p[4];
+            p += 4;
+
+            if (row >= height || span->src_y >= height || (uint32_t)span->dst_x + span->width > width ||
+                (uint32_t)span->src_x + span->width > width)
+            {
+                free(scratch);
+                rx_water_program_free(program);
+                return NULL;
+            }
+
+            // empty spans copy nothing
+            if (span->width)
+                span++;
+        }
+
+        f->span_count = optimize_spans(first_span, (uint32_t)(span - first_span), scratch);
+        span = first_span + f->span_count;
+
+        // the runs are the spans as offsets, which merge across rows when a span ends a row and the next one starts
+        // the next row in both images
+        f->first_run = (uint32_t)(run - program->runs);
+        for (const struct rx_water_span* s = first_span; s < span; s++)
+        {
+            uint32_t dst = s->dst_y * width + s->dst_x;
+            uint32_t src = s->src_y * width + s->src_x;
+            if (run > program->runs + f->first_run && run[-1].dst + run[-1].length == dst && run[-1].src + run[-1].length == src)
+                run[-1].length += s->width;
+            else
+            {
+                run->dst = dst;
+                run->src = src;
+                run->length = s->width;
+                run++;
+            }
+
+            if (s == first_span)
+            {
+                f->dirty.left = s->dst_x;
+                f->dirty.top = s->dst_y;
+                f->dirty.right = (uint16_t)(s->dst_x + s->width);
+                f->dirty.bottom = (uint16_t)(s->dst_y + 1);
+            }
+            else
+            {
+                if (s->dst_x < f->dirty.left)
+                    f->dirty.left = s->dst_x;
+                if (s->dst_x + s->width > f->dirty.right)
+                    f->dirty.right = (uint16_t)(s->dst_x + s->width);
+                if (s->dst_y + 1 > f->dirty.bottom)
+                    f->dirty.bottom = (uint16_t)(s->dst_y + 1);
+            }
+        }
+        f->run_count = (uint32_t)(run - program->runs) - f->first_run;
+    }
+
+    free(scratch);
+    program->span_count = (uint32_t)(span - program->spans);
+    program->run_count = (uint32_t)(run - program->runs);
+
+    // give back what merging saved
+    if (program->span_count)
+    {
+        struct rx_water_span* spans = (struct rx_water_span*)realloc(program->spans, program->span_count * sizeof(struct rx_water_span));
+        struct rx_water_run* runs = (struct rx_water_run*)realloc(program->runs, program->run_count * sizeof(struct rx_water_run));
+        if (spans)
+            program->spans = spans;
+        if (runs)
+            program->runs = runs;
+    }
+    return program;
+}
+
+void rx_water_program_free(rx_water_program_t* program)
+{
+    if (!program)
+        return;
+    free(program->frames);
+    free(program->spans);
+    free(program->runs);
+    free(program);
+}
+
+size_t rx_water_program_size(const rx_water_program_t* program)
+{
+    return sizeof(rx_water_program_t) + program->frame_count * sizeof(struct rx_water_frame) +
+           program->span_count * sizeof(struct rx_water_span) + program->run_count * sizeof(struct rx_water_run);
+}
+
+#pragma mark -
+
+void rx_water_program_write_quads(const rx_water_program_t* program, float* vertices)
+{
+    // a span covers the pixels of its row from dst_x to dst_x + width; with nearest filtering, the center of every pixel
+    // samples the center of the matching texel
+    for (uint32_t i = 0; i < program->span_count; i++)
+    {
+        const struct rx_water_span* span = program->spans + i;
+        float x0 = span->dst_x, x1 = (float)(span->dst_x + span->width);
+        float y0 = span->dst_y, y1 = (float)(span->dst_y + 1);
+        float s0 = span->src_x, s1 = (float)(span->src_x + span->width);
+        float t0 = span->src_y, t1 = (float)(span->src_y + 1);
+
+        const float quad[RX_WATER_QUAD_VERTICES * RX_WATER_VERTEX_FLOATS] = {
+            x0, y0, s0, t0,
+            x1, y0, s1, t0,
+            x1, y1, s1, t1,
+            x0, y1, s0, t1,
+        };
+        memcpy(vertices, quad, sizeof(quad));
+        vertices += RX_WATER_QUAD_VERTICES * RX_WATER_VERTEX_FLOATS;
+    }
+}
+
+void rx_water_program_apply(const rx_water_program_t* program, uint16_t frame, const uint32_t* source, uint32_t* destination)
+{
+    const struct rx_water_run* run = program->runs + program->frames[frame].first_run;
+    const struct rx_water_run* end = run + program->frames[frame].run_count;
+    for (; run < end; run++)
+        memcpy(destination + run->dst, source + run->src, run->length * sizeof(uint32_t));
+}
+
+void rx_water_run_microprogram(const struct rx_sfxe_record* record, const uint32_t* offsets, uint16_t frame,
+                               const uint32_t* source, uint32_t* destination, uint32_t width)
+{
+    const uint16_t* p = frame_program(record, offsets, frame);
+    uint32_t row = record->rect.top;
+    while (*p != SFXE_OPCODE_END)
+    {
+        if (*p == SFXE_OPCODE_NEXT)
+            row++;
+        else if (*p == SFXE_OPCODE_COPY)
+        {
+            memcpy(destination + row * width + p[1], source + p[3] * width + p[2], p[4] * sizeof(uint32_t));
+            p += 4;
+        }
+        else
+            abort();
+        p++;
+    }
+}
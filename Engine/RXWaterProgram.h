@@ -0,0 +1,105 @@
+/*
+ *  RXWaterProgram.h
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 02/11/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#if !defined(RX_WATER_PROGRAM_H)
+#define RX_WATER_PROGRAM_H
+
+#include <sys/cdefs.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Engine/RXCoreStructures.h"
+
+//
+// The frames of an SFXE (water) special effect are programs that copy horizontal spans of the card's static picture
+// into the image shown on screen, starting from the row at the top of the effect rect: opcode 1 moves down one row,
+// opcode 3 copies a span (destination x, source x, source y, width) into the current row and opcode 4 ends the frame.
+// The image is not cleared between frames, so the pixels a frame does not copy keep the value of the last frame that
+// copied them.
+//
+// A water program is the frame programs of an SFXE resource compiled once into spans, with the rows resolved and the
+// spans checked against the image. The spans of a frame are sorted by destination and the spans that continue each
+// other in both images are merged, unless the spans of the frame overlap in the destination image, where the last span
+// wins and the order of the program is kept. The spans of a frame can be drawn as a batch of quads that sample the static
+// picture, so that the effect runs on the GPU.
+//
+// On the CPU, rx_water_program_apply copies the runs of a frame: the spans as pixel offsets into the images, merged
+// again across rows. Every frame also has the bounding box of the pixels it copies, which is all that changes in the
+// image. rx_water_run_microprogram interprets the original frame program, which is the reference the compiled forms
+// must match.
+//
+// Images are arrays of 32-bit pixels, width pixels per row, in the row order of the SFXE programs.
+//
+
+__BEGIN_DECLS
+
+struct rx_water_span {
+    uint16_t dst_x;
+    uint16_t dst_y;
+    uint16_t src_x;
+    uint16_t src_y;
+    uint16_t width;
+};
+
+// offsets and length in pixels
+struct rx_water_run {
+    uint32_t dst;
+    uint32_t src;
+    uint32_t length;
+};
+
+struct rx_water_frame {
+    uint32_t first_span;
+    uint32_t span_count;
+    uint32_t first_run;
+    uint32_t run_count;
+
+    // right and bottom are exclusive; the box is empty if the frame copies nothing
+    rx_core_rect_t dirty;
+};
+
+struct rx_water_program {
+    uint32_t width;
+    uint16_t frame_count;
+    uint32_t span_count;
+    uint32_t run_count;
+    struct rx_water_frame* frames;
+    struct rx_water_span* spans;
+    struct rx_water_run* runs;
+};
+typedef struct rx_water_program rx_water_program_t;
+
+// compiles the frame programs of an SFXE resource that has been swapped to host byte order (see rx_card_swap_sfxe),
+// whose offset table is offsets; returns NULL if a span falls outside of a width x height image
+rx_water_program_t* rx_water_program_compile(const struct rx_sfxe_record* record, const uint32_t* offsets, uint32_t width,
+                                             uint32_t height);
+void rx_water_program_free(rx_water_program_t* program);
+
+// bytes allocated for the program
+size_t rx_water_program_size(const rx_water_program_t* program);
+
+// every span is a quad of 4 vertices of 4 floats: the position (x, y) in the image and the texture coordinates (s, t)
+// of the static picture, in texels (for rectangle textures); the quads of a frame start at vertex 4 * first_span
+#define RX_WATER_QUAD_VERTICES 4
+#define RX_WATER_VERTEX_FLOATS 4
+
+// writes the quads of every span into vertices, which must hold span_count * 16 floats
+void rx_water_program_write_quads(const rx_water_program_t* program, float* vertices);
+
+// copies the runs of a frame from the static picture source into destination
+void rx_water_program_apply(const rx_water_program_t* program, uint16_t frame, const uint32_t* source, uint32_t* destination);
+
+// interprets the program of a frame, copying its spans from the static picture source into destination; the program
+// is not checked against the image
+void rx_water_run_microprogram(const struct rx_sfxe_record* record, const uint32_t* offsets, uint16_t frame,
+                               const uint32_t* source, uint32_t* destination, uint32_t width);
+
+__END_DECLS
+
+#endif // RX_WATER_PROGRAM_H
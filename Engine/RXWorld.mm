@@ -23,6 +23,9 @@
 #import "Utilities/BZFSUtilities.h"
 
 #import "Rendering/Audio/RXAudioRenderer.h"
+#import "Rendering/Audio/RXDecodedSoundCache.h"
+#import "Rendering/Graphics/RXTextureBroker.h"
+#import "Rendering/Graphics/RXTextureAtlas.h"
 
 #import "States/RXCardState.h"
 
@@ -334,6 +337,10 @@ NSObject <RXWorldProtocol>* g_world = nil;
     [_worldCacheBase release], _worldCacheBase = nil;
     [_worldSupportBase release], _worldSupportBase = nil;
     [_engineVariables release], _engineVariables = nil;
+    
+    // the decoded sound cache holds sounds and queued decompressors of the stacks; drop them before the stacks and
+    // their archives go away
+    RX::DecodedSoundCache::SharedCache().Flush();
     [_activeStacks release], _activeStacks = nil;
     [_cachePreferences release], _cachePreferences = nil;
 }
@@ -598,6 +605,76 @@ NSObject <RXWorldProtocol>* g_world = nil;
 
 - (id)valueForEngineVariable:(NSString*)path
 {
+    // the card cache statistics are read from the cache rather than stored with the other variables
+    if ([path isEqualToString:@"rendering.card_cache_hit_rate"])
+        return [NSNumber numberWithDouble:[[(RXCardState*)_cardRenderer cardCache] hitRate]];
+    if ([path isEqualToString:@"rendering.card_cache_resident_bytes"])
+        return [NSNumber numberWithUnsignedLong:[[(RXCardState*)_cardRenderer cardCache] residentBytes]];
+    
+    // and so are the decoded sound cache statistics
+    if ([path isEqualToString:@"rendering.audio_cache_hit_rate"])
+        return [NSNumber numberWithDouble:RX::DecodedSoundCache::SharedCache().HitRate()];
+    if ([path isEqualToString:@"rendering.audio_cache_resident_bytes"])
+        return [NSNumber numberWithUnsignedLong:RX::DecodedSoundCache::SharedCache().GetStatistics().bytes];
+    
+    // and the compositor statistics, from the card renderer
+    if ([path hasPrefix:@"rendering.composite_"])
+    {
+        struct rx_compositor_stats stats = [(RXCardState*)_cardRenderer compositorStatistics];
+        if ([path isEqualToString:@"rendering.composite_pixels_queued"])
+            return [NSNumber numberWithUnsignedInt:stats.last_pixels_queued];
+        if ([path isEqualToString:@"rendering.composite_pixels_redrawn"])
+            return [NSNumber numberWithUnsignedInt:stats.last_pixels_redrawn];
+        if ([path isEqualToString:@"rendering.composite_redraw_ratio"])
+            return [NSNumber numberWithDouble:(stats.pixels_queued) ? (double)stats.pixels_redrawn / stats.pixels_queued : 1.0];
+    }
+    
+    // and the texture broker statistics, from the broker
+    if ([path hasPrefix:@"rendering.texture_"] && ![path isEqualToString:@"rendering.texture_budget"])
+    {
+        struct rx_texture_pool_stats stats = [[RXTextureBroker sharedTextureBroker] statistics];
+        if ([path isEqualToString:@"rendering.texture_hit_rate"])
+            return [NSNumber numberWithDouble:(stats.hits + stats.misses) ? (double)stats.hits / (stats.hits + stats.misses) : 0.0];
+        if ([path isEqualToString:@"rendering.texture_misses"])
+            return [NSNumber numberWithUnsignedLongLong:stats.misses];
+        if ([path isEqualToString:@"rendering.texture_waste"])
+            return [NSNumber numberWithDouble:(stats.granted_bytes) ? 1.0 - (double)stats.requested_bytes / stats.granted_bytes : 0.0];
+        if ([path isEqualToString:@"rendering.texture_evictions"])
+            return [NSNumber numberWithUnsignedLongLong:stats.evictions];
+        if ([path isEqualToString:@"rendering.texture_resident_bytes"])
+            return [NSNumber numberWithUnsignedLongLong:stats.resident_bytes];
+        if ([path isEqualToString:@"rendering.texture_effective_budget"])
+            return [NSNumber numberWithUnsignedLongLong:stats.budget];
+    }
+    
+    // and the texture atlas statistics, from the atlas
+    if ([path hasPrefix:@"rendering.atlas_"])
+    {
+        struct rx_atlas_packer_stats stats = [[RXTextureAtlas sharedTextureAtlas] statistics];
+        if ([path isEqualToString:@"rendering.atlas_pages"])
+            return [NSNumber numberWithUnsignedInt:stats.pages];
+        if ([path isEqualToString:@"rendering.atlas_occupancy"])
+            return [NSNumber numberWithDouble:(stats.page_area) ? (double)stats.used_area / stats.page_area : 0.0];
+        if ([path isEqualToString:@"rendering.atlas_fragmentation"])
+            return [NSNumber numberWithDouble:rx_atlas_packer_fragmentation(&stats)];
+    }
+    
+    // and the texture upload statistics, from the upload ring
+    if ([path hasPrefix:@"rendering.upload_"])
+    {
+        struct rx_upload_ring_stats stats = [RXTexture uploadStatistics];
+        if ([path isEqualToString:@"rendering.upload_fence_waits"])
+            return [NSNumber numberWithUnsignedLongLong:stats.fence_waits];
+        if ([path isEqualToString:@"rendering.upload_frame_fence_waits"])
+            return [NSNumber numberWithUnsignedInt:stats.last_frame_fence_waits];
+        if ([path isEqualToString:@"rendering.upload_frame_bytes"])
+            return [NSNumber numberWithUnsignedLongLong:stats.last_frame_upload_bytes];
+        if ([path isEqualToString:@"rendering.upload_peak_frame_bytes"])
+            return [NSNumber numberWithUnsignedLongLong:stats.peak_frame_upload_bytes];
+        if ([path isEqualToString:@"rendering.upload_unbuffered"])
+            return [NSNumber numberWithUnsignedLongLong:stats.unbuffered_uploads];
+    }
+    
     OSSpinLockLock(&_engineVariablesLock);
     id value = [_engineVariables valueForKeyPath:path];
     OSSpinLockUnlock(&_engineVariablesLock);
@@ -29,7 +29,11 @@ class AudioSourceBase;
 
 class AudioRenderer {
 public:
-    AudioRenderer() throw(CAXException);
+    // largest number of frames that can be pulled from an offline renderer in a single RenderOffline call
+    static const UInt32 kOfflineMaximumFramesPerSlice = 4096;
+    
+    // an offline renderer is not connected to the output device; the client pulls audio out of it with RenderOffline
+    AudioRenderer(bool offline = false) throw(CAXException);
     ~AudioRenderer() throw(CAXException);
     
     // accessors to underlying graph and mixer
@@ -45,6 +49,11 @@ public:
     void Stop() throw(CAXException);
     bool IsRunning() const throw(CAXException);
     
+    // offline rendering
+    inline bool IsOffline() const throw() {return _offline;}
+    inline Float64 OfflineSampleTime() const throw() {return _offlineSampleTime;}
+    void RenderOffline(UInt32 frames, AudioBufferList* ioData) throw(CAXException);
+    
     // gain control on the final mix going to the output device
     Float32 Gain() const throw(CAXException);
     void SetGain(Float32 gain) throw(CAXException);
@@ -117,6 +126,9 @@ private:
     TThreadSafeList<ParameterRampDescriptor> pending_ramps;
     TThreadSafeList<ParameterRampDescriptor> active_ramps;
     
+    bool _offline;
+    Float64 _offlineSampleTime;
+    
     AUGraph graph;
     CAAudioUnit* output;
     CAAudioUnit* mixer;
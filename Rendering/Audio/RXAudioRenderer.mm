@@ -81,7 +81,9 @@ OSStatus AudioRenderer::MixerRenderNotifyCallback(void
 
 #pragma mark -
 
-AudioRenderer::AudioRenderer() throw(CAXException) :
+AudioRenderer::AudioRenderer(bool offline) throw(CAXException) :
+_offline(offline),
+_offlineSampleTime(0.0),
 graph(0),
 output(0),
 mixer(0),
@@ -93,7 +95,7 @@ busNodeVector(0),
 busAllocationVector(0)
 {
     CreateGraph();
-    RXCFLog(kRXLoggingAudio, kRXLoggingLevelMessage, CFSTR("<RX::AudioRenderer: 0x%x> initialized with %u mixer inputs"), this, sourceLimit);
+    RXCFLog(kRXLoggingAudio, kRXLoggingLevelMessage, CFSTR("<RX::AudioRenderer: 0x%x> initialized with %u mixer inputs%s"), this, sourceLimit, (_offline) ? " (offline)" : "");
 }
 
 AudioRenderer::AudioRenderer(const AudioRenderer &c) {
@@ -129,6 +131,22 @@ bool AudioRenderer::IsRunning() const throw(CAXException) {
     return static_cast<bool>(isRunning);
 }
 
+void AudioRenderer::RenderOffline(UInt32 frames, AudioBufferList* ioData) throw(CAXException) {
+    XThrowIf(!_offline, kAudioUnitErr_InvalidPropertyValue, "AudioRenderer::RenderOffline (!_offline)");
+    XThrowIf(frames > kOfflineMaximumFramesPerSlice, kAudioUnitErr_TooManyFramesToProcess, "AudioRenderer::RenderOffline (frames > kOfflineMaximumFramesPerSlice)");
+    
+    // the sample time only advances when the client pulls, which makes the output (ramps included) independent of wall-clock time
+    AudioTimeStamp timestamp;
+    bzero(&timestamp, sizeof(AudioTimeStamp));
+    timestamp.mSampleTime = _offlineSampleTime;
+    timestamp.mFlags = kAudioTimeStampSampleTimeValid;
+    
+    AudioUnitRenderActionFlags flags = 0;
+    XThrowIfError(AudioUnitRender(*output, &flags, &timestamp, 0, frames, ioData), "AudioUnitRender");
+    
+    _offlineSampleTime += frames;
+}
+
 bool AudioRenderer::_must_update_graph_predicate() throw(CAXException) {
     if (_automaticGraphUpdates) {
         _graphUpdateNeeded = false;
@@ -264,6 +282,12 @@ UInt32 AudioRenderer::AttachSources(CFArrayRef sources) throw (CAXException) {
             //XThrowIfError(AUGraphGetNodeInfo(graph, converter_node, NULL, NULL, NULL, &converter_au), "AUGraphGetNodeInfo");
             CAAudioUnit converter = CAAudioUnit(converter_node, converter_au);
             
+            // offline renderers pull larger slices than the output device does
+            if (_offline) {
+                UInt32 max_frames = kOfflineMaximumFramesPerSlice;
+                XThrowIfError(converter.SetProperty(kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0, &max_frames, sizeof(UInt32)), "converter.SetProperty kAudioUnitProperty_MaximumFramesPerSlice");
+            }
+            
             // set the input and output formats of the converter
             XThrowIfError(converter.SetFormat(kAudioUnitScope_Input, 0, source_format), "converter->SetFormat kAudioUnitScope_Input");
             CAStreamBasicDescription mixer_format;
@@ -672,10 +696,10 @@ void AudioRenderer::CreateGraph() {
     // main processing graph
     XThrowIfError(NewAUGraph(&graph), "NewAUGraph");
     
-    // add the default output AU to the graph
+    // add the default output AU to the graph, or a generic output AU if we're rendering offline
     AUNode output_node;
     acd.componentType = kAudioUnitType_Output;
-    acd.componentSubType = kAudioUnitSubType_DefaultOutput;
+    acd.componentSubType = (_offline) ? kAudioUnitSubType_GenericOutput : kAudioUnitSubType_DefaultOutput;
     XThrowIfError(AUGraphAddNode(graph, &acd, &output_node), "AUGraphAddNode kAudioUnitSubType_DefaultOutput");
     //XThrowIfError(AUGraphNewNode(graph, &acd, 0, NULL, &output_node), "AUGraphNewNode");
     
@@ -713,6 +737,15 @@ void AudioRenderer::CreateGraph() {
     XThrowIfError(output->SetFormat(kAudioUnitScope_Input, 0, format), "output->SetFormat");
     XThrowIfError(mixer->SetFormat(kAudioUnitScope_Output, 0, format), "mixer->SetFormat");
     
+    // a generic output unit has no hardware format, so the client gets the mix format; it also needs larger slices
+    if (_offline) {
+        XThrowIfError(output->SetFormat(kAudioUnitScope_Output, 0, format), "output->SetFormat");
+        
+        UInt32 max_frames = kOfflineMaximumFramesPerSlice;
+        XThrowIfError(output->SetProperty(kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0, &max_frames, sizeof(UInt32)), "output->SetProperty kAudioUnitProperty_MaximumFramesPerSlice");
+        XThrowIfError(mixer->SetProperty(kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0, &max_frames, sizeof(UInt32)), "mixer->SetProperty kAudioUnitProperty_MaximumFramesPerSlice");
+    }
+    
     // add a pre-render callback on the mixer so we can schedule gain and pan ramps
     XThrowIfError(mixer->AddRenderNotify(AudioRenderer::MixerRenderNotifyCallback, this), "CAAudioUnit::AddRenderNotify");
     
@@ -15,12 +15,14 @@
 #endif
 
 #include <libkern/OSAtomic.h>
+#include <mach/semaphore.h>
 #include <MHKKit/MHKAudioDecompression.h>
 
 #include "Rendering/Audio/RXAudioSourceBase.h"
+#include "Rendering/Audio/RXDecodedSoundCache.h"
 
 #include "Base/RXAtomic.h"
-#include "Utilities/VirtualRingBuffer.h"
+#include "Utilities/RXRingBuffer.h"
 
 
 namespace RX {
@@ -30,15 +32,28 @@ public:
     static OSStatus RXCardAudioSourceRenderCallback(void* inRefCon, AudioUnitRenderActionFlags* ioActionFlags, const AudioTimeStamp* inTimeStamp, UInt32 inBusNumber, UInt32 inNumberFrames, AudioBufferList* ioData);
 
     CardAudioSource(id <MHKAudioDecompression> decompressor, float gain, float pan, bool loop) throw(CAXException);
+    
+    // sources created with a decoded sound play it straight from memory and never need to be tasked; the source
+    // retains the sound
+    CardAudioSource(DecodedSound* sound, float gain, float pan, bool loop) throw(CAXException);
     virtual ~CardAudioSource() throw(CAXException);
     
     // rendering
     void RenderTask() throw();
     void Reset() throw();
     
+    // the task semaphore is signaled from the render callback when the buffered audio drops below the low watermark;
+    // RenderTask then decodes up to the high watermark
+    inline void SetTaskSemaphore(semaphore_t semaphore) throw() {_task_semaphore = semaphore;}
+    
+    // buffering statistics
+    double FillLevel() throw();
+    inline uint32_t UnderrunCount() const throw() {return _underruns;}
+    
     // info 
-    inline int64_t FrameCount() const throw() {return [_decompressor frameCount];}
-    inline double Duration() const throw() {return [_decompressor frameCount] / format.mSampleRate;}
+    inline int64_t FrameCount() const throw() {return _frame_count;}
+    inline double Duration() const throw() {return _frame_count / format.mSampleRate;}
+    inline bool MemoryBacked() const throw() {return _decoded != NULL;}
     
     // nominal gain
     inline float NominalGain() const throw() {return _gain;}
@@ -62,19 +77,36 @@ protected:
     virtual OSStatus Render(AudioUnitRenderActionFlags* ioActionFlags, const AudioTimeStamp* inTimeStamp, UInt32 inNumberFrames, AudioBufferList* ioData) throw();
 
 private:
+    void initialize() throw();
     void task(uint32_t byte_limit) throw();
+    OSStatus renderDecoded(AudioUnitRenderActionFlags* ioActionFlags, UInt32 inNumberFrames, AudioBufferList* ioData) throw();
 
     id <MHKAudioDecompression> _decompressor;
+    DecodedSound* _decoded;
+    int64_t _frame_count;
     float _gain;
     float _pan;
     bool _loop;
     
-    VirtualRingBuffer* _decompressionBuffer;
-    VirtualRingBuffer* volatile _render_buffer;
-    OSSpinLock _buffer_swap_lock;
+    // sources attached to an offline renderer decode on the render thread instead of relying on RenderTask
+    bool _offline;
+    
+    // the render callback never locks; Reset swaps _render_buffer and waits for _render_busy to drop before deleting the old buffer
+    RingBuffer* _decompressionBuffer;
+    RingBuffer* volatile _render_buffer;
+    volatile int32_t _render_busy;
     
     int64_t _bufferedFrames;
-    uint32_t _bytesPerTask;
+    uint32_t _low_watermark;
+    uint32_t _high_watermark;
+    
+    semaphore_t _task_semaphore;
+    volatile int32_t _task_requested;
+    volatile bool _decode_complete;
+    volatile uint32_t _underruns;
+    
+    // play position in a decoded sound; only the render callback and Reset touch it
+    volatile uint32_t _play_frame;
     
     uint8_t* _loopBuffer;
     uint8_t* _loopBufferEnd;
@@ -7,16 +7,16 @@
  *
  */
 
+#import <sched.h>
+
 #import "Base/RXLogging.h"
 
 #import "RXCardAudioSource.h"
 
 namespace RX {
 
-CardAudioSource::CardAudioSource(id <MHKAudioDecompression> decompressor, float gain, float pan, bool loop) throw(CAXException) : _decompressor(decompressor), _gain(gain), _pan(pan), _loop(loop)
+CardAudioSource::CardAudioSource(id <MHKAudioDecompression> decompressor, float gain, float pan, bool loop) throw(CAXException) : _decompressor(decompressor), _decoded(NULL), _gain(gain), _pan(pan), _loop(loop)
 {
-    _task_lock = OS_SPINLOCK_INIT;
-    
     // keep our decompressor around
     [_decompressor retain];
     
@@ -24,30 +24,64 @@ CardAudioSource::CardAudioSource(id <MHKAudioDecompression> decompressor, float
     
     // set our format to the decompressor's format
     format = CAStreamBasicDescription([_decompressor outputFormat]);
+    _frame_count = [_decompressor frameCount];
+    
+    initialize();
+    
+#if defined(DEBUG_AUDIO) && DEBUG_AUDIO > 1
+    RXCFLog(kRXLoggingAudio, kRXLoggingLevelDebug, CFSTR("<RX::CardAudioSource: 0x%x> initialized with decompressor %p"), this, decompressor);
+#endif
+}
+
+CardAudioSource::CardAudioSource(DecodedSound* sound, float gain, float pan, bool loop) throw(CAXException) : _decompressor(nil), _decoded(sound), _gain(gain), _pan(pan), _loop(loop)
+{
+    release_assert(_decoded);
+    _decoded->Retain();
+    
+    format = _decoded->Format();
+    _frame_count = _decoded->FrameCount();
+    
+    initialize();
+    
+    // slices that wrap around the end of the sound need a buffer of their own when the caller doesn't provide one
+    _loopBufferLength = format.FramesToBytes(AudioRenderer::kOfflineMaximumFramesPerSlice);
+    _loopBuffer = reinterpret_cast<uint8_t*>(malloc(_loopBufferLength));
+    release_assert(_loopBuffer);
+    
+#if defined(DEBUG_AUDIO) && DEBUG_AUDIO > 1
+    RXCFLog(kRXLoggingAudio, kRXLoggingLevelDebug, CFSTR("<RX::CardAudioSource: 0x%x> initialized with decoded sound %p"), this, sound);
+#endif
+}
+
+void CardAudioSource::initialize() throw() {
+    _task_lock = OS_SPINLOCK_INIT;
     
     // CardAudioSource only handles interleaved formats
     debug_assert(format.IsInterleaved());
     
-    // 2 seconds per tasking round
-    size_t framesPerTask = static_cast<size_t>(2.0 * format.mSampleRate);
-    _bytesPerTask = framesPerTask * format.mBytesPerFrame;
+    // the task thread is woken up when less than half a second is buffered and decodes up to one second
+    _low_watermark = static_cast<uint32_t>(0.5 * format.mSampleRate) * format.mBytesPerFrame;
+    _high_watermark = static_cast<uint32_t>(1.0 * format.mSampleRate) * format.mBytesPerFrame;
     
-    _render_buffer = nil;
-    _decompressionBuffer = nil;
-    _buffer_swap_lock = OS_SPINLOCK_INIT;
+    _render_buffer = NULL;
+    _render_busy = 0;
+    _decompressionBuffer = NULL;
     
     _bufferedFrames = 0;
+    _play_frame = 0;
     
-    _loopBuffer = 0;
+    _task_semaphore = 0;
+    _task_requested = 0;
+    _decode_complete = false;
+    _underruns = 0;
+    _offline = false;
     
-#if defined(DEBUG_AUDIO) && DEBUG_AUDIO > 1
-    RXCFLog(kRXLoggingAudio, kRXLoggingLevelDebug, CFSTR("<RX::CardAudioSource: 0x%x> initialized with decompressor %p"), this, decompressor);
-#endif
+    _loopBuffer = 0;
 }
 
 CardAudioSource::~CardAudioSource() throw(CAXException) {
 #if defined(DEBUG_AUDIO) && DEBUG_AUDIO > 1
-    RXCFLog(kRXLoggingAudio, kRXLoggingLevelDebug, CFSTR("<RX::CardAudioSource: 0x%x> deallocating"), this);
+    RXCFLog(kRXLoggingAudio, kRXLoggingLevelDebug, CFSTR("<RX::CardAudioSource: 0x%x> deallocating (%u underruns)"), this, _underruns);
 #endif
     
     OSSpinLockLock(&_task_lock);
@@ -55,7 +89,9 @@ CardAudioSource::~CardAudioSource() throw(CAXException) {
     Finalize();
     
     [_decompressor release];
-    [_decompressionBuffer release];
+    if (_decoded)
+        _decoded->Release();
+    delete _decompressionBuffer;
     
     if (_loopBuffer)
         free(_loopBuffer);
@@ -63,11 +99,13 @@ CardAudioSource::~CardAudioSource() throw(CAXException) {
     OSSpinLockUnlock(&_task_lock);
 }
 
-OSStatus CardAudioSource::Render(AudioUnitRenderActionFlags* ioActionFlags, const AudioTimeStamp* inTimeStamp, UInt32 inNumberFrames, AudioBufferList* ioData) throw() {    
-    OSSpinLockLock(&_buffer_swap_lock);
-    VirtualRingBuffer* volatile render_buffer = _render_buffer;
-    [render_buffer retain];
-    OSSpinLockUnlock(&_buffer_swap_lock);
+OSStatus CardAudioSource::Render(AudioUnitRenderActionFlags* ioActionFlags, const AudioTimeStamp* inTimeStamp, UInt32 inNumberFrames, AudioBufferList* ioData) throw() {
+    if (_decoded)
+        return renderDecoded(ioActionFlags, inNumberFrames, ioData);
+    
+    // flag that we're using the render buffer before loading it; Reset will not free a buffer while the flag is up
+    __atomic_store_n(&_render_busy, 1, __ATOMIC_SEQ_CST);
+    RingBuffer* render_buffer = __atomic_load_n(&_render_buffer, __ATOMIC_SEQ_CST);
     
     // if we're disable, have no renderer, no decompressor or no render buffer, render silence
     if (!Enabled() || !rendererPtr || !_decompressor || !render_buffer) {
@@ -79,7 +117,7 @@ OSStatus CardAudioSource::Render(AudioUnitRenderActionFlags* ioActionFlags, cons
         RXCFLog(kRXLoggingAudio, kRXLoggingLevelDebug, CFSTR("<RX::CardAudioSource: 0x%x> rendering silence because disabled, no renderer, no decompressor or no decompression buffer"), this);
 #endif
         
-        [render_buffer release];
+        __atomic_store_n(&_render_busy, 0, __ATOMIC_RELEASE);
         return noErr;
     }
     
@@ -87,8 +125,16 @@ OSStatus CardAudioSource::Render(AudioUnitRenderActionFlags* ioActionFlags, cons
     UInt32 optimalBytesToRead = inNumberFrames * format.mBytesPerFrame;
     debug_assert(ioData->mBuffers[0].mDataByteSize == optimalBytesToRead);
     
-    void* readBuffer = 0;
-    UInt32 availableBytes = [render_buffer lengthAvailableToReadReturningPointer:&readBuffer];
+    UInt32 availableBytes = render_buffer->BytesAvailableToRead();
+    
+    // offline, nobody else is tasking the source, so decode what is missing right now; this keeps the output independent of scheduling
+    if (_offline && availableBytes < optimalBytesToRead) {
+        OSSpinLockLock(&_task_lock);
+        task(optimalBytesToRead - availableBytes);
+        OSSpinLockUnlock(&_task_lock);
+        
+        availableBytes = render_buffer->BytesAvailableToRead();
+    }
     
     // if there are no samples available, render silence
     if (availableBytes == 0) {
@@ -100,27 +146,110 @@ OSStatus CardAudioSource::Render(AudioUnitRenderActionFlags* ioActionFlags, cons
         RXCFLog(kRXLoggingAudio, kRXLoggingLevelDebug, CFSTR("<RX::CardAudioSource: 0x%x> rendering silence because of sample starvation"), this);
 #endif
         
-        [render_buffer release];
+        if (!_decode_complete) {
+            __sync_fetch_and_add(&_underruns, 1);
+            if (_task_semaphore && __sync_bool_compare_and_swap(&_task_requested, 0, 1))
+                semaphore_signal(_task_semaphore);
+        }
+        
+        __atomic_store_n(&_render_busy, 0, __ATOMIC_RELEASE);
         return noErr;
     }
     
     // handle either the normal or the overload case
     if (availableBytes >= optimalBytesToRead) {
-        memcpy(ioData->mBuffers[0].mData, readBuffer, optimalBytesToRead);
-        [render_buffer didReadLength:optimalBytesToRead];
+        render_buffer->Read(ioData->mBuffers[0].mData, optimalBytesToRead);
+        availableBytes -= optimalBytesToRead;
     } else {
 #if defined(DEBUG_AUDIO) && DEBUG_AUDIO > 2
         RXCFLog(kRXLoggingAudio, kRXLoggingLevelDebug, CFSTR("<RX::CardAudioSource: 0x%x> rendering silence because of partial sample starvation"), this);
 #endif
-        memcpy(ioData->mBuffers[0].mData, readBuffer, availableBytes);
-        [render_buffer didReadLength:availableBytes];
+        render_buffer->Read(ioData->mBuffers[0].mData, availableBytes);
         bzero(reinterpret_cast<unsigned char*>(ioData->mBuffers[0].mData) + availableBytes, optimalBytesToRead - availableBytes);
+        availableBytes = 0;
+        
+        // running out at the end of a non-looping sound is not an underrun
+        if (!_decode_complete)
+            __sync_fetch_and_add(&_underruns, 1);
     }
     
-    [render_buffer release];
+    // wake up the task thread if we've dropped below the low watermark; only signal once per task
+    if (availableBytes < _low_watermark && _task_semaphore && !_decode_complete && __sync_bool_compare_and_swap(&_task_requested, 0, 1))
+        semaphore_signal(_task_semaphore);
+    
+    __atomic_store_n(&_render_busy, 0, __ATOMIC_RELEASE);
     return noErr;
 }
 
+OSStatus CardAudioSource::renderDecoded(AudioUnitRenderActionFlags* ioActionFlags, UInt32 inNumberFrames, AudioBufferList* ioData) throw() {
+    if (!Enabled() || !rendererPtr) {
+        for (UInt32 bufferIndex = 0; bufferIndex < ioData->mNumberBuffers; bufferIndex++)
+            bzero(ioData->mBuffers[bufferIndex].mData, ioData->mBuffers[bufferIndex].mDataByteSize);
+        *ioActionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+        return noErr;
+    }
+    
+    const uint8_t* samples = _decoded->Samples();
+    uint32_t frame_count = static_cast<uint32_t>(_frame_count);
+    uint32_t play_frame = _play_frame;
+    uint32_t contiguous_frames = frame_count - play_frame;
+    
+    // if the caller did not provide a buffer and the slice does not wrap, point it straight into the decoded sound
+    if (!ioData->mBuffers[0].mData && contiguous_frames >= inNumberFrames) {
+        ioData->mBuffers[0].mData = const_cast<uint8_t*>(samples) + format.FramesToBytes(play_frame);
+        ioData->mBuffers[0].mDataByteSize = format.FramesToBytes(inNumberFrames);
+        
+        play_frame += inNumberFrames;
+        if (play_frame == frame_count && _loop)
+            play_frame = 0;
+        _play_frame = play_frame;
+        return noErr;
+    }
+    
+    // otherwise copy, wrapping around for looping sounds and padding with silence at the end of the others
+    if (!ioData->mBuffers[0].mData) {
+        debug_assert(format.FramesToBytes(inNumberFrames) <= _loopBufferLength);
+        ioData->mBuffers[0].mData = _loopBuffer;
+        ioData->mBuffers[0].mDataByteSize = format.FramesToBytes(inNumberFrames);
+    }
+    
+    uint8_t* output = reinterpret_cast<uint8_t*>(ioData->mBuffers[0].mData);
+    UInt32 frames_left = inNumberFrames;
+    while (frames_left > 0) {
+        if (play_frame == frame_count) {
+            if (!_loop) {
+                bzero(output, format.FramesToBytes(frames_left));
+                break;
+            }
+            play_frame = 0;
+        }
+        
+        UInt32 frames = frame_count - play_frame;
+        if (frames > frames_left)
+            frames = frames_left;
+        
+        memcpy(output, samples + format.FramesToBytes(play_frame), format.FramesToBytes(frames));
+        output += format.FramesToBytes(frames);
+        play_frame += frames;
+        frames_left -= frames;
+    }
+    
+    _play_frame = play_frame;
+    return noErr;
+}
+
+double CardAudioSource::FillLevel() throw() {
+    // a decoded sound is always entirely buffered
+    if (_decoded)
+        return (_frame_count - _play_frame) / format.mSampleRate;
+    
+    // the task lock keeps Reset from replacing the buffer under us
+    OSSpinLockLock(&_task_lock);
+    double fill = (_decompressionBuffer) ? format.BytesToFrames(_decompressionBuffer->BytesAvailableToRead()) / format.mSampleRate : 0.0;
+    OSSpinLockUnlock(&_task_lock);
+    return fill;
+}
+
 void CardAudioSource::RenderTask() throw() {
     if (!_decompressor || !_decompressionBuffer)
         return;
@@ -131,7 +260,14 @@ void CardAudioSource::RenderTask() throw() {
         return;
     }
 
-    task(_bytesPerTask);
+    // decode enough to bring the buffer back up to the high watermark
+    uint32_t buffered_bytes = _decompressionBuffer->BytesAvailableToRead();
+    if (buffered_bytes < _high_watermark)
+        task(_high_watermark - buffered_bytes);
+    
+    // re-arm the render callback's low watermark signal, unless there is nothing left to decode
+    if (!_decode_complete)
+        __sync_lock_release(&_task_requested);
     
     OSSpinLockUnlock(&_task_lock);
 }
@@ -141,9 +277,9 @@ void CardAudioSource::task(uint32_t byte_limit) throw() {
     RXCFLog(kRXLoggingAudio, kRXLoggingLevelDebug, CFSTR("<RX::CardAudioSource: 0x%x> tasking"), this);
 #endif
     
-    // get how many bytes are available in the decompression ring buffer and a suitable write pointer
+    // get how many contiguous bytes are available in the decompression ring buffer and a suitable write pointer
     void* write_ptr = NULL;
-    UInt32 available_bytes = [_decompressionBuffer lengthAvailableToWriteReturningPointer:&write_ptr];
+    UInt32 available_bytes = _decompressionBuffer->WriteSpan(&write_ptr);
     
     // we want to fill as many bytes as are available in the decompression buffer up to the specified byte limit
     UInt32 bytes_to_fill = (available_bytes < byte_limit) ? available_bytes : byte_limit;
@@ -179,6 +315,7 @@ void CardAudioSource::task(uint32_t byte_limit) throw() {
 #if defined(DEBUG_AUDIO) && DEBUG_AUDIO > 1
             RXCFLog(kRXLoggingAudio, kRXLoggingLevelDebug, CFSTR("<RX::CardAudioSource: 0x%x> no frames left to decode, bailing out"), this);
 #endif
+            _decode_complete = true;
             return;
         }
     }
@@ -189,6 +326,8 @@ void CardAudioSource::task(uint32_t byte_limit) throw() {
     
     // we fill as many bytes as the number of available frames (clamped to the ideal number of frames)
     bytes_to_fill = format.FramesToBytes(available_frames);
+    if (bytes_to_fill == 0)
+        return;
     
     // prepare a suitable ABL
     AudioBufferList abl;
@@ -202,18 +341,18 @@ void CardAudioSource::task(uint32_t byte_limit) throw() {
     
     // buffer accounting
     _bufferedFrames += available_frames;
-    frames_to_fill -= available_frames;
     
     // update the ring buffer
-    [_decompressionBuffer didWriteLength:bytes_to_fill];
+    _decompressionBuffer->DidWrite(bytes_to_fill);
     
-    // if we're looping and we're missing frames from the ideal number, reset the decompressor and go for another round
-    if (_loop && frames_to_fill > 0) {
-        [_decompressor reset];
-        _bufferedFrames = 0;
-        
-        task(format.FramesToBytes(frames_to_fill));
-    }
+    if (!_loop && _bufferedFrames == [_decompressor frameCount])
+        _decode_complete = true;
+    
+    // if we're missing bytes from the limit, go for another round; this either loops back to the beginning of the sound
+    // or continues at the beginning of the ring buffer's storage if it is not mirrored
+    uint32_t remaining_bytes = byte_limit - bytes_to_fill;
+    if (remaining_bytes >= format.mBytesPerFrame && !_decode_complete)
+        task(remaining_bytes);
 }
 
 #pragma mark -
@@ -229,27 +368,42 @@ void CardAudioSource::Reset() throw() {
     rendererPtr->SetSourceGain(*this, _gain);
     rendererPtr->SetSourcePan(*this, _pan);
     
+    // decoded sounds only need to rewind
+    if (_decoded) {
+        _play_frame = 0;
+        _decode_complete = true;
+        OSSpinLockUnlock(&_task_lock);
+        return;
+    }
+    
     // reset the decompressor
     [_decompressor reset];
     
-    // create a new decompression buffer that's 10 seconds long (2 seconds per task)
-    _decompressionBuffer = [[VirtualRingBuffer alloc] initWithLength:_bytesPerTask * 5];
+    // create a new decompression buffer that can hold the high watermark plus some slack
+    RingBuffer* old_buffer = _decompressionBuffer;
+    _decompressionBuffer = new RingBuffer(_high_watermark + _low_watermark);
+    release_assert(_decompressionBuffer->Valid());
     _bufferedFrames = 0;
+    _decode_complete = false;
     
-    // go for 1 round of tasking so we don't starve the first few callbacks
-    task(_bytesPerTask);
+    // decode up to the low watermark so we don't starve the first few callbacks, and let the task thread do the rest;
+    // keeping this short reduces the latency of newly activated sounds
+    task(_low_watermark);
+    _task_requested = 1;
+    if (_task_semaphore && !_decode_complete)
+        semaphore_signal(_task_semaphore);
     
-    // swap the render buffer; this will also take care of releasing any previous decompression buffer
-    VirtualRingBuffer* render_buffer = _render_buffer;
-    OSSpinLockLock(&_buffer_swap_lock);
-    _render_buffer = _decompressionBuffer;
-    OSSpinLockUnlock(&_buffer_swap_lock);
-    [render_buffer release];
+    // publish the new buffer to the render callback, then wait for any render in progress to let go of the old one
+    __atomic_exchange_n(&_render_buffer, _decompressionBuffer, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&_render_busy, __ATOMIC_SEQ_CST))
+        sched_yield();
+    delete old_buffer;
     
     OSSpinLockUnlock(&_task_lock);
 }
 
 void CardAudioSource::HandleAttach() throw(CAXException) {
+    _offline = rendererPtr->IsOffline();
     Reset();
 }
 
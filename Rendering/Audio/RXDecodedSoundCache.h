@@ -0,0 +1,163 @@
+/*
+ *  RXDecodedSoundCache.h
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 21/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#if !defined(RX_DECODED_SOUND_CACHE_H)
+#define RX_DECODED_SOUND_CACHE_H
+
+#if !defined(__cplusplus)
+#error C++ is required to include RXDecodedSoundCache.h
+#endif
+
+#include <deque>
+#include <map>
+#include <string>
+#include <pthread.h>
+#include <stdint.h>
+
+#include <MHKKit/MHKAudioDecompression.h>
+
+#include "Rendering/Audio/PublicUtility/CAStreamBasicDescription.h"
+
+
+namespace RX {
+
+//
+// DecodedSound is an immutable block of decoded PCM shared by every CardAudioSource playing the same sound. It is
+// reference counted; the cache holds one reference for as long as the sound is cached and each source holds another.
+//
+class DecodedSound {
+friend class DecodedSoundCache;
+
+public:
+    inline const CAStreamBasicDescription& Format() const throw() {return _format;}
+    inline const uint8_t* Samples() const throw() {return _samples;}
+    inline size_t Length() const throw() {return _length;}
+    inline int64_t FrameCount() const throw() {return _frame_count;}
+
+    inline void Retain() throw() {__sync_fetch_and_add(&_references, 1);}
+    inline void Release() throw() {if (__sync_sub_and_fetch(&_references, 1) == 0) delete this;}
+
+private:
+    DecodedSound(const CAStreamBasicDescription& format, uint8_t* samples, size_t length, int64_t frame_count) throw();
+    ~DecodedSound() throw();
+
+    DecodedSound(const DecodedSound& c);
+    DecodedSound& operator=(const DecodedSound& c) {return *this;}
+
+    CAStreamBasicDescription _format;
+    uint8_t* _samples;
+    size_t _length;
+    int64_t _frame_count;
+
+    volatile int32_t _references;
+};
+
+//
+// DecodedSoundCache keeps short, frequently reused sounds decoded in memory, keyed by stack key and tWAV ID. Sounds are
+// decoded on the audio task thread, a second at a time between the tasking of the streaming sources, so a sound that
+// misses is streamed from its decompressor the first time and played from memory once it has been decoded. The total
+// size of the cached PCM is bounded by the budget; when a new sound does not fit, the least recently used sounds that
+// no source is playing are evicted. Sounds that are too long, or that cannot fit because everything in the cache is
+// in use, are not cached and are always streamed.
+//
+class DecodedSoundCache {
+public:
+    struct Statistics {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        uint64_t rejections;
+        size_t bytes;
+        size_t entries;
+        size_t pending;
+    };
+
+    static DecodedSoundCache& SharedCache() throw();
+
+    // returns a retained sound the caller must release, or NULL if the sound should be streamed; on a miss, decode is
+    // set if the sound is worth caching and is not being decoded yet, in which case the caller should queue it with
+    // Decode; the decompressor is only used to read the sound's format and length
+    DecodedSound* Acquire(const std::string& stack, uint16_t twav_id, id <MHKAudioDecompression> decompressor, bool* decode) throw();
+
+    // queues a sound for decoding on the audio task thread; the cache retains the decompressor, which must be one no
+    // source uses
+    void Decode(const std::string& stack, uint16_t twav_id, id <MHKAudioDecompression> decompressor) throw();
+
+    // called by the audio task thread; decodes up to a second of the queued sounds and returns true while work remains
+    bool Task() throw();
+
+    // budget is in bytes; lowering it evicts unused sounds right away
+    size_t Budget() throw();
+    void SetBudget(size_t budget) throw();
+
+    // sounds longer than this many seconds are never cached
+    double MaximumDuration() throw();
+    void SetMaximumDuration(double duration) throw();
+
+    // drops every sound that is not in use and every queued decode, e.g. before the stacks are unloaded
+    void Flush() throw();
+
+    Statistics GetStatistics() throw();
+    double HitRate() throw();
+
+private:
+    typedef std::pair<std::string, uint16_t> Key;
+
+    struct Entry {
+        DecodedSound* sound;
+        uint64_t last_use;
+    };
+
+    typedef std::map<Key, Entry> EntryMap;
+
+    struct Job {
+        Key key;
+        id <MHKAudioDecompression> decompressor;
+        CAStreamBasicDescription format;
+        int64_t frame_count;
+        size_t length;
+        uint8_t* samples;
+        size_t offset;
+        uint64_t generation;
+    };
+
+    DecodedSoundCache() throw();
+    ~DecodedSoundCache() throw();
+
+    DecodedSoundCache(const DecodedSoundCache& c);
+    DecodedSoundCache& operator=(const DecodedSoundCache& c) {return *this;}
+
+    // must be called with the cache mutex locked
+    bool evict(size_t bytes_needed) throw();
+    bool cacheable(const CAStreamBasicDescription& format, int64_t frame_count) const throw();
+    bool queued(const Key& key) const throw();
+
+    // must be called without the cache mutex locked, on the audio task thread
+    void finish() throw();
+
+    pthread_mutex_t _mutex;
+    EntryMap _entries;
+    uint64_t _clock;
+
+    // queued decodes, and the one the audio task thread is working on; only the audio task thread touches the
+    // samples and offset of the current job, and Flush bumps the generation to drop it when it finishes
+    std::deque<Job> _jobs;
+    Job _job;
+    bool _decoding;
+    uint64_t _generation;
+
+    size_t _budget;
+    double _maximum_duration;
+
+    Statistics _statistics;
+};
+
+} // namespace RX
+
+#endif // RX_DECODED_SOUND_CACHE_H
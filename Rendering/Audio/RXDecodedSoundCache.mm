@@ -0,0 +1,287 @@
+/*
+ *  RXDecodedSoundCache.mm
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 21/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#import "Base/RXLogging.h"
+
+#import "RXDecodedSoundCache.h"
+
+namespace RX {
+
+DecodedSound::DecodedSound(const CAStreamBasicDescription& format, uint8_t* samples, size_t length, int64_t frame_count) throw() :
+    _format(format), _samples(samples), _length(length), _frame_count(frame_count), _references(1)
+{
+
+}
+
+DecodedSound::~DecodedSound() throw() {
+    free(_samples);
+}
+
+#pragma mark -
+
+DecodedSoundCache& DecodedSoundCache::SharedCache() throw() {
+    static DecodedSoundCache cache;
+    return cache;
+}
+
+DecodedSoundCache::DecodedSoundCache() throw() : _clock(0), _decoding(false), _generation(0), _budget(32 * 1024 * 1024), _maximum_duration(10.0) {
+    pthread_mutex_init(&_mutex, NULL);
+    bzero(&_statistics, sizeof(Statistics));
+    _job.decompressor = nil;
+    _job.samples = NULL;
+}
+
+DecodedSoundCache::~DecodedSoundCache() throw() {
+    for (EntryMap::iterator it = _entries.begin(); it != _entries.end(); ++it)
+        it->second.sound->Release();
+    for (std::deque<Job>::iterator it = _jobs.begin(); it != _jobs.end(); ++it)
+        [it->decompressor release];
+    pthread_mutex_destroy(&_mutex);
+}
+
+DecodedSound* DecodedSoundCache::Acquire(const std::string& stack, uint16_t twav_id, id <MHKAudioDecompression> decompressor, bool* decode) throw() {
+    *decode = false;
+    pthread_mutex_lock(&_mutex);
+
+    Key key(stack, twav_id);
+    EntryMap::iterator it = _entries.find(key);
+    if (it != _entries.end()) {
+        _statistics.hits++;
+        it->second.last_use = ++_clock;
+        it->second.sound->Retain();
+
+        DecodedSound* sound = it->second.sound;
+        pthread_mutex_unlock(&_mutex);
+        return sound;
+    }
+
+    _statistics.misses++;
+
+    if (!cacheable(CAStreamBasicDescription([decompressor outputFormat]), [decompressor frameCount]))
+        _statistics.rejections++;
+    else
+        *decode = !queued(key);
+
+    pthread_mutex_unlock(&_mutex);
+    return NULL;
+}
+
+void DecodedSoundCache::Decode(const std::string& stack, uint16_t twav_id, id <MHKAudioDecompression> decompressor) throw() {
+    if (!decompressor)
+        return;
+
+    Job job;
+    job.key = Key(stack, twav_id);
+    job.format = CAStreamBasicDescription([decompressor outputFormat]);
+    job.frame_count = [decompressor frameCount];
+    job.length = static_cast<size_t>(job.format.FramesToBytes(static_cast<UInt32>(job.frame_count)));
+    job.samples = NULL;
+    job.offset = 0;
+
+    pthread_mutex_lock(&_mutex);
+    if (queued(job.key) || _entries.find(job.key) != _entries.end() || !cacheable(job.format, job.frame_count)) {
+        pthread_mutex_unlock(&_mutex);
+        return;
+    }
+
+    job.decompressor = [decompressor retain];
+    job.generation = _generation;
+    _jobs.push_back(job);
+    _statistics.pending = _jobs.size() + ((_decoding) ? 1 : 0);
+    pthread_mutex_unlock(&_mutex);
+}
+
+bool DecodedSoundCache::Task() throw() {
+    pthread_mutex_lock(&_mutex);
+    if (!_decoding) {
+        if (_jobs.empty()) {
+            pthread_mutex_unlock(&_mutex);
+            return false;
+        }
+        _job = _jobs.front();
+        _jobs.pop_front();
+        _decoding = true;
+    }
+    pthread_mutex_unlock(&_mutex);
+
+    // nothing else uses the job's decompressor, so the decoding itself happens without the mutex
+    if (!_job.samples) {
+        _job.samples = reinterpret_cast<uint8_t*>(malloc(_job.length));
+        if (!_job.samples) {
+            finish();
+            return true;
+        }
+    }
+
+    // decode one second, so that the streaming sources are tasked again before the next one
+    size_t chunk = static_cast<size_t>(_job.format.FramesToBytes(static_cast<UInt32>(_job.format.mSampleRate)));
+    if (chunk > _job.length - _job.offset)
+        chunk = _job.length - _job.offset;
+
+    AudioBufferList abl;
+    abl.mNumberBuffers = 1;
+    abl.mBuffers[0].mNumberChannels = _job.format.mChannelsPerFrame;
+    abl.mBuffers[0].mDataByteSize = static_cast<UInt32>(chunk);
+    abl.mBuffers[0].mData = _job.samples + _job.offset;
+    [_job.decompressor fillAudioBufferList:&abl];
+    _job.offset += chunk;
+
+    if (_job.offset >= _job.length || chunk == 0)
+        finish();
+    return true;
+}
+
+void DecodedSoundCache::finish() throw() {
+    pthread_mutex_lock(&_mutex);
+
+    // a flush while the sound was decoding drops it; otherwise it is cached if it still fits in the budget
+    bool flushed = _job.generation != _generation;
+    bool cached = false;
+    if (!flushed && _job.samples && _job.length <= _budget && evict(_job.length)) {
+        // the cache's reference is the one the sound is created with
+        Entry entry;
+        entry.sound = new DecodedSound(_job.format, _job.samples, _job.length, _job.frame_count);
+        entry.last_use = ++_clock;
+        _entries[_job.key] = entry;
+
+        _statistics.bytes += _job.length;
+        _statistics.entries = _entries.size();
+        cached = true;
+    } else if (!flushed)
+        _statistics.rejections++;
+
+#if defined(DEBUG_AUDIO)
+    if (cached)
+        RXCFLog(kRXLoggingAudio, kRXLoggingLevelDebug, CFSTR("<RX::DecodedSoundCache: 0x%x> decoded sound %hu (%lu bytes), %lu/%lu bytes in use, hit rate %.2f"),
+            this, _job.key.second, _job.length, _statistics.bytes, _budget, HitRate());
+#endif
+
+    _decoding = false;
+    _statistics.pending = _jobs.size();
+    pthread_mutex_unlock(&_mutex);
+
+    if (!cached)
+        free(_job.samples);
+    [_job.decompressor release];
+    _job.decompressor = nil;
+    _job.samples = NULL;
+}
+
+bool DecodedSoundCache::cacheable(const CAStreamBasicDescription& format, int64_t frame_count) const throw() {
+    // only short, interleaved sounds are worth keeping in memory
+    if (!format.IsInterleaved() || frame_count <= 0 || frame_count / format.mSampleRate > _maximum_duration)
+        return false;
+    return static_cast<size_t>(format.FramesToBytes(static_cast<UInt32>(frame_count))) <= _budget;
+}
+
+bool DecodedSoundCache::queued(const Key& key) const throw() {
+    if (_decoding && _job.key == key)
+        return true;
+    for (std::deque<Job>::const_iterator it = _jobs.begin(); it != _jobs.end(); ++it) {
+        if (it->key == key)
+            return true;
+    }
+    return false;
+}
+
+bool DecodedSoundCache::evict(size_t bytes_needed) throw() {
+    // evict the least recently used sounds only the cache references until the new sound fits
+    while (_statistics.bytes + bytes_needed > _budget) {
+        EntryMap::iterator victim = _entries.end();
+        for (EntryMap::iterator it = _entries.begin(); it != _entries.end(); ++it) {
+            if (it->second.sound->_references != 1)
+                continue;
+            if (victim == _entries.end() || it->second.last_use < victim->second.last_use)
+                victim = it;
+        }
+
+        // everything left is playing
+        if (victim == _entries.end())
+            return false;
+
+        _statistics.bytes -= victim->second.sound->Length();
+        _statistics.evictions++;
+
+        // no source holds a reference and only Acquire adds references, under the mutex, so this frees the sound
+        victim->second.sound->Release();
+        _entries.erase(victim);
+    }
+
+    _statistics.entries = _entries.size();
+    return true;
+}
+
+size_t DecodedSoundCache::Budget() throw() {
+    pthread_mutex_lock(&_mutex);
+    size_t budget = _budget;
+    pthread_mutex_unlock(&_mutex);
+    return budget;
+}
+
+void DecodedSoundCache::SetBudget(size_t budget) throw() {
+    pthread_mutex_lock(&_mutex);
+    _budget = budget;
+    evict(0);
+    pthread_mutex_unlock(&_mutex);
+}
+
+double DecodedSoundCache::MaximumDuration() throw() {
+    pthread_mutex_lock(&_mutex);
+    double duration = _maximum_duration;
+    pthread_mutex_unlock(&_mutex);
+    return duration;
+}
+
+void DecodedSoundCache::SetMaximumDuration(double duration) throw() {
+    pthread_mutex_lock(&_mutex);
+    _maximum_duration = duration;
+    pthread_mutex_unlock(&_mutex);
+}
+
+void DecodedSoundCache::Flush() throw() {
+    pthread_mutex_lock(&_mutex);
+
+    EntryMap::iterator it = _entries.begin();
+    while (it != _entries.end()) {
+        if (it->second.sound->_references != 1) {
+            ++it;
+            continue;
+        }
+
+        _statistics.bytes -= it->second.sound->Length();
+        _statistics.evictions++;
+        it->second.sound->Release();
+        _entries.erase(it++);
+    }
+    _statistics.entries = _entries.size();
+
+    // queued decodes go too, and the one in progress is dropped when it finishes
+    for (std::deque<Job>::iterator job = _jobs.begin(); job != _jobs.end(); ++job)
+        [job->decompressor release];
+    _jobs.clear();
+    _generation++;
+    _statistics.pending = (_decoding) ? 1 : 0;
+
+    pthread_mutex_unlock(&_mutex);
+}
+
+DecodedSoundCache::Statistics DecodedSoundCache::GetStatistics() throw() {
+    pthread_mutex_lock(&_mutex);
+    Statistics statistics = _statistics;
+    pthread_mutex_unlock(&_mutex);
+    return statistics;
+}
+
+double DecodedSoundCache::HitRate() throw() {
+    // does not lock so Acquire can log it; a torn read only skews the statistic
+    uint64_t lookups = _statistics.hits + _statistics.misses;
+    return (lookups) ? static_cast<double>(_statistics.hits) / lookups : 0.0;
+}
+
+} // namespace RX
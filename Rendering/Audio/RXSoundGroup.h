@@ -54,6 +54,10 @@
     NSMutableSet* _sounds;
 }
 
+- (id)initWithSLSTRecord:(const uint16_t*)slst_record soundCount:(uint16_t)sound_count stack:(RXStack*)parent swapBytes:(BOOL)swap;
+
+- (void)setFadeFlags:(uint16_t)fade_flags;
+
 - (void)addSoundWithStack:(RXStack*)parent ID:(uint16_t)twav_id gain:(float)g pan:(float)p;
 - (NSSet*)sounds;
 
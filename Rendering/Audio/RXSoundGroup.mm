@@ -84,6 +84,56 @@
     return self;
 }
 
+- (id)initWithSLSTRecord:(const uint16_t*)slst_record soundCount:(uint16_t)sound_count stack:(RXStack*)parent swapBytes:(BOOL)swap {
+    self = [self init];
+    if (!self)
+        return nil;
+    
+    // some useful pointers
+    const uint16_t* group_parameters = slst_record + sound_count;
+    const uint16_t* gain_parameters = group_parameters + 5;
+    const uint16_t* pan_parameters = gain_parameters + sound_count;
+    
+    // fade flags
+    uint16_t fade_flags = *group_parameters;
+    if (swap)
+        fade_flags = CFSwapInt16BigToHost(fade_flags);
+    [self setFadeFlags:fade_flags];
+    
+    // loop flag
+    uint16_t loop_flag = *(group_parameters + 1);
+    if (swap)
+        loop_flag = CFSwapInt16BigToHost(loop_flag);
+    loop = (loop_flag) ? YES : NO;
+    
+    // group gain
+    uint16_t integer_gain = *(group_parameters + 2);
+    if (swap)
+        integer_gain = CFSwapInt16BigToHost(integer_gain);
+    gain = (float)integer_gain / kRXSoundGainDivisor;
+    
+    uint16_t sound_index = 0;
+    for (; sound_index < sound_count; ++sound_index) {
+        uint16_t sound_id = *(slst_record + sound_index);
+        if (swap)
+            sound_id = CFSwapInt16BigToHost(sound_id);
+        
+        integer_gain = *(gain_parameters + sound_index);
+        if (swap)
+            integer_gain = CFSwapInt16BigToHost(integer_gain);
+        float sound_gain = (float)integer_gain / kRXSoundGainDivisor;
+        
+        int16_t integer_pan = *((int16_t*)(pan_parameters + sound_index));
+        if (swap)
+            integer_pan = (int16_t)CFSwapInt16BigToHost(integer_pan);
+        float sound_pan = 0.5f + ((float)integer_pan / 200.0f);
+        
+        [self addSoundWithStack:parent ID:sound_id gain:sound_gain pan:sound_pan];
+    }
+    
+    return self;
+}
+
 - (void)dealloc {
 #if defined(DEBUG) && DEBUG > 1
     RXOLog(@"deallocating");
@@ -98,6 +148,11 @@
         [super description], fadeOutRemovedSounds, fadeInNewSounds, loop, gain, [_sounds count]];
 }
 
+- (void)setFadeFlags:(uint16_t)fade_flags {
+    fadeOutRemovedSounds = (fade_flags & RX_SLST_FADE_OUT_REMOVED_SOUNDS) ? YES : NO;
+    fadeInNewSounds = (fade_flags & RX_SLST_FADE_IN_NEW_SOUNDS) ? YES : NO;
+}
+
 - (void)addSoundWithStack:(RXStack*)parent ID:(uint16_t)twav_id gain:(float)g pan:(float)p {
     RXSound* sound = [RXSound new];
     sound->parent = parent;
@@ -0,0 +1,55 @@
+//
+//  RXSoundGroupTransition.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 21/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#import "Rendering/Audio/RXSoundGroup.h"
+
+
+// plans the transition from the set of active sounds to a new sound group; sounds are matched by tWAV identity (stack
+// and ID), so a sound that continues across cards keeps its live source and only has its gain and pan ramped
+@interface RXSoundGroupTransition : NSObject {
+@public
+    BOOL fadeOutRemovedSounds;
+    BOOL fadeInNewSounds;
+    BOOL loop;
+
+@private
+    NSMutableSet* _addedSounds;
+    NSMutableSet* _removedSounds;
+    NSMutableSet* _activeSounds;
+
+    NSMutableArray* _continuingSounds;
+    float* _targetGains;
+    float* _targetPans;
+    BOOL* _gainChanged;
+    BOOL* _panChanged;
+}
+
+- (id)initWithActiveSounds:(NSSet*)activeSounds soundGroup:(RXSoundGroup*)soundGroup forceFadeIn:(BOOL)forceFadeIn;
+
+// sounds of the new group that are not active; they need a new source
+- (NSSet*)addedSounds;
+
+// active sounds that are not in the new group
+- (NSSet*)removedSounds;
+
+// the active sounds after the transition: the current active sounds plus the added sounds; removed sounds stay active
+// until their detach timestamp expires
+- (NSSet*)activeSounds;
+
+// active sounds that are also in the new group, in no particular order; these are the active instances, which own the
+// live sources, not the new group's instances
+- (NSArray*)continuingSounds;
+
+// the gain (including the group gain) and pan each continuing sound must reach; a sound that was being faded out or
+// whose source's nominal value differs from the target is flagged as changed and needs a ramp
+- (float)targetGainForContinuingSoundAtIndex:(NSUInteger)index;
+- (float)targetPanForContinuingSoundAtIndex:(NSUInteger)index;
+- (BOOL)gainChangedForContinuingSoundAtIndex:(NSUInteger)index;
+- (BOOL)panChangedForContinuingSoundAtIndex:(NSUInteger)index;
+
+@end
@@ -0,0 +1,132 @@
+//
+//  RXSoundGroupTransition.mm
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 21/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#import "Rendering/Audio/RXSoundGroupTransition.h"
+
+
+@implementation RXSoundGroupTransition
+
+- (id)init {
+    [self doesNotRecognizeSelector:_cmd];
+    [self release];
+    return nil;
+}
+
+- (id)initWithActiveSounds:(NSSet*)activeSounds soundGroup:(RXSoundGroup*)soundGroup forceFadeIn:(BOOL)forceFadeIn {
+    self = [super init];
+    if (!self)
+        return nil;
+
+    fadeOutRemovedSounds = soundGroup->fadeOutRemovedSounds;
+    fadeInNewSounds = soundGroup->fadeInNewSounds || forceFadeIn;
+    loop = soundGroup->loop;
+
+    NSSet* groupSounds = [soundGroup sounds];
+
+    // the removed sounds are the active sounds minus the group's sounds
+    _removedSounds = [activeSounds mutableCopy];
+    [_removedSounds minusSet:groupSounds];
+
+    // the added sounds are the group's sounds minus the active sounds
+    _addedSounds = [groupSounds mutableCopy];
+    [_addedSounds minusSet:activeSounds];
+
+    _activeSounds = [activeSounds mutableCopy];
+    [_activeSounds unionSet:_addedSounds];
+
+    // everything else continues; pair each active instance with the target parameters from the group's instance
+    NSUInteger continuingCount = [groupSounds count] - [_addedSounds count];
+    _continuingSounds = [[NSMutableArray alloc] initWithCapacity:continuingCount];
+    _targetGains = new float[continuingCount + 1];
+    _targetPans = new float[continuingCount + 1];
+    _gainChanged = new BOOL[continuingCount + 1];
+    _panChanged = new BOOL[continuingCount + 1];
+
+    NSEnumerator* soundEnum = [groupSounds objectEnumerator];
+    RXSound* sound;
+    while ((sound = [soundEnum nextObject])) {
+        RXSound* activeSound = [activeSounds member:sound];
+        if (!activeSound)
+            continue;
+
+        NSUInteger index = [_continuingSounds count];
+        [_continuingSounds addObject:activeSound];
+
+        _targetGains[index] = sound->gain * soundGroup->gain;
+        _targetPans[index] = sound->pan;
+
+        // a sound scheduled for detach is fading out or about to be cut, so it must be brought back up
+        if (activeSound->source) {
+            _gainChanged[index] = activeSound->detach_timestamp != 0 || activeSound->source->NominalGain() != _targetGains[index];
+            _panChanged[index] = activeSound->source->NominalPan() != _targetPans[index];
+        } else {
+            _gainChanged[index] = YES;
+            _panChanged[index] = YES;
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc {
+    [_addedSounds release];
+    [_removedSounds release];
+    [_activeSounds release];
+    [_continuingSounds release];
+
+    delete[] _targetGains;
+    delete[] _targetPans;
+    delete[] _gainChanged;
+    delete[] _panChanged;
+
+    [super dealloc];
+}
+
+- (NSString*)description {
+    return [NSString stringWithFormat:@"%@ {fadeOutRemovedSounds=%d, fadeInNewSounds=%d, %lu added, %lu continuing, %lu removed}",
+        [super description], fadeOutRemovedSounds, fadeInNewSounds, (unsigned long)[_addedSounds count],
+        (unsigned long)[_continuingSounds count], (unsigned long)[_removedSounds count]];
+}
+
+- (NSSet*)addedSounds {
+    return _addedSounds;
+}
+
+- (NSSet*)removedSounds {
+    return _removedSounds;
+}
+
+- (NSSet*)activeSounds {
+    return _activeSounds;
+}
+
+- (NSArray*)continuingSounds {
+    return _continuingSounds;
+}
+
+- (float)targetGainForContinuingSoundAtIndex:(NSUInteger)index {
+    release_assert(index < [_continuingSounds count]);
+    return _targetGains[index];
+}
+
+- (float)targetPanForContinuingSoundAtIndex:(NSUInteger)index {
+    release_assert(index < [_continuingSounds count]);
+    return _targetPans[index];
+}
+
+- (BOOL)gainChangedForContinuingSoundAtIndex:(NSUInteger)index {
+    release_assert(index < [_continuingSounds count]);
+    return _gainChanged[index];
+}
+
+- (BOOL)panChangedForContinuingSoundAtIndex:(NSUInteger)index {
+    release_assert(index < [_continuingSounds count]);
+    return _panChanged[index];
+}
+
+@end
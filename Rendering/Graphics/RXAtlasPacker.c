@@ -0,0 +1,358 @@
+/*
+ *  RXAtlasPacker.c
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 06/11/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Rendering/Graphics/RXAtlasPacker.h"
+
+
+// a segment of a skyline, from x to x + width at height y
+struct skyline_segment {
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+};
+
+// a released rect of a page, which can be reused by the pictures that fit in it
+struct free_rect {
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+};
+
+struct atlas_page {
+    struct skyline_segment* segments;
+    uint32_t segment_count;
+    uint32_t segment_capacity;
+
+    struct free_rect* free_rects;
+    uint32_t free_count;
+    uint32_t free_capacity;
+
+    uint32_t pictures;
+    uint64_t packed_area;
+    uint64_t used_area;
+    uint64_t free_area;
+};
+
+struct rx_atlas_packer {
+    uint16_t page_width;
+    uint16_t page_height;
+    uint16_t padding;
+
+    struct atlas_page* pages;
+    uint32_t page_count;
+};
+
+static void reset_page(rx_atlas_packer_t* packer, struct atlas_page* page)
+{
+    page->segments[0].x = 0;
+    page->segments[0].y = 0;
+    page->segments[0].width = packer->page_width;
+    page->segment_count = 1;
+    page->free_count = 0;
+    page->pictures = 0;
+    page->packed_area = 0;
+    page->used_area = 0;
+    page->free_area = 0;
+}
+
+static struct atlas_page* add_page(rx_atlas_packer_t* packer)
+{
+    struct atlas_page* pages = (struct atlas_page*)realloc(packer->pages, (packer->page_count + 1) * sizeof(struct atlas_page));
+    if (!pages)
+        return NULL;
+    packer->pages = pages;
+
+    struct atlas_page* page = pages + packer->page_count;
+    page->free_rects = NULL;
+    page->free_capacity = 0;
+    page->segment_capacity = 16;
+    page->segments = (struct skyline_segment*)malloc(page->segment_capacity * sizeof(struct skyline_segment));
+    if (!page->segments)
+        return NULL;
+    reset_page(packer, page);
+    packer->page_count++;
+    return page;
+}
+
+// the height at which a picture of the given width that starts at a segment would sit, or -1 if it runs off the page
+static int32_t fit_height(const rx_atlas_packer_t* packer, const struct atlas_page* page, uint32_t segment, uint32_t width)
+{
+    if (page->segments[segment].x + width > packer->page_width)
+        return -1;
+
+    int32_t y = 0;
+    int32_t remaining = (int32_t)width;
+    for (uint32_t i = segment; remaining > 0; i++)
+    {
+        if (page->segments[i].y > y)
+            y = page->segments[i].y;
+        remaining -= page->segments[i].width;
+    }
+    return y;
+}
+
+static bool add_free_rect(struct atlas_page* page, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    if (width == 0 || height == 0)
+        return true;
+    if (page->free_count == page->free_capacity)
+    {
+        uint32_t capacity = (page->free_capacity) ? page->free_capacity * 2 : 16;
+        struct free_rect* rects = (struct free_rect*)realloc(page->free_rects, capacity * sizeof(struct free_rect));
+        if (!rects)
+            return false;
+        page->free_rects = rects;
+        page->free_capacity = capacity;
+    }
+    page->free_area += width * height;
+    struct free_rect* rect = page->free_rects + page->free_count++;
+    rect->x = (uint16_t)x;
+    rect->y = (uint16_t)y;
+    rect->width = (uint16_t)width;
+    rect->height = (uint16_t)height;
+    return true;
+}
+
+// places a picture in the released rect it leaves the least of, and gives the rest of the rect back as the rect on its
+// right and the rect under it
+static bool reuse(struct atlas_page* page, uint32_t width, uint32_t height, uint16_t* out_x, uint16_t* out_y)
+{
+    uint32_t best = UINT32_MAX;
+    uint32_t best_leftover = UINT32_MAX;
+    for (uint32_t i = 0; i < page->free_count; i++)
+    {
+        const struct free_rect* rect = page->free_rects + i;
+        if (rect->width < width || rect->height < height)
+            continue;
+        uint32_t leftover = (uint32_t)rect->width * rect->height - width * height;
+        if (leftover < best_leftover)
+        {
+            best = i;
+            best_leftover = leftover;
+        }
+    }
+    if (best == UINT32_MAX)
+        return false;
+
+    struct free_rect rect = page->free_rects[best];
+    page->free_rects[best] = page->free_rects[--page->free_count];
+    page->free_area -= (uint32_t)rect.width * rect.height;
+
+    // split along the longer leftover edge, so that the larger of the two rects is as square as it can be
+    if (rect.width - width > rect.height - height)
+    {
+        add_free_rect(page, rect.x + width, rect.y, rect.width - width, rect.height);
+        add_free_rect(page, rect.x, rect.y + height, width, rect.height - height);
+    }
+    else
+    {
+        add_free_rect(page, rect.x + width, rect.y, rect.width - width, height);
+        add_free_rect(page, rect.x, rect.y + height, rect.width, rect.height - height);
+    }
+
+    *out_x = rect.x;
+    *out_y = rect.y;
+    return true;
+}
+
+static bool place(rx_atlas_packer_t* packer, struct atlas_page* page, uint32_t width, uint32_t height, uint16_t* out_x,
+                  uint16_t* out_y)
+{
+    // the segment where the bottom of the picture would be the highest, then the narrowest segment
+    uint32_t best = UINT32_MAX;
+    int32_t best_bottom = INT32_MAX;
+    uint32_t best_width = UINT32_MAX;
+    for (uint32_t i = 0; i < page->segment_count; i++)
+    {
+        int32_t y = fit_height(packer, page, i, width);
+        if (y < 0 || y + height > packer->page_height)
+            continue;
+        int32_t bottom = y + (int32_t)height;
+        if (bottom < best_bottom || (bottom == best_bottom && page->segments[i].width < best_width))
+        {
+            best = i;
+            best_bottom = bottom;
+            best_width = page->segments[i].width;
+        }
+    }
+    if (best == UINT32_MAX)
+        return false;
+
+    if (page->segment_count + 1 > page->segment_capacity)
+    {
+        uint32_t capacity = page->segment_capacity * 2;
+        struct skyline_segment* segments = (struct skyline_segment*)realloc(page->segments, capacity * sizeof(struct skyline_segment));
+        if (!segments)
+            return false;
+        page->segments = segments;
+        page->segment_capacity = capacity;
+    }
+
+    // the area between the old skyline and the bottom of the picture is packed, even where the picture does not cover
+    // it
+    uint16_t x = page->segments[best].x;
+    uint16_t y = (uint16_t)(best_bottom - height);
+    uint32_t end = x + width;
+    for (uint32_t i = best; i < page->segment_count && page->segments[i].x < end; i++)
+    {
+        uint32_t segment_end = page->segments[i].x + page->segments[i].width;
+        uint32_t covered = ((segment_end < end) ? segment_end : end) - page->segments[i].x;
+        page->packed_area += (uint64_t)covered * (uint32_t)(best_bottom - page->segments[i].y);
+    }
+
+    // insert the segment of the picture, then trim or remove the segments it covers
+    memmove(page->segments + best + 1, page->segments + best, (page->segment_count - best) * sizeof(struct skyline_segment));
+    page->segment_count++;
+    page->segments[best].x = x;
+    page->segments[best].y = (uint16_t)best_bottom;
+    page->segments[best].width = (uint16_t)width;
+
+    uint32_t i = best + 1;
+    while (i < page->segment_count && page->segments[i].x < end)
+    {
+        uint32_t segment_end = page->segments[i].x + page->segments[i].width;
+        if (segment_end <= end)
+        {
+            memmove(page->segments + i, page->segments + i + 1, (page->segment_count - i - 1) * sizeof(struct skyline_segment));
+            page->segment_count--;
+            continue;
+        }
+        page->segments[i].width = (uint16_t)(segment_end - end);
+        page->segments[i].x = (uint16_t)end;
+        break;
+    }
+
+    // merge the segments at the same height
+    i = 0;
+    while (i + 1 < page->segment_count)
+    {
+        if (page->segments[i].y == page->segments[i + 1].y)
+        {
+            page->segments[i].width += page->segments[i + 1].width;
+            memmove(page->segments + i + 1, page->segments + i + 2, (page->segment_count - i - 2) * sizeof(struct skyline_segment));
+            page->segment_count--;
+        }
+        else
+            i++;
+    }
+
+    *out_x = x;
+    *out_y = y;
+    return true;
+}
+
+// the padding is not needed past the edges of a page
+static void padded_size(const rx_atlas_packer_t* packer, uint16_t width, uint16_t height, uint32_t* padded_width,
+                        uint32_t* padded_height)
+{
+    *padded_width = width + packer->padding;
+    *padded_height = height + packer->padding;
+    if (*padded_width > packer->page_width)
+        *padded_width = packer->page_width;
+    if (*padded_height > packer->page_height)
+        *padded_height = packer->page_height;
+}
+
+#pragma mark -
+
+rx_atlas_packer_t* rx_atlas_packer_create(uint16_t page_width, uint16_t page_height, uint16_t padding)
+{
+    rx_atlas_packer_t* packer = (rx_atlas_packer_t*)calloc(1, sizeof(rx_atlas_packer_t));
+    if (!packer)
+        return NULL;
+    packer->page_width = page_width;
+    packer->page_height = page_height;
+    packer->padding = padding;
+    return packer;
+}
+
+void rx_atlas_packer_free(rx_atlas_packer_t* packer)
+{
+    if (!packer)
+        return;
+    for (uint32_t i = 0; i < packer->page_count; i++)
+    {
+        free(packer->pages[i].segments);
+        free(packer->pages[i].free_rects);
+    }
+    free(packer->pages);
+    free(packer);
+}
+
+bool rx_atlas_packer_allocate(rx_atlas_packer_t* packer, uint16_t width, uint16_t height, struct rx_atlas_location* location)
+{
+    if (width == 0 || height == 0 || width > packer->page_width || height > packer->page_height)
+        return false;
+
+    uint32_t padded_width, padded_height;
+    padded_size(packer, width, height, &padded_width, &padded_height);
+
+    for (uint32_t i = 0; i <= packer->page_count; i++)
+    {
+        struct atlas_page* page = (i < packer->page_count) ? packer->pages + i : add_page(packer);
+        if (!page)
+            return false;
+        if (!reuse(page, padded_width, padded_height, &location->x, &location->y) &&
+            !place(packer, page, padded_width, padded_height, &location->x, &location->y))
+        {
+            // a picture that fits in a page always fits in an empty one
+            if (page->pictures == 0)
+                return false;
+            continue;
+        }
+
+        page->pictures++;
+        page->used_area += (uint32_t)width * height;
+        location->page = i;
+        return true;
+    }
+    return false;
+}
+
+bool rx_atlas_packer_release(rx_atlas_packer_t* packer, const struct rx_atlas_location* location, uint16_t width, uint16_t height)
+{
+    struct atlas_page* page = packer->pages + location->page;
+    page->used_area -= (uint32_t)width * height;
+    if (--page->pictures)
+    {
+        // the rect is dead space if it cannot be remembered
+        uint32_t padded_width, padded_height;
+        padded_size(packer, width, height, &padded_width, &padded_height);
+        add_free_rect(page, location->x, location->y, padded_width, padded_height);
+        return false;
+    }
+    reset_page(packer, page);
+    return true;
+}
+
+void rx_atlas_packer_get_stats(const rx_atlas_packer_t* packer, struct rx_atlas_packer_stats* stats)
+{
+    memset(stats, 0, sizeof(struct rx_atlas_packer_stats));
+    for (uint32_t i = 0; i < packer->page_count; i++)
+    {
+        const struct atlas_page* page = packer->pages + i;
+        if (!page->pictures)
+            continue;
+        stats->pages++;
+        stats->pictures += page->pictures;
+        stats->page_area += (uint64_t)packer->page_width * packer->page_height;
+        stats->packed_area += page->packed_area;
+        stats->used_area += page->used_area;
+        stats->free_area += page->free_area;
+    }
+}
+
+double rx_atlas_packer_fragmentation(const struct rx_atlas_packer_stats* stats)
+{
+    return (stats->packed_area) ? 1.0 - (double)(stats->used_area + stats->free_area) / stats->packed_area : 0.0;
+}
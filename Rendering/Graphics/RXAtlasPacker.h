@@ -0,0 +1,68 @@
+/*
+ *  RXAtlasPacker.h
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 06/11/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#if !defined(RX_ATLAS_PACKER_H)
+#define RX_ATLAS_PACKER_H
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// The atlas packer places small pictures in pages of a fixed size, which the texture atlas backs with textures. Each
+// page is packed with a skyline: the top edge of the packed area is a list of horizontal segments, and a picture goes
+// where its bottom would be the highest, on the segment that fits it the tightest. Pictures are placed in the first
+// page that has room for them, and a new page is added when none has.
+//
+// A skyline cannot give back the space of a single picture, so the rects of released pictures are kept with their page
+// and reused by the pictures that fit in them, which leave the rest of the rect as two smaller rects; a page is only
+// emptied when its last picture is released. The fragmentation of the atlas is the part of the packed area that is
+// neither covered by live pictures nor kept for reuse: the gaps the skyline left under its segments, the padding
+// between pictures and the released rects that could not be remembered.
+//
+// Coordinates are in pixels, with the top row of a page at 0.
+//
+
+__BEGIN_DECLS
+
+struct rx_atlas_location {
+    uint32_t page;
+    uint16_t x;
+    uint16_t y;
+};
+
+struct rx_atlas_packer_stats {
+    uint32_t pages;         // the pages that have pictures
+    uint32_t pictures;
+    uint64_t page_area;     // the area of the pages that have pictures
+    uint64_t packed_area;   // the area under the skylines of those pages
+    uint64_t used_area;     // the area of the live pictures
+    uint64_t free_area;     // the area of the released rects that can be reused
+};
+
+typedef struct rx_atlas_packer rx_atlas_packer_t;
+
+// pictures are separated by padding pixels on their right and bottom edges
+rx_atlas_packer_t* rx_atlas_packer_create(uint16_t page_width, uint16_t page_height, uint16_t padding);
+void rx_atlas_packer_free(rx_atlas_packer_t* packer);
+
+// returns false if the picture is larger than a page or memory runs out
+bool rx_atlas_packer_allocate(rx_atlas_packer_t* packer, uint16_t width, uint16_t height, struct rx_atlas_location* location);
+
+// returns true if the page of the picture has no picture left
+bool rx_atlas_packer_release(rx_atlas_packer_t* packer, const struct rx_atlas_location* location, uint16_t width, uint16_t height);
+
+void rx_atlas_packer_get_stats(const rx_atlas_packer_t* packer, struct rx_atlas_packer_stats* stats);
+
+// the part of the packed area that is lost, from 0 to 1
+double rx_atlas_packer_fragmentation(const struct rx_atlas_packer_stats* stats);
+
+__END_DECLS
+
+#endif // RX_ATLAS_PACKER_H
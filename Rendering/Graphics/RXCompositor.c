@@ -0,0 +1,287 @@
+/*
+ *  RXCompositor.c
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 04/11/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Rendering/Graphics/RXCompositor.h"
+
+
+// a composition that only ever goes on top of the last one is redrawn from scratch past this many layers
+#define RX_COMPOSITOR_MAX_LAYERS 256
+
+static inline bool rect_is_empty(rx_core_rect_t rect)
+{
+    return rect.right <= rect.left || rect.bottom <= rect.top;
+}
+
+static inline uint32_t rect_area(rx_core_rect_t rect)
+{
+    return (rect_is_empty(rect)) ? 0 : (uint32_t)(rect.right - rect.left) * (rect.bottom - rect.top);
+}
+
+static inline rx_core_rect_t rect_union(rx_core_rect_t a, rx_core_rect_t b)
+{
+    rx_core_rect_t u;
+    u.left = (a.left < b.left) ? a.left : b.left;
+    u.top = (a.top < b.top) ? a.top : b.top;
+    u.right = (a.right > b.right) ? a.right : b.right;
+    u.bottom = (a.bottom > b.bottom) ? a.bottom : b.bottom;
+    return u;
+}
+
+bool rx_core_rect_intersection(rx_core_rect_t a, rx_core_rect_t b, rx_core_rect_t* intersection)
+{
+    rx_core_rect_t i;
+    i.left = (a.left > b.left) ? a.left : b.left;
+    i.top = (a.top > b.top) ? a.top : b.top;
+    i.right = (a.right < b.right) ? a.right : b.right;
+    i.bottom = (a.bottom < b.bottom) ? a.bottom : b.bottom;
+    if (rect_is_empty(i))
+        return false;
+    if (intersection)
+        *intersection = i;
+    return true;
+}
+
+#pragma mark -
+
+void rx_damage_clear(rx_damage_t* damage)
+{
+    damage->count = 0;
+}
+
+void rx_damage_add(rx_damage_t* damage, rx_core_rect_t rect)
+{
+    if (rect_is_empty(rect))
+        return;
+
+    // the rects the new rect overlaps are taken out of the set and merged into it, which may make it overlap other
+    // rects, so start over until it overlaps none
+    uint32_t i = 0;
+    while (i < damage->count)
+    {
+        if (rx_core_rect_intersection(damage->rects[i], rect, NULL))
+        {
+            rect = rect_union(rect, damage->rects[i]);
+            damage->rects[i] = damage->rects[--damage->count];
+            i = 0;
+        }
+        else
+            i++;
+    }
+
+    if (damage->count < RX_DAMAGE_MAX_RECTS)
+    {
+        damage->rects[damage->count++] = rect;
+        return;
+    }
+
+    // merge the rect with the one that grows the damaged area the least
+    uint32_t best = 0;
+    uint32_t best_growth = UINT32_MAX;
+    for (i = 0; i < damage->count; i++)
+    {
+        uint32_t growth = rect_area(rect_union(damage->rects[i], rect)) - rect_area(damage->rects[i]) - rect_area(rect);
+        if (growth < best_growth)
+        {
+            best = i;
+            best_growth = growth;
+        }
+    }
+    rect = rect_union(rect, damage->rects[best]);
+    damage->rects[best] = damage->rects[--damage->count];
+    rx_damage_add(damage, rect);
+}
+
+uint32_t rx_damage_area(const rx_damage_t* damage)
+{
+    uint32_t area = 0;
+    for (uint32_t i = 0; i < damage->count; i++)
+        area += rect_area(damage->rects[i]);
+    return area;
+}
+
+#pragma mark -
+
+static inline bool layers_are_equal(const struct rx_composite_layer* a, const struct rx_composite_layer* b)
+{
+    return a->content == b->content && a->sampling[0] == b->sampling[0] && a->sampling[1] == b->sampling[1] &&
+           a->sampling[2] == b->sampling[2] && a->sampling[3] == b->sampling[3] && a->rect.left == b->rect.left &&
+           a->rect.top == b->rect.top && a->rect.right == b->rect.right && a->rect.bottom == b->rect.bottom;
+}
+
+static inline rx_core_rect_t image_rect(const rx_compositor_t* compositor)
+{
+    rx_core_rect_t rect = {0, 0, compositor->width, compositor->height};
+    return rect;
+}
+
+// the part of a rect inside of the image
+static inline rx_core_rect_t clip_rect(const rx_compositor_t* compositor, rx_core_rect_t rect)
+{
+    rx_core_rect_t clipped;
+    if (!rx_core_rect_intersection(rect, image_rect(compositor), &clipped))
+        memset(&clipped, 0, sizeof(clipped));
+    return clipped;
+}
+
+static inline bool covers_image(const rx_compositor_t* compositor, rx_core_rect_t rect)
+{
+    return rect.left == 0 && rect.top == 0 && rect.right >= compositor->width && rect.bottom >= compositor->height;
+}
+
+static bool reserve_layers(rx_compositor_t* compositor, uint32_t count)
+{
+    if (count <= compositor->layer_capacity)
+        return true;
+    uint32_t capacity = (compositor->layer_capacity) ? compositor->layer_capacity : 16;
+    while (capacity < count)
+        capacity *= 2;
+    struct rx_composite_layer* layers = (struct rx_composite_layer*)realloc(compositor->layers,
+                                                                            capacity * sizeof(struct rx_composite_layer));
+    if (!layers)
+        return false;
+    compositor->layers = layers;
+    compositor->layer_capacity = capacity;
+    return true;
+}
+
+rx_compositor_t* rx_compositor_create(uint16_t width, uint16_t height)
+{
+    rx_compositor_t* compositor = (rx_compositor_t*)calloc(1, sizeof(rx_compositor_t));
+    if (!compositor)
+        return NULL;
+    compositor->width = width;
+    compositor->height = height;
+    return compositor;
+}
+
+void rx_compositor_free(rx_compositor_t* compositor)
+{
+    if (!compositor)
+        return;
+    free(compositor->layers);
+    free(compositor);
+}
+
+void rx_compositor_invalidate(rx_compositor_t* compositor)
+{
+    compositor->layer_count = 0;
+    compositor->valid = false;
+    rx_damage_clear(&compositor->pending_damage);
+}
+
+void rx_compositor_damage(rx_compositor_t* compositor, rx_core_rect_t rect)
+{
+    rx_damage_add(&compositor->pending_damage, clip_rect(compositor, rect));
+}
+
+bool rx_compositor_compose(rx_compositor_t* compositor, const struct rx_composite_layer* layers, uint32_t count,
+                           struct rx_composition* composition)
+{
+    memset(composition, 0, sizeof(struct rx_composition));
+    rx_damage_t* damage = &composition->damage;
+
+    uint32_t pixels_queued = 0;
+    uint32_t first_layer = count;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        pixels_queued += rect_area(clip_rect(compositor, layers[i].rect));
+        if (covers_image(compositor, layers[i].rect))
+            first_layer = i;
+    }
+
+    if (first_layer < count)
+    {
+        // the update replaces the composition; outside of the layers that differ, the pixels are covered by the same
+        // layers in both compositions
+        const struct rx_composite_layer* update = layers + first_layer;
+        uint32_t update_count = count - first_layer;
+        if (compositor->valid)
+        {
+            uint32_t n = (update_count > compositor->layer_count) ? update_count : compositor->layer_count;
+            for (uint32_t i = 0; i < n; i++)
+            {
+                if (i < update_count && i < compositor->layer_count && layers_are_equal(update + i, compositor->layers + i))
+                    continue;
+                if (i < compositor->layer_count)
+                    rx_damage_add(damage, clip_rect(compositor, compositor->layers[i].rect));
+                if (i < update_count)
+                    rx_damage_add(damage, clip_rect(compositor, update[i].rect));
+            }
+            for (uint32_t i = 0; i < compositor->pending_damage.count; i++)
+                rx_damage_add(damage, compositor->pending_damage.rects[i]);
+            composition->incremental = true;
+        }
+        else
+            rx_damage_add(damage, image_rect(compositor));
+
+        if (!reserve_layers(compositor, update_count))
+        {
+            rx_compositor_invalidate(compositor);
+            return false;
+        }
+        memcpy(compositor->layers, update, update_count * sizeof(struct rx_composite_layer));
+        compositor->layer_count = update_count;
+        compositor->valid = true;
+        composition->first_layer = first_layer;
+    }
+    else if (compositor->valid && compositor->layer_count + count <= RX_COMPOSITOR_MAX_LAYERS)
+    {
+        // the update goes on top of the composition; what was drawn outside of the update stays in the image, as it
+        // would if the update was painted over it, so the pending damage is kept for the next update that replaces
+        // the composition
+        if (!reserve_layers(compositor, compositor->layer_count + count))
+        {
+            rx_compositor_invalidate(compositor);
+            return false;
+        }
+        for (uint32_t i = 0; i < count; i++)
+            rx_damage_add(damage, clip_rect(compositor, layers[i].rect));
+        memcpy(compositor->layers + compositor->layer_count, layers, count * sizeof(struct rx_composite_layer));
+        compositor->layer_count += count;
+        composition->appended = true;
+        composition->incremental = (compositor->pending_damage.count == 0);
+    }
+    else
+    {
+        // what is under the update is unknown, so the update is simply painted over the image
+        if (!reserve_layers(compositor, count))
+        {
+            rx_compositor_invalidate(compositor);
+            return false;
+        }
+        for (uint32_t i = 0; i < count; i++)
+            rx_damage_add(damage, clip_rect(compositor, layers[i].rect));
+        memcpy(compositor->layers, layers, count * sizeof(struct rx_composite_layer));
+        compositor->layer_count = count;
+        compositor->valid = false;
+    }
+    if (!composition->appended)
+        rx_damage_clear(&compositor->pending_damage);
+
+    uint32_t pixels_redrawn = 0;
+    for (uint32_t d = 0; d < damage->count; d++)
+    {
+        for (uint32_t i = 0; i < compositor->layer_count; i++)
+        {
+            rx_core_rect_t intersection;
+            if (rx_core_rect_intersection(compositor->layers[i].rect, damage->rects[d], &intersection))
+                pixels_redrawn += rect_area(intersection);
+        }
+    }
+
+    compositor->stats.compositions++;
+    compositor->stats.pixels_queued += pixels_queued;
+    compositor->stats.pixels_redrawn += pixels_redrawn;
+    compositor->stats.last_pixels_queued = pixels_queued;
+    compositor->stats.last_pixels_redrawn = pixels_redrawn;
+    return true;
+}
@@ -0,0 +1,118 @@
+/*
+ *  RXCompositor.h
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 04/11/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#if !defined(RX_COMPOSITOR_H)
+#define RX_COMPOSITOR_H
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Engine/RXCoreStructures.h"
+
+//
+// The card pictures are painted into an image that is never cleared: every screen update paints the pictures the
+// scripts queued since the last update over what the image already shows, each picture replacing the pixels of its
+// rect. The scripts of most cards queue a picture that covers the whole card, then the pictures that go over it (the
+// marbles of the fire marble puzzle, the sliders of the domes), so an update usually repaints the whole card to move a
+// few small pictures.
+//
+// The compositor keeps the layers of the last composition, from the last layer that covers the whole image, and
+// compares them to the layers of an update index by index. The pixels outside of the rects of the layers that differ
+// are covered by the same layers in the same order, so only the damaged rects need to be redrawn, with the layers that
+// intersect them. Layers that do not cover the whole image are added on top of the last composition. What is drawn in
+// the image between compositions (movies, special effects) is damage, which stays in the image until an update
+// replaces the composition, like it would if the update was painted over the image.
+//
+// Rects are in card coordinates, with the top row at 0, and right and bottom exclusive.
+//
+
+__BEGIN_DECLS
+
+#define RX_DAMAGE_MAX_RECTS 8
+
+// a set of disjoint rects; rects that overlap are merged into their bounding rect, and so are the rects that grow the
+// damaged area the least once the set is full
+struct rx_damage {
+    uint32_t count;
+    rx_core_rect_t rects[RX_DAMAGE_MAX_RECTS];
+};
+typedef struct rx_damage rx_damage_t;
+
+void rx_damage_clear(rx_damage_t* damage);
+void rx_damage_add(rx_damage_t* damage, rx_core_rect_t rect);
+uint32_t rx_damage_area(const rx_damage_t* damage);
+
+// returns false if the rects do not intersect
+bool rx_core_rect_intersection(rx_core_rect_t a, rx_core_rect_t b, rx_core_rect_t* intersection);
+
+struct rx_composite_layer {
+    const void* content;    // what the layer draws, usually its texture
+    float sampling[4];      // the origin and size of the region of the content the layer draws
+    rx_core_rect_t rect;    // where the layer draws
+};
+
+struct rx_composition {
+    // the layers before first_layer are covered by a layer that covers the whole image, and are not part of the
+    // composition
+    uint32_t first_layer;
+
+    // the layers went on top of the last composition rather than replacing it
+    bool appended;
+
+    // the damage covers every pixel that changed since the last composition, so that the image is what it was after
+    // the last composition outside of it
+    bool incremental;
+
+    // the area to redraw with the layers of the composition that intersect it
+    rx_damage_t damage;
+};
+
+struct rx_compositor_stats {
+    uint64_t compositions;
+    uint64_t pixels_queued;     // the pixels of the layers of every update
+    uint64_t pixels_redrawn;    // the pixels of the layers redrawn in the damage
+    uint32_t last_pixels_queued;
+    uint32_t last_pixels_redrawn;
+};
+
+struct rx_compositor {
+    uint16_t width;
+    uint16_t height;
+
+    // the layers of the last composition; the image is their composition if valid, and the first one then covers the
+    // whole image
+    struct rx_composite_layer* layers;
+    uint32_t layer_count;
+    uint32_t layer_capacity;
+    bool valid;
+
+    rx_damage_t pending_damage;
+    struct rx_compositor_stats stats;
+};
+typedef struct rx_compositor rx_compositor_t;
+
+rx_compositor_t* rx_compositor_create(uint16_t width, uint16_t height);
+void rx_compositor_free(rx_compositor_t* compositor);
+
+// forgets the content of the image, which the next composition redraws
+void rx_compositor_invalidate(rx_compositor_t* compositor);
+
+// damages a rect of the image, which was drawn outside of a composition
+void rx_compositor_damage(rx_compositor_t* compositor, rx_core_rect_t rect);
+
+// composes the layers of an update over the image; the layers of the new composition are then the layers of the last
+// composition followed by the layers of the update if the update was appended, or the layers of the update from
+// first_layer; returns false if memory runs out, in which case the image must be redrawn with every layer
+bool rx_compositor_compose(rx_compositor_t* compositor, const struct rx_composite_layer* layers, uint32_t count,
+                           struct rx_composition* composition);
+
+__END_DECLS
+
+#endif // RX_COMPOSITOR_H
@@ -12,10 +12,12 @@
 
 
 @interface RXDynamicPicture : RXPicture {
-
+    NSRect _sampling_rect;
+    NSRect _render_rect;
 }
 
-+ (GLuint)sharedDynamicPictureUnpackBuffer;
+// draws pictures that share a texture object, such as the pictures of an atlas page, in order and with a single draw call
++ (void)renderPictures:(RXDynamicPicture**)pictures count:(uint32_t)count inContext:(CGLContextObj)cgl_ctx;
 
 - (id)initWithTexture:(RXTexture*)texture samplingRect:(NSRect)sampling_rect renderRect:(NSRect)render_rect owner:(id)owner;
 
@@ -144,31 +144,37 @@ static void free_dynamic_picture_index(GLuint index) {
 
 @implementation RXDynamicPicture
 
-+ (GLuint)sharedDynamicPictureUnpackBuffer {
-    static GLuint dynamic_picture_unpack_buffer = 0;
-    if (dynamic_picture_unpack_buffer)
-        return dynamic_picture_unpack_buffer;
++ (void)renderPictures:(RXDynamicPicture**)pictures count:(uint32_t)count inContext:(CGLContextObj)cgl_ctx {
+    // WARNING: MUST RUN IN THE CORE VIDEO RENDER THREAD
+    if (count == 0)
+        return;
     
-    CGLContextObj cgl_ctx = [g_worldView loadContext];
-    CGLLockContext(cgl_ctx);
+    GLint firsts[32];
+    GLsizei counts[32];
     
-    // create a buffer object in which to decompress dynamic pictures, which at most can be the size of the card viewport
-    glGenBuffers(1, &dynamic_picture_unpack_buffer); glReportError();
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, dynamic_picture_unpack_buffer); glReportError();
-    if (GLEW_APPLE_flush_buffer_range)
-        glBufferParameteriAPPLE(GL_PIXEL_UNPACK_BUFFER, GL_BUFFER_FLUSHING_UNMAP_APPLE, GL_FALSE);
-    glBufferData(GL_PIXEL_UNPACK_BUFFER, 1024 * 1024 * 4, NULL, GL_DYNAMIC_DRAW); glReportError();
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    OSSpinLockLock(&dynamic_picture_lock);
     
-    // we created a new buffer object, so flush
-    glFlush();
+    // every dynamic picture is in the dynamic picture VAO, so binding it and the shared texture once is enough
+    [RXGetContextState(cgl_ctx) bindVertexArrayObject:dynamic_picture_vao];
+    [pictures[0]->_texture bindWithContext:cgl_ctx lock:NO];
     
-    CGLUnlockContext(cgl_ctx);
+    for (uint32_t i = 0; i < count; i += 32) {
+        GLsizei batch = (GLsizei)MIN(count - i, 32U);
+        for (GLsizei j = 0; j < batch; j++) {
+            firsts[j] = pictures[i + j]->_index;
+            counts[j] = 4;
+        }
+        glMultiDrawArrays(GL_TRIANGLE_STRIP, firsts, counts, batch); glReportError();
+    }
     
-    return dynamic_picture_unpack_buffer;
+    OSSpinLockUnlock(&dynamic_picture_lock);
 }
 
 - (id)initWithTexture:(RXTexture*)texture samplingRect:(NSRect)sampling_rect renderRect:(NSRect)render_rect owner:(id)owner {
+    // the sampling rect is relative to the pixels of the texture, which may not start at the origin of its texture object
+    sampling_rect.origin.x += texture->origin.x;
+    sampling_rect.origin.y += texture->origin.y;
+    
     CGLContextObj cgl_ctx = [g_worldView loadContext];
     CGLLockContext(cgl_ctx);
     
@@ -224,6 +230,9 @@ static void free_dynamic_picture_index(GLuint index) {
     if (!self)
         return nil;
     
+    _sampling_rect = sampling_rect;
+    _render_rect = render_rect;
+    
     return self;
 }
 
@@ -241,6 +250,16 @@ static void free_dynamic_picture_index(GLuint index) {
     [super dealloc];
 }
 
+- (BOOL)getCompositeLayer:(struct rx_composite_layer*)layer {
+    layer->content = _texture;
+    layer->sampling[0] = _sampling_rect.origin.x;
+    layer->sampling[1] = _sampling_rect.origin.y;
+    layer->sampling[2] = _sampling_rect.size.width;
+    layer->sampling[3] = _sampling_rect.size.height;
+    layer->rect = RXMakeCoreRectFromCompositeDisplayRect(_render_rect);
+    return YES;
+}
+
 - (void)render:(const CVTimeStamp*)output_time inContext:(CGLContextObj)cgl_ctx framebuffer:(GLuint)fbo {
     OSSpinLockLock(&dynamic_picture_lock);
     [super render:output_time inContext:cgl_ctx framebuffer:fbo];
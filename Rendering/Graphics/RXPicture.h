@@ -10,6 +10,7 @@
 
 #import "Rendering/RXRendering.h"
 #import "Rendering/Graphics/RXTexture.h"
+#import "Rendering/Graphics/RXCompositor.h"
 
 
 @interface RXPicture : NSObject <RXRenderingProtocol> {
@@ -23,5 +24,9 @@
 - (id)initWithTexture:(RXTexture*)texture vao:(GLuint)vao index:(GLuint)index owner:(id)owner;
 
 - (id)owner;
+- (RXTexture*)texture;
+
+// describes where the picture draws for the card compositor; returns NO if the picture does not know
+- (BOOL)getCompositeLayer:(struct rx_composite_layer*)layer;
 
 @end
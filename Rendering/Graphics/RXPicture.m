@@ -49,6 +49,15 @@
     return _owner;
 }
 
+- (RXTexture*)texture {
+    return _texture;
+}
+
+- (BOOL)getCompositeLayer:(struct rx_composite_layer*)layer {
+    // the vertices of the picture are in a buffer object
+    return NO;
+}
+
 - (void)render:(const CVTimeStamp*)output_time inContext:(CGLContextObj)cgl_ctx framebuffer:(GLuint)fbo {
     // WARNING: MUST RUN IN THE CORE VIDEO RENDER THREAD
     
@@ -10,6 +10,7 @@
 
 
 #import "Rendering/RXRendering.h"
+#import "Rendering/Graphics/RXUploadRing.h"
 #import "Engine/RXStack.h"
 
 
@@ -19,12 +20,22 @@
     GLenum target;
     rx_size_t size;
     
+    // where the pixels of the texture start in the texture object, which is not the origin for the textures of an atlas
+    rx_point_t origin;
+    
 @protected
     BOOL _delete_when_done;
 }
 
 + (RXTexture*)newStandardTextureWithTarget:(GLenum)target size:(rx_size_t)s context:(CGLContextObj)cgl_ctx lock:(BOOL)lock;
 
+// pictures are uploaded through a ring of unpack buffers, which is created with the load context
++ (void)initializeUploadRing;
+
+// closes the per-frame upload counters; called by the world view after each frame
++ (void)endUploadFrame;
++ (struct rx_upload_ring_stats)uploadStatistics;
+
 - (id)initWithID:(GLuint)texid target:(GLenum)t size:(rx_size_t)s deleteWhenDone:(BOOL)dwd;
 
 - (void)bindWithContext:(CGLContextObj)cgl_ctx lock:(BOOL)lock;
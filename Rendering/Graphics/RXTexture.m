@@ -6,12 +6,86 @@
 //  Copyright 2005-2012 MacStorm. All rights reserved.
 //
 
+#import <libkern/OSAtomic.h>
+
 #import "Rendering/Graphics/RXTexture.h"
-#import "Rendering/Graphics/RXDynamicPicture.h"
 
 
+// pictures are decoded into a ring of unpack buffers, each large enough for a picture of up to 1024x1024 pixels
+#define RX_UPLOAD_RING_SLOTS 3
+#define RX_UPLOAD_RING_SLOT_SIZE (1024 * 1024 * 4)
+
+static rx_upload_ring_t* upload_ring = NULL;
+static GLuint upload_buffers[RX_UPLOAD_RING_SLOTS];
+static GLuint upload_fences[RX_UPLOAD_RING_SLOTS];
+static OSSpinLock upload_ring_lock = OS_SPINLOCK_INIT;
+
+static bool test_upload_fence(void* context, uint32_t slot) {
+    // without fences, the buffer of a slot is orphaned before it is mapped again, so it never has to be waited for
+    if (!GLEW_APPLE_fence)
+        return true;
+    
+    CGLContextObj cgl_ctx = (CGLContextObj)context;
+    return (glTestFenceAPPLE(upload_fences[slot])) ? true : false;
+}
+
+static void initialize_upload_ring(CGLContextObj cgl_ctx) {
+    // MUST BE CALLED WITH THE LOAD CONTEXT LOCKED
+    if (upload_ring)
+        return;
+    
+    glGenBuffers(RX_UPLOAD_RING_SLOTS, upload_buffers); glReportError();
+    for (int i = 0; i < RX_UPLOAD_RING_SLOTS; i++) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_buffers[i]); glReportError();
+        if (GLEW_APPLE_flush_buffer_range) {
+            glBufferParameteriAPPLE(GL_PIXEL_UNPACK_BUFFER, GL_BUFFER_FLUSHING_UNMAP_APPLE, GL_FALSE);
+            
+            // with fences, mapping a slot does not wait for the GPU to finish reading it; the fence of the slot does
+            if (GLEW_APPLE_fence)
+                glBufferParameteriAPPLE(GL_PIXEL_UNPACK_BUFFER, GL_BUFFER_SERIALIZED_MODIFY_APPLE, GL_FALSE);
+        }
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, RX_UPLOAD_RING_SLOT_SIZE, NULL, GL_STREAM_DRAW); glReportError();
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); glReportError();
+    
+    if (GLEW_APPLE_fence) {
+        glGenFencesAPPLE(RX_UPLOAD_RING_SLOTS, upload_fences); glReportError();
+    }
+    
+    // we created new buffer objects, so flush
+    glFlush();
+    
+    upload_ring = rx_upload_ring_create(RX_UPLOAD_RING_SLOTS, RX_UPLOAD_RING_SLOT_SIZE, test_upload_fence, cgl_ctx);
+    release_assert(upload_ring);
+}
+
 @implementation RXTexture
 
++ (void)initializeUploadRing {
+    CGLContextObj cgl_ctx = [g_worldView loadContext];
+    CGLLockContext(cgl_ctx);
+    initialize_upload_ring(cgl_ctx);
+    CGLUnlockContext(cgl_ctx);
+}
+
++ (void)endUploadFrame {
+    OSSpinLockLock(&upload_ring_lock);
+    if (upload_ring)
+        rx_upload_ring_end_frame(upload_ring);
+    OSSpinLockUnlock(&upload_ring_lock);
+}
+
++ (struct rx_upload_ring_stats)uploadStatistics {
+    struct rx_upload_ring_stats stats;
+    memset(&stats, 0, sizeof(struct rx_upload_ring_stats));
+    
+    OSSpinLockLock(&upload_ring_lock);
+    if (upload_ring)
+        rx_upload_ring_get_stats(upload_ring, &stats);
+    OSSpinLockUnlock(&upload_ring_lock);
+    return stats;
+}
+
 + (RXTexture*)newStandardTextureWithTarget:(GLenum)target size:(rx_size_t)s context:(CGLContextObj)cgl_ctx lock:(BOOL)lock {
     if (lock)
         CGLLockContext(cgl_ctx);
@@ -64,6 +138,7 @@
     texture = texid;
     target = t;
     size = s;
+    origin = RXPointMake(0, 0);
     
     _delete_when_done = dwd;
     
@@ -121,21 +196,55 @@
     // get the load context and lock it
     CGLContextObj cgl_ctx = [g_worldView loadContext];
     CGLLockContext(cgl_ctx);
+    initialize_upload_ring(cgl_ctx);
+    
+    // get a slot of the upload ring; a slot that is still in flight must be waited for
+    uint32_t slot;
+    OSSpinLockLock(&upload_ring_lock);
+    rx_upload_slot_status_t status = rx_upload_ring_acquire(upload_ring, (uint32_t)picture_size, &slot);
+    OSSpinLockUnlock(&upload_ring_lock);
+    if (status == RX_UPLOAD_SLOT_IN_FLIGHT && GLEW_APPLE_fence)
+        glFinishFenceAPPLE(upload_fences[slot]);
+    
+    // map the buffer of the slot, or decode in client memory if there was no slot for the picture
+    GLvoid* picture_buffer;
+    if (status != RX_UPLOAD_SLOT_NONE) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_buffers[slot]); glReportError();
+        if (!GLEW_APPLE_fence)
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, RX_UPLOAD_RING_SLOT_SIZE, NULL, GL_STREAM_DRAW);
+        picture_buffer = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY); glReportError();
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); glReportError();
+    } else
+        picture_buffer = malloc(picture_size);
+    
+    // load the picture without the load context, so that other threads can decode into other slots and upload
+    // meanwhile
+    CGLUnlockContext(cgl_ctx);
+    BOOL loaded = (picture_buffer) ? [archive loadBitmapWithID:tbmp_id buffer:picture_buffer format:MHK_BGRA_UNSIGNED_INT_8_8_8_8_REV_PACKED error:&error] : NO;
+    CGLLockContext(cgl_ctx);
     
-    // bind and map the dynamic picture unpack buffer
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, [RXDynamicPicture sharedDynamicPictureUnpackBuffer]); glReportError();
-    GLvoid* picture_buffer = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY); glReportError();
+    // unmap the buffer of the slot
+    if (status != RX_UPLOAD_SLOT_NONE) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_buffers[slot]); glReportError();
+        if (GLEW_APPLE_flush_buffer_range)
+            glFlushMappedBufferRangeAPPLE(GL_PIXEL_UNPACK_BUFFER, 0, picture_size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER); glReportError();
+    }
     
-    // load the picture
-    if (![archive loadBitmapWithID:tbmp_id buffer:picture_buffer format:MHK_BGRA_UNSIGNED_INT_8_8_8_8_REV_PACKED error:&error])
+    if (!loaded) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); glReportError();
+        CGLUnlockContext(cgl_ctx);
+        
+        OSSpinLockLock(&upload_ring_lock);
+        rx_upload_ring_cancel(upload_ring, slot);
+        OSSpinLockUnlock(&upload_ring_lock);
+        if (status == RX_UPLOAD_SLOT_NONE)
+            free(picture_buffer);
+        
         @throw [NSException exceptionWithName:@"RXPictureLoadException"
                                        reason:@"Could not load a picture resource."
                                      userInfo:[NSDictionary dictionaryWithObjectsAndKeys:error, NSUnderlyingErrorKey, nil]];
-    
-    // unmap the unpack buffer
-    if (GLEW_APPLE_flush_buffer_range)
-        glFlushMappedBufferRangeAPPLE(GL_PIXEL_UNPACK_BUFFER, 0, picture_size);
-    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER); glReportError();
+    }
     
     // create a texture object and bind it
     [self bindWithContext:cgl_ctx lock:NO];
@@ -150,9 +259,12 @@
     // client storage is not compatible with PBO texture unpacking
     GLenum client_storage = [RXGetContextState(cgl_ctx) setUnpackClientStorage:GL_FALSE];
     
-    // unpack the texture
-    glTexSubImage2D(target, 0, 0, 0, picture_width, picture_height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, BUFFER_OFFSET((void*)NULL, 0));
+    // unpack the texture, then fence the slot so that it is not written again before the GPU is done reading it
+    glTexSubImage2D(target, 0, origin.x, origin.y, picture_width, picture_height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,
+        (status != RX_UPLOAD_SLOT_NONE) ? BUFFER_OFFSET((void*)NULL, 0) : picture_buffer);
     glReportError();
+    if (status != RX_UPLOAD_SLOT_NONE && GLEW_APPLE_fence)
+        glSetFenceAPPLE(upload_fences[slot]);
     
     // reset the unpack buffer binding and restore unpack client storage
     glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); glReportError();
@@ -161,8 +273,16 @@
     // flush the update to synchronize it with the render context
     glFlush();
     
+    OSSpinLockLock(&upload_ring_lock);
+    rx_upload_ring_submit(upload_ring, slot, (uint32_t)picture_size);
+    OSSpinLockUnlock(&upload_ring_lock);
+    
     // unlock the load context
     CGLUnlockContext(cgl_ctx);
+    
+    // client memory is copied by glTexSubImage2D since client storage is disabled
+    if (status == RX_UPLOAD_SLOT_NONE)
+        free(picture_buffer);
 }
 
 - (void)updateWithBitmap:(uint16_t)tbmp_id stack:(RXStack*)stack {
@@ -0,0 +1,42 @@
+//
+//  RXTextureAtlas.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 06/11/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#import "Base/RXBase.h"
+
+#import "Rendering/RXRendering.h"
+#import "Rendering/Graphics/RXTexture.h"
+#import "Rendering/Graphics/RXAtlasPacker.h"
+
+//
+// The texture atlas packs small pictures into the pages of a few brokered textures, so that the pictures of a card
+// share a handful of texture objects and can be drawn together. The textures of the atlas are regions of a page; their
+// origin is where the region starts in the page texture. A page texture goes back to the broker when its last picture
+// is released.
+//
+
+// the largest width and height of the pictures the atlas takes
+#define RX_TEXTURE_ATLAS_MAX_SIDE 128
+
+
+@interface RXTextureAtlas : NSObject {
+    rx_atlas_packer_t* _packer;
+    OSSpinLock _lock;
+    
+    // the texture of each page, or nil while the page is empty
+    RXTexture** _pages;
+    uint32_t _page_capacity;
+}
+
++ (RXTextureAtlas*)sharedTextureAtlas;
+
+// returns nil if the size is too large for the atlas or the page texture could not be allocated
+- (RXTexture*)newTextureWithSize:(rx_size_t)size;
+
+- (struct rx_atlas_packer_stats)statistics;
+
+@end
@@ -0,0 +1,177 @@
+//
+//  RXTextureAtlas.m
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 06/11/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#import "Rendering/Graphics/RXTextureAtlas.h"
+#import "Rendering/Graphics/RXTextureBroker.h"
+
+
+// pages are a size class of the texture broker; a pixel of padding keeps pictures from sharing an edge
+#define RX_TEXTURE_ATLAS_PAGE_SIDE 512
+#define RX_TEXTURE_ATLAS_PADDING 1
+
+@interface RXAtlasTexture : RXTexture
+{
+@public
+    RXTexture* _page;
+    struct rx_atlas_location _location;
+}
+@end
+
+
+@interface RXTextureAtlas (RXTextureAtlas_Private)
+- (void)_releaseLocation:(const struct rx_atlas_location*)location size:(rx_size_t)size;
+@end
+
+
+@implementation RXAtlasTexture
+
+- (void)dealloc
+{
+    [[RXTextureAtlas sharedTextureAtlas] _releaseLocation:&_location size:size];
+    [_page release];
+    [super dealloc];
+}
+
+@end
+
+
+@implementation RXTextureAtlas
+
++ (RXTextureAtlas*)sharedTextureAtlas
+{
+    static RXTextureAtlas* atlas = nil;
+    if (atlas == nil)
+    {
+        atlas = [RXTextureAtlas new];
+    }
+    return atlas;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (!self)
+        return nil;
+    
+    _lock = OS_SPINLOCK_INIT;
+    _packer = rx_atlas_packer_create(RX_TEXTURE_ATLAS_PAGE_SIDE, RX_TEXTURE_ATLAS_PAGE_SIDE, RX_TEXTURE_ATLAS_PADDING);
+    if (!_packer)
+    {
+        [self release];
+        return nil;
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    for (uint32_t i = 0; i < _page_capacity; i++)
+        [_pages[i] release];
+    free(_pages);
+    rx_atlas_packer_free(_packer);
+    
+    [super dealloc];
+}
+
+- (struct rx_atlas_packer_stats)statistics
+{
+    struct rx_atlas_packer_stats stats;
+    OSSpinLockLock(&_lock);
+    rx_atlas_packer_get_stats(_packer, &stats);
+    OSSpinLockUnlock(&_lock);
+    return stats;
+}
+
+- (void)_releaseLocation:(const struct rx_atlas_location*)location size:(rx_size_t)size
+{
+    RXTexture* page = nil;
+    
+    OSSpinLockLock(&_lock);
+    if (rx_atlas_packer_release(_packer, location, size.width, size.height) && location->page < _page_capacity)
+    {
+        page = _pages[location->page];
+        _pages[location->page] = nil;
+    }
+    OSSpinLockUnlock(&_lock);
+    
+    // an empty page gives its texture back to the broker, outside of the lock
+    [page release];
+}
+
+- (RXTexture*)_newPageTexture:(uint32_t)page
+{
+    OSSpinLockLock(&_lock);
+    RXTexture* texture = (page < _page_capacity) ? [_pages[page] retain] : nil;
+    OSSpinLockUnlock(&_lock);
+    if (texture)
+        return texture;
+    
+    // allocate the texture of a new page outside of the lock, then keep the one another thread may have allocated
+    // in the meantime
+    RXTexture* new_texture = [[RXTextureBroker sharedTextureBroker] newTextureWithWidth:RX_TEXTURE_ATLAS_PAGE_SIDE
+                                                                                   height:RX_TEXTURE_ATLAS_PAGE_SIDE];
+    if (!new_texture)
+        return nil;
+    
+    OSSpinLockLock(&_lock);
+    if (page >= _page_capacity)
+    {
+        uint32_t capacity = page + 4;
+        _pages = realloc(_pages, capacity * sizeof(RXTexture*));
+        memset(_pages + _page_capacity, 0, (capacity - _page_capacity) * sizeof(RXTexture*));
+        _page_capacity = capacity;
+    }
+    if (!_pages[page])
+    {
+        _pages[page] = new_texture;
+        new_texture = nil;
+    }
+    texture = [_pages[page] retain];
+    OSSpinLockUnlock(&_lock);
+    
+    [new_texture release];
+    return texture;
+}
+
+- (RXTexture*)newTextureWithSize:(rx_size_t)size
+{
+    release_assert(size.width > 0);
+    release_assert(size.height > 0);
+    
+    if (size.width > RX_TEXTURE_ATLAS_MAX_SIDE || size.height > RX_TEXTURE_ATLAS_MAX_SIDE)
+        return nil;
+    
+    struct rx_atlas_location location;
+    OSSpinLockLock(&_lock);
+    bool allocated = rx_atlas_packer_allocate(_packer, size.width, size.height, &location);
+    OSSpinLockUnlock(&_lock);
+    if (!allocated)
+        return nil;
+    
+    RXTexture* page = [self _newPageTexture:location.page];
+    if (!page)
+    {
+        [self _releaseLocation:&location size:size];
+        return nil;
+    }
+    
+    // the texture shares the texture object of its page and keeps the page alive
+    RXAtlasTexture* texture = [[RXAtlasTexture alloc] initWithID:page->texture target:page->target size:size deleteWhenDone:NO];
+    texture->_page = page;
+    texture->_location = location;
+    texture->origin = RXPointMake(location.x, location.y);
+    
+#if defined(DEBUG)
+    RXOLog2(kRXLoggingGraphics, kRXLoggingLevelDebug, @"packed texture [size=%ux%u] in page %u at %u,%u", size.width,
+        size.height, location.page, location.x, location.y);
+#endif
+    return texture;
+}
+
+@end
@@ -10,37 +10,25 @@
 
 #import "Rendering/RXRendering.h"
 #import "Rendering/Graphics/RXTexture.h"
-#import "Base/RXDynamicBitfield.h"
-
-
-struct _rx_texture_bucket {
-    GLsizei width;
-    GLsizei height;
-    GLuint* tex_ids;
-    RXDynamicBitfield* in_use;
-};
-
-#if defined(DEBUG)
-struct _bucket_stat {
-    GLsizei width;
-    GLsizei height;
-    GLuint count;
-};
-#endif
+#import "Rendering/Graphics/RXTexturePool.h"
 
 
 @interface RXTextureBroker : NSObject {
     CGLContextObj cgl_ctx;
     BOOL _toreDown;
     
-    struct _rx_texture_bucket* _buckets;
-    uint32_t _bucket_capacity;
-    uint32_t _bucket_count;
+    rx_texture_pool_t* _pool;
+    OSSpinLock _pool_lock;
     
-#if defined(DEBUG)
-    struct _bucket_stat* _bucket_stats;
-    uint32_t _bucket_stat_count;
-#endif
+    // the textures the pool evicted, which are deleted once the pool lock is released
+    GLuint* _evicted_textures;
+    uint32_t _evicted_count;
+    uint32_t _evicted_capacity;
+    uint32_t _leaked_count;
+    
+    // the VRAM the brokered textures may use, from the last free VRAM query, and when that query was made
+    uint64_t _vram_budget;
+    uint64_t _vram_query_time;
 }
 
 + (RXTextureBroker*)sharedTextureBroker;
@@ -48,6 +36,8 @@ struct _bucket_stat {
 - (RXTexture*)newTextureWithSize:(rx_size_t)size;
 - (RXTexture*)newTextureWithWidth:(GLsizei)width height:(GLsizei)height;
 
+- (struct rx_texture_pool_stats)statistics;
+
 - (void)_printDebugStats;
 
 @end
@@ -8,18 +8,25 @@
 
 #import "Rendering/Graphics/RXTextureBroker.h"
 
+#import "Base/RXTiming.h"
+#import "Engine/RXWorldProtocol.h"
+
+
+// the free VRAM the broker leaves to everything else when it sizes its budget
+#define RX_TEXTURE_BROKER_VRAM_RESERVE (32 * 1024 * 1024)
+
+// the free VRAM is queried from the IORegistry, so it is queried at most this often, in seconds
+#define RX_TEXTURE_BROKER_VRAM_QUERY_INTERVAL 1.0
 
 @interface RXBrokeredTexture : RXTexture
 {
 @public
-    struct _rx_texture_bucket* _bucket;
-    uint32_t _bucket_index;
+    uint32_t _slot;
 }
 @end
 
 
 @interface RXTextureBroker (RXTextureBroker_Private)
-- (void)_createBucketWithSize:(rx_size_t)size;
 - (void)_recycleTexture:(RXBrokeredTexture*)texture;
 @end
 
@@ -37,114 +44,70 @@
 
 @implementation RXTextureBroker
 
-static void allocate_texture_bucket(CGLContextObj cgl_ctx, struct _rx_texture_bucket* bucket, GLsizei width, GLsizei height)
-{
-    release_assert(bucket);
-    
-    // initial bucket state
-    bucket->in_use = [RXDynamicBitfield new];
-    bucket->tex_ids = calloc([bucket->in_use segmentCount] * [bucket->in_use segmentBits], sizeof(GLuint));
-    bucket->width = width;
-    bucket->height = height;
-}
-
-static void grow_texture_bucket(struct _rx_texture_bucket* bucket)
+static void queue_evicted_texture(void* context, uint32_t texture)
 {
-    release_assert(bucket);
-    
-    size_t old_size = [bucket->in_use segmentCount] * [bucket->in_use segmentBits] * sizeof(GLuint);
-    size_t new_size = ([bucket->in_use segmentCount] + 1) * [bucket->in_use segmentBits] * sizeof(GLuint);
-    bucket->tex_ids = realloc(bucket->tex_ids, new_size);
-    bzero(BUFFER_OFFSET(bucket->tex_ids, old_size), new_size - old_size);
-
-#if defined(DEBUG)
-    RXLog(kRXLoggingGraphics, kRXLoggingLevelDebug, @"grew texture bucket (%ux%u)", bucket->width, bucket->height);
-#endif
+    // CALLED WITH THE POOL LOCK HELD; if the queue cannot grow, the texture is leaked rather than deleted under the lock
+    RXTextureBroker* broker = (RXTextureBroker*)context;
+    if (broker->_evicted_count == broker->_evicted_capacity)
+    {
+        uint32_t capacity = broker->_evicted_capacity + 0x10;
+        GLuint* textures = realloc(broker->_evicted_textures, capacity * sizeof(GLuint));
+        if (!textures)
+        {
+            broker->_leaked_count++;
+            return;
+        }
+        broker->_evicted_textures = textures;
+        broker->_evicted_capacity = capacity;
+    }
+    broker->_evicted_textures[broker->_evicted_count++] = texture;
 }
 
-static inline void free_texture_bucket(CGLContextObj cgl_ctx, struct _rx_texture_bucket* bucket)
+static GLuint create_texture(CGLContextObj cgl_ctx, GLsizei width, GLsizei height)
 {
-    release_assert(bucket);
-    
     CGLLockContext(cgl_ctx);
-    size_t max_tex = [bucket->in_use segmentCount] * [bucket->in_use segmentBits];
-    for (uintptr_t tex_index = 0; tex_index < max_tex; ++tex_index)
+    
+    // allocate the texture
+    GLuint texture = 0;
+    glGenTextures(1, &texture); glReportError();
+    if (!texture)
     {
-        if (bucket->tex_ids[tex_index])
-            glDeleteTextures(1, bucket->tex_ids + tex_index);
+        CGLUnlockContext(cgl_ctx);
+        return 0;
     }
-    CGLUnlockContext(cgl_ctx);
     
-    free(bucket->tex_ids);
-    [bucket->in_use release];
-}
-
-static inline GLuint find_texture(CGLContextObj cgl_ctx, struct _rx_texture_bucket* bucket, uint32_t *out_index)
-{
-    release_assert(bucket);
+    // get the current TEXTURE_RECTANGLE_ARB texture
+    GLuint rect_tex;
+    glGetIntegerv(GL_TEXTURE_BINDING_RECTANGLE_ARB, (GLint*)&rect_tex); glReportError();
     
-    // if all the bits are set, we need to grow the bucket
-    if ([bucket->in_use isAllSet])
-        grow_texture_bucket(bucket);
+    // bind it to texture rectangle
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, texture); glReportError();
     
-    // find the first available texture
-    size_t max_tex = [bucket->in_use segmentCount] * [bucket->in_use segmentBits];
-    uint32_t tex_index = 0;
-    for (; tex_index < max_tex; ++tex_index)
-    {
-        if (![bucket->in_use isSet:tex_index])
-            break;
-    }
+    // texture parameters
+    glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glReportError();
     
-    if (!bucket->tex_ids[tex_index])
-    {
-        CGLLockContext(cgl_ctx);
-        
-        // allocate the texture
-        glGenTextures(1, bucket->tex_ids + tex_index); glReportError();
-        if (!bucket->tex_ids[tex_index])
-        {
-            CGLUnlockContext(cgl_ctx);
-            return 0;
-        }
-        
-        // get the current TEXTURE_RECTANGLE_ARB texture
-        GLuint rect_tex;
-        glGetIntegerv(GL_TEXTURE_BINDING_RECTANGLE_ARB, (GLint*)&rect_tex); glReportError();
-        
-        // bind it to texture rectangle
-        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, bucket->tex_ids[tex_index]); glReportError();
-        
-        // texture parameters
-        glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glReportError();
-        
-        // disable client storage
-        GLenum client_storage = [RXGetContextState(cgl_ctx) setUnpackClientStorage:GL_FALSE];
-        
-        glTexImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, GL_RGBA8, bucket->width, bucket->height, 0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, NULL); glReportError();
-        
-        // restore the texture binding and unpack client storage
-        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, rect_tex); glReportError();
-        [RXGetContextState(cgl_ctx) setUnpackClientStorage:client_storage];
-        
-        // flush to synchronize the new texture object with the render context
-        glFlush();
-        
-        CGLUnlockContext(cgl_ctx);
-        
+    // disable client storage
+    GLenum client_storage = [RXGetContextState(cgl_ctx) setUnpackClientStorage:GL_FALSE];
+    
+    glTexImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, GL_RGBA8, width, height, 0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, NULL); glReportError();
+    
+    // restore the texture binding and unpack client storage
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, rect_tex); glReportError();
+    [RXGetContextState(cgl_ctx) setUnpackClientStorage:client_storage];
+    
+    // flush to synchronize the new texture object with the render context
+    glFlush();
+    
+    CGLUnlockContext(cgl_ctx);
+
 #if defined(DEBUG)
-        RXLog(kRXLoggingGraphics, kRXLoggingLevelDebug, @"allocated brokered texture %u (%ux%u)", bucket->tex_ids[tex_index], bucket->width, bucket->height);
+    RXLog(kRXLoggingGraphics, kRXLoggingLevelDebug, @"allocated brokered texture %u (%ux%u)", texture, width, height);
 #endif
-    }
-    
-    [bucket->in_use set:tex_index];
-    if (out_index)
-        *out_index = tex_index;
-    return bucket->tex_ids[tex_index];
+    return texture;
 }
 
 + (RXTextureBroker*)sharedTextureBroker
@@ -157,16 +120,65 @@ static inline GLuint find_texture(CGLContextObj cgl_ctx, struct _rx_texture_buck
     return broker;
 }
 
-- (void)_createBucketWithSize:(rx_size_t)size
+- (void)_deleteEvictedTextures
+{
+    // MUST BE CALLED WITHOUT THE POOL LOCK; the queue of evicted textures is taken under the lock, and a new one is
+    // allocated by the next eviction
+    OSSpinLockLock(&_pool_lock);
+    uint32_t count = _evicted_count;
+    GLuint* textures = NULL;
+    if (count)
+    {
+        textures = _evicted_textures;
+        _evicted_textures = NULL;
+        _evicted_count = 0;
+        _evicted_capacity = 0;
+    }
+    OSSpinLockUnlock(&_pool_lock);
+    
+    if (!count)
+        return;
+    
+    CGLLockContext(cgl_ctx);
+    glDeleteTextures(count, textures); glReportError();
+    CGLUnlockContext(cgl_ctx);
+    free(textures);
+
+#if defined(DEBUG)
+    RXOLog2(kRXLoggingGraphics, kRXLoggingLevelDebug, @"deleted %u idle textures", count);
+#endif
+}
+
+- (void)_updateBudget
 {
-    if (_bucket_count == _bucket_capacity)
+    // the budget is the rendering.texture_budget engine variable (in MB), lowered to what the brokered textures and
+    // the free VRAM past a reserve can hold; a free VRAM of 0 means it could not be determined
+    uint64_t budget = (uint64_t)RXEngineGetUInt32(@"rendering.texture_budget") * 1024 * 1024;
+    
+    // between queries, the brokered textures may grow up to what they held at the last query plus the headroom then
+    uint64_t now = RXTimingNow();
+    OSSpinLockLock(&_pool_lock);
+    BOOL query = (_vram_query_time == 0 || RXTimingTimestampDelta(now, _vram_query_time) >= RX_TEXTURE_BROKER_VRAM_QUERY_INTERVAL) ? YES : NO;
+    if (query)
+        _vram_query_time = now;
+    OSSpinLockUnlock(&_pool_lock);
+    
+    ssize_t free_vram = (query) ? [g_worldView currentFreeVRAM] : 0;
+    
+    OSSpinLockLock(&_pool_lock);
+    if (query)
     {
-        _bucket_capacity += 0x10;
-        _buckets = realloc(_buckets, _bucket_capacity * sizeof(struct _rx_texture_bucket));
+        struct rx_texture_pool_stats stats;
+        rx_texture_pool_get_stats(_pool, &stats);
+        uint64_t headroom = (free_vram > RX_TEXTURE_BROKER_VRAM_RESERVE) ? free_vram - RX_TEXTURE_BROKER_VRAM_RESERVE : 0;
+        _vram_budget = (free_vram > 0) ? stats.resident_bytes + headroom : 0;
     }
+    if (_vram_budget)
+        budget = MIN(budget, _vram_budget);
+    rx_texture_pool_set_budget(_pool, budget);
+    OSSpinLockUnlock(&_pool_lock);
     
-    allocate_texture_bucket(cgl_ctx, _buckets + _bucket_count, size.width, size.height);
-    _bucket_count++;
+    [self _deleteEvictedTextures];
 }
 
 - (void)_recycleTexture:(RXBrokeredTexture*)texture
@@ -174,7 +186,14 @@ static inline GLuint find_texture(CGLContextObj cgl_ctx, struct _rx_texture_buck
 #if defined(DEBUG)
     RXOLog2(kRXLoggingGraphics, kRXLoggingLevelDebug, @"recycled texture: %u", texture->texture);
 #endif
-    [texture->_bucket->in_use clear:texture->_bucket_index];
+    if (_toreDown)
+        return;
+    
+    OSSpinLockLock(&_pool_lock);
+    rx_texture_pool_release(_pool, texture->_slot);
+    OSSpinLockUnlock(&_pool_lock);
+    
+    [self _deleteEvictedTextures];
 }
 
 - (id)init
@@ -185,18 +204,15 @@ static inline GLuint find_texture(CGLContextObj cgl_ctx, struct _rx_texture_buck
     
     cgl_ctx = [g_worldView loadContext];
     
-    _buckets = calloc(8, sizeof(struct _rx_texture_bucket));
-    _bucket_capacity = 8;
-    
-    // create a few standard buckets
-    for (int i = 5; i < 10; ++i)
+    _pool_lock = OS_SPINLOCK_INIT;
+    _pool = rx_texture_pool_create(kRXCardViewportSize.width, kRXCardViewportSize.height,
+        (uint64_t)RXEngineGetUInt32(@"rendering.texture_budget") * 1024 * 1024, queue_evicted_texture, self);
+    if (!_pool)
     {
-        for (int j = 5; j < 10; ++j)
-            [self _createBucketWithSize:RXSizeMake(1 << i, 1 << j)];
+        [self release];
+        return nil;
     }
     
-    [self _createBucketWithSize:kRXCardViewportSize];
-    
     return self;
 }
 
@@ -208,35 +224,58 @@ static inline GLuint find_texture(CGLContextObj cgl_ctx, struct _rx_texture_buck
 #if defined(DEBUG)
     RXOLog(@"tearing down");
 #endif
+
+    [self _printDebugStats];
     
-    for (uint32_t bucket_i = 0; bucket_i < _bucket_count; ++bucket_i)
-        free_texture_bucket(cgl_ctx, _buckets + bucket_i);
-    _bucket_count = 0;
+    // delete the idle textures; the textures still in use are not recycled anymore
+    OSSpinLockLock(&_pool_lock);
+    rx_texture_pool_trim(_pool, 0);
+    OSSpinLockUnlock(&_pool_lock);
     
-    [self _printDebugStats];
+    [self _deleteEvictedTextures];
 }
 
 - (void)dealloc
 {
-    [self teardown];
+    if (_pool)
+        [self teardown];
     
-    free(_buckets);
-#if defined(DEBUG)
-    free(_bucket_stats);
-#endif
+    rx_texture_pool_free(_pool);
+    free(_evicted_textures);
     
     [super dealloc];
 }
 
+- (struct rx_texture_pool_stats)statistics
+{
+    struct rx_texture_pool_stats stats;
+    OSSpinLockLock(&_pool_lock);
+    rx_texture_pool_get_stats(_pool, &stats);
+    OSSpinLockUnlock(&_pool_lock);
+    return stats;
+}
+
 - (void)_printDebugStats
 {
-#if defined(DEBUG)
     NSMutableString* statsString = [NSMutableString new];
-    for (GLuint i = 0; i < _bucket_stat_count; ++i)
-        [statsString appendFormat:@"\t%dx%d: %u\n", (int)_bucket_stats[i].width, (int)_bucket_stats[i].height, (unsigned int)_bucket_stats[i].count];
-    RXOLog2(kRXLoggingGraphics, kRXLoggingLevelDebug, @"texture bucket statistics\n%@", statsString);
+    
+    OSSpinLockLock(&_pool_lock);
+    struct rx_texture_pool_stats stats;
+    rx_texture_pool_get_stats(_pool, &stats);
+    uint32_t class_count = rx_texture_pool_class_count(_pool);
+    for (uint32_t i = 0; i < class_count; ++i)
+    {
+        struct rx_texture_pool_class info;
+        if (rx_texture_pool_get_class(_pool, i, &info) && info.requests)
+            [statsString appendFormat:@"\t%ux%u: %llu requests, %llu hits, %u textures (%u idle)\n", info.width, info.height,
+                info.requests, info.hits, info.textures, info.idle_textures];
+    }
+    OSSpinLockUnlock(&_pool_lock);
+    
+    [statsString appendFormat:@"\t%llu hits, %llu misses, %llu evictions, %llu over budget; %llu of %llu granted bytes requested; %llu resident bytes (%llu idle); %u evicted textures leaked",
+        stats.hits, stats.misses, stats.evictions, stats.over_budget, stats.requested_bytes, stats.granted_bytes, stats.resident_bytes, stats.idle_bytes, _leaked_count];
+    RXOLog2(kRXLoggingGraphics, kRXLoggingLevelDebug, @"texture broker statistics\n%@", statsString);
     [statsString release];
-#endif
 }
 
 - (RXTexture*)newTextureWithSize:(rx_size_t)size
@@ -247,78 +286,41 @@ static inline GLuint find_texture(CGLContextObj cgl_ctx, struct _rx_texture_buck
     if (_toreDown)
         return nil;
     
-    // find the right bucket
-    struct _rx_texture_bucket* bucket = NULL;
+    // get a slot from the pool, with an idle texture of the size class of the request if there is one
+    struct rx_texture_grant grant;
+    OSSpinLockLock(&_pool_lock);
+    rx_texture_pool_acquire(_pool, size.width, size.height, &grant);
+    OSSpinLockUnlock(&_pool_lock);
     
-    // this quick index calculation if possbile because of the way the buckets
-    // were created in the initializer
-    int i = MAX(0, (int)ceilf(log2f(size.width)) - 5);
-    int j = MAX(0, (int)ceilf(log2f(size.height)) - 5);
-    int32_t bucket_i = MIN((i * 5) + j, 5 * 5);
+    // the pool may have evicted idle textures to make room for a new one
+    [self _deleteEvictedTextures];
     
-    for (; bucket_i < (int32_t)_bucket_count; ++bucket_i)
-    {
-        bucket = _buckets + bucket_i;
-        if (bucket->width >= size.width && bucket->height >= size.height)
-            break;
-    }
-    
-    // if we don't have a bucket for that size, create a custom-fit one
-    if (bucket_i == (int32_t)_bucket_count)
-    {
-        [self _createBucketWithSize:size];
-        bucket = &_buckets[_bucket_count - 1];
-    }
-    
-    // if we don't have a bucket at this point, give up
-    if (!bucket)
-        return nil;
-    
-    // try to allocate a texture out of the bucket
-    uint32_t bucket_index;
-    GLuint texid = find_texture(cgl_ctx, bucket, &bucket_index);
+    GLuint texid = grant.texture;
     if (texid == 0)
     {
-        // texture allocation failed, return nil
-        return nil;
-    }
-    
-    RXBrokeredTexture* texture = [[RXBrokeredTexture alloc] initWithID:texid target:GL_TEXTURE_RECTANGLE_ARB size:size deleteWhenDone:NO];
-    texture->_bucket = bucket;
-    texture->_bucket_index = bucket_index;
+        texid = create_texture(cgl_ctx, grant.width, grant.height);
     
-#if defined(DEBUG)
-    if (_bucket_stat_count == 0)
-    {
-        _bucket_stats = malloc(sizeof(struct _bucket_stat));
-        _bucket_stat_count = 1;
-        _bucket_stats[0].width = bucket->width;
-        _bucket_stats[0].height = bucket->height;
-        _bucket_stats[0].count = 0;
-    }
+        OSSpinLockLock(&_pool_lock);
+        if (texid)
+            rx_texture_pool_attach(_pool, grant.slot, texid);
+        else
+            rx_texture_pool_discard(_pool, grant.slot);
+        OSSpinLockUnlock(&_pool_lock);
     
-    uint32_t stat_i = 0;
-    for (; stat_i < _bucket_stat_count; ++stat_i)
-    {
-        if (_bucket_stats[stat_i].width == bucket->width && _bucket_stats[stat_i].height == bucket->height) {
-            _bucket_stats[stat_i].count++;
-            break;
-        }
-    }
+        // texture allocation failed, return nil
+        if (texid == 0)
+            return nil;
     
-    if (stat_i == _bucket_stat_count)
-    {
-        _bucket_stat_count++;
-        _bucket_stats = realloc(_bucket_stats, _bucket_stat_count * sizeof(struct _bucket_stat));
-        _bucket_stats[stat_i].width = bucket->width;
-        _bucket_stats[stat_i].height = bucket->height;
-        _bucket_stats[stat_i].count = 1;
+        // the new texture took some of the free VRAM
+        [self _updateBudget];
     }
-#endif
     
+    RXBrokeredTexture* texture = [[RXBrokeredTexture alloc] initWithID:texid target:GL_TEXTURE_RECTANGLE_ARB size:size deleteWhenDone:NO];
+    texture->_slot = grant.slot;
+
 #if defined(DEBUG)
-    RXOLog2(kRXLoggingGraphics, kRXLoggingLevelDebug, @"reserved texture: %u [size=%ux%u] from <%ux%u> bucket [index=%u]",
-        texid, size.width, size.height, bucket->width, bucket->height, bucket_index);
+    RXOLog2(kRXLoggingGraphics, kRXLoggingLevelDebug, @"reserved texture: %u [size=%ux%u] from <%ux%u> class [slot=%u]",
+        texid, size.width, size.height, grant.width, grant.height, grant.slot);
 #endif
     return texture;
 }
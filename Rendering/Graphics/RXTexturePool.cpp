@@ -0,0 +1,293 @@
+//
+//  RXTexturePool.cpp
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 05/11/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#include <string.h>
+
+#include <algorithm>
+#include <list>
+#include <new>
+#include <vector>
+
+#include "Rendering/Graphics/RXTexturePool.h"
+
+
+namespace {
+
+const uint16_t kMinimumClassSide = 32;
+const uint16_t kMaximumClassSide = 512;
+
+inline uint64_t texture_bytes(uint16_t width, uint16_t height) {return static_cast<uint64_t>(width) * height * 4;}
+
+inline uint16_t round_up_pow2(uint16_t side) {
+    uint16_t rounded = kMinimumClassSide;
+    while (rounded < side)
+        rounded <<= 1;
+    return rounded;
+}
+
+struct Class {
+    uint16_t width;
+    uint16_t height;
+    bool custom;
+    bool active;
+    uint32_t textures;
+    uint64_t requests;
+    uint64_t hits;
+
+    // the idle slots of the class, most recently released last
+    std::vector<uint32_t> idle;
+};
+
+struct Slot {
+    uint32_t texture;
+    uint32_t klass;
+
+    // position in the pool's LRU list while idle
+    std::list<uint32_t>::iterator lru;
+};
+
+} // namespace
+
+struct rx_texture_pool {
+    uint16_t card_width;
+    uint16_t card_height;
+    rx_texture_pool_evict_handler_t handler;
+    void* context;
+
+    std::vector<Class> classes;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+
+    // the idle slots, least recently released first
+    std::list<uint32_t> lru;
+
+    rx_texture_pool_stats stats;
+};
+
+namespace {
+
+uint32_t find_class(rx_texture_pool* pool, uint16_t width, uint16_t height) {
+    uint32_t inactive = static_cast<uint32_t>(pool->classes.size());
+    for (uint32_t i = 0; i < pool->classes.size(); i++) {
+        Class& c = pool->classes[i];
+        if (c.active && c.width == width && c.height == height)
+            return i;
+        if (!c.active && inactive == pool->classes.size())
+            inactive = i;
+    }
+
+    // a custom class, which reuses the entry of one that went away
+    if (inactive == pool->classes.size())
+        pool->classes.push_back(Class());
+    Class& c = pool->classes[inactive];
+    c.width = width;
+    c.height = height;
+    c.custom = true;
+    c.active = true;
+    c.textures = 0;
+    c.requests = 0;
+    c.hits = 0;
+    c.idle.clear();
+    pool->stats.classes++;
+    return inactive;
+}
+
+void release_slot(rx_texture_pool* pool, uint32_t slot) {
+    Slot& s = pool->slots[slot];
+    Class& c = pool->classes[s.klass];
+    pool->stats.resident_bytes -= texture_bytes(c.width, c.height);
+    pool->stats.resident_textures--;
+    c.textures--;
+    if (c.custom && c.textures == 0) {
+        c.active = false;
+        pool->stats.classes--;
+    }
+
+    pool->free_slots.push_back(slot);
+}
+
+void evict_lru(rx_texture_pool* pool) {
+    uint32_t slot = pool->lru.front();
+    pool->lru.pop_front();
+
+    Slot& s = pool->slots[slot];
+    Class& c = pool->classes[s.klass];
+    c.idle.erase(std::find(c.idle.begin(), c.idle.end(), slot));
+    pool->stats.idle_bytes -= texture_bytes(c.width, c.height);
+    pool->stats.evictions++;
+
+    uint32_t texture = s.texture;
+    release_slot(pool, slot);
+    pool->handler(pool->context, texture);
+}
+
+void enforce_budget(rx_texture_pool* pool, uint64_t incoming_bytes) {
+    while (!pool->lru.empty() && pool->stats.resident_bytes + incoming_bytes > pool->stats.budget)
+        evict_lru(pool);
+}
+
+} // namespace
+
+rx_texture_pool_t* rx_texture_pool_create(uint16_t card_width, uint16_t card_height, uint64_t budget,
+                                          rx_texture_pool_evict_handler_t handler, void* context)
+{
+    rx_texture_pool* pool = new (std::nothrow) rx_texture_pool;
+    if (!pool)
+        return NULL;
+    pool->card_width = card_width;
+    pool->card_height = card_height;
+    pool->handler = handler;
+    pool->context = context;
+    memset(&pool->stats, 0, sizeof(pool->stats));
+    pool->stats.budget = budget;
+
+    // the standard classes, which stay for the life of the pool
+    for (uint16_t width = kMinimumClassSide; width <= kMaximumClassSide; width <<= 1) {
+        for (uint16_t height = kMinimumClassSide; height <= kMaximumClassSide; height <<= 1)
+            pool->classes[find_class(pool, width, height)].custom = false;
+    }
+    pool->classes[find_class(pool, card_width, card_height)].custom = false;
+
+    return pool;
+}
+
+void rx_texture_pool_free(rx_texture_pool_t* pool)
+{
+    delete pool;
+}
+
+void rx_texture_pool_size_class(const rx_texture_pool_t* pool, uint16_t width, uint16_t height, uint16_t* class_width,
+                                uint16_t* class_height)
+{
+    if (width <= kMaximumClassSide && height <= kMaximumClassSide) {
+        *class_width = round_up_pow2(width);
+        *class_height = round_up_pow2(height);
+    } else if (width <= pool->card_width && height <= pool->card_height) {
+        *class_width = pool->card_width;
+        *class_height = pool->card_height;
+    } else {
+        *class_width = width;
+        *class_height = height;
+    }
+}
+
+void rx_texture_pool_set_budget(rx_texture_pool_t* pool, uint64_t budget)
+{
+    pool->stats.budget = budget;
+    enforce_budget(pool, 0);
+}
+
+void rx_texture_pool_acquire(rx_texture_pool_t* pool, uint16_t width, uint16_t height, struct rx_texture_grant* grant)
+{
+    uint16_t class_width, class_height;
+    rx_texture_pool_size_class(pool, width, height, &class_width, &class_height);
+    uint32_t klass = find_class(pool, class_width, class_height);
+    uint64_t bytes = texture_bytes(class_width, class_height);
+
+    pool->stats.requested_bytes += texture_bytes(width, height);
+    pool->stats.granted_bytes += bytes;
+    pool->classes[klass].requests++;
+
+    grant->width = class_width;
+    grant->height = class_height;
+
+    Class& c = pool->classes[klass];
+    if (!c.idle.empty()) {
+        uint32_t slot = c.idle.back();
+        c.idle.pop_back();
+
+        Slot& s = pool->slots[slot];
+        pool->lru.erase(s.lru);
+
+        pool->stats.idle_bytes -= bytes;
+        pool->stats.hits++;
+        c.hits++;
+
+        grant->slot = slot;
+        grant->texture = s.texture;
+        return;
+    }
+
+    // make room for the new texture; evicting idle textures never takes away the class, which is not empty once the
+    // slot is taken
+    pool->stats.misses++;
+    c.textures++;
+    enforce_budget(pool, bytes);
+    if (pool->stats.resident_bytes + bytes > pool->stats.budget)
+        pool->stats.over_budget++;
+
+    uint32_t slot;
+    if (!pool->free_slots.empty()) {
+        slot = pool->free_slots.back();
+        pool->free_slots.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(pool->slots.size());
+        pool->slots.push_back(Slot());
+    }
+
+    Slot& s = pool->slots[slot];
+    s.texture = 0;
+    s.klass = klass;
+
+    pool->stats.resident_bytes += bytes;
+    pool->stats.resident_textures++;
+
+    grant->slot = slot;
+    grant->texture = 0;
+}
+
+void rx_texture_pool_attach(rx_texture_pool_t* pool, uint32_t slot, uint32_t texture)
+{
+    pool->slots[slot].texture = texture;
+}
+
+void rx_texture_pool_discard(rx_texture_pool_t* pool, uint32_t slot)
+{
+    release_slot(pool, slot);
+}
+
+void rx_texture_pool_release(rx_texture_pool_t* pool, uint32_t slot)
+{
+    Slot& s = pool->slots[slot];
+    Class& c = pool->classes[s.klass];
+    s.lru = pool->lru.insert(pool->lru.end(), slot);
+    c.idle.push_back(slot);
+    pool->stats.idle_bytes += texture_bytes(c.width, c.height);
+
+    enforce_budget(pool, 0);
+}
+
+void rx_texture_pool_trim(rx_texture_pool_t* pool, uint64_t idle_bytes)
+{
+    while (!pool->lru.empty() && pool->stats.idle_bytes > idle_bytes)
+        evict_lru(pool);
+}
+
+void rx_texture_pool_get_stats(const rx_texture_pool_t* pool, struct rx_texture_pool_stats* stats)
+{
+    *stats = pool->stats;
+}
+
+uint32_t rx_texture_pool_class_count(const rx_texture_pool_t* pool)
+{
+    return static_cast<uint32_t>(pool->classes.size());
+}
+
+bool rx_texture_pool_get_class(const rx_texture_pool_t* pool, uint32_t index, struct rx_texture_pool_class* info)
+{
+    if (index >= pool->classes.size() || !pool->classes[index].active)
+        return false;
+    const Class& c = pool->classes[index];
+    info->width = c.width;
+    info->height = c.height;
+    info->requests = c.requests;
+    info->hits = c.hits;
+    info->textures = c.textures;
+    info->idle_textures = static_cast<uint32_t>(c.idle.size());
+    return true;
+}
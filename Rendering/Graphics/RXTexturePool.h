@@ -0,0 +1,97 @@
+//
+//  RXTexturePool.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 05/11/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#if !defined(RX_TEXTURE_POOL_H)
+#define RX_TEXTURE_POOL_H
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// The texture pool is the allocation policy of the texture broker, without any GL. Requests are rounded up to a size
+// class: powers of two from 32 to 512 on each side, the card viewport, or the exact size of larger requests, which get
+// a custom class that goes away with its last texture. A request is served by the most recently released idle texture
+// of its class, or by a new texture that the caller creates and attaches to the slot it was granted.
+//
+// The pool keeps the bytes of its textures within a budget by evicting idle textures, least recently released first;
+// evicted textures are handed to the eviction handler, which deletes them. Textures in use are never evicted, so a
+// request is still granted when nothing idle is left to evict, and is counted as over budget.
+//
+// The pool is not thread-safe.
+//
+
+__BEGIN_DECLS
+
+// receives the textures the pool evicts
+typedef void (*rx_texture_pool_evict_handler_t)(void* context, uint32_t texture);
+
+struct rx_texture_grant {
+    uint32_t slot;
+    uint16_t width;     // the size of the texture, which is the size of the class of the request
+    uint16_t height;
+    uint32_t texture;   // the idle texture that serves the request, or 0 if a new texture must be attached to the slot
+};
+
+struct rx_texture_pool_stats {
+    uint64_t hits;              // requests served by an idle texture
+    uint64_t misses;            // requests that needed a new texture
+    uint64_t evictions;
+    uint64_t over_budget;       // new textures that did not fit in the budget
+    uint64_t requested_bytes;   // the bytes of every request
+    uint64_t granted_bytes;     // the bytes of the textures that served them; the difference is rounding waste
+    uint64_t budget;
+    uint64_t resident_bytes;
+    uint64_t idle_bytes;
+    uint32_t resident_textures;
+    uint32_t classes;
+};
+
+struct rx_texture_pool_class {
+    uint16_t width;
+    uint16_t height;
+    uint64_t requests;
+    uint64_t hits;
+    uint32_t textures;
+    uint32_t idle_textures;
+};
+
+typedef struct rx_texture_pool rx_texture_pool_t;
+
+rx_texture_pool_t* rx_texture_pool_create(uint16_t card_width, uint16_t card_height, uint64_t budget,
+                                          rx_texture_pool_evict_handler_t handler, void* context);
+void rx_texture_pool_free(rx_texture_pool_t* pool);
+
+// rounds a request up to its size class
+void rx_texture_pool_size_class(const rx_texture_pool_t* pool, uint16_t width, uint16_t height, uint16_t* class_width,
+                                uint16_t* class_height);
+
+// evicts idle textures until the pool fits in the budget
+void rx_texture_pool_set_budget(rx_texture_pool_t* pool, uint64_t budget);
+
+void rx_texture_pool_acquire(rx_texture_pool_t* pool, uint16_t width, uint16_t height, struct rx_texture_grant* grant);
+
+// attaches the texture created for a grant without one, or gives the slot back if the texture could not be created
+void rx_texture_pool_attach(rx_texture_pool_t* pool, uint32_t slot, uint32_t texture);
+void rx_texture_pool_discard(rx_texture_pool_t* pool, uint32_t slot);
+
+// makes the texture of a slot idle, and evicts it right away if the pool is over budget
+void rx_texture_pool_release(rx_texture_pool_t* pool, uint32_t slot);
+
+// evicts idle textures, least recently released first, until at most idle_bytes of them are left
+void rx_texture_pool_trim(rx_texture_pool_t* pool, uint64_t idle_bytes);
+
+void rx_texture_pool_get_stats(const rx_texture_pool_t* pool, struct rx_texture_pool_stats* stats);
+
+// the size classes, for reports; returns false past the last class, and for a custom class that went away
+uint32_t rx_texture_pool_class_count(const rx_texture_pool_t* pool);
+bool rx_texture_pool_get_class(const rx_texture_pool_t* pool, uint32_t index, struct rx_texture_pool_class* info);
+
+__END_DECLS
+
+#endif // RX_TEXTURE_POOL_H
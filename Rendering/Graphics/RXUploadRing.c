@@ -0,0 +1,164 @@
+/*
+ *  RXUploadRing.c
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 07/11/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Rendering/Graphics/RXUploadRing.h"
+
+
+enum slot_state {
+    SLOT_FREE = 0,
+    SLOT_WRITING,
+    SLOT_IN_FLIGHT,
+};
+
+struct upload_slot {
+    enum slot_state state;
+    uint64_t sequence;      // the order in which the slots in flight were submitted
+};
+
+struct rx_upload_ring {
+    struct upload_slot* slots;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    uint32_t next;
+    uint64_t sequence;
+
+    rx_upload_ring_fence_test_t test;
+    void* context;
+
+    struct rx_upload_ring_stats stats;
+    uint64_t frame_upload_bytes;
+    uint32_t frame_fence_waits;
+};
+
+static void take_slot(rx_upload_ring_t* ring, uint32_t index, uint32_t* slot)
+{
+    if (ring->slots[index].state == SLOT_IN_FLIGHT)
+        ring->stats.slots_in_flight--;
+    ring->slots[index].state = SLOT_WRITING;
+    ring->next = (index + 1) % ring->slot_count;
+    *slot = index;
+}
+
+#pragma mark -
+
+rx_upload_ring_t* rx_upload_ring_create(uint32_t slot_count, uint32_t slot_size, rx_upload_ring_fence_test_t test, void* context)
+{
+    if (slot_count == 0)
+        return NULL;
+
+    rx_upload_ring_t* ring = (rx_upload_ring_t*)calloc(1, sizeof(rx_upload_ring_t));
+    if (!ring)
+        return NULL;
+    ring->slots = (struct upload_slot*)calloc(slot_count, sizeof(struct upload_slot));
+    if (!ring->slots)
+    {
+        free(ring);
+        return NULL;
+    }
+
+    ring->slot_count = slot_count;
+    ring->slot_size = slot_size;
+    ring->test = test;
+    ring->context = context;
+    return ring;
+}
+
+void rx_upload_ring_free(rx_upload_ring_t* ring)
+{
+    if (!ring)
+        return;
+    free(ring->slots);
+    free(ring);
+}
+
+uint32_t rx_upload_ring_slot_count(const rx_upload_ring_t* ring)
+{
+    return ring->slot_count;
+}
+
+uint32_t rx_upload_ring_slot_size(const rx_upload_ring_t* ring)
+{
+    return ring->slot_size;
+}
+
+rx_upload_slot_status_t rx_upload_ring_acquire(rx_upload_ring_t* ring, uint32_t size, uint32_t* slot)
+{
+    *slot = RX_UPLOAD_RING_NO_SLOT;
+    if (size > ring->slot_size)
+    {
+        ring->stats.unbuffered_uploads++;
+        return RX_UPLOAD_SLOT_NONE;
+    }
+
+    // the next free slot in turn, or the next slot in flight whose upload is done
+    uint32_t oldest = RX_UPLOAD_RING_NO_SLOT;
+    for (uint32_t i = 0; i < ring->slot_count; i++)
+    {
+        uint32_t index = (ring->next + i) % ring->slot_count;
+        struct upload_slot* s = ring->slots + index;
+        if (s->state == SLOT_FREE || (s->state == SLOT_IN_FLIGHT && ring->test(ring->context, index)))
+        {
+            take_slot(ring, index, slot);
+            return RX_UPLOAD_SLOT_READY;
+        }
+        if (s->state == SLOT_IN_FLIGHT && (oldest == RX_UPLOAD_RING_NO_SLOT || s->sequence < ring->slots[oldest].sequence))
+            oldest = index;
+    }
+
+    // every slot is being written
+    if (oldest == RX_UPLOAD_RING_NO_SLOT)
+    {
+        ring->stats.unbuffered_uploads++;
+        return RX_UPLOAD_SLOT_NONE;
+    }
+
+    // the oldest upload is the most likely to be done
+    ring->stats.fence_waits++;
+    ring->frame_fence_waits++;
+    take_slot(ring, oldest, slot);
+    return RX_UPLOAD_SLOT_IN_FLIGHT;
+}
+
+void rx_upload_ring_submit(rx_upload_ring_t* ring, uint32_t slot, uint32_t bytes)
+{
+    ring->stats.uploads++;
+    ring->stats.upload_bytes += bytes;
+    ring->frame_upload_bytes += bytes;
+
+    if (slot == RX_UPLOAD_RING_NO_SLOT)
+        return;
+    ring->slots[slot].state = SLOT_IN_FLIGHT;
+    ring->slots[slot].sequence = ++ring->sequence;
+    ring->stats.slots_in_flight++;
+}
+
+void rx_upload_ring_cancel(rx_upload_ring_t* ring, uint32_t slot)
+{
+    if (slot != RX_UPLOAD_RING_NO_SLOT)
+        ring->slots[slot].state = SLOT_FREE;
+}
+
+void rx_upload_ring_end_frame(rx_upload_ring_t* ring)
+{
+    ring->stats.frames++;
+    ring->stats.last_frame_upload_bytes = ring->frame_upload_bytes;
+    ring->stats.last_frame_fence_waits = ring->frame_fence_waits;
+    if (ring->frame_upload_bytes > ring->stats.peak_frame_upload_bytes)
+        ring->stats.peak_frame_upload_bytes = ring->frame_upload_bytes;
+    ring->frame_upload_bytes = 0;
+    ring->frame_fence_waits = 0;
+}
+
+void rx_upload_ring_get_stats(const rx_upload_ring_t* ring, struct rx_upload_ring_stats* stats)
+{
+    memcpy(stats, &ring->stats, sizeof(struct rx_upload_ring_stats));
+}
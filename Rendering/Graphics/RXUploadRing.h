@@ -0,0 +1,80 @@
+/*
+ *  RXUploadRing.h
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 07/11/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#if !defined(RX_UPLOAD_RING_H)
+#define RX_UPLOAD_RING_H
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// The upload ring hands out the slots of a ring of pixel unpack buffers, so that a picture can be decoded into one
+// slot while the GPU still reads the pictures uploaded from the others. A slot is free, being written, or in flight
+// from the time its upload is submitted until the fence the caller set after the upload has passed.
+//
+// Slots are handed out in turn. A slot in flight is reused as soon as its fence tests as passed; when every slot that
+// is not being written is still in flight, the oldest is handed out and the caller must finish its fence before
+// writing to it, which is counted as a fence wait. When every slot is being written, or a picture does not fit in a
+// slot, no slot is handed out and the caller uploads the picture from client memory.
+//
+// The ring is not thread-safe.
+//
+
+__BEGIN_DECLS
+
+// tells if the GPU is done with the upload of a slot in flight
+typedef bool (*rx_upload_ring_fence_test_t)(void* context, uint32_t slot);
+
+// the slot of an upload from client memory
+#define RX_UPLOAD_RING_NO_SLOT UINT32_MAX
+
+typedef enum {
+    RX_UPLOAD_SLOT_NONE = 0,    // no slot was handed out
+    RX_UPLOAD_SLOT_READY,       // the slot can be written
+    RX_UPLOAD_SLOT_IN_FLIGHT,   // the fence of the slot must be finished before the slot is written
+} rx_upload_slot_status_t;
+
+struct rx_upload_ring_stats {
+    uint64_t uploads;
+    uint64_t upload_bytes;
+    uint64_t unbuffered_uploads;        // uploads that did not get a slot
+    uint64_t fence_waits;
+    uint64_t frames;
+    uint64_t last_frame_upload_bytes;
+    uint64_t peak_frame_upload_bytes;
+    uint32_t last_frame_fence_waits;
+    uint32_t slots_in_flight;
+};
+
+typedef struct rx_upload_ring rx_upload_ring_t;
+
+rx_upload_ring_t* rx_upload_ring_create(uint32_t slot_count, uint32_t slot_size, rx_upload_ring_fence_test_t test, void* context);
+void rx_upload_ring_free(rx_upload_ring_t* ring);
+
+uint32_t rx_upload_ring_slot_count(const rx_upload_ring_t* ring);
+uint32_t rx_upload_ring_slot_size(const rx_upload_ring_t* ring);
+
+rx_upload_slot_status_t rx_upload_ring_acquire(rx_upload_ring_t* ring, uint32_t size, uint32_t* slot);
+
+// puts a slot in flight once its upload and fence are issued; an upload from client memory is submitted with
+// RX_UPLOAD_RING_NO_SLOT so that its bytes are counted
+void rx_upload_ring_submit(rx_upload_ring_t* ring, uint32_t slot, uint32_t bytes);
+
+// gives back a slot that was not uploaded from; the fence of a slot handed out in flight must be finished first
+void rx_upload_ring_cancel(rx_upload_ring_t* ring, uint32_t slot);
+
+// closes the per-frame counters
+void rx_upload_ring_end_frame(rx_upload_ring_t* ring);
+
+void rx_upload_ring_get_stats(const rx_upload_ring_t* ring, struct rx_upload_ring_stats* stats);
+
+__END_DECLS
+
+#endif // RX_UPLOAD_RING_H
@@ -17,6 +17,7 @@
 #import "Engine/RXWorldProtocol.h"
 
 #import "Rendering/Graphics/GL/GLShaderProgramManager.h"
+#import "Rendering/Graphics/RXTexture.h"
 
 #import <AppKit/NSApplication.h>
 #import <AppKit/NSOpenGL.h>
@@ -1313,6 +1314,9 @@ major_number.minor_number major_number.minor_number.release_number
     // glFlush and swap the front and back buffers
     CGLFlushDrawable(cgl_ctx); glReportError();
     
+    // the textures uploaded from now on count toward the next frame
+    [RXTexture endUploadFrame];
+    
     // finally call down to the card renderer one last time to let it take post-flush actions
     if (_cardRenderer.target)
         _cardRenderer.flush.imp(_cardRenderer.target, _cardRenderer.flush.sel, outputTime);
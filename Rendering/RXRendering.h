@@ -64,6 +64,7 @@ typedef struct rx_event rx_event_t;
 struct rx_card_sfxe {
     struct rx_sfxe_record* record;
     uint32_t* offsets;
+    struct rx_water_program* water;
 };
 typedef struct rx_card_sfxe rx_card_sfxe;
 
@@ -9,7 +9,7 @@
 #import "Engine/RXWorld.h"
 
 #import "Rendering/Audio/RXAudioRenderer.h"
-#import "Rendering/Graphics/RXDynamicPicture.h"
+#import "Rendering/Graphics/RXTexture.h"
 #import "Rendering/Graphics/RXWorldView.h"
 #import "Rendering/Graphics/RXWindow.h"
 #import "Rendering/Graphics/GL/GLShaderProgramManager.h"
@@ -361,8 +361,8 @@
     // initialize the shader manager
     [GLShaderProgramManager sharedManager];
     
-    // initialize the dynamic picture unpack buffer
-    [RXDynamicPicture sharedDynamicPictureUnpackBuffer];
+    // initialize the texture upload ring
+    [RXTexture initializeUploadRing];
     
     // initialize the card renderer
     _cardRenderer = [[RXCardState alloc] init];
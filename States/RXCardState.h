@@ -16,9 +16,12 @@
 #import "States/RXRenderState.h"
 
 #import "Engine/RXCard.h"
+#import "Engine/RXCardCache.h"
+#import "Engine/RXCardPreloader.h"
 #import "Engine/RXStack.h"
 #import "Engine/RXScriptEngine.h"
 
+#import "Rendering/Graphics/RXCompositor.h"
 #import "Rendering/Graphics/RXTransition.h"
 #import "Rendering/Animation/RXInterpolator.h"
 
@@ -50,6 +53,8 @@ struct rx_transition_program {
 
 @interface RXCardState : RXRenderState <RXScriptEngineControllerProtocol> {
     RXScriptEngine* sengine;
+    RXCardPreloader* _preloader;
+    RXCardCache* _card_cache;
     
     // render state
     void* _render_states_buffer;
@@ -83,6 +88,7 @@ struct rx_transition_program {
     NSTimer* _activeSourceUpdateTimer;
     OSSpinLock _audioTaskThreadStatusLock;
     semaphore_t _audioTaskThreadExitSemaphore;
+    semaphore_t _audioTaskThreadWakeSemaphore;
     
     BOOL _forceFadeInOnNextSoundGroup;
     
@@ -104,10 +110,28 @@ struct rx_transition_program {
     
     GLuint _fbos[1];
     GLuint _textures[1];
+    
+    // the pictures of the last composition of the dynamic RT, one per compositor layer
+    rx_compositor_t* _compositor;
+    NSMutableArray* _composited_pictures;
+    struct rx_compositor_stats _composite_stats;
+    OSSpinLock _composite_stats_lock;
+    
     void* _water_draw_buffer;
     void* _water_readback_buffer;
     BOOL _water_sfx_disabled;
     
+    // water special effect on the GPU: the static picture, the effect image and its FBO, and the span quads
+    GLuint _water_textures[2];
+    GLuint _water_fbo;
+    GLuint _water_vao;
+    GLuint _water_vbo;
+    struct rx_water_program* _water_quads_program;
+    BOOL _water_on_gpu;
+    
+    // the composition the copies of the static picture were last taken at, or 0
+    uint64_t _water_static_composition;
+    
     GLuint _card_program;
     GLint _modulate_color_uniform;
     
@@ -120,7 +144,8 @@ struct rx_transition_program {
     // inventory
     id<RXInterpolator> _inventory_position_interpolators[3];
     id<RXInterpolator> _inventory_alpha_interpolators[3];
-    GLuint _inventory_textures[3];
+    GLuint _inventory_texture;
+    GLint _inventory_texture_x[3];
     rx_size_t _inventory_sizes[3];
     CGRect _inventory_frames[3];
     NSRect _inventory_hotspot_frames[3];
@@ -143,6 +168,9 @@ struct rx_transition_program {
 }
 
 - (RXScriptEngine*)scriptEngine;
+- (RXCardPreloader*)cardPreloader;
+- (RXCardCache*)cardCache;
+- (struct rx_compositor_stats)compositorStatistics;
 
 - (void)setActiveCardWithStack:(NSString*)stackKey ID:(uint16_t)cardID waitUntilDone:(BOOL)wait;
 - (void)clearActiveCardWaitingUntilDone:(BOOL)wait;
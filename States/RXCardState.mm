@@ -16,10 +16,13 @@
 #import "Engine/RXHardwareProfiler.h"
 #import "Engine/RXHotspot.h"
 #import "Engine/RXArchiveManager.h"
+#import "Engine/RXWaterProgram.h"
 
 #import "Rendering/Audio/RXCardAudioSource.h"
+#import "Rendering/Audio/RXSoundGroupTransition.h"
 #import "Rendering/Graphics/GL/GLShaderProgramManager.h"
 #import "Rendering/Graphics/RXMovieProxy.h"
+#import "Rendering/Graphics/RXDynamicPicture.h"
 
 #import "Application/RXApplicationDelegate.h"
 
@@ -120,14 +123,6 @@ static CFArrayCallBacks g_deleteOnReleaseAudioSourceArrayCallbacks = {
 #pragma mark -
 #pragma mark audio array applier functions
 
-static void RXCardAudioSourceFadeInApplier(const void* value, void* context)
-{
-    RX::AudioRenderer* renderer = reinterpret_cast<RX::AudioRenderer*>(context);
-    RX::CardAudioSource* source = const_cast<RX::CardAudioSource*>(reinterpret_cast<const RX::CardAudioSource*>(value));
-    renderer->SetSourceGain(*source, 0.0f);
-    renderer->RampSourceGain(*source, source->NominalGain(), RX_AUDIO_GAIN_RAMP_DURATION);
-}
-
 static void RXCardAudioSourceEnableApplier(const void* value, void* context)
 {
     RX::CardAudioSource* source = const_cast<RX::CardAudioSource*>(reinterpret_cast<const RX::CardAudioSource*>(value));
@@ -229,11 +224,29 @@ static void rx_release_owner_applier(const void* value, void* context)
     
     _transitionQueue = [NSMutableArray new];
     
+    _card_cache = [RXCardCache new];
+    if (!_card_cache)
+        goto init_failure;
+    
+    _preloader = [[RXCardPreloader alloc] initWithCardCache:_card_cache];
+    if (!_preloader)
+        goto init_failure;
+    
+    _compositor = rx_compositor_create(kRXCardViewportSize.width, kRXCardViewportSize.height);
+    if (!_compositor)
+        goto init_failure;
+    _composited_pictures = [NSMutableArray new];
+    _composite_stats_lock = OS_SPINLOCK_INIT;
+    
     kern_return_t kerr;
     kerr = semaphore_create(mach_task_self(), &_audioTaskThreadExitSemaphore, SYNC_POLICY_FIFO, 0);
     if (kerr != 0)
         goto init_failure;
     
+    kerr = semaphore_create(mach_task_self(), &_audioTaskThreadWakeSemaphore, SYNC_POLICY_FIFO, 0);
+    if (kerr != 0)
+        goto init_failure;
+    
     kerr = semaphore_create(mach_task_self(), &_transitionSemaphore, SYNC_POLICY_FIFO, 0);
     if (kerr != 0)
         goto init_failure;
@@ -288,6 +301,8 @@ init_failure:
         semaphore_destroy(mach_task_self(), _transitionSemaphore);
     if (_audioTaskThreadExitSemaphore)
         semaphore_destroy(mach_task_self(), _audioTaskThreadExitSemaphore);
+    if (_audioTaskThreadWakeSemaphore)
+        semaphore_destroy(mach_task_self(), _audioTaskThreadWakeSemaphore);
     
     [_transitionQueue release];
     
@@ -309,6 +324,13 @@ init_failure:
     
     [sengine release];
     
+    [_preloader tearDown];
+    [_preloader release];
+    [_card_cache release];
+    
+    rx_compositor_free(_compositor);
+    [_composited_pictures release];
+    
     [super dealloc];
 }
 
@@ -317,6 +339,24 @@ init_failure:
     return sengine;
 }
 
+- (RXCardPreloader*)cardPreloader
+{
+    return _preloader;
+}
+
+- (RXCardCache*)cardCache
+{
+    return _card_cache;
+}
+
+- (struct rx_compositor_stats)compositorStatistics
+{
+    OSSpinLockLock(&_composite_stats_lock);
+    struct rx_compositor_stats stats = _composite_stats;
+    OSSpinLockUnlock(&_composite_stats_lock);
+    return stats;
+}
+
 #pragma mark -
 #pragma mark rendering initialization
 
@@ -403,6 +443,53 @@ init_failure:
     _water_draw_buffer = malloc((kRXCardViewportSize.width * kRXCardViewportSize.height) << 3);
     _water_readback_buffer = BUFFER_OFFSET(_water_draw_buffer, (kRXCardViewportSize.width * kRXCardViewportSize.height) << 2);
     
+    // the GPU water effect keeps a copy of the static picture, and draws the spans of every frame from that copy into
+    // its own image, which is then copied into the dynamic RT
+    glGenTextures(2, _water_textures); glReportError();
+    for (GLuint i = 0; i < 2; i++)
+    {
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, _water_textures[i]); glReportError();
+        glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glReportError();
+        
+        glTexImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, GL_RGBA8, kRXCardViewportSize.width, kRXCardViewportSize.height, 0,
+            GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, NULL); glReportError();
+    }
+    
+    glGenFramebuffersEXT(1, &_water_fbo); glReportError();
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, _water_fbo); glReportError();
+    glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_RECTANGLE_ARB, _water_textures[1], 0); glReportError();
+    
+    // the effect falls back to the CPU if the FBO cannot be used
+    GLenum water_fbo_status = glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT);
+    if (water_fbo_status != GL_FRAMEBUFFER_COMPLETE_EXT)
+    {
+        RXOLog2(kRXLoggingGraphics, kRXLoggingLevelError, @"water FBO not complete, status 0x%04x\n", (unsigned int)water_fbo_status);
+        glDeleteFramebuffersEXT(1, &_water_fbo);
+        _water_fbo = 0;
+    }
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0); glReportError();
+    
+    // the span quads of the active effect are uploaded in a VBO when the effect starts; see _renderCardWithTimestamp
+    glGenVertexArraysAPPLE(1, &_water_vao); glReportError();
+    [gl_state bindVertexArrayObject:_water_vao];
+    
+    glGenBuffers(1, &_water_vbo); glReportError();
+    glBindBuffer(GL_ARRAY_BUFFER, _water_vbo); glReportError();
+    
+    glEnableVertexAttribArray(RX_ATTRIB_POSITION);
+    glVertexAttribPointer(RX_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, RX_WATER_VERTEX_FLOATS * sizeof(GLfloat), NULL);
+    glReportError();
+    
+    glEnableVertexAttribArray(RX_ATTRIB_TEXCOORD0);
+    glVertexAttribPointer(RX_ATTRIB_TEXCOORD0, 2, GL_FLOAT, GL_FALSE, RX_WATER_VERTEX_FLOATS * sizeof(GLfloat), BUFFER_OFFSET(NULL, 2 * sizeof(GLfloat)));
+    glReportError();
+    
+    glBindBuffer(GL_ARRAY_BUFFER, 0); glReportError();
+    
 // inventory textures and interpolators
     
     // get a reference to the extra bitmaps archive, and get the inventory texture descriptors
@@ -614,29 +701,41 @@ init_failure:
     _hotspotDebugRenderElementCountArray = new GLint[RX_MAX_RENDER_HOTSPOT + RX_MAX_INVENTORY_ITEMS];
 #endif
     
-// alright, we've done all the work we could, let's now make those inventory textures
+// alright, we've done all the work we could, let's now make the inventory texture
     
-    // re-bind the inventory unpack buffer
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, inventory_unpack_buffer); glReportError();
+    // the items are packed side by side in a single texture, a pixel apart, so that drawing the inventory binds one texture
+    GLsizei inventory_texture_width = 0;
+    GLsizei inventory_texture_height = 1;
+    for (GLuint inventory_i = 0; inventory_i < RX_MAX_INVENTORY_ITEMS; inventory_i++)
+    {
+        _inventory_texture_x[inventory_i] = inventory_texture_width;
+        inventory_texture_width += _inventory_sizes[inventory_i].width + 1;
+        inventory_texture_height = MAX(inventory_texture_height, (GLsizei)_inventory_sizes[inventory_i].height);
+    }
     
-    // create the textures and reset inventoryBuffer which we'll use as a buffer offset
-    glGenTextures(RX_MAX_INVENTORY_ITEMS, _inventory_textures);
+    // allocate the texture before binding the unpack buffer, since a NULL pointer is an offset in a bound unpack buffer
+    glGenTextures(1, &_inventory_texture);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, _inventory_texture); glReportError();
+    
+    glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glReportError();
+    
+    glTexImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, GL_RGBA8, inventory_texture_width, inventory_texture_height, 0, GL_BGRA,
+        GL_UNSIGNED_INT_8_8_8_8_REV, NULL); glReportError();
+    
+    // re-bind the inventory unpack buffer and reset inventoryBuffer which we'll use as a buffer offset
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, inventory_unpack_buffer); glReportError();
     inventoryBuffer = 0;
     
-    // decompress the textures into the buffer
+    // upload each item in its region of the texture
     for (GLuint inventory_i = 0; inventory_i < RX_MAX_INVENTORY_ITEMS; inventory_i++)
     {
-        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, _inventory_textures[inventory_i]); glReportError();
-        
-        glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glReportError();
-
-        glTexImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, GL_RGBA8,
+        glTexSubImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, _inventory_texture_x[inventory_i], 0,
             _inventory_sizes[inventory_i].width, _inventory_sizes[inventory_i].height,
-            0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, inventoryBuffer); glReportError();
+            GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, inventoryBuffer); glReportError();
         
         inventoryBuffer = BUFFER_OFFSET(inventoryBuffer, (uint32_t)(_inventory_sizes[inventory_i].width * _inventory_sizes[inventory_i].height) << 2);
     }
@@ -811,87 +910,144 @@ init_failure:
     // cache the sound group's sound set
     NSSet* soundGroupSounds = [soundGroup sounds];
     
+    // configure the decoded sound cache from the engine variables; a budget of 0 disables it
+    RX::DecodedSoundCache* decodedSoundCache = NULL;
+    uint32_t decodedSoundCacheBudget = RXEngineGetUInt32(@"rendering.audio_cache_budget");
+    if (decodedSoundCacheBudget)
+    {
+        decodedSoundCache = &RX::DecodedSoundCache::SharedCache();
+        decodedSoundCache->SetBudget(decodedSoundCacheBudget * 1024 * 1024);
+        decodedSoundCache->SetMaximumDuration(RXEngineGetUInt32(@"rendering.audio_cache_max_duration"));
+    }
+    else
+        RX::DecodedSoundCache::SharedCache().SetBudget(0);
+    
 #if defined(DEBUG)
     RXOLog2(kRXLoggingAudio, kRXLoggingLevelDebug, @"activating sound group %@ with sounds: %@", soundGroup, soundGroupSounds);
 #endif
     
+    // diff the active sounds against the new group
+    RXSoundGroupTransition* transition = [[RXSoundGroupTransition alloc] initWithActiveSounds:_activeSounds
+                                                                                    soundGroup:soundGroup
+                                                                                   forceFadeIn:_forceFadeInOnNextSoundGroup];
+    
+#if defined(DEBUG) && DEBUG > 1
+    RXOLog2(kRXLoggingAudio, kRXLoggingLevelDebug, @"    transition: %@", transition);
+#endif
+    
     // create an array of new sources
     CFMutableArrayRef sourcesToAdd = CFArrayCreateMutable(NULL, 0, &g_weakAudioSourceArrayCallbacks);
     
-    // copy the active sound set to prepare the new active sound set
-    NSMutableSet* newActiveSounds = [_activeSounds mutableCopy];
+    // start from the planned set of active sounds; sounds that fail to get a source are taken back out
+    NSMutableSet* newActiveSounds = [[transition activeSounds] mutableCopy];
     
     // the set of sounds to remove is the set of active sounds minus the incoming sound group's set of sounds
-    NSMutableSet* soundsToRemove = [_activeSounds mutableCopy];
-    [soundsToRemove minusSet:soundGroupSounds];
+    NSMutableSet* soundsToRemove = [[transition removedSounds] mutableCopy];
     
-    // process new and updated sounds
-    NSEnumerator* soundEnum = [soundGroupSounds objectEnumerator];
+    // NEW SOUNDS
+    NSEnumerator* soundEnum = [[transition addedSounds] objectEnumerator];
     RXSound* sound;
     while ((sound = [soundEnum nextObject]))
     {
-        RXSound* active_sound = [_activeSounds member:sound];
-
-        // NEW SOUND
-        if (!active_sound)
+        // get a decompressor
+        id <MHKAudioDecompression> decompressor = [sound audioDecompressor];
+        if (!decompressor)
         {
-            // get a decompressor
-            id <MHKAudioDecompression> decompressor = [sound audioDecompressor];
-            if (!decompressor)
+            RXOLog2(kRXLoggingAudio, kRXLoggingLevelError, @"failed to get audio decompressor for sound ID %hu", sound->twav_id);
+            [newActiveSounds removeObject:sound];
+            continue;
+        }
+        
+        // short ambient sounds come back on many cards, so play them from the decoded sound cache once they have been
+        // decoded; a sound that misses is streamed and queued for decoding on the audio task thread with a
+        // decompressor of its own
+        RX::DecodedSound* decoded = NULL;
+        if (decodedSoundCache)
+        {
+            std::string stackKey([[sound->parent key] UTF8String]);
+            bool decode;
+            decoded = decodedSoundCache->Acquire(stackKey, sound->twav_id, decompressor, &decode);
+            if (decode)
             {
-                RXOLog2(kRXLoggingAudio, kRXLoggingLevelError, @"failed to get audio decompressor for sound ID %hu", sound->twav_id);
-                continue;
+                decodedSoundCache->Decode(stackKey, sound->twav_id, [sound->parent audioDecompressorWithID:sound->twav_id]);
+                semaphore_signal(_audioTaskThreadWakeSemaphore);
             }
-            
-            // create an audio source with the decompressor
+        }
+        if (decoded)
+        {
+            sound->source = new RX::CardAudioSource(decoded, sound->gain * soundGroup->gain, sound->pan, soundGroup->loop);
+            decoded->Release();
+        }
+        else
             sound->source = new RX::CardAudioSource(decompressor, sound->gain * soundGroup->gain, sound->pan, soundGroup->loop);
-            release_assert(sound->source);
-            
-            // make sure the sound doesn't have a valid detach timestamp
-            sound->detach_timestamp = 0;
-            
-            // add the sound to the new set of active sounds
-            [newActiveSounds addObject:sound];
-            
-            // prepare the sourcesToAdd array
-            CFArrayAppendValue(sourcesToAdd, sound->source);
-            
+        release_assert(sound->source);
+        sound->source->SetTaskSemaphore(_audioTaskThreadWakeSemaphore);
+        
+        // make sure the sound doesn't have a valid detach timestamp
+        sound->detach_timestamp = 0;
+        
+        // prepare the sourcesToAdd array
+        CFArrayAppendValue(sourcesToAdd, sound->source);
+        
 #if defined(DEBUG) && DEBUG > 1
-            RXOLog2(kRXLoggingAudio, kRXLoggingLevelDebug, @"    added new sound %hu to the active mix (source: %p)", sound->twav_id, sound->source);
+        RXOLog2(kRXLoggingAudio, kRXLoggingLevelDebug, @"    added new sound %hu to the active mix (source: %p)", sound->twav_id, sound->source);
 #endif
+    }
+    
+    // CONTINUING SOUNDS: keep the live source and collect the parameter ramps, which are all submitted in one batch
+    // with the fade ins and fade outs below
+    CFMutableArrayRef gainRampSources = CFArrayCreateMutable(NULL, 0, &g_weakAudioSourceArrayCallbacks);
+    std::vector<Float32> gainRampValues;
+    std::vector<Float64> gainRampDurations;
+    
+    CFMutableArrayRef panRampSources = CFArrayCreateMutable(NULL, 0, &g_weakAudioSourceArrayCallbacks);
+    std::vector<Float32> panRampValues;
+    std::vector<Float64> panRampDurations;
+    
+    NSArray* continuingSounds = [transition continuingSounds];
+    NSUInteger continuingCount = [continuingSounds count];
+    for (NSUInteger continuingIndex = 0; continuingIndex < continuingCount; continuingIndex++)
+    {
+        RXSound* active_sound = [continuingSounds objectAtIndex:continuingIndex];
+        RXSound* incoming_sound = [[soundGroup sounds] member:active_sound];
+        release_assert(active_sound->source);
+        
+        // update the sound's gain and pan (this does not affect the source)
+        active_sound->gain = incoming_sound->gain;
+        active_sound->pan = incoming_sound->pan;
+        
+        // make sure the sound doesn't have a valid detach timestamp
+        active_sound->detach_timestamp = 0;
+        
+        // set source looping
+        active_sound->source->SetLooping(soundGroup->loop);
+        
+        // update the source's gain and stereo panning smoothly, if they change
+        if ([transition gainChangedForContinuingSoundAtIndex:continuingIndex])
+        {
+            Float32 target_gain = [transition targetGainForContinuingSoundAtIndex:continuingIndex];
+            CFArrayAppendValue(gainRampSources, active_sound->source);
+            gainRampValues.push_back(target_gain);
+            gainRampDurations.push_back(RX_AUDIO_GAIN_RAMP_DURATION);
+            active_sound->source->SetNominalGain(target_gain);
         }
-
-        // UPDATE SOUND
-        else
+        
+        if ([transition panChangedForContinuingSoundAtIndex:continuingIndex])
         {
-            release_assert(active_sound->source);
-            
-            // update the sound's gain and pan (this does not affect the source)
-            active_sound->gain = sound->gain;
-            active_sound->pan = sound->pan;
-            
-            // make sure the sound doesn't have a valid detach timestamp
-            active_sound->detach_timestamp = 0;
-            
-            // set source looping
-            active_sound->source->SetLooping(soundGroup->loop);
-            
-            // update the source's gain smoothly
-            renderer->RampSourceGain(*(active_sound->source), active_sound->gain * soundGroup->gain, RX_AUDIO_GAIN_RAMP_DURATION);
-            active_sound->source->SetNominalGain(active_sound->gain * soundGroup->gain);
-            
-            // update the source's stereo panning smoothly
-            renderer->RampSourcePan(*(active_sound->source), active_sound->pan, RX_AUDIO_PAN_RAMP_DURATION);
-            active_sound->source->SetNominalPan(active_sound->pan);
-            
+            Float32 target_pan = [transition targetPanForContinuingSoundAtIndex:continuingIndex];
+            CFArrayAppendValue(panRampSources, active_sound->source);
+            panRampValues.push_back(target_pan);
+            panRampDurations.push_back(RX_AUDIO_PAN_RAMP_DURATION);
+            active_sound->source->SetNominalPan(target_pan);
+        }
+        
 #if defined(DEBUG) && DEBUG > 1
-            RXOLog2(kRXLoggingAudio, kRXLoggingLevelDebug, @"    updated sound %hu in the active mix (source: %p)", sound->twav_id, sound->source);
+        RXOLog2(kRXLoggingAudio, kRXLoggingLevelDebug, @"    continuing sound %hu in the active mix (source: %p)", active_sound->twav_id, active_sound->source);
 #endif
-        }
     }
     
     // if no fade out is requested, set the detach timestamp of sounds not already scheduled for detach to now
-    if (!soundGroup->fadeOutRemovedSounds)
+    if (!transition->fadeOutRemovedSounds)
     {
         soundEnum = [soundsToRemove objectEnumerator];
         while ((sound = [soundEnum nextObject]))
@@ -920,19 +1076,53 @@ init_failure:
     [soundsToRemove intersectSet:_activeSounds];
     
     // now that any sources bound to be detached has been, go ahead and attach as many of the new sources as possible
-    if (soundGroup->fadeInNewSounds || _forceFadeInOnNextSoundGroup)
+    CFRange everything = CFRangeMake(0, CFArrayGetCount(sourcesToAdd));
+    if (transition->fadeInNewSounds)
     {
         // disabling the sources will prevent the fade in from starting before we update the graph
-        CFRange everything = CFRangeMake(0, CFArrayGetCount(sourcesToAdd));
         CFArrayApplyFunction(sourcesToAdd, everything, RXCardAudioSourceDisableApplier, [g_world audioRenderer]);
         renderer->AttachSources(sourcesToAdd);
-        CFArrayApplyFunction(sourcesToAdd, everything, RXCardAudioSourceFadeInApplier, [g_world audioRenderer]);
+        
+        // start the new sources silent and ramp them up to their nominal gain with the other gain changes
+        renderer->RampSourcesGain(sourcesToAdd, 0.0f, 0.0);
+        for (CFIndex sourceIndex = 0; sourceIndex < everything.length; sourceIndex++)
+        {
+            RX::CardAudioSource* source = const_cast<RX::CardAudioSource*>(reinterpret_cast<const RX::CardAudioSource*>(CFArrayGetValueAtIndex(sourcesToAdd, sourceIndex)));
+            CFArrayAppendValue(gainRampSources, source);
+            gainRampValues.push_back(source->NominalGain());
+            gainRampDurations.push_back(RX_AUDIO_GAIN_RAMP_DURATION);
+        }
     }
     else
     {
         renderer->AttachSources(sourcesToAdd);
     }
     
+    // schedule a fade out ramp for all to-be-removed sources if the fade out flag is on
+    if (transition->fadeOutRemovedSounds)
+    {
+        // the detach timestamp for those sources is now + the ramp duration + some comfort offset
+        uint64_t detach_timestamp = RXTimingOffsetTimestamp(RXTimingNow(), RX_AUDIO_GAIN_RAMP_DURATION + 0.5);
+        
+        soundEnum = [soundsToRemove objectEnumerator];
+        while ((sound = [soundEnum nextObject]))
+        {
+            release_assert(sound->source);
+            CFArrayAppendValue(gainRampSources, sound->source);
+            gainRampValues.push_back(0.0f);
+            gainRampDurations.push_back(RX_AUDIO_GAIN_RAMP_DURATION);
+            sound->detach_timestamp = detach_timestamp;
+        }
+    }
+    
+    // submit every gain and pan change of the transition to the mixer at once
+    if (CFArrayGetCount(gainRampSources) > 0)
+        renderer->RampSourcesGain(gainRampSources, gainRampValues, gainRampDurations);
+    if (CFArrayGetCount(panRampSources) > 0)
+        renderer->RampSourcesPan(panRampSources, panRampValues, panRampDurations);
+    CFRelease(gainRampSources);
+    CFRelease(panRampSources);
+    
     // re-enable automatic updates; this will automatically do an update if one is needed
     renderer->SetAutomaticGraphUpdates(true);
     
@@ -944,27 +1134,8 @@ init_failure:
     }
     
     // enable all the new audio sources
-    if (soundGroup->fadeInNewSounds || _forceFadeInOnNextSoundGroup)
-    {
-        CFRange everything = CFRangeMake(0, CFArrayGetCount(sourcesToAdd));
+    if (transition->fadeInNewSounds)
         CFArrayApplyFunction(sourcesToAdd, everything, RXCardAudioSourceEnableApplier, [g_world audioRenderer]);
-    }
-    
-    // schedule a fade out ramp for all to-be-removed sources if the fade out flag is on
-    if (soundGroup->fadeOutRemovedSounds)
-    {
-        CFMutableArrayRef sourcesToRemove = [self _newSourceArrayFromSoundSet:soundsToRemove callbacks:&g_weakAudioSourceArrayCallbacks];
-        renderer->RampSourcesGain(sourcesToRemove, 0.0f, RX_AUDIO_GAIN_RAMP_DURATION);
-        CFRelease(sourcesToRemove);
-        
-        // the detach timestamp for those sources is now + the ramp duration + some comfort offset
-        uint64_t detach_timestamp = RXTimingOffsetTimestamp(RXTimingNow(), RX_AUDIO_GAIN_RAMP_DURATION + 0.5);
-        
-        NSEnumerator* soundEnum = [soundsToRemove objectEnumerator];
-        RXSound* sound;
-        while ((sound = [soundEnum nextObject]))
-            sound->detach_timestamp = detach_timestamp;
-    }
     
 #if defined(DEBUG) && DEBUG > 1
     RXOLog2(kRXLoggingAudio, kRXLoggingLevelDebug, @"new active sound set: %@", newActiveSounds);
@@ -976,8 +1147,9 @@ init_failure:
     // done with sourcesToAdd
     CFRelease(sourcesToAdd);
     
-    // done with the sound sets
+    // done with the sound sets and the transition
     [soundsToRemove release];
+    [transition release];
 }
 
 - (void)playDataSound:(RXDataSound*)sound
@@ -1005,6 +1177,7 @@ init_failure:
         // create an audio source with the decompressor
         sound->source = new RX::CardAudioSource(decompressor, sound->gain, sound->pan, false);
         release_assert(sound->source);
+        sound->source->SetTaskSemaphore(_audioTaskThreadWakeSemaphore);
         
         // make sure the sound doesn't have a valid detach timestamp
         sound->detach_timestamp = 0;
@@ -1094,6 +1267,9 @@ init_failure:
                       (thread_policy_t)&precedencePolicy,
                       THREAD_PRECEDENCE_POLICY_COUNT);
     
+    // sources signal the wake semaphore when they drop below their low watermark; the timeout is only a safety net
+    mach_timespec_t wait_time = {1, 0};
+    
     uint32_t cycles = 0;
     while (1)
     {
@@ -1104,6 +1280,9 @@ init_failure:
         
         OSSpinLockUnlock(&_audioTaskThreadStatusLock);
         
+        // decode a slice of the sounds queued for the decoded sound cache; while some remain, only poll the semaphore
+        bool decoding = RX::DecodedSoundCache::SharedCache().Task();
+        
         // recycle the pool every 500 cycles
         cycles++;
         if (cycles > 500)
@@ -1114,8 +1293,14 @@ init_failure:
             p = [NSAutoreleasePool new];
         }
         
-        // sleep 1 second until the next cycle
-        sleep(1);
+        // wait until a source needs decoding
+        if (decoding)
+        {
+            mach_timespec_t no_wait = {0, 0};
+            semaphore_timedwait(_audioTaskThreadWakeSemaphore, no_wait);
+        }
+        else
+            semaphore_timedwait(_audioTaskThreadWakeSemaphore, wait_time);
     }
     
     // pop the autorelease pool
@@ -1443,6 +1628,7 @@ init_failure:
                                        reason:@"_switchCardWithSimpleDescriptor: MUST RUN ON SCRIPT THREAD"
                                      userInfo:nil];
     
+    uint64_t switch_start = RXTimingNow();
     RXCard* new_card = nil;
     
     // because this method will always execute in the script thread, we do not have to protect access to the front card
@@ -1475,14 +1661,26 @@ init_failure:
             return;
         }
         
-        // FIXME: need to be smarter about card loading (cache, locality, etc)
-        // load the new card in
-        RXCardDescriptor* cd = [[RXCardDescriptor alloc] initWithStack:stack ID:scd->cardID];
-        if (!cd)
-            @throw [NSException exceptionWithName:NSInvalidArgumentException reason:@"COULD NOT FIND CARD IN STACK" userInfo:nil]; 
+        // use the card if the player has been there recently or if it has been preloaded, otherwise load the new card in
+        new_card = [_card_cache newCardWithSimpleDescriptor:scd];
+        if (new_card)
+            [_preloader dropCardWithSimpleDescriptor:scd];
+        else
+            new_card = [_preloader newCardWithSimpleDescriptor:scd];
+        if (!new_card)
+        {
+            RXCardDescriptor* cd = [[RXCardDescriptor alloc] initWithStack:stack ID:scd->cardID];
+            if (!cd)
+                @throw [NSException exceptionWithName:NSInvalidArgumentException reason:@"COULD NOT FIND CARD IN STACK" userInfo:nil]; 
+            
+            new_card = [[RXCard alloc] initWithCardDescriptor:cd];
+            [cd release];
+            
+            // the open card script would load the card; load it here so that its neighbors can be preloaded right away
+            [new_card load];
+        }
         
-        new_card = [[RXCard alloc] initWithCardDescriptor:cd];
-        [cd release];
+        [_preloader recordCardSwitchLatency:RXTimingTimestampDelta(RXTimingNow(), switch_start)];
         
 #if (DEBUG)
         RXOLog2(kRXLoggingEngine, kRXLoggingLevelDebug, @"switch card: {from=%@, to=%@}", _front_render_state->card, new_card);
@@ -1490,6 +1688,13 @@ init_failure:
 
         // run the close card script on the old card
         [sengine closeCard];
+        
+        // keep the old card around in case the player comes back to it
+        if (front_card)
+            [_card_cache addCard:front_card];
+        
+        // preload the neighbors once the old card is in the cache, so that going back is not preloaded as well
+        [_preloader preloadNeighborsOfCard:new_card];
     }
     
     // if the back state's new_card field is YES, we are performing a switch card before we ran a single
@@ -1589,6 +1794,97 @@ init_failure:
 #pragma mark -
 #pragma mark graphics rendering
 
+- (void)_renderPictures:(id*)pictures count:(uint32_t)count outputTime:(const CVTimeStamp*)outputTime inContext:(CGLContextObj)cgl_ctx
+{
+    // WARNING: MUST RUN IN THE CORE VIDEO RENDER THREAD
+    
+    // consecutive dynamic pictures that share a texture object, such as the pictures of an atlas page, are drawn together
+    Class dynamic_picture_class = [RXDynamicPicture class];
+    uint32_t i = 0;
+    while (i < count)
+    {
+        uint32_t run = 1;
+        if ([pictures[i] isKindOfClass:dynamic_picture_class])
+        {
+            GLuint texture = [(RXPicture*)pictures[i] texture]->texture;
+            while (i + run < count && [pictures[i + run] isKindOfClass:dynamic_picture_class] &&
+                   [(RXPicture*)pictures[i + run] texture]->texture == texture)
+                run++;
+        }
+        
+        if (run > 1)
+            [RXDynamicPicture renderPictures:(RXDynamicPicture**)pictures + i count:run inContext:cgl_ctx];
+        else
+            [pictures[i] render:outputTime inContext:cgl_ctx framebuffer:_fbos[RX_CARD_DYNAMIC_RENDER_INDEX]];
+        i += run;
+    }
+}
+
+- (BOOL)_composePictures:(NSArray*)pictures outputTime:(const CVTimeStamp*)outputTime inContext:(CGLContextObj)cgl_ctx
+    composition:(struct rx_composition*)composition
+{
+    // WARNING: MUST RUN IN THE CORE VIDEO RENDER THREAD
+    
+    // describe the pictures to the compositor, unless one of them cannot say where it draws
+    uint32_t picture_count = [pictures count];
+    struct rx_composite_layer* layers = (struct rx_composite_layer*)malloc(MAX(picture_count, 1U) * sizeof(struct rx_composite_layer));
+    BOOL composable = (layers && RXEngineGetBool(@"rendering.dirty_compositing")) ? YES : NO;
+    for (uint32_t i = 0; i < picture_count && composable; i++)
+        composable = [[pictures objectAtIndex:i] getCompositeLayer:layers + i];
+    
+    if (!composable || !rx_compositor_compose(_compositor, layers, picture_count, composition))
+    {
+        free(layers);
+        
+        // paint every picture over the dynamic RT
+        rx_compositor_invalidate(_compositor);
+        [_composited_pictures removeAllObjects];
+        
+        id* batch = (id*)malloc(MAX(picture_count, 1U) * sizeof(id));
+        [pictures getObjects:batch range:NSMakeRange(0, picture_count)];
+        [self _renderPictures:batch count:picture_count outputTime:outputTime inContext:cgl_ctx];
+        free(batch);
+        return NO;
+    }
+    free(layers);
+    
+    // the composited pictures are retained until they leave the composition, so that their textures cannot be reused
+    // for other pictures while the compositor compares against them
+    if (composition->appended)
+        [_composited_pictures addObjectsFromArray:pictures];
+    else
+        [_composited_pictures setArray:[pictures subarrayWithRange:NSMakeRange(composition->first_layer, picture_count - composition->first_layer)]];
+    release_assert([_composited_pictures count] == _compositor->layer_count);
+    
+    // the pictures to draw for each damage rect, in order
+    id* batch = (id*)malloc(MAX(_compositor->layer_count, 1U) * sizeof(id));
+    
+    // redraw the damage with the pictures that intersect it; rows in the dynamic RT are card rows
+    glEnable(GL_SCISSOR_TEST);
+    for (uint32_t d = 0; d < composition->damage.count; d++)
+    {
+        rx_core_rect_t damage = composition->damage.rects[d];
+        glScissor(damage.left, damage.top, damage.right - damage.left, damage.bottom - damage.top);
+        uint32_t batch_count = 0;
+        for (uint32_t i = 0; i < _compositor->layer_count; i++)
+        {
+            if (rx_core_rect_intersection(_compositor->layers[i].rect, damage, NULL))
+                batch[batch_count++] = [_composited_pictures objectAtIndex:i];
+        }
+        [self _renderPictures:batch count:batch_count outputTime:outputTime inContext:cgl_ctx];
+    }
+    free(batch);
+    
+    // disable the scissor test (Riven X assumption)
+    glDisable(GL_SCISSOR_TEST);
+    
+    OSSpinLockLock(&_composite_stats_lock);
+    _composite_stats = _compositor->stats;
+    OSSpinLockUnlock(&_composite_stats_lock);
+    
+    return YES;
+}
+
 - (void)_renderCardWithTimestamp:(const CVTimeStamp*)outputTime inContext:(CGLContextObj)cgl_ctx
 {
     // WARNING: MUST RUN IN THE CORE VIDEO RENDER THREAD
@@ -1611,68 +1907,150 @@ init_failure:
     glTranslatef(0.f, kRXCardViewportSize.height, 0.f);
     glScalef(1.0f, -1.0f, 1.0f);
     
-    // render static card pictures only when necessary
+    // render static card pictures only when necessary, redrawing only what changed since the last composition
+    struct rx_composition composition;
+    BOOL composited = NO;
     if (r->refresh_static)
-    {
-        // render each picture
-        renderListEnumerator = [r->pictures objectEnumerator];
-        while ((renderObject = [renderListEnumerator nextObject]))
-            [renderObject render:outputTime inContext:cgl_ctx framebuffer:_fbos[RX_CARD_DYNAMIC_RENDER_INDEX]];
-    }
+        composited = [self _composePictures:r->pictures outputTime:outputTime inContext:cgl_ctx composition:&composition];
     
-    if (r->water_fx.sfxe && !_water_sfx_disabled)
+    rx_water_program_t* water = (r->water_fx.sfxe) ? r->water_fx.sfxe->water : NULL;
+    if (water && !_water_sfx_disabled)
     {
-        // if we refreshed pictures, we need to reset the special effect and copy the RT back to main memory
+        // if we refreshed pictures, we need to reset the special effect and keep a copy of the static picture
         if (r->refresh_static)
         {
             r->water_fx.current_frame = 0;
             r->water_fx.frame_timestamp = 0;
             
-            // we need to immediately readback the dynamic RT into the water readback buffer and copy the content into the water draw buffer
-            glFlush();
-            glReadPixels(0, 0, kRXCardViewportSize.width, kRXCardViewportSize.height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, _water_readback_buffer);
-            glReportError();
-
-            memcpy(_water_draw_buffer, _water_readback_buffer, kRXCardViewportSize.width * kRXCardViewportSize.height << 2);
+            // the copies of the static picture are only stale in the damage of the composition if they were taken at
+            // the last composition, since the effect and the movies only draw in damaged rects
+            BOOL water_on_gpu = (_water_fbo && RXEngineGetBool(@"rendering.water_on_gpu")) ? YES : NO;
+            rx_damage_t stale;
+            if (composited && composition.incremental && water_on_gpu == _water_on_gpu && _water_static_composition &&
+                _water_static_composition + 1 == _compositor->stats.compositions)
+                stale = composition.damage;
+            else
+            {
+                rx_core_rect_t card_rect = {0, 0, kRXCardViewportSize.width, kRXCardViewportSize.height};
+                rx_damage_clear(&stale);
+                rx_damage_add(&stale, card_rect);
+            }
+            _water_on_gpu = water_on_gpu;
+            _water_static_composition = (composited) ? _compositor->stats.compositions : 0;
+            
+            if (_water_on_gpu)
+            {
+                // copy the dynamic RT into the static picture and effect image textures, without leaving the GPU
+                for (uint32_t d = 0; d < stale.count; d++)
+                {
+                    rx_core_rect_t rect = stale.rects[d];
+                    for (int i = 0; i < 2; i++)
+                    {
+                        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, _water_textures[i]); glReportError();
+                        glCopyTexSubImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, rect.left, rect.top, rect.left, rect.top,
+                            rect.right - rect.left, rect.bottom - rect.top); glReportError();
+                    }
+                }
+                
+                // the effect may be a new one, even if its program is at the address of the last one
+                _water_quads_program = NULL;
+            }
+            else
+            {
+                // we need to immediately readback the dynamic RT into the water readback buffer and copy the content into the water draw buffer
+                glFlush();
+                glPixelStorei(GL_PACK_ROW_LENGTH, kRXCardViewportSize.width); glReportError();
+                for (uint32_t d = 0; d < stale.count; d++)
+                {
+                    rx_core_rect_t rect = stale.rects[d];
+                    glReadPixels(rect.left, rect.top, rect.right - rect.left, rect.bottom - rect.top, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,
+                        (uint32_t*)_water_readback_buffer + rect.top * kRXCardViewportSize.width + rect.left); glReportError();
+                }
+                glPixelStorei(GL_PACK_ROW_LENGTH, 0); glReportError();
+                
+                for (uint32_t d = 0; d < stale.count; d++)
+                {
+                    rx_core_rect_t rect = stale.rects[d];
+                    for (uint32_t row = rect.top; row < rect.bottom; row++)
+                    {
+                        size_t offset = row * kRXCardViewportSize.width + rect.left;
+                        memcpy((uint32_t*)_water_draw_buffer + offset, (uint32_t*)_water_readback_buffer + offset, (rect.right - rect.left) << 2);
+                    }
+                }
+            }
+        }
+        
+        // upload the span quads of every frame of the effect once, when the effect starts
+        if (_water_on_gpu && _water_quads_program != water)
+        {
+            GLsizeiptr quads_size = water->span_count * RX_WATER_QUAD_VERTICES * RX_WATER_VERTEX_FLOATS * sizeof(GLfloat);
+            glBindBuffer(GL_ARRAY_BUFFER, _water_vbo); glReportError();
+            glBufferData(GL_ARRAY_BUFFER, quads_size, NULL, GL_STATIC_DRAW); glReportError();
+            if (quads_size)
+            {
+                GLfloat* quads = (GLfloat*)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY); glReportError();
+                rx_water_program_write_quads(water, quads);
+                glUnmapBuffer(GL_ARRAY_BUFFER); glReportError();
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0); glReportError();
+            _water_quads_program = water;
         }
         
         // if the special effect frame timestamp is 0 or expired, update the special effect texture
         double fps_inverse = 1.0 / r->water_fx.sfxe->record->fps;
         if (r->water_fx.frame_timestamp == 0 || RXTimingTimestampDelta(outputTime->hostTime, r->water_fx.frame_timestamp) >= fps_inverse)
         {
-            // run the water microprogram for the current sfxe frame
-            union {
-                uint16_t* p_int16;
-                void* p_void;
-            } mp;
-            mp.p_void = BUFFER_OFFSET(r->water_fx.sfxe->record, r->water_fx.sfxe->offsets[r->water_fx.current_frame]);
-            
-            uint16_t draw_row = r->water_fx.sfxe->record->rect.top;
-            while (*mp.p_int16 != 4)
+            uint16_t frame = r->water_fx.current_frame;
+            const rx_core_rect_t* dirty = &water->frames[frame].dirty;
+            BOOL frame_is_empty = (dirty->right <= dirty->left || dirty->bottom <= dirty->top) ? YES : NO;
+            if (_water_on_gpu)
             {
-                if (*mp.p_int16 == 1)
-                {
-                    draw_row++;
-                }
-                else if (*mp.p_int16 == 3)
+                // draw the spans of the frame from the static picture into the effect image; the spans are in texture
+                // rows, so the y axis is not flipped
+                glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, _water_fbo); glReportError();
+                glPushMatrix();
+                glLoadIdentity();
+                
+                glActiveTexture(GL_TEXTURE0); glReportError();
+                glBindTexture(GL_TEXTURE_RECTANGLE_ARB, _water_textures[0]); glReportError();
+                [RXGetContextState(cgl_ctx) bindVertexArrayObject:_water_vao];
+                glDrawArrays(GL_QUADS, water->frames[frame].first_span * RX_WATER_QUAD_VERTICES,
+                    water->frames[frame].span_count * RX_WATER_QUAD_VERTICES); glReportError();
+                
+                glPopMatrix();
+                
+                // copy the part of the effect image the frame changed into the dynamic RT, with the water FBO as the
+                // read framebuffer
+                if (!frame_is_empty)
                 {
-                    memcpy(BUFFER_OFFSET(_water_draw_buffer, (draw_row * kRXCardViewportSize.width + mp.p_int16[1]) << 2),
-                           BUFFER_OFFSET(_water_readback_buffer, (mp.p_int16[3] * kRXCardViewportSize.width + mp.p_int16[2]) << 2),
-                           mp.p_int16[4] << 2);
-                    mp.p_int16 += 4;
+                    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, _textures[RX_CARD_DYNAMIC_RENDER_INDEX]); glReportError();
+                    glCopyTexSubImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, dirty->left, dirty->top, dirty->left, dirty->top,
+                        dirty->right - dirty->left, dirty->bottom - dirty->top); glReportError();
                 }
-                else
+                
+                glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, _fbos[RX_CARD_DYNAMIC_RENDER_INDEX]); glReportError();
+            }
+            else
+            {
+                // copy the runs of the current sfxe frame
+                rx_water_program_apply(water, frame, (const uint32_t*)_water_readback_buffer, (uint32_t*)_water_draw_buffer);
+                
+                // update the dynamic RT texture from the part of the water draw buffer the frame changed; the rest of
+                // the draw buffer is what was last uploaded
+                if (!frame_is_empty)
                 {
-                    abort();
+                    const uint32_t* dirty_pixels = (const uint32_t*)_water_draw_buffer + dirty->top * kRXCardViewportSize.width + dirty->left;
+                    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, _textures[RX_CARD_DYNAMIC_RENDER_INDEX]); glReportError();
+                    glPixelStorei(GL_UNPACK_ROW_LENGTH, kRXCardViewportSize.width); glReportError();
+                    glTexSubImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, dirty->left, dirty->top, dirty->right - dirty->left, dirty->bottom - dirty->top,
+                        GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, dirty_pixels); glReportError();
+                    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0); glReportError();
                 }
-                
-                mp.p_int16++;
             }
             
-            // update the dynamic RT texture from the water draw buffer
-            glBindTexture(GL_TEXTURE_RECTANGLE_ARB, _textures[RX_CARD_DYNAMIC_RENDER_INDEX]); glReportError();
-            glTexSubImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, 0, 0, kRXCardViewportSize.width, kRXCardViewportSize.height,
-                GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, _water_draw_buffer); glReportError();
+            // the frame drew over the composition
+            if (!frame_is_empty)
+                rx_compositor_damage(_compositor, *dirty);
             
             // increment the special effect frame counter
             r->water_fx.current_frame = (r->water_fx.current_frame + 1) % r->water_fx.sfxe->record->frame_count;
@@ -1683,7 +2061,14 @@ init_failure:
     // render movies at the very end
     renderListEnumerator = [_active_movies objectEnumerator];
     while ((renderObject = [renderListEnumerator nextObject]))
+    {
         _movieRenderDispatch.imp(renderObject, _movieRenderDispatch.sel, outputTime, cgl_ctx, _fbos[RX_CARD_DYNAMIC_RENDER_INDEX]);
+        
+        // the movie drew over the composition
+        RXMovie* movie = [(RXMovieProxy*)renderObject proxiedMovie];
+        if (movie)
+            rx_compositor_damage(_compositor, RXMakeCoreRectFromCompositeDisplayRect(NSRectFromCGRect([movie renderRect])));
+    }
     
     // un-flip the y axis
     glLoadIdentity();
@@ -1797,6 +2182,9 @@ init_failure:
         
         // bind the card composite VAO
         [gl_state bindVertexArrayObject:_card_composite_vao];
+        
+        // every item is in the inventory texture
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, _inventory_texture); glReportError();
     }
     
     // get pointers into the card composite array
@@ -2010,20 +2398,20 @@ init_failure:
         positions[1] = _inventory_frames[inv_i].origin.y + _inventory_frames[inv_i].size.height;
         positions += 4;
         
-        // tex coords are always the same
-        tex_coords0[0] = 0.0f;
+        // tex coords are always the region of the item in the inventory texture
+        tex_coords0[0] = _inventory_texture_x[inv_i];
         tex_coords0[1] = _inventory_sizes[inv_i].height;
         tex_coords0 += 4;
         
-        tex_coords0[0] = _inventory_sizes[inv_i].width;
+        tex_coords0[0] = _inventory_texture_x[inv_i] + _inventory_sizes[inv_i].width;
         tex_coords0[1] = _inventory_sizes[inv_i].height;
         tex_coords0 += 4;
         
-        tex_coords0[0] = 0.0f;
+        tex_coords0[0] = _inventory_texture_x[inv_i];
         tex_coords0[1] = 0.0f;
         tex_coords0 += 4;
         
-        tex_coords0[0] = _inventory_sizes[inv_i].width;
+        tex_coords0[0] = _inventory_texture_x[inv_i] + _inventory_sizes[inv_i].width;
         tex_coords0[1] = 0.0f;
         tex_coords0 += 4;
         
@@ -2034,7 +2422,7 @@ init_failure:
             float alpha = (alpha_interpolator) ? [alpha_interpolator value] : _inventory_alpha[inv_i];
             glBlendColor(1.f, 1.f, 1.f, alpha); glReportError();
             
-            glBindTexture(GL_TEXTURE_RECTANGLE_ARB, _inventory_textures[inv_i]); glReportError();
+            // each item keeps its own draw, since the blend color holds its alpha
             glDrawArrays(GL_TRIANGLE_STRIP, 4 + 4 * inv_i, 4); glReportError();
         }
         
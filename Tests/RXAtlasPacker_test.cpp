@@ -0,0 +1,245 @@
+/*
+ *  RXAtlasPacker_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 06/11/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "Rendering/Graphics/RXAtlasPacker.h"
+
+
+static int failures = 0;
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s\n", message); \
+            failures++; \
+        } \
+    } while (0)
+
+static const uint16_t kPageSide = 512;
+
+struct picture_t {
+    uint16_t width;
+    uint16_t height;
+    rx_atlas_location location;
+};
+
+// checks that the pictures are inside of their page and that no two pictures, with their padding, overlap
+static bool pictures_are_disjoint(const std::vector<picture_t>& pictures, uint16_t padding) {
+    uint32_t pages = 0;
+    for (size_t i = 0; i < pictures.size(); i++) {
+        if (pictures[i].location.page + 1 > pages)
+            pages = pictures[i].location.page + 1;
+    }
+
+    std::vector<uint8_t> coverage(static_cast<size_t>(pages) * kPageSide * kPageSide, 0);
+    for (size_t i = 0; i < pictures.size(); i++) {
+        const picture_t& p = pictures[i];
+        uint32_t right = p.location.x + p.width + padding;
+        uint32_t bottom = p.location.y + p.height + padding;
+        if (p.location.x + p.width > kPageSide || p.location.y + p.height > kPageSide)
+            return false;
+        if (right > kPageSide)
+            right = kPageSide;
+        if (bottom > kPageSide)
+            bottom = kPageSide;
+
+        uint8_t* page = &coverage[static_cast<size_t>(p.location.page) * kPageSide * kPageSide];
+        for (uint32_t y = p.location.y; y < bottom; y++) {
+            for (uint32_t x = p.location.x; x < right; x++) {
+                if (page[y * kPageSide + x])
+                    return false;
+                page[y * kPageSide + x] = 1;
+            }
+        }
+    }
+    return true;
+}
+
+static rx_atlas_packer_stats stats_of(rx_atlas_packer_t* packer) {
+    rx_atlas_packer_stats stats;
+    rx_atlas_packer_get_stats(packer, &stats);
+    return stats;
+}
+
+static void test_placement() {
+    printf("-- Placing pictures --\n");
+
+    rx_atlas_packer_t* packer = rx_atlas_packer_create(kPageSide, kPageSide, 0);
+    std::vector<picture_t> pictures;
+
+    // the first picture goes in the top left corner, and the next ones along the top of the page
+    picture_t p = {100, 50, {0, 0, 0}};
+    CHECK(rx_atlas_packer_allocate(packer, p.width, p.height, &p.location), "a small picture should be placed");
+    CHECK(p.location.page == 0 && p.location.x == 0 && p.location.y == 0, "the first picture should be in the top left corner");
+    pictures.push_back(p);
+
+    picture_t q = {60, 30, {0, 0, 0}};
+    rx_atlas_packer_allocate(packer, q.width, q.height, &q.location);
+    CHECK(q.location.y == 0 && q.location.x == 100, "the next picture should go along the top of the page");
+    pictures.push_back(q);
+
+    // a picture as wide as the rest of the top row fits beside the others
+    picture_t r = {352, 40, {0, 0, 0}};
+    rx_atlas_packer_allocate(packer, r.width, r.height, &r.location);
+    CHECK(r.location.y == 0 && r.location.x == 160, "a picture should fill the rest of the top row");
+    pictures.push_back(r);
+
+    // the lowest segment is under the second picture
+    picture_t s = {60, 10, {0, 0, 0}};
+    rx_atlas_packer_allocate(packer, s.width, s.height, &s.location);
+    CHECK(s.location.x == 100 && s.location.y == 30, "a picture should go where its bottom is the highest");
+    pictures.push_back(s);
+
+    CHECK(pictures_are_disjoint(pictures, 0), "pictures should not overlap");
+
+    picture_t too_large = {kPageSide + 1, 10, {0, 0, 0}};
+    CHECK(!rx_atlas_packer_allocate(packer, too_large.width, too_large.height, &too_large.location), "a picture larger than a page should be rejected");
+
+    rx_atlas_packer_stats stats = stats_of(packer);
+    CHECK(stats.pages == 1 && stats.pictures == 4, "the pictures should be in one page");
+    CHECK(stats.used_area == 100 * 50 + 60 * 30 + 352 * 40 + 60 * 10, "the used area should be the area of the pictures");
+    CHECK(stats.packed_area >= stats.used_area, "the packed area should cover the pictures");
+
+    rx_atlas_packer_free(packer);
+    printf("\n");
+}
+
+static void test_pages() {
+    printf("-- Adding and emptying pages --\n");
+
+    rx_atlas_packer_t* packer = rx_atlas_packer_create(kPageSide, kPageSide, 1);
+    std::vector<picture_t> pictures;
+
+    // 63x63 pictures with a pixel of padding tile a page 8 by 8
+    for (int i = 0; i < 65; i++) {
+        picture_t p = {63, 63, {0, 0, 0}};
+        CHECK(rx_atlas_packer_allocate(packer, p.width, p.height, &p.location), "tiles should be placed");
+        pictures.push_back(p);
+    }
+    CHECK(pictures[63].location.page == 0 && pictures[64].location.page == 1, "a full page should make the packer add a page");
+    CHECK(pictures_are_disjoint(pictures, 1), "padded pictures should not overlap");
+    rx_atlas_packer_stats stats = stats_of(packer);
+    CHECK(rx_atlas_packer_fragmentation(&stats) < 0.04, "padded tiles should only waste their padding");
+
+    // releasing a picture leaves its rect to the pictures that fit in it
+    CHECK(!rx_atlas_packer_release(packer, &pictures[0].location, 63, 63), "a page with pictures left should not be empty");
+    stats = stats_of(packer);
+    CHECK(stats.pictures == 64 && stats.used_area == 64 * 63 * 63, "a released picture should not be counted");
+    CHECK(stats.free_area == 64 * 64, "the rect of a released picture should be kept with its padding");
+
+    picture_t small = {30, 63, {0, 0, 0}};
+    rx_atlas_packer_allocate(packer, small.width, small.height, &small.location);
+    CHECK(small.location.page == 0 && small.location.x == 0 && small.location.y == 0, "the rect of a released picture should be reused");
+    picture_t rest = {32, 63, {0, 0, 0}};
+    rx_atlas_packer_allocate(packer, rest.width, rest.height, &rest.location);
+    CHECK(rest.location.page == 0 && rest.location.x == 31 && rest.location.y == 0, "the rest of a reused rect should be reused");
+
+    picture_t p = {63, 63, {0, 0, 0}};
+    rx_atlas_packer_allocate(packer, p.width, p.height, &p.location);
+    CHECK(p.location.page == 1, "a picture larger than the released rects should go after the others");
+
+    CHECK(!rx_atlas_packer_release(packer, &pictures[64].location, 63, 63), "the second page still has a picture");
+    CHECK(rx_atlas_packer_release(packer, &p.location, 63, 63), "releasing the last picture should empty the page");
+    CHECK(stats_of(packer).pages == 1, "an empty page should not be counted");
+
+    picture_t q = {200, 200, {0, 0, 0}};
+    rx_atlas_packer_allocate(packer, q.width, q.height, &q.location);
+    CHECK(q.location.page == 1 && q.location.x == 0 && q.location.y == 0, "an empty page should be reused from its top left corner");
+
+    rx_atlas_packer_free(packer);
+    printf("\n");
+}
+
+// the small dynamic pictures of a few cards: marbles, pins, dome symbols, journal icons and slider knobs; pictures of
+// random sizes come and go, and the pictures of every other card are released
+static void test_fragmentation() {
+    printf("-- Fragmentation --\n");
+
+    rx_atlas_packer_t* packer = rx_atlas_packer_create(kPageSide, kPageSide, 0);
+    srand(49);
+
+    std::vector<picture_t> live;
+    bool disjoint = true;
+    double worst = 0.0;
+    double occupancy_total = 0.0;
+    uint32_t samples = 0;
+    for (int card = 0; card < 200; card++) {
+        uint32_t count = 20 + rand() % 60;
+        for (uint32_t i = 0; i < count; i++) {
+            picture_t p;
+            p.width = static_cast<uint16_t>(4 + rand() % 60);
+            p.height = static_cast<uint16_t>(2 + rand() % 50);
+            if (rx_atlas_packer_allocate(packer, p.width, p.height, &p.location))
+                live.push_back(p);
+        }
+
+        rx_atlas_packer_stats stats = stats_of(packer);
+        double fragmentation = rx_atlas_packer_fragmentation(&stats);
+        if (fragmentation > worst)
+            worst = fragmentation;
+        occupancy_total += static_cast<double>(stats.used_area) / stats.page_area;
+        samples++;
+
+        if (card % 10 == 0)
+            disjoint = disjoint && pictures_are_disjoint(live, 0);
+
+        // leaving a card releases its pictures, or most of them when the card keeps a few in its caches
+        if (card % 2 == 1) {
+            std::vector<picture_t> kept;
+            for (size_t i = 0; i < live.size(); i++) {
+                if (rand() % 8 == 0)
+                    kept.push_back(live[i]);
+                else
+                    rx_atlas_packer_release(packer, &live[i].location, live[i].width, live[i].height);
+            }
+            live.swap(kept);
+        }
+    }
+    CHECK(disjoint, "pictures should never overlap");
+
+    rx_atlas_packer_stats stats = stats_of(packer);
+    printf("%u pages, %u pictures, mean occupancy %.3f, released %.3f, fragmentation %.3f (worst %.3f)\n", stats.pages,
+        stats.pictures, occupancy_total / samples, static_cast<double>(stats.free_area) / stats.page_area,
+        rx_atlas_packer_fragmentation(&stats), worst);
+    CHECK(worst < 0.25, "reusing released rects should keep the fragmentation low");
+
+    // pack a fresh atlas to measure the skyline gaps alone, without dead space
+    rx_atlas_packer_t* fresh = rx_atlas_packer_create(kPageSide, kPageSide, 0);
+    for (int i = 0; i < 2000; i++) {
+        rx_atlas_location location;
+        rx_atlas_packer_allocate(fresh, static_cast<uint16_t>(4 + rand() % 60), static_cast<uint16_t>(2 + rand() % 50), &location);
+    }
+    rx_atlas_packer_stats fresh_stats = stats_of(fresh);
+    double gaps = rx_atlas_packer_fragmentation(&fresh_stats);
+    printf("2000 pictures in %u pages, skyline gaps %.3f, occupancy %.3f\n", fresh_stats.pages, gaps,
+        static_cast<double>(fresh_stats.used_area) / fresh_stats.page_area);
+    CHECK(gaps < 0.15, "the skyline should leave few gaps under its segments");
+    rx_atlas_packer_free(fresh);
+
+    rx_atlas_packer_free(packer);
+    printf("\n");
+}
+
+int main(int argc, char* const argv[]) {
+    test_placement();
+    test_pages();
+    test_fragmentation();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("-- All atlas packer tests passed --\n");
+    return 0;
+}
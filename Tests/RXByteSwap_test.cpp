@@ -0,0 +1,212 @@
+/*
+ *  RXByteSwap_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 31/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "Base/RXByteSwap.h"
+#include "Engine/RXCoreStructures.h"
+
+
+static int failures = 0;
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s\n", message); \
+            failures++; \
+        } \
+    } while (0)
+
+static uint32_t seed = 0x2badcafe;
+
+static uint8_t random_byte() {
+    seed = seed * 1664525 + 1013904223;
+    return static_cast<uint8_t>(seed >> 24);
+}
+
+static std::vector<uint8_t> random_bytes(size_t length) {
+    std::vector<uint8_t> bytes(length);
+    for (size_t i = 0; i < length; i++)
+        bytes[i] = random_byte();
+    return bytes;
+}
+
+// reverses each field of every record, one byte at a time
+static void reference_swap(uint8_t* data, size_t count, const uint8_t* field_sizes, size_t field_count) {
+    for (size_t record = 0; record < count; record++) {
+        for (size_t f = 0; f < field_count; f++) {
+            for (size_t i = 0; i < field_sizes[f] / 2; i++) {
+                uint8_t byte = data[i];
+                data[i] = data[field_sizes[f] - 1 - i];
+                data[field_sizes[f] - 1 - i] = byte;
+            }
+            data += field_sizes[f];
+        }
+    }
+}
+
+static void test_spans() {
+    printf("-- Swapping spans --\n");
+
+    bool words_ok = true;
+    bool longs_ok = true;
+    bool copy_ok = true;
+    bool untouched = true;
+    for (size_t count = 0; count < 80; count++) {
+        // every start alignment, with guard bytes around the span
+        for (size_t misalignment = 0; misalignment < 4; misalignment++) {
+            std::vector<uint8_t> original = random_bytes(count * 4 + 8);
+            std::vector<uint8_t> bytes = original;
+            uint8_t* span = &bytes[misalignment + 2];
+
+            rx_swap16_span(span, count);
+            for (size_t i = 0; i < count; i++)
+                words_ok = words_ok && span[i * 2] == original[misalignment + 2 + i * 2 + 1] &&
+                           span[i * 2 + 1] == original[misalignment + 2 + i * 2];
+            untouched = untouched && memcmp(&bytes[misalignment + 2 + count * 2], &original[misalignment + 2 + count * 2],
+                                            bytes.size() - misalignment - 2 - count * 2) == 0;
+
+            bytes = original;
+            rx_swap32_span(span, count);
+            for (size_t i = 0; i < count; i++) {
+                for (size_t b = 0; b < 4; b++)
+                    longs_ok = longs_ok && span[i * 4 + b] == original[misalignment + 2 + i * 4 + 3 - b];
+            }
+            untouched = untouched && memcmp(&bytes[0], &original[0], misalignment + 2) == 0 &&
+                        memcmp(&bytes[misalignment + 2 + count * 4], &original[misalignment + 2 + count * 4], 6 - misalignment) == 0;
+
+            std::vector<uint8_t> copy(count * 2 + 4, 0xaa);
+            rx_swap16_copy_span(&copy[1 + (misalignment & 1)], &original[misalignment], count);
+            for (size_t i = 0; i < count; i++)
+                copy_ok = copy_ok && copy[1 + (misalignment & 1) + i * 2] == original[misalignment + i * 2 + 1] &&
+                          copy[1 + (misalignment & 1) + i * 2 + 1] == original[misalignment + i * 2];
+            copy_ok = copy_ok && copy[0] == 0xaa && copy[copy.size() - 1] == 0xaa;
+        }
+    }
+    CHECK(words_ok, "16-bit spans should be swapped");
+    CHECK(longs_ok, "32-bit spans should be swapped");
+    CHECK(copy_ok, "copied 16-bit spans should be swapped");
+    CHECK(untouched, "the bytes around a span should not change");
+
+    CHECK(rx_swap16(0x1234) == 0x3412, "a word should be swapped");
+    CHECK(rx_swap32(0x12345678) == 0x78563412, "a long should be swapped");
+    printf("\n");
+}
+
+struct layout_case {
+    const char* name;
+    size_t size;
+    std::vector<uint8_t> fields;
+};
+
+static void test_layouts() {
+    printf("-- Swapping packed structures --\n");
+
+    const uint8_t plst[] = {2, 2, 2, 2, 2, 2};
+    const uint8_t mlst[] = {2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2};
+    const uint8_t hspt[] = {2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2};
+    const uint8_t blst[] = {2, 2, 2};
+    const uint8_t sfxe[] = {2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 4, 4, 4, 4, 4};
+    const uint8_t mixed[] = {1, 4, 2, 8, 1, 2, 4, 4, 8, 2, 2, 1, 1};
+    const layout_case cases[] = {
+        {"PLST", sizeof(struct rx_plst_record), std::vector<uint8_t>(plst, plst + sizeof(plst))},
+        {"MLST", sizeof(struct rx_mlst_record), std::vector<uint8_t>(mlst, mlst + sizeof(mlst))},
+        {"HSPT", sizeof(struct rx_hspt_record), std::vector<uint8_t>(hspt, hspt + sizeof(hspt))},
+        {"BLST", sizeof(struct rx_blst_record), std::vector<uint8_t>(blst, blst + sizeof(blst))},
+        {"SFXE", sizeof(struct rx_sfxe_record), std::vector<uint8_t>(sfxe, sfxe + sizeof(sfxe))},
+        {"mixed", 40, std::vector<uint8_t>(mixed, mixed + sizeof(mixed))},
+    };
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const layout_case& test = cases[c];
+        rx_swap_layout_t layout;
+        char message[128];
+        snprintf(message, sizeof(message), "the %s layout should be built", test.name);
+        CHECK(rx_swap_layout_init(&layout, &test.fields[0], test.fields.size()), message);
+        snprintf(message, sizeof(message), "the %s layout should have the size of its structure", test.name);
+        CHECK(layout.size == test.size, message);
+
+        bool segments_ok = true;
+        for (uint32_t s = 0; s < layout.segment_count; s++)
+            segments_ok = segments_ok && layout.segments[s].length <= 16;
+        snprintf(message, sizeof(message), "the %s segments should be at most 16 bytes long", test.name);
+        CHECK(segments_ok, message);
+
+        // record counts around the point where the vector path stops, and a misaligned start
+        bool swapped_ok = true;
+        for (size_t count = 0; count < 9; count++) {
+            for (size_t misalignment = 0; misalignment < 2; misalignment++) {
+                std::vector<uint8_t> original = random_bytes(test.size * count + 2);
+                std::vector<uint8_t> expected = original;
+                std::vector<uint8_t> bytes = original;
+                reference_swap(&expected[misalignment], count, &test.fields[0], test.fields.size());
+                rx_swap_records(&bytes[misalignment], count, &layout);
+                swapped_ok = swapped_ok && bytes == expected;
+            }
+        }
+        snprintf(message, sizeof(message), "%s records should match the scalar swap", test.name);
+        CHECK(swapped_ok, message);
+    }
+
+    // the layouts match the fields of the structures
+    const uint8_t sfxe_bytes[] = {
+        0x00, 0x50, 0x00, 0x02, 0x00, 0x00, 0x00, 0x34, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x14, 0x00, 0x1e,
+        0x00, 0x0f, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x03, 0x00, 0x04, 0x00, 0x05, 0x00, 0x06,
+        0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x0a,
+        0x01, 0x02, 0x03, 0x04,
+    };
+    struct rx_sfxe_record record;
+    memcpy(&record, sfxe_bytes, sizeof(record));
+    rx_swap_layout_t layout;
+    rx_swap_layout_init(&layout, sfxe, sizeof(sfxe));
+    rx_swap_records(&record, 1, &layout);
+    CHECK(record.magic == 0x50 && record.frame_count == 2 && record.offset_table == 52,
+          "the SFXE header fields should be in host order");
+    CHECK(record.rect.right == 20 && record.fps == 15 && record.alt_rect.bottom == 4 && record.alt_frame_count == 6,
+          "the SFXE rects should be in host order");
+    CHECK(record.u2 == 7 && record.u5 == 10 && record.u6 == 0x01020304, "the SFXE longs should be in host order");
+
+    // invalid layouts
+    const uint8_t bad_size[] = {2, 3};
+    CHECK(!rx_swap_layout_init(&layout, bad_size, sizeof(bad_size)), "a field of 3 bytes should be rejected");
+    std::vector<uint8_t> too_many(RX_SWAP_LAYOUT_MAX_SEGMENTS * 2 + 1, 8);
+    CHECK(!rx_swap_layout_init(&layout, &too_many[0], too_many.size()), "a layout with too many segments should be rejected");
+    std::vector<uint8_t> most(RX_SWAP_LAYOUT_MAX_SEGMENTS * 2, 8);
+    CHECK(rx_swap_layout_init(&layout, &most[0], most.size()) && layout.segment_count == RX_SWAP_LAYOUT_MAX_SEGMENTS,
+          "a layout with the most segments should be built");
+
+    printf("\n");
+}
+
+int main(int argc, char* const argv[]) {
+#if defined(RX_BYTE_SWAP_SSSE3)
+    printf("-- Testing the SSSE3 kernels --\n\n");
+#elif defined(RX_BYTE_SWAP_SSE2)
+    printf("-- Testing the SSE2 kernels --\n\n");
+#elif defined(RX_BYTE_SWAP_NEON)
+    printf("-- Testing the NEON kernels --\n\n");
+#else
+    printf("-- Testing the scalar kernels --\n\n");
+#endif
+
+    test_spans();
+    test_layouts();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("-- All byte swap tests passed --\n");
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ *  RXCardLinks_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 29/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "Engine/RXCardLinks.h"
+#include "Engine/RXScriptCommandAliases.h"
+
+
+static int failures = 0;
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s\n", message); \
+            failures++; \
+        } \
+    } while (0)
+
+// appends a big-endian word to a script
+static void push_be16(std::vector<uint8_t>& script, uint16_t value) {
+    script.push_back(static_cast<uint8_t>(value >> 8));
+    script.push_back(static_cast<uint8_t>(value & 0xff));
+}
+
+static void push_words(std::vector<uint8_t>& script, const uint16_t* words, size_t count) {
+    for (size_t i = 0; i < count; i++)
+        push_be16(script, words[i]);
+}
+
+// a card script for card 3: a mouse down program that goes to card 5 or, depending on a variable, to card 7 or to
+// card 5 after a go to card 3, and an open card program that goes to card 9
+static rx_script_t* make_script() {
+    std::vector<uint8_t> script;
+    push_be16(script, 2);
+
+    const uint16_t mouse_down[] = {
+        kScriptTypeMouseDown, 2,
+        RX_COMMAND_GOTO_CARD, 1, 5,
+        RX_COMMAND_BRANCH, 2, 0, 2,
+            0, 1,
+                RX_COMMAND_GOTO_CARD, 1, 7,
+            1, 2,
+                RX_COMMAND_GOTO_CARD, 1, 3,
+                RX_COMMAND_GOTO_CARD, 1, 5,
+    };
+    push_words(script, mouse_down, sizeof(mouse_down) / sizeof(uint16_t));
+
+    const uint16_t open_card[] = {
+        kScriptTypeCardOpen, 2,
+        RX_COMMAND_ACTIVATE_PLST, 1, 1,
+        RX_COMMAND_GOTO_CARD, 1, 9,
+    };
+    push_words(script, open_card, sizeof(open_card) / sizeof(uint16_t));
+
+    uint32_t script_length;
+    return rx_script_decode(&script[0], script.size(), &script_length, NULL, NULL);
+}
+
+static void test_links() {
+    printf("-- Extracting card links --\n");
+
+    rx_script_t* script = make_script();
+    CHECK(script != NULL, "the script should decode");
+
+    rx_card_link_t links[8];
+    uint32_t count = rx_card_links_add_script(script, 3, links, 0, 8);
+    CHECK(count == 3, "every card other than the script's own card should be linked once");
+
+    rx_card_links_sort(links, count);
+    CHECK(links[0].card_id == 5 && links[0].references == 2, "the card named twice should come first");
+    CHECK(links[1].card_id == 7 && links[1].references == 1, "the card in a switch case should be linked");
+    CHECK(links[2].card_id == 9 && links[2].references == 1, "the card of the open card program should be linked");
+
+    // adding the same script again, like a second hotspot with the same program, adds references
+    count = rx_card_links_add_script(script, 3, links, count, 8);
+    CHECK(count == 3 && links[0].references == 4, "links should accumulate references");
+
+    // a full list keeps counting the cards it has but drops the others
+    count = rx_card_links_add_script(script, 3, links, 0, 1);
+    CHECK(count == 1 && links[0].card_id == 5 && links[0].references == 2, "links should never exceed the capacity");
+
+    CHECK(rx_card_links_add_script(NULL, 3, links, 1, 8) == 1, "a card without a script should have no links");
+
+    rx_script_free(script);
+    printf("\n");
+}
+
+static void test_replaced_programs() {
+    printf("-- Walking replaced programs --\n");
+
+    // script workarounds replace programs without verifying them; a switch claiming more cases than the program holds
+    // must not be walked out of bounds
+    rx_script_t* script = make_script();
+    const uint16_t truncated[] = {RX_COMMAND_GOTO_CARD, 1, 11, RX_COMMAND_BRANCH, 2, 0, 40, 0, 1};
+    script = rx_script_replace_program(script, kScriptTypeMouseDown, 0, truncated, sizeof(truncated), 2);
+
+    rx_card_link_t links[8];
+    uint32_t count = rx_card_links_add_script(script, 3, links, 0, 8);
+    rx_card_links_sort(links, count);
+    CHECK(count == 2 && links[0].card_id == 9 && links[1].card_id == 11, "the links before the truncation should be kept");
+
+    rx_script_free(script);
+    printf("\n");
+}
+
+int main(int argc, char* const argv[]) {
+    test_links();
+    test_replaced_programs();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("-- All card link tests passed --\n");
+    return 0;
+}
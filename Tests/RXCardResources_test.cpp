@@ -0,0 +1,203 @@
+/*
+ *  RXCardResources_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 30/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "Engine/RXCardResources.h"
+
+
+static int failures = 0;
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s\n", message); \
+            failures++; \
+        } \
+    } while (0)
+
+static void push_be16(std::vector<uint8_t>& data, uint16_t value) {
+    data.push_back(static_cast<uint8_t>(value >> 8));
+    data.push_back(static_cast<uint8_t>(value & 0xff));
+}
+
+static void push_be32(std::vector<uint8_t>& data, uint32_t value) {
+    push_be16(data, static_cast<uint16_t>(value >> 16));
+    push_be16(data, static_cast<uint16_t>(value & 0xffff));
+}
+
+// copies a resource into its own allocation, like the engine does, so that the records are aligned as they are there
+static uint8_t* copy_resource(const std::vector<uint8_t>& data) {
+    uint8_t* copy = static_cast<uint8_t*>(malloc(data.size()));
+    memcpy(copy, &data[0], data.size());
+    return copy;
+}
+
+static void test_lists() {
+    printf("-- Swapping list resources --\n");
+
+    std::vector<uint8_t> plst;
+    push_be16(plst, 2);
+    const uint16_t records[] = {1, 300, 10, 20, 618, 352, 2, 301, 0, 0, 608, 392};
+    for (size_t i = 0; i < sizeof(records) / sizeof(uint16_t); i++)
+        push_be16(plst, records[i]);
+
+    uint8_t* data = copy_resource(plst);
+    uint16_t count = 0;
+    CHECK(rx_card_swap_plst(data, plst.size(), &count), "a well formed PLST should be swapped");
+    CHECK(count == 2, "the record count should be returned");
+    struct rx_plst_record* picture = reinterpret_cast<struct rx_plst_record*>(data + 2);
+    CHECK(picture[0].bitmap_id == 300 && picture[0].rect.right == 618, "the first record should be in host order");
+    CHECK(picture[1].index == 2 && picture[1].rect.bottom == 392, "the last record should be in host order");
+    free(data);
+
+    // a list claiming more records than it holds
+    data = copy_resource(plst);
+    CHECK(!rx_card_swap_plst(data, plst.size() - 2, &count), "a truncated PLST should be rejected");
+    CHECK(!rx_card_swap_blst(data, 1, &count), "a list without a count should be rejected");
+    free(data);
+
+    std::vector<uint8_t> flst;
+    push_be16(flst, 1);
+    push_be16(flst, 1);
+    push_be16(flst, 7);
+    push_be16(flst, 0);
+    data = copy_resource(flst);
+    CHECK(rx_card_swap_flst(data, flst.size(), &count) && count == 1, "a well formed FLST should be swapped");
+    CHECK(reinterpret_cast<struct rx_flst_record*>(data + 2)->sfxe_id == 7, "the FLST record should be in host order");
+    free(data);
+
+    // two sound groups, with 2 sounds and 1 sound
+    std::vector<uint8_t> slst;
+    const uint16_t slst_records[] = {
+        2,
+        1, 2, 10, 11, 1, 1, 25600, 0, 0, 25600, 12800, 0, 0xffce, 0, 0,
+        2, 1, 12, 2, 0, 25600, 0, 0, 25600, 50, 0,
+    };
+    for (size_t i = 0; i < sizeof(slst_records) / sizeof(uint16_t); i++)
+        push_be16(slst, slst_records[i]);
+    data = copy_resource(slst);
+    CHECK(rx_card_swap_slst(data, slst.size(), &count) && count == 2, "a well formed SLST should be swapped");
+    const uint16_t* words = reinterpret_cast<const uint16_t*>(data);
+    bool all = true;
+    for (size_t i = 1; i < sizeof(slst_records) / sizeof(uint16_t); i++)
+        all = all && words[i] == slst_records[i];
+    CHECK(all, "every SLST record should be in host order");
+    free(data);
+
+    data = copy_resource(slst);
+    CHECK(!rx_card_swap_slst(data, slst.size() - 2, &count), "a truncated SLST should be rejected");
+    free(data);
+
+    std::vector<uint8_t> hspt;
+    const uint16_t hspt_record[] = {16, 0xffff, 1, 2, 3, 4, 0, 2003, 5, 0, 1};
+    for (size_t i = 0; i < sizeof(hspt_record) / sizeof(uint16_t); i++)
+        push_be16(hspt, hspt_record[i]);
+    data = copy_resource(hspt);
+    struct rx_hspt_record* hotspot = reinterpret_cast<struct rx_hspt_record*>(data);
+    rx_card_swap_hspt_record(hotspot);
+    CHECK(hotspot->blst_id == 16 && hotspot->name_rec == -1 && hotspot->mouse_cursor == 2003 && hotspot->zip == 1,
+          "the HSPT record should be in host order");
+    free(data);
+
+    printf("\n");
+}
+
+// an SFXE resource with two frames: one copying a rect, one with an empty program
+static std::vector<uint8_t> make_sfxe() {
+    std::vector<uint8_t> sfxe;
+    push_be16(sfxe, 0x0050);
+    push_be16(sfxe, 2);
+    push_be32(sfxe, 52);
+    for (int i = 0; i < 4; i++)
+        push_be16(sfxe, static_cast<uint16_t>(i * 10));
+    push_be16(sfxe, 15);
+    push_be16(sfxe, 0);
+    for (int i = 0; i < 4; i++)
+        push_be16(sfxe, 0);
+    push_be16(sfxe, 0);
+    push_be16(sfxe, 0);
+    for (int i = 0; i < 5; i++)
+        push_be32(sfxe, 0);
+
+    // offset table
+    push_be32(sfxe, 60);
+    push_be32(sfxe, 60 + 14);
+
+    // frame programs
+    push_be16(sfxe, 1);
+    push_be16(sfxe, 3);
+    push_be16(sfxe, 1);
+    push_be16(sfxe, 2);
+    push_be16(sfxe, 3);
+    push_be16(sfxe, 4);
+    push_be16(sfxe, 4);
+    push_be16(sfxe, 4);
+    return sfxe;
+}
+
+static void test_sfxe() {
+    printf("-- Swapping SFXE resources --\n");
+
+    std::vector<uint8_t> sfxe = make_sfxe();
+    CHECK(sfxe.size() == 60 + 16, "the SFXE resource should have the expected layout");
+
+    uint8_t* data = copy_resource(sfxe);
+    CHECK(rx_card_swap_sfxe(data, sfxe.size()), "a well formed SFXE should be swapped");
+    struct rx_sfxe_record* record = reinterpret_cast<struct rx_sfxe_record*>(data);
+    CHECK(record->frame_count == 2 && record->offset_table == 52 && record->fps == 15, "the header should be in host order");
+    CHECK(record->rect.right == 20, "the rect should be in host order");
+
+    uint32_t offset;
+    memcpy(&offset, data + 52 + 4, sizeof(offset));
+    CHECK(offset == 74, "the offset table should be in host order");
+    const uint16_t* program = reinterpret_cast<const uint16_t*>(data + 60);
+    CHECK(program[0] == 1 && program[1] == 3 && program[5] == 4 && program[6] == 4, "the frame program should be in host order");
+    free(data);
+
+    // an offset table past the end of the resource
+    data = copy_resource(sfxe);
+    CHECK(!rx_card_swap_sfxe(data, 56), "an SFXE with a truncated offset table should be rejected");
+    free(data);
+
+    // a program that runs past the end of the resource
+    data = copy_resource(sfxe);
+    CHECK(!rx_card_swap_sfxe(data, sfxe.size() - 2), "an SFXE with a truncated program should be rejected");
+    free(data);
+
+    // an unknown opcode
+    std::vector<uint8_t> bad = sfxe;
+    bad[60 + 3] = 9;
+    data = copy_resource(bad);
+    CHECK(!rx_card_swap_sfxe(data, bad.size()), "an SFXE with an unknown opcode should be rejected");
+    free(data);
+
+    data = copy_resource(sfxe);
+    CHECK(!rx_card_swap_sfxe(data, 20), "an SFXE shorter than its header should be rejected");
+    free(data);
+
+    printf("\n");
+}
+
+int main(int argc, char* const argv[]) {
+    test_lists();
+    test_sfxe();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("-- All card resource tests passed --\n");
+    return 0;
+}
@@ -0,0 +1,314 @@
+/*
+ *  RXCompositor_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 04/11/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "Rendering/Graphics/RXCompositor.h"
+
+
+static int failures = 0;
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s\n", message); \
+            failures++; \
+        } \
+    } while (0)
+
+static const uint16_t kWidth = 608;
+static const uint16_t kHeight = 392;
+
+static uint32_t seed = 0xc0de5eed;
+
+static uint32_t random_number(uint32_t limit) {
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 8) % limit;
+}
+
+static rx_core_rect_t make_rect(uint16_t left, uint16_t top, uint16_t right, uint16_t bottom) {
+    rx_core_rect_t rect = {left, top, right, bottom};
+    return rect;
+}
+
+// a layer drawing the region of a content at (s, t) into a rect
+static rx_composite_layer make_layer(uintptr_t content, float s, float t, rx_core_rect_t rect) {
+    rx_composite_layer layer;
+    layer.content = reinterpret_cast<const void*>(content);
+    layer.sampling[0] = s;
+    layer.sampling[1] = t;
+    layer.sampling[2] = rect.right - rect.left;
+    layer.sampling[3] = rect.bottom - rect.top;
+    layer.rect = rect;
+    return layer;
+}
+
+// a card image, with the pixels of a layer made up from its content and sampling origin
+struct image_t {
+    std::vector<uint32_t> pixels;
+
+    image_t() : pixels(kWidth * kHeight, 0) {}
+
+    void draw(const rx_composite_layer& layer, rx_core_rect_t clip) {
+        rx_core_rect_t rect;
+        if (!rx_core_rect_intersection(layer.rect, clip, &rect))
+            return;
+        uint32_t content = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(layer.content));
+        for (uint32_t y = rect.top; y < rect.bottom; y++) {
+            for (uint32_t x = rect.left; x < rect.right; x++) {
+                uint32_t s = static_cast<uint32_t>(layer.sampling[0]) + x - layer.rect.left;
+                uint32_t t = static_cast<uint32_t>(layer.sampling[1]) + y - layer.rect.top;
+                pixels[y * kWidth + x] = content * 0x9e3779b1u ^ (s * 0x85ebca6bu) ^ (t * 0xc2b2ae35u);
+            }
+        }
+    }
+
+    void fill(rx_core_rect_t rect, uint32_t value) {
+        for (uint32_t y = rect.top; y < rect.bottom; y++)
+            for (uint32_t x = rect.left; x < rect.right; x++)
+                pixels[y * kWidth + x] = value;
+    }
+};
+
+// the card renderer: the reference paints every layer of an update over the image, while the composited image only
+// redraws the damage of the composition with the layers of the composition
+struct renderer_t {
+    rx_compositor_t* compositor;
+    image_t reference;
+    image_t composited;
+
+    renderer_t() : compositor(rx_compositor_create(kWidth, kHeight)) {}
+    ~renderer_t() {
+        rx_compositor_free(compositor);
+    }
+
+    bool update(const std::vector<rx_composite_layer>& layers, rx_composition* composition) {
+        rx_core_rect_t image = make_rect(0, 0, kWidth, kHeight);
+        for (size_t i = 0; i < layers.size(); i++)
+            reference.draw(layers[i], image);
+
+        if (!rx_compositor_compose(compositor, &layers[0], static_cast<uint32_t>(layers.size()), composition))
+            return false;
+        for (uint32_t d = 0; d < composition->damage.count; d++) {
+            for (uint32_t i = 0; i < compositor->layer_count; i++)
+                composited.draw(compositor->layers[i], composition->damage.rects[d]);
+        }
+        return reference.pixels == composited.pixels;
+    }
+
+    // a movie frame, drawn into both images between updates
+    void draw_movie(rx_core_rect_t rect, uint32_t frame) {
+        reference.fill(rect, frame);
+        composited.fill(rect, frame);
+        rx_compositor_damage(compositor, rect);
+    }
+};
+
+static void test_damage() {
+    printf("-- Accumulating damage --\n");
+
+    rx_damage_t damage;
+    rx_damage_clear(&damage);
+    rx_damage_add(&damage, make_rect(10, 10, 20, 20));
+    rx_damage_add(&damage, make_rect(30, 10, 40, 20));
+    rx_damage_add(&damage, make_rect(5, 5, 5, 50));
+    CHECK(damage.count == 2 && rx_damage_area(&damage) == 200, "disjoint rects should be kept apart and empty rects dropped");
+
+    // a rect that bridges the two rects merges them all
+    rx_damage_add(&damage, make_rect(15, 12, 35, 14));
+    CHECK(damage.count == 1, "overlapping rects should be merged");
+    CHECK(damage.rects[0].left == 10 && damage.rects[0].top == 10 && damage.rects[0].right == 40 && damage.rects[0].bottom == 20,
+          "the merged rect should bound the rects");
+
+    // a full set merges the new rect where it grows the damage the least
+    rx_damage_clear(&damage);
+    for (uint16_t i = 0; i < RX_DAMAGE_MAX_RECTS; i++)
+        rx_damage_add(&damage, make_rect(i * 50, 0, i * 50 + 10, 10));
+    CHECK(damage.count == RX_DAMAGE_MAX_RECTS, "every disjoint rect should be kept");
+    rx_damage_add(&damage, make_rect(12, 0, 14, 10));
+    CHECK(damage.count == RX_DAMAGE_MAX_RECTS && rx_damage_area(&damage) == (RX_DAMAGE_MAX_RECTS - 1) * 100 + 140,
+          "a rect past the capacity should be merged with its closest rect");
+    bool disjoint = true;
+    for (uint32_t i = 0; i < damage.count; i++)
+        for (uint32_t j = i + 1; j < damage.count; j++)
+            disjoint = disjoint && !rx_core_rect_intersection(damage.rects[i], damage.rects[j], NULL);
+    CHECK(disjoint, "the rects should stay disjoint");
+
+    printf("\n");
+}
+
+static void test_compositions() {
+    printf("-- Composing updates --\n");
+
+    renderer_t renderer;
+    rx_composition composition;
+    std::vector<rx_composite_layer> layers;
+    rx_core_rect_t card = make_rect(0, 0, kWidth, kHeight);
+
+    // a partial update over an unknown image is painted as is
+    layers.push_back(make_layer(7, 0, 0, make_rect(100, 100, 120, 110)));
+    CHECK(renderer.update(layers, &composition), "a partial first update should be painted");
+    CHECK(!composition.incremental && composition.damage.count == 1 && rx_damage_area(&composition.damage) == 200,
+          "a partial first update should only damage its rect");
+
+    // the first full update redraws everything, from the last layer that covers the card
+    layers.clear();
+    layers.push_back(make_layer(1, 0, 0, card));
+    layers.push_back(make_layer(2, 0, 0, card));
+    layers.push_back(make_layer(3, 0, 0, make_rect(10, 10, 30, 30)));
+    CHECK(renderer.update(layers, &composition), "a full update should be painted");
+    CHECK(composition.first_layer == 1 && !composition.appended, "the layers under the last full layer should be skipped");
+    CHECK(rx_damage_area(&composition.damage) == kWidth * kHeight, "the first full update should damage the whole card");
+
+    // the same update again changes nothing
+    CHECK(renderer.update(layers, &composition), "a repeated update should be painted");
+    CHECK(composition.incremental && composition.damage.count == 0, "a repeated update should not damage the card");
+    CHECK(renderer.compositor->stats.last_pixels_redrawn == 0, "a repeated update should not redraw anything");
+
+    // moving the small layer damages where it was and where it is
+    layers[2] = make_layer(3, 0, 0, make_rect(50, 10, 70, 30));
+    CHECK(renderer.update(layers, &composition), "a moved layer should be painted");
+    CHECK(composition.damage.count == 2 && rx_damage_area(&composition.damage) == 800, "a moved layer should damage both of its rects");
+
+    // a layer that samples another region of its content damages its rect
+    layers[2].sampling[0] = 20;
+    CHECK(renderer.update(layers, &composition), "a resampled layer should be painted");
+    CHECK(rx_damage_area(&composition.damage) == 400, "a resampled layer should damage its rect");
+
+    // a partial update goes on top of the composition, and a movie drawn before it stays where the update does not go
+    renderer.draw_movie(make_rect(200, 200, 300, 260), 0xdeadbeef);
+    std::vector<rx_composite_layer> overlay(1, make_layer(4, 0, 0, make_rect(400, 0, 420, 20)));
+    CHECK(renderer.update(overlay, &composition), "a partial update should be painted");
+    CHECK(composition.appended && !composition.incremental, "a partial update should go on top of the composition");
+    CHECK(rx_damage_area(&composition.damage) == 400, "a partial update should only damage its rect");
+    CHECK(renderer.compositor->layer_count == 3, "the partial update should be added to the composition");
+
+    // the next full update diffs against the layers of both updates, and repairs the movie frame
+    CHECK(renderer.update(layers, &composition), "a full update after a partial update should be painted");
+    CHECK(composition.incremental && rx_damage_area(&composition.damage) == 400 + 6000,
+          "the layer of the partial update and the movie should be damaged");
+
+    // a new card damages everything
+    layers.assign(1, make_layer(9, 0, 0, card));
+    CHECK(renderer.update(layers, &composition), "a new card should be painted");
+    CHECK(rx_damage_area(&composition.damage) == kWidth * kHeight, "a new card should damage the whole card");
+
+    // an invalidated compositor redraws everything
+    rx_compositor_invalidate(renderer.compositor);
+    CHECK(renderer.update(layers, &composition), "an update after invalidation should be painted");
+    CHECK(!composition.incremental && rx_damage_area(&composition.damage) == kWidth * kHeight,
+          "an invalidated compositor should damage the whole card");
+
+    printf("\n");
+}
+
+// the fire marble puzzle: the board, then the 6 marbles from an atlas, and their tiny copies on the waffle; every
+// update moves a marble by a cell
+static void test_marble_scene() {
+    printf("-- Marble puzzle scene --\n");
+
+    renderer_t renderer;
+    rx_composition composition;
+    uint16_t marbles[6][2];
+    for (int m = 0; m < 6; m++) {
+        marbles[m][0] = static_cast<uint16_t>(random_number(25));
+        marbles[m][1] = static_cast<uint16_t>(random_number(25));
+    }
+
+    bool painted = true;
+    for (int update = 0; update < 300; update++) {
+        int m = random_number(6);
+        marbles[m][random_number(2)] = static_cast<uint16_t>(random_number(25));
+
+        std::vector<rx_composite_layer> layers;
+        layers.push_back(make_layer(100, 0, 0, make_rect(0, 0, kWidth, kHeight)));
+        for (int i = 0; i < 6; i++) {
+            uint16_t x = static_cast<uint16_t>(134 + marbles[i][0] * 13), y = static_cast<uint16_t>(24 + marbles[i][1] * 13);
+            layers.push_back(make_layer(101, i * 13.5f, 0, make_rect(x, y, x + 13, y + 13)));
+        }
+        for (int i = 0; i < 6; i++) {
+            uint16_t x = static_cast<uint16_t>(246 + marbles[i][0] * 5), y = static_cast<uint16_t>(263 + marbles[i][1] * 2);
+            layers.push_back(make_layer(102, 0, i * 2.f, make_rect(x, y, x + 4, y + 2)));
+        }
+        painted = renderer.update(layers, &composition) && painted;
+    }
+    CHECK(painted, "the composited marble puzzle should match the full redraws");
+
+    const rx_compositor_stats& stats = renderer.compositor->stats;
+    printf("%llu updates, %.0f pixels redrawn per update instead of %.0f\n", (unsigned long long)stats.compositions,
+           (double)stats.pixels_redrawn / stats.compositions, (double)stats.pixels_queued / stats.compositions);
+    CHECK(stats.pixels_redrawn * 20 < stats.pixels_queued, "moving marbles should redraw less than a twentieth of the pixels");
+
+    printf("\n");
+}
+
+// a dome: the background, the slider track and 5 sliders; every update moves a slider by a notch, while the dome spins
+// in a movie between updates
+static void test_dome_scene() {
+    printf("-- Dome slider scene --\n");
+
+    renderer_t renderer;
+    rx_composition composition;
+    uint16_t sliders[5] = {0, 4, 9, 14, 19};
+    rx_core_rect_t movie = make_rect(180, 40, 430, 240);
+
+    bool painted = true;
+    for (int update = 0; update < 300; update++) {
+        int s = random_number(5);
+        int notch = sliders[s] + ((random_number(2)) ? 1 : -1);
+        bool taken = notch < 0 || notch > 24;
+        for (int i = 0; i < 5; i++)
+            taken = taken || sliders[i] == notch;
+        if (!taken)
+            sliders[s] = static_cast<uint16_t>(notch);
+
+        // the dome spins until the sliders are set
+        bool spinning = update % 50 < 10;
+        if (spinning)
+            renderer.draw_movie(movie, 0xd0d0d000 + update);
+
+        std::vector<rx_composite_layer> layers;
+        layers.push_back(make_layer(200, 0, 0, make_rect(0, 0, kWidth, kHeight)));
+        layers.push_back(make_layer(201, 0, 0, make_rect(151, 303, 458, 322)));
+        for (int i = 0; i < 5; i++) {
+            uint16_t x = static_cast<uint16_t>(151 + sliders[i] * 12);
+            layers.push_back(make_layer(202, 0, 0, make_rect(x, 303, x + 13, 322)));
+        }
+        painted = renderer.update(layers, &composition) && painted;
+        if (spinning)
+            renderer.draw_movie(movie, 0xd0d0d000 + update);
+    }
+    CHECK(painted, "the composited domes should match the full redraws");
+
+    const rx_compositor_stats& stats = renderer.compositor->stats;
+    printf("%llu updates, %.0f pixels redrawn per update instead of %.0f\n", (unsigned long long)stats.compositions,
+           (double)stats.pixels_redrawn / stats.compositions, (double)stats.pixels_queued / stats.compositions);
+    CHECK(stats.pixels_redrawn * 4 < stats.pixels_queued, "moving sliders should redraw less than a quarter of the pixels");
+
+    printf("\n");
+}
+
+int main(int argc, char* const argv[]) {
+    test_damage();
+    test_compositions();
+    test_marble_scene();
+    test_dome_scene();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("-- All compositor tests passed --\n");
+    return 0;
+}
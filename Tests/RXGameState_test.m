@@ -10,7 +10,7 @@
 
 #import "BZFSUtilities.h"
 
-#import "RXArchiveManager.h"
+#import "Base/RXTiming.h"
 
 
 @implementation RXGameState_test
@@ -19,9 +19,7 @@
     // tickle the world; including RXWorld.h brings in a world of hurt, so do this dynamically
     [NSClassFromString(@"RXWorld") performSelector:@selector(sharedWorld)];
     
-    // hopefully we have at least one edition object...
-    RXEdition* someEdition = [[[[RXArchiveManager sharedArchiveManager] valueForKey:@"editions"] allValues] objectAtIndex:0];
-    gameState = [[RXGameState alloc] initWithEdition:someEdition];
+    gameState = [[RXGameState alloc] init];
 }
 
 - (void)tearDown {
@@ -55,4 +53,185 @@
     STAssertEquals((uint16_t)10, [steamedState unsignedShortForKey:@"durr"], @"steamedState should have a value of 10 for ke\"durr\"");
 }
 
+- (void)testVariableIDs {
+    uint32_t variable = [RXGameState variableIDForKey:@"bBlueValve"];
+    STAssertEquals(variable, [RXGameState variableIDForKey:@"bbluevalve"], @"variable IDs should be case-insensitive");
+    STAssertEqualObjects(@"bbluevalve", [RXGameState keyForVariableID:variable], @"the key of a variable ID should be the lowercased name");
+    STAssertTrue(variable != [RXGameState variableIDForKey:@"bredvalve"], @"different names should have different IDs");
+}
+
+- (void)testVariableSlotsMatchKeys {
+    uint32_t variable = [RXGameState variableIDForKey:@"tdomeelev"];
+    
+    [gameState setUnsignedShort:3 forKey:@"TDomeElev"];
+    STAssertEquals((uint16_t)3, [gameState unsignedShortForVariable:variable], @"a value set by key should be visible by ID");
+    
+    [gameState setUnsignedShort:7 forVariable:variable];
+    STAssertEquals((uint16_t)7, [gameState unsignedShortForKey:@"tdomeelev"], @"a value set by ID should be visible by key");
+    
+    STAssertFalse([gameState isKeySet:@"durr unset"], @"\"durr unset\" should not be set");
+    STAssertEquals((uint16_t)0, [gameState unsignedShortForVariable:[RXGameState variableIDForKey:@"durr unset"]], @"unset variables should read 0");
+    STAssertTrue([gameState isKeySet:@"durr unset"], @"reading a variable should set it");
+}
+
+- (void)testVariableConversions {
+    [gameState setShort:-1 forKey:@"durr"];
+    STAssertEquals((uint16_t)0xffff, [gameState unsignedShortForKey:@"durr"], @"-1 should read as 0xffff");
+    STAssertEquals((int32_t)-1, [gameState signed32ForKey:@"durr"], @"-1 should be sign-extended");
+    
+    [gameState setUnsigned32:0x12345 forKey:@"durr"];
+    STAssertEquals((uint16_t)0x2345, [gameState unsignedShortForKey:@"durr"], @"32-bit values should be truncated to 16 bits");
+    
+    [gameState setUnsigned64:0x100000000ULL forKey:@"durr"];
+    STAssertEquals((uint64_t)0x100000000ULL, [gameState unsigned64ForKey:@"durr"], @"64-bit values should not be truncated");
+}
+
+- (void)testSerializingVariableTypes {
+    [gameState setShort:-2 forKey:@"durr short"];
+    [gameState setUnsigned64:0x100000000ULL forKey:@"durr 64"];
+    
+    NSData* data = [NSKeyedArchiver archivedDataWithRootObject:gameState];
+    RXGameState* steamedState = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+    STAssertNotNil(steamedState, @"steamedState should not be nil");
+    
+    STAssertEquals((int16_t)-2, [steamedState shortForKey:@"durr short"], @"steamedState should have a value of -2 for \"durr short\"");
+    STAssertEquals((uint64_t)0x100000000ULL, [steamedState unsigned64ForKey:@"durr 64"], @"steamedState should keep 64-bit values");
+    STAssertEquals([gameState unsigned32ForKey:@"adomecombo"], [steamedState unsigned32ForKey:@"adomecombo"], @"steamedState should keep the dome combination");
+}
+
+// the dome and marble puzzles read and write a handful of variables many times per frame; time the same access pattern
+// through variable names (what scripts did before variable IDs) and through variable IDs
+- (void)testVariableAccessPerformance {
+    NSString* keys[] = {@"adomecheck", @"tdomeelev", @"pmarblered", @"pmarbleorange", @"pmarbleyellow", @"pmarblegreen", @"pmarbleblue", @"pmarbleviolet"};
+    const uint32_t key_count = sizeof(keys) / sizeof(NSString*);
+    const uint32_t iterations = 100000;
+    
+    uint32_t variables[key_count];
+    for (uint32_t k = 0; k < key_count; k++) {
+        variables[k] = [RXGameState variableIDForKey:keys[k]];
+        [gameState setUnsignedShort:0 forVariable:variables[k]];
+    }
+    
+    NSAutoreleasePool* p = [NSAutoreleasePool new];
+    uint64_t start = RXTimingNow();
+    for (uint32_t i = 0; i < iterations; i++) {
+        NSString* key = keys[i % key_count];
+        [gameState setUnsignedShort:[gameState unsignedShortForKey:key] + 1 forKey:key];
+        if ((i & 1023) == 0) {
+            [p release];
+            p = [NSAutoreleasePool new];
+        }
+    }
+    double key_time = RXTimingTimestampDelta(RXTimingNow(), start);
+    [p release];
+    
+    start = RXTimingNow();
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint32_t variable = variables[i % key_count];
+        [gameState setUnsignedShort:[gameState unsignedShortForVariable:variable] + 1 forVariable:variable];
+    }
+    double id_time = RXTimingTimestampDelta(RXTimingNow(), start);
+    
+    NSLog(@"%u variable updates: %f s by name, %f s by ID", iterations, key_time, id_time);
+    
+    for (uint32_t k = 0; k < key_count; k++)
+        STAssertEquals((uint16_t)(2 * iterations / key_count), [gameState unsignedShortForVariable:variables[k]], @"both loops should update the same variables");
+}
+
+- (NSURL*)_temporaryURL {
+    NSURL* tempFileURL;
+    NSFileHandle* tempFile = BZFSCreateTemporaryFileInDirectory(nil, nil, &tempFileURL, NULL);
+    [tempFile closeFile];
+    BZFSRemoveItemAtURL(tempFileURL, NULL);
+    return tempFileURL;
+}
+
+- (void)testSnapshotsAreIsolated {
+    [gameState setShort:-2 forKey:@"durr short"];
+    [gameState setUnsigned64:0x100000000ULL forKey:@"durr 64"];
+    RXGameStateSnapshot* snapshot = [gameState snapshot];
+    
+    // changes after the snapshot must not show up in it
+    [gameState setShort:5 forKey:@"durr short"];
+    [gameState setUnsignedShort:1 forKey:@"durr new"];
+    
+    NSURL* url = [self _temporaryURL];
+    STAssertTrue([snapshot writeToURL:url error:NULL], @"the snapshot should be written");
+    RXGameState* steamedState = [RXGameState gameStateWithURL:url error:NULL];
+    BZFSRemoveItemAtURL(url, NULL);
+    STAssertNotNil(steamedState, @"steamedState should not be nil");
+    
+    STAssertEquals((int16_t)-2, [steamedState shortForKey:@"durr short"], @"the snapshot should keep the value it was taken with");
+    STAssertEquals((uint64_t)0x100000000ULL, [steamedState unsigned64ForKey:@"durr 64"], @"the snapshot should keep 64-bit values");
+    STAssertFalse([steamedState isKeySet:@"durr new"], @"variables set after the snapshot should not be in it");
+    STAssertEquals([gameState unsigned32ForKey:@"adomecombo"], [steamedState unsigned32ForKey:@"adomecombo"], @"steamedState should keep the dome combination");
+    STAssertEqualObjects([[gameState currentCard] description], [[steamedState currentCard] description], @"steamedState should keep the current card");
+    
+    STAssertEquals((int16_t)5, [gameState shortForKey:@"durr short"], @"the game state should keep its own changes");
+}
+
+- (void)testReadingKeyedArchives {
+    // save files written before the binary format
+    [gameState setUnsignedShort:10 forKey:@"durr"];
+    NSURL* url = [self _temporaryURL];
+    [[NSKeyedArchiver archivedDataWithRootObject:gameState] writeToURL:url atomically:YES];
+    
+    RXGameState* steamedState = [RXGameState gameStateWithURL:url error:NULL];
+    BZFSRemoveItemAtURL(url, NULL);
+    STAssertEquals((uint16_t)10, [steamedState unsignedShortForKey:@"durr"], @"keyed archives should still be read");
+}
+
+- (void)testReadingCorruptedSaves {
+    NSURL* url = [self _temporaryURL];
+    NSData* data = [[gameState snapshot] data];
+    
+    NSError* error = nil;
+    [[data subdataWithRange:NSMakeRange(0, [data length] - 1)] writeToURL:url atomically:YES];
+    STAssertNil([RXGameState gameStateWithURL:url error:&error], @"a truncated save should not be read");
+    STAssertNotNil(error, @"a truncated save should have an error");
+    BZFSRemoveItemAtURL(url, NULL);
+}
+
+// autosaves used to archive the game state with the access lock held, which blocks the script thread; time how long
+// the lock is held by a snapshot and by an archive, and what encoding a snapshot costs on the background thread
+- (void)testSnapshotPerformance {
+    const uint32_t iterations = 1000;
+    
+    NSAutoreleasePool* p = [NSAutoreleasePool new];
+    uint64_t start = RXTimingNow();
+    for (uint32_t i = 0; i < iterations; i++)
+        [NSKeyedArchiver archivedDataWithRootObject:gameState];
+    double archive_time = RXTimingTimestampDelta(RXTimingNow(), start) / iterations;
+    [p release];
+    
+    p = [NSAutoreleasePool new];
+    double snapshot_time = 0.0;
+    double encode_time = 0.0;
+    double copy_time = 0.0;
+    NSUInteger size = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        start = RXTimingNow();
+        RXGameStateSnapshot* snapshot = [gameState snapshot];
+        uint64_t snapshot_end = RXTimingNow();
+        NSData* data = [snapshot data];
+        uint64_t encode_end = RXTimingNow();
+        
+        // the first variable change after a snapshot copies the slots
+        [gameState setUnsignedShort:(uint16_t)i forKey:@"durr"];
+        uint64_t copy_end = RXTimingNow();
+        
+        snapshot_time += RXTimingTimestampDelta(snapshot_end, start);
+        encode_time += RXTimingTimestampDelta(encode_end, snapshot_end);
+        copy_time += RXTimingTimestampDelta(copy_end, encode_end);
+        size = [data length];
+    }
+    [p release];
+    snapshot_time /= iterations;
+    encode_time /= iterations;
+    copy_time /= iterations;
+    
+    NSLog(@"lock held %f us by a snapshot, %f us by a keyed archive; snapshot encoding %f us (%lu bytes); first change after a snapshot %f us",
+          snapshot_time * 1.0e6, archive_time * 1.0e6, encode_time * 1.0e6, (unsigned long)size, copy_time * 1.0e6);
+}
+
 @end
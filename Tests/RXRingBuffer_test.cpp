@@ -0,0 +1,352 @@
+/*
+ *  RXRingBuffer_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 20/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "Utilities/RXRingBuffer.h"
+
+using namespace RX;
+
+
+// the VirtualRingBuffer_test scenarios, with the page size instead of a hard-coded 4 KB
+static int test_buffer(bool mirror) {
+    const uint32_t data = 0xDECAFBAD;
+    uint32_t read_data = 0x0;
+
+    const void* read_pointer;
+    void* write_pointer;
+
+    size_t available_read;
+    size_t available_write;
+    size_t old_available_read;
+    size_t old_available_write;
+
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    printf("-- Testing a %s ring buffer --\n", (mirror) ? "mirrored" : "split");
+
+    RingBuffer buffer(1, mirror);
+    if (!buffer.Valid()) {
+        printf("Could not allocate the buffer!\n");
+        return 1;
+    }
+    printf("capacity = %zu, mirrored = %d\n", buffer.Capacity(), buffer.Mirrored());
+
+    // buffer should be one VM page long and empty
+    if (buffer.Capacity() != page) {
+        printf("Buffer capacity was not rounded up to one VM page.\n");
+        return 1;
+    }
+    if (!buffer.IsEmpty()) {
+        printf("Buffer wasn't empty after initialization.\n");
+        return 1;
+    }
+
+    // buffer should have 0 bytes available for reading
+    available_read = buffer.ReadSpan(&read_pointer);
+    if (available_read != 0) {
+        printf("Buffer reported bytes available for reading after initialization.\n");
+        return 1;
+    }
+
+    // buffer should have one VM page of free space
+    available_write = buffer.WriteSpan(&write_pointer);
+    if (available_write != page) {
+        printf("Buffer reported an incorrect number of bytes available for writing after initialization.\n");
+        return 1;
+    }
+
+    // buffer should still have 0 bytes available for reading
+    available_read = buffer.ReadSpan(&read_pointer);
+    if (available_read != 0) {
+        printf("Buffer reported bytes available for reading before first write was committed.\n");
+        return 1;
+    }
+
+    // write some bytes and commit
+    memcpy(write_pointer, &data, sizeof(data));
+    buffer.DidWrite(sizeof(data));
+
+    if (buffer.IsEmpty()) {
+        printf("Buffer reported empty after first write was committed.\n");
+        return 1;
+    }
+
+    available_read = buffer.ReadSpan(&read_pointer);
+    if (available_read != sizeof(data)) {
+        printf("Buffer reported an incorrect number of bytes available for reading after first write was committed.\n");
+        return 1;
+    }
+
+    old_available_write = available_write;
+    available_write = buffer.WriteSpan(&write_pointer);
+    if (available_write != old_available_write - sizeof(data)) {
+        printf("Buffer reported an incorrect number of bytes available for writing after first write was committed.\n");
+        return 1;
+    }
+
+    // read some bytes
+    memcpy(&read_data, read_pointer, sizeof(data));
+    buffer.DidRead(sizeof(data));
+
+    if (read_data != data) {
+        printf("Incorrect data read back from the buffer.\n");
+        return 1;
+    }
+
+    if (!buffer.IsEmpty()) {
+        printf("Buffer reported not empty after first read was committed.\n");
+        return 1;
+    }
+
+    old_available_read = available_read;
+    available_read = buffer.ReadSpan(&read_pointer);
+    if (available_read != old_available_read - sizeof(data)) {
+        printf("Buffer reported an incorrect number of bytes available for reading after first read was committed.\n");
+        return 1;
+    }
+
+    // the write span may stop at the end of the storage if the buffer is not mirrored
+    old_available_write = available_write;
+    available_write = buffer.WriteSpan(&write_pointer);
+    if (buffer.Mirrored() && available_write != old_available_write + sizeof(data)) {
+        printf("Buffer reported an incorrect number of bytes available for writing after first read was committed.\n");
+        return 1;
+    }
+
+    // write some bytes and commit, then test empty
+    memcpy(write_pointer, &data, sizeof(data));
+    buffer.DidWrite(sizeof(data));
+    buffer.Empty();
+
+    if (!buffer.IsEmpty()) {
+        printf("Buffer reported not empty after explicit empty.\n");
+        return 1;
+    }
+
+    // let's fill the buffer
+    available_write = buffer.WriteSpan(&write_pointer);
+    if (available_write != page) {
+        printf("Buffer reported an incorrect number of bytes available for writing after empty.\n");
+        return 1;
+    }
+
+    for (size_t offset = 0; offset < page; offset += sizeof(data))
+        memcpy(static_cast<uint8_t*>(write_pointer) + offset, &data, sizeof(data));
+    buffer.DidWrite(page);
+
+    available_write = buffer.WriteSpan(&write_pointer);
+    if (available_write != 0) {
+        printf("Buffer reported bytes available for writing after buffer fill was committed.\n");
+        return 1;
+    }
+
+    available_read = buffer.ReadSpan(&read_pointer);
+    if (available_read != page) {
+        printf("Buffer reported an incorrect number of bytes available for reading after buffer fill was committed.\n");
+        return 1;
+    }
+
+    /*
+        let's test wrap around
+        method:
+                - read half the fill bytes (puts the read pointer halfway through the nominal length)
+                - write half the nominal length (puts the write pointer at the read pointer)
+                - read the nominal length of bytes
+                - test for data coherency
+    */
+
+    buffer.DidRead(page / 2);
+
+    available_read = buffer.ReadSpan(&read_pointer);
+    if (available_read != page / 2) {
+        printf("Buffer reported an incorrect number of bytes available for reading after reading half the buffer fill bytes. 0x%zx bytes\n", available_read);
+        return 1;
+    }
+
+    available_write = buffer.WriteSpan(&write_pointer);
+    if (available_write != page / 2) {
+        printf("Buffer reported an incorrect number of bytes available for writing after reading half the buffer fill bytes.\n");
+        return 1;
+    }
+
+    // write a distinct pattern in the wrapped half so that we can check it comes back in order
+    const uint32_t wrapped_data = 0xFEEDFACE;
+    for (size_t offset = 0; offset < page / 2; offset += sizeof(wrapped_data))
+        memcpy(static_cast<uint8_t*>(write_pointer) + offset, &wrapped_data, sizeof(wrapped_data));
+    buffer.DidWrite(page / 2);
+
+    // the read span only covers the wrapped bytes if the buffer is mirrored
+    available_read = buffer.ReadSpan(&read_pointer);
+    if (available_read != ((buffer.Mirrored()) ? page : page / 2)) {
+        printf("Buffer reported an incorrect number of bytes available for reading after wrap around write was committed.\n");
+        return 1;
+    }
+    if (buffer.BytesAvailableToRead() != page) {
+        printf("Buffer reported an incorrect fill level after wrap around write was committed.\n");
+        return 1;
+    }
+
+    // read everything back through the copy helper, which handles both mirrored and split spans
+    uint8_t* contents = new uint8_t[page];
+    if (buffer.Read(contents, page) != page) {
+        printf("Could not read back the nominal length after wrap around write.\n");
+        delete[] contents;
+        return 1;
+    }
+    for (size_t offset = 0; offset < page; offset += sizeof(read_data)) {
+        memcpy(&read_data, contents + offset, sizeof(read_data));
+        if (read_data != ((offset < page / 2) ? data : wrapped_data)) {
+            printf("Incorrect data read back from the buffer after wrap around write at offset 0x%zx.\n", offset);
+            delete[] contents;
+            return 1;
+        }
+    }
+    delete[] contents;
+
+    if (!buffer.IsEmpty()) {
+        printf("Buffer reported not empty after reading all wrap around bytes.\n");
+        return 1;
+    }
+
+    printf("-- Ring buffer test passed --\n\n");
+    return 0;
+}
+
+struct benchmark_context {
+    RingBuffer* buffer;
+    uint64_t total;
+    size_t chunk;
+    bool failed;
+};
+
+static void* benchmark_producer(void* arg) {
+    benchmark_context* context = reinterpret_cast<benchmark_context*>(arg);
+    uint64_t sequence = 0;
+    uint64_t written = 0;
+
+    while (written < context->total) {
+        void* span;
+        size_t available = context->buffer->WriteSpan(&span);
+        if (available < sizeof(uint64_t)) {
+            sched_yield();
+            continue;
+        }
+
+        size_t length = (available < context->chunk) ? available : context->chunk;
+        length &= ~(sizeof(uint64_t) - 1);
+        if (length > context->total - written)
+            length = static_cast<size_t>(context->total - written);
+
+        uint64_t* words = reinterpret_cast<uint64_t*>(span);
+        for (size_t i = 0; i < length / sizeof(uint64_t); i++)
+            words[i] = sequence++;
+
+        context->buffer->DidWrite(length);
+        written += length;
+    }
+
+    return NULL;
+}
+
+static void* benchmark_consumer(void* arg) {
+    benchmark_context* context = reinterpret_cast<benchmark_context*>(arg);
+    uint64_t sequence = 0;
+    uint64_t read = 0;
+
+    while (read < context->total) {
+        const void* span;
+        size_t available = context->buffer->ReadSpan(&span);
+        if (available < sizeof(uint64_t)) {
+            sched_yield();
+            continue;
+        }
+
+        size_t length = (available < context->chunk) ? available : context->chunk;
+        length &= ~(sizeof(uint64_t) - 1);
+
+        const uint64_t* words = reinterpret_cast<const uint64_t*>(span);
+        for (size_t i = 0; i < length / sizeof(uint64_t); i++) {
+            if (words[i] != sequence++)
+                context->failed = true;
+        }
+
+        context->buffer->DidRead(length);
+        read += length;
+    }
+
+    return NULL;
+}
+
+// one producer and one consumer thread stream sequence numbers through the buffer; the consumer checks every word
+static int benchmark_buffer(size_t capacity, size_t chunk, bool mirror) {
+    RingBuffer buffer(capacity, mirror);
+    if (!buffer.Valid()) {
+        printf("Could not allocate the benchmark buffer!\n");
+        return 1;
+    }
+
+    benchmark_context context;
+    context.buffer = &buffer;
+    context.total = 1ULL << 28;
+    context.chunk = chunk;
+    context.failed = false;
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+
+    pthread_t producer, consumer;
+    pthread_create(&consumer, NULL, benchmark_consumer, &context);
+    pthread_create(&producer, NULL, benchmark_producer, &context);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+
+    gettimeofday(&end, NULL);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) * 1.0e-6;
+
+    if (context.failed) {
+        printf("Consumer read back out-of-sequence data (capacity %zu, chunk %zu).\n", buffer.Capacity(), chunk);
+        return 1;
+    }
+
+    printf("capacity %7zu, chunk %6zu, mirrored %d: %8.1f MB/s\n", buffer.Capacity(), chunk, buffer.Mirrored(), (context.total / seconds) / (1024.0 * 1024.0));
+    return 0;
+}
+
+int main(int argc, char* const argv[]) {
+    int result = test_buffer(true);
+    if (result != 0)
+        return result;
+
+    result = test_buffer(false);
+    if (result != 0)
+        return result;
+
+    printf("-- Two-thread throughput --\n");
+    static const size_t capacities[] = {0x1000, 0x10000, 0x40000};
+    static const size_t chunks[] = {512, 4096};
+    for (size_t i = 0; i < sizeof(capacities) / sizeof(capacities[0]); i++) {
+        for (size_t j = 0; j < sizeof(chunks) / sizeof(chunks[0]); j++) {
+            result = benchmark_buffer(capacities[i], chunks[j], true);
+            if (result != 0)
+                return result;
+            result = benchmark_buffer(capacities[i], chunks[j], false);
+            if (result != 0)
+                return result;
+        }
+    }
+
+    return 0;
+}
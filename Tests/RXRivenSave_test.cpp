@@ -0,0 +1,246 @@
+/*
+ *  RXRivenSave_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 28/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+// Imports every original engine save in a directory (by default, Tests/original engine games) and compares the
+// variables with the .plist that was made from the same save by dump_save. The variables are imported the way
+// RXGameState imports them, into dense slots indexed by variable IDs interned from the lowercased names.
+//
+//  c++ -O2 -I. Tests/RXRivenSave_test.cpp Engine/RXRivenSave.cpp -o RXRivenSave_test
+
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Engine/RXRivenSave.h"
+
+
+static int failures = 0;
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s\n", message); \
+            failures++; \
+        } \
+    } while (0)
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1.0e-6;
+}
+
+static bool read_file(const std::string& path, std::vector<uint8_t>& data) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return false;
+    uint8_t buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+    fclose(fp);
+    return true;
+}
+
+// reads the <key>/<integer> pairs of a flat XML property list
+static bool read_plist(const std::string& path, std::map<std::string, uint32_t>& values) {
+    std::vector<uint8_t> data;
+    if (!read_file(path, data))
+        return false;
+    std::string xml(data.begin(), data.end());
+
+    size_t position = 0;
+    while ((position = xml.find("<key>", position)) != std::string::npos) {
+        size_t key_end = xml.find("</key>", position);
+        size_t integer = xml.find("<integer>", key_end);
+        if (key_end == std::string::npos || integer == std::string::npos)
+            return false;
+
+        std::string key = xml.substr(position + 5, key_end - position - 5);
+        values[key] = static_cast<uint32_t>(strtoul(xml.c_str() + integer + 9, NULL, 10));
+        position = integer;
+    }
+    return true;
+}
+
+// variable slots, with the IDs interned from the lowercased names like RXGameState does
+struct slots_t {
+    std::map<std::string, uint32_t> ids;
+    std::vector<std::string> keys;
+    std::vector<uint32_t> values;
+    std::vector<bool> set;
+
+    uint32_t id_for_key(const std::string& key) {
+        std::map<std::string, uint32_t>::iterator i = ids.find(key);
+        if (i != ids.end())
+            return i->second;
+        uint32_t id = static_cast<uint32_t>(keys.size());
+        ids[key] = id;
+        keys.push_back(key);
+        return id;
+    }
+
+    void set_value(uint32_t id, uint32_t value) {
+        if (id >= values.size()) {
+            values.resize(std::max<size_t>(id + 1, 2 * values.size()));
+            set.resize(values.size());
+        }
+        values[id] = value;
+        set[id] = true;
+    }
+};
+
+struct import_t {
+    slots_t* slots;
+    std::vector<uint32_t> ids;      // variable ID of each save variable
+    std::vector<std::string> names; // plist key of each save variable
+};
+
+static void import_variable(void* context, uint32_t index, const char* name, size_t name_length, uint32_t value) {
+    import_t* import = static_cast<import_t*>(context);
+
+    // unnamed variables keep their index as their key, like dump_save does
+    char index_key[16];
+    std::string key;
+    if (name)
+        key.assign(name, name_length);
+    else {
+        snprintf(index_key, sizeof(index_key), "%u", index);
+        key = index_key;
+    }
+
+    std::string lowercase_key(key);
+    for (size_t i = 0; i < lowercase_key.size(); i++)
+        lowercase_key[i] = static_cast<char>(tolower(lowercase_key[i]));
+
+    uint32_t id = import->slots->id_for_key(lowercase_key);
+    import->slots->set_value(id, value);
+    import->ids.push_back(id);
+    import->names.push_back(key);
+}
+
+static void test_save(const std::string& directory, const std::string& name, slots_t& slots) {
+    std::string base = directory + "/" + name.substr(0, name.size() - 4);
+
+    std::vector<uint8_t> save;
+    std::map<std::string, uint32_t> expected;
+    if (!read_file(base + ".rvn", save) || !read_plist(base + ".plist", expected)) {
+        printf("%s: could not read the save or its plist\n", name.c_str());
+        failures++;
+        return;
+    }
+
+    // import the save a number of times to time it
+    const int iterations = 200;
+    import_t import;
+    import.slots = &slots;
+    int error = kRXRivenSaveNoError;
+    double start = now();
+    for (int i = 0; i < iterations && error == kRXRivenSaveNoError; i++) {
+        import.ids.clear();
+        import.names.clear();
+        error = rx_riven_save_read_variables(&save[0], save.size(), import_variable, &import);
+    }
+    double import_time = (now() - start) / iterations;
+
+    if (error != kRXRivenSaveNoError) {
+        printf("%s: %s\n", name.c_str(), rx_riven_save_error_description(error));
+        failures++;
+        return;
+    }
+
+    uint32_t mismatches = 0;
+    for (size_t i = 0; i < import.ids.size(); i++) {
+        std::map<std::string, uint32_t>::iterator e = expected.find(import.names[i]);
+        if (e == expected.end() || e->second != slots.values[import.ids[i]]) {
+            if (mismatches++ < 5)
+                printf("%s: variable %s should be %u, is %u\n", name.c_str(), import.names[i].c_str(),
+                       (e == expected.end()) ? 0 : e->second, slots.values[import.ids[i]]);
+        }
+    }
+    CHECK(mismatches == 0, "imported variables should match the plist");
+    CHECK(import.ids.size() == expected.size(), "every variable of the plist should be imported");
+
+    printf("%-52s %4zu variables  %8.2f us\n", name.c_str(), import.ids.size(), import_time * 1.0e6);
+}
+
+static void test_corrupted_saves(const std::string& path) {
+    printf("\n-- Reading corrupted saves --\n");
+
+    std::vector<uint8_t> save;
+    if (!read_file(path, save))
+        return;
+
+    slots_t slots;
+    import_t import;
+    import.slots = &slots;
+
+    CHECK(rx_riven_save_read_variables(&save[0], 3, import_variable, &import) == kRXRivenSaveNotMohawk, "a short file should not be read");
+
+    // every truncation must be read within bounds and either fail or read a prefix of the variables
+    for (size_t length = 0; length < save.size(); length += 7)
+        rx_riven_save_read_variables(&save[0], length, import_variable, &import);
+
+    // and so must every corrupted byte of the headers and of the resource directory, which is at the end of a save
+    for (size_t offset = 0; offset < save.size(); offset++) {
+        if (offset >= 28 && offset + 256 < save.size())
+            continue;
+        std::vector<uint8_t> corrupted(save);
+        corrupted[offset] ^= 0xa5;
+        rx_riven_save_read_variables(&corrupted[0], corrupted.size(), import_variable, &import);
+    }
+
+    printf("\n");
+}
+
+int main(int argc, char* const argv[]) {
+    std::string directory = (argc > 1) ? argv[1] : "Tests/original engine games";
+
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        perror(directory.c_str());
+        return 1;
+    }
+    std::vector<std::string> saves;
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".rvn") == 0)
+            saves.push_back(name);
+    }
+    closedir(dir);
+    std::sort(saves.begin(), saves.end());
+
+    printf("-- Importing %zu original engine saves --\n", saves.size());
+    CHECK(!saves.empty(), "there should be saves to import");
+
+    // the slots are shared by every save, like the process-wide variable IDs
+    slots_t slots;
+    for (size_t i = 0; i < saves.size(); i++)
+        test_save(directory, saves[i], slots);
+
+    if (!saves.empty())
+        test_corrupted_saves(directory + "/" + saves[0]);
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("-- All original engine save tests passed --\n");
+    return 0;
+}
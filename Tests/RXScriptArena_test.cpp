@@ -0,0 +1,257 @@
+/*
+ *  RXScriptArena_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 26/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "Engine/RXScriptArena.h"
+#include "Engine/RXScriptIR.h"
+#include "Engine/RXScriptCommandAliases.h"
+
+
+static int failures = 0;
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s\n", message); \
+            failures++; \
+        } \
+    } while (0)
+
+struct collected_t {
+    std::vector<uint16_t> events;
+    std::vector<int> codes;
+};
+
+static void collect_violation(void* context, uint16_t event, const rx_script_violation_t* violation) {
+    collected_t* collected = static_cast<collected_t*>(context);
+    collected->events.push_back(event);
+    collected->codes.push_back(violation->code);
+}
+
+// appends a big-endian word to a script
+static void push_be16(std::vector<uint8_t>& script, uint16_t value) {
+    script.push_back(static_cast<uint8_t>(value >> 8));
+    script.push_back(static_cast<uint8_t>(value & 0xff));
+}
+
+static void push_program(std::vector<uint8_t>& script, uint16_t event, const std::vector<uint16_t>& words, uint16_t opcode_count) {
+    push_be16(script, event);
+    push_be16(script, opcode_count);
+    for (size_t i = 0; i < words.size(); i++)
+        push_be16(script, words[i]);
+}
+
+static void set_event_count(std::vector<uint8_t>& script, uint16_t count) {
+    script[0] = static_cast<uint8_t>(count >> 8);
+    script[1] = static_cast<uint8_t>(count & 0xff);
+}
+
+static bool program_equals(const rx_script_program_t& program, const std::vector<uint16_t>& words, uint16_t opcode_count) {
+    return program.opcode_count == opcode_count && program.length == 2 * words.size() &&
+           (words.empty() || memcmp(program.opcodes, &words[0], program.length) == 0);
+}
+
+static void test_decoding() {
+    printf("-- Decoding a script into an arena --\n");
+
+    // open card: activate PLST 1; open card: set variable 3 to 4; mouse down: a switch on variable 3 with a default case
+    // that goes to card 9; an unknown event; start rendering: a set variable with 1 argument, which is rejected
+    std::vector<uint16_t> plst;
+    plst.push_back(RX_COMMAND_ACTIVATE_PLST); plst.push_back(1); plst.push_back(1);
+    std::vector<uint16_t> set_variable;
+    set_variable.push_back(RX_COMMAND_SET_VARIABLE); set_variable.push_back(2); set_variable.push_back(3); set_variable.push_back(4);
+    std::vector<uint16_t> branch;
+    branch.push_back(RX_COMMAND_BRANCH); branch.push_back(2); branch.push_back(3); branch.push_back(1);
+    branch.push_back(0xffff); branch.push_back(1);
+    branch.push_back(RX_COMMAND_GOTO_CARD); branch.push_back(1); branch.push_back(9);
+    std::vector<uint16_t> short_set_variable;
+    short_set_variable.push_back(RX_COMMAND_SET_VARIABLE); short_set_variable.push_back(1); short_set_variable.push_back(3);
+
+    std::vector<uint8_t> script;
+    push_be16(script, 0);
+    push_program(script, kScriptTypeCardOpen, plst, 1);
+    push_program(script, kScriptTypeMouseDown, branch, 1);
+    push_program(script, kScriptTypeCardOpen, set_variable, 1);
+    push_program(script, 42, plst, 1);
+    push_program(script, kScriptTypeStartRendering, short_set_variable, 1);
+    set_event_count(script, 5);
+    size_t length = script.size();
+
+    // trailing data, such as the next hotspot record
+    push_be16(script, 0xbeef);
+
+    collected_t collected;
+    uint32_t script_length = 0;
+    rx_script_t* arena = rx_script_decode(&script[0], script.size(), &script_length, collect_violation, &collected);
+    CHECK(arena != NULL, "the script should decode");
+    CHECK(script_length == length, "the script length should be measured");
+
+    CHECK(rx_script_program_count(arena, kScriptTypeCardOpen) == 2, "there should be 2 open card programs");
+    CHECK(rx_script_program_count(arena, kScriptTypeMouseDown) == 1, "there should be 1 mouse down program");
+    CHECK(rx_script_program_count(arena, kScriptTypeStartRendering) == 1, "the rejected program should be kept");
+    CHECK(rx_script_program_count(arena, kScriptTypeIdle) == 0, "there should be no idle program");
+    CHECK(rx_script_program_count(arena, 42) == 0, "unknown events should have no programs");
+
+    CHECK(program_equals(rx_script_program(arena, kScriptTypeCardOpen, 0), plst, 1), "programs should keep their order");
+    CHECK(program_equals(rx_script_program(arena, kScriptTypeCardOpen, 1), set_variable, 1), "programs should keep their order");
+    CHECK(program_equals(rx_script_program(arena, kScriptTypeMouseDown, 0), branch, 1), "programs should be host-endian");
+    CHECK(program_equals(rx_script_program(arena, kScriptTypeStartRendering, 0), std::vector<uint16_t>(), 0),
+          "rejected programs should be empty");
+    CHECK(rx_script_program(arena, kScriptTypeCardOpen, 2).opcodes == NULL, "out of range programs should be empty views");
+    CHECK(rx_script_program(arena, kScriptTypeCardOpen, 0).ir == NULL, "decoded programs are not linked");
+
+    CHECK(collected.codes.size() == 2 && collected.codes[0] == kRXScriptViolationUnknownEvent && collected.events[0] == 42 &&
+          collected.codes[1] == kRXScriptViolationArgumentCount && collected.events[1] == kScriptTypeStartRendering,
+          "violations should be reported with their event");
+
+    // program data and entries are 4-byte aligned within the arena
+    for (uint16_t event = 0; event < RX_SCRIPT_EVENT_TYPE_COUNT; event++) {
+        for (uint32_t i = 0; i < rx_script_program_count(arena, event); i++)
+            CHECK(((uintptr_t)rx_script_program(arena, event, i).opcodes & 3) == 0, "programs should be aligned");
+    }
+
+    printf("%zu byte arena for a %u byte script\n", rx_script_size(arena), script_length);
+    rx_script_free(arena);
+
+    printf("\n");
+}
+
+static void test_truncated_scripts() {
+    printf("-- Decoding truncated scripts --\n");
+
+    std::vector<uint16_t> plst;
+    plst.push_back(RX_COMMAND_ACTIVATE_PLST); plst.push_back(1); plst.push_back(1);
+
+    std::vector<uint8_t> script;
+    push_be16(script, 3);
+    push_program(script, kScriptTypeCardOpen, plst, 1);
+    push_program(script, kScriptTypeCardOpen, plst, 1);
+    script.resize(script.size() - 2);
+
+    collected_t collected;
+    uint32_t script_length = 0;
+    rx_script_t* arena = rx_script_decode(&script[0], script.size(), &script_length, collect_violation, &collected);
+    CHECK(arena != NULL, "a truncated script should decode");
+    CHECK(rx_script_program_count(arena, kScriptTypeCardOpen) == 1, "only the programs before the truncation should be kept");
+    CHECK(script_length == script.size(), "a truncated script should run to the end of its buffer");
+    CHECK(!collected.codes.empty() && collected.codes[0] == kRXScriptViolationTruncated, "the truncation should be reported");
+    rx_script_free(arena);
+
+    arena = rx_script_decode(&script[0], 1, &script_length, NULL, NULL);
+    CHECK(arena != NULL && rx_script_program_count(arena, kScriptTypeCardOpen) == 0, "an empty buffer should decode to no programs");
+    rx_script_free(arena);
+
+    printf("\n");
+}
+
+static void test_editing() {
+    printf("-- Clearing, replacing and linking programs --\n");
+
+    std::vector<uint16_t> plst;
+    plst.push_back(RX_COMMAND_ACTIVATE_PLST); plst.push_back(1); plst.push_back(1);
+    std::vector<uint16_t> cursor;
+    cursor.push_back(RX_COMMAND_SET_CURSOR); cursor.push_back(1); cursor.push_back(3000);
+
+    std::vector<uint8_t> script;
+    push_be16(script, 4);
+    push_program(script, kScriptTypeMouseDown, plst, 1);
+    push_program(script, kScriptTypeMouseInside, cursor, 1);
+    push_program(script, kScriptTypeMouseInside, cursor, 1);
+    push_program(script, kScriptTypeMouseUp, plst, 1);
+
+    rx_script_t* arena = rx_script_decode(&script[0], script.size(), NULL, NULL, NULL);
+
+    rx_script_clear_event(arena, kScriptTypeMouseInside);
+    CHECK(rx_script_program_count(arena, kScriptTypeMouseInside) == 0, "cleared events should have no programs");
+    CHECK(program_equals(rx_script_program(arena, kScriptTypeMouseDown, 0), plst, 1) &&
+          program_equals(rx_script_program(arena, kScriptTypeMouseUp, 0), plst, 1), "other events should be unchanged");
+
+    // drop the opcode of the mouse down program
+    arena = rx_script_replace_program(arena, kScriptTypeMouseDown, 0, &plst[0], 0, 0);
+    CHECK(program_equals(rx_script_program(arena, kScriptTypeMouseDown, 0), std::vector<uint16_t>(), 0), "the program should be replaced");
+    CHECK(program_equals(rx_script_program(arena, kScriptTypeMouseUp, 0), plst, 1), "other programs should be unchanged");
+
+    arena = rx_script_replace_program(arena, kScriptTypeMouseDown, 0, &cursor[0], 2 * cursor.size(), 1);
+    CHECK(program_equals(rx_script_program(arena, kScriptTypeMouseDown, 0), cursor, 1), "the program should be replaced");
+
+    arena = rx_script_link(arena);
+    for (uint16_t event = 0; event < RX_SCRIPT_EVENT_TYPE_COUNT; event++) {
+        for (uint32_t i = 0; i < rx_script_program_count(arena, event); i++) {
+            rx_script_program_t program = rx_script_program(arena, event, i);
+            CHECK(program.ir && rx_script_ir_is_valid(program.ir, program.ir_length), "linked programs should have a valid IR");
+            CHECK(((uintptr_t)program.ir & 3) == 0, "IRs should be aligned");
+        }
+    }
+    CHECK(program_equals(rx_script_program(arena, kScriptTypeMouseDown, 0), cursor, 1), "linking should keep the programs");
+
+    // replacing a linked program drops its IR only
+    arena = rx_script_replace_program(arena, kScriptTypeMouseUp, 0, &cursor[0], 2 * cursor.size(), 1);
+    CHECK(rx_script_program(arena, kScriptTypeMouseUp, 0).ir == NULL, "a replaced program should lose its IR");
+    CHECK(rx_script_program(arena, kScriptTypeMouseDown, 0).ir != NULL, "other programs should keep their IR");
+
+    rx_script_free(arena);
+
+    printf("\n");
+}
+
+static void test_random_scripts() {
+    printf("-- Decoding random scripts --\n");
+
+    // random scripts must never be read out of bounds, and every program that is kept must compile
+    uint32_t programs = 0;
+    srandom(37);
+    for (uint32_t i = 0; i < 50000; i++) {
+        std::vector<uint8_t> script;
+        push_be16(script, random() % 6);
+        size_t words = random() % 48;
+        for (size_t w = 0; w < words; w++) {
+            switch (random() % 4) {
+                case 0: push_be16(script, RX_COMMAND_BRANCH); break;
+                case 1: push_be16(script, random() % 3); break;
+                case 2: push_be16(script, random() % 50); break;
+                default: push_be16(script, random()); break;
+            }
+        }
+
+        uint32_t script_length;
+        rx_script_t* arena = rx_script_decode(&script[0], script.size(), &script_length, NULL, NULL);
+        CHECK(arena && script_length <= script.size(), "random scripts should decode within their buffer");
+
+        arena = rx_script_link(arena);
+        for (uint16_t event = 0; event < RX_SCRIPT_EVENT_TYPE_COUNT; event++) {
+            for (uint32_t p = 0; p < rx_script_program_count(arena, event); p++) {
+                CHECK(rx_script_program(arena, event, p).ir != NULL, "kept programs should compile");
+                programs++;
+            }
+        }
+        rx_script_free(arena);
+    }
+
+    printf("%u programs kept\n\n", programs);
+}
+
+int main(int argc, char* const argv[]) {
+    test_decoding();
+    test_truncated_scripts();
+    test_editing();
+    test_random_scripts();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("-- All script arena tests passed --\n");
+    return 0;
+}
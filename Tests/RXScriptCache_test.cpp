@@ -0,0 +1,272 @@
+/*
+ *  RXScriptCache_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 27/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "Engine/RXScriptCache.h"
+#include "Engine/RXScriptCommandAliases.h"
+#include "Engine/RXScriptIR.h"
+#include "Engine/RXScriptVerifier.h"
+
+
+static int failures = 0;
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s\n", message); \
+            failures++; \
+        } \
+    } while (0)
+
+// appends a big-endian word to a script
+static void push_be16(std::vector<uint8_t>& script, uint16_t value) {
+    script.push_back(static_cast<uint8_t>(value >> 8));
+    script.push_back(static_cast<uint8_t>(value & 0xff));
+}
+
+// a script with an open card program and a mouse down program, linked
+static rx_script_t* make_script(uint16_t card_id, uint32_t* script_length) {
+    std::vector<uint8_t> script;
+    push_be16(script, 2);
+    push_be16(script, kScriptTypeCardOpen);
+    push_be16(script, 1);
+    push_be16(script, RX_COMMAND_ACTIVATE_PLST); push_be16(script, 1); push_be16(script, 1);
+    push_be16(script, kScriptTypeMouseDown);
+    push_be16(script, 1);
+    push_be16(script, RX_COMMAND_GOTO_CARD); push_be16(script, 1); push_be16(script, card_id);
+
+    rx_script_t* arena = rx_script_decode(&script[0], script.size(), script_length, NULL, NULL);
+    return rx_script_link(arena);
+}
+
+// a script with an open card program made of nested switches, linked, so that its IR has case tables
+static rx_script_t* make_switch_script(uint32_t* script_length) {
+    std::vector<uint8_t> script;
+    push_be16(script, 1);
+    push_be16(script, kScriptTypeCardOpen);
+    push_be16(script, 2);
+    push_be16(script, RX_COMMAND_ACTIVATE_PLST); push_be16(script, 1); push_be16(script, 1);
+    push_be16(script, RX_COMMAND_BRANCH); push_be16(script, 2); push_be16(script, 5); push_be16(script, 3);
+        push_be16(script, 0); push_be16(script, 1);
+            push_be16(script, RX_COMMAND_GOTO_CARD); push_be16(script, 1); push_be16(script, 7);
+        push_be16(script, 1); push_be16(script, 1);
+            push_be16(script, RX_COMMAND_BRANCH); push_be16(script, 2); push_be16(script, 6); push_be16(script, 2);
+                push_be16(script, 40); push_be16(script, 1);
+                    push_be16(script, RX_COMMAND_ACTIVATE_PLST); push_be16(script, 1); push_be16(script, 2);
+                push_be16(script, 0xffff); push_be16(script, 0);
+        push_be16(script, 0xffff); push_be16(script, 1);
+            push_be16(script, RX_COMMAND_ACTIVATE_PLST); push_be16(script, 1); push_be16(script, 3);
+
+    rx_script_t* arena = rx_script_decode(&script[0], script.size(), script_length, NULL, NULL);
+    return rx_script_link(arena);
+}
+
+// runs an IR and checks that everything it hands the engine lies within the IR and that case blocks do not nest
+// deeper than the verifier allows
+struct bounds_context {
+    const uint8_t* ir;
+    uint32_t ir_length;
+    uint16_t value;
+    uint32_t depth;
+    bool in_bounds;
+};
+
+static uint16_t bounds_variable_value(void* ctx, uint16_t) {
+    return reinterpret_cast<bounds_context*>(ctx)->value;
+}
+
+static void bounds_execute_command(void* ctx, uint16_t, uint16_t argc, const uint16_t* argv) {
+    bounds_context* context = reinterpret_cast<bounds_context*>(ctx);
+    const uint8_t* start = reinterpret_cast<const uint8_t*>(argv);
+    if (start < context->ir + 4 || start + 2 * argc > context->ir + context->ir_length)
+        context->in_bounds = false;
+}
+
+static bool bounds_should_abort(void*) {
+    return false;
+}
+
+static void bounds_enter_block(void* ctx) {
+    bounds_context* context = reinterpret_cast<bounds_context*>(ctx);
+    if (++context->depth > RX_SCRIPT_VERIFIER_MAX_DEPTH + 1)
+        context->in_bounds = false;
+}
+
+static void bounds_exit_block(void* ctx) {
+    reinterpret_cast<bounds_context*>(ctx)->depth--;
+}
+
+static bool executes_in_bounds(const rx_script_t* script) {
+    for (uint16_t event = 0; event < RX_SCRIPT_EVENT_TYPE_COUNT; event++) {
+        uint32_t count = rx_script_program_count(script, event);
+        for (uint32_t i = 0; i < count; i++) {
+            rx_script_program_t program = rx_script_program(script, event, i);
+            if (!program.ir)
+                continue;
+
+            // take every case of the switches, and a value no case has
+            static const uint16_t values[] = {0, 1, 3, 40, 0xffff};
+            for (size_t v = 0; v < sizeof(values) / sizeof(values[0]); v++) {
+                bounds_context context = {static_cast<const uint8_t*>(program.ir), program.ir_length, values[v], 0, true};
+                rx_script_ir_executor_t executor = {&context, bounds_variable_value, bounds_execute_command,
+                                                    bounds_should_abort, bounds_enter_block, bounds_exit_block, NULL, NULL};
+                rx_script_ir_execute(program.ir, &executor);
+                if (!context.in_bounds)
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool read_file(const char* path, std::vector<uint8_t>& data) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+        return false;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+    fclose(fp);
+    return true;
+}
+
+static void write_file(const char* path, const std::vector<uint8_t>& data) {
+    FILE* fp = fopen(path, "wb");
+    if (!data.empty())
+        fwrite(&data[0], 1, data.size(), fp);
+    fclose(fp);
+}
+
+static void test_round_trip(const char* path) {
+    printf("-- Writing and reading cache entries --\n");
+
+    rx_script_t* scripts[3];
+    uint32_t script_lengths[3];
+    for (uint16_t i = 0; i < 3; i++)
+        scripts[i] = make_script(i + 10, &script_lengths[i]);
+
+    uint64_t hash = rx_script_cache_hash("HSPT", 4);
+    CHECK(hash != rx_script_cache_hash("HSPU", 4), "different resources should have different hashes");
+    CHECK(rx_script_cache_write(path, hash, 3, scripts, script_lengths), "the entry should be written");
+
+    rx_script_t* read_scripts[3];
+    uint32_t read_lengths[3];
+    CHECK(rx_script_cache_read(path, hash, 3, read_scripts, read_lengths) == 3, "the entry should be read");
+    for (int i = 0; i < 3; i++) {
+        CHECK(rx_script_size(read_scripts[i]) == rx_script_size(scripts[i]) &&
+              memcmp(read_scripts[i], scripts[i], rx_script_size(scripts[i])) == 0, "the arenas should round-trip");
+        CHECK(read_lengths[i] == script_lengths[i], "the script lengths should round-trip");
+
+        rx_script_program_t program = rx_script_program(read_scripts[i], kScriptTypeMouseDown, 0);
+        CHECK(program.ir != NULL && program.opcodes[2] == i + 10, "the programs should be usable");
+        rx_script_free(read_scripts[i]);
+    }
+
+    CHECK(rx_script_cache_read(path, hash + 1, 3, read_scripts, read_lengths) == -1, "a stale entry should be a miss");
+    CHECK(rx_script_cache_read(path, hash, 2, read_scripts, read_lengths) == -1, "an entry that is too large should be a miss");
+    CHECK(rx_script_cache_read("/nonexistent/0.hspt", hash, 3, read_scripts, read_lengths) == -1, "a missing entry should be a miss");
+
+    // empty resources, such as a card without hotspots
+    CHECK(rx_script_cache_write(path, hash, 0, NULL, NULL), "an empty entry should be written");
+    CHECK(rx_script_cache_read(path, hash, 0, read_scripts, read_lengths) == 0, "an empty entry should be read");
+
+    for (int i = 0; i < 3; i++)
+        rx_script_free(scripts[i]);
+
+    printf("\n");
+}
+
+static void test_invalid_entries(const char* path) {
+    printf("-- Rejecting invalid cache entries --\n");
+
+    uint32_t script_length;
+    rx_script_t* script = make_switch_script(&script_length);
+    CHECK(rx_script_program(script, kScriptTypeCardOpen, 0).ir != NULL, "the switch program should compile");
+    uint64_t hash = rx_script_cache_hash(&script_length, sizeof(script_length));
+    CHECK(rx_script_cache_write(path, hash, 1, &script, &script_length), "the entry should be written");
+
+    std::vector<uint8_t> entry;
+    CHECK(read_file(path, entry), "the entry should exist");
+
+    rx_script_t* read_script;
+    uint32_t read_length;
+
+    // a different cache version
+    std::vector<uint8_t> corrupted(entry);
+    corrupted[4] ^= 0xff;
+    write_file(path, corrupted);
+    CHECK(rx_script_cache_read(path, hash, 1, &read_script, &read_length) == -1, "an entry from another version should be a miss");
+
+    // truncated and extended entries
+    corrupted.assign(entry.begin(), entry.end() - 1);
+    write_file(path, corrupted);
+    CHECK(rx_script_cache_read(path, hash, 1, &read_script, &read_length) == -1, "a truncated entry should be a miss");
+    corrupted.assign(entry.begin(), entry.end());
+    corrupted.push_back(0);
+    write_file(path, corrupted);
+    CHECK(rx_script_cache_read(path, hash, 1, &read_script, &read_length) == -1, "an extended entry should be a miss");
+
+    // every single-bit corruption of the arena must either be rejected or read back a valid arena that runs in
+    // bounds; the engine must never be handed an arena it could run out of bounds
+    size_t arena_start = entry.size() - rx_script_size(script);
+    uint32_t rejected = 0;
+    for (size_t offset = arena_start; offset < entry.size(); offset++) {
+        for (int bit = 0; bit < 8; bit++) {
+            corrupted.assign(entry.begin(), entry.end());
+            corrupted[offset] ^= (uint8_t)(1 << bit);
+            write_file(path, corrupted);
+
+            if (rx_script_cache_read(path, hash, 1, &read_script, &read_length) == -1) {
+                rejected++;
+                continue;
+            }
+            CHECK(rx_script_is_valid(read_script, rx_script_size(read_script)), "accepted arenas should be valid");
+            CHECK(executes_in_bounds(read_script), "accepted arenas should execute in bounds");
+            rx_script_free(read_script);
+        }
+    }
+    printf("%u of %zu corruptions rejected\n", rejected, 8 * (entry.size() - arena_start));
+    CHECK(rejected > 0, "corrupted arenas should be rejected");
+
+    // the arena validation on its own
+    CHECK(rx_script_is_valid(script, rx_script_size(script)), "a linked arena should be valid");
+    CHECK(!rx_script_is_valid(script, rx_script_size(script) - 4), "an arena with the wrong size should be invalid");
+
+    rx_script_free(script);
+    printf("\n");
+}
+
+int main(int, char* const[]) {
+    char path[] = "/tmp/RXScriptCache_test.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    test_round_trip(path);
+    test_invalid_entries(path);
+    unlink(path);
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("-- All script cache tests passed --\n");
+    return 0;
+}
@@ -0,0 +1,15 @@
+//
+//  RXScriptEngine_test.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 24/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#import <SenTestingKit/SenTestingKit.h>
+
+
+@interface RXScriptEngine_test : SenTestCase {
+}
+
+@end
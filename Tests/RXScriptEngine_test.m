@@ -0,0 +1,64 @@
+//
+//  RXScriptEngine_test.m
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 24/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#import "RXScriptEngine_test.h"
+
+#import <objc/runtime.h>
+
+#import "Engine/RXScriptEngine.h"
+#import "Engine/RXScriptExternalCommands.h"
+
+
+@implementation RXScriptEngine_test
+
+- (void)testEveryExternalCommandIsReachable {
+    uint32_t external_count = 0;
+    
+    // every external command method must be in the external command list and its dispatch table entry
+    uint32_t mlist_count;
+    Method* mlist = class_copyMethodList([RXScriptEngine class], &mlist_count);
+    for (uint32_t method_index = 0; method_index < mlist_count; ++method_index) {
+        SEL m_sel = method_getName(mlist[method_index]);
+        NSString* method_selector_string = NSStringFromSelector(m_sel);
+        if (![method_selector_string hasPrefix:@"_external_"])
+            continue;
+        external_count++;
+        
+        NSRange first_colon_range = [method_selector_string rangeOfString:@":"];
+        NSRange range = NSMakeRange([(NSString*)@"_external_" length], first_colon_range.location - [(NSString*)@"_external_" length]);
+        NSString* external_name = [method_selector_string substringWithRange:range];
+        
+        uint16_t command_id = rx_external_command_id([external_name UTF8String]);
+        STAssertTrue(command_id != RX_EXTERNAL_COMMAND_UNKNOWN, @"%@ is not in the external command list", external_name);
+        if (command_id == RX_EXTERNAL_COMMAND_UNKNOWN)
+            continue;
+        
+        STAssertEquals([RXScriptEngine selectorForExternalCommandID:command_id], m_sel,
+                       @"%@ does not dispatch to its method", external_name);
+        STAssertEquals([RXScriptEngine implementationForExternalCommandID:command_id], method_getImplementation(mlist[method_index]),
+                       @"%@ does not dispatch to its implementation", external_name);
+    }
+    free(mlist);
+    
+    // and every command in the list must have a method
+    STAssertEquals(external_count, (uint32_t)RX_EXTERNAL_COMMAND_COUNT, @"the external command list has commands without a method");
+}
+
+- (void)testExternalCommandIDs {
+    for (uint16_t command_id = 0; command_id < RX_EXTERNAL_COMMAND_COUNT; command_id++)
+        STAssertEquals(rx_external_command_id(rx_external_command_names[command_id]), command_id, @"command IDs should be dense");
+    
+    // stack NAME resources do not always use the same case as the implementations
+    STAssertEquals(rx_external_command_id("xBCheckCatch"), (uint16_t)RX_EXTERNAL_COMMAND_ID(xbcheckcatch),
+                   @"external command names should be matched without regard to case");
+    STAssertEquals(rx_external_command_id("xnotacommand"), (uint16_t)RX_EXTERNAL_COMMAND_UNKNOWN,
+                   @"unknown external commands should have the unknown ID");
+    STAssertTrue([RXScriptEngine selectorForExternalCommandID:RX_EXTERNAL_COMMAND_COUNT] == NULL, @"out of range command IDs have no selector");
+}
+
+@end
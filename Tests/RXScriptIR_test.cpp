@@ -0,0 +1,448 @@
+/*
+ *  RXScriptIR_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 22/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Engine/RXScriptIR.h"
+#include "Engine/RXScriptCommandAliases.h"
+
+
+// execution state shared by the reference walker and the IR interpreter; it records a trace of everything the engine
+// would observe, in order, and aborts after a set number of commands the way a card change does
+struct trace_context {
+    std::vector<std::string> trace;
+    const uint16_t* variables;
+    uint32_t commands;
+    uint32_t abort_after;
+    uint32_t depth;
+    bool abort;
+};
+
+static void trace_append(trace_context* context, const char* format, unsigned a, unsigned b = 0, unsigned c = 0) {
+    char line[128];
+    snprintf(line, sizeof(line), format, a, b, c);
+    context->trace.push_back(line);
+}
+
+static uint16_t trace_variable_value(void* ctx, uint16_t variable) {
+    trace_context* context = reinterpret_cast<trace_context*>(ctx);
+    trace_append(context, "switch on %u=%u", variable, context->variables[variable]);
+    return context->variables[variable];
+}
+
+static void trace_execute_command(void* ctx, uint16_t opcode, uint16_t argc, const uint16_t* argv) {
+    trace_context* context = reinterpret_cast<trace_context*>(ctx);
+    std::string line;
+    char word[16];
+    snprintf(word, sizeof(word), "cmd %u", opcode);
+    line += word;
+    for (uint16_t i = 0; i < argc; i++) {
+        snprintf(word, sizeof(word), " %u", argv[i]);
+        line += word;
+    }
+    context->trace.push_back(line);
+
+    context->commands++;
+    if (context->commands == context->abort_after)
+        context->abort = true;
+}
+
+static bool trace_should_abort(void* ctx) {
+    return reinterpret_cast<trace_context*>(ctx)->abort;
+}
+
+static void trace_enter_block(void* ctx) {
+    reinterpret_cast<trace_context*>(ctx)->depth++;
+}
+
+static void trace_exit_block(void* ctx) {
+    trace_context* context = reinterpret_cast<trace_context*>(ctx);
+    context->depth--;
+    if (context->depth == 0)
+        context->abort = false;
+}
+
+static void trace_case_enter(void* ctx, uint16_t, uint16_t, bool is_default) {
+    trace_append(reinterpret_cast<trace_context*>(ctx), (is_default) ? "default case {" : "matching case {", 0);
+}
+
+static void trace_case_exit(void* ctx) {
+    trace_append(reinterpret_cast<trace_context*>(ctx), "}", 0);
+}
+
+#pragma mark -
+
+// C++ port of rx_compute_riven_script_length for host-endian programs
+static size_t compute_script_length(const uint16_t* script, uint16_t command_count) {
+    size_t offset = 0;
+    for (uint16_t i = 0; i < command_count; i++) {
+        uint16_t command = script[offset / 2];
+        uint16_t argc = script[offset / 2 + 1];
+        size_t arguments_offset = 2 * (argc + 1);
+        offset += 2 + arguments_offset;
+
+        if (command == 8) {
+            uint16_t case_count = script[(offset - arguments_offset + 4) / 2];
+            for (uint16_t c = 0; c < case_count; c++) {
+                offset += 2;
+                uint16_t case_command_count = script[offset / 2];
+                offset += 2;
+                offset += compute_script_length(script + offset / 2, case_command_count);
+            }
+        }
+    }
+    return offset;
+}
+
+// C++ port of -[RXScriptEngine _executeRivenProgram:count:], minus the logging
+static size_t walker_execute(trace_context* context, const void* program_buffer, uint16_t opcode_count) {
+    context->depth++;
+
+    size_t program_off = 0;
+    const uint16_t* program = reinterpret_cast<const uint16_t*>(program_buffer);
+
+    for (uint16_t pc = 0; pc < opcode_count; pc++) {
+        if (context->abort)
+            break;
+
+        if (*program == RX_COMMAND_BRANCH) {
+            uint16_t variable_id = *(program + 2);
+            uint16_t casec = *(program + 3);
+
+            program_off += 8;
+            program = reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(program_buffer) + program_off);
+
+            uint16_t var_val = trace_variable_value(context, variable_id);
+
+            uint16_t casei = 0;
+            uint16_t case_val;
+            size_t default_case_off = 0;
+            for (; casei < casec; casei++) {
+                case_val = *program;
+
+                if (case_val == 0xffff)
+                    default_case_off = program_off;
+
+                if (case_val == var_val) {
+                    trace_case_enter(context, variable_id, var_val, false);
+                    // the engine adds the executed length here, which falls short of the case when it aborts and
+                    // makes the skip below walk garbage; measure the case instead, which is the same when not aborted
+                    walker_execute(context, program + 2, *(program + 1));
+                    program_off += compute_script_length(program + 2, *(program + 1));
+                    trace_case_exit(context);
+                } else
+                    program_off += compute_script_length(program + 2, *(program + 1));
+
+                program_off += 4;
+                program = reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(program_buffer) + program_off);
+
+                if (case_val == var_val)
+                    break;
+            }
+
+            if (casei == casec && default_case_off != 0) {
+                const uint16_t* default_case = reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(program_buffer) + default_case_off);
+                trace_case_enter(context, variable_id, var_val, true);
+                walker_execute(context, default_case + 2, *(default_case + 1));
+                trace_case_exit(context);
+            } else {
+                casei++;
+                for (; casei < casec; casei++) {
+                    program_off += compute_script_length(program + 2, *(program + 1)) + 4;
+                    program = reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(program_buffer) + program_off);
+                }
+            }
+        } else {
+            trace_execute_command(context, *program, *(program + 1), program + 2);
+            program_off += 4 + (*(program + 1) * sizeof(uint16_t));
+            program = reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(program_buffer) + program_off);
+        }
+    }
+
+    context->depth--;
+    if (context->depth == 0)
+        context->abort = false;
+
+    return program_off;
+}
+
+#pragma mark -
+
+static const uint16_t kVariableCount = 8;
+
+// emits a random block of count instructions; switches nest up to max_depth and use small, duplicated, sparse and
+// 0xffff case values so that every case resolution rule of the walker is exercised
+static void generate_block(std::vector<uint16_t>& program, uint16_t count, int max_depth) {
+    for (uint16_t i = 0; i < count; i++) {
+        if (max_depth > 0 && (random() % 3) == 0) {
+            uint16_t case_count = random() % 6;
+            program.push_back(RX_COMMAND_BRANCH);
+            program.push_back(2);
+            program.push_back(random() % kVariableCount);
+            program.push_back(case_count);
+
+            bool sparse = (random() % 4) == 0;
+            for (uint16_t c = 0; c < case_count; c++) {
+                uint16_t value;
+                switch (random() % 6) {
+                    case 0:
+                        value = 0xffff;
+                        break;
+                    default:
+                        value = (sparse) ? (random() % 8) * 1000 : random() % 4;
+                        break;
+                }
+                program.push_back(value);
+
+                uint16_t case_opcode_count = random() % 4;
+                program.push_back(case_opcode_count);
+                generate_block(program, case_opcode_count, max_depth - 1);
+            }
+        } else {
+            uint16_t opcode;
+            do {
+                opcode = random() % 48;
+            } while (opcode == RX_COMMAND_BRANCH);
+            uint16_t argc = random() % 6;
+            program.push_back(opcode);
+            program.push_back(argc);
+            for (uint16_t a = 0; a < argc; a++)
+                program.push_back(random() % 0x10000);
+        }
+    }
+}
+
+static void execute_ir(trace_context* context, const void* ir) {
+    rx_script_ir_executor_t executor;
+    executor.context = context;
+    executor.variable_value = trace_variable_value;
+    executor.execute_command = trace_execute_command;
+    executor.should_abort = trace_should_abort;
+    executor.enter_block = trace_enter_block;
+    executor.exit_block = trace_exit_block;
+    executor.case_enter = trace_case_enter;
+    executor.case_exit = trace_case_exit;
+    rx_script_ir_execute(ir, &executor);
+}
+
+static void reset_context(trace_context* context, const uint16_t* variables, uint32_t abort_after) {
+    context->trace.clear();
+    context->variables = variables;
+    context->commands = 0;
+    context->abort_after = abort_after;
+    context->depth = 0;
+    context->abort = false;
+}
+
+static int test_traces() {
+    printf("-- Comparing IR and walker execution traces --\n");
+
+    uint32_t programs = 0;
+    uint32_t executions = 0;
+    for (uint32_t iteration = 0; iteration < 2000; iteration++) {
+        std::vector<uint16_t> program;
+        uint16_t opcode_count = 1 + random() % 8;
+        generate_block(program, opcode_count, 1 + random() % 4);
+
+        size_t length = program.size() * sizeof(uint16_t);
+        if (compute_script_length(&program[0], opcode_count) != length) {
+            printf("Generated program length mismatch.\n");
+            return 1;
+        }
+
+        size_t ir_length = 0;
+        void* ir = rx_script_ir_compile(&program[0], length, opcode_count, &ir_length);
+        if (!ir || !rx_script_ir_is_valid(ir, ir_length)) {
+            printf("Failed to compile a well-formed program (iteration %u).\n", iteration);
+            return 1;
+        }
+        programs++;
+
+        for (uint32_t run = 0; run < 16; run++) {
+            uint16_t variables[kVariableCount];
+            for (uint16_t v = 0; v < kVariableCount; v++) {
+                switch (random() % 5) {
+                    case 0:
+                        variables[v] = 0xffff;
+                        break;
+                    case 1:
+                        variables[v] = (random() % 8) * 1000;
+                        break;
+                    default:
+                        variables[v] = random() % 5;
+                        break;
+                }
+            }
+
+            // a third of the runs abort after a few commands
+            uint32_t abort_after = (run % 3 == 0) ? 1 + random() % 6 : 0;
+
+            trace_context walker_context;
+            reset_context(&walker_context, variables, abort_after);
+            walker_execute(&walker_context, &program[0], opcode_count);
+
+            trace_context ir_context;
+            reset_context(&ir_context, variables, abort_after);
+            execute_ir(&ir_context, ir);
+
+            if (walker_context.trace != ir_context.trace || walker_context.depth != 0 || ir_context.depth != 0) {
+                printf("Trace mismatch (iteration %u, run %u):\n", iteration, run);
+                size_t lines = std::max(walker_context.trace.size(), ir_context.trace.size());
+                for (size_t l = 0; l < lines; l++)
+                    printf("    %-32s | %s\n", (l < walker_context.trace.size()) ? walker_context.trace[l].c_str() : "",
+                           (l < ir_context.trace.size()) ? ir_context.trace[l].c_str() : "");
+                free(ir);
+                return 1;
+            }
+            executions++;
+        }
+
+        free(ir);
+    }
+
+    printf("%u programs, %u executions, all traces identical\n", programs, executions);
+    printf("-- Trace test passed --\n\n");
+    return 0;
+}
+
+static int test_malformed() {
+    printf("-- Rejecting malformed programs --\n");
+
+    // a switch with the wrong number of arguments
+    uint16_t bad_argc[] = {RX_COMMAND_BRANCH, 3, 0, 0, 0};
+    if (rx_script_ir_compile(bad_argc, sizeof(bad_argc), 1, NULL)) {
+        printf("Compiled a switch with 3 arguments.\n");
+        return 1;
+    }
+
+    // a command whose arguments run past the end of the program
+    uint16_t truncated_command[] = {1, 4, 0, 0};
+    if (rx_script_ir_compile(truncated_command, sizeof(truncated_command), 1, NULL)) {
+        printf("Compiled a truncated command.\n");
+        return 1;
+    }
+
+    // a case block that runs past the end of the program
+    uint16_t truncated_case[] = {RX_COMMAND_BRANCH, 2, 0, 1, 0, 2, 1, 0};
+    if (rx_script_ir_compile(truncated_case, sizeof(truncated_case), 1, NULL)) {
+        printf("Compiled a truncated case.\n");
+        return 1;
+    }
+
+    // more opcodes than the program holds
+    uint16_t short_program[] = {1, 0};
+    if (rx_script_ir_compile(short_program, sizeof(short_program), 2, NULL)) {
+        printf("Compiled a program with a missing opcode.\n");
+        return 1;
+    }
+
+    printf("-- Malformed program test passed --\n\n");
+    return 0;
+}
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1.0e-6;
+}
+
+static void nop_command(void*, uint16_t, uint16_t, const uint16_t*) {}
+static uint16_t fixed_variable_value(void* ctx, uint16_t) {return *reinterpret_cast<uint16_t*>(ctx);}
+static bool never_abort(void*) {return false;}
+static void nop_block(void*) {}
+
+// a switch on a variable whose matching case is last, with every case holding a nested switch; this is the shape
+// that makes the walker measure the whole program on every execution
+static int benchmark_deep_switch() {
+    printf("-- Deep switch dispatch --\n");
+
+    std::vector<uint16_t> program;
+    const uint16_t case_count = 32;
+    program.push_back(RX_COMMAND_BRANCH);
+    program.push_back(2);
+    program.push_back(0);
+    program.push_back(case_count);
+    for (uint16_t c = 0; c < case_count; c++) {
+        program.push_back(c);
+        program.push_back(1);
+        program.push_back(RX_COMMAND_BRANCH);
+        program.push_back(2);
+        program.push_back(0);
+        program.push_back(case_count);
+        for (uint16_t n = 0; n < case_count; n++) {
+            program.push_back(n);
+            program.push_back(1);
+            program.push_back(RX_COMMAND_SET_VARIABLE);
+            program.push_back(2);
+            program.push_back(1);
+            program.push_back(n);
+        }
+    }
+
+    size_t length = program.size() * sizeof(uint16_t);
+    void* ir = rx_script_ir_compile(&program[0], length, 1, NULL);
+    if (!ir) {
+        printf("Failed to compile the benchmark program.\n");
+        return 1;
+    }
+
+    uint16_t value = case_count - 1;
+    rx_script_ir_executor_t executor;
+    executor.context = &value;
+    executor.variable_value = fixed_variable_value;
+    executor.execute_command = nop_command;
+    executor.should_abort = never_abort;
+    executor.enter_block = nop_block;
+    executor.exit_block = nop_block;
+    executor.case_enter = NULL;
+    executor.case_exit = NULL;
+
+    const uint32_t iterations = 100000;
+    uint16_t variables[kVariableCount] = {static_cast<uint16_t>(case_count - 1)};
+    trace_context context;
+
+    double start = now();
+    for (uint32_t i = 0; i < iterations / 10; i++) {
+        reset_context(&context, variables, 0);
+        walker_execute(&context, &program[0], 1);
+    }
+    double walker_time = (now() - start) / (iterations / 10);
+
+    start = now();
+    for (uint32_t i = 0; i < iterations; i++)
+        rx_script_ir_execute(ir, &executor);
+    double ir_time = (now() - start) / iterations;
+
+    printf("program %zu bytes: walker %.2f us, IR %.3f us per execution\n", length, walker_time * 1.0e6, ir_time * 1.0e6);
+
+    free(ir);
+    return 0;
+}
+
+int main(int, char* const[]) {
+    srandom(42);
+
+    int result = test_traces();
+    if (result != 0)
+        return result;
+
+    result = test_malformed();
+    if (result != 0)
+        return result;
+
+    return benchmark_deep_switch();
+}
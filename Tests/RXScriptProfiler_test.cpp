@@ -0,0 +1,189 @@
+/*
+ *  RXScriptProfiler_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 23/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "Engine/RXScriptProfiler.h"
+
+#if defined(__APPLE__)
+#include <CoreFoundation/CoreFoundation.h>
+#include "Base/RXTiming.h"
+#endif
+
+
+static int failures = 0;
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s\n", message); \
+            failures++; \
+        } \
+    } while (0)
+
+static std::string report() {
+    char* text = rx_script_profiler_copy_report();
+    std::string s(text);
+    free(text);
+    return s;
+}
+
+// returns the count column of the report row for name, or -1
+static long report_count(const std::string& text, const char* name) {
+    size_t line = 0;
+    while (line < text.size()) {
+        size_t end = text.find('\n', line);
+        if (end == std::string::npos)
+            end = text.size();
+        std::string row = text.substr(line, end - line);
+        char row_name[64];
+        long count;
+        if (sscanf(row.c_str(), "%63s %ld", row_name, &count) == 2 && strcmp(row_name, name) == 0)
+            return count;
+        line = end + 1;
+    }
+    return -1;
+}
+
+// an activate PLST opcode that calls an external, the way opcode 17 nests external commands
+static void record_program(uint16_t external, uint32_t repeat) {
+    for (uint32_t i = 0; i < repeat; i++) {
+        rx_script_profiler_enter(kRXScriptProfilerOpcode, 39);
+        rx_script_profiler_exit(kRXScriptProfilerOpcode, 39);
+
+        rx_script_profiler_enter(kRXScriptProfilerOpcode, 17);
+        rx_script_profiler_enter(kRXScriptProfilerExternal, external);
+        rx_script_profiler_exit(kRXScriptProfilerExternal, external);
+        rx_script_profiler_exit(kRXScriptProfilerOpcode, 17);
+    }
+}
+
+static void* record_thread(void* context) {
+    record_program(*static_cast<uint16_t*>(context), 1000);
+    return NULL;
+}
+
+static void test_tables() {
+    printf("-- Aggregating per-opcode and per-external tables --\n");
+
+    rx_script_profiler_reset();
+    rx_script_profiler_set_opcode_name(17, "callExternal");
+    rx_script_profiler_set_opcode_name(39, "activatePLST");
+    uint16_t elevator = rx_script_profiler_external_id("handlejungleelevatormouth");
+    CHECK(elevator == rx_script_profiler_external_id("handlejungleelevatormouth"), "external IDs should be interned");
+
+    record_program(elevator, 100);
+
+    // a second thread has its own ring; it exits before collection, which must still pick up its events
+    pthread_t thread;
+    pthread_create(&thread, NULL, record_thread, &elevator);
+    pthread_join(thread, NULL);
+
+    std::string text = report();
+    printf("%s", text.c_str());
+    CHECK(report_count(text, "activatePLST") == 1100, "activatePLST should have 1100 calls");
+    CHECK(report_count(text, "callExternal") == 1100, "callExternal should have 1100 calls");
+    CHECK(report_count(text, "handlejungleelevatormouth") == 1100, "the external should have 1100 calls");
+
+    printf("\n");
+}
+
+static void test_unmatched_events() {
+    printf("-- Recovering from unmatched events --\n");
+
+    rx_script_profiler_reset();
+
+    // an opcode that threw never records its exit; the enclosing exit must still match its own entry
+    rx_script_profiler_enter(kRXScriptProfilerOpcode, 2);
+    rx_script_profiler_enter(kRXScriptProfilerOpcode, 7);
+    rx_script_profiler_exit(kRXScriptProfilerOpcode, 2);
+
+    // an exit without an entry is ignored
+    rx_script_profiler_exit(kRXScriptProfilerOpcode, 9);
+
+    std::string text = report();
+    CHECK(text.find("opcode 2 ") != std::string::npos, "opcode 2 should be reported");
+    CHECK(text.find("opcode 7 ") == std::string::npos, "opcode 7 should not be reported");
+    CHECK(text.find("opcode 9 ") == std::string::npos, "opcode 9 should not be reported");
+
+    printf("\n");
+}
+
+static void test_overflow() {
+    printf("-- Dropping events when a ring is full --\n");
+
+    rx_script_profiler_reset();
+
+    // far more events than a ring holds, without collecting
+    for (uint32_t i = 0; i < 100000; i++) {
+        rx_script_profiler_enter(kRXScriptProfilerOpcode, 1);
+        rx_script_profiler_exit(kRXScriptProfilerOpcode, 1);
+    }
+
+    std::string text = report();
+    printf("%s", text.c_str());
+    CHECK(text.find("events dropped") != std::string::npos, "dropped events should be reported");
+
+    printf("\n");
+}
+
+static void test_chrome_trace() {
+    printf("-- Writing a Chrome trace --\n");
+
+    rx_script_profiler_reset();
+    record_program(rx_script_profiler_external_id("quote\"d"), 10);
+
+    const char* path = "/tmp/rxscriptprofiler_test.json";
+    CHECK(rx_script_profiler_write_chrome_trace(path), "writing the trace should succeed");
+
+    FILE* fp = fopen(path, "r");
+    std::string json;
+    if (fp) {
+        char buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+            json.append(buffer, n);
+        fclose(fp);
+    }
+    remove(path);
+
+    size_t events = 0;
+    for (size_t p = json.find("\"ph\":\"X\""); p != std::string::npos; p = json.find("\"ph\":\"X\"", p + 1))
+        events++;
+    CHECK(events == 30, "the trace should have 30 complete events");
+    CHECK(json.find("\"name\":\"quote\\\"d\"") != std::string::npos, "names should be escaped");
+    CHECK(json.compare(0, 15, "{\"traceEvents\":") == 0, "the trace should be a traceEvents object");
+
+    printf("%zu trace events\n\n", events);
+}
+
+int main(int argc, char* const argv[]) {
+#if defined(__APPLE__)
+    RXTimingUpdateTimebase();
+#endif
+    rx_script_profiler_set_enabled(true);
+
+    test_tables();
+    test_unmatched_events();
+    test_overflow();
+    test_chrome_trace();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("-- All profiler tests passed --\n");
+    return 0;
+}
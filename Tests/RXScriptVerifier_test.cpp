@@ -0,0 +1,260 @@
+/*
+ *  RXScriptVerifier_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 25/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "Engine/RXScriptVerifier.h"
+#include "Engine/RXScriptIR.h"
+#include "Engine/RXScriptCommandAliases.h"
+
+
+static int failures = 0;
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s\n", message); \
+            failures++; \
+        } \
+    } while (0)
+
+struct collected_t {
+    std::vector<rx_script_violation_t> violations;
+};
+
+static void collect_violation(void* context, const rx_script_violation_t* violation) {
+    static_cast<collected_t*>(context)->violations.push_back(*violation);
+}
+
+static uint32_t verify(const std::vector<uint16_t>& program, uint16_t opcode_count, size_t* length, collected_t* collected) {
+    return rx_script_verify_program(program.empty() ? NULL : &program[0], 2 * program.size(), opcode_count, false, length,
+                                    collect_violation, collected);
+}
+
+static void emit(std::vector<uint16_t>& program, uint16_t opcode, uint16_t argc, uint16_t fill = 1) {
+    program.push_back(opcode);
+    program.push_back(argc);
+    for (uint16_t i = 0; i < argc; i++)
+        program.push_back(fill);
+}
+
+// a switch on variable 3 with a case for 0 that sets a variable and a default case that goes to a card
+static void emit_switch(std::vector<uint16_t>& program) {
+    emit(program, RX_COMMAND_BRANCH, 2);
+    program[program.size() - 2] = 3;
+    program[program.size() - 1] = 2;
+
+    program.push_back(0);
+    program.push_back(1);
+    emit(program, RX_COMMAND_SET_VARIABLE, 2);
+
+    program.push_back(0xffff);
+    program.push_back(1);
+    emit(program, RX_COMMAND_GOTO_CARD, 1);
+}
+
+static void test_valid_programs() {
+    printf("-- Accepting well-formed programs --\n");
+
+    std::vector<uint16_t> program;
+    emit(program, RX_COMMAND_ACTIVATE_PLST, 1);
+    emit_switch(program);
+    emit(program, RX_COMMAND_CALL_EXTERNAL, 4);
+    program[program.size() - 3] = 2;
+    emit(program, RX_COMMAND_SCHEDULE_TRANSITION, 5);
+
+    // a synthesized SLST for 2 sounds: 1 count, 2 IDs, 5 group parameters, 2 gains, 2 pans, 2 unknowns
+    emit(program, 3, 14);
+    program[program.size() - 14] = 2;
+
+    collected_t collected;
+    size_t length;
+    CHECK(verify(program, 5, &length, &collected) == 0, "a well-formed program should have no violations");
+    CHECK(length == 2 * program.size(), "the program length should be measured");
+
+    // the same program in big-endian order
+    std::vector<uint16_t> swapped(program);
+    for (size_t i = 0; i < swapped.size(); i++)
+        swapped[i] = static_cast<uint16_t>((swapped[i] << 8) | (swapped[i] >> 8));
+    CHECK(rx_script_verify_program(&swapped[0], 2 * swapped.size(), 5, true, &length, NULL, NULL) == 0,
+          "a big-endian program should verify with byte_swap");
+    CHECK(length == 2 * program.size(), "the big-endian program length should be measured");
+
+    // trailing data after the program is not part of it
+    program.push_back(0xbeef);
+    CHECK(verify(program, 5, &length, &collected) == 0 && length == 2 * (program.size() - 1),
+          "trailing data should not be measured");
+
+    CHECK(verify(std::vector<uint16_t>(), 0, &length, &collected) == 0 && length == 0, "an empty program is valid");
+
+    printf("\n");
+}
+
+static void test_violations() {
+    printf("-- Reporting violations --\n");
+
+    // an opcode out of range and a short set variable; both are reported, and the program can still be measured
+    {
+        std::vector<uint16_t> program;
+        emit(program, 60, 0);
+        emit(program, RX_COMMAND_SET_VARIABLE, 1);
+        emit(program, RX_COMMAND_ACTIVATE_PLST, 1);
+
+        collected_t collected;
+        size_t length;
+        CHECK(verify(program, 3, &length, &collected) == 2, "two violations should be reported");
+        CHECK(length == 2 * program.size(), "the program should still be measured");
+        CHECK(collected.violations.size() == 2 &&
+              collected.violations[0].code == kRXScriptViolationInvalidOpcode && collected.violations[0].offset == 0 &&
+              collected.violations[1].code == kRXScriptViolationArgumentCount && collected.violations[1].offset == 4,
+              "the violations should be reported in order with their offsets");
+    }
+
+    // truncated programs cannot be measured
+    {
+        std::vector<uint16_t> program;
+        emit(program, RX_COMMAND_ACTIVATE_PLST, 1);
+        emit(program, RX_COMMAND_PLAY_DATA_SOUND, 3);
+        program.pop_back();
+
+        collected_t collected;
+        size_t length;
+        CHECK(verify(program, 2, &length, &collected) == 1 && collected.violations[0].code == kRXScriptViolationTruncated,
+              "truncated arguments should be reported");
+        CHECK(length == RX_SCRIPT_VERIFIER_UNKNOWN_LENGTH, "a truncated program has no length");
+        CHECK(verify(program, 7, &length, &collected) > 0, "a program with too many opcodes should be truncated");
+    }
+
+    // switches must have exactly 2 arguments; with fewer the program cannot be walked
+    {
+        std::vector<uint16_t> program;
+        emit(program, RX_COMMAND_BRANCH, 3, 0);
+
+        collected_t collected;
+        size_t length;
+        CHECK(verify(program, 1, &length, &collected) == 1 && collected.violations[0].code == kRXScriptViolationSwitchArguments,
+              "a switch with 3 arguments should be reported");
+        CHECK(length == 2 * program.size(), "a switch with 3 arguments and no cases can be measured");
+
+        program.clear();
+        emit(program, RX_COMMAND_BRANCH, 1, 0);
+        CHECK(verify(program, 1, &length, &collected) == 1 && length == RX_SCRIPT_VERIFIER_UNKNOWN_LENGTH,
+              "a switch with 1 argument cannot be measured");
+    }
+
+    // violations inside cases are found and report their depth
+    {
+        std::vector<uint16_t> program;
+        emit_switch(program);
+        program[6] = RX_COMMAND_PLAY_DATA_SOUND;
+
+        collected_t collected;
+        size_t length;
+        CHECK(verify(program, 1, &length, &collected) == 1 && collected.violations[0].depth == 1 &&
+              collected.violations[0].offset == 12, "violations in cases should be reported with their depth");
+    }
+
+    // external commands cannot claim more arguments than the instruction has
+    {
+        std::vector<uint16_t> program;
+        emit(program, RX_COMMAND_CALL_EXTERNAL, 3, 0);
+        program[3] = 2;
+
+        collected_t collected;
+        size_t length;
+        CHECK(verify(program, 1, &length, &collected) == 1 && collected.violations[0].code == kRXScriptViolationExternalArguments,
+              "an external call with too few arguments should be reported");
+    }
+
+    // synthesized SLSTs must have a full SLST record for their sound count
+    {
+        std::vector<uint16_t> program;
+        emit(program, 3, 8);
+        program[2] = 2;
+
+        collected_t collected;
+        size_t length;
+        CHECK(verify(program, 1, &length, &collected) == 1 && collected.violations[0].code == kRXScriptViolationArgumentCount,
+              "a short synthesized SLST should be reported");
+    }
+
+    // deep nesting is rejected
+    {
+        std::vector<uint16_t> program;
+        for (uint32_t depth = 0; depth < RX_SCRIPT_VERIFIER_MAX_DEPTH + 1; depth++) {
+            emit(program, RX_COMMAND_BRANCH, 2, 0);
+            program[program.size() - 1] = 1;
+            program.push_back(0);
+            program.push_back(1);
+        }
+        emit(program, RX_COMMAND_ACTIVATE_PLST, 1);
+
+        collected_t collected;
+        size_t length;
+        CHECK(verify(program, 1, &length, &collected) == 1 && collected.violations[0].code == kRXScriptViolationSwitchDepth,
+              "deeply nested switches should be reported");
+    }
+
+    printf("\n");
+}
+
+static void test_random_programs() {
+    printf("-- Verifying random programs --\n");
+
+    // random words biased towards small values, so that some of them are well-formed; verification must never read out
+    // of bounds, and every program it accepts must compile to IR
+    uint32_t accepted = 0;
+    uint32_t measured = 0;
+    srandom(36);
+    for (uint32_t i = 0; i < 200000; i++) {
+        std::vector<uint16_t> program(1 + random() % 24);
+        for (size_t w = 0; w < program.size(); w++) {
+            switch (random() % 4) {
+                case 0: program[w] = RX_COMMAND_BRANCH; break;
+                case 1: program[w] = random() % 3; break;
+                case 2: program[w] = random() % 50; break;
+                default: program[w] = random(); break;
+            }
+        }
+        uint16_t opcode_count = random() % 4;
+
+        size_t length;
+        uint32_t violations = rx_script_verify_program(&program[0], 2 * program.size(), opcode_count, false, &length, NULL, NULL);
+        if (length != RX_SCRIPT_VERIFIER_UNKNOWN_LENGTH) {
+            measured++;
+            CHECK(length <= 2 * program.size(), "measured programs should be within their buffer");
+        }
+        if (violations == 0) {
+            accepted++;
+            void* ir = rx_script_ir_compile(&program[0], length, opcode_count, NULL);
+            CHECK(ir != NULL, "accepted programs should compile");
+            free(ir);
+        } else
+            CHECK(length == RX_SCRIPT_VERIFIER_UNKNOWN_LENGTH || length <= 2 * program.size(), "rejected programs stay in bounds");
+    }
+
+    printf("%u accepted, %u measured of 200000\n\n", accepted, measured);
+}
+
+int main(int argc, char* const argv[]) {
+    test_valid_programs();
+    test_violations();
+    test_random_programs();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("-- All verifier tests passed --\n");
+    return 0;
+}
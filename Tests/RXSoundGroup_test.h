@@ -0,0 +1,16 @@
+//
+//  RXSoundGroup_test.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 21/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#import <SenTestingKit/SenTestingKit.h>
+
+
+@interface RXSoundGroup_test : SenTestCase {
+
+}
+
+@end
@@ -0,0 +1,132 @@
+//
+//  RXSoundGroup_test.mm
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 21/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#import "RXSoundGroup_test.h"
+#import "RXSoundGroup.h"
+#import "RXSoundGroupTransition.h"
+#import "Engine/RXCoreStructures.h"
+
+
+// builds an SLST record body for two sounds (IDs 1 and 2) with the given fade flags
+static void make_slst_record(uint16_t* record, uint16_t fade_flags, bool big_endian) {
+    uint16_t values[] = {
+        1, 2,                       // sound IDs
+        fade_flags, 1, 100, 0, 0,   // fade flags, loop, group gain, u0, u1
+        50, 100,                    // sound gains
+        0, 0,                       // sound pans
+    };
+    for (size_t i = 0; i < sizeof(values) / sizeof(uint16_t); i++)
+        record[i] = (big_endian) ? CFSwapInt16HostToBig(values[i]) : values[i];
+}
+
+@implementation RXSoundGroup_test
+
+- (void)testFadeFlags {
+    RXSoundGroup* group = [RXSoundGroup new];
+    
+    [group setFadeFlags:0];
+    STAssertFalse(group->fadeOutRemovedSounds, @"fade flags 0 should not fade out removed sounds");
+    STAssertFalse(group->fadeInNewSounds, @"fade flags 0 should not fade in new sounds");
+    
+    [group setFadeFlags:RX_SLST_FADE_OUT_REMOVED_SOUNDS];
+    STAssertTrue(group->fadeOutRemovedSounds, @"fade flags 1 should fade out removed sounds");
+    STAssertFalse(group->fadeInNewSounds, @"fade flags 1 should not fade in new sounds");
+    
+    [group setFadeFlags:RX_SLST_FADE_IN_NEW_SOUNDS];
+    STAssertFalse(group->fadeOutRemovedSounds, @"fade flags 2 should not fade out removed sounds");
+    STAssertTrue(group->fadeInNewSounds, @"fade flags 2 should fade in new sounds");
+    
+    [group setFadeFlags:RX_SLST_FADE_OUT_REMOVED_SOUNDS | RX_SLST_FADE_IN_NEW_SOUNDS];
+    STAssertTrue(group->fadeOutRemovedSounds, @"fade flags 3 should fade out removed sounds");
+    STAssertTrue(group->fadeInNewSounds, @"fade flags 3 should fade in new sounds");
+    
+    // unused bits are ignored
+    [group setFadeFlags:0xFFFC];
+    STAssertFalse(group->fadeOutRemovedSounds, @"unused fade flag bits should not fade out removed sounds");
+    STAssertFalse(group->fadeInNewSounds, @"unused fade flag bits should not fade in new sounds");
+    
+    [group release];
+}
+
+- (void)testFadeFlagsFromSLSTRecord {
+    uint16_t record[11];
+    
+    for (uint16_t fade_flags = 0; fade_flags < 4; fade_flags++) {
+        // SLST resources are big-endian
+        make_slst_record(record, fade_flags, true);
+        RXSoundGroup* group = [[RXSoundGroup alloc] initWithSLSTRecord:record soundCount:2 stack:nil swapBytes:YES];
+        STAssertNotNil(group, @"group should not be nil");
+        STAssertEquals(group->fadeOutRemovedSounds, (BOOL)((fade_flags & 0x1) ? YES : NO), @"fade out flag mismatch for fade flags %hu", fade_flags);
+        STAssertEquals(group->fadeInNewSounds, (BOOL)((fade_flags & 0x2) ? YES : NO), @"fade in flag mismatch for fade flags %hu", fade_flags);
+        STAssertTrue(group->loop, @"group should loop");
+        STAssertEquals([[group sounds] count], (NSUInteger)2, @"group should have 2 sounds");
+        [group release];
+        
+        // records synthesized by scripts are in host order
+        make_slst_record(record, fade_flags, false);
+        group = [[RXSoundGroup alloc] initWithSLSTRecord:record soundCount:2 stack:nil swapBytes:NO];
+        STAssertEquals(group->fadeOutRemovedSounds, (BOOL)((fade_flags & 0x1) ? YES : NO), @"fade out flag mismatch for host order fade flags %hu", fade_flags);
+        STAssertEquals(group->fadeInNewSounds, (BOOL)((fade_flags & 0x2) ? YES : NO), @"fade in flag mismatch for host order fade flags %hu", fade_flags);
+        [group release];
+    }
+}
+
+- (void)testTransition {
+    RXStack* a = (RXStack*)[NSString stringWithFormat:@"%@", @"astack"];
+    
+    // active sounds 1 and 2, one of which is being faded out
+    NSMutableSet* active = [NSMutableSet set];
+    RXSound* s1 = [RXSound new];
+    s1->parent = a;
+    s1->twav_id = 1;
+    [active addObject:s1];
+    RXSound* s2 = [RXSound new];
+    s2->parent = a;
+    s2->twav_id = 2;
+    s2->detach_timestamp = 1;
+    [active addObject:s2];
+    
+    // the new group has sounds 2 and 3
+    RXSoundGroup* group = [RXSoundGroup new];
+    [group setFadeFlags:RX_SLST_FADE_IN_NEW_SOUNDS];
+    group->gain = 0.5f;
+    [group addSoundWithStack:a ID:2 gain:0.8f pan:0.25f];
+    [group addSoundWithStack:a ID:3 gain:1.0f pan:0.5f];
+    
+    RXSoundGroupTransition* transition = [[RXSoundGroupTransition alloc] initWithActiveSounds:active soundGroup:group forceFadeIn:NO];
+    STAssertFalse(transition->fadeOutRemovedSounds, @"transition should not fade out removed sounds");
+    STAssertTrue(transition->fadeInNewSounds, @"transition should fade in new sounds");
+    
+    STAssertEquals([[transition addedSounds] count], (NSUInteger)1, @"one sound should be added");
+    STAssertEquals(((RXSound*)[[transition addedSounds] anyObject])->twav_id, (uint16_t)3, @"sound 3 should be added");
+    
+    STAssertEquals([[transition removedSounds] count], (NSUInteger)1, @"one sound should be removed");
+    STAssertTrue([[transition removedSounds] anyObject] == s1, @"sound 1 should be removed");
+    
+    // the continuing sound is the active instance, with the new group's parameters as its target
+    STAssertEquals([[transition continuingSounds] count], (NSUInteger)1, @"one sound should continue");
+    STAssertTrue([[transition continuingSounds] objectAtIndex:0] == s2, @"the active instance of sound 2 should continue");
+    STAssertEqualsWithAccuracy([transition targetGainForContinuingSoundAtIndex:0], 0.4f, 1.0e-6f, @"target gain should include the group gain");
+    STAssertEqualsWithAccuracy([transition targetPanForContinuingSoundAtIndex:0], 0.25f, 1.0e-6f, @"target pan mismatch");
+    STAssertTrue([transition gainChangedForContinuingSoundAtIndex:0], @"a sound being faded out should be ramped back up");
+    
+    STAssertEquals([[transition activeSounds] count], (NSUInteger)3, @"all sounds should be active until removed sounds are detached");
+    [transition release];
+    
+    // the fade in override applies even when the group doesn't fade in
+    [group setFadeFlags:0];
+    transition = [[RXSoundGroupTransition alloc] initWithActiveSounds:active soundGroup:group forceFadeIn:YES];
+    STAssertTrue(transition->fadeInNewSounds, @"forced fade in should fade in new sounds");
+    [transition release];
+    
+    [group release];
+    [s2 release];
+    [s1 release];
+}
+
+@end
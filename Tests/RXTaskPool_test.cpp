@@ -0,0 +1,232 @@
+/*
+ *  RXTaskPool_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 30/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "Base/RXTaskPool.h"
+
+
+static int failures = 0;
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s\n", message); \
+            failures++; \
+        } \
+    } while (0)
+
+// records the order in which tasks run
+struct order_log {
+    pthread_mutex_t lock;
+    int entries[64];
+    int count;
+};
+
+struct log_context {
+    order_log* log;
+    int value;
+};
+
+static void log_task(void* context) {
+    log_context* c = static_cast<log_context*>(context);
+    pthread_mutex_lock(&c->log->lock);
+    c->log->entries[c->log->count++] = c->value;
+    pthread_mutex_unlock(&c->log->lock);
+}
+
+static int position(const order_log& log, int value) {
+    for (int i = 0; i < log.count; i++) {
+        if (log.entries[i] == value)
+            return i;
+    }
+    return -1;
+}
+
+static void test_dependencies(rx_task_pool_t* pool) {
+    printf("-- Running a task graph --\n");
+
+    order_log log;
+    memset(&log, 0, sizeof(log));
+    pthread_mutex_init(&log.lock, NULL);
+
+    // a diamond: 1 -> {2, 3} -> 4
+    log_context contexts[4] = {{&log, 1}, {&log, 2}, {&log, 3}, {&log, 4}};
+    rx_task_t* tasks[4];
+    for (int i = 0; i < 4; i++)
+        tasks[i] = rx_task_create(pool, log_task, &contexts[i]);
+    rx_task_add_prerequisite(tasks[1], tasks[0]);
+    rx_task_add_prerequisite(tasks[2], tasks[0]);
+    rx_task_add_prerequisite(tasks[3], tasks[1]);
+    rx_task_add_prerequisite(tasks[3], tasks[2]);
+
+    // submit in reverse so that the order cannot come from the submission order
+    for (int i = 3; i >= 0; i--)
+        rx_task_submit(tasks[i]);
+    rx_task_wait(tasks[3]);
+
+    CHECK(log.count == 4, "every task should have run");
+    CHECK(position(log, 1) == 0, "the root task should run first");
+    CHECK(position(log, 4) == 3, "the join task should run last");
+    for (int i = 0; i < 4; i++)
+        CHECK(rx_task_is_finished(tasks[i]), "every task should be finished");
+
+    // a prerequisite that has already finished does not hold a task back
+    log_context late_context = {&log, 5};
+    rx_task_t* late = rx_task_create(pool, log_task, &late_context);
+    rx_task_add_prerequisite(late, tasks[3]);
+    rx_task_submit(late);
+    rx_task_wait(late);
+    CHECK(log.count == 5 && log.entries[4] == 5, "a task with finished prerequisites should run");
+    rx_task_release(late);
+
+    for (int i = 0; i < 4; i++)
+        rx_task_release(tasks[i]);
+    pthread_mutex_destroy(&log.lock);
+    printf("\n");
+}
+
+// a task that fans out into subtasks once it runs, which a join task waits for
+struct fan_context {
+    rx_task_pool_t* pool;
+    rx_task_t* join;
+    int32_t sums[32];
+    int count;
+};
+
+struct leaf_context {
+    fan_context* fan;
+    int index;
+};
+
+static leaf_context leaves[32];
+
+static void leaf_task(void* context) {
+    leaf_context* c = static_cast<leaf_context*>(context);
+    c->fan->sums[c->index] = c->index * c->index;
+}
+
+static void fan_task(void* context) {
+    fan_context* c = static_cast<fan_context*>(context);
+    for (int i = 0; i < c->count; i++) {
+        leaves[i].fan = c;
+        leaves[i].index = i;
+        rx_task_t* leaf = rx_task_create(c->pool, leaf_task, &leaves[i]);
+        rx_task_add_prerequisite(c->join, leaf);
+        rx_task_submit(leaf);
+        rx_task_release(leaf);
+    }
+}
+
+static void test_fan_out(rx_task_pool_t* pool) {
+    printf("-- Fanning out from a running task --\n");
+
+    fan_context fan;
+    memset(&fan, 0, sizeof(fan));
+    fan.pool = pool;
+    fan.count = 32;
+    for (int i = 0; i < 32; i++)
+        fan.sums[i] = -1;
+
+    rx_task_t* fan_out = rx_task_create(pool, fan_task, &fan);
+    fan.join = rx_task_create(pool, NULL, NULL);
+    rx_task_add_prerequisite(fan.join, fan_out);
+    rx_task_submit(fan.join);
+    rx_task_submit(fan_out);
+    rx_task_wait(fan.join);
+
+    bool all = true;
+    for (int i = 0; i < 32; i++)
+        all = all && fan.sums[i] == i * i;
+    CHECK(all, "the join should wait for every subtask");
+
+    rx_task_release(fan.join);
+    rx_task_release(fan_out);
+    printf("\n");
+}
+
+// a task that waits for other tasks, which must not deadlock a pool with a single worker
+struct nested_context {
+    rx_task_pool_t* pool;
+    int value;
+};
+
+static void increment_task(void* context) {
+    __sync_fetch_and_add(&static_cast<nested_context*>(context)->value, 1);
+}
+
+static void nested_task(void* context) {
+    nested_context* c = static_cast<nested_context*>(context);
+    for (int i = 0; i < 8; i++) {
+        rx_task_t* task = rx_task_create(c->pool, increment_task, c);
+        rx_task_submit(task);
+        rx_task_wait(task);
+        rx_task_release(task);
+    }
+}
+
+static void test_nested_wait() {
+    printf("-- Waiting from a worker thread --\n");
+
+    rx_task_pool_t* pool = rx_task_pool_create(1);
+    CHECK(pool != NULL, "a pool with a single worker should be created");
+
+    nested_context context = {pool, 0};
+    rx_task_t* tasks[2];
+    for (int i = 0; i < 2; i++) {
+        tasks[i] = rx_task_create(pool, nested_task, &context);
+        rx_task_submit(tasks[i]);
+    }
+    rx_task_wait(tasks[0]);
+    rx_task_wait(tasks[1]);
+    CHECK(context.value == 16, "every nested task should have run");
+
+    rx_task_release(tasks[0]);
+    rx_task_release(tasks[1]);
+    rx_task_pool_destroy(pool);
+    printf("\n");
+}
+
+static void test_destroy() {
+    printf("-- Destroying a busy pool --\n");
+
+    rx_task_pool_t* pool = rx_task_pool_create(2);
+    nested_context context = {pool, 0};
+    for (int i = 0; i < 100; i++) {
+        rx_task_t* task = rx_task_create(pool, increment_task, &context);
+        rx_task_submit(task);
+        rx_task_release(task);
+    }
+    rx_task_pool_destroy(pool);
+
+    CHECK(context.value == 100, "submitted tasks should run before the pool is destroyed");
+    printf("\n");
+}
+
+int main(int argc, char* const argv[]) {
+    rx_task_pool_t* pool = rx_task_pool_shared();
+    CHECK(pool != NULL, "the shared pool should be created");
+    CHECK(rx_task_pool_shared() == pool, "the shared pool should be created once");
+
+    test_dependencies(pool);
+    test_fan_out(pool);
+    test_nested_wait();
+    test_destroy();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("-- All task pool tests passed --\n");
+    return 0;
+}
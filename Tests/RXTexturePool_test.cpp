@@ -0,0 +1,264 @@
+/*
+ *  RXTexturePool_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 05/11/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Rendering/Graphics/RXTexturePool.h"
+
+
+static int failures = 0;
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s\n", message); \
+            failures++; \
+        } \
+    } while (0)
+
+static const uint16_t kCardWidth = 608;
+static const uint16_t kCardHeight = 392;
+static const uint64_t kMB = 1024 * 1024;
+
+// stands in for GL: hands out texture names and records the textures the pool evicts
+struct textures_t {
+    uint32_t next_name;
+    std::vector<uint32_t> evicted;
+
+    textures_t() : next_name(1) {}
+
+    static void evict(void* context, uint32_t texture) {
+        static_cast<textures_t*>(context)->evicted.push_back(texture);
+    }
+
+    // acquires a texture the way the broker does
+    rx_texture_grant acquire(rx_texture_pool_t* pool, uint16_t width, uint16_t height) {
+        rx_texture_grant grant;
+        rx_texture_pool_acquire(pool, width, height, &grant);
+        if (grant.texture == 0) {
+            grant.texture = next_name++;
+            rx_texture_pool_attach(pool, grant.slot, grant.texture);
+        }
+        return grant;
+    }
+};
+
+static rx_texture_pool_stats stats_of(rx_texture_pool_t* pool) {
+    rx_texture_pool_stats stats;
+    rx_texture_pool_get_stats(pool, &stats);
+    return stats;
+}
+
+static void test_size_classes() {
+    printf("-- Size classes --\n");
+
+    textures_t textures;
+    rx_texture_pool_t* pool = rx_texture_pool_create(kCardWidth, kCardHeight, 64 * kMB, textures_t::evict, &textures);
+
+    uint16_t w, h;
+    rx_texture_pool_size_class(pool, 1, 1, &w, &h);
+    CHECK(w == 32 && h == 32, "small requests should round up to 32x32");
+    rx_texture_pool_size_class(pool, 100, 33, &w, &h);
+    CHECK(w == 128 && h == 64, "requests should round up to powers of two");
+    rx_texture_pool_size_class(pool, 512, 512, &w, &h);
+    CHECK(w == 512 && h == 512, "a power of two should be its own class");
+    rx_texture_pool_size_class(pool, 600, 100, &w, &h);
+    CHECK(w == kCardWidth && h == kCardHeight, "requests past 512 that fit in the card should get the card class");
+    rx_texture_pool_size_class(pool, 1000, 20, &w, &h);
+    CHECK(w == 1000 && h == 20, "requests larger than the card should get their own class");
+
+    CHECK(stats_of(pool).classes == 26, "the pool should start with the standard classes");
+
+    rx_texture_pool_free(pool);
+    printf("\n");
+}
+
+static void test_reuse() {
+    printf("-- Reusing idle textures --\n");
+
+    textures_t textures;
+    rx_texture_pool_t* pool = rx_texture_pool_create(kCardWidth, kCardHeight, 64 * kMB, textures_t::evict, &textures);
+
+    rx_texture_grant a = textures.acquire(pool, 100, 100);
+    rx_texture_grant b = textures.acquire(pool, 120, 90);
+    CHECK(a.width == 128 && a.height == 128, "the grant should have the size of the class");
+    CHECK(a.texture != b.texture, "textures in use should not be shared");
+    CHECK(stats_of(pool).misses == 2 && stats_of(pool).hits == 0, "new textures should be misses");
+
+    rx_texture_pool_release(pool, a.slot);
+    rx_texture_pool_release(pool, b.slot);
+    CHECK(stats_of(pool).idle_bytes == 2 * 128 * 128 * 4, "released textures should be idle");
+
+    // the most recently released texture of the class is reused first
+    rx_texture_grant c = textures.acquire(pool, 128, 128);
+    CHECK(c.texture == b.texture, "the most recently released texture should be reused");
+    CHECK(stats_of(pool).hits == 1, "reusing an idle texture should be a hit");
+
+    rx_texture_grant d = textures.acquire(pool, 64, 64);
+    CHECK(d.texture != a.texture, "an idle texture of another class should not be reused");
+
+    rx_texture_pool_stats stats = stats_of(pool);
+    CHECK(stats.resident_textures == 3 && stats.resident_bytes == 2 * 128 * 128 * 4 + 64 * 64 * 4, "resident bytes should count every texture");
+    CHECK(stats.requested_bytes == (100 * 100 + 120 * 90 + 128 * 128 + 64 * 64) * 4, "requested bytes should count the requested sizes");
+    CHECK(stats.granted_bytes == (3 * 128 * 128 + 64 * 64) * 4, "granted bytes should count the class sizes");
+    CHECK(textures.evicted.empty(), "nothing should be evicted within the budget");
+
+    rx_texture_pool_free(pool);
+    printf("\n");
+}
+
+static void test_budget() {
+    printf("-- Enforcing the budget --\n");
+
+    // a budget of four 512x512 textures
+    textures_t textures;
+    const uint64_t texture = 512 * 512 * 4;
+    rx_texture_pool_t* pool = rx_texture_pool_create(kCardWidth, kCardHeight, 4 * texture, textures_t::evict, &textures);
+
+    std::vector<rx_texture_grant> grants;
+    for (int i = 0; i < 4; i++)
+        grants.push_back(textures.acquire(pool, 512, 512));
+    for (int i = 0; i < 4; i++)
+        rx_texture_pool_release(pool, grants[i].slot);
+
+    // a texture of another class makes room by evicting the least recently released texture
+    rx_texture_grant other = textures.acquire(pool, 256, 512);
+    CHECK(textures.evicted.size() == 1 && textures.evicted[0] == grants[0].texture, "the least recently released texture should be evicted");
+    CHECK(stats_of(pool).resident_bytes <= 4 * texture, "the pool should stay within the budget");
+
+    // textures in use are never evicted; requests past the budget are still granted
+    std::vector<rx_texture_grant> in_use;
+    for (int i = 0; i < 5; i++)
+        in_use.push_back(textures.acquire(pool, 512, 512));
+    rx_texture_pool_stats stats = stats_of(pool);
+    CHECK(stats.idle_bytes == 0, "every idle texture should be reused or evicted");
+    CHECK(stats.over_budget == 2, "new textures past the budget should be counted");
+    CHECK(std::find(textures.evicted.begin(), textures.evicted.end(), other.texture) == textures.evicted.end(), "a texture in use should not be evicted");
+
+    // releasing textures while over budget evicts them right away
+    size_t evictions = textures.evicted.size();
+    rx_texture_pool_release(pool, in_use[0].slot);
+    CHECK(textures.evicted.size() == evictions + 1 && textures.evicted.back() == in_use[0].texture, "a texture released over budget should be evicted");
+
+    // lowering the budget evicts idle textures
+    rx_texture_pool_release(pool, other.slot);
+    for (int i = 1; i < 5; i++)
+        rx_texture_pool_release(pool, in_use[i].slot);
+    rx_texture_pool_set_budget(pool, texture);
+    stats = stats_of(pool);
+    CHECK(stats.resident_bytes == texture && stats.resident_textures == 1, "a lower budget should evict idle textures");
+    CHECK(stats.evictions == textures.evicted.size(), "every eviction should be counted");
+
+    rx_texture_pool_free(pool);
+    printf("\n");
+}
+
+static void test_custom_classes() {
+    printf("-- Custom classes --\n");
+
+    textures_t textures;
+    rx_texture_pool_t* pool = rx_texture_pool_create(kCardWidth, kCardHeight, 64 * kMB, textures_t::evict, &textures);
+
+    rx_texture_grant a = textures.acquire(pool, 1000, 20);
+    CHECK(stats_of(pool).classes == 27, "a large request should add a class");
+    rx_texture_grant b = textures.acquire(pool, 1000, 20);
+    CHECK(stats_of(pool).classes == 27, "requests of the same size should share their class");
+
+    rx_texture_pool_release(pool, a.slot);
+    rx_texture_pool_release(pool, b.slot);
+    rx_texture_pool_trim(pool, 0);
+    CHECK(textures.evicted.size() == 2, "trimming should evict every idle texture");
+    CHECK(stats_of(pool).classes == 26, "a custom class should go away with its last texture");
+
+    // the entry of the class is reused by the next custom class
+    uint32_t class_count = rx_texture_pool_class_count(pool);
+    textures.acquire(pool, 700, 700);
+    CHECK(rx_texture_pool_class_count(pool) == class_count, "the entry of a class that went away should be reused");
+    rx_texture_pool_class info;
+    bool found = false;
+    for (uint32_t i = 0; i < class_count; i++) {
+        if (rx_texture_pool_get_class(pool, i, &info) && info.width == 700)
+            found = (info.height == 700 && info.textures == 1 && info.requests == 1);
+    }
+    CHECK(found, "the new class should be reported");
+
+    // a texture that could not be created gives its slot back
+    rx_texture_grant failed;
+    rx_texture_pool_acquire(pool, 2000, 2000, &failed);
+    rx_texture_pool_discard(pool, failed.slot);
+    CHECK(stats_of(pool).classes == 27 && stats_of(pool).resident_textures == 1, "a discarded slot should not stay resident");
+
+    rx_texture_pool_free(pool);
+    printf("\n");
+}
+
+// the picture textures of a walk through cards: each card acquires the textures of its pictures and releases them
+// when the player leaves; the pool must stay consistent with a count of the textures it handed out
+static void test_card_walk() {
+    printf("-- Card walk --\n");
+
+    static const uint16_t sizes[][2] = {
+        {608, 392}, {608, 392}, {100, 80}, {33, 33}, {200, 150}, {64, 300}, {608, 100}, {1000, 40}, {48, 48}, {400, 392},
+    };
+    const uint32_t size_count = sizeof(sizes) / sizeof(sizes[0]);
+
+    textures_t textures;
+    rx_texture_pool_t* pool = rx_texture_pool_create(kCardWidth, kCardHeight, 8 * kMB, textures_t::evict, &textures);
+
+    srand(48);
+    bool consistent = true;
+    std::vector<rx_texture_grant> card;
+    for (int visit = 0; visit < 2000; visit++) {
+        uint32_t pictures = 1 + rand() % 12;
+        for (uint32_t i = 0; i < pictures; i++) {
+            const uint16_t* size = sizes[rand() % size_count];
+            card.push_back(textures.acquire(pool, size[0], size[1]));
+        }
+
+        rx_texture_pool_stats stats = stats_of(pool);
+        if (stats.resident_bytes > stats.budget && stats.idle_bytes != 0)
+            consistent = false;
+        if (stats.resident_textures != textures.next_name - 1 - textures.evicted.size())
+            consistent = false;
+
+        for (size_t i = 0; i < card.size(); i++)
+            rx_texture_pool_release(pool, card[i].slot);
+        card.clear();
+    }
+    CHECK(consistent, "the pool should stay within its budget and account for every texture");
+
+    rx_texture_pool_stats stats = stats_of(pool);
+    CHECK(stats.misses == textures.next_name - 1, "every miss should create a texture");
+    printf("%llu requests, hit rate %.3f, waste %.3f, %llu evictions\n", (unsigned long long)(stats.hits + stats.misses),
+        (double)stats.hits / (stats.hits + stats.misses), 1.0 - (double)stats.requested_bytes / stats.granted_bytes,
+        (unsigned long long)stats.evictions);
+
+    rx_texture_pool_free(pool);
+    printf("\n");
+}
+
+int main(int argc, char* const argv[]) {
+    test_size_classes();
+    test_reuse();
+    test_budget();
+    test_custom_classes();
+    test_card_walk();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("-- All texture pool tests passed --\n");
+    return 0;
+}
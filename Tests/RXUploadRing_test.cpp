@@ -0,0 +1,202 @@
+/*
+ *  RXUploadRing_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 07/11/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "Rendering/Graphics/RXUploadRing.h"
+
+
+static int failures = 0;
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s\n", message); \
+            failures++; \
+        } \
+    } while (0)
+
+static const uint32_t kSlotSize = 1024 * 1024 * 4;
+
+// stands in for the GPU: an upload is done after it has been in flight for a number of steps
+struct gpu_t {
+    std::vector<int> remaining;
+
+    explicit gpu_t(uint32_t slots) : remaining(slots, 0) {}
+
+    static bool test(void* context, uint32_t slot) {
+        gpu_t* gpu = static_cast<gpu_t*>(context);
+        return gpu->remaining[slot] <= 0;
+    }
+
+    void step() {
+        for (size_t i = 0; i < remaining.size(); i++)
+            remaining[i]--;
+    }
+
+    // finishing a fence waits for the upload
+    void finish(uint32_t slot) {
+        remaining[slot] = 0;
+    }
+};
+
+static rx_upload_ring_stats stats_of(rx_upload_ring_t* ring) {
+    rx_upload_ring_stats stats;
+    rx_upload_ring_get_stats(ring, &stats);
+    return stats;
+}
+
+static void test_rotation() {
+    printf("-- Handing out slots --\n");
+
+    gpu_t gpu(3);
+    rx_upload_ring_t* ring = rx_upload_ring_create(3, kSlotSize, gpu_t::test, &gpu);
+
+    // free slots are handed out in turn
+    uint32_t slots[3];
+    for (int i = 0; i < 3; i++) {
+        CHECK(rx_upload_ring_acquire(ring, 1000, &slots[i]) == RX_UPLOAD_SLOT_READY, "a free slot should be ready");
+        gpu.remaining[slots[i]] = 2;
+        rx_upload_ring_submit(ring, slots[i], 1000);
+    }
+    CHECK(slots[0] == 0 && slots[1] == 1 && slots[2] == 2, "slots should be handed out in turn");
+    CHECK(stats_of(ring).slots_in_flight == 3, "submitted slots should be in flight");
+
+    // a slot in flight whose upload is done is reused without waiting
+    gpu.step();
+    gpu.step();
+    uint32_t slot;
+    CHECK(rx_upload_ring_acquire(ring, 1000, &slot) == RX_UPLOAD_SLOT_READY && slot == 0, "a done slot should be reused without waiting");
+    rx_upload_ring_submit(ring, slot, 1000);
+    gpu.remaining[slot] = 5;
+
+    // when every slot is busy, the oldest upload is waited for
+    gpu.remaining[1] = 3;
+    gpu.remaining[2] = 3;
+    CHECK(rx_upload_ring_acquire(ring, 1000, &slot) == RX_UPLOAD_SLOT_IN_FLIGHT && slot == 1, "the oldest busy slot should be handed out to wait on");
+    CHECK(stats_of(ring).fence_waits == 1, "waiting for a fence should be counted");
+    gpu.finish(slot);
+    rx_upload_ring_cancel(ring, slot);
+
+    // a slot given back is free again
+    CHECK(rx_upload_ring_acquire(ring, 1000, &slot) == RX_UPLOAD_SLOT_READY && slot == 1, "a cancelled slot should be free");
+    rx_upload_ring_cancel(ring, slot);
+
+    rx_upload_ring_free(ring);
+    printf("\n");
+}
+
+static void test_unbuffered() {
+    printf("-- Uploads without a slot --\n");
+
+    gpu_t gpu(2);
+    rx_upload_ring_t* ring = rx_upload_ring_create(2, kSlotSize, gpu_t::test, &gpu);
+
+    uint32_t slot;
+    CHECK(rx_upload_ring_acquire(ring, kSlotSize + 1, &slot) == RX_UPLOAD_SLOT_NONE && slot == RX_UPLOAD_RING_NO_SLOT, "a picture larger than a slot should not get one");
+    rx_upload_ring_submit(ring, slot, kSlotSize + 1);
+
+    // every slot being written leaves none to hand out
+    uint32_t a, b;
+    rx_upload_ring_acquire(ring, 10, &a);
+    rx_upload_ring_acquire(ring, 10, &b);
+    CHECK(rx_upload_ring_acquire(ring, 10, &slot) == RX_UPLOAD_SLOT_NONE, "no slot should be handed out while every slot is written");
+    CHECK(stats_of(ring).fence_waits == 0, "a slot being written should not be waited for");
+
+    rx_upload_ring_stats stats = stats_of(ring);
+    CHECK(stats.unbuffered_uploads == 2, "uploads without a slot should be counted");
+    CHECK(stats.uploads == 1 && stats.upload_bytes == kSlotSize + 1, "uploads from client memory should count their bytes");
+    CHECK(stats.slots_in_flight == 0, "an upload from client memory should not put a slot in flight");
+
+    rx_upload_ring_free(ring);
+    printf("\n");
+}
+
+static void test_frames() {
+    printf("-- Frame counters --\n");
+
+    gpu_t gpu(3);
+    rx_upload_ring_t* ring = rx_upload_ring_create(3, kSlotSize, gpu_t::test, &gpu);
+
+    uint32_t slot;
+    rx_upload_ring_acquire(ring, 500, &slot);
+    rx_upload_ring_submit(ring, slot, 500);
+    rx_upload_ring_acquire(ring, 700, &slot);
+    rx_upload_ring_submit(ring, slot, 700);
+    rx_upload_ring_end_frame(ring);
+    CHECK(stats_of(ring).last_frame_upload_bytes == 1200, "a frame should count the bytes uploaded during it");
+
+    rx_upload_ring_end_frame(ring);
+    rx_upload_ring_stats stats = stats_of(ring);
+    CHECK(stats.last_frame_upload_bytes == 0 && stats.peak_frame_upload_bytes == 1200, "the peak should outlive its frame");
+    CHECK(stats.frames == 2 && stats.upload_bytes == 1200, "totals should not be reset with the frames");
+
+    rx_upload_ring_free(ring);
+    printf("\n");
+}
+
+// the pictures of a card walk, each uploaded during a frame while the GPU reads the previous uploads for a frame or
+// two; the ring should rarely have to wait with three slots, and more often with one, which is the single shared
+// unpack buffer the ring replaces
+static double waits_per_upload(uint32_t slot_count) {
+    gpu_t gpu(slot_count);
+    rx_upload_ring_t* ring = rx_upload_ring_create(slot_count, kSlotSize, gpu_t::test, &gpu);
+
+    srand(50);
+    for (int frame = 0; frame < 5000; frame++) {
+        uint32_t uploads = (rand() % 4 == 0) ? 1 + rand() % 3 : 0;
+        for (uint32_t i = 0; i < uploads; i++) {
+            uint32_t slot;
+            rx_upload_slot_status_t status = rx_upload_ring_acquire(ring, 608 * 392 * 4, &slot);
+            if (status == RX_UPLOAD_SLOT_IN_FLIGHT)
+                gpu.finish(slot);
+            if (status != RX_UPLOAD_SLOT_NONE)
+                gpu.remaining[slot] = 1 + rand() % 2;
+            rx_upload_ring_submit(ring, slot, 608 * 392 * 4);
+        }
+        rx_upload_ring_end_frame(ring);
+        gpu.step();
+    }
+
+    rx_upload_ring_stats stats = stats_of(ring);
+    double waits = static_cast<double>(stats.fence_waits) / stats.uploads;
+    printf("%u slots: %llu uploads, %llu fence waits (%.3f per upload), peak %llu bytes per frame\n", slot_count,
+        (unsigned long long)stats.uploads, (unsigned long long)stats.fence_waits, waits,
+        (unsigned long long)stats.peak_frame_upload_bytes);
+    rx_upload_ring_free(ring);
+    return waits;
+}
+
+static void test_card_walk() {
+    printf("-- Card walk --\n");
+
+    double single = waits_per_upload(1);
+    double triple = waits_per_upload(3);
+    CHECK(triple < single / 4, "three slots should wait far less than a single buffer");
+
+    printf("\n");
+}
+
+int main(int argc, char* const argv[]) {
+    test_rotation();
+    test_unbuffered();
+    test_frames();
+    test_card_walk();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("-- All upload ring tests passed --\n");
+    return 0;
+}
@@ -0,0 +1,354 @@
+/*
+ *  RXWaterProgram_test.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 02/11/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Engine/RXWaterProgram.h"
+
+
+static int failures = 0;
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED: %s\n", message); \
+            failures++; \
+        } \
+    } while (0)
+
+static const uint32_t kWidth = 608;
+static const uint32_t kHeight = 392;
+
+static uint32_t seed = 0x5eed1e55;
+
+static uint32_t random_number(uint32_t limit) {
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 8) % limit;
+}
+
+// an SFXE resource in host byte order, as rx_card_swap_sfxe leaves it, built from frame programs
+struct sfxe_resource {
+    std::vector<uint8_t> bytes;
+
+    const struct rx_sfxe_record* record() const {
+        return reinterpret_cast<const struct rx_sfxe_record*>(&bytes[0]);
+    }
+    const uint32_t* offsets() const {
+        return reinterpret_cast<const uint32_t*>(&bytes[record()->offset_table]);
+    }
+};
+
+static sfxe_resource make_sfxe(uint16_t top, const std::vector<std::vector<uint16_t> >& frames) {
+    struct rx_sfxe_record record;
+    memset(&record, 0, sizeof(record));
+    record.magic = 0x50;
+    record.frame_count = static_cast<uint16_t>(frames.size());
+    record.offset_table = sizeof(record);
+    record.rect.top = top;
+    record.rect.right = static_cast<uint16_t>(kWidth);
+    record.rect.bottom = static_cast<uint16_t>(kHeight);
+    record.fps = 15;
+
+    sfxe_resource sfxe;
+    sfxe.bytes.resize(sizeof(record) + frames.size() * sizeof(uint32_t));
+    memcpy(&sfxe.bytes[0], &record, sizeof(record));
+    for (size_t f = 0; f < frames.size(); f++) {
+        uint32_t offset = static_cast<uint32_t>(sfxe.bytes.size());
+        memcpy(&sfxe.bytes[sizeof(record) + f * sizeof(uint32_t)], &offset, sizeof(offset));
+        const uint8_t* words = reinterpret_cast<const uint8_t*>(&frames[f][0]);
+        sfxe.bytes.insert(sfxe.bytes.end(), words, words + frames[f].size() * sizeof(uint16_t));
+    }
+    return sfxe;
+}
+
+// a frame program with spans of random widths on rows below top, like the programs of the water effects
+static std::vector<uint16_t> random_frame(uint16_t top, uint16_t rows) {
+    std::vector<uint16_t> program;
+    for (uint16_t row = 0; row < rows; row++) {
+        uint32_t span_count = random_number(5);
+        for (uint32_t i = 0; i < span_count; i++) {
+            uint16_t width = static_cast<uint16_t>(1 + random_number(80));
+            program.push_back(3);
+            program.push_back(static_cast<uint16_t>(random_number(kWidth - width + 1)));
+            program.push_back(static_cast<uint16_t>(random_number(kWidth - width + 1)));
+            program.push_back(static_cast<uint16_t>(top + random_number(rows)));
+            program.push_back(width);
+        }
+        program.push_back(1);
+    }
+    program.push_back(4);
+    return program;
+}
+
+// a frame program like the ones of the water effects: every row is cut into segments that are shifted by a little,
+// where consecutive segments often have the same shift, and the segments of a row are copied in any order
+static std::vector<uint16_t> random_water_frame(uint16_t top, uint16_t rows) {
+    std::vector<uint16_t> program;
+    for (uint16_t row = 0; row < rows; row++) {
+        std::vector<std::vector<uint16_t> > segments;
+        uint32_t x = 2;
+        while (x < kWidth - 2) {
+            uint16_t width = static_cast<uint16_t>(std::min<uint32_t>(1 + random_number(48), kWidth - 2 - x));
+            int dx = static_cast<int>(random_number(3)) - 1;
+            int dy = (row == 0 || row == rows - 1) ? 0 : static_cast<int>(random_number(3)) - 1;
+            uint16_t copy[] = {3, static_cast<uint16_t>(x), static_cast<uint16_t>(x + dx), static_cast<uint16_t>(top + row + dy), width};
+            segments.push_back(std::vector<uint16_t>(copy, copy + 5));
+            x += width;
+        }
+        for (size_t i = segments.size(); i > 1; i--)
+            std::swap(segments[i - 1], segments[random_number(static_cast<uint32_t>(i))]);
+        for (size_t i = 0; i < segments.size(); i++)
+            program.insert(program.end(), segments[i].begin(), segments[i].end());
+        program.push_back(1);
+    }
+    program.push_back(4);
+    return program;
+}
+
+// draws the quads of a frame the way the GPU does, sampling the nearest texel at the center of every covered pixel
+static void rasterize_quads(const float* vertices, const rx_water_frame& frame, const uint32_t* source, uint32_t* destination) {
+    const float* quad = vertices + frame.first_span * RX_WATER_QUAD_VERTICES * RX_WATER_VERTEX_FLOATS;
+    for (uint32_t i = 0; i < frame.span_count; i++, quad += RX_WATER_QUAD_VERTICES * RX_WATER_VERTEX_FLOATS) {
+        float x0 = quad[0], y0 = quad[1], s0 = quad[2], t0 = quad[3];
+        float x1 = quad[8], y1 = quad[9], s1 = quad[10], t1 = quad[11];
+        for (uint32_t y = 0; y < kHeight; y++) {
+            float cy = y + 0.5f;
+            if (cy < y0 || cy >= y1)
+                continue;
+            uint32_t t = static_cast<uint32_t>(floorf(t0 + (cy - y0) * (t1 - t0) / (y1 - y0)));
+            for (uint32_t x = 0; x < kWidth; x++) {
+                float cx = x + 0.5f;
+                if (cx < x0 || cx >= x1)
+                    continue;
+                uint32_t s = static_cast<uint32_t>(floorf(s0 + (cx - x0) * (s1 - s0) / (x1 - x0)));
+                destination[y * kWidth + x] = source[t * kWidth + s];
+            }
+        }
+    }
+}
+
+static void test_compile() {
+    printf("-- Compiling water programs --\n");
+
+    std::vector<std::vector<uint16_t> > frames;
+    const uint16_t first[] = {3, 10, 20, 101, 5, 1, 1, 3, 0, 600, 100, 8, 3, 30, 40, 102, 2, 4};
+    frames.push_back(std::vector<uint16_t>(first, first + sizeof(first) / sizeof(uint16_t)));
+    frames.push_back(std::vector<uint16_t>(1, 4));
+    sfxe_resource sfxe = make_sfxe(100, frames);
+
+    rx_water_program_t* program = rx_water_program_compile(sfxe.record(), sfxe.offsets(), kWidth, kHeight);
+    CHECK(program != NULL, "a well formed program should be compiled");
+    if (!program)
+        return;
+    CHECK(program->frame_count == 2 && program->span_count == 3, "every span should be compiled");
+    CHECK(program->frames[0].first_span == 0 && program->frames[0].span_count == 3, "the first frame should have 3 spans");
+    CHECK(program->frames[1].first_span == 3 && program->frames[1].span_count == 0, "the last frame should be empty");
+
+    const rx_water_span& span = program->spans[2];
+    CHECK(span.dst_x == 30 && span.dst_y == 102 && span.src_x == 40 && span.src_y == 102 && span.width == 2,
+          "the rows of the spans should be resolved");
+    CHECK(program->spans[1].dst_y == 102 && program->spans[0].dst_y == 100, "rows should start at the top of the effect rect");
+
+    std::vector<float> vertices(program->span_count * RX_WATER_QUAD_VERTICES * RX_WATER_VERTEX_FLOATS);
+    rx_water_program_write_quads(program, &vertices[0]);
+    const float* quad = &vertices[2 * RX_WATER_QUAD_VERTICES * RX_WATER_VERTEX_FLOATS];
+    CHECK(quad[0] == 30.f && quad[1] == 102.f && quad[2] == 40.f && quad[3] == 102.f, "the first corner of a quad should be the span origin");
+    CHECK(quad[8] == 32.f && quad[9] == 103.f && quad[10] == 42.f && quad[11] == 103.f, "the opposite corner should cover the span");
+    CHECK(rx_water_program_size(program) >= 3 * sizeof(rx_water_span), "the size should count the spans");
+    rx_water_program_free(program);
+
+    // a span past the right edge of the image, a row past the bottom and an unknown opcode
+    const uint16_t wide[] = {3, 600, 0, 100, 9, 4};
+    frames.assign(1, std::vector<uint16_t>(wide, wide + sizeof(wide) / sizeof(uint16_t)));
+    sfxe = make_sfxe(100, frames);
+    CHECK(!rx_water_program_compile(sfxe.record(), sfxe.offsets(), kWidth, kHeight), "a span past the edge should be rejected");
+
+    const uint16_t low[] = {1, 1, 3, 0, 0, 100, 9, 4};
+    frames.assign(1, std::vector<uint16_t>(low, low + sizeof(low) / sizeof(uint16_t)));
+    sfxe = make_sfxe(static_cast<uint16_t>(kHeight - 2), frames);
+    CHECK(!rx_water_program_compile(sfxe.record(), sfxe.offsets(), kWidth, kHeight), "a row past the bottom should be rejected");
+
+    const uint16_t unknown[] = {1, 2, 4};
+    frames.assign(1, std::vector<uint16_t>(unknown, unknown + sizeof(unknown) / sizeof(uint16_t)));
+    sfxe = make_sfxe(100, frames);
+    CHECK(!rx_water_program_compile(sfxe.record(), sfxe.offsets(), kWidth, kHeight), "an unknown opcode should be rejected");
+
+    printf("\n");
+}
+
+static void test_optimize() {
+    printf("-- Sorting and merging spans --\n");
+
+    std::vector<std::vector<uint16_t> > frames;
+    // [20, 30) and [10, 20) out of order and continuing each other in both images, and an empty span; [4, 12) and then
+    // [0, 8) overlapping it; the end of row 100 and the start of row 101, which continue each other in both images
+    const uint16_t sorted[] = {3, 20, 22, 100, 10, 3, 10, 12, 100, 10, 3, 40, 0, 100, 0, 1, 4};
+    const uint16_t overlapping[] = {3, 4, 0, 101, 8, 3, 0, 50, 101, 8, 4};
+    const uint16_t rows[] = {3, 600, 600, 100, 8, 1, 3, 0, 0, 101, 16, 4};
+    frames.push_back(std::vector<uint16_t>(sorted, sorted + sizeof(sorted) / sizeof(uint16_t)));
+    frames.push_back(std::vector<uint16_t>(overlapping, overlapping + sizeof(overlapping) / sizeof(uint16_t)));
+    frames.push_back(std::vector<uint16_t>(rows, rows + sizeof(rows) / sizeof(uint16_t)));
+    frames.push_back(std::vector<uint16_t>(1, 4));
+    sfxe_resource sfxe = make_sfxe(100, frames);
+
+    rx_water_program_t* program = rx_water_program_compile(sfxe.record(), sfxe.offsets(), kWidth, kHeight);
+    CHECK(program != NULL, "a well formed program should be compiled");
+    if (!program)
+        return;
+
+    const rx_water_frame* frame = &program->frames[0];
+    const rx_water_span* span = &program->spans[frame->first_span];
+    CHECK(frame->span_count == 1, "spans that continue each other should be merged and empty spans dropped");
+    CHECK(span->dst_x == 10 && span->src_x == 12 && span->width == 20, "the merged span should cover both spans");
+    CHECK(frame->run_count == 1 && program->runs[frame->first_run].dst == 100 * kWidth + 10 &&
+          program->runs[frame->first_run].src == 100 * kWidth + 12 && program->runs[frame->first_run].length == 20,
+          "the run should be the merged span");
+    CHECK(frame->dirty.left == 10 && frame->dirty.top == 100 && frame->dirty.right == 30 && frame->dirty.bottom == 101,
+          "the dirty box should bound the span");
+
+    frame = &program->frames[1];
+    span = &program->spans[frame->first_span];
+    CHECK(frame->span_count == 2 && span[0].dst_x == 4 && span[1].dst_x == 0, "overlapping spans should keep their order");
+    CHECK(frame->dirty.left == 0 && frame->dirty.right == 12, "the dirty box should bound overlapping spans");
+
+    frame = &program->frames[2];
+    CHECK(frame->span_count == 2, "spans on different rows should not be merged");
+    CHECK(frame->run_count == 1 && program->runs[frame->first_run].length == 24, "runs should be merged across rows");
+    CHECK(frame->dirty.left == 0 && frame->dirty.top == 100 && frame->dirty.right == kWidth && frame->dirty.bottom == 102,
+          "the dirty box should bound both rows");
+
+    frame = &program->frames[3];
+    CHECK(frame->span_count == 0 && frame->run_count == 0, "an empty frame should have no spans");
+    CHECK(frame->dirty.right <= frame->dirty.left || frame->dirty.bottom <= frame->dirty.top, "the dirty box of an empty frame should be empty");
+
+    CHECK(program->span_count == 5 && program->run_count == 4, "the program should count the merged spans and runs");
+    rx_water_program_free(program);
+
+    // water effects shift segments of a row by the same amount, which merges
+    frames.clear();
+    for (int f = 0; f < 4; f++)
+        frames.push_back(random_water_frame(120, 160));
+    sfxe = make_sfxe(120, frames);
+    program = rx_water_program_compile(sfxe.record(), sfxe.offsets(), kWidth, kHeight);
+    CHECK(program != NULL, "a water program should be compiled");
+    if (!program)
+        return;
+    uint32_t copies = 0;
+    for (size_t f = 0; f < frames.size(); f++) {
+        for (size_t i = 0; frames[f][i] != 4; i++) {
+            if (frames[f][i] == 3) {
+                copies++;
+                i += 4;
+            }
+        }
+    }
+    CHECK(program->span_count < copies, "merging should remove spans from water programs");
+    CHECK(program->run_count <= program->span_count, "there should be no more runs than spans");
+    for (uint32_t i = 0; i < program->frame_count; i++) {
+        const rx_water_span* spans = &program->spans[program->frames[i].first_span];
+        bool ordered = true;
+        for (uint32_t s = 1; s < program->frames[i].span_count; s++)
+            ordered = ordered && (spans[s - 1].dst_y < spans[s].dst_y ||
+                                  (spans[s - 1].dst_y == spans[s].dst_y && spans[s - 1].dst_x + spans[s - 1].width <= spans[s].dst_x));
+        CHECK(ordered, "the spans of a water frame should be sorted by destination");
+    }
+    rx_water_program_free(program);
+
+    printf("\n");
+}
+
+static void check_frames(const char* name, const std::vector<std::vector<uint16_t> >& frames, uint16_t top) {
+    sfxe_resource sfxe = make_sfxe(top, frames);
+
+    char message[128];
+    rx_water_program_t* program = rx_water_program_compile(sfxe.record(), sfxe.offsets(), kWidth, kHeight);
+    snprintf(message, sizeof(message), "the %s program should be compiled", name);
+    CHECK(program != NULL, message);
+    if (!program)
+        return;
+    std::vector<float> vertices(program->span_count * RX_WATER_QUAD_VERTICES * RX_WATER_VERTEX_FLOATS + 1);
+    rx_water_program_write_quads(program, &vertices[0]);
+
+    std::vector<uint32_t> source(kWidth * kHeight);
+    for (size_t i = 0; i < source.size(); i++)
+        source[i] = static_cast<uint32_t>(i * 2654435761u);
+
+    // the images start out as the static picture and are not cleared between frames, so run every frame twice over
+    std::vector<uint32_t> reference = source;
+    std::vector<uint32_t> applied = source;
+    std::vector<uint32_t> drawn = source;
+    bool applied_ok = true;
+    bool drawn_ok = true;
+    bool dirty_ok = true;
+    for (uint32_t i = 0; i < 2u * program->frame_count; i++) {
+        uint16_t frame = static_cast<uint16_t>(i % program->frame_count);
+        std::vector<uint32_t> previous = reference;
+        rx_water_run_microprogram(sfxe.record(), sfxe.offsets(), frame, &source[0], &reference[0], kWidth);
+        rx_water_program_apply(program, frame, &source[0], &applied[0]);
+        rasterize_quads(&vertices[0], program->frames[frame], &source[0], &drawn[0]);
+        applied_ok = applied_ok && applied == reference;
+        drawn_ok = drawn_ok && drawn == reference;
+
+        // the pixels outside of the dirty box must not change
+        const rx_core_rect_t& dirty = program->frames[frame].dirty;
+        for (uint32_t p = 0; p < kWidth * kHeight && dirty_ok; p++) {
+            uint32_t x = p % kWidth, y = p / kWidth;
+            bool inside = x >= dirty.left && x < dirty.right && y >= dirty.top && y < dirty.bottom;
+            dirty_ok = inside || previous[p] == reference[p];
+        }
+    }
+    snprintf(message, sizeof(message), "the compiled runs should reproduce every %s frame", name);
+    CHECK(applied_ok, message);
+    snprintf(message, sizeof(message), "the quads should reproduce every %s frame", name);
+    CHECK(drawn_ok, message);
+    snprintf(message, sizeof(message), "the %s frames should only change their dirty box", name);
+    CHECK(dirty_ok, message);
+    snprintf(message, sizeof(message), "the %s frames should change the image", name);
+    CHECK(reference != source, message);
+
+    rx_water_program_free(program);
+}
+
+static void test_reference() {
+    printf("-- Matching the frame programs --\n");
+
+    const uint16_t top = 120;
+    const uint16_t rows = 160;
+    std::vector<std::vector<uint16_t> > frames;
+    for (int f = 0; f < 12; f++)
+        frames.push_back(random_frame(top, rows));
+    check_frames("random", frames, top);
+
+    frames.clear();
+    for (int f = 0; f < 12; f++)
+        frames.push_back(random_water_frame(top, rows));
+    check_frames("water", frames, top);
+
+    printf("\n");
+}
+
+int main(int argc, char* const argv[]) {
+    test_compile();
+    test_optimize();
+    test_reference();
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("-- All water program tests passed --\n");
+    return 0;
+}
@@ -0,0 +1,386 @@
+/*
+ *  rxaudio_offline.mm
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 19/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+/*
+ * Renders a scripted sequence of card audio events through an offline RX::AudioRenderer into a file, as fast as the
+ * machine allows. Since nothing depends on the output device or on wall-clock time, the same script always produces
+ * the same samples, which makes the output usable as a golden file.
+ *
+ * Script format, one event per line, times in seconds ('#' starts a comment):
+ *
+ *     <time> attach <slot> <archive path> <tWAV ID> <gain> <pan> <loop>
+ *     <time> detach <slot>
+ *     <time> gain <slot> <value> <ramp duration>
+ *     <time> pan <slot> <value> <ramp duration>
+ *     <time> enable <slot>
+ *     <time> disable <slot>
+ *     <time> end
+ *
+ * Events must be sorted by time. Output is 32-bit float stereo at 44100 Hz, either as a WAVE file or as raw
+ * interleaved samples if the output path ends in .raw.
+ */
+
+#import <sysexits.h>
+#import <errno.h>
+#import <fcntl.h>
+#import <limits.h>
+#import <unistd.h>
+#import <getopt.h>
+
+#import "Base/RXBase.h"
+#import <AudioToolbox/ExtendedAudioFile.h>
+
+#import <MHKKit/MHKKit.h>
+
+#import "Base/RXThreadUtilities.h"
+#import "Base/RXTiming.h"
+#import "Base/RXLogging.h"
+
+#import "Rendering/Audio/RXAudioRenderer.h"
+#import "Rendering/Audio/RXCardAudioSource.h"
+
+using namespace RX;
+
+#define MAX_SLOTS 16
+
+static uint64_t g_decode_time = 0;
+
+@interface TimedDecompressor : NSObject <MHKAudioDecompression> {
+    id <MHKAudioDecompression> _decompressor;
+}
+
+- (id)initWithDecompressor:(id <MHKAudioDecompression>)decompressor;
+
+@end
+
+@implementation TimedDecompressor
+
+- (id)initWithDecompressor:(id <MHKAudioDecompression>)decompressor {
+    self = [super init];
+    if (!self)
+        return nil;
+
+    _decompressor = [decompressor retain];
+    return self;
+}
+
+- (void)dealloc {
+    [_decompressor release];
+    [super dealloc];
+}
+
+- (AudioStreamBasicDescription)outputFormat {
+    return [_decompressor outputFormat];
+}
+
+- (SInt64)frameCount {
+    return [_decompressor frameCount];
+}
+
+- (void)reset {
+    [_decompressor reset];
+}
+
+- (void)fillAudioBufferList:(AudioBufferList*)abl {
+    uint64_t start = RXTimingNow();
+    [_decompressor fillAudioBufferList:abl];
+    g_decode_time += RXTimingNow() - start;
+}
+
+@end
+
+struct offline_event {
+    double time;
+    char command[16];
+    int slot;
+    char path[PATH_MAX];
+    int twav;
+    float value;
+    float value2;
+    int loop;
+};
+
+static bool parse_event(const char* line, struct offline_event* event) {
+    bzero(event, sizeof(struct offline_event));
+
+    int consumed = 0;
+    if (sscanf(line, "%lf %15s%n", &event->time, event->command, &consumed) != 2)
+        return false;
+    line += consumed;
+
+    if (strcmp(event->command, "end") == 0)
+        return true;
+    if (strcmp(event->command, "attach") == 0)
+        return sscanf(line, "%d %1023s %d %f %f %d", &event->slot, event->path, &event->twav, &event->value, &event->value2, &event->loop) == 6;
+    if (strcmp(event->command, "gain") == 0 || strcmp(event->command, "pan") == 0)
+        return sscanf(line, "%d %f %f", &event->slot, &event->value, &event->value2) == 3;
+    if (strcmp(event->command, "detach") == 0 || strcmp(event->command, "enable") == 0 || strcmp(event->command, "disable") == 0)
+        return sscanf(line, "%d", &event->slot) == 1;
+    return false;
+}
+
+static void print_usage(const char* name) {
+    printf("usage: %s [-b block frames] [-o output file] script\n", name);
+}
+
+int main(int argc, char* const argv[]) {
+    NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+
+    UInt32 block_frames = 512;
+    const char* output_path = "rxaudio_offline.wav";
+
+    int ch;
+    while ((ch = getopt(argc, argv, "b:o:")) != -1) {
+        switch (ch) {
+            case 'b':
+                block_frames = (UInt32)strtoul(optarg, NULL, 10);
+                break;
+            case 'o':
+                output_path = optarg;
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(EX_USAGE);
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1 || block_frames == 0 || block_frames > AudioRenderer::kOfflineMaximumFramesPerSlice) {
+        print_usage(getprogname());
+        exit(EX_USAGE);
+    }
+
+    RXInitThreading();
+    RXTimingUpdateTimebase();
+
+    // load the script
+    FILE* script = fopen(argv[0], "r");
+    if (!script) {
+        fprintf(stderr, "failed to open %s: %s\n", argv[0], strerror(errno));
+        exit(EX_NOINPUT);
+    }
+
+    std::vector<struct offline_event> events;
+    char line[2048];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), script)) {
+        line_number++;
+        char* comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+        if (strspn(line, " \t\r\n") == strlen(line))
+            continue;
+
+        struct offline_event event;
+        if (!parse_event(line, &event) || (event.slot < 0 || event.slot >= MAX_SLOTS)) {
+            fprintf(stderr, "%s:%d: invalid event\n", argv[0], line_number);
+            exit(EX_DATAERR);
+        }
+        if (!events.empty() && event.time < events.back().time) {
+            fprintf(stderr, "%s:%d: events are not sorted by time\n", argv[0], line_number);
+            exit(EX_DATAERR);
+        }
+        events.push_back(event);
+    }
+    fclose(script);
+
+    if (events.empty() || strcmp(events.back().command, "end") != 0) {
+        fprintf(stderr, "%s: script must finish with an end event\n", argv[0]);
+        exit(EX_DATAERR);
+    }
+
+    // the output format is the mixer's output format, which is always 2 non-interleaved canonical channels at 44100 Hz
+    CAStreamBasicDescription mix_format;
+    mix_format.mSampleRate = 44100.0;
+    mix_format.SetCanonical(2, false);
+
+    int raw_fd = -1;
+    ExtAudioFileRef output_file = NULL;
+    size_t output_path_length = strlen(output_path);
+    if (output_path_length > 4 && strcmp(output_path + output_path_length - 4, ".raw") == 0) {
+        raw_fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (raw_fd == -1) {
+            fprintf(stderr, "failed to open %s: %s\n", output_path, strerror(errno));
+            exit(EX_CANTCREAT);
+        }
+    } else {
+        CAStreamBasicDescription file_format;
+        file_format.mSampleRate = 44100.0;
+        file_format.mFormatID = kAudioFormatLinearPCM;
+        file_format.mFormatFlags = kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked;
+        file_format.mChannelsPerFrame = 2;
+        file_format.mBitsPerChannel = 32;
+        file_format.mFramesPerPacket = 1;
+        file_format.mBytesPerFrame = 8;
+        file_format.mBytesPerPacket = 8;
+
+        CFURLRef url = CFURLCreateFromFileSystemRepresentation(NULL, (const UInt8*)output_path, output_path_length, false);
+        OSStatus err = ExtAudioFileCreateWithURL(url, kAudioFileWAVEType, &file_format, NULL, kAudioFileFlags_EraseFile, &output_file);
+        CFRelease(url);
+        if (err == noErr)
+            err = ExtAudioFileSetProperty(output_file, kExtAudioFileProperty_ClientDataFormat, sizeof(AudioStreamBasicDescription), &mix_format);
+        if (err != noErr) {
+            fprintf(stderr, "failed to create %s: %d\n", output_path, (int)err);
+            exit(EX_CANTCREAT);
+        }
+    }
+
+    // non-interleaved render buffers, plus an interleaving buffer for raw output
+    Float32* left = new Float32[block_frames];
+    Float32* right = new Float32[block_frames];
+    Float32* interleaved = new Float32[block_frames * 2];
+
+    AudioBufferList* abl = (AudioBufferList*)malloc(offsetof(AudioBufferList, mBuffers) + 2 * sizeof(AudioBuffer));
+    abl->mNumberBuffers = 2;
+
+    NSMutableDictionary* archives = [NSMutableDictionary dictionary];
+    CardAudioSource* sources[MAX_SLOTS];
+    bzero(sources, sizeof(sources));
+
+    uint64_t render_time = 0;
+    uint64_t total_frames = 0;
+    int exit_status = EX_OK;
+
+    try {
+        AudioRenderer renderer(true);
+        renderer.Initialize();
+
+        std::vector<struct offline_event>::iterator event = events.begin();
+        bool done = false;
+        while (!done) {
+            // dispatch every event that is due at the current sample time
+            while (event != events.end() && static_cast<uint64_t>(round(event->time * mix_format.mSampleRate)) <= total_frames) {
+                int slot = event->slot;
+                if (strcmp(event->command, "end") == 0) {
+                    done = true;
+                } else if (strcmp(event->command, "attach") == 0) {
+                    if (sources[slot]) {
+                        renderer.DetachSource(*sources[slot]);
+                        delete sources[slot];
+                        sources[slot] = NULL;
+                    }
+
+                    NSString* path = [NSString stringWithUTF8String:event->path];
+                    MHKArchive* archive = [archives objectForKey:path];
+                    if (!archive) {
+                        NSError* error = nil;
+                        archive = [[[MHKArchive alloc] initWithPath:path error:&error] autorelease];
+                        if (!archive) {
+                            fprintf(stderr, "failed to open archive %s: %s\n", event->path, [[error description] UTF8String]);
+                            exit_status = EX_NOINPUT;
+                            break;
+                        }
+                        [archives setObject:archive forKey:path];
+                    }
+
+                    NSError* error = nil;
+                    id <MHKAudioDecompression> decompressor = [archive decompressorWithSoundID:(uint16_t)event->twav error:&error];
+                    if (!decompressor) {
+                        fprintf(stderr, "failed to create a decompressor for tWAV %d: %s\n", event->twav, [[error description] UTF8String]);
+                        exit_status = EX_DATAERR;
+                        break;
+                    }
+
+                    TimedDecompressor* timed = [[[TimedDecompressor alloc] initWithDecompressor:decompressor] autorelease];
+                    sources[slot] = new CardAudioSource(timed, event->value, event->value2, event->loop != 0);
+                    renderer.AttachSource(*sources[slot]);
+                } else if (!sources[slot]) {
+                    fprintf(stderr, "%s at %f: slot %d has no source\n", event->command, event->time, slot);
+                    exit_status = EX_DATAERR;
+                    break;
+                } else if (strcmp(event->command, "detach") == 0) {
+                    renderer.DetachSource(*sources[slot]);
+                    delete sources[slot];
+                    sources[slot] = NULL;
+                } else if (strcmp(event->command, "gain") == 0) {
+                    renderer.RampSourceGain(*sources[slot], event->value, event->value2);
+                } else if (strcmp(event->command, "pan") == 0) {
+                    renderer.RampSourcePan(*sources[slot], event->value, event->value2);
+                } else if (strcmp(event->command, "enable") == 0) {
+                    sources[slot]->SetEnabled(true);
+                } else if (strcmp(event->command, "disable") == 0) {
+                    sources[slot]->SetEnabled(false);
+                }
+
+                ++event;
+            }
+            if (done || exit_status != EX_OK)
+                break;
+
+            // render up to the block size, but stop at the next event so that it lands on the right sample
+            UInt32 frames = block_frames;
+            uint64_t next_event_frame = static_cast<uint64_t>(round(event->time * mix_format.mSampleRate));
+            if (next_event_frame - total_frames < frames)
+                frames = static_cast<UInt32>(next_event_frame - total_frames);
+
+            abl->mBuffers[0].mNumberChannels = 1;
+            abl->mBuffers[0].mDataByteSize = frames * sizeof(Float32);
+            abl->mBuffers[0].mData = left;
+            abl->mBuffers[1].mNumberChannels = 1;
+            abl->mBuffers[1].mDataByteSize = frames * sizeof(Float32);
+            abl->mBuffers[1].mData = right;
+
+            uint64_t start = RXTimingNow();
+            renderer.RenderOffline(frames, abl);
+            render_time += RXTimingNow() - start;
+
+            if (output_file) {
+                XThrowIfError(ExtAudioFileWrite(output_file, frames, abl), "ExtAudioFileWrite");
+            } else {
+                for (UInt32 i = 0; i < frames; i++) {
+                    interleaved[2 * i] = left[i];
+                    interleaved[2 * i + 1] = right[i];
+                }
+                if (write(raw_fd, interleaved, frames * 2 * sizeof(Float32)) != (ssize_t)(frames * 2 * sizeof(Float32))) {
+                    fprintf(stderr, "failed to write %s: %s\n", output_path, strerror(errno));
+                    exit_status = EX_IOERR;
+                    break;
+                }
+            }
+
+            total_frames += frames;
+        }
+
+        for (int slot = 0; slot < MAX_SLOTS; slot++) {
+            if (sources[slot]) {
+                renderer.DetachSource(*sources[slot]);
+                delete sources[slot];
+            }
+        }
+    } catch (CAXException c) {
+        char errorString[256];
+        fprintf(stderr, "error %s in %s\n", c.FormatError(errorString), c.mOperation);
+        exit_status = EX_SOFTWARE;
+    }
+
+    if (output_file)
+        ExtAudioFileDispose(output_file);
+    if (raw_fd != -1)
+        close(raw_fd);
+
+    delete[] left;
+    delete[] right;
+    delete[] interleaved;
+    free(abl);
+
+    // CPU cost report; decoding happens inside the render pull, so the mix cost is the difference
+    double audio_seconds = total_frames / mix_format.mSampleRate;
+    double render_seconds = RXTimingTimestampDelta(render_time, 0);
+    double decode_seconds = RXTimingTimestampDelta(g_decode_time, 0);
+    printf("rendered %.3f s of audio (%llu frames) in %.3f s (%.1fx real-time)\n", audio_seconds, total_frames, render_seconds,
+        (render_seconds > 0.0) ? audio_seconds / render_seconds : 0.0);
+    if (audio_seconds > 0.0) {
+        printf("    decode: %.3f ms per audio second\n", 1000.0 * decode_seconds / audio_seconds);
+        printf("    mix:    %.3f ms per audio second\n", 1000.0 * (render_seconds - decode_seconds) / audio_seconds);
+    }
+
+    [pool release];
+    return exit_status;
+}
@@ -0,0 +1,334 @@
+/*
+ *  rxbyteswap_bench.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 31/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+/*
+ * Byte swapping benchmark. Gathers the records of the PLST, MLST, BLST and FLST resources and the headers and frame
+ * offset tables of the SFXE resources of a set of Mohawk stack archives, then byte-swaps each kind of record back and
+ * forth, first one field at a time the way the loaders used to, then with the kernels of Base/RXByteSwap.h, and
+ * reports records per second for both. Script programs are measured as a swapping copy of their words, the way the
+ * script arenas are built. The benchmark builds on any platform:
+ *
+ *     c++ -O2 -I. Tests/rxbyteswap_bench.cpp -o rxbyteswap_bench
+ *
+ * Add -mssse3 for the shuffle kernels on x86, or -DRX_BYTE_SWAP_SCALAR to measure the scalar fallback.
+ *
+ * usage: rxbyteswap_bench [-n iterations] [-v] [archive ...]
+ *
+ * Without archives, a synthetic stack is used. -v prints the number of records of each kind.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Base/RXByteSwap.h"
+#include "Engine/RXCoreStructures.h"
+#include "Tools/mohawk_resources.h"
+
+
+enum {
+    KIND_PLST,
+    KIND_MLST,
+    KIND_BLST,
+    KIND_FLST,
+    KIND_SFXE_HEADER,
+    KIND_SFXE_OFFSET,
+    KIND_SCRIPT_WORD,
+    KIND_COUNT
+};
+
+static const char* const kind_names[KIND_COUNT] = {
+    "PLST", "MLST", "BLST", "FLST", "SFXE header", "SFXE offset", "script word"
+};
+
+static const size_t kind_sizes[KIND_COUNT] = {
+    sizeof(struct rx_plst_record), sizeof(struct rx_mlst_record), sizeof(struct rx_blst_record),
+    sizeof(struct rx_flst_record), sizeof(struct rx_sfxe_record), sizeof(uint32_t), sizeof(uint16_t)
+};
+
+static const uint8_t sfxe_field_sizes[] = {2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 4, 4, 4, 4, 4};
+
+// the records of each kind, back to back
+struct records_t {
+    std::vector<uint8_t> data[KIND_COUNT];
+    size_t count[KIND_COUNT];
+};
+
+static inline uint64_t now_ns() {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000000ULL + tv.tv_usec * 1000ULL;
+#endif
+}
+
+static void append(records_t& records, int kind, const uint8_t* data, size_t count) {
+    records.data[kind].insert(records.data[kind].end(), data, data + count * kind_sizes[kind]);
+    records.count[kind] += count;
+}
+
+// loading
+
+static void gather_list(records_t& records, int kind, const std::vector<uint8_t>& archive, const resource_t& resource) {
+    if (resource.length < 2)
+        return;
+    const uint8_t* data = &archive[0] + resource.offset;
+    size_t count = read_be16(data);
+    if ((resource.length - 2) / kind_sizes[kind] < count)
+        return;
+    append(records, kind, data + 2, count);
+}
+
+static void gather_sfxe(records_t& records, const std::vector<uint8_t>& archive, const resource_t& resource) {
+    if (resource.length < sizeof(struct rx_sfxe_record))
+        return;
+    const uint8_t* data = &archive[0] + resource.offset;
+    append(records, KIND_SFXE_HEADER, data, 1);
+
+    uint16_t frame_count = read_be16(data + 2);
+    uint32_t offset_table = read_be32(data + 4);
+    if (offset_table > resource.length || (resource.length - offset_table) / 4 < frame_count)
+        return;
+    append(records, KIND_SFXE_OFFSET, data + offset_table, frame_count);
+}
+
+// the script words of a card are all of its script, which is close enough to its programs
+static void gather_script(records_t& records, const std::vector<uint8_t>& archive, const resource_t& resource) {
+    if (resource.length < 4)
+        return;
+    append(records, KIND_SCRIPT_WORD, &archive[0] + resource.offset + 4, (resource.length - 4) / 2);
+}
+
+static void load_archive(const char* path, records_t& records) {
+    std::vector<uint8_t> archive;
+    if (!read_file(path, archive))
+        exit(EX_NOINPUT);
+
+    static const char* types[] = {"PLST", "MLST", "BLST", "FLST", "SFXE", "CARD"};
+    for (int t = 0; t < 6; t++) {
+        std::vector<resource_t> list;
+        if (!mohawk_resources(archive, types[t], list)) {
+            fprintf(stderr, "%s: not a valid Mohawk archive\n", path);
+            exit(EX_DATAERR);
+        }
+        for (size_t i = 0; i < list.size(); i++) {
+            if (t < 4)
+                gather_list(records, t, archive, list[i]);
+            else if (t == 4)
+                gather_sfxe(records, archive, list[i]);
+            else
+                gather_script(records, archive, list[i]);
+        }
+    }
+}
+
+static void push_be16(std::vector<uint8_t>& data, uint16_t value) {
+    data.push_back(value >> 8);
+    data.push_back(value & 0xff);
+}
+
+// record counts in the proportions of the original stacks
+static void synthesize_stack(records_t& records) {
+    srandom(37);
+
+    const size_t counts[KIND_COUNT] = {2500, 400, 2200, 60, 60, 1200, 600000};
+    for (int kind = 0; kind < KIND_COUNT; kind++) {
+        std::vector<uint8_t> data;
+        for (size_t i = 0; i < counts[kind] * kind_sizes[kind] / 2; i++)
+            push_be16(data, random() % 608);
+        append(records, kind, &data[0], counts[kind]);
+    }
+}
+
+// swapping
+
+// the loaders before the kernels: one word at a time for the lists and one field at a time for the SFXE headers
+static void swap_scalar(int kind, uint8_t* data, size_t count, uint8_t* scratch) {
+    switch (kind) {
+        case KIND_SFXE_HEADER: {
+            struct rx_sfxe_record* record = (struct rx_sfxe_record*)data;
+            for (size_t i = 0; i < count; i++, record++) {
+                record->magic = rx_swap_core_word(record->magic);
+                record->frame_count = rx_swap_core_word(record->frame_count);
+                record->offset_table = rx_swap32(record->offset_table);
+                record->rect = rx_swap_core_rect(record->rect);
+                record->fps = rx_swap_core_word(record->fps);
+                record->u0 = rx_swap_core_word(record->u0);
+                record->alt_rect = rx_swap_core_rect(record->alt_rect);
+                record->u1 = rx_swap_core_word(record->u1);
+                record->alt_frame_count = rx_swap_core_word(record->alt_frame_count);
+                record->u2 = rx_swap32(record->u2);
+                record->u3 = rx_swap32(record->u3);
+                record->u4 = rx_swap32(record->u4);
+                record->u5 = rx_swap32(record->u5);
+                record->u6 = rx_swap32(record->u6);
+            }
+            break;
+        }
+        case KIND_SFXE_OFFSET:
+            for (size_t i = 0; i < count; i++) {
+                uint32_t v;
+                memcpy(&v, data + i * 4, 4);
+                v = rx_swap32(v);
+                memcpy(data + i * 4, &v, 4);
+            }
+            break;
+        case KIND_SCRIPT_WORD: {
+            uint16_t* words = (uint16_t*)scratch;
+            for (size_t i = 0; i < count; i++)
+                words[i] = read_be16(data + 2 * i);
+            memcpy(data, scratch, count * 2);
+            break;
+        }
+        default: {
+            uint16_t* words = (uint16_t*)data;
+            for (size_t i = 0; i < count * kind_sizes[kind] / 2; i++)
+                words[i] = rx_swap_core_word(words[i]);
+            break;
+        }
+    }
+}
+
+static void swap_kernels(int kind, uint8_t* data, size_t count, uint8_t* scratch, const rx_swap_layout_t* sfxe_layout) {
+    switch (kind) {
+        case KIND_SFXE_HEADER:
+            rx_swap_records(data, count, sfxe_layout);
+            break;
+        case KIND_SFXE_OFFSET:
+            rx_swap32_span(data, count);
+            break;
+        case KIND_SCRIPT_WORD:
+            rx_swap16_copy_span(scratch, data, count);
+            memcpy(data, scratch, count * 2);
+            break;
+        default:
+            rx_swap16_span(data, count * kind_sizes[kind] / 2);
+            break;
+    }
+}
+
+// returns the fastest of the iterations, which is the least disturbed by the rest of the system; every iteration swaps
+// the records an even number of passes, so they end up as they started
+static uint64_t measure(int kind, records_t& records, bool kernels, uint32_t iterations, uint32_t passes,
+                        const rx_swap_layout_t* layout) {
+    uint8_t* data = &records.data[kind][0];
+    size_t count = records.count[kind];
+    std::vector<uint8_t> scratch(records.data[kind].size() + 16);
+
+    uint64_t best_ns = UINT64_MAX;
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint64_t start = now_ns();
+        for (uint32_t pass = 0; pass < passes; pass++) {
+            if (kernels)
+                swap_kernels(kind, data, count, &scratch[0], layout);
+            else
+                swap_scalar(kind, data, count, &scratch[0]);
+        }
+        best_ns = std::min(best_ns, now_ns() - start);
+    }
+    return best_ns;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: rxbyteswap_bench [-n iterations] [-v] [archive ...]\n");
+    exit(EX_USAGE);
+}
+
+int main(int argc, char* const argv[]) {
+    uint32_t iterations = 100;
+    bool verbose = false;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "n:vh")) != -1) {
+        switch (ch) {
+            case 'n':
+                iterations = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage();
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (iterations == 0)
+        usage();
+
+    records_t records;
+    memset(records.count, 0, sizeof(records.count));
+    if (argc == 0)
+        synthesize_stack(records);
+    for (int i = 0; i < argc; i++)
+        load_archive(argv[i], records);
+
+    rx_swap_layout_t sfxe_layout;
+    if (!rx_swap_layout_init(&sfxe_layout, sfxe_field_sizes, sizeof(sfxe_field_sizes)) ||
+        sfxe_layout.size != sizeof(struct rx_sfxe_record)) {
+        fprintf(stderr, "invalid SFXE layout\n");
+        return EX_SOFTWARE;
+    }
+
+#if defined(RX_BYTE_SWAP_SSSE3)
+    const char* kernels = "SSSE3";
+#elif defined(RX_BYTE_SWAP_SSE2)
+    const char* kernels = "SSE2";
+#elif defined(RX_BYTE_SWAP_NEON)
+    const char* kernels = "NEON";
+#else
+    const char* kernels = "scalar";
+#endif
+    printf("%s kernels, best of %u iterations\n", kernels, iterations);
+    printf("\n%-12s %10s %16s %16s %8s\n", "records", "count", "scalar rec/s", "kernel rec/s", "speedup");
+
+    for (int kind = 0; kind < KIND_COUNT; kind++) {
+        size_t count = records.count[kind];
+        if (verbose)
+            printf("%s: %zu records of %zu bytes\n", kind_names[kind], count, kind_sizes[kind]);
+        if (count == 0)
+            continue;
+
+        // both variants must produce the same bytes
+        std::vector<uint8_t> original = records.data[kind];
+        std::vector<uint8_t> scratch(original.size() + 16);
+        std::vector<uint8_t> scalar = original;
+        swap_scalar(kind, &scalar[0], count, &scratch[0]);
+        swap_kernels(kind, &records.data[kind][0], count, &scratch[0], &sfxe_layout);
+        if (scalar != records.data[kind]) {
+            fprintf(stderr, "%s: the kernels do not match the scalar swap\n", kind_names[kind]);
+            return EX_SOFTWARE;
+        }
+        records.data[kind] = original;
+
+        // small kinds are swapped over and over, so that an iteration is long enough to time
+        uint32_t passes = 2 * (uint32_t)std::max<size_t>(1, 32768 / count);
+        uint64_t scalar_ns = measure(kind, records, false, iterations, passes, &sfxe_layout);
+        uint64_t kernel_ns = measure(kind, records, true, iterations, passes, &sfxe_layout);
+        double scalar_rate = (double)count * passes * 1.0e9 / std::max<uint64_t>(scalar_ns, 1);
+        double kernel_rate = (double)count * passes * 1.0e9 / std::max<uint64_t>(kernel_ns, 1);
+        printf("%-12s %10zu %16.0f %16.0f %7.2fx\n", kind_names[kind], count, scalar_rate, kernel_rate,
+               kernel_rate / scalar_rate);
+    }
+
+    return EX_OK;
+}
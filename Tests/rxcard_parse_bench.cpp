@@ -0,0 +1,468 @@
+/*
+ *  rxcard_parse_bench.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 30/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+/*
+ * Card resource parsing benchmark. Fetches and byte-swaps the PLST, MLST, BLST and FLST resources of every card in a
+ * set of Mohawk stack archives, along with the SFXE resources the FLST names, the way RXCard loads a card, first one
+ * resource after the other and then as a task graph on the shared task pool (a task per list resource, and a task per
+ * SFXE resource that the FLST task fans out into). A fetch is a copy of the resource out of the archive, which is in
+ * memory. The benchmark only depends on the portable card modules, so it builds on any platform:
+ *
+ *     c++ -O2 -I. Tests/rxcard_parse_bench.cpp Engine/RXCardResources.c Base/RXTaskPool.c -lpthread \
+ *         -o rxcard_parse_bench
+ *
+ * usage: rxcard_parse_bench [-n iterations] [-v] [archive ...]
+ *
+ * Without archives, a synthetic stack is used. -v prints a line per card.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Base/RXTaskPool.h"
+#include "Engine/RXCardResources.h"
+#include "Tools/mohawk_resources.h"
+
+
+struct blob_t {
+    const uint8_t* data;
+    size_t length;
+};
+
+// the list resources of a card, which have the card's ID, and the SFXE resources of the stack
+struct card_t {
+    std::string stack;
+    uint16_t id;
+    blob_t plst;
+    blob_t mlst;
+    blob_t blst;
+    blob_t flst;
+    const std::map<uint16_t, blob_t>* sfxes;
+};
+
+static inline uint64_t now_ns() {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000000ULL + tv.tv_usec * 1000ULL;
+#endif
+}
+
+// loading
+
+static void load_archive(const char* path, std::vector<uint8_t>& archive, std::map<uint16_t, blob_t>& sfxes,
+                         std::vector<card_t>& cards) {
+    if (!read_file(path, archive))
+        exit(EX_NOINPUT);
+
+    static const char* types[] = {"CARD", "PLST", "MLST", "BLST", "FLST", "SFXE"};
+    std::map<uint16_t, blob_t> resources[6];
+    for (int t = 0; t < 6; t++) {
+        std::vector<resource_t> list;
+        if (!mohawk_resources(archive, types[t], list)) {
+            fprintf(stderr, "%s: not a valid Mohawk archive\n", path);
+            exit(EX_DATAERR);
+        }
+        for (size_t i = 0; i < list.size(); i++) {
+            blob_t blob = {&archive[0] + list[i].offset, list[i].length};
+            resources[t][list[i].id] = blob;
+        }
+    }
+    sfxes = resources[5];
+
+    blob_t empty = {NULL, 0};
+    for (std::map<uint16_t, blob_t>::const_iterator it = resources[0].begin(); it != resources[0].end(); ++it) {
+        card_t card;
+        card.stack = path;
+        card.id = it->first;
+        card.plst = (resources[1].count(card.id)) ? resources[1][card.id] : empty;
+        card.mlst = (resources[2].count(card.id)) ? resources[2][card.id] : empty;
+        card.blst = (resources[3].count(card.id)) ? resources[3][card.id] : empty;
+        card.flst = (resources[4].count(card.id)) ? resources[4][card.id] : empty;
+        card.sfxes = &sfxes;
+        cards.push_back(card);
+    }
+}
+
+static void push_be16(std::vector<uint8_t>& data, uint16_t value) {
+    data.push_back(value >> 8);
+    data.push_back(value & 0xff);
+}
+
+static void push_be32(std::vector<uint8_t>& data, uint32_t value) {
+    push_be16(data, value >> 16);
+    push_be16(data, value & 0xffff);
+}
+
+static void synthesize_list(std::vector<uint8_t>& data, uint16_t count, size_t record_words) {
+    push_be16(data, count);
+    for (uint16_t r = 0; r < count; r++) {
+        push_be16(data, r + 1);
+        for (size_t w = 1; w < record_words; w++)
+            push_be16(data, random() % 608);
+    }
+}
+
+// an SFXE resource of frames that each copy a handful of rects, like the water effects
+static void synthesize_sfxe(std::vector<uint8_t>& data, uint16_t frame_count) {
+    const uint32_t header_size = sizeof(struct rx_sfxe_record);
+    size_t start = data.size();
+    push_be16(data, 0x0050);
+    push_be16(data, frame_count);
+    push_be32(data, header_size);
+    while (data.size() - start < header_size)
+        push_be16(data, 0);
+
+    std::vector<uint8_t> programs;
+    std::vector<uint32_t> offsets;
+    for (uint16_t f = 0; f < frame_count; f++) {
+        offsets.push_back(header_size + frame_count * 4 + (uint32_t)programs.size());
+        uint16_t copies = 20 + random() % 40;
+        for (uint16_t c = 0; c < copies; c++) {
+            push_be16(programs, 3);
+            for (int i = 0; i < 4; i++)
+                push_be16(programs, random() % 392);
+            push_be16(programs, 1);
+        }
+        push_be16(programs, 4);
+    }
+    for (uint16_t f = 0; f < frame_count; f++)
+        push_be32(data, offsets[f]);
+    data.insert(data.end(), programs.begin(), programs.end());
+}
+
+// a stack of 500 cards with a few pictures, movies and hotspots each, and a special effect on one card in 8
+static void synthesize_stack(std::vector<uint8_t>& data, std::map<uint16_t, blob_t>& sfxes, std::vector<card_t>& cards) {
+    srandom(37);
+
+    const uint16_t card_count = 500;
+    const uint16_t sfxe_count = 8;
+
+    // offsets first, since the data moves as it grows
+    std::vector<size_t> sfxe_offsets;
+    for (uint16_t s = 0; s < sfxe_count; s++) {
+        sfxe_offsets.push_back(data.size());
+        synthesize_sfxe(data, 15 + random() % 10);
+    }
+    sfxe_offsets.push_back(data.size());
+
+    std::vector<size_t> offsets;
+    for (uint16_t c = 0; c < card_count; c++) {
+        offsets.push_back(data.size());
+        synthesize_list(data, 1 + random() % 12, sizeof(struct rx_plst_record) / 2);
+        offsets.push_back(data.size());
+        synthesize_list(data, random() % 3, sizeof(struct rx_mlst_record) / 2);
+        offsets.push_back(data.size());
+        synthesize_list(data, random() % 10, sizeof(struct rx_blst_record) / 2);
+        offsets.push_back(data.size());
+        uint16_t effects = (c % 8 == 0) ? 1 + random() % 2 : 0;
+        push_be16(data, effects);
+        for (uint16_t e = 0; e < effects; e++) {
+            push_be16(data, e + 1);
+            push_be16(data, random() % sfxe_count);
+            push_be16(data, 0);
+        }
+    }
+    offsets.push_back(data.size());
+
+    for (uint16_t s = 0; s < sfxe_count; s++) {
+        blob_t blob = {&data[0] + sfxe_offsets[s], sfxe_offsets[s + 1] - sfxe_offsets[s]};
+        sfxes[s] = blob;
+    }
+    for (uint16_t c = 0; c < card_count; c++) {
+        const size_t* o = &offsets[c * 4];
+        card_t card;
+        card.stack = "synthetic";
+        card.id = c;
+        card.plst.data = &data[0] + o[0];
+        card.plst.length = o[1] - o[0];
+        card.mlst.data = &data[0] + o[1];
+        card.mlst.length = o[2] - o[1];
+        card.blst.data = &data[0] + o[2];
+        card.blst.length = o[3] - o[2];
+        card.flst.data = &data[0] + o[3];
+        card.flst.length = o[4] - o[3];
+        card.sfxes = &sfxes;
+        cards.push_back(card);
+    }
+}
+
+// parsing
+
+// a card's resources as the loader keeps them, one allocation per resource
+struct loaded_card_t {
+    const card_t* card;
+    void* lists[4];
+    std::vector<void*> sfxes;
+    uint32_t records;
+    bool malformed;
+};
+
+static void* fetch(const blob_t& blob) {
+    void* copy = malloc(blob.length ? blob.length : 1);
+    if (blob.length)
+        memcpy(copy, blob.data, blob.length);
+    return copy;
+}
+
+static const blob_t& list_blob(const card_t& card, int list) {
+    switch (list) {
+        case 0: return card.plst;
+        case 1: return card.mlst;
+        case 2: return card.blst;
+        default: return card.flst;
+    }
+}
+
+// fetches and swaps one list resource; returns its record count
+static uint16_t parse_list(loaded_card_t& loaded, int list) {
+    static bool (* const swappers[4])(void*, size_t, uint16_t*) = {
+        rx_card_swap_plst, rx_card_swap_mlst, rx_card_swap_blst, rx_card_swap_flst
+    };
+
+    const blob_t& blob = list_blob(*loaded.card, list);
+    loaded.lists[list] = fetch(blob);
+    if (!blob.length)
+        return 0;
+
+    uint16_t count = 0;
+    if (!swappers[list](loaded.lists[list], blob.length, &count))
+        loaded.malformed = true;
+    return count;
+}
+
+// fetches and swaps the SFXE resource named by an FLST record; returns the number of frames
+static uint16_t parse_sfxe(loaded_card_t& loaded, uint16_t index) {
+    const struct rx_flst_record* record = (const struct rx_flst_record*)((const uint8_t*)loaded.lists[3] + 2) + index;
+    std::map<uint16_t, blob_t>::const_iterator sfxe = loaded.card->sfxes->find(record->sfxe_id);
+    if (sfxe == loaded.card->sfxes->end()) {
+        loaded.malformed = true;
+        return 0;
+    }
+
+    loaded.sfxes[index] = fetch(sfxe->second);
+    if (!rx_card_swap_sfxe(loaded.sfxes[index], sfxe->second.length)) {
+        loaded.malformed = true;
+        return 0;
+    }
+    return ((struct rx_sfxe_record*)loaded.sfxes[index])->frame_count;
+}
+
+static void parse_serial(loaded_card_t& loaded) {
+    loaded.records = 0;
+    for (int list = 0; list < 4; list++)
+        loaded.records += parse_list(loaded, list);
+
+    uint16_t flst_count = (loaded.card->flst.length) ? read_be16(loaded.card->flst.data) : 0;
+    loaded.sfxes.assign(flst_count, NULL);
+    for (uint16_t i = 0; i < flst_count && !loaded.malformed; i++)
+        loaded.records += parse_sfxe(loaded, i);
+}
+
+// the task graph: list tasks, with the FLST task fanning out into SFXE tasks, all joined by a single task
+struct job_t {
+    loaded_card_t* loaded;
+    rx_task_t* join;
+    int list;
+    uint16_t index;
+    uint32_t records;
+    std::vector<job_t>* sfxe_jobs;  // the FLST job's SFXE jobs
+};
+
+static void sfxe_job(void* context) {
+    job_t* job = static_cast<job_t*>(context);
+    job->records = parse_sfxe(*job->loaded, job->index);
+}
+
+static void list_job(void* context) {
+    job_t* job = static_cast<job_t*>(context);
+    job->records = parse_list(*job->loaded, job->list);
+    if (job->list != 3 || job->loaded->malformed)
+        return;
+
+    // the vectors are sized before any SFXE job writes to them
+    uint16_t flst_count = job->records;
+    job->loaded->sfxes.assign(flst_count, NULL);
+    job->sfxe_jobs->resize(flst_count);
+    for (uint16_t i = 0; i < flst_count; i++) {
+        job_t& sfxe = (*job->sfxe_jobs)[i];
+        sfxe.loaded = job->loaded;
+        sfxe.index = i;
+        sfxe.records = 0;
+        rx_task_t* task = rx_task_create(rx_task_pool_shared(), sfxe_job, &sfxe);
+        rx_task_add_prerequisite(job->join, task);
+        rx_task_submit(task);
+        rx_task_release(task);
+    }
+}
+
+static void parse_parallel(loaded_card_t& loaded) {
+    rx_task_pool_t* pool = rx_task_pool_shared();
+    rx_task_t* join = rx_task_create(pool, NULL, NULL);
+
+    job_t jobs[4];
+    std::vector<job_t> sfxe_jobs;
+    for (int list = 0; list < 4; list++) {
+        job_t& job = jobs[list];
+        job.sfxe_jobs = &sfxe_jobs;
+        job.loaded = &loaded;
+        job.join = join;
+        job.list = list;
+        job.records = 0;
+        rx_task_t* task = rx_task_create(pool, list_job, &job);
+        rx_task_add_prerequisite(join, task);
+        rx_task_submit(task);
+        rx_task_release(task);
+    }
+    rx_task_submit(join);
+    rx_task_wait(join);
+    rx_task_release(join);
+
+    loaded.records = 0;
+    for (int list = 0; list < 4; list++)
+        loaded.records += jobs[list].records;
+    for (size_t i = 0; i < sfxe_jobs.size(); i++)
+        loaded.records += sfxe_jobs[i].records;
+}
+
+static void free_card(loaded_card_t& loaded) {
+    for (int list = 0; list < 4; list++)
+        free(loaded.lists[list]);
+    for (size_t i = 0; i < loaded.sfxes.size(); i++)
+        free(loaded.sfxes[i]);
+    loaded.sfxes.clear();
+}
+
+// returns the fastest of the iterations, which is the least disturbed by the rest of the system
+static uint64_t measure_card(const card_t& card, bool parallel, uint32_t iterations, uint32_t* records, bool* malformed) {
+    uint64_t best_ns = UINT64_MAX;
+    for (uint32_t i = 0; i < iterations; i++) {
+        loaded_card_t loaded;
+        loaded.card = &card;
+        loaded.malformed = false;
+        loaded.records = 0;
+
+        uint64_t start = now_ns();
+        if (parallel)
+            parse_parallel(loaded);
+        else
+            parse_serial(loaded);
+        best_ns = std::min(best_ns, now_ns() - start);
+
+        *records = loaded.records;
+        *malformed = loaded.malformed;
+        free_card(loaded);
+    }
+    return best_ns;
+}
+
+static uint64_t percentile(std::vector<uint64_t> values, double p) {
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+static void usage() {
+    fprintf(stderr, "usage: rxcard_parse_bench [-n iterations] [-v] [archive ...]\n");
+    exit(EX_USAGE);
+}
+
+int main(int argc, char* const argv[]) {
+    uint32_t iterations = 100;
+    bool verbose = false;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "n:vh")) != -1) {
+        switch (ch) {
+            case 'n':
+                iterations = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage();
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (iterations == 0)
+        usage();
+
+    std::vector<std::vector<uint8_t> > archives(argc ? argc : 1);
+    std::vector<std::map<uint16_t, blob_t> > sfxes(argc ? argc : 1);
+    std::vector<card_t> cards;
+    if (argc == 0)
+        synthesize_stack(archives[0], sfxes[0], cards);
+    for (int i = 0; i < argc; i++)
+        load_archive(argv[i], archives[i], sfxes[i], cards);
+    if (cards.empty()) {
+        fprintf(stderr, "no cards to parse\n");
+        return EX_DATAERR;
+    }
+
+    if (!rx_task_pool_shared()) {
+        fprintf(stderr, "could not create the task pool\n");
+        return EX_OSERR;
+    }
+
+    std::vector<uint64_t> serial_ns, parallel_ns;
+    uint64_t records = 0;
+    for (size_t c = 0; c < cards.size(); c++) {
+        uint32_t serial_records, parallel_records;
+        bool malformed;
+        uint64_t serial = measure_card(cards[c], false, iterations, &serial_records, &malformed);
+        uint64_t parallel = measure_card(cards[c], true, iterations, &parallel_records, &malformed);
+        if (malformed || serial_records != parallel_records) {
+            fprintf(stderr, "%s: card %hu: malformed resource\n", cards[c].stack.c_str(), cards[c].id);
+            continue;
+        }
+
+        serial_ns.push_back(serial);
+        parallel_ns.push_back(parallel);
+        records += serial_records;
+
+        if (verbose)
+            printf("%s: card %hu: %u records, serial %.2f us, task graph %.2f us\n", cards[c].stack.c_str(), cards[c].id,
+                   serial_records, serial * 1.0e-3, parallel * 1.0e-3);
+    }
+    if (serial_ns.empty())
+        return EX_DATAERR;
+
+    size_t n = serial_ns.size();
+    uint64_t total_serial_ns = 0, total_parallel_ns = 0;
+    for (size_t c = 0; c < n; c++) {
+        total_serial_ns += serial_ns[c];
+        total_parallel_ns += parallel_ns[c];
+    }
+
+    printf("%zu cards, %llu records (list records and SFXE frames), best of %u iterations\n", n,
+           (unsigned long long)records, iterations);
+    printf("\n%-10s %12s %12s %12s %16s\n", "per card", "mean us", "p50 us", "max us", "records/s");
+    printf("%-10s %12.2f %12.2f %12.2f %16.0f\n", "serial", total_serial_ns * 1.0e-3 / n, percentile(serial_ns, 0.5) * 1.0e-3,
+           percentile(serial_ns, 1.0) * 1.0e-3, records * 1.0e9 / total_serial_ns);
+    printf("%-10s %12.2f %12.2f %12.2f %16.0f\n", "task graph", total_parallel_ns * 1.0e-3 / n,
+           percentile(parallel_ns, 0.5) * 1.0e-3, percentile(parallel_ns, 1.0) * 1.0e-3, records * 1.0e9 / total_parallel_ns);
+
+    return EX_OK;
+}
@@ -0,0 +1,407 @@
+/*
+ *  rxscript_decode_bench.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 26/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+/*
+ * Script decoding benchmark. Decodes the card script and the hotspot scripts of every card in a set of Mohawk stack
+ * archives into script arenas, the way RXCard loads a card, and reports the decode time, the number of heap
+ * allocations and the arena size per card, then the same for pre-linking the decoded scripts. The benchmark only
+ * depends on the portable script modules, so it builds on any platform:
+ *
+ *     c++ -O2 -I. Tests/rxscript_decode_bench.cpp Engine/RXScriptArena.c Engine/RXScriptVerifier.cpp \
+ *         Engine/RXScriptIR.cpp -o rxscript_decode_bench
+ *
+ * usage: rxscript_decode_bench [-n iterations] [-v] [archive ...]
+ *
+ * Without archives, a synthetic stack is used. -v prints a line per card.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Engine/RXScriptArena.h"
+#include "Engine/RXScriptCommandAliases.h"
+#include "Tools/mohawk_resources.h"
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+
+
+// size of an HSPT record, which precedes each hotspot's script
+static const size_t hspt_record_size = 22;
+
+// a card's CARD resource and its HSPT resource, which has the same ID
+struct card_t {
+    std::string stack;
+    uint16_t id;
+    const uint8_t* card;
+    size_t card_length;
+    const uint8_t* hotspots;
+    size_t hotspots_length;
+};
+
+struct card_result_t {
+    uint64_t decode_ns;
+    uint64_t decode_allocations;
+    uint64_t link_ns;
+    uint64_t link_allocations;
+    size_t arena_bytes;
+    uint32_t scripts;
+    uint32_t programs;
+};
+
+static inline uint64_t now_ns() {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000000ULL + tv.tv_usec * 1000ULL;
+#endif
+}
+
+// allocation counting
+
+#if defined(__GLIBC__)
+
+// count every allocation made through the C allocator, which also serves operator new
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* p, size_t size);
+
+static uint64_t allocation_count = 0;
+
+extern "C" void* malloc(size_t size) {
+    allocation_count++;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    allocation_count++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* p, size_t size) {
+    allocation_count++;
+    return __libc_realloc(p, size);
+}
+
+static uint64_t allocations() {
+    return allocation_count;
+}
+
+#elif defined(__APPLE__)
+
+// blocks in use; the decoded scripts are still alive when this is sampled, so the difference is their allocations
+static uint64_t allocations() {
+    malloc_statistics_t statistics;
+    malloc_zone_statistics(NULL, &statistics);
+    return statistics.blocks_in_use;
+}
+
+#else
+
+static uint64_t allocations() {
+    return 0;
+}
+
+#endif
+
+// loading
+
+static void load_archive(const char* path, std::vector<uint8_t>& archive, std::vector<card_t>& cards) {
+    if (!read_file(path, archive))
+        exit(EX_NOINPUT);
+
+    std::vector<resource_t> card_resources;
+    std::vector<resource_t> hotspot_resources;
+    if (!mohawk_resources(archive, "CARD", card_resources) || !mohawk_resources(archive, "HSPT", hotspot_resources)) {
+        fprintf(stderr, "%s: not a valid Mohawk archive\n", path);
+        exit(EX_DATAERR);
+    }
+
+    std::map<uint16_t, resource_t> hotspots_by_id;
+    for (size_t i = 0; i < hotspot_resources.size(); i++)
+        hotspots_by_id[hotspot_resources[i].id] = hotspot_resources[i];
+
+    for (size_t i = 0; i < card_resources.size(); i++) {
+        card_t card;
+        card.stack = path;
+        card.id = card_resources[i].id;
+        card.card = &archive[0] + card_resources[i].offset;
+        card.card_length = card_resources[i].length;
+        card.hotspots = NULL;
+        card.hotspots_length = 0;
+
+        std::map<uint16_t, resource_t>::const_iterator hotspots = hotspots_by_id.find(card.id);
+        if (hotspots != hotspots_by_id.end()) {
+            card.hotspots = &archive[0] + hotspots->second.offset;
+            card.hotspots_length = hotspots->second.length;
+        }
+        cards.push_back(card);
+    }
+}
+
+static void push_be16(std::vector<uint8_t>& data, uint16_t value) {
+    data.push_back(value >> 8);
+    data.push_back(value & 0xff);
+}
+
+// emits a big-endian program of count opcodes, with a switch at the top level
+static void synthesize_program(std::vector<uint8_t>& data, uint16_t count) {
+    push_be16(data, RX_COMMAND_BRANCH);
+    push_be16(data, 2);
+    push_be16(data, random() % 16);
+    push_be16(data, 2);
+    for (uint16_t c = 0; c < 2; c++) {
+        push_be16(data, (c == 0) ? 0 : 0xffff);
+        push_be16(data, 2);
+        push_be16(data, RX_COMMAND_SET_VARIABLE);
+        push_be16(data, 2);
+        push_be16(data, random() % 16);
+        push_be16(data, c);
+        push_be16(data, RX_COMMAND_ACTIVATE_PLST);
+        push_be16(data, 1);
+        push_be16(data, 1 + c);
+    }
+
+    for (uint16_t i = 1; i < count; i++) {
+        push_be16(data, RX_COMMAND_CALL_EXTERNAL);
+        push_be16(data, 3);
+        push_be16(data, random() % 32);
+        push_be16(data, 1);
+        push_be16(data, random() % 4);
+    }
+}
+
+// a stack of cards with 4 card programs and 6 hotspots, each with a mouse down and a mouse inside program
+static void synthesize_stack(std::vector<uint8_t>& data, std::vector<card_t>& cards) {
+    srandom(37);
+
+    const uint16_t card_count = 500;
+    const uint16_t hotspot_count = 6;
+    std::vector<size_t> card_offsets;
+    std::vector<size_t> hotspot_offsets;
+    for (uint16_t c = 0; c < card_count; c++) {
+        // name record and zip mode flag, then the script
+        card_offsets.push_back(data.size());
+        push_be16(data, 0);
+        push_be16(data, 0);
+        const uint16_t events[] = {kScriptTypeCardOpen, kScriptTypeStartRendering, kScriptTypeCardClose, kScriptTypeIdle};
+        push_be16(data, 4);
+        for (uint16_t e = 0; e < 4; e++) {
+            uint16_t count = 1 + random() % 12;
+            push_be16(data, events[e]);
+            push_be16(data, count);
+            synthesize_program(data, count);
+        }
+
+        hotspot_offsets.push_back(data.size());
+        push_be16(data, hotspot_count);
+        for (uint16_t h = 0; h < hotspot_count; h++) {
+            for (size_t i = 0; i < hspt_record_size / 2; i++)
+                push_be16(data, 0);
+            push_be16(data, 2);
+            uint16_t count = 1 + random() % 6;
+            push_be16(data, kScriptTypeMouseDown);
+            push_be16(data, count);
+            synthesize_program(data, count);
+            push_be16(data, kScriptTypeMouseInside);
+            push_be16(data, 1);
+            push_be16(data, RX_COMMAND_SET_CURSOR);
+            push_be16(data, 1);
+            push_be16(data, 3000);
+        }
+    }
+    card_offsets.push_back(data.size());
+
+    for (uint16_t c = 0; c < card_count; c++) {
+        card_t card;
+        card.stack = "synthetic";
+        card.id = c;
+        card.card = &data[0] + card_offsets[c];
+        card.card_length = hotspot_offsets[c] - card_offsets[c];
+        card.hotspots = &data[0] + hotspot_offsets[c];
+        card.hotspots_length = card_offsets[c + 1] - hotspot_offsets[c];
+        cards.push_back(card);
+    }
+}
+
+// decoding
+
+// decodes the card's scripts the way RXCard loads them; returns the number of scripts, or 0 if a resource is malformed
+static uint32_t decode_card(const card_t& card, rx_script_t** scripts) {
+    uint32_t script_count = 0;
+    if (card.card_length < 6)
+        return 0;
+    scripts[script_count++] = rx_script_decode(card.card + 4, card.card_length - 4, NULL, NULL, NULL);
+
+    if (card.hotspots_length < 2)
+        return script_count;
+    uint16_t hotspot_count = read_be16(card.hotspots);
+    size_t offset = 2;
+    for (uint16_t h = 0; h < hotspot_count; h++) {
+        offset += hspt_record_size;
+        if (offset > card.hotspots_length)
+            break;
+
+        uint32_t script_length;
+        scripts[script_count++] = rx_script_decode(card.hotspots + offset, card.hotspots_length - offset, &script_length, NULL, NULL);
+        offset += script_length;
+    }
+    return script_count;
+}
+
+static card_result_t measure_card(const card_t& card, rx_script_t** scripts, uint32_t iterations) {
+    card_result_t result;
+    memset(&result, 0, sizeof(card_result_t));
+    result.decode_ns = UINT64_MAX;
+    result.link_ns = UINT64_MAX;
+
+    // the fastest of the iterations, which is the least disturbed by the rest of the system
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint64_t allocations_before = allocations();
+        uint64_t start = now_ns();
+        uint32_t script_count = decode_card(card, scripts);
+        uint64_t decode_ns = now_ns() - start;
+        uint64_t decode_allocations = allocations() - allocations_before;
+
+        allocations_before = allocations();
+        start = now_ns();
+        for (uint32_t s = 0; s < script_count; s++)
+            scripts[s] = rx_script_link(scripts[s]);
+        uint64_t link_ns = now_ns() - start;
+        uint64_t link_allocations = allocations() - allocations_before;
+
+        result.decode_ns = std::min(result.decode_ns, decode_ns);
+        result.link_ns = std::min(result.link_ns, link_ns);
+        result.decode_allocations = decode_allocations;
+        result.link_allocations = link_allocations;
+        result.scripts = script_count;
+        result.programs = 0;
+        result.arena_bytes = 0;
+        for (uint32_t s = 0; s < script_count; s++) {
+            for (uint16_t event = 0; event < RX_SCRIPT_EVENT_TYPE_COUNT; event++)
+                result.programs += rx_script_program_count(scripts[s], event);
+            result.arena_bytes += rx_script_size(scripts[s]);
+            rx_script_free(scripts[s]);
+        }
+    }
+    return result;
+}
+
+static uint64_t percentile(std::vector<uint64_t> values, double p) {
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+static void usage() {
+    fprintf(stderr, "usage: rxscript_decode_bench [-n iterations] [-v] [archive ...]\n");
+    exit(EX_USAGE);
+}
+
+int main(int argc, char* const argv[]) {
+    uint32_t iterations = 100;
+    bool verbose = false;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "n:vh")) != -1) {
+        switch (ch) {
+            case 'n':
+                iterations = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage();
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (iterations == 0)
+        usage();
+
+    std::vector<std::vector<uint8_t> > archives(argc ? argc : 1);
+    std::vector<card_t> cards;
+    if (argc == 0)
+        synthesize_stack(archives[0], cards);
+    for (int i = 0; i < argc; i++)
+        load_archive(argv[i], archives[i], cards);
+    if (cards.empty()) {
+        fprintf(stderr, "no cards to decode\n");
+        return EX_DATAERR;
+    }
+
+    // room for every script of a card, allocated up front so that it is not counted
+    std::vector<rx_script_t*> scripts(UINT16_MAX + 1);
+
+    std::vector<uint64_t> decode_ns, decode_allocations, link_ns, link_allocations, arena_bytes;
+    uint64_t programs = 0;
+    uint64_t script_count = 0;
+    for (size_t c = 0; c < cards.size(); c++) {
+        card_result_t result = measure_card(cards[c], &scripts[0], iterations);
+        if (result.scripts == 0) {
+            fprintf(stderr, "%s: CARD %hu: malformed script resource\n", cards[c].stack.c_str(), cards[c].id);
+            continue;
+        }
+
+        decode_ns.push_back(result.decode_ns);
+        decode_allocations.push_back(result.decode_allocations);
+        link_ns.push_back(result.link_ns);
+        link_allocations.push_back(result.link_allocations);
+        arena_bytes.push_back(result.arena_bytes);
+        programs += result.programs;
+        script_count += result.scripts;
+
+        if (verbose)
+            printf("%s: CARD %hu: %u scripts, %u programs, decode %.2f us in %llu allocations, link %.2f us in %llu allocations, %zu bytes\n",
+                   cards[c].stack.c_str(), cards[c].id, result.scripts, result.programs, result.decode_ns * 1.0e-3,
+                   (unsigned long long)result.decode_allocations, result.link_ns * 1.0e-3,
+                   (unsigned long long)result.link_allocations, result.arena_bytes);
+    }
+    if (decode_ns.empty())
+        return EX_DATAERR;
+
+    size_t n = decode_ns.size();
+    uint64_t total_decode_ns = 0, total_decode_allocations = 0, total_link_ns = 0, total_link_allocations = 0, total_bytes = 0;
+    for (size_t c = 0; c < n; c++) {
+        total_decode_ns += decode_ns[c];
+        total_decode_allocations += decode_allocations[c];
+        total_link_ns += link_ns[c];
+        total_link_allocations += link_allocations[c];
+        total_bytes += arena_bytes[c];
+    }
+
+    printf("%zu cards, %llu scripts, %llu programs, best of %u iterations\n", n, (unsigned long long)script_count,
+           (unsigned long long)programs, iterations);
+    printf("\n%-8s %12s %12s %12s %14s %14s\n", "per card", "mean us", "p50 us", "max us", "mean allocs", "max allocs");
+    printf("%-8s %12.2f %12.2f %12.2f %14.2f %14llu\n", "decode", total_decode_ns * 1.0e-3 / n, percentile(decode_ns, 0.5) * 1.0e-3,
+           percentile(decode_ns, 1.0) * 1.0e-3, (double)total_decode_allocations / n,
+           (unsigned long long)percentile(decode_allocations, 1.0));
+    printf("%-8s %12.2f %12.2f %12.2f %14.2f %14llu\n", "link", total_link_ns * 1.0e-3 / n, percentile(link_ns, 0.5) * 1.0e-3,
+           percentile(link_ns, 1.0) * 1.0e-3, (double)total_link_allocations / n,
+           (unsigned long long)percentile(link_allocations, 1.0));
+    printf("\n%.0f arena bytes per card, %llu bytes in all\n", (double)total_bytes / n, (unsigned long long)total_bytes);
+
+    return EX_OK;
+}
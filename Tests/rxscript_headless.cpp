@@ -0,0 +1,520 @@
+/*
+ *  rxscript_headless.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 23/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+/*
+ * Headless script driver. Executes the programs of captured card scripts through the script IR in a loop, with the
+ * script engine's side effects stubbed out, and reports interpreter throughput and per-opcode time histograms.
+ *
+ * Only the variable opcodes (set, increment, decrement) and branches have an effect, on a private array of stack
+ * variables; every other command is a no-op. This measures the cost of walking and dispatching programs, not the cost
+ * of the commands themselves. The driver only depends on the portable script IR, so it builds on any platform:
+ *
+ *     c++ -O2 -I. Tests/rxscript_headless.cpp Engine/RXScriptIR.cpp -o rxscript_headless
+ *
+ * usage: rxscript_headless [-n iterations] [-e event] [file ...]
+ *
+ * Each file is a captured CARD resource (.card) or HSPT resource (.hspt), as written by the debug console's
+ * capture_scripts command. Without files, a synthetic card is used. -e restricts execution to one event type (for
+ * example "open card" or "idle").
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+#include "Engine/RXScriptIR.h"
+#include "Engine/RXScriptCommandAliases.h"
+
+
+static const char* const event_names[] = {
+    "mouse down",
+    "mouse still down",
+    "mouse up",
+    "unknown 3",
+    "mouse inside",
+    "mouse exited",
+    "open card",
+    "close card",
+    "idle",
+    "start rendering",
+    "screen update",
+};
+static const uint16_t event_type_count = sizeof(event_names) / sizeof(const char*);
+
+// size of an HSPT record, which precedes each hotspot's script
+static const size_t hspt_record_size = 22;
+
+static const uint32_t opcode_slots = 256;
+static const uint32_t histogram_buckets = 32;
+
+struct program_t {
+    std::string source;
+    uint16_t event;
+    uint16_t opcode_count;
+    size_t length;
+    void* ir;
+};
+
+struct harness_t {
+    uint16_t variables[0x10000];
+    uint64_t executed;
+    uint32_t depth;
+    bool abort;
+
+    // per-opcode timing; each opcode is charged the time since the previous opcode finished, which includes the
+    // interpreter's work to reach it
+    bool timing;
+    uint64_t last;
+    uint64_t counts[opcode_slots];
+    uint64_t total_ns[opcode_slots];
+    uint64_t histograms[opcode_slots][histogram_buckets];
+};
+
+static inline uint16_t read_be16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint64_t now_ns() {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000000ULL + tv.tv_usec * 1000ULL;
+#endif
+}
+
+#pragma mark -
+#pragma mark script decoding
+
+// bounds-checked version of rx_compute_riven_script_length over a big-endian script
+static bool script_length(const uint8_t* script, size_t available, uint16_t command_count, size_t& length) {
+    size_t offset = 0;
+    for (uint16_t i = 0; i < command_count; i++) {
+        if (offset + 4 > available)
+            return false;
+        uint16_t opcode = read_be16(script + offset);
+        uint16_t argc = read_be16(script + offset + 2);
+        if (offset + 4 + 2 * (size_t)argc > available)
+            return false;
+
+        if (opcode == RX_COMMAND_BRANCH) {
+            if (argc < 2)
+                return false;
+            uint16_t case_count = read_be16(script + offset + 6);
+            offset += 4 + 2 * (size_t)argc;
+            for (uint16_t c = 0; c < case_count; c++) {
+                if (offset + 4 > available)
+                    return false;
+                uint16_t case_command_count = read_be16(script + offset + 2);
+                offset += 4;
+
+                size_t case_length;
+                if (!script_length(script + offset, available - offset, case_command_count, case_length))
+                    return false;
+                offset += case_length;
+            }
+        } else
+            offset += 4 + 2 * (size_t)argc;
+    }
+
+    length = offset;
+    return true;
+}
+
+// decodes a script (event count followed by events) and compiles its programs; returns the script's length or 0
+static size_t decode_script(const uint8_t* script, size_t available, const std::string& source, std::vector<program_t>& programs) {
+    if (available < 2)
+        return 0;
+    uint16_t event_count = read_be16(script);
+    size_t offset = 2;
+
+    for (uint16_t e = 0; e < event_count; e++) {
+        if (offset + 4 > available)
+            return 0;
+        uint16_t event = read_be16(script + offset);
+        uint16_t opcode_count = read_be16(script + offset + 2);
+        offset += 4;
+
+        size_t length;
+        if (event >= event_type_count || !script_length(script + offset, available - offset, opcode_count, length))
+            return 0;
+
+        std::vector<uint16_t> words(length / 2 + 1);
+        for (size_t w = 0; w < length / 2; w++)
+            words[w] = read_be16(script + offset + 2 * w);
+        offset += length;
+
+        program_t program;
+        program.source = source;
+        program.event = event;
+        program.opcode_count = opcode_count;
+        program.length = length;
+        program.ir = rx_script_ir_compile(&words[0], length, opcode_count, NULL);
+        if (!program.ir) {
+            fprintf(stderr, "%s: could not compile a %s program, skipping it\n", source.c_str(), event_names[event]);
+            continue;
+        }
+        programs.push_back(program);
+    }
+
+    return offset;
+}
+
+static bool load_file(const char* path, std::vector<program_t>& programs) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+    fclose(fp);
+
+    std::string source(path);
+    bool hspt = source.size() > 5 && source.compare(source.size() - 5, 5, ".hspt") == 0;
+
+    if (hspt) {
+        // hotspot count, then each hotspot's record and script
+        if (data.size() < 2)
+            goto malformed;
+        uint16_t hotspot_count = read_be16(&data[0]);
+        size_t offset = 2;
+        for (uint16_t h = 0; h < hotspot_count; h++) {
+            offset += hspt_record_size;
+            if (offset > data.size())
+                goto malformed;
+            size_t length = decode_script(&data[0] + offset, data.size() - offset, source, programs);
+            if (length == 0)
+                goto malformed;
+            offset += length;
+        }
+    } else {
+        // the card script follows the card's name record and zip mode flag
+        if (data.size() < 6 || decode_script(&data[0] + 4, data.size() - 4, source, programs) == 0)
+            goto malformed;
+    }
+    return true;
+
+malformed:
+    fprintf(stderr, "%s: malformed script resource\n", path);
+    return false;
+}
+
+// emits a big-endian script resembling a puzzle card: nested switches over a few variables and variable updates
+static void synthesize_block(std::vector<uint8_t>& script, uint16_t count, int depth) {
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t words[6];
+        uint16_t word_count;
+        if (depth > 0 && (random() % 3) == 0) {
+            uint16_t case_count = 2 + random() % 4;
+            words[0] = RX_COMMAND_BRANCH;
+            words[1] = 2;
+            words[2] = random() % 16;
+            words[3] = case_count;
+            for (uint16_t w = 0; w < 4; w++) {
+                script.push_back(words[w] >> 8);
+                script.push_back(words[w] & 0xff);
+            }
+            for (uint16_t c = 0; c < case_count; c++) {
+                uint16_t value = (c == case_count - 1 && (random() % 2)) ? 0xffff : c;
+                uint16_t case_opcode_count = 1 + random() % 4;
+                script.push_back(value >> 8);
+                script.push_back(value & 0xff);
+                script.push_back(case_opcode_count >> 8);
+                script.push_back(case_opcode_count & 0xff);
+                synthesize_block(script, case_opcode_count, depth - 1);
+            }
+            continue;
+        }
+
+        switch (random() % 4) {
+            case 0:
+                words[0] = RX_COMMAND_SET_VARIABLE;
+                words[1] = 2;
+                words[2] = random() % 16;
+                words[3] = random() % 4;
+                word_count = 4;
+                break;
+            case 1:
+                words[0] = RX_COMMAND_INCREMENT_VARIABLE;
+                words[1] = 2;
+                words[2] = random() % 16;
+                words[3] = 1;
+                word_count = 4;
+                break;
+            case 2:
+                words[0] = RX_COMMAND_ACTIVATE_PLST;
+                words[1] = 1;
+                words[2] = 1 + random() % 8;
+                word_count = 3;
+                break;
+            default:
+                words[0] = RX_COMMAND_CALL_EXTERNAL;
+                words[1] = 3;
+                words[2] = random() % 32;
+                words[3] = 1;
+                words[4] = random() % 4;
+                word_count = 5;
+                break;
+        }
+        for (uint16_t w = 0; w < word_count; w++) {
+            script.push_back(words[w] >> 8);
+            script.push_back(words[w] & 0xff);
+        }
+    }
+}
+
+static void synthesize_card(std::vector<program_t>& programs) {
+    srandom(1);
+
+    std::vector<uint8_t> script;
+    const uint16_t events[] = {6, 7, 8, 9, 0, 2};
+    const uint16_t event_count = sizeof(events) / sizeof(uint16_t);
+    script.push_back(0);
+    script.push_back(event_count);
+    for (uint16_t e = 0; e < event_count; e++) {
+        uint16_t opcode_count = 8 + random() % 24;
+        script.push_back(0);
+        script.push_back(events[e]);
+        script.push_back(opcode_count >> 8);
+        script.push_back(opcode_count & 0xff);
+        synthesize_block(script, opcode_count, 3);
+    }
+
+    decode_script(&script[0], script.size(), "synthetic", programs);
+}
+
+#pragma mark -
+#pragma mark execution
+
+static inline void charge(harness_t* harness, uint16_t opcode) {
+    if (!harness->timing)
+        return;
+
+    uint64_t t = now_ns();
+    uint64_t delta = t - harness->last;
+    harness->last = t;
+
+    uint32_t slot = (opcode < opcode_slots) ? opcode : opcode_slots - 1;
+    uint32_t bucket = 0;
+    while (bucket < histogram_buckets - 1 && (delta >> (bucket + 1)) != 0)
+        bucket++;
+
+    harness->counts[slot]++;
+    harness->total_ns[slot] += delta;
+    harness->histograms[slot][bucket]++;
+}
+
+static uint16_t harness_variable_value(void* context, uint16_t variable) {
+    harness_t* harness = reinterpret_cast<harness_t*>(context);
+    harness->executed++;
+    charge(harness, RX_COMMAND_BRANCH);
+    return harness->variables[variable];
+}
+
+static void harness_execute_command(void* context, uint16_t opcode, uint16_t argc, const uint16_t* argv) {
+    harness_t* harness = reinterpret_cast<harness_t*>(context);
+    harness->executed++;
+
+    switch (opcode) {
+        case RX_COMMAND_SET_VARIABLE:
+            if (argc >= 2)
+                harness->variables[argv[0]] = argv[1];
+            break;
+        case RX_COMMAND_INCREMENT_VARIABLE:
+            if (argc >= 2)
+                harness->variables[argv[0]] += argv[1];
+            break;
+        case RX_COMMAND_DECREMENT_VARIABLE:
+            if (argc >= 2)
+                harness->variables[argv[0]] -= argv[1];
+            break;
+        default:
+            break;
+    }
+
+    charge(harness, opcode);
+}
+
+static bool harness_should_abort(void* context) {
+    return reinterpret_cast<harness_t*>(context)->abort;
+}
+
+static void harness_enter_block(void* context) {
+    reinterpret_cast<harness_t*>(context)->depth++;
+}
+
+static void harness_exit_block(void* context) {
+    harness_t* harness = reinterpret_cast<harness_t*>(context);
+    harness->depth--;
+    if (harness->depth == 0)
+        harness->abort = false;
+}
+
+static void run(harness_t* harness, const std::vector<program_t>& programs, uint32_t iterations) {
+    rx_script_ir_executor_t executor;
+    executor.context = harness;
+    executor.variable_value = harness_variable_value;
+    executor.execute_command = harness_execute_command;
+    executor.should_abort = harness_should_abort;
+    executor.enter_block = harness_enter_block;
+    executor.exit_block = harness_exit_block;
+    executor.case_enter = NULL;
+    executor.case_exit = NULL;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (size_t p = 0; p < programs.size(); p++) {
+            harness->last = (harness->timing) ? now_ns() : 0;
+            rx_script_ir_execute(programs[p].ir, &executor);
+        }
+    }
+}
+
+static uint64_t histogram_percentile(const uint64_t* histogram, uint64_t count, double percentile) {
+    uint64_t target = (uint64_t)(count * percentile);
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < histogram_buckets; b++) {
+        seen += histogram[b];
+        if (seen > target)
+            return 1ULL << (b + 1);
+    }
+    return 1ULL << histogram_buckets;
+}
+
+static void print_report(const harness_t* harness) {
+    printf("\n%-8s %12s %10s %10s %10s  %s\n", "opcode", "count", "mean ns", "p50 ns <", "p99 ns <", "histogram (log2 ns buckets from 1 ns)");
+    for (uint32_t op = 0; op < opcode_slots; op++) {
+        uint64_t count = harness->counts[op];
+        if (count == 0)
+            continue;
+
+        char bars[histogram_buckets + 1];
+        uint32_t last_bucket = 0;
+        for (uint32_t b = 0; b < histogram_buckets; b++) {
+            uint64_t n = harness->histograms[op][b];
+            if (n)
+                last_bucket = b;
+            // one character per bucket, scaled to the share of samples
+            double share = (double)n / count;
+            bars[b] = (n == 0) ? '.' : (share < 0.01) ? '_' : (share < 0.1) ? 'o' : (share < 0.5) ? 'O' : '#';
+        }
+        bars[last_bucket + 1] = 0;
+
+        printf("%-8u %12llu %10.1f %10llu %10llu  %s\n", op, (unsigned long long)count, (double)harness->total_ns[op] / count,
+               (unsigned long long)histogram_percentile(harness->histograms[op], count, 0.5),
+               (unsigned long long)histogram_percentile(harness->histograms[op], count, 0.99), bars);
+    }
+}
+
+static void usage() {
+    fprintf(stderr, "usage: rxscript_headless [-n iterations] [-e event] [file ...]\n");
+    exit(EX_USAGE);
+}
+
+int main(int argc, char* const argv[]) {
+    uint32_t iterations = 10000;
+    int event_filter = -1;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "n:e:h")) != -1) {
+        switch (ch) {
+            case 'n':
+                iterations = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'e':
+                for (uint16_t e = 0; e < event_type_count; e++) {
+                    if (strcmp(optarg, event_names[e]) == 0)
+                        event_filter = e;
+                }
+                if (event_filter < 0) {
+                    fprintf(stderr, "unknown event type \"%s\"\n", optarg);
+                    return EX_USAGE;
+                }
+                break;
+            default:
+                usage();
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (iterations == 0)
+        usage();
+
+    std::vector<program_t> programs;
+    if (argc == 0)
+        synthesize_card(programs);
+    for (int i = 0; i < argc; i++) {
+        if (!load_file(argv[i], programs))
+            return EX_DATAERR;
+    }
+
+    if (event_filter >= 0) {
+        std::vector<program_t> filtered;
+        for (size_t p = 0; p < programs.size(); p++) {
+            if (programs[p].event == event_filter)
+                filtered.push_back(programs[p]);
+            else
+                free(programs[p].ir);
+        }
+        programs.swap(filtered);
+    }
+
+    if (programs.empty()) {
+        fprintf(stderr, "no programs to execute\n");
+        return EX_DATAERR;
+    }
+
+    size_t program_bytes = 0;
+    uint32_t per_event[event_type_count] = {0};
+    for (size_t p = 0; p < programs.size(); p++) {
+        program_bytes += programs[p].length;
+        per_event[programs[p].event]++;
+    }
+    printf("%zu programs, %zu bytes\n", programs.size(), program_bytes);
+    for (uint16_t e = 0; e < event_type_count; e++) {
+        if (per_event[e])
+            printf("    %-18s %u\n", event_names[e], per_event[e]);
+    }
+
+    harness_t* harness = reinterpret_cast<harness_t*>(calloc(1, sizeof(harness_t)));
+
+    // throughput pass, without timing overhead
+    uint64_t start = now_ns();
+    run(harness, programs, iterations);
+    double elapsed = (now_ns() - start) * 1.0e-9;
+    printf("\n%u iterations: %llu opcodes in %.3f s, %.2f M opcodes/s\n", iterations, (unsigned long long)harness->executed,
+           elapsed, harness->executed / elapsed * 1.0e-6);
+
+    // timing pass, fewer iterations since every opcode reads the clock
+    harness->timing = true;
+    run(harness, programs, (iterations + 9) / 10);
+    print_report(harness);
+
+    for (size_t p = 0; p < programs.size(); p++)
+        free(programs[p].ir);
+    free(harness);
+
+    return EX_OK;
+}
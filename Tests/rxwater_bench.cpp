@@ -0,0 +1,305 @@
+/*
+ *  rxwater_bench.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 03/11/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+/*
+ * Water effect benchmark. Byte-swaps the SFXE resources of a set of Mohawk stack archives, then runs every frame of
+ * every effect on a card-sized image, first by interpreting the frame programs the way the renderer used to, then with
+ * the runs of the compiled water programs of Engine/RXWaterProgram.h, and reports nanoseconds per frame for both. It
+ * also reports the spans of the programs before and after merging and the bytes a frame uploads to the card texture,
+ * the whole image against the dirty box of the frame. The benchmark builds on any platform:
+ *
+ *     c++ -O2 -I. Tests/rxwater_bench.cpp Engine/RXWaterProgram.c Engine/RXCardResources.c -o rxwater_bench
+ *
+ * usage: rxwater_bench [-n iterations] [-v] [archive ...]
+ *
+ * Without archives, synthetic water effects are used. -v prints a line per effect.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Engine/RXCardResources.h"
+#include "Engine/RXWaterProgram.h"
+#include "Tools/mohawk_resources.h"
+
+
+// the card viewport
+static const uint32_t kWidth = 608;
+static const uint32_t kHeight = 392;
+
+// an SFXE resource in host byte order and its compiled program
+struct effect_t {
+    std::string name;
+    std::vector<uint8_t> bytes;
+    rx_water_program_t* program;
+    uint32_t copies;
+
+    const struct rx_sfxe_record* record() const {
+        return (const struct rx_sfxe_record*)&bytes[0];
+    }
+    const uint32_t* offsets() const {
+        return (const uint32_t*)&bytes[record()->offset_table];
+    }
+};
+
+static inline uint64_t now_ns() {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000000ULL + tv.tv_usec * 1000ULL;
+#endif
+}
+
+// the copy opcodes of an effect, which are the spans the interpreter copies
+static uint32_t count_copies(const effect_t& effect) {
+    uint32_t copies = 0;
+    for (uint16_t frame = 0; frame < effect.record()->frame_count; frame++) {
+        const uint16_t* p = (const uint16_t*)(&effect.bytes[0] + effect.offsets()[frame]);
+        for (; *p != 4; p++) {
+            if (*p == 3) {
+                copies++;
+                p += 4;
+            }
+        }
+    }
+    return copies;
+}
+
+// compiles an effect, or returns false if it does not fit the card viewport
+static bool add_effect(std::vector<effect_t>& effects, const std::string& name, const std::vector<uint8_t>& bytes) {
+    effect_t effect;
+    effect.name = name;
+    effect.bytes = bytes;
+    effect.program = rx_water_program_compile(effect.record(), effect.offsets(), kWidth, kHeight);
+    if (!effect.program)
+        return false;
+    effect.copies = count_copies(effect);
+    effects.push_back(effect);
+    return true;
+}
+
+// loading
+
+static void load_archive(const char* path, std::vector<effect_t>& effects) {
+    std::vector<uint8_t> archive;
+    if (!read_file(path, archive))
+        exit(EX_NOINPUT);
+
+    std::vector<resource_t> list;
+    if (!mohawk_resources(archive, "SFXE", list)) {
+        fprintf(stderr, "%s: not a valid Mohawk archive\n", path);
+        exit(EX_DATAERR);
+    }
+    for (size_t i = 0; i < list.size(); i++) {
+        std::vector<uint8_t> bytes(&archive[0] + list[i].offset, &archive[0] + list[i].offset + list[i].length);
+        char name[64];
+        snprintf(name, sizeof(name), "SFXE %u", list[i].id);
+        if (bytes.empty() || !rx_card_swap_sfxe(&bytes[0], bytes.size()) || !add_effect(effects, name, bytes))
+            fprintf(stderr, "%s: skipping invalid %s\n", path, name);
+    }
+}
+
+static void push_words(std::vector<uint8_t>& data, const uint16_t* words, size_t count) {
+    const uint8_t* bytes = (const uint8_t*)words;
+    data.insert(data.end(), bytes, bytes + count * sizeof(uint16_t));
+}
+
+// water effects the size of the ones of the original stacks: the rows of the effect rect are cut into segments shifted
+// by a pixel or so, where neighboring segments often have the same shift, and the segments of a row are copied in no
+// particular order
+static void synthesize_effects(std::vector<effect_t>& effects) {
+    srandom(37);
+
+    for (int e = 0; e < 8; e++) {
+        struct rx_sfxe_record record;
+        memset(&record, 0, sizeof(record));
+        record.magic = 0x50;
+        record.frame_count = (uint16_t)(16 + random() % 16);
+        record.offset_table = sizeof(record);
+        record.rect.left = (uint16_t)(random() % 200);
+        record.rect.top = (uint16_t)(100 + random() % 100);
+        record.rect.right = (uint16_t)(record.rect.left + 200 + random() % (kWidth - 200 - record.rect.left));
+        record.rect.bottom = (uint16_t)(kHeight - random() % 40);
+        record.fps = 15;
+
+        std::vector<uint8_t> bytes(sizeof(record) + record.frame_count * sizeof(uint32_t));
+        for (uint16_t frame = 0; frame < record.frame_count; frame++) {
+            uint32_t offset = (uint32_t)bytes.size();
+            memcpy(&bytes[sizeof(record) + frame * sizeof(uint32_t)], &offset, sizeof(offset));
+
+            uint32_t rows = record.rect.bottom - record.rect.top;
+            for (uint32_t row = 0; row < rows; row++) {
+                std::vector<std::vector<uint16_t> > segments;
+                for (uint32_t x = record.rect.left + 1; x < record.rect.right - 1u;) {
+                    uint16_t width = (uint16_t)std::min<uint32_t>(1 + random() % 24, record.rect.right - 1u - x);
+                    int dx = (random() % 4 == 0) ? (int)(random() % 3) - 1 : 0;
+                    int dy = (row == 0 || row == rows - 1 || random() % 4) ? 0 : (int)(random() % 3) - 1;
+                    uint16_t copy[] = {3, (uint16_t)x, (uint16_t)(x + dx), (uint16_t)(record.rect.top + row + dy), width};
+                    segments.push_back(std::vector<uint16_t>(copy, copy + 5));
+                    x += width;
+                }
+                for (size_t i = segments.size(); i > 1; i--)
+                    std::swap(segments[i - 1], segments[random() % i]);
+                for (size_t i = 0; i < segments.size(); i++)
+                    push_words(bytes, &segments[i][0], segments[i].size());
+
+                const uint16_t next = 1;
+                push_words(bytes, &next, 1);
+            }
+            const uint16_t end = 4;
+            push_words(bytes, &end, 1);
+        }
+        memcpy(&bytes[0], &record, sizeof(record));
+
+        char name[64];
+        snprintf(name, sizeof(name), "synthetic %d", e);
+        add_effect(effects, name, bytes);
+    }
+}
+
+// running
+
+static void run_frames(const effect_t& effect, bool compiled, const uint32_t* source, uint32_t* destination) {
+    for (uint16_t frame = 0; frame < effect.record()->frame_count; frame++) {
+        if (compiled)
+            rx_water_program_apply(effect.program, frame, source, destination);
+        else
+            rx_water_run_microprogram(effect.record(), effect.offsets(), frame, source, destination, kWidth);
+    }
+}
+
+// returns the fastest of the iterations, which is the least disturbed by the rest of the system
+static uint64_t measure(const std::vector<effect_t>& effects, bool compiled, uint32_t iterations, const uint32_t* source,
+                        uint32_t* destination) {
+    uint64_t best_ns = UINT64_MAX;
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint64_t start = now_ns();
+        for (size_t e = 0; e < effects.size(); e++)
+            run_frames(effects[e], compiled, source, destination);
+        best_ns = std::min(best_ns, now_ns() - start);
+    }
+    return best_ns;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: rxwater_bench [-n iterations] [-v] [archive ...]\n");
+    exit(EX_USAGE);
+}
+
+int main(int argc, char* const argv[]) {
+    uint32_t iterations = 100;
+    bool verbose = false;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "n:vh")) != -1) {
+        switch (ch) {
+            case 'n':
+                iterations = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage();
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (iterations == 0)
+        usage();
+
+    std::vector<effect_t> effects;
+    if (argc == 0)
+        synthesize_effects(effects);
+    for (int i = 0; i < argc; i++)
+        load_archive(argv[i], effects);
+    if (effects.empty()) {
+        fprintf(stderr, "no water effects\n");
+        return EX_DATAERR;
+    }
+
+    std::vector<uint32_t> source(kWidth * kHeight);
+    for (size_t i = 0; i < source.size(); i++)
+        source[i] = (uint32_t)random();
+
+    uint64_t frames = 0, copies = 0, spans = 0, runs = 0, dirty_bytes = 0;
+    for (size_t e = 0; e < effects.size(); e++) {
+        const effect_t& effect = effects[e];
+
+        // both variants must produce the same image, frame after frame
+        std::vector<uint32_t> interpreted = source;
+        std::vector<uint32_t> compiled = source;
+        for (uint16_t frame = 0; frame < effect.record()->frame_count; frame++) {
+            rx_water_run_microprogram(effect.record(), effect.offsets(), frame, &source[0], &interpreted[0], kWidth);
+            rx_water_program_apply(effect.program, frame, &source[0], &compiled[0]);
+            if (interpreted != compiled) {
+                fprintf(stderr, "%s: frame %u of the compiled program does not match the interpreter\n",
+                        effect.name.c_str(), frame);
+                return EX_SOFTWARE;
+            }
+        }
+
+        uint64_t effect_dirty_bytes = 0;
+        for (uint16_t frame = 0; frame < effect.program->frame_count; frame++) {
+            const rx_core_rect_t& dirty = effect.program->frames[frame].dirty;
+            if (dirty.right > dirty.left && dirty.bottom > dirty.top)
+                effect_dirty_bytes += (uint64_t)(dirty.right - dirty.left) * (dirty.bottom - dirty.top) * sizeof(uint32_t);
+        }
+
+        if (verbose)
+            printf("%s: %u frames, %u spans, %u merged spans, %u runs, %zu program bytes, %llu dirty bytes per frame\n",
+                   effect.name.c_str(), effect.program->frame_count, effect.copies, effect.program->span_count,
+                   effect.program->run_count, rx_water_program_size(effect.program),
+                   (unsigned long long)(effect_dirty_bytes / std::max<uint16_t>(effect.program->frame_count, 1)));
+
+        frames += effect.program->frame_count;
+        copies += effect.copies;
+        spans += effect.program->span_count;
+        runs += effect.program->run_count;
+        dirty_bytes += effect_dirty_bytes;
+    }
+    if (frames == 0) {
+        fprintf(stderr, "no water effect frames\n");
+        return EX_DATAERR;
+    }
+
+    std::vector<uint32_t> destination = source;
+    uint64_t interpreted_ns = measure(effects, false, iterations, &source[0], &destination[0]);
+    uint64_t compiled_ns = measure(effects, true, iterations, &source[0], &destination[0]);
+
+    printf("%zu effects, %llu frames, best of %u iterations\n", effects.size(), (unsigned long long)frames, iterations);
+    printf("\n%-12s %12s %12s %8s\n", "", "interpreted", "compiled", "ratio");
+    printf("%-12s %12.0f %12.0f %7.2fx\n", "ns/frame", (double)interpreted_ns / frames, (double)compiled_ns / frames,
+           (double)interpreted_ns / std::max<uint64_t>(compiled_ns, 1));
+    printf("%-12s %12.1f %12.1f %7.2fx\n", "copies/frame", (double)copies / frames, (double)runs / frames,
+           (double)copies / std::max<uint64_t>(runs, 1));
+    printf("\n%-12s %12s %12s %8s\n", "", "full", "dirty box", "ratio");
+    printf("%-12s %12u %12.0f %7.2fx\n", "upload B", kWidth * kHeight * (uint32_t)sizeof(uint32_t),
+           (double)dirty_bytes / frames, (double)kWidth * kHeight * sizeof(uint32_t) * frames / std::max<uint64_t>(dirty_bytes, 1));
+    printf("\nspans: %llu in the programs, %llu after merging, %llu runs\n", (unsigned long long)copies,
+           (unsigned long long)spans, (unsigned long long)runs);
+
+    for (size_t e = 0; e < effects.size(); e++)
+        rx_water_program_free(effects[e].program);
+    return EX_OK;
+}
@@ -0,0 +1,119 @@
+/*
+ *  mohawk_resources.h
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 26/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+#if !defined(MOHAWK_RESOURCES_H)
+#define MOHAWK_RESOURCES_H
+
+/*
+ * A minimal Mohawk archive reader for the portable script tools, which cannot use MHKKit. It finds the resources of a
+ * type in an archive that has been read into memory.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+
+struct resource_t {
+    uint16_t id;
+    size_t offset;
+    size_t length;
+};
+
+static inline uint16_t read_be16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t read_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline bool read_file(const char* path, std::vector<uint8_t>& data) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    uint8_t buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+    fclose(fp);
+    return true;
+}
+
+// returns the resources of the given type; a resource's length extends to the next file in the archive, which is
+// also how MHKArchive corrects the lengths stored in the file table
+static inline bool mohawk_resources(const std::vector<uint8_t>& archive, const char type[4], std::vector<resource_t>& resources) {
+    size_t size = archive.size();
+    const uint8_t* bytes = (size) ? &archive[0] : NULL;
+
+    // MHWK chunk header, then the RSRC header
+    if (size < 28 || memcmp(bytes, "MHWK", 4) != 0 || memcmp(bytes + 8, "RSRC", 4) != 0)
+        return false;
+    size_t rsrc_dir = read_be32(bytes + 20);
+    size_t file_table = rsrc_dir + read_be16(bytes + 24);
+
+    // file table
+    if (file_table + 4 > size)
+        return false;
+    uint32_t file_count = read_be32(bytes + file_table);
+    if (file_table + 4 + (size_t)file_count * 10 > size)
+        return false;
+
+    std::vector<size_t> file_offsets(file_count);
+    for (uint32_t i = 0; i < file_count; i++)
+        file_offsets[i] = read_be32(bytes + file_table + 4 + i * 10);
+    std::vector<size_t> sorted_offsets(file_offsets);
+    sorted_offsets.push_back(size);
+    std::sort(sorted_offsets.begin(), sorted_offsets.end());
+
+    // type table
+    if (rsrc_dir + 4 > size)
+        return false;
+    uint16_t type_count = read_be16(bytes + rsrc_dir + 2);
+    if (rsrc_dir + 4 + (size_t)type_count * 8 > size)
+        return false;
+
+    for (uint16_t t = 0; t < type_count; t++) {
+        const uint8_t* entry = bytes + rsrc_dir + 4 + t * 8;
+        if (memcmp(entry, type, 4) != 0)
+            continue;
+
+        size_t rsrc_table = rsrc_dir + read_be16(entry + 4);
+        if (rsrc_table + 2 > size)
+            return false;
+        uint16_t rsrc_count = read_be16(bytes + rsrc_table);
+        if (rsrc_table + 2 + (size_t)rsrc_count * 4 > size)
+            return false;
+
+        for (uint16_t r = 0; r < rsrc_count; r++) {
+            uint16_t id = read_be16(bytes + rsrc_table + 2 + r * 4);
+            uint16_t index = read_be16(bytes + rsrc_table + 4 + r * 4);
+
+            // file table indices are 1-based
+            if (index == 0 || index > file_count || file_offsets[index - 1] > size)
+                return false;
+
+            resource_t resource;
+            resource.id = id;
+            resource.offset = file_offsets[index - 1];
+            resource.length = *std::upper_bound(sorted_offsets.begin(), sorted_offsets.end(), resource.offset) - resource.offset;
+            resources.push_back(resource);
+        }
+    }
+    return true;
+}
+
+#endif // MOHAWK_RESOURCES_H
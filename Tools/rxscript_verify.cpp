@@ -0,0 +1,197 @@
+/*
+ *  rxscript_verify.cpp
+ *  rivenx
+ *
+ *  Created by Jean-Francois Roy on 25/10/2012.
+ *  Copyright 2005-2012 MacStorm. All rights reserved.
+ *
+ */
+
+/*
+ * Runs the script verifier over every program of every CARD and HSPT resource in a set of Mohawk archives and reports
+ * the violations, which are the programs the engine would reject when loading the card. The tool only depends on the
+ * portable script verifier, so it builds on any platform:
+ *
+ *     c++ -O2 -I. Tools/rxscript_verify.cpp Engine/RXScriptVerifier.cpp -o rxscript_verify
+ *
+ * usage: rxscript_verify [-q] archive ...
+ *
+ * -q only prints the summary. The exit status is EX_DATAERR if any program has a violation.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sysexits.h>
+
+#include <string>
+#include <vector>
+
+#include "Engine/RXScriptVerifier.h"
+#include "Tools/mohawk_resources.h"
+
+
+static const char* const event_names[] = {
+    "mouse down",
+    "mouse still down",
+    "mouse up",
+    "unknown 3",
+    "mouse inside",
+    "mouse exited",
+    "open card",
+    "close card",
+    "idle",
+    "start rendering",
+    "screen update",
+};
+static const uint16_t event_type_count = sizeof(event_names) / sizeof(const char*);
+
+// size of an HSPT record, which precedes each hotspot's script
+static const size_t hspt_record_size = 22;
+
+struct report_t {
+    bool quiet;
+    std::string location;
+    uint64_t programs;
+    uint64_t rejected_programs;
+    uint64_t violations;
+    uint64_t malformed_resources;
+};
+
+// verification
+
+static void print_violation(void* context, const rx_script_violation_t* violation) {
+    report_t* report = static_cast<report_t*>(context);
+    report->violations++;
+    if (report->quiet)
+        return;
+
+    printf("%s: %s (opcode %hu, %hu arguments, offset %lu, depth %u)\n", report->location.c_str(),
+           rx_script_violation_description(violation->code), violation->opcode, violation->argc,
+           (unsigned long)violation->offset, violation->depth);
+}
+
+// verifies a script (event count followed by events); returns the script's length, or 0 if it could not be measured
+static size_t verify_script(const uint8_t* script, size_t available, const std::string& location, report_t& report) {
+    if (available < 2)
+        return 0;
+    uint16_t event_count = read_be16(script);
+    size_t offset = 2;
+
+    for (uint16_t e = 0; e < event_count; e++) {
+        if (offset + 4 > available)
+            return 0;
+        uint16_t event = read_be16(script + offset);
+        uint16_t opcode_count = read_be16(script + offset + 2);
+        offset += 4;
+
+        char event_name[32];
+        if (event < event_type_count)
+            snprintf(event_name, sizeof(event_name), "%s", event_names[event]);
+        else
+            snprintf(event_name, sizeof(event_name), "event %hu", event);
+        report.location = location + " " + event_name + " program";
+
+        size_t length;
+        uint32_t violations = rx_script_verify_program(script + offset, available - offset, opcode_count, true, &length,
+                                                       print_violation, &report);
+        report.programs++;
+        if (violations || event >= event_type_count)
+            report.rejected_programs++;
+        if (length == RX_SCRIPT_VERIFIER_UNKNOWN_LENGTH)
+            return 0;
+        offset += length;
+    }
+
+    return offset;
+}
+
+static void verify_archive(const char* path, report_t& report) {
+    std::vector<uint8_t> archive;
+    if (!read_file(path, archive))
+        return;
+
+    std::vector<resource_t> cards;
+    std::vector<resource_t> hotspot_lists;
+    if (!mohawk_resources(archive, "CARD", cards) || !mohawk_resources(archive, "HSPT", hotspot_lists)) {
+        fprintf(stderr, "%s: not a valid Mohawk archive\n", path);
+        return;
+    }
+
+    char location[64];
+    for (size_t i = 0; i < cards.size(); i++) {
+        // the card script follows the card's name record and zip mode flag
+        snprintf(location, sizeof(location), ": CARD %hu", cards[i].id);
+        const uint8_t* card = &archive[0] + cards[i].offset;
+        if (cards[i].length < 6 || verify_script(card + 4, cards[i].length - 4, path + std::string(location), report) == 0) {
+            fprintf(stderr, "%s%s: malformed script resource\n", path, location);
+            report.malformed_resources++;
+        }
+    }
+
+    for (size_t i = 0; i < hotspot_lists.size(); i++) {
+        const uint8_t* list = &archive[0] + hotspot_lists[i].offset;
+        size_t length = hotspot_lists[i].length;
+        snprintf(location, sizeof(location), ": HSPT %hu", hotspot_lists[i].id);
+
+        // hotspot count, then each hotspot's record and script
+        bool malformed = length < 2;
+        uint16_t hotspot_count = (malformed) ? 0 : read_be16(list);
+        size_t offset = 2;
+        for (uint16_t h = 0; h < hotspot_count && !malformed; h++) {
+            offset += hspt_record_size;
+            if (offset > length) {
+                malformed = true;
+                break;
+            }
+
+            char hotspot_location[96];
+            snprintf(hotspot_location, sizeof(hotspot_location), "%s hotspot %hu", location, read_be16(list + offset - hspt_record_size));
+            size_t script_length = verify_script(list + offset, length - offset, path + std::string(hotspot_location), report);
+            if (script_length == 0)
+                malformed = true;
+            offset += script_length;
+        }
+
+        if (malformed) {
+            fprintf(stderr, "%s%s: malformed script resource\n", path, location);
+            report.malformed_resources++;
+        }
+    }
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [-q] archive ...\n", name);
+    exit(EX_USAGE);
+}
+
+int main(int argc, char* const argv[]) {
+    report_t report;
+    report.quiet = false;
+    report.programs = 0;
+    report.rejected_programs = 0;
+    report.violations = 0;
+    report.malformed_resources = 0;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "q")) != -1) {
+        switch (ch) {
+            case 'q':
+                report.quiet = true;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (optind == argc)
+        usage(argv[0]);
+
+    for (int i = optind; i < argc; i++)
+        verify_archive(argv[i], report);
+
+    printf("%llu programs, %llu rejected, %llu violations, %llu malformed resources\n",
+           (unsigned long long)report.programs, (unsigned long long)report.rejected_programs,
+           (unsigned long long)report.violations, (unsigned long long)report.malformed_resources);
+    return (report.rejected_programs || report.malformed_resources) ? EX_DATAERR : EX_OK;
+}
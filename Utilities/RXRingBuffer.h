@@ -0,0 +1,237 @@
+//
+//  RXRingBuffer.h
+//  rivenx
+//
+//  Created by Jean-Francois Roy on 20/10/2012.
+//  Copyright 2005-2012 MacStorm. All rights reserved.
+//
+
+#if !defined(RX_RING_BUFFER_H)
+#define RX_RING_BUFFER_H
+
+#if !defined(__cplusplus)
+#error C++ is required to include RXRingBuffer.h
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+//
+// RingBuffer is a single-producer single-consumer byte ring buffer. One thread writes, one thread reads, and neither
+// ever blocks, takes a lock or allocates, so the consumer side is safe to use from a real-time audio callback.
+//
+// Positions are free-running byte counters: the producer owns the write position and the consumer owns the read
+// position. Each side publishes its position with a release store and reads the other side's with an acquire load,
+// so the data written before a DidWrite is visible to the consumer once it sees the new write position.
+//
+// The storage is a whole number of VM pages. Where the platform allows it (Mach VM remapping on Mac OS X, memfd
+// double mapping on Linux), the pages are mapped twice back-to-back, so a span never wraps and ReadSpan/WriteSpan
+// always return everything available. Otherwise the storage is a single mapping and spans stop at the end of the
+// buffer; clients then loop over spans or use the Read/Write copy helpers, which handle both cases.
+//
+
+namespace RX {
+
+class RingBuffer {
+public:
+    // length is rounded up to a whole number of VM pages; mirroring can be turned off to exercise the fallback path
+    explicit RingBuffer(size_t length, bool mirror = true) throw() : _buffer(0), _capacity(0), _mirrored(false), _write_position(0), _read_position(0) {
+        size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        if (length == 0)
+            length = 1;
+        _capacity = (length + page_size - 1) & ~(page_size - 1);
+
+        if (mirror)
+            _buffer = AllocateMirrored(_capacity);
+        if (_buffer)
+            _mirrored = true;
+        else
+            _buffer = static_cast<uint8_t*>(valloc(_capacity));
+        if (!_buffer)
+            _capacity = 0;
+    }
+
+    ~RingBuffer() throw() {
+        if (!_buffer)
+            return;
+        if (_mirrored)
+            DeallocateMirrored(_buffer, _capacity);
+        else
+            free(_buffer);
+    }
+
+    inline bool Valid() const throw() {return _buffer != 0;}
+    inline size_t Capacity() const throw() {return _capacity;}
+    inline bool Mirrored() const throw() {return _mirrored;}
+
+    // may only be called when neither the producer nor the consumer is using the buffer
+    inline void Empty() throw() {
+        __atomic_store_n(&_read_position, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&_write_position, 0, __ATOMIC_RELEASE);
+    }
+
+    // either side
+    inline size_t BytesAvailableToRead() const throw() {
+        uint64_t read_position = __atomic_load_n(&_read_position, __ATOMIC_ACQUIRE);
+        return static_cast<size_t>(__atomic_load_n(&_write_position, __ATOMIC_ACQUIRE) - read_position);
+    }
+    inline bool IsEmpty() const throw() {return BytesAvailableToRead() == 0;}
+
+    // consumer side
+    inline size_t ReadSpan(const void** pointer) const throw() {
+        uint64_t read_position = __atomic_load_n(&_read_position, __ATOMIC_RELAXED);
+        size_t available = static_cast<size_t>(__atomic_load_n(&_write_position, __ATOMIC_ACQUIRE) - read_position);
+        size_t offset = static_cast<size_t>(read_position % _capacity);
+        if (!_mirrored && offset + available > _capacity)
+            available = _capacity - offset;
+        *pointer = _buffer + offset;
+        return available;
+    }
+
+    inline void DidRead(size_t length) throw() {
+        __atomic_store_n(&_read_position, __atomic_load_n(&_read_position, __ATOMIC_RELAXED) + length, __ATOMIC_RELEASE);
+    }
+
+    size_t Read(void* destination, size_t length) throw() {
+        size_t copied = 0;
+        while (copied < length) {
+            const void* span;
+            size_t available = ReadSpan(&span);
+            if (available == 0)
+                break;
+            if (available > length - copied)
+                available = length - copied;
+            memcpy(static_cast<uint8_t*>(destination) + copied, span, available);
+            DidRead(available);
+            copied += available;
+        }
+        return copied;
+    }
+
+    // producer side
+    inline size_t WriteSpan(void** pointer) const throw() {
+        uint64_t write_position = __atomic_load_n(&_write_position, __ATOMIC_RELAXED);
+        size_t available = _capacity - static_cast<size_t>(write_position - __atomic_load_n(&_read_position, __ATOMIC_ACQUIRE));
+        size_t offset = static_cast<size_t>(write_position % _capacity);
+        if (!_mirrored && offset + available > _capacity)
+            available = _capacity - offset;
+        *pointer = _buffer + offset;
+        return available;
+    }
+
+    inline void DidWrite(size_t length) throw() {
+        __atomic_store_n(&_write_position, __atomic_load_n(&_write_position, __ATOMIC_RELAXED) + length, __ATOMIC_RELEASE);
+    }
+
+    size_t Write(const void* source, size_t length) throw() {
+        size_t copied = 0;
+        while (copied < length) {
+            void* span;
+            size_t available = WriteSpan(&span);
+            if (available == 0)
+                break;
+            if (available > length - copied)
+                available = length - copied;
+            memcpy(span, static_cast<const uint8_t*>(source) + copied, available);
+            DidWrite(available);
+            copied += available;
+        }
+        return copied;
+    }
+
+private:
+    RingBuffer(const RingBuffer& c);
+    RingBuffer& operator=(const RingBuffer&) {return *this;}
+
+#if defined(__APPLE__)
+    static uint8_t* AllocateMirrored(size_t length) throw() {
+        // reserve twice the length, then replace the upper half with a second mapping of the lower half
+        vm_address_t address = 0;
+        if (vm_allocate(mach_task_self(), &address, 2 * length, VM_FLAGS_ANYWHERE) != KERN_SUCCESS)
+            return 0;
+        if (vm_deallocate(mach_task_self(), address + length, length) != KERN_SUCCESS) {
+            vm_deallocate(mach_task_self(), address, 2 * length);
+            return 0;
+        }
+
+        vm_address_t mirror = address + length;
+        vm_prot_t current_protection, max_protection;
+        kern_return_t kerr = vm_remap(mach_task_self(), &mirror, length, 0, VM_FLAGS_FIXED, mach_task_self(), address, FALSE,
+                                      &current_protection, &max_protection, VM_INHERIT_DEFAULT);
+        if (kerr != KERN_SUCCESS || mirror != address + length) {
+            if (kerr == KERN_SUCCESS)
+                vm_deallocate(mach_task_self(), mirror, length);
+            vm_deallocate(mach_task_self(), address, length);
+            return 0;
+        }
+        return reinterpret_cast<uint8_t*>(address);
+    }
+
+    static void DeallocateMirrored(uint8_t* buffer, size_t length) throw() {
+        vm_deallocate(mach_task_self(), reinterpret_cast<vm_address_t>(buffer), 2 * length);
+    }
+#elif defined(__linux__) && defined(SYS_memfd_create)
+    static uint8_t* AllocateMirrored(size_t length) throw() {
+        // map an anonymous memory file twice, back-to-back, inside a reserved region of twice the length
+        int fd = static_cast<int>(syscall(SYS_memfd_create, "rx_ring_buffer", 0));
+        if (fd == -1)
+            return 0;
+        if (ftruncate(fd, static_cast<off_t>(length)) == -1) {
+            close(fd);
+            return 0;
+        }
+
+        void* address = mmap(0, 2 * length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (address == MAP_FAILED) {
+            close(fd);
+            return 0;
+        }
+
+        uint8_t* base = static_cast<uint8_t*>(address);
+        if (mmap(base, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+            mmap(base + length, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+        {
+            munmap(address, 2 * length);
+            close(fd);
+            return 0;
+        }
+
+        // the mappings keep the memory alive
+        close(fd);
+        return base;
+    }
+
+    static void DeallocateMirrored(uint8_t* buffer, size_t length) throw() {
+        munmap(buffer, 2 * length);
+    }
+#else
+    static uint8_t* AllocateMirrored(size_t) throw() {return 0;}
+    static void DeallocateMirrored(uint8_t*, size_t) throw() {}
+#endif
+
+    uint8_t* _buffer;
+    size_t _capacity;
+    bool _mirrored;
+
+    // keep the producer and consumer positions on separate cache lines; they are 64-bit even on 32-bit architectures
+    // so that they never wrap around during the lifetime of a buffer
+    char _pad0[64];
+    uint64_t _write_position;
+    char _pad1[64];
+    uint64_t _read_position;
+    char _pad2[64];
+};
+
+} // namespace RX
+
+#endif // RX_RING_BUFFER_H
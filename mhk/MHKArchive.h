@@ -60,7 +60,7 @@
 
 // MHKArchive is KVO-compliant for all resource types as keys, read-only
 
-// resource accessors
+// resource accessors; the card loader calls them from several threads at once, so they must not modify the archive
 - (NSDictionary*)resourceDescriptorWithResourceType:(NSString*)type ID:(uint16_t)resourceID;
 - (MHKFileHandle*)openResourceWithResourceType:(NSString*)type ID:(uint16_t)resourceID;
 - (NSData*)dataWithResourceType:(NSString*)type ID:(uint16_t)resourceID;
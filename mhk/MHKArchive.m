@@ -530,6 +530,23 @@ MHK_INLINE uint32_t compute_file_table_entry_length(MHK_file_table_entry* s)
     // compute the file lengths since MHK have bogus values
     [self compute_file_lengths];
     
+    // store the length in every descriptor now, so that descriptors are never modified after the archive is open and
+    // can be looked up from several threads at once
+    NSEnumerator* types_enum = [file_descriptor_arrays objectEnumerator];
+    NSArray* type_descs;
+    while ((type_descs = [types_enum nextObject]))
+    {
+        NSEnumerator* files_enum = [type_descs objectEnumerator];
+        NSMutableDictionary* descriptor;
+        while ((descriptor = [files_enum nextObject]))
+        {
+            MHK_file_table_entry* file_entry = file_table + [[descriptor objectForKey:@"Index"] unsignedIntValue] - 1;
+            NSNumber* file_size_number = [[NSNumber alloc] initWithUnsignedInt:compute_file_table_entry_length(file_entry)];
+            [descriptor setObject:file_size_number forKey:@"Length"];
+            [file_size_number release];
+        }
+    }
+    
     // we don't need the global tables anymore
     if (name_list)
         free(name_list);
@@ -689,16 +706,8 @@ MHK_INLINE uint32_t compute_file_table_entry_length(MHK_file_table_entry* s)
         uint16_t m = l + (r - l) / 2;
         if (resourceID == binary_tree[m].resource_id)
         {
-            NSMutableDictionary* descriptor = binary_tree[m].descriptor;
-            
-            if (![descriptor objectForKey:@"Length"])
-            {
-                MHK_file_table_entry* file_entry = file_table + [[descriptor objectForKey:@"Index"] unsignedIntValue] - 1;
-                uint32_t file_size = compute_file_table_entry_length(file_entry);
-                [descriptor setObject:[NSNumber numberWithUnsignedInt:file_size] forKey:@"Length"];
-            }
-            
-            return [[descriptor copy] autorelease];
+            // the descriptor got its length when the archive was opened and is only read from here on
+            return [[binary_tree[m].descriptor copy] autorelease];
         }
         else if (resourceID < binary_tree[m].resource_id)
         {
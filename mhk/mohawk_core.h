@@ -10,7 +10,16 @@
 #if !defined(mohawk_core_h)
 #define mohawk_core_h 1
 
+#if defined(__APPLE__)
 #include <CoreFoundation/CFByteOrder.h>
+#else
+// the portable tools only need the big endian conversions
+#include <stdint.h>
+#include <endian.h>
+
+static __inline__ uint16_t CFSwapInt16BigToHost(uint16_t arg) {return be16toh(arg);}
+static __inline__ uint32_t CFSwapInt32BigToHost(uint32_t arg) {return be32toh(arg);}
+#endif
 
 #if !defined(MHK_INLINE)
 #define MHK_INLINE static __inline__